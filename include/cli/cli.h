@@ -8,12 +8,39 @@ typedef struct {
     bool print_ir;
     bool print_time;
     bool print_types;
+    bool print_stats;       // --stats: print the internal counters (core/stats.h) after the compile
+    bool mem_report;        // --mem-report: print allocations by category, kind and module (core/mem_report.h)
     bool verbose;
     bool run_executable;
     bool quiet;
+    bool link_in_process;   // link without spawning cc (falls back when unsupported)
+    bool check_all;         // --check-all: check and emit std functions the program never reaches
+    bool report_stack_allocs; // --report-stack-allocs: print each @alloc promoted to the stack
+    bool incremental;       // --incremental: reuse checked, compiled bodies from cache_dir (sema/decl_deps.h)
+    bool strict_overflow;   // --strict-overflow: signed +, -, * and negation never overflow (nsw)
+    bool strict_aliasing;   // --strict-aliasing: accesses of different scalar types never alias (TBAA)
+    bool bounds_checks;     // --bounds-checks: array and slice subscripts trap when out of range
     int opt_level;
+    int jobs;               // worker threads for loading, body checking and codegen (<= 1: serial)
+    int jit_opt_level;      // --run tier opt level (-1: same as opt_level)
+    int huge_pages;         // --huge-pages: 0 malloc'd arena, 1 transparent, 2 explicit (hugetlbfs)
     const char *output_name;
     const char *stdlib_path;
+    const char *cache_dir;  // module cache directory (NULL: no caching)
+    const char *serve_socket;   // --serve: run as a compile daemon on this socket
+    const char *connect_socket; // --connect: hand the compile to the daemon there
+    const char *batch_manifest; // --batch: compile each command line of this file
+    const char *trace_path;     // --trace: write a Chrome trace of the compile here
+    const char *target_cpu;      // -march / --target-cpu (NULL or "native": the host CPU)
+    const char *target_features; // --target-features, e.g. "+avx2,-avx512f" (NULL: the CPU's own)
+    int prefer_vector_width;     // --prefer-vector-width: widest vectors to prefer, in bits (0: target default)
+    int codegen_units;           // --codegen-units: objects the optimized module is split into (<= 1: one)
+    const char *profile_generate; // --profile-generate: raw profile the executable writes at exit (NULL: off)
+    const char *profile_use;      // --profile-use: indexed profile (llvm-profdata merge) to optimize with
+    bool instrument;              // --instrument: per-function call counts and cycles, reported at exit
+    bool perf_map;                // --perf-map: write /tmp/perf-<pid>.map for the --run JIT
+    bool fold_instances;          // --icf: fold functions (generic instances) that lower to identical code
+    bool fast_compile;            // -Odev: -O0 with fast instruction selection and no verifier (see codegen_emit.c)
 } Options;
 
 int parse_options(int argc, char **argv, Options *opts, const char **in_path);
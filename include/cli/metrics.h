@@ -24,4 +24,10 @@ typedef struct {
 size_t count_ast_nodes(AstNode *program);
 
 // Prints the formatted table report
-void print_compilation_report(CompilationStats *stats, AstNode *program);
\ No newline at end of file
+void print_compilation_report(CompilationStats *stats, AstNode *program);
+
+// Prints the --stats counters (core/stats.h) as a table
+void print_stats_report(void);
+
+// Prints the --mem-report tallies (core/mem_report.h): per category, kind and module
+void print_mem_report(void);
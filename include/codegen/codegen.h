@@ -11,17 +11,76 @@ typedef struct CodegenContext CodegenContext;
 CodegenContext* codegen_context_create(TypeStore *store, const char *module_name, int opt_level, ModuleLoader *loader);
 void codegen_context_destroy(CodegenContext *ctx);
 
+// Disposes the module and its LLVM context once every object is emitted, so
+// that linking runs without them. Only codegen_context_destroy may follow.
+void codegen_release_module(CodegenContext *ctx);
+
 // Global initialization of LLVM targets. Should be called once at startup.
 void codegen_initialize(void);
 
+// Checks -march / --target-cpu and --target-features against the host
+// target's tables (NULL: the host's own). Reports each unknown name on
+// stderr and returns false if there was one. Call after codegen_initialize.
+bool codegen_check_target(const char *cpu, const char *features);
+
+// Takes the non-generic code of library units (opts->stdlib_path) from cached
+// objects in `cache_dir`, compiling missing ones first. Call after sema and
+// before codegen_program, which then only declares that code. Object paths
+// (arena strings) are pushed onto `objects`; they must be linked in.
+// Returns the number of prebuilt units, or -1 on bad arguments.
+int codegen_use_prebuilt_libraries(CodegenContext *ctx, const char *cache_dir, Arena *arena, DynArray *objects);
+
+// Same for the function instances of prebuilt units' templates: each one is
+// cached under its template's sources, its type arguments (and the sources
+// declaring them) and the target. Call after codegen_use_prebuilt_libraries.
+// Returns the number of instances linked from the cache, or -1 on bad arguments.
+int codegen_use_cached_instances(CodegenContext *ctx, const char *cache_dir, Arena *arena, DynArray *objects);
+
+// With --incremental: the bodies sema found unchanged (AST_FLAG_REUSED) come
+// from their cached objects, and the other cacheable ones are compiled into
+// the objects sema named (CompilationUnit.body_objects). Their paths are
+// copied into `arena` and pushed onto `objects`. Returns the number of bodies linked from objects,
+// or -1 on bad arguments.
+int codegen_use_cached_bodies(CodegenContext *ctx, Arena *arena, DynArray *objects);
+
 // Generates LLVM IR for the program. Returns 0 on success.
 int codegen_program(CodegenContext *ctx);
 
 // Prints the LLVM IR to stdout
 void codegen_dump_module(CodegenContext *ctx);
 
+// The LLVM IR as a malloc'd string the caller frees; NULL without a module.
+char *codegen_module_ir(CodegenContext *ctx);
+
 // Emits the LLVM IR to a file
 void codegen_emit_object(CodegenContext *ctx, const char *filename);
 
+// Emits the object file into memory. Returns a malloc'd buffer the caller
+// frees and stores its size in `out_size`; NULL on failure.
+unsigned char *codegen_emit_object_buffer(CodegenContext *ctx, size_t *out_size);
+
+typedef struct {
+    unsigned char *data; // malloc'd object file image
+    size_t size;
+} CodegenObject;
+
+// --codegen-units: splits the optimized module into at most `units` objects
+// that are generated on as many threads and must all be linked. `objects`
+// needs room for `units`; the caller frees each data. Returns the number
+// written, 0 when the module is better emitted whole (one function, or
+// aliases), or SIZE_MAX when emitting failed.
+size_t codegen_emit_object_units(CodegenContext *ctx, size_t units, CodegenObject *objects);
+
+// Defines the print_* runtime (src/core/runtime.c) inside the module.
+// codegen_program does so before optimizing, so executables never link
+// runtime.c and its printers inline into their callers.
+void codegen_define_runtime(CodegenContext *ctx);
+
 // Runs the main function in the module using LLVM JIT and returns the exit code.
 int codegen_run_jit(CodegenContext *ctx);
+
+// Runs main on a lazy ORC JIT without building ctx's module: every unit is
+// lowered into its own module (on opts->jobs threads) and compiled only when
+// one of its functions is first called. IR passes and instruction selection
+// run at `opt_level`. Returns main's result, or -1 if the JIT cannot start.
+int codegen_run_lazy_jit(CodegenContext *ctx, int opt_level);
@@ -15,10 +15,49 @@
 
 /* --- Context Internals --- */
 
-typedef struct CodegenMap {
-    HashMap *map;
-    struct CodegenMap *parent;
-} CodegenMap;
+/* Calling convention of the target triple (codegen_abi.c). */
+typedef enum {
+    CODEGEN_ABI_GENERIC,    // First-class aggregates up to 16 bytes, byval / sret beyond
+    CODEGEN_ABI_SYSV_X86_64,
+    CODEGEN_ABI_AAPCS64,
+} CodegenAbi;
+
+/* How one parameter or result crosses a call. */
+typedef enum {
+    ABI_DIRECT,   // As its own LLVM type
+    ABI_COERCE,   // Reinterpreted as `coerce`, the registers the ABI assigns it
+    ABI_INDIRECT, // In memory: a pointer parameter (byval or a caller copy), sret as a result
+} AbiArgKind;
+
+typedef struct {
+    AbiArgKind kind;
+    bool byval;         // INDIRECT parameter copied onto the callee's stack
+    LLVMTypeRef coerce; // COERCE only
+} AbiArg;
+
+typedef struct {
+    AbiArg ret;
+    size_t param_count;
+    AbiArg params[];
+} AbiSignature;
+
+/*
+ * Local variables of the function being lowered: one flat slot per name
+ * (interned dense index), holding the innermost binding. Declaring a local
+ * logs the binding it shadows; leaving a scope replays the log back to the
+ * scope's mark. Lookups are a single index, and the table and log are kept
+ * for the life of the context, so no scope allocates.
+ */
+typedef struct {
+    int name;           // Dense index of the name
+    LLVMValueRef prev;  // Binding it shadowed, NULL if none
+} CodegenLocalUndo;
+
+typedef struct {
+    LLVMValueRef *slots; // Dense name index -> alloca (or indirect param)
+    size_t capacity;
+    DynArray undo;       // DynArray<CodegenLocalUndo>
+} CodegenLocals;
 
 struct CodegenContext {
     TypeStore *store;
@@ -27,49 +66,123 @@ struct CodegenContext {
     LLVMBuilderRef builder;
     LLVMTargetRef target;
     LLVMTargetMachineRef machine;
+    LLVMCodeGenOptLevel codegen_level; // Backend effort of `machine`
+    bool owns_machine;       // false: borrowed from the context this one was derived from
     LLVMTargetDataRef target_data;
-    HashMap *globals;
+    char *target_cpu;        // CPU and features of `machine`, repeated on every function
+    char *target_features;
+    int prefer_vector_width; // --prefer-vector-width bits (0: the target's choice)
+    bool strict_overflow;    // --strict-overflow: signed arithmetic is nsw
+    bool strict_aliasing;    // --strict-aliasing: loads and stores carry !tbaa (codegen_types.c)
+    bool bounds_checks;      // --bounds-checks: subscripts trap out of range (codegen_bounds.c)
+    bool instrument;         // --instrument: bodies count calls and cycles (codegen_instrument.c)
+    bool fold_instances;     // --icf: merge functions that lower to identical code (mergefunc)
+    bool comdats;            // The object format has COMDAT groups (not Mach-O)
+    bool fast_compile;       // -Odev: fast instruction selection, no verifier outside DEV_BUILD
+    LLVMValueRef tbaa_tags[6]; // Access tag per scalar kind, built on first use
+    CodegenAbi abi;
+    HashMap *abi_signatures; // function Type* -> AbiSignature (owned)
+    HashMap *decl_values; // function / global decl -> its LLVMValueRef in `module`
     HashMap *type_cache;
-    CodegenMap *locals;
+    HashMap *field_slots; // explicitly laid out struct Type* -> unsigned[]: LLVM element of each field
+    HashMap *type_aligns; // LLVM struct type -> alignment its storage needs beyond the ABI one
+    CodegenLocals locals;
     LLVMBasicBlockRef loop_cond_bb;
     LLVMBasicBlockRef loop_end_bb;
     int opt_level;
+
+    // Split codegen (-j N slices, prebuilt library objects)
+    bool export_wrappers;   // @link wrappers keep external linkage
+    bool emit_definitions;  // Protos of units lowered elsewhere are declarations
+    HashMap *cached_bodies; // function decl -> itself: body comes from a cached object
+    bool export_runtime;    // print_* stay external: linked objects call them as well
     
     ModuleLoader *loader; // Added for module name mangling
     
+    // Escape analysis of the current function (codegen_escape.c)
+    HashMap *stack_allocs; // @alloc / @free node -> itself: lowered to an alloca / elided
+
+    // Bounds checks of the current function (codegen_bounds.c)
+    HashMap *safe_subscripts;          // subscript node -> itself: proven in range, not checked
+    LLVMBasicBlockRef bounds_trap_bb;  // Where failed checks branch, NULL until the first one
+
     // For sret
     Type *current_func_type;
     LLVMValueRef sret_ptr;
+    AstNode *sret_local;       // Local every return returns, kept in sret_ptr itself (NRVO), or NULL
+
+    // For `return @tail(...)` back into the current function (AST_FLAG_SELF_TAIL_CALL)
+    LLVMBasicBlockRef tail_entry_bb; // Just past the parameter spills, NULL without such a call
+    LLVMValueRef *tail_param_slots;  // Storage of each parameter, rewritten before the jump
     
-    // For defer
-    DynArray *deferred_actions;
-    size_t loop_defer_count;
-
-    // Centralized defer cleanup tracking
-    LLVMBasicBlockRef current_cleanup_bb; 
-    LLVMValueRef exit_dest_var;
-    LLVMValueRef ret_val_var;
+    // For defer (codegen_stmt.c)
+    DynArray *deferred_actions; // DynArray<DeferInfo*>: pending defers, outermost first
+    size_t loop_defer_count;    // Of those, the ones outside the innermost loop
+    LLVMValueRef ret_val_var;   // Holds a result across a shared deferred body
+
+    // For async fns (codegen_async.c)
+    LLVMValueRef async_frame;   // Frame the body being lowered runs in, NULL outside an async fn
+    DynArray *async_resumes;    // DynArray<LLVMBasicBlockRef>: where resume point k continues, at k - 1
 };
 
 /* --- Internal Helpers --- */
 
-CodegenMap   *codegen_map_create(CodegenContext *ctx, CodegenMap *parent);
-void          codegen_map_destroy(CodegenMap *m);
-void          codegen_map_put(CodegenMap *m, void *key, LLVMValueRef val);
-LLVMValueRef  codegen_map_get(CodegenMap *m, void *key);
+// A context for a module lowered alongside `parent` (a -j slice, a cached
+// object) that shares its target machine.
+CodegenContext *codegen_context_derive(CodegenContext *parent, const char *module_name, int opt_level);
+
+size_t        codegen_locals_enter(CodegenContext *ctx);
+void          codegen_locals_leave(CodegenContext *ctx, size_t mark);
+size_t        codegen_locals_rewind(CodegenContext *ctx, size_t mark);
+void          codegen_locals_replay(CodegenContext *ctx, size_t mark, size_t top);
+void          codegen_locals_put(CodegenContext *ctx, int name, LLVMValueRef val);
+LLVMValueRef  codegen_locals_get(CodegenContext *ctx, int name);
 
 LLVMTypeRef  get_llvm_type(CodegenContext *ctx, Type *t);
 LLVMTypeRef  get_llvm_function_type(CodegenContext *ctx, Type *t);
+unsigned     codegen_field_slot(CodegenContext *ctx, Type *struct_type, size_t field);
+void         codegen_align_storage(CodegenContext *ctx, LLVMValueRef storage, LLVMTypeRef ty);
 bool         type_is_address_only(Type *t);
-bool         type_is_indirect(CodegenContext *ctx, Type *t);
 LLVMValueRef codegen_load_value(CodegenContext *ctx, LLVMValueRef ptr, Type *type);
+void         codegen_store_value(CodegenContext *ctx, LLVMValueRef val, LLVMValueRef ptr, Type *type); // Copies an array given by address
+void         codegen_tbaa(CodegenContext *ctx, LLVMValueRef access, Type *type); // !tbaa of a load or store of `type`
 LLVMValueRef codegen_materialize_slice(CodegenContext *ctx, LLVMValueRef val, Type *src_type, Type *dst_type);
 LLVMValueRef create_entry_block_alloca(CodegenContext *ctx, LLVMTypeRef ty, const char *name);
 char*        mangle_name(CodegenContext *ctx, CompilationUnit *unit, InternResult *symbol_name, Type *fn_type);
+const char  *codegen_decl_name(CodegenContext *ctx, AstNode *decl);
+char        *codegen_display_name(CodegenContext *ctx, AstNode *decl); // "std.io.print(i32)", malloc'd
+LLVMValueRef codegen_decl_value(CodegenContext *ctx, AstNode *decl);
 bool         struct_field_index(Type *struct_type, const char *field_name, size_t *out_index);
 LLVMValueRef codegen_expr(CodegenContext *ctx, AstNode *expr);
+LLVMValueRef codegen_const_aggregate(CodegenContext *ctx, AstNode *expr); // A constant struct literal or list, or codegen_expr
+void         codegen_initializer_into(CodegenContext *ctx, AstNode *list, LLVMValueRef dst); // An array-typed list, written in place
+void         codegen_struct_literal_into(CodegenContext *ctx, AstNode *expr, LLVMValueRef dst); // Field by field, in place
 LLVMValueRef codegen_lvalue(CodegenContext *ctx, AstNode *expr);
 void         codegen_statement(CodegenContext *ctx, AstNode *stmt);
+void         codegen_find_stack_allocs(CodegenContext *ctx, AstNode *func);
+void         codegen_find_safe_subscripts(CodegenContext *ctx, AstNode *func);
+void         codegen_bounds_check(CodegenContext *ctx, AstNode *subscript, LLVMValueRef idx, LLVMValueRef len); // --bounds-checks: trap unless idx < len
+void         codegen_target_attributes(CodegenContext *ctx, LLVMValueRef func); // target-cpu and friends
+void         codegen_profile_program(CodegenContext *ctx);
+
+/* --- Direct calls through known allocators (codegen_devirt.c) --- */
+
+LLVMValueRef codegen_known_field_fn(CodegenContext *ctx, AstNode *aggregate, InternResult *field); // The fn a literal put in `field`, or NULL
+LLVMValueRef codegen_devirt_call(CodegenContext *ctx, LLVMTypeRef fn_ty, LLVMValueRef fn_ptr, LLVMValueRef known,
+                                 LLVMValueRef *args, unsigned nargs, const char *name);
+LLVMValueRef codegen_forwarding_call(CodegenContext *ctx, AstNode *expr, bool *handled); // a.alloc(n) on a known allocator
+
+/* --- --instrument (codegen_instrument.c) --- */
+
+void codegen_instrument_function(CodegenContext *ctx, AstNode *decl, LLVMValueRef func);
+void codegen_instrument_program(CodegenContext *ctx);
+
+/* --- C calling convention (codegen_abi.c) --- */
+
+CodegenAbi          codegen_abi_for_triple(const char *triple);
+const AbiSignature *codegen_abi_signature(CodegenContext *ctx, Type *fn_type);
+void                codegen_abi_attributes(CodegenContext *ctx, LLVMValueRef fn_or_call, Type *fn_type);
+LLVMValueRef        codegen_abi_coerce(CodegenContext *ctx, LLVMValueRef val, LLVMTypeRef to);
 
 /* --- Sub-dispatchers for codegen_expr --- */
 
@@ -77,8 +190,29 @@ LLVMValueRef codegen_expr_literal(CodegenContext *ctx, AstNode *expr);
 LLVMValueRef codegen_expr_ident(CodegenContext *ctx, AstNode *expr);
 LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr);
 LLVMValueRef codegen_expr_call(CodegenContext *ctx, AstNode *expr);
+bool         codegen_call_into(CodegenContext *ctx, AstNode *expr, LLVMValueRef dest); // An sret call, written to `dest`
+void         codegen_tail_call(CodegenContext *ctx, AstNode *expr); // `return @tail(call)`: terminates the block
+
+/* --- vec<T, N> (codegen_vector.c) --- */
+
+LLVMValueRef codegen_splat(CodegenContext *ctx, LLVMValueRef scalar, LLVMTypeRef vec_ty);
+LLVMValueRef codegen_vector_binary(CodegenContext *ctx, OpKind op, LLVMValueRef L, LLVMValueRef R, Type *vec, Type *result);
+LLVMValueRef codegen_vector_cast(CodegenContext *ctx, LLVMValueRef val, Type *from, Type *to);
+LLVMValueRef codegen_vector_intrinsic(CodegenContext *ctx, AstNode *expr);
+
+/* --- Atomics (codegen_atomic.c) --- */
+LLVMValueRef codegen_atomic_intrinsic(CodegenContext *ctx, AstNode *expr);
+
+/* --- Async fns and their frames (codegen_async.c) --- */
+
+LLVMTypeRef  codegen_async_ramp_type(CodegenContext *ctx, Type *fn_type); // ptr (alloc ctx, _alloc, _free, params...)
+void         codegen_async_function(CodegenContext *ctx, AstNode *decl, LLVMValueRef ramp); // The ramp and f.resume
+LLVMValueRef codegen_async_intrinsic(CodegenContext *ctx, AstNode *expr); // await, @spawn, @suspend, ...
+void         codegen_async_return(CodegenContext *ctx); // Marks the frame done and leaves f.resume
 
 /* --- Decl logic --- */
 
 void codegen_decl_proto(CodegenContext *ctx, AstNode *decl);
 void codegen_decl_body(CodegenContext *ctx, AstNode *decl);
+void codegen_decl_linkage(CodegenContext *ctx, AstNode *decl);
+void codegen_decl_instance_linkage(CodegenContext *ctx, AstNode *decl, bool keep);
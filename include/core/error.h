@@ -15,7 +15,7 @@ typedef struct AstNode AstNode;
 /**
  * @brief ICE with source location reporting.
  */
-#define ICE_AT(node, msg, ...) ice_impl_at(__FILE__, __LINE__, (node)->filename, (node)->span, msg, ##__VA_ARGS__)
+#define ICE_AT(node, msg, ...) ice_impl_at(__FILE__, __LINE__, (node)->span, msg, ##__VA_ARGS__)
 
 void ice_impl(const char *file, int line, const char *fmt, ...) __attribute__((noreturn));
-void ice_impl_at(const char *file, int line, const char *src_file, Span span, const char *fmt, ...) __attribute__((noreturn));
+void ice_impl_at(const char *file, int line, Span span, const char *fmt, ...) __attribute__((noreturn));
@@ -2,12 +2,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "arena.h"
 
 
 char *read_file(const char *filename);
 void free_file_content(char *content);
 
-int read_line_from_file(const char *filename, size_t line_no,
-                        char *buf, size_t buf_size, size_t *out_len);
-void print_source_excerpt(const char *filename, size_t line_no, size_t col);
-void print_source_excerpt_span(const char *filename, size_t line_no, size_t start_col, size_t end_col);
+/*
+ * Read a whole file straight into `arena` (NUL-terminated, one copy, no
+ * strlen). The buffer lives as long as the arena, so token slices can point
+ * into it directly. Returns NULL and reports the cause on failure.
+ */
+char *read_file_into_arena(Arena *arena, const char *filename, size_t *out_len);
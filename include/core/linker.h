@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * In-process linker for the simple case (--in-process-link).
+ *
+ * Links relocatable x86-64 ELF objects held in memory straight into a
+ * dynamically linked, non-PIE executable against glibc (libc.so.6 and
+ * libm.so.6), without temporary files or a `cc` subprocess. Every symbol
+ * the objects leave undefined is imported through a GOT slot bound at load
+ * time; there is no crt, so the objects must provide `main` and must not
+ * need constructors, TLS, common symbols or imported data.
+ *
+ * Anything outside that subset is reported as LINK_UNSUPPORTED before a
+ * byte is written, so callers can fall back to the system linker.
+ */
+
+typedef struct {
+    const void *data;
+    size_t size;
+    const char *name;   // For diagnostics
+} LinkInput;
+
+typedef enum {
+    LINK_OK,
+    LINK_UNSUPPORTED,   // Inputs or host outside the supported subset
+    LINK_FAILED,        // Bad input (e.g. undefined main) or I/O error
+} LinkStatus;
+
+/*
+ * Link `inputs` into the executable `output_path`. On anything but LINK_OK
+ * a reason is written to `err` (may be NULL).
+ */
+LinkStatus link_executable_in_process(const LinkInput *inputs, size_t count, const char *output_path,
+                                      char *err, size_t err_len);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "core/source_map.h"
+
+/*
+ * Per-category memory accounting for --mem-report.
+ *
+ * The arena call sites that make up most of a compile's footprint tag what
+ * they allocate: a category, an optional kind within it (the AstNodeType of
+ * a node, the TypeKind of a type) and the module it belongs to. Bytes and
+ * counts are summed per category, per kind and per module. Everything is
+ * cumulative since mem_report_start(): scratch allocations that are later
+ * rewound still count, so this is where memory went, not what is live.
+ *
+ * Until mem_report_start() MEM_ACCOUNT is a single untaken branch, so the
+ * hooks stay in release builds.
+ */
+
+typedef enum {
+    MEM_TOKENS,     // Streaming token chunks and token arrays
+    MEM_AST,        // Parsed nodes, by AstNodeType
+    MEM_TYPES,      // Canonical and declared types, by TypeKind
+    MEM_SCOPES,     // Scopes, local symbol tables and their bindings
+    MEM_SYMBOLS,    // Symbols and overload sets
+    MEM_HASHMAP,    // Hash-map headers and bucket arrays
+    MEM_INTERN,     // Interned strings and interner records
+    MEM_MONO,       // AST cloned for generic instances, by AstNodeType
+    MEM_CATEGORY_COUNT
+} MemCategory;
+
+// Kinds per category: room for every AstNodeType and TypeKind
+#define MEM_KIND_COUNT 48
+// For allocations without a kind (a cloned child list, a bucket array)
+#define MEM_KIND_NONE (-1)
+
+typedef struct {
+    size_t bytes;
+    size_t count;   // Objects allocated (tokens for MEM_TOKENS)
+} MemTally;
+
+extern bool g_mem_report_enabled;
+
+#define MEM_ACCOUNT(cat, kind, file, bytes, count) do {                        \
+        if (g_mem_report_enabled) mem_account((cat), (kind), (file), (bytes), (count)); \
+    } while (0)
+
+/* Zero every tally and start recording. */
+void mem_report_start(void);
+
+/* Stop recording; the tallies stay readable. */
+void mem_report_stop(void);
+
+/*
+ * Record `bytes` and `count` objects. `file` SOURCE_NONE charges the module
+ * set by mem_report_set_source() on the calling thread.
+ */
+void mem_account(MemCategory cat, int kind, SourceId file, size_t bytes, size_t count);
+
+/* Module that untagged allocations on this thread are charged to; returns the previous one. */
+SourceId mem_report_set_source(SourceId file);
+
+MemTally mem_report_category(MemCategory cat);
+MemTally mem_report_kind(MemCategory cat, int kind);
+MemTally mem_report_module(SourceId file, MemCategory cat);
+
+/* One past the highest module id charged so far. */
+SourceId mem_report_module_limit(void);
+
+/* Column name of a category ("tokens", "ast", ...). */
+const char *mem_category_name(MemCategory cat);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "parsing/ast.h"
+#include "arena.h"
+#include "dense_arena_interner.h"
+#include "core/source_map.h"
+
+/*
+ * On-disk cache of parsed modules (--cache-dir).
+ *
+ * Entries are keyed by a hash of the module's source bytes, so an unchanged
+ * file maps to the same entry no matter where it lives or who imports it.
+ * Each entry holds the module's AST as it comes out of the parser (no sema
+ * state); interned names are stored as text and re-interned on load, which
+ * keeps entries valid across runs with different interner contents.
+ *
+ * A module the program imports (outside the library, whose entries are
+ * skimmed already) also gets an interface summary (.nti) under the same key: the same AST, but with every function body kept as its byte range in
+ * the source, the way the parser skims library bodies. Importers only need
+ * the declarations, so a summary costs what the module's interface costs to
+ * decode; a body is parsed only if sema checks it (see parse_deferred_body).
+ * Generic templates keep their range too, which every instance re-parses.
+ */
+
+/* Content hash used as the cache key (includes the entry format version). */
+uint64_t module_cache_key(const char *src, size_t len);
+
+/*
+ * Rebuild the AST cached under `key` into `arena`. Nodes get `filename` as
+ * their originating module and spans point into source `file`. Returns NULL on a miss or a stale/corrupt entry.
+ * Safe to call from several threads while the identifier and string
+ * interners are in concurrent mode (keywords are only peeked).
+ */
+AstNode *module_cache_fetch(const char *cache_dir, uint64_t key, size_t src_len,
+                            Arena *arena, const char *filename, SourceId file,
+                            DenseArenaInterner *keywords,
+                            DenseArenaInterner *identifiers,
+                            DenseArenaInterner *strings);
+
+/*
+ * Serialize `ast` under `key`. The entry is written to a temporary file and
+ * renamed into place, so concurrent compilers never see a partial entry.
+ * Must not run while the interners are in concurrent mode.
+ */
+bool module_cache_store(const char *cache_dir, uint64_t key, size_t src_len, AstNode *ast,
+                        DenseArenaInterner *keywords,
+                        DenseArenaInterner *identifiers,
+                        DenseArenaInterner *strings);
+
+/* Same as module_cache_fetch, for the interface summary under `key`. */
+AstNode *module_cache_fetch_interface(const char *cache_dir, uint64_t key, size_t src_len,
+                                      Arena *arena, const char *filename, SourceId file,
+                                      DenseArenaInterner *keywords,
+                                      DenseArenaInterner *identifiers,
+                                      DenseArenaInterner *strings);
+
+/* Same as module_cache_store, writing `ast` as an interface summary. */
+bool module_cache_store_interface(const char *cache_dir, uint64_t key, size_t src_len, AstNode *ast,
+                                  DenseArenaInterner *keywords,
+                                  DenseArenaInterner *identifiers,
+                                  DenseArenaInterner *strings);
@@ -8,6 +8,7 @@
 
 typedef struct CompilationUnit {
     char *absolute_path;
+    SourceId file;          // Registered buffer; what symbols and spans name the module by
     char *logical_path;     // e.g., "std.io"
     AstNode *ast_root;
     Scope *global_scope;
@@ -15,6 +16,16 @@ typedef struct CompilationUnit {
     bool imports_resolved;
     HashMap *generic_templates; // InternResult* -> AstNode* (template decl)
     DynArray *mono_instances;   // DynArray<AstNode*> (monomorphized function/struct decls)
+    HashMap *mono_args;         // mono decl -> DynArray<Type*>: what it was instantiated with
+    uint64_t cache_key;         // Content hash of the source (--cache-dir only)
+    size_t source_len;
+    bool from_cache;            // AST was rebuilt from the module cache
+    bool from_interface;        // ... from the module's interface summary (bodies deferred)
+    bool is_library;            // Lives under opts->stdlib_path
+    bool prebuilt;              // Codegen: non-generic code comes from a cached object
+    bool bodies_checked;        // Sema pass 2 is done (kept across --serve requests)
+    bool resident;              // Preloaded by the --serve daemon
+    HashMap *body_objects;      // function decl -> cached object path (--incremental, sema/decl_deps.h)
 } CompilationUnit;
 
 typedef struct {
@@ -26,9 +37,12 @@ typedef struct {
 
     HashMap *units; // char* (abs_path) -> CompilationUnit*
     HashMap *units_by_logical_path; // char* (logical) -> CompilationUnit*
+    HashMap *units_by_file; // SourceId -> CompilationUnit*
     DynArray *units_ordered; // DynArray<CompilationUnit*> (post-order)
 
     char *project_root; // Absolute path to entry point directory
+    char *stdlib_root;  // Absolute opts->stdlib_path, resolved on first use
+    struct ResolveCache *resolve_cache; // Import paths already resolved (module_loader.c)
 } ModuleLoader;
 
 
@@ -37,5 +51,31 @@ ModuleLoader* module_loader_create(Arena *arena, Options *opts,
                                    DenseArenaInterner *identifiers, 
                                    DenseArenaInterner *strings);
 
+/*
+ * Load the entry module at `path` and everything it imports. With
+ * opts->jobs > 1 files are read, lexed and parsed on a worker pool; the
+ * resulting `units_ordered` is the same post-order as the serial walk.
+ * With opts->cache_dir unchanged modules come from the module cache, and
+ * every module parsed from source is written back there on success.
+ */
+int module_loader_load(ModuleLoader *loader, const char *path);
+
+/*
+ * Load every module under opts->stdlib_path (std/vec.nt as "std.vec",
+ * std/module.nt as "std", ...) and mark the units resident. Used by the
+ * --serve daemon, whose requests then only parse their own modules. The
+ * project root is left unset for the first real load.
+ */
+int module_loader_preload_library(ModuleLoader *loader);
+
+/*
+ * Drop every unit from `units_ordered` that the module at `path` does not
+ * (transitively) import. The units stay loaded; they are only left out of
+ * sema and codegen for this program.
+ */
+void module_loader_retain_reachable(ModuleLoader *loader, const char *path);
+
 int load_module_recursive(ModuleLoader *loader, const char *path, const char *logical_path, const char *importer_path, int depth);
 CompilationUnit* module_loader_get_unit(ModuleLoader *loader, const char *path);
+/* The unit whose source is `file`, or NULL (e.g. for SOURCE_NONE). */
+CompilationUnit* module_loader_unit_for_file(ModuleLoader *loader, SourceId file);
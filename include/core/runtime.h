@@ -11,3 +11,6 @@ void print_str(const char *s);
 void print_char(char c);
 void print_ptr(void *p);
 void print_newline(void);
+
+/* --instrument under --run: print the per-function report and reset it. */
+void newt_instrument_report(void);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Compile server (--serve / --connect) and batch mode (--batch), Unix only.
+ *
+ * The daemon builds the expensive, program-independent state once (the
+ * parsed and checked library, interners, type store) and then forks one
+ * child per request. A child starts from a copy-on-write image of the warm
+ * state, compiles and exits, so requests never see each other's modules and
+ * nothing has to be torn down between them.
+ *
+ * A request carries the client's working directory, its command line and
+ * its stdin/stdout/stderr (passed as file descriptors), so diagnostics and
+ * --run output land exactly where they would for a local compile. The reply
+ * is the request's exit code.
+ *
+ * --batch runs the same warm-state-then-fork scheme without a socket: the
+ * requests are the lines of a manifest, and up to -j children compile at
+ * once in the compiler's own directory and with its standard streams.
+ */
+
+/*
+ * Compiles one request inside the forked child, already running in the
+ * client's directory with the client's standard streams. `argv` is the
+ * client's command line without the --connect option.
+ */
+typedef int (*ServeHandler)(int argc, char **argv, void *arg);
+
+/*
+ * Listen on `socket_path` until SIGINT/SIGTERM, running `handler` in a
+ * fresh child for every connection. A stale socket file is replaced and
+ * the socket is removed on exit. Returns EXIT_OK or EXIT_IO.
+ */
+int server_run(const char *socket_path, ServeHandler handler, void *arg);
+
+/*
+ * Client side: send the current directory, `argv` (minus any --connect
+ * option) and the standard streams to the daemon at `socket_path` and wait
+ * for the exit code. Returns EXIT_IO when no daemon answers.
+ */
+int server_request(const char *socket_path, int argc, char **argv);
+
+/*
+ * One manifest line: a command line without the program name, split on
+ * blanks (no quoting). `#` starts a comment; blank lines are skipped.
+ */
+typedef struct {
+    int argc;       // Including argv[0], the compiler's name
+    char **argv;    // NULL-terminated; points into the manifest text
+    int line;       // 1-based line in the manifest
+    int code;       // Exit code, filled in by server_batch
+} BatchEntry;
+
+typedef struct {
+    BatchEntry *entries;
+    size_t count;
+    char **slots;   // Every entry's argv is a window into this array
+    char *text;
+} BatchManifest;
+
+/* Read and split the manifest at `path`; false (with a message) if it cannot be read. */
+bool batch_manifest_read(const char *path, const char *prog, BatchManifest *out);
+void batch_manifest_free(BatchManifest *manifest);
+
+/*
+ * Run `handler` for every entry in a fresh child, at most `jobs` at a time,
+ * and store each child's result in its entry (EXIT_IO if it died). Returns
+ * EXIT_OK when every entry did, else the code of the first failing entry.
+ */
+int server_batch(BatchManifest *manifest, int jobs, ServeHandler handler, void *arg);
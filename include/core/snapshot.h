@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+#include "dense_arena_interner.h"
+#include "sema/type.h"
+
+/*
+ * Startup snapshot (--cache-dir).
+ *
+ * Every compile starts by building the same state before it reads a line
+ * of source: the keyword, identifier and string interners with the
+ * keywords in them, the TypeStore with its primitives and pre-interned
+ * names (`len` and the intrinsics), and the universe scope. All of it lives
+ * in the first block of the central arena, and none of it points outside
+ * that block except the interners' callbacks.
+ *
+ * So the block is built once at a fixed address, written to the cache
+ * directory and from then on mapped back, copy-on-write, at that same
+ * address. Pointers, and the pointer hashes the tables were filled with,
+ * stay valid as they are; only the callbacks are set again, since the
+ * executable moves between runs. The arena goes on allocating behind the
+ * snapshot in the mapped block, so nothing else changes for the compile.
+ *
+ * A snapshot belongs to one executable (its path identity, size and
+ * modification time) and format version; a mismatch, a taken address or
+ * any I/O failure builds the state from scratch instead. Linux only:
+ * elsewhere the state is always built.
+ */
+
+typedef struct StartupState {
+    DenseArenaInterner *keywords;
+    DenseArenaInterner *identifiers;
+    DenseArenaInterner *strings;
+    TypeStore *store;     // Universe scope included
+} StartupState;
+
+/* Build the startup state into `arena` from scratch. False on OOM. */
+bool startup_state_build(Arena *arena, StartupState *out);
+
+/*
+ * The central arena, `size` bytes to start with and blocks from `backing`
+ * after that, holding the startup state in `*out`. With a `cache_dir` the
+ * state is mapped from the snapshot there, or built and saved as one;
+ * `*mapped` (when not NULL) tells which. NULL on OOM.
+ */
+Arena *startup_state_open(const char *cache_dir, size_t size, ArenaBacking backing,
+                          StartupState *out, bool *mapped);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "core/utils.h"
+
+/*
+ * Registry of source buffers that spans point into.
+ *
+ * Every loaded file is registered once and named by its 32-bit id from then
+ * on: spans, symbols and compilation units carry the id, so "same module" is
+ * an integer compare and the path is only looked up when printed. A Span
+ * only carries a file id and two byte offsets; the line and column behind an
+ * offset are worked out here, when a diagnostic or a dump needs them. Each
+ * file's line-start table is built on the first such lookup and kept, so the
+ * lexer never counts lines, and diagnostic excerpts are cut from the
+ * registered buffer instead of re-reading the file. Registration and lookups
+ * are thread-safe; ids are never reused.
+ */
+
+typedef uint32_t SourceId;
+#define SOURCE_NONE ((SourceId)0)
+
+typedef struct {
+    uint32_t line;  // 1-based; 0 when the span has no file
+    uint32_t col;   // 1-based byte column
+} SourcePos;
+
+/*
+ * Register `text` (not copied; it must outlive every lookup) under `path`,
+ * which is copied and may be NULL for in-memory input. Returns SOURCE_NONE
+ * when out of memory.
+ */
+SourceId source_register(const char *path, const char *text, size_t len);
+
+/* Path given at registration, or NULL. */
+const char *source_path(SourceId file);
+
+/* Text given at registration and its length, or NULL. */
+const char *source_text(SourceId file, size_t *len);
+
+/* Line and column of byte `offset` in `file`; {0, 0} for SOURCE_NONE. */
+SourcePos source_pos(SourceId file, uint32_t offset);
+
+/*
+ * Line `line` (1-based) of `file` without its newline, pointing into the
+ * registered text, or NULL when the file has no such line.
+ */
+const char *source_line(SourceId file, uint32_t line, size_t *len);
+
+/* Print `line` of `file` with a caret under [start_col, end_col) to stderr. */
+void print_source_excerpt_span(SourceId file, size_t line_no, size_t start_col, size_t end_col);
+void print_source_excerpt(SourceId file, size_t line_no, size_t col);
+
+static inline SourcePos span_start_pos(Span span) { return source_pos(span.file, span.start); }
+static inline SourcePos span_end_pos(Span span) { return source_pos(span.file, span.end); }
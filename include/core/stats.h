@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Internal statistics counters for --stats.
+ *
+ * Each counter is one relaxed atomic add on a global array, so the hooks are
+ * cheap enough for hash-map probes but not free: they are compiled in only
+ * with NEWT_STATS (dev builds, or `make STATS=1`). Without it STAT_INC,
+ * STAT_ADD and STAT_MAX expand to nothing and stats_enabled() is false.
+ *
+ * Counters are either sums (STAT_INC/STAT_ADD) or high-water marks
+ * (STAT_MAX); the third column says how to read them in the report.
+ */
+#define NEWT_STAT_COUNTERS(X)                                                          \
+    X(HASHMAP_LOOKUPS,      "hashmap.lookups",       "hash-map lookups")              \
+    X(HASHMAP_PROBE_GROUPS, "hashmap.probe_groups",  "groups probed past home slot")  \
+    X(HASHMAP_PROBE_MAX,    "hashmap.probe_max",     "longest probe (groups)")        \
+    X(INTERN_HITS,          "intern.hits",           "interner hits")                 \
+    X(INTERN_MISSES,        "intern.misses",         "interner misses (inserts)")     \
+    X(SCOPE_LOOKUPS,        "scope.lookups",         "scope_lookup_symbol calls")     \
+    X(SCOPE_WALKED,         "scope.walked",          "scopes walked")                 \
+    X(SCOPE_DEPTH_MAX,      "scope.depth_max",       "deepest scope walk")            \
+    X(OVERLOAD_RESOLUTIONS, "overload.resolutions",  "overload sets resolved")        \
+    X(OVERLOAD_CANDIDATES,  "overload.candidates",   "overload candidates scored")    \
+    X(MONO_STRUCTS,         "mono.structs",          "generic structs instantiated")  \
+    X(MONO_FUNCTIONS,       "mono.functions",        "generic functions instantiated") \
+    X(MONO_METHODS,         "mono.methods",          "generic methods instantiated")  \
+    X(MONO_CACHE_HITS,      "mono.cache_hits",       "instantiations reused")         \
+    X(AST_NODES_CLONED,     "ast.nodes_cloned",      "AST nodes cloned")              \
+    X(CODEGEN_FUNCTIONS,    "codegen.functions",     "function bodies emitted")       \
+    X(CODEGEN_BLOCKS,       "codegen.blocks",        "basic blocks created")          \
+    X(CODEGEN_FOLDED,       "codegen.folded",        "functions folded by --icf")     \
+    X(BOUNDS_CHECKS,        "bounds.checks",         "subscripts bounds-checked")     \
+    X(BOUNDS_ELIDED,        "bounds.elided",         "bounds checks proven redundant") \
+    X(MODULE_RESOLVES,      "module.resolves",       "module paths resolved")         \
+    X(MODULE_RESOLVE_HITS,  "module.resolve_hits",   "paths resolved from the cache") \
+    X(MODULE_FS_PROBES,     "module.fs_probes",      "stat/realpath/opendir calls")
+
+typedef enum {
+#define STAT_ENUM(id, name, desc) STAT_##id,
+    NEWT_STAT_COUNTERS(STAT_ENUM)
+#undef STAT_ENUM
+    STAT_COUNT
+} StatCounter;
+
+#ifdef NEWT_STATS
+
+extern size_t g_stat_counters[STAT_COUNT];
+
+#define STAT_ADD(id, n) \
+    ((void)__atomic_fetch_add(&g_stat_counters[STAT_##id], (size_t)(n), __ATOMIC_RELAXED))
+#define STAT_INC(id) STAT_ADD(id, 1)
+#define STAT_MAX(id, n) stat_max(STAT_##id, (size_t)(n))
+
+void stat_max(StatCounter id, size_t value);
+
+#else
+
+// Still evaluate nothing, but keep locals that only feed a counter "used"
+#define STAT_ADD(id, n) ((void)sizeof(n))
+#define STAT_INC(id)    ((void)0)
+#define STAT_MAX(id, n) ((void)sizeof(n))
+
+#endif
+
+/* True when the counters are compiled in. */
+bool stats_enabled(void);
+
+/* Zero every counter (a --serve daemon does this per request). */
+void stats_reset(void);
+
+/* Current value of one counter. */
+size_t stats_get(StatCounter id);
+
+/* Dotted name ("hashmap.lookups") and description of a counter. */
+const char *stats_name(StatCounter id);
+const char *stats_description(StatCounter id);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Span tracing for --trace=<file>.
+ *
+ * Spans nest per thread and are written out as Chrome trace_event JSON
+ * (chrome://tracing, Perfetto): one "B"/"E" pair per span, with the thread
+ * that recorded it as `tid`. Until trace_start() every call returns right
+ * away, so the hooks stay in release builds.
+ *
+ * Categories in use: "phase" (driver stages), "module" (loading one file),
+ * "sema" (sub-passes, function bodies), "codegen" (functions, partitions,
+ * optimization, emission), "link" and "jit".
+ */
+
+/* Start recording; timestamps are relative to this call. */
+void trace_start(void);
+
+/* Open a span on the calling thread. `name` is copied. */
+void trace_begin(const char *cat, const char *name);
+
+/* Same, for a name that is not NUL-terminated (e.g. an interned Slice). */
+void trace_begin_n(const char *cat, const char *name, size_t len);
+
+/* Close the innermost span opened by this thread. */
+void trace_end(void);
+
+/* Write everything recorded so far to `path` and stop recording. */
+bool trace_write_json(const char *path);
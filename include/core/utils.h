@@ -3,11 +3,15 @@
 #include <string.h>
 
 
+// ------------------------------
+// A span: byte range [start, end) in a registered source file. Line and
+// column are resolved on demand through core/source_map.h; file 0 means
+// the node has no source position.
+// ------------------------------
 typedef struct {
-    size_t start_line;
-    size_t start_col;
-    size_t end_line;
-    size_t end_col;
+    uint32_t file;
+    uint32_t start;
+    uint32_t end;
 } Span;
 
 // ------------------------------
@@ -18,16 +22,82 @@ typedef struct {
     uint32_t len;     // length of the slice
 } Slice;
 
-static inline size_t slice_hash(void *p) {
-    Slice *s = (Slice*)p;
+/*
+ * Byte hash behind slice_hash/str_hash. The default reads the key eight (or
+ * four) bytes at a time and folds them with 64x64->128 multiplies, in the
+ * style of wyhash; identifiers up to 16 bytes take no loop at all. Build
+ * with -DNEWT_HASH_FNV1A (make HASH=fnv1a) for the old byte-at-a-time
+ * FNV-1a. Either way the value is only stable within one build.
+ */
+#ifdef NEWT_HASH_FNV1A
+
+static inline size_t hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
     size_t h = (size_t)1469598103934665603ULL; /* FNV-1a 64-bit */
-    for (size_t i = 0; i < s->len; ++i) {
-        h ^= (unsigned char)s->ptr[i];
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
         h *= (size_t)1099511628211ULL;
     }
     return h;
 }
 
+#else
+
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+
+static inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t hash_read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline size_t hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
+    uint64_t seed = HASH_P0;
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two overlapping 4-byte reads from each end cover 4..16 bytes
+            size_t mid = (len >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + mid);
+            b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        for (; i > 16; i -= 16, p += 16) {
+            seed = hash_mum(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+        }
+        // The last 16 bytes, overlapping the final block
+        a = hash_read64(p + i - 16);
+        b = hash_read64(p + i - 8);
+    }
+    return (size_t)hash_mum(HASH_P1 ^ len, hash_mum(a ^ HASH_P1, b ^ seed));
+}
+
+#endif
+
+static inline size_t slice_hash(void *p) {
+    Slice *s = (Slice*)p;
+    return hash_bytes(s->ptr, s->len);
+}
+
 static inline int slice_cmp(void *a, void *b) {
     Slice *sa = (Slice*)a;
     Slice *sb = (Slice*)b;
@@ -35,9 +105,8 @@ static inline int slice_cmp(void *a, void *b) {
     return memcmp(sa->ptr, sb->ptr, sa->len);
 }
 
-static inline Span span_join(const Span *a, const Span *b) {
-    if (!a || !b) return (Span){0,0,0,0};
-    return (Span){a->start_line, a->start_col, b->end_line, b->end_col};
+static inline Span span_join(Span a, Span b) {
+    return (Span){a.file, a.start, b.end};
 }
 
 static inline size_t ptr_hash(void *key) {
@@ -54,12 +123,7 @@ static inline int ptr_cmp(void *a, void *b) {
 
 static inline size_t str_hash(void *key) {
     const char *s = (const char *)key;
-    size_t h = (size_t)1469598103934665603ULL;
-    while (*s) {
-        h ^= (unsigned char)*s++;
-        h *= (size_t)1099511628211ULL;
-    }
-    return h;
+    return hash_bytes(s, strlen(s));
 }
 
 static inline int str_cmp(void *a, void *b) {
@@ -73,7 +137,5 @@ void *xmalloc(size_t size);
 void *xcalloc(size_t nmemb, size_t size);
 char *xstrdup(const char *s);
 
-char *get_runtime_path(void);
-
 // Runs a command and waits for it to complete. Returns exit code.
 int run_command(const char *cmd, char *const argv[]);
\ No newline at end of file
@@ -15,7 +15,8 @@
  *   - Good cache locality for sequential allocations.
  *
  * Limitations:
- *   - Individual objects cannot be freed; the entire arena is freed at once.
+ *   - Individual objects cannot be freed; memory is released all at once, or
+ *     back to a checkpoint taken with arena_mark().
  *   - Memory usage may be higher if the arena is over-allocated.
  */
 
@@ -23,20 +24,107 @@ typedef struct ArenaBlock {
     struct ArenaBlock *next; // Pointer to the next block
     size_t capacity;         // Total capacity of this block
     size_t used;             // Amount of memory used in this block
+    size_t mapped;           // Bytes mapped for this block (0: from malloc, ARENA_IN_REGION: see arena_create_in)
     char data[];             // Flexible array member for actual data
 } ArenaBlock;
 
+/*
+ * Where blocks come from. The default is malloc; the mmap variants map
+ * anonymous memory per block, optionally aligned to and advised for 2 MiB
+ * transparent huge pages, or backed by explicit hugetlbfs pages (falling
+ * back to transparent ones when none are reserved). Ignored where mmap is
+ * not available.
+ */
+typedef enum {
+    ARENA_MALLOC = 0,
+    ARENA_MMAP,
+    ARENA_HUGE_PAGES,
+    ARENA_HUGETLB
+} ArenaBacking;
+
 typedef struct Arena {
-    ArenaBlock *blocks;      // Linked list of memory blocks
+    ArenaBlock *blocks;      // Linked list of memory blocks, current first
     size_t block_size;       // Size of each block (initial capacity)
+    size_t next_block_size;  // Grows geometrically up to ARENA_MAX_BLOCK_SIZE
+    ArenaBlock *free_blocks; // Released by reset/rewind, reused before new ones
+    ArenaBacking backing;
+    struct Arena *adopted;      // Handed over by arena_adopt(), destroyed with this one
+    struct Arena *next_adopted; // Next in the adopting arena's list
+    size_t region_size;         // Nonzero: this struct heads a mapping of that many bytes
 } Arena;
 
+#define ARENA_IN_REGION ((size_t)-1)
+
+#define ARENA_MAX_BLOCK_SIZE ((size_t)64 * 1024 * 1024)
+
 Arena *arena_create(size_t initial_capacity);
+Arena *arena_create_backed(size_t initial_capacity, ArenaBacking backing);
+
+/*
+ * Lay an arena and its first block out at the start of `region`, `size`
+ * bytes of page-aligned mapped memory that the arena takes over: destroying
+ * it unmaps the region. Everything allocated before the block fills lies
+ * inside the region, so the region can be written out and later mapped back
+ * at the same address as a working arena (core/snapshot.h). Blocks after
+ * the first come from `backing`. NULL where mmap is not available.
+ */
+Arena *arena_create_in(void *region, size_t size, ArenaBacking backing);
 void arena_destroy(Arena *arena);
+/* Keep the current block; the others go to the free list for reuse. */
 void arena_reset(Arena *arena);
 void *arena_alloc(Arena *arena, size_t size);
 void *arena_calloc(Arena *arena, size_t size);
 
+/*
+ * Move every block of `src` into `dst` and free `src`. Allocations made from
+ * `src` stay valid and are released together with `dst`. Used to hand the
+ * private arenas of worker threads back to the owning arena.
+ */
+void arena_merge(Arena *dst, Arena *src);
+
+/*
+ * Make `src` part of `dst` without moving its blocks: `src` stays usable, so
+ * a table a worker built from it can still grow, and it is destroyed
+ * together with `dst`. The byte counts of `dst` include it.
+ */
+void arena_adopt(Arena *dst, Arena *src);
+
+/*
+ * Checkpoints. arena_rewind() releases everything allocated since the
+ * matching arena_mark(); marks must be rewound innermost first, and a mark
+ * is invalidated by arena_reset() or rewinding past it.
+ */
+typedef struct ArenaMark {
+    ArenaBlock *block;       // Current block when the mark was taken
+    size_t used;             // Its fill level at that point
+} ArenaMark;
+
+ArenaMark arena_mark(const Arena *arena);
+void arena_rewind(Arena *arena, ArenaMark mark);
+
+/*
+ * Per-thread scratch arena for temporaries that never outlive the function
+ * that made them (mangling buffers, candidate lists, path pieces, type
+ * prototypes). Pairs nest:
+ *
+ *     ArenaScratch scratch = arena_scratch_begin();
+ *     char *buf = arena_alloc(scratch.arena, len);
+ *     ...
+ *     arena_scratch_end(scratch);
+ *
+ * Nothing that has to survive arena_scratch_end() may be allocated from it.
+ */
+typedef struct ArenaScratch {
+    Arena *arena;
+    ArenaMark mark;
+} ArenaScratch;
+
+ArenaScratch arena_scratch_begin(void);
+void arena_scratch_end(ArenaScratch scratch);
+
+/* Free the calling thread's scratch arena (worker threads, before exiting). */
+void arena_scratch_release(void);
+
 /* Debug / Metrics helpers */
 size_t arena_bytes_used(const Arena *arena);
 size_t arena_bytes_capacity(const Arena *arena);
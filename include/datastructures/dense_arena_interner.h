@@ -4,6 +4,7 @@
 #include "hash_map.h"
 #include "dynamic_array.h"
 #include "utils.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,7 +19,14 @@ extern "C" {
  *  - a HashMap* for fast lookup (keys are pointers into the arena),
  *  - a DynArray* of InternResult* pointers in dense order.
  *
+ * Each key costs one arena record (canonical Slice, InternResult and Entry
+ * together) followed by its copied bytes.
+ *
  * Note: This implementation assumes arena allocations are never individually freed.
+ *
+ * The interner is single-threaded by default. Between
+ * intern_table_begin_concurrent() and intern_table_end_concurrent() intern()
+ * and intern_peek() may be called from several threads (see below).
  */
 typedef struct {
     Arena *arena;
@@ -33,6 +41,9 @@ typedef struct {
     size_t (*hash_func)(void *key);
     /** Comparison function for keys: 0 -> equal, non-zero -> not equal. */
     int (*cmp_func)(void *a, void *b);
+
+    /** Sharded state while in concurrent mode, NULL otherwise. */
+    struct InternConcurrent *concurrent;
 } DenseArenaInterner;
 
 /**
@@ -143,6 +154,34 @@ int  intern_idx(DenseArenaInterner *interner, Slice *slice, void* meta);
 InternResult* intern_peek(DenseArenaInterner *interner, Slice *slice);
 
 
+/* --- Concurrent mode --- */
+
+/**
+ * @brief Switch the interner into concurrent mode.
+ *
+ * New keys go to one of `shard_count` (rounded up to a power of two) shards,
+ * each with its own mutex, hash table and arena. Keys interned before this
+ * call are found without taking any lock, since the base table is frozen
+ * until intern_table_end_concurrent(). Dense indices stay unique and
+ * contiguous but follow insertion order across threads.
+ *
+ * Only intern(), intern_ptr(), intern_idx() and intern_peek() are
+ * thread-safe in this mode. The interner's own arena is not touched, so
+ * several interners sharing one arena may be concurrent at the same time.
+ *
+ * @return true on success (or if already concurrent), false on allocation failure.
+ */
+bool intern_table_begin_concurrent(DenseArenaInterner *interner, size_t shard_count);
+
+/**
+ * @brief Fold the shards back into the base table and leave concurrent mode.
+ *
+ * Must be called once no other thread uses the interner. All InternResult*
+ * handed out stay valid (shard arenas are merged into the interner's arena).
+ */
+void intern_table_end_concurrent(DenseArenaInterner *interner);
+
+
 /* --- Accessors --- */
 
 /**
@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <stdbool.h>
 
 #include "arena.h"
 
@@ -37,3 +38,55 @@ int dynarray_reserve_in_arena(DynArray *da, size_t min_capacity);
 static inline void dynarray_push_ptr(DynArray *da, void *p) {
     dynarray_push_value(da, &p);
 }
+
+/*
+ * Typed inline access for hot loops. The bounds (and, for the typed macros,
+ * the element size) are only checked in DEV_BUILD; release builds compile
+ * these to a plain indexed load or pointer walk. dynarray_get() stays the
+ * checked, NULL-returning accessor.
+ */
+#ifdef DEV_BUILD
+void dynarray_index_fail(const DynArray *da, size_t index, size_t elem_size) __attribute__((noreturn));
+
+static inline void dynarray_check(const DynArray *da, size_t index, size_t elem_size) {
+    if (!da || index >= da->count || elem_size != da->elem_size) dynarray_index_fail(da, index, elem_size);
+}
+#define DYNARRAY_CHECK(da, index, size) dynarray_check((da), (size_t)(index), (size))
+#else
+#define DYNARRAY_CHECK(da, index, size) ((void)0)
+#endif
+
+static inline void *dynarray_at(const DynArray *da, size_t index) {
+    DYNARRAY_CHECK(da, index, da ? da->elem_size : 0);
+    return (char*)da->data + index * da->elem_size;
+}
+
+/* Element `i` of an array of T, as an lvalue: DYNARRAY_AT(AstNode*, decls, i).
+ * `da` and `i` are evaluated twice in DEV_BUILD, so keep them side-effect free. */
+#define DYNARRAY_AT(T, da, i) \
+    (*(DYNARRAY_CHECK((da), (i), sizeof(T)), &((T*)(da)->data)[i]))
+
+static inline void *dynarray_begin(const DynArray *da, size_t elem_size) {
+#ifdef DEV_BUILD
+    if (da && da->count && elem_size != da->elem_size) dynarray_index_fail(da, 0, elem_size);
+#else
+    (void)elem_size;
+#endif
+    return da ? da->data : NULL;
+}
+
+static inline void *dynarray_end(const DynArray *da) {
+    return da && da->data ? (char*)da->data + da->count * da->elem_size : NULL;
+}
+
+/*
+ * Walk an array of T with `it` pointing at each element; a NULL array is
+ * empty. The bounds are read once, so the body must not push to the array.
+ *
+ *     DYNARRAY_FOREACH(AstNode*, it, program->decls) {
+ *         AstNode *decl = *it;
+ *         ...
+ *     }
+ */
+#define DYNARRAY_FOREACH(T, it, da) \
+    for (__typeof__(T) *it = dynarray_begin((da), sizeof(T)), *it##_end = dynarray_end(da); it < it##_end; it++)
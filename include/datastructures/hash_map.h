@@ -2,12 +2,23 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "arena.h"
 #include "core/utils.h"
 
 /* -----------------------------
-   HashMap API (Open Addressing)
-   ----------------------------- */
+   HashMap API (Swiss table)
+   -----------------------------
+
+   Open addressing over a power-of-two slot array plus one control byte per
+   slot: EMPTY, DELETED, or seven bits of the key's hash. Lookups scan a
+   group of 16 control bytes at once (SSE2/NEON, scalar elsewhere) and only
+   call `cmp` on slots whose hash bits match, so a probe rarely touches more
+   than one key. Removal leaves a DELETED marker only when the slot sits in a
+   run of full slots some probe may have passed through; otherwise the slot
+   becomes EMPTY again. */
+
+#define HASHMAP_GROUP_WIDTH 16
 
 typedef struct {
     void *key;
@@ -16,10 +27,12 @@ typedef struct {
 
 typedef struct {
     Arena *arena;          /* If NULL, uses malloc/free */
-    KeyValue *entries;     /* Contiguous array of KeyValue pairs */
-    size_t capacity;       /* Number of slots in entries */
+    KeyValue *entries;     /* capacity slots; only meaningful where ctrl is full */
+    uint8_t *ctrl;         /* capacity + HASHMAP_GROUP_WIDTH control bytes (tail mirrors the head) */
+    size_t capacity;       /* Number of slots, a power of two */
     size_t size;           /* Number of active elements */
-    size_t tombstones;     /* Number of deleted slots */
+    size_t tombstones;     /* Number of DELETED slots */
+    size_t growth_left;    /* EMPTY slots that may still be filled before a rehash */
 } HashMap;
 
 /* Constructor / Destructor */
@@ -58,7 +71,7 @@ bool hashmap_remove(
     void (*free_value)(void*)
 );
 
-/* Resize / Rehash */
+/* Resize / Rehash (rounded up to a power of two that fits the contents) */
 bool hashmap_rehash(
     HashMap* map,
     size_t new_capacity,
@@ -66,6 +79,16 @@ bool hashmap_rehash(
     int (*cmp)(void*, void*)
 );
 
+/*
+ * The same with the caller's hash `h` of `key`, for keys that carry their
+ * hash (interned strings) or callers that probe several maps with one key.
+ * `hash` is still needed by put: a rebuild rehashes the stored keys with it,
+ * so for those keys it can simply read the cached value back.
+ */
+bool hashmap_put_hashed(HashMap *map, void *key, void *value, size_t h,
+                        size_t (*hash)(void*), int (*cmp)(void*, void*));
+void *hashmap_get_hashed(HashMap *map, void *key, size_t h, int (*cmp)(void*, void*));
+
 /* Utility */
 size_t hashmap_size(HashMap* map);
 
@@ -73,3 +96,26 @@ void hashmap_foreach(
     HashMap* map,
     void (*func)(void* key, void* value)
 );
+
+/* Iterate in slot order: start with *cursor = 0; returns false when done. */
+bool hashmap_next(HashMap* map, size_t *cursor, void **key, void **value);
+
+/* -----------------------------
+   Pointer-keyed maps
+   -----------------------------
+
+   Interned names, types, AST nodes and units are compared by identity.
+   These entry points work on any HashMap whose keys use ptr_hash/ptr_cmp
+   (the two families may be mixed on one map) but inline the hash and the
+   compare instead of calling through function pointers. */
+
+bool ptrmap_put(HashMap *map, void *key, void *value);
+void *ptrmap_get(HashMap *map, void *key);
+bool ptrmap_remove(HashMap *map, void *key);
+
+/*
+ * Look up `count` keys at once into `values` (NULL where absent). The home
+ * slots of all keys are prefetched before the first probe, which hides most
+ * of the cache misses of a cold table. Returns the number of keys found.
+ */
+size_t ptrmap_get_many(HashMap *map, void *const *keys, void **values, size_t count);
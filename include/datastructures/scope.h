@@ -6,6 +6,7 @@
 #include "dynamic_array.h"
 #include "dense_arena_interner.h"
 #include "hash_map.h"
+#include "core/source_map.h"
 
 // Forward declarations
 typedef struct Scope Scope;
@@ -48,7 +49,7 @@ typedef struct Symbol {
     InternResult *name_rec; 
     Type *type;
     Span span;
-    const char *filename; // Which module defined this
+    SourceId file;       // Which module defined this
     bool is_pub;         // Visibility
 
     AstNode *decl_node; // AST node that defined this symbol
@@ -73,8 +74,30 @@ typedef struct Symbol {
 
 } Symbol;
 
+/*
+ * Function-local scopes do not own a hash map. Their symbols live in one
+ * flat table per type-check context, indexed by the identifier's dense
+ * index: each slot holds the innermost binding of that name, and each
+ * binding points at the one it shadows. A local scope records the bindings
+ * it made so scope_exit() can pop them again, which makes entering a scope,
+ * leaving it and resolving a local name O(1) regardless of program size.
+ */
+typedef struct ScopeBinding {
+    Symbol *symbol;
+    Scope *scope;                       // Local scope that made the binding
+    struct ScopeBinding *shadowed;      // Next binding of the same name
+    struct ScopeBinding *next_in_scope; // Undo log of `scope`
+    size_t dense_index;
+} ScopeBinding;
+
+typedef struct SymbolTable {
+    ScopeBinding **heads; // Innermost binding per identifier dense index
+    size_t capacity;
+    Arena *arena;
+} SymbolTable;
+
 typedef struct Scope {
-    HashMap *symbols; // Open-addressed hash map for symbols
+    HashMap *symbols; // Open-addressed hash map for symbols (NULL for local scopes)
     DynArray symbols_list; // For efficient iteration
 
     Scope *parent;
@@ -88,6 +111,11 @@ typedef struct Scope {
 
     CompilationUnit *unit;
 
+    // Local scopes only
+    SymbolTable *locals;    // Flat table holding this scope's bindings
+    ScopeBinding *bindings; // Bindings made here, newest first
+    Scope *outer;           // Nearest enclosing scope with its own map
+
 } Scope;
 
 typedef enum {
@@ -98,10 +126,19 @@ typedef enum {
 // Scope management functions
 // kind: 0 for identifiers (default), 1 for keywords (universe primitive types)
 Scope *scope_create(Arena *arena, Scope *parent, int identifier_count, int kind);
+// Allocate the scope's later symbols and table growth from `arena` (a sema
+// worker's while it fills the scope); returns the previous arena
+Arena *scope_set_arena(Scope *scope, Arena *arena);
+
+// Function-local scopes backed by a flat symbol table
+SymbolTable *symbol_table_create(Arena *arena, size_t identifier_count);
+Scope *scope_create_local(SymbolTable *table, Scope *parent);
+void scope_exit(Scope *scope); // Pops the bindings of a local scope
 
 // Symbol management
-Symbol *scope_define_symbol(Scope *scope, InternResult *name, Type *type, SymbolValue kind, const char *filename, bool is_pub, AstNode *decl_node);
-Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, const char *caller_filename);
+Symbol *scope_define_symbol(Scope *scope, InternResult *name, Type *type, SymbolValue kind, SourceId file, bool is_pub, AstNode *decl_node);
+// `caller_file` sees its own module's private symbols; other modules only see `pub` ones
+Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, SourceId caller_file);
 Symbol *scope_lookup_symbol_local(Scope *scope, InternResult *name);
 
 // Overload set helpers
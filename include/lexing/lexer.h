@@ -8,6 +8,7 @@
 #include "dense_arena_interner.h"
 #include "dynamic_array.h"
 #include "token.h"
+#include "core/source_map.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,9 +23,9 @@ typedef struct Lexer {
     /* byte offset into source (0..source_len) */
     size_t pos;
 
-    /* human-facing position for errors (1-based) */
-    size_t line;
-    size_t col;
+    /* Registered source the token spans point into; lines and columns are
+       resolved from it on demand (core/source_map.h) */
+    SourceId file;
 
     /* Arena used for interner allocations and lexer-local allocations */
     Arena *arena;
@@ -44,16 +45,21 @@ typedef struct Lexer {
 
 /* Create a lexer that will operate on `source` (not copied). `arena` is used
  * for lexer allocations and must remain valid for the lifetime of the lexer.
+ * The source is registered as an unnamed file for span resolution.
  * Returns NULL on allocation failure. */
 void lexer_populate_default_keywords(DenseArenaInterner *keywords);
 Lexer* lexer_create(const char *source, size_t source_len, Arena *arena);
 
-/* Create a lexer with existing interners for module systems. */
-Lexer* lexer_create_ex(const char *source, size_t source_len, Arena *arena,
+/* Create a lexer with existing interners for module systems. `file` is the
+ * id `source` was registered under; token spans carry it. */
+Lexer* lexer_create_ex(const char *source, size_t source_len, SourceId file, Arena *arena,
                       DenseArenaInterner *keywords,
                       DenseArenaInterner *identifiers,
                       DenseArenaInterner *strings);
 
+/* Continue lexing at byte `pos` (clamped to the end of the source). */
+void lexer_seek(Lexer *lexer, size_t pos);
+
 /* Destroy lexer and free any heap allocations owned by the lexer.
  * Note: arena_destroy must be called separately if caller created the arena. */
 void lexer_destroy(Lexer *lexer);
@@ -64,6 +70,10 @@ bool lexer_at_end(const Lexer *lexer);
 /* Produce a single token from the lexer (advances internal position). */
 Token lexer_next_token(Lexer *lexer);
 
+/* Lex up to `max` tokens into `out`, stopping after TOK_EOF. Returns how many
+ * were written; streaming consumers call this once per buffer. */
+size_t lexer_next_tokens(Lexer *lexer, Token *out, size_t max);
+
 /* Lex the entire source and append tokens into lexer->tokens.
  * Returns true on success, false on allocation/error. */
 bool lexer_lex_all(Lexer *lexer);
@@ -77,7 +87,7 @@ const char* token_type_to_string(TokenKind type);
 
 void lexer_reset(Lexer *lexer);
 
-void print_token(const Token *tok);
+void print_token(const Lexer *lexer, const Token *tok);
 
 #ifdef __cplusplus
 }
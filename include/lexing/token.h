@@ -24,6 +24,10 @@ typedef enum {
     TOK_IMPORT,
     TOK_ALIAS,
     TOK_DEFER,
+    TOK_SWITCH,
+    TOK_CASE,
+    TOK_ASYNC,
+    TOK_AWAIT,
 
     // types
     TOK_I8,
@@ -100,6 +104,7 @@ typedef enum {
     TOK_ENUM,
     TOK_IMPL,
     TOK_AS,
+    TOK_BAD_INT_LIT,  // integer literal with no digits or past u64
     TOK_UNKNOWN
 
 } TokenKind;
@@ -108,9 +113,28 @@ typedef enum {
 // ------------------------------
 // Token struct
 // ------------------------------
+// 16 bytes. The lexeme is [offset, offset + len) of the lexed buffer; its
+// spelling and span are recovered with token_slice / token_span, which take
+// the buffer and file id the lexer (or parser) carries. Numeric and char
+// literals are decoded by the lexer and carry their value in place of a
+// record, so the parser never re-reads their spelling.
 typedef struct {
-    TokenKind type;   // what kind of token
-    Slice slice;     /**< Non-owning view into the source buffer. Pointer remains valid as long as the source buffer (usually arena-owned) is alive. */
-    Span span;        // position in source for error reporting
-    InternResult *record;
+    uint32_t type : 8;    // TokenKind
+    uint32_t len : 24;    // lexeme length in bytes (TOKEN_MAX_LEN at most)
+    uint32_t offset;      // byte offset of the lexeme in the source
+    union {
+        InternResult *record; // identifiers, keywords and strings
+        uint64_t int_value;   // TOK_INT_LIT; the codepoint of a TOK_CHAR_LIT
+        double float_value;   // TOK_FLOAT_LIT
+    };
 } Token;
+
+#define TOKEN_MAX_LEN ((1u << 24) - 1)
+
+static inline Slice token_slice(const char *source, const Token *tok) {
+    return (Slice){ source + tok->offset, tok->len };
+}
+
+static inline Span token_span(uint32_t file, const Token *tok) {
+    return (Span){ file, tok->offset, tok->offset + tok->len };
+}
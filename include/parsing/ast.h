@@ -4,6 +4,7 @@
 #include "token.h"
 #include "dynamic_array.h"
 #include "utils.h"
+#include "core/source_map.h"
 #include "dense_arena_interner.h"
 #include "arena.h"
 #include "sema/intrinsics.h"
@@ -34,6 +35,8 @@ typedef enum {
     AST_IF_STATEMENT,
     AST_WHILE_STATEMENT,
     AST_FOR_STATEMENT,
+    AST_SWITCH_STATEMENT,
+    AST_SWITCH_CASE,
     AST_RETURN_STATEMENT,
     AST_BREAK_STATEMENT,
     AST_CONTINUE_STATEMENT,
@@ -105,22 +108,54 @@ typedef struct {
     int is_const;            /* boolean: 0 or 1 */
     int is_pub;              /* visibility */
     AstNode *initializer;    /* optional */
+    const char *mangled_name; /* codegen: symbol name of a global, see codegen_decl_name */
 } AstVariableDeclaration;
 
+/* Source annotations of a function: @inline, @noinline, @hot, @cold, @pure, and `async` */
+typedef enum {
+    FN_ATTR_INLINE   = 1 << 0, /* alwaysinline */
+    FN_ATTR_NOINLINE = 1 << 1, /* noinline */
+    FN_ATTR_HOT      = 1 << 2, /* hot */
+    FN_ATTR_COLD     = 1 << 3, /* cold */
+    FN_ATTR_PURE     = 1 << 4, /* no writes the caller can see (checked, see sema/purity.h) */
+    FN_ATTR_ASYNC    = 1 << 5  /* `async fn`: runs in a heap frame and may suspend (docs/lang/async.md) */
+} FunctionAttrs;
+
+/* What a function may do to memory its caller can see, see sema/purity.h */
+typedef enum {
+    FN_MEMORY_ANY = 0,  /* unknown, or writes */
+    FN_MEMORY_READ,     /* readonly */
+    FN_MEMORY_NONE      /* readnone */
+} FunctionMemory;
+
 typedef struct {
     AstNode *return_type;    /* AST_TYPE node, may be NULL */
     InternResult *intern_result;  /* interned record for the function name */
     DynArray *type_params;   /* DynArray<InternResult*>, NULL if not generic */
+    DynArray *const_params;  /* DynArray<AstNode*>: the type of each const parameter, NULL at type parameters; NULL without any */
     AstNode *target_type_node; /* AST_IDENTIFIER node for the struct this method is bound to (Optional) */
     DynArray *params;        /* AstParam nodes */
-    AstNode *body;           /* AstBlock, may be NULL for @link */
+    AstNode *body;           /* AstBlock, may be NULL for @link or while deferred */
     InternResult *link_name; /* Optional: for @link("name") */
     int is_pub;              /* visibility */
+    uint8_t attrs;           /* FunctionAttrs */
+    uint8_t memory;          /* FunctionMemory, inferred after pass 2 */
+    /* Set when the body was skimmed: [body_start, body_end) is its `{...}`
+       in lazy_body->source, parsed on demand by parse_deferred_body */
+    const struct LazyBodySource *lazy_body;
+    uint32_t body_start, body_end;
+    /* A deferred generic template and its instances: the body parsed once
+       for all of them; an instance's `body` is its root, valid with
+       `body_patch` bound (see parsing/template_body.h) */
+    struct TemplateBody *template_body;
+    const struct BodyPatch *body_patch;
+    const char *mangled_name; /* codegen: symbol name, see codegen_decl_name */
 } AstFunctionDeclaration;
 
 typedef struct {
     int name_idx;            /* interned dense index for the parameter name; -1 for anonymous */
     AstNode *type;           /* AST_TYPE node */
+    bool is_noalias;         /* @noalias: the pointee is reached through no other pointer in the call */
 } AstParam;
 
 typedef struct {
@@ -149,12 +184,23 @@ typedef struct {
     AstNode *target;            /* Expression being aliased (Identifier or MemberExpr) */
 } AstAliasDeclaration;
 
+/* Layout annotations of a struct: @packed, @reorder (and @align(N)), see sema/type_layout.h */
+typedef enum {
+    STRUCT_ATTR_PACKED  = 1 << 0, /* no padding between fields, alignment 1 */
+    STRUCT_ATTR_REORDER = 1 << 1  /* fields placed by decreasing alignment */
+} StructAttrs;
+
+#define STRUCT_MAX_ALIGN 4096 // Upper bound on N in @align(N)
+
 typedef struct {
     InternResult *intern_result; // Struct name
     DynArray *type_params;       // DynArray<InternResult*>, NULL if not generic
+    DynArray *const_params;      // DynArray<AstNode*>: type of each const parameter (N: usize), NULL at type parameters; NULL without any
     DynArray *fields;            // Contains AstFieldDecl*
     DynArray *methods;           // Contains AstNode* (AstFunctionDeclaration methods)
     int is_pub;                  // visibility
+    uint8_t attrs;               // StructAttrs
+    uint32_t align;              // @align(N), 0 without one
 } AstStructDeclaration;
 
 typedef struct {
@@ -184,18 +230,42 @@ typedef struct {
     AstNode *else_branch; /* may be NULL */
 } AstIfStatement;
 
+#define LOOP_HINT_MAX 1024 // Upper bound on N in @unroll(N) and @vectorize(N)
+
+/* @unroll(N), @nounroll and @vectorize(W) in front of a loop; lowered to llvm.loop metadata */
+typedef struct {
+    uint32_t unroll;     /* @unroll(N), 0 without one */
+    uint32_t vectorize;  /* @vectorize(W), 0 without one */
+    bool nounroll;       /* @nounroll */
+} LoopHints;
+
 typedef struct {
     AstNode *condition;
     AstNode *body;
+    LoopHints hints;
 } AstWhileStatement;
 
 typedef struct {
-    AstNode *init;       /* may be NULL */
+    AstNode *init;       /* may be NULL; the untyped loop variable of a range loop */
     AstNode *condition;  /* may be NULL */
     AstNode *post;       /* may be NULL */
+    AstNode *range;      /* for (x in range): an array or slice, NULL for the C form */
     AstNode *body;
+    LoopHints hints;
 } AstForStatement;
 
+/* switch subject { case A, B: ... else: ... }; an arm never falls through */
+typedef struct {
+    AstNode *subject;
+    DynArray *cases;     /* contains AstNode* (AST_SWITCH_CASE) */
+    AstNode *else_body;  /* AST_BLOCK, may be NULL */
+} AstSwitchStatement;
+
+typedef struct {
+    DynArray *values;    /* contains AstNode*, constant expressions */
+    AstNode *body;       /* AST_BLOCK of the statements up to the next arm */
+} AstSwitchCase;
+
 typedef struct {
     AstNode *expression;
 } AstReturnStatement;
@@ -249,7 +319,8 @@ typedef enum {
     AST_TYPE_PTR,    // pointer to inner type
     AST_TYPE_ARRAY,  // array of inner type with optional size expression
     AST_TYPE_FUNC,   // function type: params list + return type
-    AST_TYPE_APPLICATION // type with type arguments (e.g. Vec[i32])
+    AST_TYPE_APPLICATION, // type with type arguments (e.g. Vec[i32])
+    AST_TYPE_VECTOR  // vec<T, N>: reuses the array payload, size_expr is the lane count
 } AstTypeKind;
 
 typedef struct AstType {
@@ -287,16 +358,25 @@ typedef struct {
 
 typedef enum {
     AST_FLAG_NONE = 0,
-    AST_FLAG_CHECKED = 1 << 0
+    AST_FLAG_CHECKED = 1 << 0,
+    AST_FLAG_PRUNED = 1 << 1, // Library function unreachable from the program (sema/reachability.h)
+    AST_FLAG_REUSED = 1 << 2, // Body unchanged since a cached build (sema/decl_deps.h)
+    AST_FLAG_USES_INSTANCES = 1 << 3, // Checking the body used generic instances
+    AST_FLAG_SELF_TAIL_CALL = 1 << 4, // The body has a `return @tail(...)` calling its own function
+    AST_FLAG_ASYNC_CALL = 1 << 5 // Call of an async fn as the operand of `await` or @spawn
 } AstFlags;
 
+/*
+ * A node is a fixed header followed by the payload of its kind. Nodes are
+ * allocated only as large as that payload (see ast_node_size), so `data` must
+ * stay the last member and only the member matching node_type may be touched.
+ */
 struct AstNode {
     AstNodeType node_type;
-    Span span;
-    const char *filename; // Originating module
+    Span span;   // span.file is the originating module, even for synthesized nodes
     Type *type;  // semantic type information
-    int flags; // AstFlags
     int last_checked_pass; // For multi-pass tracking
+    uint16_t flags; // AstFlags
 
     /* constant folding / evaluation helper: inline value to avoid small allocations */
     uint8_t is_foldable_const;  /* safe for constant folding (primitives only) */
@@ -321,6 +401,8 @@ struct AstNode {
         AstIfStatement if_statement;
         AstWhileStatement while_statement;
         AstForStatement for_statement;
+        AstSwitchStatement switch_statement;
+        AstSwitchCase switch_case;
         AstReturnStatement return_statement;
         AstDeferStatement defer_statement;
         AstBreakStatement break_statement;
@@ -349,9 +431,20 @@ struct AstNode {
 /* ----------------------- Helpers & prototypes ----------------------- */
 
 /* AST helper prototypes (implementations are up to you) */
-AstNode *ast_create_node(AstNodeType type, Arena *arena, const char *filename);
+AstNode *ast_create_node(AstNodeType type, Arena *arena, SourceId file);
+/* Bytes allocated for a node of `type`: the header plus that kind's payload,
+ * never less than a cast or literal so sema can rewrite any node in place. */
+size_t ast_node_size(AstNodeType type);
+/* Display name of a node type ("CallExpression"), "Unknown" if out of range. */
+const char *ast_node_type_name(AstNodeType type);
 void print_ast(AstNode *node, int depth, DenseArenaInterner *keywords, DenseArenaInterner *identifiers, DenseArenaInterner *strings);
 void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInterner *keywords, DenseArenaInterner *identifiers, DenseArenaInterner *strings);
 int is_lvalue_node(AstNode *node);
 int is_assignment_op(TokenKind type);
 AstNode *ast_clone_node(AstNode *node, Arena *arena);
+
+/* Called with every name `node` mentions: identifiers, member names and the
+ * names in type expressions. Function bodies that are still deferred are
+ * not visited; NULL names may be passed. */
+typedef void (*AstNameVisitor)(InternResult *name, void *user);
+void ast_visit_names(AstNode *node, AstNameVisitor visit, void *user);
@@ -14,3 +14,8 @@ AstNode *parse_declaration_stmt(Parser *p, ParseError *err);
 AstNode *parse_variable_declaration(Parser *p, ParseError *err);
 AstNode *parse_function_declaration(Parser *p, ParseError *err);
 int parse_parameter_list(Parser *p, AstNode *func_decl, ParseError *err);
+
+/* Parse the body that was skimmed for `func_decl` into `arena` (the caller
+ * stores it). Returns the block, or NULL with `*err_msg`/`*err_span` set on a
+ * syntax error. Tokens only live for the call. */
+AstNode *parse_deferred_body(const AstNode *func_decl, Arena *arena, const char **err_msg, Span *err_span);
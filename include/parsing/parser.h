@@ -1,19 +1,69 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include "token.h"
+#include "core/source_map.h"
 #include "dynamic_array.h"
 #include "arena.h"
 
 #include "ast.h"
 
+struct Lexer;
+
+/* Streamed tokens live in chunks of TOKEN_CHUNK_SIZE, so a Token* stays put
+   until its chunk is recycled and index -> slot is a shift and a mask. */
+#define TOKEN_CHUNK_SHIFT 9
+#define TOKEN_CHUNK_SIZE ((size_t)1 << TOKEN_CHUNK_SHIFT)
+#define TOKEN_CHUNK_MASK (TOKEN_CHUNK_SIZE - 1)
+
+typedef struct TokenChunk {
+    struct TokenChunk *next_free;
+    Token tokens[TOKEN_CHUNK_SIZE];
+} TokenChunk;
+
+/* Where a module's skipped function bodies can be parsed from later: the
+ * registered source and the interners its tokens were lexed with. One per
+ * parse, shared by every deferred body in it (see parser_defer_bodies). */
+typedef struct LazyBodySource {
+    const char         *source;
+    size_t              len;
+    SourceId            file;
+    char               *filename;
+    DenseArenaInterner *keywords;
+    DenseArenaInterner *identifiers;
+    DenseArenaInterner *strings;
+} LazyBodySource;
+
 /* Parser structure */
 typedef struct {
-    DynArray   *tokens;   /* borrowed: DynArray of Token (Tokens stored in tokens.data) */
-    size_t      current;  /* next token index to consume (0..tokens.count) */
-    size_t      end;      /* tokens.count (one-past-last) */
+    Token      *flat;     /* borrowed: the lexer's token array; NULL when streaming */
+    size_t      current;  /* next token index to consume (0..end) */
+    size_t      end;      /* one-past-last token; SIZE_MAX while streaming has not reached EOF */
+    const char *source;   /* buffer token offsets point into */
+    SourceId    file;     /* file id for token spans */
     char       *filename; /* pointer to filename string in arena */
     Arena      *arena;    /* arena that owns parser/filename/messages */
+
+    /* Tokens [window_base, lexed) are in memory: all of them for a flat
+       array; while streaming, the ones pulled from `lexer` into `window`
+       and not yet recycled between top-level declarations. */
+    size_t        window_base; /* index of window[0]'s first token */
+    size_t        lexed;       /* tokens pulled so far */
+    struct Lexer *lexer;       /* NULL when parsing a flat array */
+    TokenChunk  **window;
+    size_t        window_len;
+    size_t        window_cap;
+    TokenChunk   *free_chunks;
+    int           stream_failed; /* out of memory while pulling a token */
+
+    Arena        *token_arena; /* chunks and window: the lexer's arena when streaming (validate_block swaps `arena`) */
+
+    /* Non-NULL: bodies are deferred (parse_deferred_body), all of them or
+       only those of generic templates */
+    const LazyBodySource *lazy_bodies;
+    bool          defer_all_bodies;
+    bool          in_generic_impl; /* parsing the methods of an `impl<T>` */
 } Parser;
 
 
@@ -26,19 +76,81 @@ typedef struct {
 
 
 
-/* Create parser allocated inside the given arena; the arena owns the parser and filename. */
-Parser *parser_create(DynArray *tokens, char *filename, Arena *arena); /* filename is already in arena */
+/* Create a parser over `lexer`'s already lexed token array, allocated inside
+ * the given arena; the arena owns the parser and filename. */
+Parser *parser_create(struct Lexer *lexer, char *filename, Arena *arena); /* filename is already in arena */
+
+/* Create a parser that lexes as it goes: tokens are pulled from `lexer` when
+ * the parser first looks at them, so the whole token array never exists.
+ * `lexer->tokens` stays empty. */
+Parser *parser_create_streaming(struct Lexer *lexer, char *filename, Arena *arena);
 
 void parser_free(Parser *parser); /* free parser resources */
 
-/* Basic token access */
-Token   *current_token(Parser *p);            /* token at p->current or NULL if at end */
-Token   *peek(Parser *p, size_t offset);     /* token at current+offset or NULL if OOB */
+/* Defer function bodies from here on: only the byte range of each `{...}` is
+ * recorded, and parse_deferred_body parses it when it is first needed. With
+ * `all` every body is skimmed unchecked; otherwise only generic templates
+ * are deferred, and their bodies are still parsed once into scratch memory
+ * so syntax errors surface now. `lexer` is the one feeding `p`. Returns
+ * false on allocation failure. */
+bool parser_defer_bodies(Parser *p, const struct Lexer *lexer, bool all);
+
+/* Slow path of parser_token_at: lex more (streaming) or NULL */
+Token   *parser_token_fetch(Parser *p, size_t index);
+
+/* Streaming mode: recycle the chunks behind the previous token. Only safe
+ * where no Token* from earlier is still held (between top-level
+ * declarations); a no-op for a flat array. */
+void     parser_release_consumed(Parser *p);
+
+/* Basic token access. The parser asks for the current token on nearly every
+ * decision, so the in-memory case is one range check here. */
+
+/* token at absolute index, NULL if OOB or already recycled */
+static inline Token *parser_token_at(Parser *p, size_t index) {
+    size_t slot = index - p->window_base;
+    if (slot < p->lexed - p->window_base) {
+        if (p->flat) return &p->flat[index];
+        return &p->window[slot >> TOKEN_CHUNK_SHIFT]->tokens[slot & TOKEN_CHUNK_MASK];
+    }
+    return parser_token_fetch(p, index);
+}
+
+/* token at p->current or NULL if at end */
+static inline Token *current_token(Parser *p) {
+    return parser_token_at(p, p->current);
+}
+
+/* token at current+offset or NULL if OOB */
+static inline Token *peek(Parser *p, size_t offset) {
+    return parser_token_at(p, p->current + offset);
+}
 
 /* Advance and consume helpers */
-Token   *parser_advance(Parser *p);                       /* consume and return token previously current, or NULL */
-Token   *consume(Parser *p, TokenKind expected);          /* consume when exact type expected, else NULL */
-int      parser_match(Parser *p, TokenKind expected);    /* if current==expected, advance and return 1 */
+
+/* consume and return token previously current, or NULL */
+static inline Token *parser_advance(Parser *p) {
+    Token *tok = current_token(p);
+    if (tok) p->current++;
+    return tok;
+}
+
+/* consume when exact type expected, else NULL */
+static inline Token *consume(Parser *p, TokenKind expected) {
+    Token *tok = current_token(p);
+    if (!tok || tok->type != expected) return NULL;
+    p->current++;
+    return tok;
+}
+
+/* if current==expected, advance and return 1 */
+static inline int parser_match(Parser *p, TokenKind expected) {
+    return consume(p, expected) != NULL;
+}
+
+/* Spelling and source span of a token */
+static inline Slice tok_slice(const Parser *p, const Token *tok) { return token_slice(p->source, tok); }
+static inline Span tok_span(const Parser *p, const Token *tok) { return token_span(p->file, tok); }
 
 /* utility: create parse error message. This will allocate message in parser->arena */
 void     create_parse_error(ParseError *err_out, Parser *p, const char *message, Token *token);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "utils.h"
+
+/*
+ * The body of a generic template, parsed once and shared by every instance.
+ *
+ * Sema annotates and rewrites a body in place (types, resolved symbols,
+ * inserted casts, folded literals), so the instances cannot all keep their
+ * annotations in the one tree at the same time. Instead, checking an
+ * instance records the bytes it changed as a BodyPatch, and the tree goes
+ * back to how it was parsed. Whoever reads that instance's body later
+ * (codegen) binds its patch first and unbinds when it is done:
+ *
+ *     if (template_body_bind(tb, decl->body_patch)) {
+ *         ... walk decl->body ...
+ *         template_body_unbind(tb);
+ *     }
+ *
+ * The tree lives alone in its own arena. The patches describe that arena's
+ * blocks as they were right after the parse. Anything a check allocates
+ * there later (a grown argument list) stays valid and is reached through
+ * the patch. One patch is bound at a time: the lock is held from bind to
+ * unbind, so another thread waits for it, and the thread holding it cannot
+ * bind it again (a check of one instance that instantiates another).
+ */
+
+/* The bytes one instance's check changed in its template's body. */
+typedef struct BodyPatch BodyPatch;
+
+typedef struct {
+    ArenaBlock *block;
+    size_t used;       // Bytes of the block the parse filled
+    char *parsed;      // Copy of them
+} TemplateBlock;
+
+typedef struct TemplateBody {
+    Arena *arena;              // Only the body is allocated from it
+    struct AstNode *root;      // NULL until parsed
+    TemplateBlock *blocks;
+    size_t block_count;
+    bool held;
+    pthread_mutex_t lock;      // Recursive, so the holder can find it held
+} TemplateBody;
+
+/* An unparsed body; it and its arena are released with `owner`. */
+TemplateBody *template_body_create(Arena *owner);
+
+/*
+ * Hold `tb` with `patch` applied (NULL: the tree as parsed). Returns false,
+ * without waiting, when this thread already holds it.
+ */
+bool template_body_bind(TemplateBody *tb, const BodyPatch *patch);
+
+/* Put the tree back as parsed and release it. */
+void template_body_unbind(TemplateBody *tb);
+
+/*
+ * Parse the body of `func_decl` into `tb` once; later calls return the same
+ * tree. Must be held unpatched. NULL with `*err_msg`/`*err_span` set on a
+ * syntax error, as parse_deferred_body.
+ */
+struct AstNode *template_body_parse(TemplateBody *tb, const struct AstNode *func_decl, const char **err_msg, Span *err_span);
+
+/*
+ * What was changed in the tree since it was bound unpatched, allocated from
+ * `arena`. The tree is left as it is until the unbind.
+ */
+const BodyPatch *template_body_capture(TemplateBody *tb, Arena *arena);
+
+/* Bytes a patch takes, for --mem-report and tests. */
+size_t body_patch_size(const BodyPatch *patch);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "sema/typecheck.h"
+
+/*
+ * Compile-time evaluation of global initializers (sema pass 3).
+ *
+ * Runs once the bodies are checked and only when they are error-free. A
+ * global whose initializer codegen cannot emit as an LLVM constant (a call,
+ * a read of another global, anything beyond the folds of pass 2) is
+ * interpreted over the checked AST instead: calls into functions with
+ * bodies, locals, loops, `defer`, arrays, structs and pointers to locals
+ * all work, with the same integer widths and signed arithmetic as the code
+ * codegen would have emitted.
+ *
+ * The result replaces the initializer with nodes codegen emits as a
+ * constant: literals, initializer lists, struct literals, function names
+ * and `&global`. A scalar `const` also gets its value on the symbol.
+ *
+ * Initializers that print, allocate, call external functions, write to
+ * globals, divide by zero, index out of bounds or exceed the step, depth
+ * or memory limits are reported as TE_CONST_EVAL. A value whose pointers
+ * cannot be written back as nodes (into the middle of a global, say)
+ * keeps its initializer as it was.
+ */
+void const_eval_program(TypeCheckContext *ctx);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "sema/typecheck.h"
+
+/*
+ * Declaration dependency graph for incremental rebuilds (--incremental,
+ * runs before pass 2).
+ *
+ * Every function and non-generic impl method of the program's own modules
+ * gets a key over what checking and compiling its body reads: its own
+ * source text and its module's imports, plus, for every declaration one of
+ * its names can refer to, that declaration's interface. The interface of a
+ * function is its signature, of a struct, enum or alias its whole
+ * declaration, of a global its declaration and everything its initializer
+ * can reach at compile time; the types those mention follow recursively.
+ * Names are matched across all loaded modules, so the graph over-
+ * approximates but can never miss an edge: editing a body only changes that
+ * body's key, editing a signature or a type changes the keys of the bodies
+ * that can see it.
+ *
+ * Each key names an object in the cache directory. When it is there, the
+ * body was checked and compiled without errors by an earlier run with the
+ * same inputs: the function is marked AST_FLAG_REUSED, pass 2 skips it and
+ * codegen only declares it. Otherwise the object path is recorded in the
+ * unit's `body_objects` and codegen_use_cached_bodies writes it after this
+ * run. Bodies that use generic instances, and functions a global
+ * initializer calls (pass 3 interprets their checked bodies), are always
+ * checked.
+ *
+ * Only active with --incremental and --cache-dir when an executable is
+ * built (not with --run or --ir).
+ */
+void decl_deps_program(TypeCheckContext *ctx);
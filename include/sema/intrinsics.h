@@ -1,6 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 typedef enum {
     INTRINSIC_NONE = 0,
@@ -8,5 +10,185 @@ typedef enum {
     INTRINSIC_PRINT_NEWLINE,
     INTRINSIC_ALLOC,
     INTRINSIC_FREE,
+    // Vector operations on vec<T, N>
+    INTRINSIC_SPLAT,      // @splat(V, x)
+    INTRINSIC_LOAD,       // @load(V, src, i): N lanes from src[i..]
+    INTRINSIC_STORE,      // @store(dst, i, v)
+    INTRINSIC_SHUFFLE,    // @shuffle(a, [b,] {indices...})
+    INTRINSIC_SELECT,     // @select(mask, a, b)
+    INTRINSIC_REDUCE_ADD,
+    INTRINSIC_REDUCE_MUL,
+    INTRINSIC_REDUCE_MIN,
+    INTRINSIC_REDUCE_MAX,
+    INTRINSIC_ANY,        // @any(mask)
+    INTRINSIC_ALL,        // @all(mask)
+    // Atomic memory operations; orderings are written as bare names (see AtomicOrder)
+    INTRINSIC_ATOMIC_LOAD,  // @atomic_load(p, order)
+    INTRINSIC_ATOMIC_STORE, // @atomic_store(p, v, order)
+    INTRINSIC_ATOMIC_CAS,   // @atomic_cas(p, expected, desired, order[, failure_order]): old value
+    INTRINSIC_ATOMIC_RMW,   // @atomic_rmw(op, p, v, order): old value
+    INTRINSIC_FENCE,        // @fence(order)
+    // Bulk memory on T[N], T[] or *T, counted in elements of T
+    INTRINSIC_MEMCPY,       // @memcpy(dst, src, count): the ranges must not overlap
+    INTRINSIC_MEMMOVE,      // @memmove(dst, src, count)
+    INTRINSIC_MEMSET,       // @memset(dst, byte, count)
+    // Optimizer hints: they never change what a correct program does
+    INTRINSIC_LIKELY,       // @likely(cond): cond, expected true
+    INTRINSIC_UNLIKELY,     // @unlikely(cond): cond, expected false
+    INTRINSIC_ASSUME,       // @assume(cond): cond holds; undefined behaviour if it does not
+    INTRINSIC_PREFETCH,     // @prefetch(mem, read|write, locality 0-3)
+    INTRINSIC_UNREACHABLE,  // @unreachable(): control never gets here
+    INTRINSIC_TAIL,         // return @tail(f(args)): the call reuses the caller's frame
+    // Math on a float or vec<float, N>, at its own width: @sqrt(x), @pow(x, y), @fma(a, b, c)
+    INTRINSIC_SQRT,
+    INTRINSIC_FLOOR,
+    INTRINSIC_CEIL,
+    INTRINSIC_TRUNC,
+    INTRINSIC_ROUND,        // Halfway cases away from zero
+    INTRINSIC_SIN,
+    INTRINSIC_COS,
+    INTRINSIC_EXP,
+    INTRINSIC_EXP2,
+    INTRINSIC_LOG,
+    INTRINSIC_LOG2,
+    INTRINSIC_LOG10,
+    INTRINSIC_ABS,          // Also integers, as are @min and @max
+    INTRINSIC_MIN,          // On floats, a NaN operand yields the other one
+    INTRINSIC_MAX,
+    INTRINSIC_COPYSIGN,     // @copysign(mag, sign)
+    INTRINSIC_POW,
+    INTRINSIC_FMA,          // @fma(a, b, c): a * b + c, rounded once
+    // Frames of async functions, see docs/lang/async.md
+    INTRINSIC_AWAIT,        // await f(args): written as a keyword, only inside an async fn
+    INTRINSIC_SPAWN,        // @spawn(allocator, f(args)): allocate f's frame, run it to its first suspension
+    INTRINSIC_SUSPEND,      // @suspend(): return to whoever resumed the current frame
+    INTRINSIC_FRAME,        // @frame(): the current async fn's frame, as *void
+    INTRINSIC_RESUME,       // @resume(frame): run it to its next suspension, then any awaiting frames
+    INTRINSIC_DONE,         // @done(frame): its function has returned
+    INTRINSIC_DESTROY,      // @destroy(frame): free it through the allocator it was spawned with
     INTRINSIC_UNKNOWN
-} IntrinsicKind;
\ No newline at end of file
+} IntrinsicKind;
+
+/* Name after the '@' of the intrinsics written as `@name(...)`, NULL for the others. */
+static inline const char *intrinsic_name(IntrinsicKind kind) {
+    switch (kind) {
+        case INTRINSIC_ALLOC:      return "alloc";
+        case INTRINSIC_FREE:       return "free";
+        case INTRINSIC_SPLAT:      return "splat";
+        case INTRINSIC_LOAD:       return "load";
+        case INTRINSIC_STORE:      return "store";
+        case INTRINSIC_SHUFFLE:    return "shuffle";
+        case INTRINSIC_SELECT:     return "select";
+        case INTRINSIC_REDUCE_ADD: return "reduce_add";
+        case INTRINSIC_REDUCE_MUL: return "reduce_mul";
+        case INTRINSIC_REDUCE_MIN: return "reduce_min";
+        case INTRINSIC_REDUCE_MAX: return "reduce_max";
+        case INTRINSIC_ANY:        return "any";
+        case INTRINSIC_ALL:        return "all";
+        case INTRINSIC_ATOMIC_LOAD:  return "atomic_load";
+        case INTRINSIC_ATOMIC_STORE: return "atomic_store";
+        case INTRINSIC_ATOMIC_CAS:   return "atomic_cas";
+        case INTRINSIC_ATOMIC_RMW:   return "atomic_rmw";
+        case INTRINSIC_FENCE:        return "fence";
+        case INTRINSIC_MEMCPY:       return "memcpy";
+        case INTRINSIC_MEMMOVE:      return "memmove";
+        case INTRINSIC_MEMSET:       return "memset";
+        case INTRINSIC_LIKELY:       return "likely";
+        case INTRINSIC_UNLIKELY:     return "unlikely";
+        case INTRINSIC_ASSUME:       return "assume";
+        case INTRINSIC_PREFETCH:     return "prefetch";
+        case INTRINSIC_UNREACHABLE:  return "unreachable";
+        case INTRINSIC_TAIL:         return "tail";
+        case INTRINSIC_SQRT:         return "sqrt";
+        case INTRINSIC_FLOOR:        return "floor";
+        case INTRINSIC_CEIL:         return "ceil";
+        case INTRINSIC_TRUNC:        return "trunc";
+        case INTRINSIC_ROUND:        return "round";
+        case INTRINSIC_SIN:          return "sin";
+        case INTRINSIC_COS:          return "cos";
+        case INTRINSIC_EXP:          return "exp";
+        case INTRINSIC_EXP2:         return "exp2";
+        case INTRINSIC_LOG:          return "log";
+        case INTRINSIC_LOG2:         return "log2";
+        case INTRINSIC_LOG10:        return "log10";
+        case INTRINSIC_ABS:          return "abs";
+        case INTRINSIC_MIN:          return "min";
+        case INTRINSIC_MAX:          return "max";
+        case INTRINSIC_COPYSIGN:     return "copysign";
+        case INTRINSIC_POW:          return "pow";
+        case INTRINSIC_FMA:          return "fma";
+        case INTRINSIC_SPAWN:        return "spawn";
+        case INTRINSIC_SUSPEND:      return "suspend";
+        case INTRINSIC_FRAME:        return "frame";
+        case INTRINSIC_RESUME:       return "resume";
+        case INTRINSIC_DONE:         return "done";
+        case INTRINSIC_DESTROY:      return "destroy";
+        default:                   return NULL;
+    }
+}
+
+/* Memory orderings of the atomic intrinsics, weakest first (C11 names; relaxed is LLVM's monotonic). */
+typedef enum {
+    ATOMIC_RELAXED,
+    ATOMIC_ACQUIRE,
+    ATOMIC_RELEASE,
+    ATOMIC_ACQ_REL,
+    ATOMIC_SEQ_CST,
+    ATOMIC_ORDER_INVALID
+} AtomicOrder;
+
+/* The read-modify-write operations of @atomic_rmw. */
+typedef enum {
+    ATOMIC_RMW_XCHG,
+    ATOMIC_RMW_ADD,
+    ATOMIC_RMW_SUB,
+    ATOMIC_RMW_AND,
+    ATOMIC_RMW_OR,
+    ATOMIC_RMW_XOR,
+    ATOMIC_RMW_MIN,
+    ATOMIC_RMW_MAX,
+    ATOMIC_RMW_INVALID
+} AtomicRmwOp;
+
+static inline bool intrinsic_is_atomic(IntrinsicKind kind) {
+    return kind >= INTRINSIC_ATOMIC_LOAD && kind <= INTRINSIC_FENCE;
+}
+
+static inline bool intrinsic_is_bulk_memory(IntrinsicKind kind) {
+    return kind >= INTRINSIC_MEMCPY && kind <= INTRINSIC_MEMSET;
+}
+
+static inline bool intrinsic_is_hint(IntrinsicKind kind) {
+    return kind >= INTRINSIC_LIKELY && kind <= INTRINSIC_UNREACHABLE;
+}
+
+static inline bool intrinsic_is_math(IntrinsicKind kind) {
+    return kind >= INTRINSIC_SQRT && kind <= INTRINSIC_FMA;
+}
+
+static inline bool intrinsic_is_async(IntrinsicKind kind) {
+    return kind >= INTRINSIC_AWAIT && kind <= INTRINSIC_DESTROY;
+}
+
+/* Operands of a math intrinsic: all of one type. */
+static inline size_t intrinsic_math_arity(IntrinsicKind kind) {
+    if (kind == INTRINSIC_FMA) return 3;
+    return kind >= INTRINSIC_MIN ? 2 : 1;
+}
+
+static inline int intrinsic_lookup_name(const char *const *names, int count, const char *name, size_t len) {
+    for (int i = 0; i < count; i++) {
+        if (strlen(names[i]) == len && memcmp(names[i], name, len) == 0) return i;
+    }
+    return count;
+}
+
+static inline AtomicOrder atomic_order_named(const char *name, size_t len) {
+    static const char *const names[] = { "relaxed", "acquire", "release", "acq_rel", "seq_cst" };
+    return (AtomicOrder)intrinsic_lookup_name(names, ATOMIC_ORDER_INVALID, name, len);
+}
+
+static inline AtomicRmwOp atomic_rmw_op_named(const char *name, size_t len) {
+    static const char *const names[] = { "xchg", "add", "sub", "and", "or", "xor", "min", "max" };
+    return (AtomicRmwOp)intrinsic_lookup_name(names, ATOMIC_RMW_INVALID, name, len);
+}
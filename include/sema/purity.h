@@ -0,0 +1,27 @@
+#pragma once
+
+#include "sema/typecheck.h"
+
+/*
+ * Memory effects of functions (runs after pass 2, when it found no errors).
+ *
+ * Every checked, non-generic function or impl method gets a FunctionMemory:
+ * FN_MEMORY_NONE when its body only touches its own locals and parameters,
+ * FN_MEMORY_READ when it also reads globals or through pointers, and
+ * FN_MEMORY_ANY when it writes either of those, prints, allocates, or calls
+ * a function pointer or anything that is not known to be as well behaved.
+ * Calls take the callee's effects, so the result is computed as a fixed
+ * point, starting from FN_MEMORY_NONE everywhere (recursion stays pure).
+ * Functions without a checked body only get FN_MEMORY_READ from @pure.
+ *
+ * A @pure function whose body comes out FN_MEMORY_ANY is reported as
+ * TE_NOT_PURE. Codegen lowers the result to `readnone`/`readonly`.
+ *
+ * With --incremental a reused body may have been compiled against other
+ * callee effects, so only @pure (part of the signature) is trusted there.
+ */
+void purity_program(TypeCheckContext *ctx);
+
+
+/* The function declaration a call through `callee` runs, when it is known. */
+AstNode *purity_callee_decl(AstNode *callee);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "sema/typecheck.h"
+
+/*
+ * Whole-program reachability of library functions (runs before pass 2).
+ *
+ * The program's own modules, every global initializer and every generic
+ * template are roots; their bodies are scanned for identifiers and member
+ * names, and any non-generic function or impl method of a std module with
+ * one of those names becomes live and is scanned in turn. The walk is by
+ * name, so it over-approximates: all overloads of a name and every method
+ * of that name on any library type stay live.
+ *
+ * What is left is marked AST_FLAG_PRUNED: pass 2 does not check it, codegen
+ * emits neither its prototype nor its body, and a deferred body is never
+ * parsed. Nothing is pruned with --check-all, with --cache-dir (prebuilt std
+ * objects hold every function) or in modules the --serve daemon keeps
+ * resident, which are checked once for all requests.
+ */
+void reachability_prune_program(TypeCheckContext *ctx);
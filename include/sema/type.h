@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define VECTOR_MAX_LANES 1024 // Upper bound on N in vec<T, N>
+
 typedef struct Type Type;
 typedef struct Symbol Symbol; // Forward declaration for structs/typedefs
 typedef struct Scope Scope;   // Forward declaration for intrinsics
@@ -18,7 +20,9 @@ typedef enum {
     TYPE_STRUCT,      // User defined
     TYPE_ENUM,        // User defined (not yet implemented)
     TYPE_TYPEVAR,     // Abstract type variable: T (used in generic templates)
-    TYPE_GENERIC_INST // Concrete generic instantiation: Vec[i32]
+    TYPE_GENERIC_INST, // Concrete generic instantiation: Vec[i32]
+    TYPE_VECTOR,      // SIMD vector: vec<f32, 8>
+    TYPE_CONST_ARG    // Value of a const generic parameter: the 4 in Buf<i32, 4>
 } TypeKind;
 
 typedef enum {
@@ -34,9 +38,16 @@ typedef enum {
 typedef struct {
     InternResult *name;
     Type *type; 
-    int32_t offset;
+    int64_t offset; // Byte offset, once the struct is laid out (sema/type_layout.h)
 } StructField;
 
+typedef enum {
+    STRUCT_LAYOUT_PENDING = 0, // Not computed yet
+    STRUCT_LAYOUT_BUSY,        // Being computed: the struct contains itself
+    STRUCT_LAYOUT_NATURAL,     // Declaration order at natural alignment, as LLVM lays it out
+    STRUCT_LAYOUT_EXPLICIT     // Packed, over-aligned or reordered: codegen places each field
+} StructLayout;
+
 typedef struct {
     InternResult *name;
     int64_t value;
@@ -44,7 +55,7 @@ typedef struct {
 
 struct Type {
     TypeKind kind;
-    uint64_t cached_hash; // Stored hash for memoization
+    uint64_t cached_hash; // Interned types: hash of own fields and child addresses
 
     union {
         // TYPE_PRIMITIVE
@@ -66,6 +77,12 @@ struct Type {
             Type *base;
         } slice;
 
+        // TYPE_VECTOR: lanes of an integer, float or bool type
+        struct {
+            Type *base;
+            int64_t lanes;
+        } vector;
+
         // TYPE_FUNCTION
         struct {
             Type *return_type;
@@ -82,6 +99,9 @@ struct Type {
             size_t field_count;
             HashMap *field_map;
             HashMap *methods; // Maps InternResult* (method name) -> Symbol* (the method)
+            int64_t size;     // Layout (sema/type_layout.h), valid once `layout` is past STRUCT_LAYOUT_BUSY
+            int32_t align;
+            uint8_t layout;   // StructLayout
         } struct_type;
 
         // TYPE_ENUM
@@ -106,6 +126,11 @@ struct Type {
             size_t arg_count;    // Number of type arguments
             Type *concrete_type; // The monomorphized TYPE_STRUCT or TYPE_FUNCTION type
         } generic_inst;
+
+        // TYPE_CONST_ARG: only ever a generic_inst argument, never the type of a value
+        struct {
+            int64_t value;
+        } const_arg;
     } as;
 };
 
@@ -113,7 +138,11 @@ struct Type {
 typedef struct TypeStore {
     Arena *arena;
 
-    DenseArenaInterner *type_interner; // For interning complex types
+    // Interns every composite type; a type's address is its identity, so
+    // equality stays a pointer compare. Concurrent mode while pass 2 runs on
+    // a worker pool: types that already exist are found without a lock and
+    // new ones are inserted into one of a few locked shards.
+    DenseArenaInterner *type_interner;
     
     // The "Registry" for primitives
     // Key:   void* (The interned key from your identifiers interner)
@@ -133,20 +162,33 @@ typedef struct TypeStore {
 
     // Pre-interned common property names
     InternResult *kw_len;
+    // Intrinsic names, defined in every unit's global scope
+    InternResult *kw_print, *kw_println;
 
-    // Cache for monomorphized generic instances
-    // Key: MonoKey* (template + type args), Value: Type*
-    HashMap *generic_inst_cache;
-    
     // Registry for generic impl blocks
     // Key: base Type* (generic struct type), Value: DynArray* of AstImplDeclaration*
     HashMap *impl_registry;
+    HashMap *impl_method_index; // Generic struct Type* -> its impl methods by name (see lookup_generic_method)
+
+    // Parent scope of every unit's global scope; created by the first
+    // typecheck_program() and reused by later ones (--serve requests)
+    Scope *universe;
 } TypeStore;
 
 TypeStore *typestore_create(Arena *arena, DenseArenaInterner *identifiers, DenseArenaInterner *keywords);
+// Point the type interner's callbacks at this process's code again, for a
+// store mapped back from a startup snapshot (core/snapshot.h)
+void typestore_relink(TypeStore *ts);
 InternResult *intern_type(TypeStore *ts, Type *prototype);
 
+// Make intern_type() and the make_*_type() helpers safe to call from several
+// threads until typestore_end_concurrent(). Returns false on allocation failure.
+bool typestore_begin_concurrent(TypeStore *ts);
+void typestore_end_concurrent(TypeStore *ts);
+
 void register_primitives_to_scope(TypeStore *ts, Scope *universe_scope, DenseArenaInterner *keywords);
+// The universe scope with the primitives registered, created on first use
+Scope *typestore_universe(TypeStore *ts, DenseArenaInterner *keywords);
 void register_intrinsics(TypeStore *ts, Scope *global_scope, DenseArenaInterner *identifiers);
 
 // Returns true for i8, u8, i16, i32, i64, etc.
@@ -158,13 +200,18 @@ bool type_is_float(Type *t);
 bool type_is_bool(Type *t);
 // Returns true if the type is a char
 bool type_is_char(Type *t);
+// Returns true for vec<T, N>; vec<bool, N> is a mask
+bool type_is_vector(Type *t);
+bool type_is_mask(Type *t);
 
 // --- Type construction helpers (intern + return canonical Type*) ---
 Type *make_pointer_type(TypeStore *ts, Type *base);
 Type *make_array_type(TypeStore *ts, Type *base, int64_t size);
 Type *make_slice_type(TypeStore *ts, Type *base);
+Type *make_vector_type(TypeStore *ts, Type *base, int64_t lanes);
 Type *make_function_type(TypeStore *ts, Type *return_type, Type **params, size_t param_count);
 Type *make_generic_inst_type(TypeStore *ts, Type *base, Type **args, size_t arg_count);
+Type *make_const_arg_type(TypeStore *ts, int64_t value);
 
 // --- Generic type substitution ---
 // Recursively substitutes TYPE_TYPEVAR nodes with their concrete bindings.
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "sema/type.h"
+
+/*
+ * Byte sizes, alignments and struct field offsets, for the 64-bit data
+ * layouts codegen targets (pointers, usize and enums take 8 bytes, slices 16,
+ * scalars their own size, vectors a power of two).
+ *
+ * A struct is laid out when its fields are resolved: pass 1 lays out every
+ * plain struct, and the monomorphizer every instance once its queue drains.
+ * Fields keep their declaration order in StructField[]; `offset` records
+ * where each one lives:
+ *   - by default, in declaration order at natural alignment;
+ *   - @reorder places them by decreasing alignment (stable), which leaves
+ *     the least padding;
+ *   - @packed drops all padding and gives the struct alignment 1;
+ *   - @align(N) raises the struct's alignment to at least N and rounds its
+ *     size up to a multiple of it, so every element of an array is aligned.
+ * Anything but the default is STRUCT_LAYOUT_EXPLICIT, and codegen then
+ * builds the LLVM struct from these offsets instead of LLVM's own rules.
+ */
+
+/* Size and alignment of `t`; false while a struct in it is unresolved (or contains itself). */
+bool type_layout(Type *t, int64_t *size, int32_t *align);
+
+/* Lay out struct `t` (on first use); false while one of its fields cannot be laid out yet. */
+bool type_struct_layout(Type *t);
@@ -4,4 +4,9 @@
 #include "datastructures/scope.h"
 
 void type_print(FILE *out, const Type *type);
-void type_print_store_dump(TypeStore *store, Scope *global_scope);
\ No newline at end of file
+/* snprintf-style: writes at most `cap` bytes of the type's name, returns its full length. */
+size_t type_format(char *buf, size_t cap, const Type *type);
+void type_print_store_dump(TypeStore *store, Scope *global_scope);
+
+/* Display name of a type kind ("Struct"), "Unknown" if out of range. */
+const char *type_kind_name(TypeKind kind);
@@ -51,13 +51,25 @@ typedef enum {
     TE_MISSING_TYPE_ARGS,
     TE_GENERIC_ARG_MISMATCH,
     TE_ALLOCATOR_SHAPE_INVALID,
-    TE_INSTANTIATION_DEPTH
+    TE_INSTANTIATION_DEPTH,
+    TE_SYNTAX,             // Deferred function body failed to parse
+    TE_CONST_EVAL,         // Global initializer cannot be evaluated at compile time
+    TE_NOT_PURE,           // @pure function writes memory (sema/purity.h)
+    TE_INVALID_VECTOR,     // Bad vec<T, N> type or vector operation
+    TE_INVALID_ATOMIC,     // Bad operand or memory ordering of an atomic intrinsic
+    TE_INVALID_HINT,       // Bad operand of @prefetch or another optimizer hint
+    TE_NOT_ITERABLE,       // for (x in range) over something other than an array or slice
+    TE_NOT_SWITCHABLE,     // switch over something other than an integer, char or enum
+    TE_DUPLICATE_CASE,     // Two case values of one switch are equal
+    TE_NONEXHAUSTIVE_SWITCH, // Enum switch without else misses a variant
+    TE_INVALID_CONST_ARG,   // Value for a type parameter, or a const parameter's value is no fitting constant
+    TE_INVALID_TAIL_CALL,   // @tail misused, or its call cannot reuse the caller's frame
+    TE_INVALID_ASYNC        // async fn, await or a frame intrinsic misused (docs/lang/async.md)
 } TypeErrorKind;
 
 typedef struct {
     TypeErrorKind kind;
-    Span span;             
-    const char *filename;  
+    Span span;             // span.file names the module the error is reported in
     
     union {
         struct { const char *name; } name;
@@ -105,6 +117,11 @@ typedef struct {
             Type *type;
         } field;
 
+        struct {
+            const char *name;   // Global being initialized
+            const char *reason; // What the evaluation ran into
+        } const_eval;
+
     } as;
 } TypeError;
 
@@ -13,28 +13,42 @@ typedef struct {
     TypeStore *store;
     DenseArenaInterner *identifiers;
     DenseArenaInterner *keywords;
-    const char *filename;
+    SourceId file; // Module being checked; its private symbols are visible
     DynArray *errors; // DynArray<TypeError>
     ModuleLoader *loader;
     int current_pass;
     DynArray *mono_queue; // Queue of MonoJob*
     bool is_draining;
     int current_mono_depth;
+    SymbolTable *locals; // Shared by the local scopes of every function body
+    Arena *arena; // Nodes, scopes and instances made while checking (the store's arena when serial)
+    struct SemaWorker *worker; // Pool worker checking bodies with this context, NULL when serial
+    HashMap *overload_cache; // Chosen overload per (set, argument types), see resolve_overload_candidate
+    size_t instance_uses; // Generic instances looked up so far, see AST_FLAG_USES_INSTANCES
+    AstNode *current_function; // Function whose body is being checked, for @tail
+    size_t live_defers; // Defers registered in the enclosing blocks of the statement being checked
 } TypeCheckContext;
 
 // Context creation
-TypeCheckContext typecheck_context_create(Arena *arena, TypeStore *store, DenseArenaInterner *identifiers, DenseArenaInterner *keywords, const char *filename, ModuleLoader *loader);
+TypeCheckContext typecheck_context_create(Arena *arena, TypeStore *store, DenseArenaInterner *identifiers, DenseArenaInterner *keywords, SourceId file, ModuleLoader *loader);
 
-// Main Entry Point
+// Main Entry Point. With loader->opts->jobs > 1 the function and method
+// bodies of pass 2 are checked on a worker pool; see docs/semantics.md.
 void typecheck_program(TypeCheckContext *ctx);
 
 // AST -> Type resolution (Updated to take Context)
 Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node);
+// One argument of a generic instance: a type, or a TYPE_CONST_ARG for an integer constant
+Type *resolve_generic_arg(TypeCheckContext *ctx, Scope *scope, AstNode *node);
 
 void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *var_node);
 
-// Lazy monomorphization for methods
-Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *inst_type, AstNode *method_node);
+// Lazy monomorphization for methods: `method_name` of generic instance `inst_type`, NULL if it has none
+Symbol *lookup_generic_method(TypeCheckContext *ctx, Scope *scope, Type *inst_type, InternResult *method_name);
 
 // Instantiation for generic functions
-Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol *sym, Type **arg_types, size_t count, Span error_span);
\ No newline at end of file
+Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol *sym, Type **arg_types, size_t count, Span error_span);
+
+// On a pass 2 worker, records that the current body asked for instance `key`
+// (see sema_exclusive_begin); does nothing serially
+void sema_note_instance(TypeCheckContext *ctx, void *key);
\ No newline at end of file
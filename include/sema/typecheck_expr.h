@@ -13,6 +13,8 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
 Type* check_assignment(TypeCheckContext *ctx, Scope *scope, AstNode *expr);
 Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expected_type);
 Type* check_expression(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expected_type);
+// The operand of `return @tail(call)`; the call must be able to replace the caller's frame
+Type* check_tail_call(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *return_type);
 
 // Helpers
 void insert_cast(TypeCheckContext *ctx, AstNode *node, Type *to_type);
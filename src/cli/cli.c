@@ -16,12 +16,27 @@ static bool h_ast(Options *o, int *i, int argc, char **argv)    { o->print_ast =
 static bool h_ir(Options *o, int *i, int argc, char **argv)     { o->print_ir = true; return true; }
 static bool h_types(Options *o, int *i, int argc, char **argv)  { o->print_types = true; return true; }
 static bool h_time(Options *o, int *i, int argc, char **argv)   { o->print_time = true; return true; }
+static bool h_stats(Options *o, int *i, int argc, char **argv)  { o->print_stats = true; return true; }
+static bool h_mem_report(Options *o, int *i, int argc, char **argv) { o->mem_report = true; return true; }
 static bool h_run(Options *o, int *i, int argc, char **argv)    { o->run_executable = true; return true; }
 static bool h_quiet(Options *o, int *i, int argc, char **argv)  { o->quiet = true; return true; }
 static bool h_verbose(Options *o, int *i, int argc, char **argv){ o->verbose = true; return true; }
+static bool h_in_process_link(Options *o, int *i, int argc, char **argv) { o->link_in_process = true; return true; }
+static bool h_check_all(Options *o, int *i, int argc, char **argv) { o->check_all = true; return true; }
+static bool h_report_stack_allocs(Options *o, int *i, int argc, char **argv) { o->report_stack_allocs = true; return true; }
+static bool h_incremental(Options *o, int *i, int argc, char **argv) { o->incremental = true; return true; }
+static bool h_strict_overflow(Options *o, int *i, int argc, char **argv) { o->strict_overflow = true; return true; }
+static bool h_strict_aliasing(Options *o, int *i, int argc, char **argv) { o->strict_aliasing = true; return true; }
+static bool h_bounds_checks(Options *o, int *i, int argc, char **argv) { o->bounds_checks = true; return true; }
+static bool h_instrument(Options *o, int *i, int argc, char **argv) { o->instrument = true; return true; }
+static bool h_perf_map(Options *o, int *i, int argc, char **argv) { o->perf_map = true; return true; }
+static bool h_icf(Options *o, int *i, int argc, char **argv) { o->fold_instances = true; return true; }
 
 static bool h_opt(Options *o, int *i, int argc, char **argv) {
-    if (strlen(argv[*i]) == 3) {
+    o->fast_compile = strcmp(argv[*i], "-Odev") == 0;
+    if (o->fast_compile) {
+        o->opt_level = 0;
+    } else if (strlen(argv[*i]) == 3) {
         o->opt_level = argv[*i][2] - '0';
     } else if (*i + 1 < argc) {
         o->opt_level = atoi(argv[++(*i)]);
@@ -33,6 +48,41 @@ static bool h_opt(Options *o, int *i, int argc, char **argv) {
     return true;
 }
 
+static bool h_jobs(Options *o, int *i, int argc, char **argv) {
+    const char *arg = NULL;
+    if (strncmp(argv[*i], "-j", 2) == 0 && argv[*i][2] != '\0') {
+        arg = argv[*i] + 2;
+    } else if (*i + 1 < argc) {
+        arg = argv[++(*i)];
+    }
+    if (!arg) {
+        fprintf(stderr, "Error: -j requires an argument\n");
+        return false;
+    }
+    char *end = NULL;
+    long n = strtol(arg, &end, 10);
+    if (*end != '\0' || n < 1 || n > 256) {
+        fprintf(stderr, "Error: Invalid job count: %s\n", arg);
+        return false;
+    }
+    o->jobs = (int)n;
+    return true;
+}
+
+static bool h_jit_opt(Options *o, int *i, int argc, char **argv) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Error: --jit-opt requires an argument\n");
+        return false;
+    }
+    const char *arg = argv[++(*i)];
+    if (strlen(arg) != 1 || arg[0] < '0' || arg[0] > '3') {
+        fprintf(stderr, "Error: Invalid JIT optimization level: %s\n", arg);
+        return false;
+    }
+    o->jit_opt_level = arg[0] - '0';
+    return true;
+}
+
 static bool h_out(Options *o, int *i, int argc, char **argv) {
     if (*i + 1 < argc) {
         o->output_name = argv[++(*i)];
@@ -42,6 +92,153 @@ static bool h_out(Options *o, int *i, int argc, char **argv) {
     return false;
 }
 
+static bool h_cache_dir(Options *o, int *i, int argc, char **argv) {
+    if (*i + 1 < argc) {
+        o->cache_dir = argv[++(*i)];
+        return true;
+    }
+    fprintf(stderr, "Error: --cache-dir requires an argument\n");
+    return false;
+}
+
+static bool h_serve(Options *o, int *i, int argc, char **argv) {
+    if (*i + 1 < argc) {
+        o->serve_socket = argv[++(*i)];
+        return true;
+    }
+    fprintf(stderr, "Error: --serve requires a socket path\n");
+    return false;
+}
+
+static bool h_batch(Options *o, int *i, int argc, char **argv) {
+    if (*i + 1 < argc) {
+        o->batch_manifest = argv[++(*i)];
+        return true;
+    }
+    fprintf(stderr, "Error: --batch requires a manifest path\n");
+    return false;
+}
+
+static bool h_connect(Options *o, int *i, int argc, char **argv) {
+    if (*i + 1 < argc) {
+        o->connect_socket = argv[++(*i)];
+        return true;
+    }
+    fprintf(stderr, "Error: --connect requires a socket path\n");
+    return false;
+}
+
+static bool h_trace(Options *o, int *i, int argc, char **argv) {
+    const char *arg = NULL;
+    if (strncmp(argv[*i], "--trace=", 8) == 0) {
+        arg = argv[*i] + 8;
+    } else if (*i + 1 < argc) {
+        arg = argv[++(*i)];
+    }
+    if (!arg || *arg == '\0') {
+        fprintf(stderr, "Error: --trace requires a file name\n");
+        return false;
+    }
+    o->trace_path = arg;
+    return true;
+}
+
+/* `--flag=value` or `--flag value`: the value, NULL (after an error) if missing. */
+static const char *option_value(const char *flag, int *i, int argc, char **argv) {
+    size_t len = strlen(flag);
+    const char *arg = NULL;
+    if (strncmp(argv[*i], flag, len) == 0 && argv[*i][len] == '=') {
+        arg = argv[*i] + len + 1;
+    } else if (*i + 1 < argc) {
+        arg = argv[++(*i)];
+    }
+    if (!arg || *arg == '\0') {
+        fprintf(stderr, "Error: %s requires an argument\n", flag);
+        return NULL;
+    }
+    return arg;
+}
+
+static bool h_march(Options *o, int *i, int argc, char **argv) {
+    const char *arg = strncmp(argv[*i], "-march=", 7) == 0 ? argv[*i] + 7 : NULL;
+    if (!arg || *arg == '\0') {
+        fprintf(stderr, "Error: -march requires a CPU name (e.g. -march=native)\n");
+        return false;
+    }
+    o->target_cpu = arg;
+    return true;
+}
+
+static bool h_target_cpu(Options *o, int *i, int argc, char **argv) {
+    return (o->target_cpu = option_value("--target-cpu", i, argc, argv)) != NULL;
+}
+
+static bool h_target_features(Options *o, int *i, int argc, char **argv) {
+    return (o->target_features = option_value("--target-features", i, argc, argv)) != NULL;
+}
+
+static bool h_prefer_vector_width(Options *o, int *i, int argc, char **argv) {
+    const char *arg = option_value("--prefer-vector-width", i, argc, argv);
+    if (!arg) return false;
+    char *end = NULL;
+    long bits = strtol(arg, &end, 10);
+    if (*end != '\0' || bits < 64 || bits > 4096 || (bits & (bits - 1)) != 0) {
+        fprintf(stderr, "Error: Invalid vector width: %s (expected a power of two, e.g. 256)\n", arg);
+        return false;
+    }
+    o->prefer_vector_width = (int)bits;
+    return true;
+}
+
+static bool h_codegen_units(Options *o, int *i, int argc, char **argv) {
+    const char *arg = option_value("--codegen-units", i, argc, argv);
+    if (!arg) return false;
+    char *end = NULL;
+    long n = strtol(arg, &end, 10);
+    if (*end != '\0' || n < 1 || n > 256) {
+        fprintf(stderr, "Error: Invalid codegen unit count: %s\n", arg);
+        return false;
+    }
+    o->codegen_units = (int)n;
+    return true;
+}
+
+static bool h_profile_generate(Options *o, int *i, int argc, char **argv) {
+    const char *arg = strncmp(argv[*i], "--profile-generate=", 19) == 0 ? argv[*i] + 19 : "default.profraw";
+    if (*arg == '\0') {
+        fprintf(stderr, "Error: --profile-generate= requires a file name\n");
+        return false;
+    }
+    o->profile_generate = arg;
+    return true;
+}
+
+static bool h_profile_use(Options *o, int *i, int argc, char **argv) {
+    const char *arg = option_value("--profile-use", i, argc, argv);
+    if (!arg) return false;
+    FILE *f = fopen(arg, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot read profile '%s'\n", arg);
+        return false;
+    }
+    fclose(f);
+    o->profile_use = arg;
+    return true;
+}
+
+static bool h_huge_pages(Options *o, int *i, int argc, char **argv) {
+    const char *arg = strncmp(argv[*i], "--huge-pages=", 13) == 0 ? argv[*i] + 13 : NULL;
+    if (!arg || strcmp(arg, "transparent") == 0) {
+        o->huge_pages = 1;
+    } else if (strcmp(arg, "explicit") == 0) {
+        o->huge_pages = 2;
+    } else {
+        fprintf(stderr, "Error: Invalid --huge-pages mode: %s (expected 'transparent' or 'explicit')\n", arg);
+        return false;
+    }
+    return true;
+}
+
 static const CLIOption REGISTRY[] = {
     {"-t", "--tokens",  h_tokens},
     {"-a", "--ast",     h_ast},
@@ -52,6 +249,32 @@ static const CLIOption REGISTRY[] = {
     {"-q", "--quiet",   h_quiet},
     {"-v", "--verbose", h_verbose},
     {"-o", NULL,        h_out},
+    {"-j", "--jobs",    h_jobs},
+    {NULL, "--cache-dir", h_cache_dir},
+    {NULL, "--in-process-link", h_in_process_link},
+    {NULL, "--check-all", h_check_all},
+    {NULL, "--incremental", h_incremental},
+    {NULL, "--report-stack-allocs", h_report_stack_allocs},
+    {NULL, "--jit-opt", h_jit_opt},
+    {NULL, "--serve",   h_serve},
+    {NULL, "--connect", h_connect},
+    {NULL, "--batch",   h_batch},
+    {NULL, "--trace",   h_trace},
+    {NULL, "--stats",   h_stats},
+    {NULL, "--mem-report", h_mem_report},
+    {NULL, "--huge-pages", h_huge_pages},
+    {NULL, "--target-cpu", h_target_cpu},
+    {NULL, "--target-features", h_target_features},
+    {NULL, "--prefer-vector-width", h_prefer_vector_width},
+    {NULL, "--codegen-units", h_codegen_units},
+    {NULL, "--strict-overflow", h_strict_overflow},
+    {NULL, "--strict-aliasing", h_strict_aliasing},
+    {NULL, "--bounds-checks", h_bounds_checks},
+    {NULL, "--profile-generate", h_profile_generate},
+    {NULL, "--profile-use", h_profile_use},
+    {NULL, "--instrument", h_instrument},
+    {NULL, "--perf-map", h_perf_map},
+    {NULL, "--icf",     h_icf},
 };
 
 int parse_options(int argc, char **argv, Options *opts, const char **in_path) {
@@ -60,6 +283,24 @@ int parse_options(int argc, char **argv, Options *opts, const char **in_path) {
     opts->print_tokens = opts->print_ast = opts->print_ir = opts->print_types = false;
     opts->print_time = opts->verbose = opts->run_executable = opts->quiet = false;
     opts->output_name = "output"; opts->opt_level = 0; opts->stdlib_path = "lib";
+    opts->jobs = 1; opts->cache_dir = NULL; opts->link_in_process = false;
+    opts->check_all = false; opts->incremental = false;
+    opts->strict_overflow = false; opts->strict_aliasing = false;
+    opts->bounds_checks = false;
+    opts->report_stack_allocs = false;
+    opts->jit_opt_level = -1;
+    opts->huge_pages = 0;
+    opts->serve_socket = NULL; opts->connect_socket = NULL; opts->batch_manifest = NULL;
+    opts->trace_path = NULL;
+    opts->print_stats = false;
+    opts->mem_report = false;
+    opts->target_cpu = NULL; opts->target_features = NULL;
+    opts->prefer_vector_width = 0;
+    opts->codegen_units = 1;
+    opts->profile_generate = NULL; opts->profile_use = NULL;
+    opts->instrument = false; opts->perf_map = false;
+    opts->fold_instances = false;
+    opts->fast_compile = false;
 
     int pos_args = 0;
     for (int i = 1; i < argc; ++i) {
@@ -78,6 +319,26 @@ int parse_options(int argc, char **argv, Options *opts, const char **in_path) {
 
         if (strncmp(argv[i], "-O", 2) == 0) {
             if (!h_opt(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            if (!h_jobs(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (!h_trace(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--huge-pages=", 13) == 0) {
+            if (!h_huge_pages(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "-march=", 7) == 0) {
+            if (!h_march(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--target-cpu=", 13) == 0) {
+            if (!h_target_cpu(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--target-features=", 18) == 0) {
+            if (!h_target_features(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--prefer-vector-width=", 22) == 0) {
+            if (!h_prefer_vector_width(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--codegen-units=", 16) == 0) {
+            if (!h_codegen_units(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--profile-generate=", 19) == 0) {
+            if (!h_profile_generate(opts, &i, argc, argv)) return 0;
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            if (!h_profile_use(opts, &i, argc, argv)) return 0;
         } else if (argv[i][0] == '-') {
             fprintf(stderr, "Unknown option: %s\n", argv[i]); print_usage(argv[0]); return 0;
         } else {
@@ -86,19 +347,66 @@ int parse_options(int argc, char **argv, Options *opts, const char **in_path) {
         }
     }
 
-    if (pos_args == 0) { fprintf(stderr, "Error: No input file specified\n"); return 0; }
+    if (opts->serve_socket && (pos_args > 0 || opts->connect_socket)) {
+        fprintf(stderr, "Error: --serve takes no input file (requests name their own)\n"); return 0;
+    }
+    if (opts->batch_manifest && (pos_args > 0 || opts->serve_socket || opts->connect_socket)) {
+        fprintf(stderr, "Error: --batch takes no input file (manifest lines name their own)\n"); return 0;
+    }
+    if (opts->incremental && !opts->cache_dir) {
+        fprintf(stderr, "Error: --incremental requires --cache-dir\n"); return 0;
+    }
+    if (opts->profile_generate && opts->profile_use) {
+        fprintf(stderr, "Error: --profile-generate and --profile-use are exclusive\n"); return 0;
+    }
+    if (opts->profile_generate && opts->run_executable) {
+        fprintf(stderr, "Error: --profile-generate needs an executable (not --run)\n"); return 0;
+    }
+    if (opts->perf_map && !opts->run_executable) {
+        fprintf(stderr, "Error: --perf-map describes JIT code and needs --run\n"); return 0;
+    }
+    if (pos_args == 0 && !opts->serve_socket && !opts->batch_manifest) { fprintf(stderr, "Error: No input file specified\n"); return 0; }
     return 1;
 }
 
 void print_usage(const char *prog) {
     fprintf(stderr, "Usage: %s <file> [options]\n", prog);
+    fprintf(stderr, "       %s --serve <socket> [-j <n>] [-q]\n", prog);
+    fprintf(stderr, "       %s --batch <manifest> [-j <n>] [-q]\n", prog);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -o <name>       Set output executable name (default: 'output')\n");
     fprintf(stderr, "  -O<level>       Optimization level (0-3)\n");
-    fprintf(stderr, "  -r, --run       Compile and run the program immediately\n");
+    fprintf(stderr, "  -Odev           Fastest compile: -O0 with the fast instruction selector and register allocator\n");
+    fprintf(stderr, "  -j, --jobs <n>  Load modules, check bodies and generate IR on <n> threads\n");
+    fprintf(stderr, "  --cache-dir <dir>  Reuse parsed modules and std objects cached in <dir>\n");
+    fprintf(stderr, "  --in-process-link  Link without running cc (x86-64 Linux, glibc)\n");
+    fprintf(stderr, "  --check-all     Also check and emit std functions the program never uses\n");
+    fprintf(stderr, "  --incremental   Only re-check and recompile functions whose inputs changed (needs --cache-dir)\n");
+    fprintf(stderr, "  --report-stack-allocs  Report each @alloc promoted to the stack\n");
+    fprintf(stderr, "  -march=<cpu>, --target-cpu <cpu>  Generate code for <cpu> (default: native, the host)\n");
+    fprintf(stderr, "  --target-features <list>  Enable/disable CPU features, e.g. +avx2,-avx512f\n");
+    fprintf(stderr, "  --prefer-vector-width <bits>  Widest vectors the vectorizers should prefer (e.g. 256)\n");
+    fprintf(stderr, "  --codegen-units <n>  Split the optimized program into <n> objects generated in parallel\n");
+    fprintf(stderr, "  --strict-overflow  Signed overflow of +, - and * is undefined, letting it be optimized on\n");
+    fprintf(stderr, "  --strict-aliasing  Memory is only accessed through its own scalar type (type-based alias analysis)\n");
+    fprintf(stderr, "  --bounds-checks  Trap on array and slice subscripts out of range\n");
+    fprintf(stderr, "  --profile-generate[=<file>]  Instrument the executable to write a raw profile (default: default.profraw)\n");
+    fprintf(stderr, "  --profile-use <file>  Optimize with a profile merged by llvm-profdata\n");
+    fprintf(stderr, "  --instrument    Count calls and time every function; the report is printed at exit\n");
+    fprintf(stderr, "  --icf           Fold generic instances (and other functions) that compile to identical code\n");
+    fprintf(stderr, "  -r, --run       Run the program on the lazy JIT (no executable)\n");
+    fprintf(stderr, "  --jit-opt <n>   Optimization level of the --run tier (default: -O)\n");
+    fprintf(stderr, "  --perf-map      With --run, write /tmp/perf-<pid>.map so perf can name JIT functions\n");
+    fprintf(stderr, "  --serve <socket>   Keep the std library resident and compile requests sent to <socket>\n");
+    fprintf(stderr, "  --connect <socket> Compile on the --serve daemon at <socket>\n");
+    fprintf(stderr, "  --batch <manifest> Compile every command line in <manifest> against one resident std library, <n> at a time\n");
     fprintf(stderr, "  -v, --verbose   Show compilation progress\n");
     fprintf(stderr, "  -q, --quiet     Suppress all non-error output\n");
     fprintf(stderr, "  -T, --time      Show performance metrics\n");
+    fprintf(stderr, "  --trace=<file>  Write a Chrome trace (chrome://tracing) of the compile\n");
+    fprintf(stderr, "  --stats         Show internal counters (probes, lookups, instantiations; dev or STATS=1 builds)\n");
+    fprintf(stderr, "  --mem-report    Show compiler memory by category (tokens, AST, types, ...), kind and module\n");
+    fprintf(stderr, "  --huge-pages[=explicit]  Back the compiler arena with 2 MiB pages\n");
     fprintf(stderr, "  -a, --ast       Dump the parsed AST\n");
     fprintf(stderr, "  --ir            Dump the generated LLVM IR\n");
     fprintf(stderr, "  -t, --tokens    Dump lexer tokens\n");
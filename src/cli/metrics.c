@@ -1,7 +1,12 @@
 #include "cli/metrics.h"
 #include "datastructures/dynamic_array.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
+#include "core/utils.h"
+#include "sema/type_print.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #define COL_RESET   "\033[0m"
 #define COL_GRAY    "\033[90m"
@@ -62,7 +67,7 @@ static void count_nodes_recursive(AstNode *node, size_t *count) {
             break;
             
         case AST_TYPE:
-            if (node->data.ast_type.kind == AST_TYPE_ARRAY) {
+            if (node->data.ast_type.kind == AST_TYPE_ARRAY || node->data.ast_type.kind == AST_TYPE_VECTOR) {
                 count_nodes_recursive(node->data.ast_type.u.array.elem, count);
                 count_nodes_recursive(node->data.ast_type.u.array.size_expr, count);
             } else if (node->data.ast_type.kind == AST_TYPE_PTR) {
@@ -86,6 +91,17 @@ static void count_nodes_recursive(AstNode *node, size_t *count) {
             count_nodes_recursive(node->data.while_statement.body, count);
             break;
             
+        case AST_SWITCH_STATEMENT:
+            count_nodes_recursive(node->data.switch_statement.subject, count);
+            count_dynarray_nodes(node->data.switch_statement.cases, count);
+            count_nodes_recursive(node->data.switch_statement.else_body, count);
+            break;
+
+        case AST_SWITCH_CASE:
+            count_dynarray_nodes(node->data.switch_case.values, count);
+            count_nodes_recursive(node->data.switch_case.body, count);
+            break;
+            
         case AST_BINARY_EXPR:
             count_nodes_recursive(node->data.binary_expr.left, count);
             count_nodes_recursive(node->data.binary_expr.right, count);
@@ -172,4 +188,136 @@ void print_compilation_report(CompilationStats *stats, AstNode *program) {
     printf("%s└─────────────────┴─────────────┴──────────────┘%s\n", COL_GRAY, COL_RESET);
 
     printf("  %sNodes:%s %zu  %sThroughput:%s %.2f MB/s\n\n", COL_GRAY, COL_RESET, ast_nodes, COL_GRAY, COL_RESET, throughput);
-}
\ No newline at end of file
+}
+
+static double stat_ratio(StatCounter num, StatCounter den) {
+    size_t d = stats_get(den);
+    return d ? (double)stats_get(num) / (double)d : 0.0;
+}
+
+void print_stats_report(void) {
+    printf("\n%s[%sStatistics%s]%s\n", COL_GRAY, COL_RESET, COL_GRAY, COL_RESET);
+    printf("%s┌──────────────────────┬──────────────┬─────────────────────────────────┐%s\n", COL_GRAY, COL_RESET);
+    printf("%s│%s Counter              %s│%s        Value %s│%s Meaning                         %s│%s\n", COL_GRAY, COL_BOLD, COL_GRAY, COL_BOLD, COL_GRAY, COL_BOLD, COL_GRAY, COL_RESET);
+    printf("%s├──────────────────────┼──────────────┼─────────────────────────────────┤%s\n", COL_GRAY, COL_RESET);
+    for (int i = 0; i < STAT_COUNT; i++) {
+        printf("%s│%s %-20s %s│%s %12zu %s│%s %-31s %s│%s\n", COL_GRAY, COL_RESET, stats_name(i), COL_GRAY, COL_RESET,
+               stats_get(i), COL_GRAY, COL_RESET, stats_description(i), COL_GRAY, COL_RESET);
+    }
+    printf("%s└──────────────────────┴──────────────┴─────────────────────────────────┘%s\n", COL_GRAY, COL_RESET);
+
+    double hits = (double)stats_get(STAT_INTERN_HITS);
+    double interned = hits + (double)stats_get(STAT_INTERN_MISSES);
+    printf("  %sProbe groups/lookup:%s %.3f  %sIntern hit rate:%s %.1f%%  %sScopes/lookup:%s %.2f  %sCandidates/call:%s %.2f\n\n",
+           COL_GRAY, COL_RESET, stat_ratio(STAT_HASHMAP_PROBE_GROUPS, STAT_HASHMAP_LOOKUPS),
+           COL_GRAY, COL_RESET, interned > 0 ? 100.0 * hits / interned : 0.0,
+           COL_GRAY, COL_RESET, stat_ratio(STAT_SCOPE_WALKED, STAT_SCOPE_LOOKUPS),
+           COL_GRAY, COL_RESET, stat_ratio(STAT_OVERLOAD_CANDIDATES, STAT_OVERLOAD_RESOLUTIONS));
+}
+
+// -----------------------------------------------------------------------------
+// Memory Report
+// -----------------------------------------------------------------------------
+
+#define MEM_TOP_KINDS   8
+#define MEM_TOP_MODULES 20
+
+static const char *short_bytes(char *buf, size_t len, size_t bytes) {
+    if (bytes < KB_SIZE) snprintf(buf, len, "%zuB", bytes);
+    else if (bytes < MB_SIZE) snprintf(buf, len, "%.1fK", bytes / KB_SIZE);
+    else snprintf(buf, len, "%.1fM", bytes / MB_SIZE);
+    return buf;
+}
+
+static const char *mem_kind_name(MemCategory cat, int kind) {
+    if (kind == MEM_KIND_NONE) return "(other)";
+    return cat == MEM_TYPES ? type_kind_name((TypeKind)kind) : ast_node_type_name((AstNodeType)kind);
+}
+
+typedef struct {
+    int key;        // Kind or module id
+    size_t bytes;
+    size_t count;
+} MemRow;
+
+static int mem_row_by_bytes(const void *a, const void *b) {
+    const MemRow *x = a, *y = b;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : x->key - y->key;
+}
+
+/* The biggest kinds of one category on a line: "CallExpression 1.2M (8012)". */
+static void print_mem_kinds(MemCategory cat) {
+    MemRow rows[MEM_KIND_COUNT + 1];
+    size_t n = 0;
+    for (int k = -1; k < MEM_KIND_COUNT; k++) {
+        MemTally t = mem_report_kind(cat, k);
+        if (t.bytes) rows[n++] = (MemRow){ k, t.bytes, t.count };
+    }
+    if (n == 0) return;
+    qsort(rows, n, sizeof(MemRow), mem_row_by_bytes);
+
+    char buf[16];
+    printf("  %s%-8s%s", COL_GRAY, mem_category_name(cat), COL_RESET);
+    for (size_t i = 0; i < n && i < MEM_TOP_KINDS; i++) {
+        printf(" %s %s (%zu)%s", mem_kind_name(cat, rows[i].key), short_bytes(buf, sizeof(buf), rows[i].bytes),
+               rows[i].count, i + 1 < n && i + 1 < MEM_TOP_KINDS ? "," : "");
+    }
+    printf("\n");
+}
+
+static void print_mem_modules(void) {
+    SourceId limit = mem_report_module_limit();
+    if (limit == 0) return;
+    MemRow *rows = malloc(limit * sizeof(MemRow));
+    if (!rows) return;
+    size_t n = 0;
+    for (SourceId f = 0; f < limit; f++) {
+        size_t bytes = 0;
+        for (int c = 0; c < MEM_CATEGORY_COUNT; c++) bytes += mem_report_module(f, c).bytes;
+        if (bytes) rows[n++] = (MemRow){ (int)f, bytes, 0 };
+    }
+    qsort(rows, n, sizeof(MemRow), mem_row_by_bytes);
+
+    char buf[16];
+    printf("\n  %s%-9s", COL_BOLD, "Total");
+    for (int c = 0; c < MEM_CATEGORY_COUNT; c++) printf(" %8s", mem_category_name(c));
+    printf("  Module%s\n", COL_RESET);
+    for (size_t i = 0; i < n && i < MEM_TOP_MODULES; i++) {
+        SourceId f = (SourceId)rows[i].key;
+        printf("  %-9s", short_bytes(buf, sizeof(buf), rows[i].bytes));
+        for (int c = 0; c < MEM_CATEGORY_COUNT; c++) {
+            printf(" %8s", short_bytes(buf, sizeof(buf), mem_report_module(f, c).bytes));
+        }
+        const char *path = f == SOURCE_NONE ? NULL : source_path(f);
+        printf("  %s%s%s\n", f == SOURCE_NONE ? COL_GRAY : COL_CYAN, path ? path : "(shared)", COL_RESET);
+    }
+    if (n > MEM_TOP_MODULES) printf("  %s... %zu more modules%s\n", COL_GRAY, n - MEM_TOP_MODULES, COL_RESET);
+    free(rows);
+}
+
+void print_mem_report(void) {
+    printf("\n%s[%sMemory%s]%s\n", COL_GRAY, COL_RESET, COL_GRAY, COL_RESET);
+    printf("%s┌─────────────────┬──────────────┬──────────────┐%s\n", COL_GRAY, COL_RESET);
+    printf("%s│%s Category        %s│%s Bytes        %s│%s        Count %s│%s\n", COL_GRAY, COL_BOLD, COL_GRAY, COL_BOLD, COL_GRAY, COL_BOLD, COL_GRAY, COL_RESET);
+    printf("%s├─────────────────┼──────────────┼──────────────┤%s\n", COL_GRAY, COL_RESET);
+
+    size_t total = 0;
+    for (int c = 0; c < MEM_CATEGORY_COUNT; c++) {
+        MemTally t = mem_report_category(c);
+        total += t.bytes;
+        printf("%s│%s %-15s %s│%s", COL_GRAY, COL_RESET, mem_category_name(c), COL_GRAY, COL_RESET);
+        print_mem_unit(t.bytes);
+        printf("%s│%s %12zu %s│%s\n", COL_GRAY, COL_RESET, t.count, COL_GRAY, COL_RESET);
+    }
+    printf("%s├─────────────────┼──────────────┼──────────────┤%s\n", COL_GRAY, COL_RESET);
+    printf("%s│%s TOTAL           %s│%s", COL_GRAY, COL_BOLD, COL_GRAY, COL_BOLD);
+    print_mem_unit(total);
+    printf("%s│%s              %s│%s\n", COL_GRAY, COL_RESET, COL_GRAY, COL_RESET);
+    printf("%s└─────────────────┴──────────────┴──────────────┘%s\n", COL_GRAY, COL_RESET);
+
+    print_mem_kinds(MEM_AST);
+    print_mem_kinds(MEM_TYPES);
+    print_mem_kinds(MEM_MONO);
+    print_mem_modules();
+    printf("  %sPeak RSS:%s %zu KB\n\n", COL_GRAY, COL_RESET, get_peak_rss_kb());
+}
@@ -0,0 +1,374 @@
+/**
+ * @file codegen_abi.c
+ * @brief C calling convention: how each parameter and result crosses a call.
+ *
+ * Every function, Newt or @link, is lowered with the target's C convention,
+ * so Newt-to-Newt and FFI calls agree on where an aggregate lives:
+ *
+ *   - x86-64 System V: a struct of at most 16 bytes is split into eightbytes,
+ *     each classified INTEGER or SSE by the fields it holds, and passed as
+ *     the matching { i64 | double | float | <2 x float> } pair. Larger or
+ *     misaligned (@packed) structs are MEMORY: byval on the stack, sret when
+ *     returned. A struct that no longer fits the remaining argument registers
+ *     goes on the stack whole, as the ABI requires.
+ *   - AAPCS64: a homogeneous float aggregate of up to four members travels as
+ *     [N x float|double] in v-registers, other composites of at most 16 bytes
+ *     as i64 / [2 x i64]; larger ones are passed by reference to a caller
+ *     copy and returned through x8 (sret).
+ *   - anything else keeps the plain lowering: first-class aggregates up to
+ *     16 bytes, byval / sret beyond.
+ *
+ * Fixed-size arrays are Newt values with no C counterpart and always go
+ * byval. Coerced values are reinterpreted through a stack slot; at -O1 and
+ * above SROA folds those away.
+ */
+
+#include "codegen_internal.h"
+#include "sema/type_layout.h"
+
+#define ABI_SYSV_INT_REGS 6
+#define ABI_SYSV_SSE_REGS 8
+#define ABI_AAPCS64_HFA_MAX 4
+
+CodegenAbi codegen_abi_for_triple(const char *triple) {
+    if (strncmp(triple, "x86_64", 6) == 0 || strncmp(triple, "amd64", 5) == 0) {
+        if (strstr(triple, "windows") || strstr(triple, "mingw") || strstr(triple, "cygwin")) return CODEGEN_ABI_GENERIC;
+        return CODEGEN_ABI_SYSV_X86_64;
+    }
+    if (strncmp(triple, "aarch64", 7) == 0 || strncmp(triple, "arm64", 5) == 0) {
+        if (strstr(triple, "windows") || strstr(triple, "darwin") || strstr(triple, "apple")) return CODEGEN_ABI_GENERIC;
+        return CODEGEN_ABI_AAPCS64;
+    }
+    return CODEGEN_ABI_GENERIC;
+}
+
+static Type *concrete(Type *t) {
+    if (t && t->kind == TYPE_GENERIC_INST) t = t->as.generic_inst.concrete_type;
+    return t;
+}
+
+static bool is_aggregate(Type *t) {
+    t = concrete(t);
+    return t && t->kind == TYPE_STRUCT;
+}
+
+static uint64_t abi_size(CodegenContext *ctx, Type *t) {
+    return LLVMABISizeOfType(ctx->target_data, get_llvm_type(ctx, t));
+}
+
+// =============================================================================
+// SECTION: x86-64 SYSTEM V
+// =============================================================================
+
+typedef enum { CLASS_NONE, CLASS_INTEGER, CLASS_SSE } EightbyteClass;
+
+typedef struct {
+    EightbyteClass cls;
+    unsigned f32_slots; // Bit k: an f32 at byte 4k of the eightbyte
+    bool wide_sse;      // Holds an f64 or vector lanes
+} Eightbyte;
+
+typedef struct {
+    Eightbyte parts[2];
+    bool memory;
+    unsigned leaves;
+    Type *vector_leaf; // The last vector seen
+} SysvClassify;
+
+static void sysv_mark(SysvClassify *c, int64_t offset, int64_t size, EightbyteClass cls, bool is_f32, bool wide) {
+    for (int64_t at = offset; at < offset + size; at = (at / 8 + 1) * 8) {
+        Eightbyte *eb = &c->parts[at / 8];
+        if (cls == CLASS_INTEGER || eb->cls == CLASS_NONE) eb->cls = cls; // INTEGER wins
+        if (is_f32) eb->f32_slots |= 1u << ((at % 8) / 4);
+        if (wide) eb->wide_sse = true;
+    }
+}
+
+static void sysv_classify(SysvClassify *c, Type *t, int64_t offset) {
+    t = concrete(t);
+    if (!t || c->memory) return;
+    int64_t size = 0;
+    int32_t align = 1;
+    if (!type_layout(t, &size, &align) || offset % align != 0 || offset + size > 16) {
+        c->memory = true; // misaligned (@packed) or straddling past the two eightbytes
+        return;
+    }
+
+    switch (t->kind) {
+        case TYPE_STRUCT:
+            for (size_t i = 0; i < t->as.struct_type.field_count; i++) {
+                sysv_classify(c, t->as.struct_type.fields[i].type, offset + t->as.struct_type.fields[i].offset);
+            }
+            return;
+        case TYPE_ARRAY: {
+            int64_t elem = t->as.array.size > 0 ? size / t->as.array.size : 0;
+            for (int64_t i = 0; i < t->as.array.size; i++) sysv_classify(c, t->as.array.base, offset + i * elem);
+            return;
+        }
+        case TYPE_VECTOR:
+            c->leaves++;
+            c->vector_leaf = t;
+            sysv_mark(c, offset, size, CLASS_SSE, false, true);
+            return;
+        case TYPE_PRIMITIVE:
+            c->leaves++;
+            if (t->as.primitive == PRIM_F32) sysv_mark(c, offset, size, CLASS_SSE, true, false);
+            else if (t->as.primitive == PRIM_F64) sysv_mark(c, offset, size, CLASS_SSE, false, true);
+            else sysv_mark(c, offset, size, CLASS_INTEGER, false, false);
+            return;
+        case TYPE_VOID:
+            return;
+        default: // pointers, functions, enums, slices
+            c->leaves++;
+            sysv_mark(c, offset, size, CLASS_INTEGER, false, false);
+            return;
+    }
+}
+
+static LLVMTypeRef sysv_part_type(CodegenContext *ctx, const Eightbyte *eb, uint64_t bytes) {
+    if (eb->cls == CLASS_INTEGER) return LLVMIntTypeInContext(ctx->context, (unsigned)(bytes * 8));
+    LLVMTypeRef f32 = LLVMFloatTypeInContext(ctx->context);
+    if (eb->wide_sse) return LLVMDoubleTypeInContext(ctx->context);
+    if (eb->f32_slots == 1) return f32;
+    return LLVMVectorType(f32, 2);
+}
+
+/* Register classes of a struct of at most 16 bytes; false when it is MEMORY. */
+static bool sysv_coerce(CodegenContext *ctx, Type *t, LLVMTypeRef *out, unsigned *int_regs, unsigned *sse_regs) {
+    SysvClassify c = {0};
+    sysv_classify(&c, t, 0);
+    uint64_t size = abi_size(ctx, t);
+    if (c.memory || size > 16) return false;
+
+    *int_regs = *sse_regs = 0;
+    if (size == 0) {
+        *out = NULL;
+        return true;
+    }
+
+    // A lone 16-byte vector is one xmm register (SSE + SSEUP)
+    if (c.leaves == 1 && c.vector_leaf && size == 16) {
+        *out = get_llvm_type(ctx, c.vector_leaf);
+        *sse_regs = 1;
+        return true;
+    }
+
+    unsigned count = size > 8 && c.parts[1].cls != CLASS_NONE ? 2 : 1;
+    if (c.parts[0].cls == CLASS_NONE) c.parts[0].cls = CLASS_INTEGER;
+    LLVMTypeRef parts[2];
+    for (unsigned k = 0; k < count; k++) {
+        uint64_t bytes = size - k * 8 < 8 ? size - k * 8 : 8;
+        parts[k] = sysv_part_type(ctx, &c.parts[k], bytes);
+        if (c.parts[k].cls == CLASS_INTEGER) (*int_regs)++;
+        else (*sse_regs)++;
+    }
+    if (count == 1) {
+        *out = parts[0];
+        return true;
+    }
+
+    // The second register is the second eightbyte: widen a lone float in front of a 4-aligned one
+    LLVMTypeRef pair = LLVMStructTypeInContext(ctx->context, parts, 2, 0);
+    if (LLVMOffsetOfElement(ctx->target_data, pair, 1) != 8) {
+        parts[0] = LLVMDoubleTypeInContext(ctx->context);
+        pair = LLVMStructTypeInContext(ctx->context, parts, 2, 0);
+    }
+    *out = pair;
+    return true;
+}
+
+/* Registers a by-value scalar takes (LLVM assigns them itself). */
+static void sysv_scalar_regs(Type *t, unsigned *int_regs, unsigned *sse_regs) {
+    *int_regs = *sse_regs = 0;
+    t = concrete(t);
+    if (!t || t->kind == TYPE_VOID || t->kind == TYPE_ARRAY) return;
+    if (t->kind == TYPE_VECTOR || type_is_float(t)) *sse_regs = 1;
+    else *int_regs = t->kind == TYPE_SLICE ? 2 : 1;
+}
+
+static void sysv_signature(CodegenContext *ctx, Type *fn_type, AbiSignature *sig) {
+    unsigned int_left = ABI_SYSV_INT_REGS, sse_left = ABI_SYSV_SSE_REGS;
+    unsigned int_regs = 0, sse_regs = 0;
+
+    Type *ret = fn_type->as.func.return_type;
+    if (is_aggregate(ret)) {
+        LLVMTypeRef coerce = NULL;
+        if (!sysv_coerce(ctx, ret, &coerce, &int_regs, &sse_regs)) sig->ret.kind = ABI_INDIRECT;
+        else if (coerce) sig->ret = (AbiArg){ .kind = ABI_COERCE, .coerce = coerce };
+    }
+    if (sig->ret.kind == ABI_INDIRECT) int_left--; // The sret pointer takes %rdi
+
+    for (size_t i = 0; i < sig->param_count; i++) {
+        Type *param = fn_type->as.func.params[i];
+        AbiArg *arg = &sig->params[i];
+        if (!is_aggregate(param)) {
+            sysv_scalar_regs(param, &int_regs, &sse_regs);
+        } else {
+            LLVMTypeRef coerce = NULL;
+            bool fits = sysv_coerce(ctx, param, &coerce, &int_regs, &sse_regs) && int_regs <= int_left && sse_regs <= sse_left;
+            if (!fits) {
+                *arg = (AbiArg){ .kind = ABI_INDIRECT, .byval = true };
+                continue;
+            }
+            if (coerce) *arg = (AbiArg){ .kind = ABI_COERCE, .coerce = coerce };
+        }
+        int_left -= int_regs < int_left ? int_regs : int_left;
+        sse_left -= sse_regs < sse_left ? sse_regs : sse_left;
+    }
+}
+
+// =============================================================================
+// SECTION: AAPCS64
+// =============================================================================
+
+/* Counts the float leaves of `t`; false as soon as one is not `*base`. */
+static bool hfa_members(Type *t, Type **base, unsigned *count) {
+    t = concrete(t);
+    if (!t) return false;
+    switch (t->kind) {
+        case TYPE_STRUCT:
+            for (size_t i = 0; i < t->as.struct_type.field_count; i++) {
+                if (!hfa_members(t->as.struct_type.fields[i].type, base, count)) return false;
+            }
+            return true;
+        case TYPE_ARRAY:
+            for (int64_t i = 0; i < t->as.array.size; i++) {
+                if (!hfa_members(t->as.array.base, base, count)) return false;
+            }
+            return true;
+        case TYPE_PRIMITIVE:
+            if (!type_is_float(t)) return false;
+            if (*base && (*base)->as.primitive != t->as.primitive) return false;
+            *base = t;
+            return ++(*count) <= ABI_AAPCS64_HFA_MAX;
+        default:
+            return false;
+    }
+}
+
+static AbiArg aapcs64_classify(CodegenContext *ctx, Type *t) {
+    uint64_t size = abi_size(ctx, t);
+    if (size == 0) return (AbiArg){ .kind = ABI_DIRECT };
+
+    Type *base = NULL;
+    unsigned count = 0;
+    if (hfa_members(t, &base, &count) && count > 0 && size == count * abi_size(ctx, base)) {
+        return (AbiArg){ .kind = ABI_COERCE, .coerce = LLVMArrayType(get_llvm_type(ctx, base), count) };
+    }
+    if (size <= 16) {
+        LLVMTypeRef i64 = LLVMInt64TypeInContext(ctx->context);
+        return (AbiArg){ .kind = ABI_COERCE, .coerce = size <= 8 ? i64 : LLVMArrayType(i64, 2) };
+    }
+    // Returned through x8; passed as a pointer to a copy the caller makes
+    return (AbiArg){ .kind = ABI_INDIRECT };
+}
+
+static void aapcs64_signature(CodegenContext *ctx, Type *fn_type, AbiSignature *sig) {
+    Type *ret = fn_type->as.func.return_type;
+    if (is_aggregate(ret)) sig->ret = aapcs64_classify(ctx, ret);
+    for (size_t i = 0; i < sig->param_count; i++) {
+        Type *param = fn_type->as.func.params[i];
+        if (is_aggregate(param)) sig->params[i] = aapcs64_classify(ctx, param);
+    }
+}
+
+// =============================================================================
+// SECTION: SIGNATURES
+// =============================================================================
+
+static void generic_signature(CodegenContext *ctx, Type *fn_type, AbiSignature *sig) {
+    Type *ret = fn_type->as.func.return_type;
+    if (is_aggregate(ret) && abi_size(ctx, ret) > 16) sig->ret.kind = ABI_INDIRECT;
+    for (size_t i = 0; i < sig->param_count; i++) {
+        Type *param = fn_type->as.func.params[i];
+        if (is_aggregate(param) && abi_size(ctx, param) > 16) sig->params[i] = (AbiArg){ .kind = ABI_INDIRECT, .byval = true };
+    }
+}
+
+const AbiSignature *codegen_abi_signature(CodegenContext *ctx, Type *fn_type) {
+    AbiSignature *sig = ptrmap_get(ctx->abi_signatures, fn_type);
+    if (sig) return sig;
+
+    size_t param_count = fn_type->as.func.param_count;
+    sig = xmalloc(sizeof(AbiSignature) + sizeof(AbiArg) * param_count);
+    // Fixed-size arrays always go through memory: byval pointer, sret result
+    bool array_ret = fn_type->as.func.return_type->kind == TYPE_ARRAY;
+    sig->ret = (AbiArg){ .kind = array_ret ? ABI_INDIRECT : ABI_DIRECT };
+    sig->param_count = param_count;
+    for (size_t i = 0; i < param_count; i++) {
+        bool array = fn_type->as.func.params[i]->kind == TYPE_ARRAY;
+        sig->params[i] = array ? (AbiArg){ .kind = ABI_INDIRECT, .byval = true } : (AbiArg){ .kind = ABI_DIRECT };
+    }
+
+    switch (ctx->abi) {
+        case CODEGEN_ABI_SYSV_X86_64: sysv_signature(ctx, fn_type, sig); break;
+        case CODEGEN_ABI_AAPCS64:     aapcs64_signature(ctx, fn_type, sig); break;
+        default:                      generic_signature(ctx, fn_type, sig); break;
+    }
+    ptrmap_put(ctx->abi_signatures, fn_type, sig);
+    return sig;
+}
+
+/* LLVM type of one argument or result as it crosses the call. */
+static LLVMTypeRef abi_arg_type(CodegenContext *ctx, const AbiArg *arg, Type *t) {
+    switch (arg->kind) {
+        case ABI_COERCE:   return arg->coerce;
+        case ABI_INDIRECT: return LLVMPointerType(get_llvm_type(ctx, t), 0);
+        default:           return get_llvm_type(ctx, t);
+    }
+}
+
+LLVMTypeRef get_llvm_function_type(CodegenContext *ctx, Type *t) {
+    if (!t || t->kind != TYPE_FUNCTION) return LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), NULL, 0, 0);
+
+    const AbiSignature *sig = codegen_abi_signature(ctx, t);
+    bool sret = sig->ret.kind == ABI_INDIRECT;
+    LLVMTypeRef ret_type = sret ? LLVMVoidTypeInContext(ctx->context) : abi_arg_type(ctx, &sig->ret, t->as.func.return_type);
+
+    size_t llvm_arg_count = sig->param_count + (sret ? 1 : 0);
+    LLVMTypeRef *llvm_params = xmalloc(sizeof(LLVMTypeRef) * (llvm_arg_count ? llvm_arg_count : 1));
+
+    size_t idx = 0;
+    if (sret) llvm_params[idx++] = LLVMPointerType(get_llvm_type(ctx, t->as.func.return_type), 0);
+    for (size_t i = 0; i < sig->param_count; i++) {
+        llvm_params[idx++] = abi_arg_type(ctx, &sig->params[i], t->as.func.params[i]);
+    }
+
+    LLVMTypeRef fn_ty = LLVMFunctionType(ret_type, llvm_params, (unsigned)llvm_arg_count, 0);
+    free(llvm_params);
+    return fn_ty;
+}
+
+static void add_abi_attribute(CodegenContext *ctx, LLVMValueRef fn_or_call, unsigned index, const char *name, LLVMTypeRef ty) {
+    LLVMAttributeRef attr = LLVMCreateTypeAttribute(ctx->context, LLVMGetEnumAttributeKindForName(name, strlen(name)), ty);
+    if (LLVMIsACallInst(fn_or_call)) LLVMAddCallSiteAttribute(fn_or_call, index, attr);
+    else LLVMAddAttributeAtIndex(fn_or_call, index, attr);
+}
+
+void codegen_abi_attributes(CodegenContext *ctx, LLVMValueRef fn_or_call, Type *fn_type) {
+    const AbiSignature *sig = codegen_abi_signature(ctx, fn_type);
+    unsigned idx = 1; // Parameter attributes start at index 1
+    if (sig->ret.kind == ABI_INDIRECT) {
+        add_abi_attribute(ctx, fn_or_call, idx++, "sret", get_llvm_type(ctx, fn_type->as.func.return_type));
+    }
+    for (size_t i = 0; i < sig->param_count; i++, idx++) {
+        if (sig->params[i].kind == ABI_INDIRECT && sig->params[i].byval) {
+            add_abi_attribute(ctx, fn_or_call, idx, "byval", get_llvm_type(ctx, fn_type->as.func.params[i]));
+        }
+    }
+}
+
+LLVMValueRef codegen_abi_coerce(CodegenContext *ctx, LLVMValueRef val, LLVMTypeRef to) {
+    LLVMTypeRef from = LLVMTypeOf(val);
+    if (from == to) return val;
+
+    // The slot holds the larger of the two, at the stricter alignment
+    bool to_larger = LLVMABISizeOfType(ctx->target_data, to) > LLVMABISizeOfType(ctx->target_data, from);
+    LLVMValueRef slot = create_entry_block_alloca(ctx, to_larger ? to : from, "abi_coerce");
+    unsigned align = LLVMABIAlignmentOfType(ctx->target_data, from);
+    if (LLVMABIAlignmentOfType(ctx->target_data, to) > align) align = LLVMABIAlignmentOfType(ctx->target_data, to);
+    LLVMSetAlignment(slot, align);
+
+    LLVMBuildStore(ctx->builder, val, slot);
+    return LLVMBuildLoad2(ctx->builder, to, slot, "abi_value");
+}
@@ -0,0 +1,479 @@
+/**
+ * @file codegen_async.c
+ * @brief Lowers async fns, `await` and the frame intrinsics (docs/lang/async.md).
+ *
+ * An async fn becomes two functions. The ramp, under the function's own
+ * symbol, allocates the frame through the caller's allocator, stores the
+ * arguments in it and runs the body to its first suspension:
+ *
+ *     ptr f(ptr alloc_ctx, ptr alloc_fn, ptr free_fn, params...)
+ *
+ * The body lives in `f.resume(ptr frame)`, which is generated like any other
+ * body and then turned into a state machine: every alloca (the result, the
+ * parameters, each local and temporary) becomes a field of the frame, and
+ * so does every value that is used outside the block defining it, so nothing
+ * lives in registers across a suspension. An entry switch on the frame's
+ * state jumps to the start or to the block after the suspension point the
+ * frame stopped at.
+ *
+ * The frame starts with a fixed header, then the result, so an awaiting
+ * caller finds both without knowing the callee's locals. LLVM's own
+ * coroutine passes are not used: CoroSplit in LLVM 14 does not handle the
+ * opaque pointers every module here is built with.
+ */
+
+#include "codegen_internal.h"
+#include "dynamic_array.h"
+#include "core/stats.h"
+
+enum {
+    FRAME_RESUME,  // void (*)(ptr frame): f.resume
+    FRAME_STATE,   // i32: 0 before the body started, k at resume point k, FRAME_DONE once returned
+    FRAME_WAITER,  // Frame awaiting this one, resumed when it is done (NULL: none)
+    FRAME_CTX,     // The allocator the frame came from: its ctx, _alloc and _free
+    FRAME_ALLOC,
+    FRAME_FREE,
+    FRAME_HEADER_FIELDS
+};
+
+#define FRAME_DONE (-1)
+
+static LLVMTypeRef ptr_type(CodegenContext *ctx) {
+    return LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+}
+
+static LLVMTypeRef i32_type(CodegenContext *ctx) {
+    return LLVMInt32TypeInContext(ctx->context);
+}
+
+/* The header, followed by the result of `ret` unless it is void. */
+static LLVMTypeRef frame_prefix_type(CodegenContext *ctx, Type *ret) {
+    LLVMTypeRef ptr = ptr_type(ctx);
+    LLVMTypeRef fields[FRAME_HEADER_FIELDS + 1] = { ptr, i32_type(ctx), ptr, ptr, ptr, ptr };
+    unsigned count = FRAME_HEADER_FIELDS;
+    if (ret && !type_is_void(ret)) fields[count++] = get_llvm_type(ctx, ret);
+    return LLVMStructTypeInContext(ctx->context, fields, count, 0);
+}
+
+static LLVMValueRef frame_field(CodegenContext *ctx, LLVMTypeRef frame_ty, LLVMValueRef frame, unsigned field) {
+    return LLVMBuildStructGEP2(ctx->builder, frame_ty, frame, field, "frame.field");
+}
+
+static LLVMValueRef load_header(CodegenContext *ctx, LLVMValueRef frame, unsigned field) {
+    LLVMTypeRef ty = field == FRAME_STATE ? i32_type(ctx) : ptr_type(ctx);
+    return LLVMBuildLoad2(ctx->builder, ty, frame_field(ctx, frame_prefix_type(ctx, NULL), frame, field), "frame.header");
+}
+
+static void store_header(CodegenContext *ctx, LLVMValueRef frame, unsigned field, LLVMValueRef val) {
+    LLVMBuildStore(ctx->builder, val, frame_field(ctx, frame_prefix_type(ctx, NULL), frame, field));
+}
+
+/* A parameter crosses into the ramp as codegen_expr yields it: arrays by address. */
+static LLVMTypeRef ramp_param_type(CodegenContext *ctx, Type *t) {
+    return type_is_address_only(t) ? ptr_type(ctx) : get_llvm_type(ctx, t);
+}
+
+LLVMTypeRef codegen_async_ramp_type(CodegenContext *ctx, Type *fn_type) {
+    size_t count = fn_type->as.func.param_count;
+    LLVMTypeRef *params = xmalloc(sizeof(LLVMTypeRef) * (count + 3));
+    params[0] = params[1] = params[2] = ptr_type(ctx);
+    for (size_t i = 0; i < count; i++) params[3 + i] = ramp_param_type(ctx, fn_type->as.func.params[i]);
+    LLVMTypeRef ty = LLVMFunctionType(ptr_type(ctx), params, (unsigned)(count + 3), 0);
+    free(params);
+    return ty;
+}
+
+static void free_frame(CodegenContext *ctx, LLVMValueRef frame) {
+    LLVMTypeRef free_ty = LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), (LLVMTypeRef[]){ ptr_type(ctx), ptr_type(ctx) }, 2, 0);
+    LLVMValueRef free_fn = load_header(ctx, frame, FRAME_FREE);
+    LLVMValueRef alloc_ctx = load_header(ctx, frame, FRAME_CTX);
+    LLVMBuildCall2(ctx->builder, free_ty, free_fn, (LLVMValueRef[]){ alloc_ctx, frame }, 2, "");
+}
+
+/* ---------------------------------------------------------------------------
+ * Calls: the ramp of `f(args)` with an allocator, as await and @spawn make it
+ * ------------------------------------------------------------------------- */
+
+static LLVMValueRef call_ramp(CodegenContext *ctx, AstNode *call, LLVMValueRef alloc[3]) {
+    Type *fn_type = call->data.call_expr.callee->type;
+    LLVMValueRef ramp = codegen_expr(ctx, call->data.call_expr.callee);
+    size_t count = fn_type->as.func.param_count;
+    LLVMValueRef *args = xmalloc(sizeof(LLVMValueRef) * (count + 3));
+    memcpy(args, alloc, sizeof(LLVMValueRef) * 3);
+    for (size_t i = 0; i < count; i++) args[3 + i] = codegen_expr(ctx, DYNARRAY_AT(AstNode*, call->data.call_expr.args, i));
+    LLVMValueRef frame = LLVMBuildCall2(ctx->builder, codegen_async_ramp_type(ctx, fn_type), ramp, args, (unsigned)(count + 3), "frame");
+    free(args);
+    return frame;
+}
+
+/* The ctx, _alloc and _free of an Allocator value or pointer, as @alloc reads them. */
+static void allocator_fields(CodegenContext *ctx, AstNode *allocator_arg, LLVMValueRef out[3]) {
+    Type *allocator_type = allocator_arg->type;
+    LLVMValueRef allocator_val = codegen_expr(ctx, allocator_arg);
+    if (allocator_type->kind == TYPE_POINTER) allocator_type = allocator_type->as.ptr.base;
+    if (LLVMGetTypeKind(LLVMTypeOf(allocator_val)) == LLVMPointerTypeKind) {
+        allocator_val = codegen_load_value(ctx, allocator_val, allocator_type);
+    }
+
+    static const char *const names[3] = { "ctx", "_alloc", "_free" };
+    for (int i = 0; i < 3; i++) {
+        size_t index;
+        if (!struct_field_index(allocator_type, names[i], &index)) ICE("@spawn allocator missing field '%s'", names[i]);
+        out[i] = LLVMBuildExtractValue(ctx->builder, allocator_val, codegen_field_slot(ctx, allocator_type, index), names[i]);
+    }
+}
+
+/* Ends the block at a new resume point: the frame stops there until it is resumed. */
+static void suspend_at(CodegenContext *ctx, LLVMBasicBlockRef resume_bb) {
+    dynarray_push_value(ctx->async_resumes, &resume_bb);
+    store_header(ctx, ctx->async_frame, FRAME_STATE, LLVMConstInt(i32_type(ctx), ctx->async_resumes->count, 0));
+    LLVMBuildRetVoid(ctx->builder);
+}
+
+/*
+ * await f(args): f's frame comes from the awaiting frame's allocator. If f
+ * is done at once its result is read straight away; otherwise this frame
+ * becomes f's waiter and suspends, and f's last resumption resumes it here.
+ */
+static LLVMValueRef codegen_await(CodegenContext *ctx, AstNode *expr) {
+    AstNode *call = DYNARRAY_AT(AstNode*, expr->data.intrinsic.args, 0);
+    LLVMValueRef self = ctx->async_frame;
+    LLVMValueRef alloc[3] = {
+        load_header(ctx, self, FRAME_CTX), load_header(ctx, self, FRAME_ALLOC), load_header(ctx, self, FRAME_FREE)
+    };
+    LLVMValueRef child = call_ramp(ctx, call, alloc);
+    LLVMValueRef slot = create_entry_block_alloca(ctx, ptr_type(ctx), "awaited");
+    LLVMBuildStore(ctx->builder, child, slot);
+
+    LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+    LLVMBasicBlockRef suspend_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "await.suspend");
+    LLVMBasicBlockRef resume_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "await.resume");
+    LLVMValueRef done = LLVMBuildICmp(ctx->builder, LLVMIntEQ, load_header(ctx, child, FRAME_STATE),
+                                      LLVMConstInt(i32_type(ctx), (unsigned long long)FRAME_DONE, 1), "await.done");
+    LLVMBuildCondBr(ctx->builder, done, resume_bb, suspend_bb);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, suspend_bb);
+    store_header(ctx, child, FRAME_WAITER, self);
+    suspend_at(ctx, resume_bb);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, resume_bb);
+    child = LLVMBuildLoad2(ctx->builder, ptr_type(ctx), slot, "awaited");
+    Type *ret = expr->type;
+    LLVMValueRef result = NULL;
+    if (!type_is_void(ret)) {
+        LLVMValueRef field = frame_field(ctx, frame_prefix_type(ctx, ret), child, FRAME_HEADER_FIELDS);
+        result = codegen_load_value(ctx, field, ret);
+        if (type_is_address_only(ret)) {
+            // The child's frame is about to go: keep the array in this one
+            LLVMValueRef copy = create_entry_block_alloca(ctx, get_llvm_type(ctx, ret), "awaited.result");
+            codegen_store_value(ctx, result, copy, ret);
+            result = copy;
+        }
+    }
+    free_frame(ctx, child);
+    return result;
+}
+
+/*
+ * @resume(frame) runs the frame to its next suspension. When that finishes
+ * it, the frame waiting on it resumes, and so on up the chain of awaits: a
+ * loop here rather than calls from inside each other, so a long chain takes
+ * no stack and a waiter only runs once the frame it waited for has stopped.
+ */
+static LLVMValueRef resume_trampoline(CodegenContext *ctx) {
+    static const char *const name = "newt.async.resume";
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, name);
+    if (fn) return fn;
+
+    LLVMTypeRef ptr = ptr_type(ctx);
+    LLVMTypeRef step_ty = LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), &ptr, 1, 0);
+    fn = LLVMAddFunction(ctx->module, name, step_ty);
+    LLVMSetLinkage(fn, LLVMInternalLinkage);
+    codegen_target_attributes(ctx, fn);
+
+    LLVMBuilderRef outer = ctx->builder;
+    ctx->builder = LLVMCreateBuilderInContext(ctx->context);
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->context, fn, "entry");
+    LLVMBasicBlockRef step = LLVMAppendBasicBlockInContext(ctx->context, fn, "step");
+    LLVMBasicBlockRef finished = LLVMAppendBasicBlockInContext(ctx->context, fn, "finished");
+    LLVMBasicBlockRef wake = LLVMAppendBasicBlockInContext(ctx->context, fn, "wake");
+    LLVMBasicBlockRef out = LLVMAppendBasicBlockInContext(ctx->context, fn, "out");
+
+    LLVMPositionBuilderAtEnd(ctx->builder, entry);
+    LLVMBuildBr(ctx->builder, step);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, step);
+    LLVMValueRef frame = LLVMBuildPhi(ctx->builder, ptr, "frame");
+    LLVMValueRef resume_fn = load_header(ctx, frame, FRAME_RESUME);
+    LLVMBuildCall2(ctx->builder, step_ty, resume_fn, &frame, 1, "");
+    LLVMValueRef done = LLVMBuildICmp(ctx->builder, LLVMIntEQ, load_header(ctx, frame, FRAME_STATE),
+                                      LLVMConstInt(i32_type(ctx), (unsigned long long)FRAME_DONE, 1), "done");
+    LLVMBuildCondBr(ctx->builder, done, finished, out);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, finished);
+    LLVMValueRef waiter = load_header(ctx, frame, FRAME_WAITER);
+    LLVMBuildCondBr(ctx->builder, LLVMBuildIsNull(ctx->builder, waiter, "no_waiter"), out, wake);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, wake);
+    store_header(ctx, frame, FRAME_WAITER, LLVMConstNull(ptr));
+    LLVMBuildBr(ctx->builder, step);
+
+    LLVMValueRef incoming[2] = { LLVMGetParam(fn, 0), waiter };
+    LLVMBasicBlockRef from[2] = { entry, wake };
+    LLVMAddIncoming(frame, incoming, from, 2);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, out);
+    LLVMBuildRetVoid(ctx->builder);
+
+    LLVMDisposeBuilder(ctx->builder);
+    ctx->builder = outer;
+    return fn;
+}
+
+LLVMValueRef codegen_async_intrinsic(CodegenContext *ctx, AstNode *expr) {
+    DynArray *args = expr->data.intrinsic.args;
+    switch (expr->data.intrinsic.kind) {
+        case INTRINSIC_AWAIT:
+            return codegen_await(ctx, expr);
+        case INTRINSIC_SPAWN: {
+            LLVMValueRef alloc[3];
+            allocator_fields(ctx, DYNARRAY_AT(AstNode*, args, 0), alloc);
+            return call_ramp(ctx, DYNARRAY_AT(AstNode*, args, 1), alloc);
+        }
+        case INTRINSIC_SUSPEND: {
+            LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+            LLVMBasicBlockRef resume_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "suspend.resume");
+            suspend_at(ctx, resume_bb);
+            LLVMPositionBuilderAtEnd(ctx->builder, resume_bb);
+            return NULL;
+        }
+        case INTRINSIC_FRAME:
+            return ctx->async_frame;
+        case INTRINSIC_RESUME: {
+            LLVMValueRef frame = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0));
+            LLVMValueRef fn = resume_trampoline(ctx);
+            LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(fn), fn, &frame, 1, "");
+            return NULL;
+        }
+        case INTRINSIC_DONE: {
+            LLVMValueRef frame = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0));
+            return LLVMBuildICmp(ctx->builder, LLVMIntEQ, load_header(ctx, frame, FRAME_STATE),
+                                 LLVMConstInt(i32_type(ctx), (unsigned long long)FRAME_DONE, 1), "done");
+        }
+        case INTRINSIC_DESTROY:
+            free_frame(ctx, codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0)));
+            return NULL;
+        default:
+            ICE("Intrinsic %d is not an async one", expr->data.intrinsic.kind);
+    }
+}
+
+void codegen_async_return(CodegenContext *ctx) {
+    store_header(ctx, ctx->async_frame, FRAME_STATE, LLVMConstInt(i32_type(ctx), (unsigned long long)FRAME_DONE, 1));
+    LLVMBuildRetVoid(ctx->builder);
+}
+
+/* ---------------------------------------------------------------------------
+ * The body: generated as usual, then every value that has to outlive a
+ * suspension moved into the frame
+ * ------------------------------------------------------------------------- */
+
+/* Users of `inst` that need it outside its own block: a phi, or any instruction in another block. */
+static size_t distant_users(LLVMValueRef inst, DynArray *out) {
+    LLVMBasicBlockRef bb = LLVMGetInstructionParent(inst);
+    size_t count = 0;
+    for (LLVMUseRef use = LLVMGetFirstUse(inst); use; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMGetInstructionParent(user) == bb && !LLVMIsAPHINode(user)) continue;
+        if (out) {
+            bool seen = false;
+            DYNARRAY_FOREACH(LLVMValueRef, it, out) seen |= *it == user;
+            if (!seen) dynarray_push_value(out, &user);
+        }
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Keep `inst` in a slot of its own: stored once it is computed, and loaded
+ * again at each distant use (a phi loads at the end of the incoming block).
+ * The slot becomes a frame field with the other allocas.
+ */
+static void demote_to_slot(CodegenContext *ctx, LLVMValueRef inst) {
+    LLVMTypeRef ty = LLVMTypeOf(inst);
+    DynArray users;
+    dynarray_init(&users, sizeof(LLVMValueRef));
+    distant_users(inst, &users);
+
+    LLVMValueRef slot = create_entry_block_alloca(ctx, ty, "spill");
+    LLVMValueRef after = LLVMGetNextInstruction(inst);
+    while (LLVMIsAPHINode(after)) after = LLVMGetNextInstruction(after);
+    LLVMPositionBuilderBefore(ctx->builder, after);
+    LLVMBuildStore(ctx->builder, inst, slot);
+
+    DYNARRAY_FOREACH(LLVMValueRef, user_it, &users) {
+        LLVMValueRef user = *user_it;
+        int operands = LLVMGetNumOperands(user);
+        for (int i = 0; i < operands; i++) {
+            if (LLVMGetOperand(user, (unsigned)i) != inst) continue;
+            if (LLVMIsAPHINode(user)) {
+                LLVMPositionBuilderBefore(ctx->builder, LLVMGetBasicBlockTerminator(LLVMGetIncomingBlock(user, (unsigned)i)));
+            } else {
+                LLVMPositionBuilderBefore(ctx->builder, user);
+            }
+            LLVMSetOperand(user, (unsigned)i, LLVMBuildLoad2(ctx->builder, ty, slot, "reload"));
+        }
+    }
+    dynarray_free(&users);
+}
+
+static void demote_distant_values(CodegenContext *ctx, LLVMValueRef func) {
+    DynArray values;
+    dynarray_init(&values, sizeof(LLVMValueRef));
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst; inst = LLVMGetNextInstruction(inst)) {
+            if (LLVMIsAAllocaInst(inst) || LLVMGetTypeKind(LLVMTypeOf(inst)) == LLVMVoidTypeKind) continue;
+            if (distant_users(inst, NULL) > 0) dynarray_push_value(&values, &inst);
+        }
+    }
+    DYNARRAY_FOREACH(LLVMValueRef, it, &values) demote_to_slot(ctx, *it);
+    dynarray_free(&values);
+}
+
+/*
+ * Lay the frame out (header, then `fixed`: the result and parameter slots
+ * in order, then every other alloca), point each alloca's uses at its field,
+ * and put the dispatch on the state in front of the body. Returns the frame
+ * type, which the ramp allocates.
+ */
+static LLVMTypeRef build_frame(CodegenContext *ctx, LLVMValueRef func, DynArray *fixed) {
+    DynArray slots;
+    dynarray_init(&slots, sizeof(LLVMValueRef));
+    DYNARRAY_FOREACH(LLVMValueRef, it, fixed) dynarray_push_value(&slots, it);
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst; inst = LLVMGetNextInstruction(inst)) {
+            if (!LLVMIsAAllocaInst(inst)) continue;
+            bool is_fixed = false;
+            DYNARRAY_FOREACH(LLVMValueRef, it, fixed) is_fixed |= *it == inst;
+            if (!is_fixed) dynarray_push_value(&slots, &inst);
+        }
+    }
+
+    LLVMTypeRef header = frame_prefix_type(ctx, NULL);
+    size_t field_count = FRAME_HEADER_FIELDS + slots.count;
+    LLVMTypeRef *fields = xmalloc(sizeof(LLVMTypeRef) * field_count);
+    LLVMGetStructElementTypes(header, fields);
+    for (size_t i = 0; i < slots.count; i++) fields[FRAME_HEADER_FIELDS + i] = LLVMGetAllocatedType(DYNARRAY_AT(LLVMValueRef, &slots, i));
+    LLVMTypeRef frame_ty = LLVMStructTypeInContext(ctx->context, fields, (unsigned)field_count, 0);
+    free(fields);
+
+    LLVMBasicBlockRef body = LLVMGetEntryBasicBlock(func);
+    LLVMBasicBlockRef dispatch = LLVMInsertBasicBlockInContext(ctx->context, body, "dispatch");
+    LLVMPositionBuilderAtEnd(ctx->builder, dispatch);
+    LLVMValueRef frame = LLVMGetParam(func, 0);
+    for (size_t i = 0; i < slots.count; i++) {
+        LLVMValueRef alloca = DYNARRAY_AT(LLVMValueRef, &slots, i);
+        LLVMReplaceAllUsesWith(alloca, frame_field(ctx, frame_ty, frame, (unsigned)(FRAME_HEADER_FIELDS + i)));
+        LLVMInstructionEraseFromParent(alloca);
+    }
+
+    LLVMValueRef state = load_header(ctx, frame, FRAME_STATE);
+    LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, state, body, (unsigned)ctx->async_resumes->count);
+    for (size_t k = 0; k < ctx->async_resumes->count; k++) {
+        LLVMAddCase(sw, LLVMConstInt(i32_type(ctx), k + 1, 0), DYNARRAY_AT(LLVMBasicBlockRef, ctx->async_resumes, k));
+    }
+    dynarray_free(&slots);
+    return frame_ty;
+}
+
+/* The ramp: allocate the frame, fill in its header and arguments, and run it to its first suspension. */
+static void build_ramp(CodegenContext *ctx, AstNode *decl, LLVMValueRef ramp, LLVMValueRef resume, LLVMTypeRef frame_ty) {
+    Type *fn_type = decl->type;
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->context, ramp, "entry");
+    LLVMPositionBuilderAtEnd(ctx->builder, entry);
+
+    LLVMTypeRef ptr = ptr_type(ctx);
+    LLVMTypeRef alloc_ty = LLVMFunctionType(ptr, (LLVMTypeRef[]){ ptr, LLVMInt64TypeInContext(ctx->context) }, 2, 0);
+    LLVMValueRef alloc_ctx = LLVMGetParam(ramp, 0), alloc_fn = LLVMGetParam(ramp, 1);
+    LLVMValueRef frame = LLVMBuildCall2(ctx->builder, alloc_ty, alloc_fn, (LLVMValueRef[]){ alloc_ctx, LLVMSizeOf(frame_ty) }, 2, "frame");
+
+    store_header(ctx, frame, FRAME_RESUME, resume);
+    store_header(ctx, frame, FRAME_STATE, LLVMConstInt(i32_type(ctx), 0, 0));
+    store_header(ctx, frame, FRAME_WAITER, LLVMConstNull(ptr));
+    store_header(ctx, frame, FRAME_CTX, alloc_ctx);
+    store_header(ctx, frame, FRAME_ALLOC, alloc_fn);
+    store_header(ctx, frame, FRAME_FREE, LLVMGetParam(ramp, 2));
+
+    unsigned first_param = FRAME_HEADER_FIELDS + (type_is_void(fn_type->as.func.return_type) ? 0 : 1);
+    for (size_t i = 0; i < fn_type->as.func.param_count; i++) {
+        LLVMValueRef field = frame_field(ctx, frame_ty, frame, first_param + (unsigned)i);
+        codegen_store_value(ctx, LLVMGetParam(ramp, 3 + (unsigned)i), field, fn_type->as.func.params[i]);
+    }
+
+    LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(resume), resume, &frame, 1, "");
+    LLVMBuildRet(ctx->builder, frame);
+}
+
+void codegen_async_function(CodegenContext *ctx, AstNode *decl, LLVMValueRef ramp) {
+    AstFunctionDeclaration *fdecl = &decl->data.function_declaration;
+    Type *fn_type = decl->type;
+    Type *ret = fn_type->as.func.return_type;
+
+    const char *name = codegen_decl_name(ctx, decl);
+    size_t name_len = strlen(name);
+    char *resume_name = xmalloc(name_len + sizeof(".resume"));
+    memcpy(resume_name, name, name_len);
+    memcpy(resume_name + name_len, ".resume", sizeof(".resume"));
+    LLVMTypeRef ptr = ptr_type(ctx);
+    LLVMValueRef resume = LLVMAddFunction(ctx->module, resume_name, LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), &ptr, 1, 0));
+    LLVMSetLinkage(resume, LLVMInternalLinkage);
+    codegen_target_attributes(ctx, resume);
+    free(resume_name);
+
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->context, resume, "entry");
+    LLVMPositionBuilderAtEnd(ctx->builder, entry);
+
+    DynArray resumes, fixed;
+    dynarray_init(&resumes, sizeof(LLVMBasicBlockRef));
+    dynarray_init(&fixed, sizeof(LLVMValueRef));
+    size_t locals_mark = codegen_locals_enter(ctx);
+    ctx->current_func_type = fn_type;
+    ctx->deferred_actions->count = 0;
+    ctx->loop_defer_count = 0;
+    ctx->sret_ptr = NULL;
+    ctx->sret_local = NULL;
+    ctx->async_frame = LLVMGetParam(resume, 0);
+    ctx->async_resumes = &resumes;
+    codegen_find_stack_allocs(ctx, decl);
+    codegen_find_safe_subscripts(ctx, decl);
+
+    // The result and the parameters come first in the frame, where callers and the ramp find them
+    ctx->ret_val_var = NULL;
+    if (!type_is_void(ret)) {
+        ctx->ret_val_var = create_entry_block_alloca(ctx, get_llvm_type(ctx, ret), "result");
+        dynarray_push_value(&fixed, &ctx->ret_val_var);
+    }
+    for (size_t i = 0; fdecl->params && i < fdecl->params->count; i++) {
+        AstNode *param_node = DYNARRAY_AT(AstNode*, fdecl->params, i);
+        LLVMValueRef storage = create_entry_block_alloca(ctx, get_llvm_type(ctx, param_node->type), "param");
+        dynarray_push_value(&fixed, &storage);
+        if (param_node->data.param.name_idx != -1) codegen_locals_put(ctx, param_node->data.param.name_idx, storage);
+    }
+
+    codegen_statement(ctx, fdecl->body);
+    if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) codegen_async_return(ctx);
+
+    demote_distant_values(ctx, resume);
+    LLVMTypeRef frame_ty = build_frame(ctx, resume, &fixed);
+    build_ramp(ctx, decl, ramp, resume, frame_ty);
+
+    codegen_locals_leave(ctx, locals_mark);
+    ctx->current_func_type = NULL;
+    ctx->ret_val_var = NULL;
+    ctx->async_frame = NULL;
+    ctx->async_resumes = NULL;
+    dynarray_free(&resumes);
+    dynarray_free(&fixed);
+    STAT_ADD(CODEGEN_BLOCKS, LLVMCountBasicBlocks(resume));
+}
@@ -0,0 +1,104 @@
+/**
+ * @file codegen_atomic.c
+ * @brief Lowers @atomic_load, @atomic_store, @atomic_cas, @atomic_rmw and @fence.
+ *
+ * Each maps onto one LLVM atomic instruction carrying the ordering written
+ * in the source; none of them is singlethread, so they order memory across
+ * threads as well as against signal handlers.
+ */
+
+#include "codegen_internal.h"
+
+static LLVMAtomicOrdering llvm_order(AstNode *arg) {
+    Slice *name = (Slice*)arg->data.identifier.intern_result->key;
+    switch (atomic_order_named(name->ptr, name->len)) {
+        case ATOMIC_RELAXED: return LLVMAtomicOrderingMonotonic;
+        case ATOMIC_ACQUIRE: return LLVMAtomicOrderingAcquire;
+        case ATOMIC_RELEASE: return LLVMAtomicOrderingRelease;
+        case ATOMIC_ACQ_REL: return LLVMAtomicOrderingAcquireRelease;
+        case ATOMIC_SEQ_CST: return LLVMAtomicOrderingSequentiallyConsistent;
+        default: ICE("Atomic ordering not checked by sema");
+    }
+}
+
+/* The load half of a success ordering: what a failed @atomic_cas orders by default. */
+static LLVMAtomicOrdering failure_order_for(LLVMAtomicOrdering success) {
+    switch (success) {
+        case LLVMAtomicOrderingRelease:        return LLVMAtomicOrderingMonotonic;
+        case LLVMAtomicOrderingAcquireRelease: return LLVMAtomicOrderingAcquire;
+        default:                               return success;
+    }
+}
+
+static LLVMAtomicRMWBinOp llvm_rmw_op(AstNode *arg, Type *t) {
+    Slice *name = (Slice*)arg->data.identifier.intern_result->key;
+    bool is_unsigned = type_is_unsigned(t);
+    switch (atomic_rmw_op_named(name->ptr, name->len)) {
+        case ATOMIC_RMW_XCHG: return LLVMAtomicRMWBinOpXchg;
+        case ATOMIC_RMW_ADD:  return LLVMAtomicRMWBinOpAdd;
+        case ATOMIC_RMW_SUB:  return LLVMAtomicRMWBinOpSub;
+        case ATOMIC_RMW_AND:  return LLVMAtomicRMWBinOpAnd;
+        case ATOMIC_RMW_OR:   return LLVMAtomicRMWBinOpOr;
+        case ATOMIC_RMW_XOR:  return LLVMAtomicRMWBinOpXor;
+        case ATOMIC_RMW_MIN:  return is_unsigned ? LLVMAtomicRMWBinOpUMin : LLVMAtomicRMWBinOpMin;
+        case ATOMIC_RMW_MAX:  return is_unsigned ? LLVMAtomicRMWBinOpUMax : LLVMAtomicRMWBinOpMax;
+        default: ICE("Atomic operation not checked by sema");
+    }
+}
+
+/* Atomic accesses must be naturally aligned, which every Newt scalar is. */
+static void set_natural_alignment(CodegenContext *ctx, LLVMValueRef inst, LLVMTypeRef ty) {
+    LLVMSetAlignment(inst, (unsigned)LLVMABISizeOfType(ctx->target_data, ty));
+}
+
+LLVMValueRef codegen_atomic_intrinsic(CodegenContext *ctx, AstNode *expr) {
+    DynArray *args = expr->data.intrinsic.args;
+    AstNode *a0 = DYNARRAY_AT(AstNode*, args, 0);
+
+    switch (expr->data.intrinsic.kind) {
+        case INTRINSIC_ATOMIC_LOAD: {
+            LLVMTypeRef ty = get_llvm_type(ctx, expr->type);
+            LLVMValueRef load = LLVMBuildLoad2(ctx->builder, ty, codegen_expr(ctx, a0), "atomic_load");
+            LLVMSetOrdering(load, llvm_order(DYNARRAY_AT(AstNode*, args, 1)));
+            set_natural_alignment(ctx, load, ty);
+            return load;
+        }
+
+        case INTRINSIC_ATOMIC_STORE: {
+            LLVMValueRef ptr = codegen_expr(ctx, a0);
+            LLVMValueRef val = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1));
+            LLVMValueRef store = LLVMBuildStore(ctx->builder, val, ptr);
+            LLVMSetOrdering(store, llvm_order(DYNARRAY_AT(AstNode*, args, 2)));
+            set_natural_alignment(ctx, store, LLVMTypeOf(val));
+            return NULL;
+        }
+
+        case INTRINSIC_ATOMIC_CAS: {
+            LLVMValueRef ptr = codegen_expr(ctx, a0);
+            LLVMValueRef expected = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1));
+            LLVMValueRef desired = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 2));
+            LLVMAtomicOrdering success = llvm_order(DYNARRAY_AT(AstNode*, args, 3));
+            LLVMAtomicOrdering failure = args->count == 5 ? llvm_order(DYNARRAY_AT(AstNode*, args, 4)) : failure_order_for(success);
+            LLVMValueRef pair = LLVMBuildAtomicCmpXchg(ctx->builder, ptr, expected, desired, success, failure, false);
+            return LLVMBuildExtractValue(ctx->builder, pair, 0, "cas_old");
+        }
+
+        case INTRINSIC_ATOMIC_RMW: {
+            Type *t = expr->type;
+            LLVMAtomicRMWBinOp op = llvm_rmw_op(a0, t);
+            LLVMValueRef ptr = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1));
+            LLVMValueRef val = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 2));
+            LLVMAtomicOrdering order = llvm_order(DYNARRAY_AT(AstNode*, args, 3));
+            // LLVM 14's atomicrmw only takes integers: exchange a pointer as its address
+            bool is_pointer = t->kind == TYPE_POINTER;
+            LLVMTypeRef int_ptr = LLVMIntPtrTypeInContext(ctx->context, ctx->target_data);
+            if (is_pointer) val = LLVMBuildPtrToInt(ctx->builder, val, int_ptr, "xchg_addr");
+            LLVMValueRef old = LLVMBuildAtomicRMW(ctx->builder, op, ptr, val, order, false);
+            return is_pointer ? LLVMBuildIntToPtr(ctx->builder, old, get_llvm_type(ctx, t), "xchg_old") : old;
+        }
+
+        default: // @fence
+            LLVMBuildFence(ctx->builder, llvm_order(a0), false, "");
+            return NULL;
+    }
+}
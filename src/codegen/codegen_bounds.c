@@ -0,0 +1,380 @@
+/**
+ * @file codegen_bounds.c
+ * @brief --bounds-checks: array and slice subscripts trap when out of range.
+ *
+ * Each checked subscript compares its index, unsigned, against the length
+ * and branches to a cold block of the function that calls llvm.trap. Checks
+ * the compiler can prove redundant are left out:
+ *
+ *   - a constant index into an array (or table literal) shorter than it;
+ *   - `X[i]` in the body of `for (i: usize = ...; i < X.len ...; ...)`,
+ *     where X is a local or parameter and the body neither writes `i` nor
+ *     (for a slice) X, nor takes either's address, and (for a slice) X's
+ *     address is not taken anywhere in the function, since a pointer taken
+ *     before the loop could rebind it from inside. The condition was checked
+ *     on the way into the body and nothing since could have changed it.
+ *
+ * Pointers carry no length and are never checked.
+ */
+
+#include "codegen_internal.h"
+#include "core/stats.h"
+
+typedef struct {
+    AstNode *index;     // Decl of the loop variable
+    AstNode *container; // Decl of the array or slice it is bounded by
+    bool slice;         // The container is a slice, whose length can change
+} BoundsProof;
+
+typedef struct {
+    CodegenContext *ctx;
+    AstNode *body;     // The function body, searched for addresses taken
+    HashMap *locals;   // var / param decl -> itself: declared in this function
+    DynArray proofs;   // DynArray<BoundsProof>: loops enclosing the node being scanned
+} BoundsScan;
+
+static AstNode *local_decl_of(BoundsScan *s, AstNode *node) {
+    if (!node || node->node_type != AST_IDENTIFIER) return NULL;
+    Symbol *sym = node->data.identifier.symbol;
+    if (!sym || sym->kind != SYMBOL_VARIABLE || !sym->decl_node) return NULL;
+    return ptrmap_get(s->locals, sym->decl_node) ? sym->decl_node : NULL;
+}
+
+/* The variable a write to `lvalue` lands in, through field accesses only:
+ * `X[j] = v` stores to an element and leaves X itself alone. */
+static AstNode *written_root(AstNode *lvalue) {
+    while (lvalue && lvalue->node_type == AST_MEMBER_EXPR && !lvalue->data.member_expr.is_instance_method) {
+        lvalue = lvalue->data.member_expr.target;
+    }
+    if (!lvalue || lvalue->node_type != AST_IDENTIFIER || !lvalue->data.identifier.symbol) return NULL;
+    return lvalue->data.identifier.symbol->decl_node;
+}
+
+typedef struct {
+    AstNode *decls[2];
+    bool addresses_only;    // Only taking an address counts, not a store
+    bool written;
+} WriteScan;
+
+static void note_write(WriteScan *w, AstNode *lvalue, bool address) {
+    if (w->addresses_only && !address) return;
+    AstNode *root = written_root(lvalue);
+    if (root && (root == w->decls[0] || root == w->decls[1])) w->written = true;
+}
+
+static void find_writes(WriteScan *w, AstNode *node);
+
+static void find_writes_list(WriteScan *w, DynArray *nodes) {
+    if (!nodes) return;
+    DYNARRAY_FOREACH(AstNode*, node_it, nodes) find_writes(w, *node_it);
+}
+
+/* Whether anything under `node` assigns, steps or takes the address of one of `w->decls`. */
+static void find_writes(WriteScan *w, AstNode *node) {
+    if (!node || w->written) return;
+    switch (node->node_type) {
+        case AST_VARIABLE_DECLARATION:
+            find_writes(w, node->data.variable_declaration.initializer);
+            break;
+        case AST_BLOCK:
+            find_writes_list(w, node->data.block.statements);
+            break;
+        case AST_IF_STATEMENT:
+            find_writes(w, node->data.if_statement.condition);
+            find_writes(w, node->data.if_statement.then_branch);
+            find_writes(w, node->data.if_statement.else_branch);
+            break;
+        case AST_WHILE_STATEMENT:
+            find_writes(w, node->data.while_statement.condition);
+            find_writes(w, node->data.while_statement.body);
+            break;
+        case AST_SWITCH_STATEMENT:
+            find_writes(w, node->data.switch_statement.subject);
+            DYNARRAY_FOREACH(AstNode*, arm_it, node->data.switch_statement.cases) find_writes(w, (*arm_it)->data.switch_case.body);
+            find_writes(w, node->data.switch_statement.else_body);
+            break;
+        case AST_FOR_STATEMENT:
+            find_writes(w, node->data.for_statement.init);
+            find_writes(w, node->data.for_statement.condition);
+            find_writes(w, node->data.for_statement.post);
+            find_writes(w, node->data.for_statement.range);
+            find_writes(w, node->data.for_statement.body);
+            break;
+        case AST_RETURN_STATEMENT:
+            find_writes(w, node->data.return_statement.expression);
+            break;
+        case AST_DEFER_STATEMENT:
+            find_writes(w, node->data.defer_statement.body);
+            break;
+        case AST_EXPR_STATEMENT:
+            find_writes(w, node->data.expr_statement.expression);
+            break;
+
+        case AST_ASSIGNMENT_EXPR:
+            note_write(w, node->data.assignment_expr.lvalue, false);
+            find_writes(w, node->data.assignment_expr.lvalue);
+            find_writes(w, node->data.assignment_expr.rvalue);
+            break;
+        case AST_POSTFIX_EXPR:
+            note_write(w, node->data.postfix_expr.expr, false);
+            find_writes(w, node->data.postfix_expr.expr);
+            break;
+        case AST_UNARY_EXPR: {
+            OpKind op = node->data.unary_expr.op;
+            if (op == OP_ADDRESS || op == OP_PRE_INC || op == OP_PRE_DEC) note_write(w, node->data.unary_expr.expr, op == OP_ADDRESS);
+            find_writes(w, node->data.unary_expr.expr);
+            break;
+        }
+        case AST_BINARY_EXPR:
+            find_writes(w, node->data.binary_expr.left);
+            find_writes(w, node->data.binary_expr.right);
+            break;
+        case AST_SUBSCRIPT_EXPR:
+            find_writes(w, node->data.subscript_expr.target);
+            find_writes(w, node->data.subscript_expr.index);
+            break;
+        case AST_MEMBER_EXPR:
+            // A method gets its receiver's address
+            if (node->data.member_expr.is_instance_method) note_write(w, node->data.member_expr.target, true);
+            find_writes(w, node->data.member_expr.target);
+            break;
+        case AST_CALL_EXPR:
+            find_writes(w, node->data.call_expr.callee);
+            find_writes_list(w, node->data.call_expr.args);
+            break;
+        case AST_INTRINSIC:
+            find_writes_list(w, node->data.intrinsic.args);
+            break;
+        case AST_GENERIC_INST_EXPR:
+            find_writes(w, node->data.generic_inst_expr.base);
+            break;
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) find_writes(w, init->expr);
+            }
+            break;
+        case AST_CAST:
+            find_writes(w, node->data.cast_expr.expr);
+            break;
+        case AST_INITIALIZER_LIST:
+            find_writes_list(w, node->data.initializer_list.elements);
+            break;
+        default:
+            break;
+    }
+}
+
+/* `cond` (or an `&&` operand of it) is `i < X.len` with `i` the unsigned loop variable `index`. */
+static bool find_bound(BoundsScan *s, AstNode *cond, AstNode *index, BoundsProof *out) {
+    if (!cond || cond->node_type != AST_BINARY_EXPR) return false;
+    AstBinaryExpr *bin = &cond->data.binary_expr;
+    if (bin->op == OP_AND) return find_bound(s, bin->left, index, out) || find_bound(s, bin->right, index, out);
+    if (bin->op != OP_LT || local_decl_of(s, bin->left) != index) return false;
+
+    AstNode *len = bin->right;
+    if (len->node_type != AST_MEMBER_EXPR || len->data.member_expr.member != s->ctx->store->kw_len) return false;
+    AstNode *container = local_decl_of(s, len->data.member_expr.target);
+    Type *t = len->data.member_expr.target->type;
+    if (!container || !t || (t->kind != TYPE_ARRAY && t->kind != TYPE_SLICE)) return false;
+
+    out->index = index;
+    out->container = container;
+    out->slice = t->kind == TYPE_SLICE;
+    return true;
+}
+
+/* The bound a C-style loop keeps on each entry to its body, if any. */
+static bool loop_proof(BoundsScan *s, AstNode *loop, BoundsProof *out) {
+    AstForStatement *fs = &loop->data.for_statement;
+    AstNode *init = fs->init;
+    if (fs->range || !init || init->node_type != AST_VARIABLE_DECLARATION || !init->type || !type_is_unsigned(init->type)) return false;
+    if (!find_bound(s, fs->condition, init, out)) return false;
+
+    // An array's length is fixed, so only the index has to stay put
+    WriteScan w = { .decls = { out->index, out->slice ? out->container : NULL } };
+    find_writes(&w, fs->body);
+    if (w.written) return false;
+    if (!out->slice) return true;
+
+    // The index is declared by the loop, but a pointer to the slice may predate it
+    WriteScan escaped = { .decls = { out->container, NULL }, .addresses_only = true };
+    find_writes(&escaped, s->body);
+    return !escaped.written;
+}
+
+static void scan(BoundsScan *s, AstNode *node);
+
+static void scan_list(BoundsScan *s, DynArray *nodes) {
+    if (!nodes) return;
+    DYNARRAY_FOREACH(AstNode*, node_it, nodes) scan(s, *node_it);
+}
+
+static void scan_subscript(BoundsScan *s, AstNode *node) {
+    AstNode *container = local_decl_of(s, node->data.subscript_expr.target);
+    AstNode *index = local_decl_of(s, node->data.subscript_expr.index);
+    if (!container || !index) return;
+    DYNARRAY_FOREACH(BoundsProof, proof, &s->proofs) {
+        if (proof->index == index && proof->container == container) {
+            if (!s->ctx->safe_subscripts) s->ctx->safe_subscripts = hashmap_create(NULL, 16);
+            ptrmap_put(s->ctx->safe_subscripts, node, node);
+            return;
+        }
+    }
+}
+
+static void scan(BoundsScan *s, AstNode *node) {
+    if (!node) return;
+    switch (node->node_type) {
+        case AST_VARIABLE_DECLARATION:
+            ptrmap_put(s->locals, node, node);
+            scan(s, node->data.variable_declaration.initializer);
+            break;
+        case AST_BLOCK:
+            scan_list(s, node->data.block.statements);
+            break;
+        case AST_IF_STATEMENT:
+            scan(s, node->data.if_statement.condition);
+            scan(s, node->data.if_statement.then_branch);
+            scan(s, node->data.if_statement.else_branch);
+            break;
+        case AST_WHILE_STATEMENT:
+            scan(s, node->data.while_statement.condition);
+            scan(s, node->data.while_statement.body);
+            break;
+        case AST_SWITCH_STATEMENT:
+            scan(s, node->data.switch_statement.subject);
+            DYNARRAY_FOREACH(AstNode*, arm_it, node->data.switch_statement.cases) scan(s, (*arm_it)->data.switch_case.body);
+            scan(s, node->data.switch_statement.else_body);
+            break;
+        case AST_FOR_STATEMENT: {
+            scan(s, node->data.for_statement.init);
+            scan(s, node->data.for_statement.condition);
+            scan(s, node->data.for_statement.post);
+            scan(s, node->data.for_statement.range);
+            BoundsProof proof;
+            bool proven = loop_proof(s, node, &proof);
+            if (proven) dynarray_push_value(&s->proofs, &proof);
+            scan(s, node->data.for_statement.body);
+            if (proven) s->proofs.count--;
+            break;
+        }
+        case AST_RETURN_STATEMENT:
+            scan(s, node->data.return_statement.expression);
+            break;
+        case AST_DEFER_STATEMENT:
+            scan(s, node->data.defer_statement.body);
+            break;
+        case AST_EXPR_STATEMENT:
+            scan(s, node->data.expr_statement.expression);
+            break;
+
+        case AST_SUBSCRIPT_EXPR:
+            if (s->proofs.count > 0) scan_subscript(s, node);
+            scan(s, node->data.subscript_expr.target);
+            scan(s, node->data.subscript_expr.index);
+            break;
+        case AST_MEMBER_EXPR:
+            scan(s, node->data.member_expr.target);
+            break;
+        case AST_UNARY_EXPR:
+            scan(s, node->data.unary_expr.expr);
+            break;
+        case AST_BINARY_EXPR:
+            scan(s, node->data.binary_expr.left);
+            scan(s, node->data.binary_expr.right);
+            break;
+        case AST_POSTFIX_EXPR:
+            scan(s, node->data.postfix_expr.expr);
+            break;
+        case AST_ASSIGNMENT_EXPR:
+            scan(s, node->data.assignment_expr.lvalue);
+            scan(s, node->data.assignment_expr.rvalue);
+            break;
+        case AST_CALL_EXPR:
+            scan(s, node->data.call_expr.callee);
+            scan_list(s, node->data.call_expr.args);
+            break;
+        case AST_INTRINSIC:
+            scan_list(s, node->data.intrinsic.args);
+            break;
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) scan(s, init->expr);
+            }
+            break;
+        case AST_CAST:
+            scan(s, node->data.cast_expr.expr);
+            break;
+        case AST_INITIALIZER_LIST:
+            scan_list(s, node->data.initializer_list.elements);
+            break;
+        default:
+            break;
+    }
+}
+
+void codegen_find_safe_subscripts(CodegenContext *ctx, AstNode *func) {
+    if (ctx->safe_subscripts) hashmap_destroy(ctx->safe_subscripts, NULL, NULL);
+    ctx->safe_subscripts = NULL;
+    ctx->bounds_trap_bb = NULL;
+
+    AstNode *body = func->data.function_declaration.body;
+    if (!ctx->bounds_checks || !body) return;
+
+    BoundsScan s = { .ctx = ctx, .body = body, .locals = hashmap_create(NULL, 16) };
+    dynarray_init(&s.proofs, sizeof(BoundsProof));
+    DynArray *params = func->data.function_declaration.params;
+    if (params) DYNARRAY_FOREACH(AstNode*, param_it, params) ptrmap_put(s.locals, *param_it, *param_it);
+    scan(&s, body);
+    dynarray_free(&s.proofs);
+    hashmap_destroy(s.locals, NULL, NULL);
+}
+
+/* The function's one trap block, created on first use. */
+static LLVMBasicBlockRef trap_block(CodegenContext *ctx, LLVMValueRef func) {
+    if (ctx->bounds_trap_bb && LLVMGetBasicBlockParent(ctx->bounds_trap_bb) == func) return ctx->bounds_trap_bb;
+
+    LLVMBasicBlockRef here = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef trap_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "bounds.trap");
+    LLVMPositionBuilderAtEnd(ctx->builder, trap_bb);
+    unsigned id = LLVMLookupIntrinsicID("llvm.trap", 9);
+    LLVMValueRef trap = LLVMGetIntrinsicDeclaration(ctx->module, id, NULL, 0);
+    LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(trap), trap, NULL, 0, "");
+    LLVMBuildUnreachable(ctx->builder);
+    LLVMPositionBuilderAtEnd(ctx->builder, here);
+    ctx->bounds_trap_bb = trap_bb;
+    return trap_bb;
+}
+
+void codegen_bounds_check(CodegenContext *ctx, AstNode *subscript, LLVMValueRef idx, LLVMValueRef len) {
+    if (!ctx->bounds_checks) return;
+    if (ctx->safe_subscripts && ptrmap_get(ctx->safe_subscripts, subscript)) {
+        STAT_INC(BOUNDS_ELIDED);
+        return;
+    }
+
+    // Unsigned, a negative index is past any length
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(ctx->context);
+    Type *index_type = subscript->data.subscript_expr.index->type;
+    idx = LLVMBuildIntCast2(ctx->builder, idx, i64, index_type && !type_is_unsigned(index_type), "bounds.idx");
+    if (LLVMIsAConstantInt(idx) && LLVMIsAConstantInt(len) &&
+        LLVMConstIntGetZExtValue(idx) < LLVMConstIntGetZExtValue(len)) {
+        STAT_INC(BOUNDS_ELIDED);
+        return;
+    }
+
+    STAT_INC(BOUNDS_CHECKS);
+    LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+    LLVMBasicBlockRef ok_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "bounds.ok");
+    LLVMValueRef in_range = LLVMBuildICmp(ctx->builder, LLVMIntULT, idx, len, "bounds.in_range");
+    LLVMValueRef br = LLVMBuildCondBr(ctx->builder, in_range, ok_bb, trap_block(ctx, func));
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+    LLVMMetadataRef weights[] = {
+        LLVMMDStringInContext2(ctx->context, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 2000, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 1, 0)),
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(ctx->context, "prof", 4),
+                    LLVMMetadataAsValue(ctx->context, LLVMMDNodeInContext2(ctx->context, weights, 3)));
+    LLVMPositionBuilderAtEnd(ctx->builder, ok_bb);
+}
@@ -9,6 +9,7 @@
 
 #include "codegen_internal.h"
 #include "codegen/codegen_utils.h"
+#include "sema/purity.h"
 #include <stdio.h>
 
 // Forward declaration for recursive printing (e.g., arrays of structs, nested structs)
@@ -34,6 +35,16 @@ static void codegen_intrinsic_print_str_lit(CodegenContext *ctx, const char *s)
     LLVMBuildCall2(ctx->builder, fn_ty, fn, &str, 1, "");
 }
 
+/* Field `i` of the struct `val`, which is either loaded or still in memory. */
+static LLVMValueRef print_struct_field(CodegenContext *ctx, LLVMValueRef val, Type *t, size_t i) {
+    unsigned slot = codegen_field_slot(ctx, t, i);
+    if (LLVMGetTypeKind(LLVMTypeOf(val)) == LLVMPointerTypeKind) {
+        LLVMValueRef field_ptr = LLVMBuildStructGEP2(ctx->builder, get_llvm_type(ctx, t), val, slot, "field_ptr");
+        return codegen_load_value(ctx, field_ptr, t->as.struct_type.fields[i].type);
+    }
+    return LLVMBuildExtractValue(ctx->builder, val, slot, "field_val");
+}
+
 /**
  * Recursively generates LLVM IR to print an arbitrary compiler value based on its Type.
  * This dynamically dispatches to runtime functions (e.g., print_i32, print_bool) 
@@ -139,23 +150,26 @@ static void codegen_intrinsic_print_value(CodegenContext *ctx, LLVMValueRef val,
             snprintf(field_prefix, sizeof(field_prefix), "%.*s: ", (int)fname->len, fname->ptr);
             codegen_intrinsic_print_str_lit(ctx, field_prefix);
             
-            // Extract field value depending on whether 'val' is a pointer (lvalue) or loaded struct
-            LLVMValueRef field_val;
-            LLVMTypeRef struct_ty = get_llvm_type(ctx, t);
-            if (LLVMGetTypeKind(LLVMTypeOf(val)) == LLVMPointerTypeKind) {
-                field_val = LLVMBuildStructGEP2(ctx->builder, struct_ty, val, (unsigned)i, "field_ptr");
-                field_val = codegen_load_value(ctx, field_val, t->as.struct_type.fields[i].type);
-            } else {
-                field_val = LLVMBuildExtractValue(ctx->builder, val, (unsigned)i, "field_val");
-            }
-            
             // Recurse
-            codegen_intrinsic_print_value(ctx, field_val, t->as.struct_type.fields[i].type);
+            codegen_intrinsic_print_value(ctx, print_struct_field(ctx, val, t, i), t->as.struct_type.fields[i].type);
         }
         codegen_intrinsic_print_str_lit(ctx, " }");
     }
     // -------------------------------------------------------------------------
-    // 4. ARRAYS AND SLICES
+    // 4. VECTORS: <a, b, c>
+    // -------------------------------------------------------------------------
+    else if (t->kind == TYPE_VECTOR) {
+        LLVMTypeRef i32_ty = LLVMInt32TypeInContext(ctx->context);
+        codegen_intrinsic_print_str_lit(ctx, "<");
+        for (int64_t i = 0; i < t->as.vector.lanes; i++) {
+            if (i > 0) codegen_intrinsic_print_str_lit(ctx, ", ");
+            LLVMValueRef lane = LLVMBuildExtractElement(ctx->builder, val, LLVMConstInt(i32_ty, (unsigned long long)i, 0), "lane");
+            codegen_intrinsic_print_value(ctx, lane, t->as.vector.base);
+        }
+        codegen_intrinsic_print_str_lit(ctx, ">");
+    }
+    // -------------------------------------------------------------------------
+    // 5. ARRAYS AND SLICES
     // -------------------------------------------------------------------------
     else if (t->kind == TYPE_ARRAY || t->kind == TYPE_SLICE) {
         codegen_intrinsic_print_str_lit(ctx, "[");
@@ -210,7 +224,7 @@ static void codegen_intrinsic_print_value(CodegenContext *ctx, LLVMValueRef val,
 
         // Print actual element
         LLVMPositionBuilderAtEnd(ctx->builder, no_comma_bb);
-        LLVMValueRef elem_ptr = LLVMBuildGEP2(ctx->builder, elem_ty, ptr, &curr_idx, 1, "elem_ptr");
+        LLVMValueRef elem_ptr = LLVMBuildInBoundsGEP2(ctx->builder, elem_ty, ptr, &curr_idx, 1, "elem_ptr");
         LLVMValueRef elem_val = codegen_load_value(ctx, elem_ptr, base_type);
         codegen_intrinsic_print_value(ctx, elem_val, base_type);
 
@@ -225,10 +239,244 @@ static void codegen_intrinsic_print_value(CodegenContext *ctx, LLVMValueRef val,
     }
 }
 
+// =============================================================================
+// SECTION: BATCHED PRINTING
+// =============================================================================
+
+/*
+ * One print/println call becomes a single newt_print call: string constants are
+ * spliced into a format built at compile time and every scalar adds a
+ * conversion and an argument, so stdout is locked and parsed once per call
+ * instead of once per piece. The output is exactly what the print_* entry
+ * points would write. Arrays and slices need a loop and go through
+ * codegen_intrinsic_print_value after whatever came before them; an
+ * argument that may print itself flushes the batch before it runs.
+ */
+typedef struct {
+    char *format;
+    size_t len;
+    size_t cap;
+    DynArray args; // DynArray<LLVMValueRef>
+} PrintBatch;
+
+/* `name` with type `ty`, whatever std.libc declared it as. */
+static LLVMValueRef runtime_decl(CodegenContext *ctx, const char *name, LLVMTypeRef ty) {
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, name);
+    if (!fn) fn = LLVMAddFunction(ctx->module, name, ty);
+    else if (LLVMGlobalGetValueType(fn) != ty) fn = LLVMConstBitCast(fn, LLVMPointerType(ty, 0));
+    return fn;
+}
+
+/* newt_print(fmt, ...): printf, unless std.io redirected print (see codegen_define_runtime). */
+static LLVMValueRef runtime_print(CodegenContext *ctx, LLVMTypeRef *out_ty) {
+    LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+    *out_ty = LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), &i8ptr, 1, 1);
+    return runtime_decl(ctx, "newt_print", *out_ty);
+}
+
+static void print_batch_text(PrintBatch *b, const char *text, bool escape) {
+    for (const char *p = text; *p; p++) {
+        if (b->len + 3 > b->cap) {
+            b->cap = b->cap ? b->cap * 2 : 64;
+            char *grown = xmalloc(b->cap);
+            if (b->len) memcpy(grown, b->format, b->len);
+            free(b->format);
+            b->format = grown;
+        }
+        if (escape && *p == '%') b->format[b->len++] = '%';
+        b->format[b->len++] = *p;
+    }
+}
+
+static void print_batch_arg(PrintBatch *b, const char *conversion, LLVMValueRef arg) {
+    print_batch_text(b, conversion, false);
+    dynarray_push_value(&b->args, &arg);
+}
+
+static void print_batch_flush(CodegenContext *ctx, PrintBatch *b) {
+    if (b->len == 0) return;
+    b->format[b->len] = '\0';
+
+    size_t argc = 1 + b->args.count;
+    LLVMValueRef *args = xmalloc(sizeof(LLVMValueRef) * argc);
+    args[0] = LLVMBuildGlobalStringPtr(ctx->builder, b->format, "print_fmt");
+    for (size_t i = 0; i < b->args.count; i++) args[i + 1] = DYNARRAY_AT(LLVMValueRef, &b->args, i);
+
+    LLVMTypeRef print_ty;
+    LLVMValueRef print_fn = runtime_print(ctx, &print_ty);
+    LLVMBuildCall2(ctx->builder, print_ty, print_fn, args, (unsigned)argc, "");
+    free(args);
+
+    b->len = 0;
+    b->args.count = 0;
+}
+
+/* Appends `val` to the batch, formatted as codegen_intrinsic_print_value would print it. */
+static void print_batch_value(CodegenContext *ctx, PrintBatch *b, LLVMValueRef val, Type *t) {
+    if (!t) return;
+    LLVMContextRef c = ctx->context;
+    LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(c), 0);
+
+    if (t->kind == TYPE_PRIMITIVE) {
+        switch (t->as.primitive) {
+            case PRIM_I32:  print_batch_arg(b, "%d", val); break;
+            case PRIM_I64:  print_batch_arg(b, "%lld", val); break;
+            case PRIM_F32:  print_batch_arg(b, "%g", LLVMBuildFPExt(ctx->builder, val, LLVMDoubleTypeInContext(c), "f32_to_f64")); break;
+            case PRIM_F64:  print_batch_arg(b, "%g", val); break;
+            case PRIM_CHAR: print_batch_arg(b, "%c", LLVMBuildSExt(ctx->builder, val, LLVMInt32TypeInContext(c), "char_to_i32")); break;
+            case PRIM_BOOL:
+                val = LLVMBuildICmp(ctx->builder, LLVMIntNE, val, LLVMConstNull(LLVMTypeOf(val)), "bool_set");
+                print_batch_arg(b, "%s", LLVMBuildSelect(ctx->builder, val,
+                                                         LLVMBuildGlobalStringPtr(ctx->builder, "true", "print_true"),
+                                                         LLVMBuildGlobalStringPtr(ctx->builder, "false", "print_false"), "bool_str"));
+                break;
+            default: break;
+        }
+    } else if (t->kind == TYPE_POINTER) {
+        LLVMValueRef is_null = LLVMBuildIsNull(ctx->builder, val, "is_null");
+        if (t == ctx->store->t_str || (t->as.ptr.base->kind == TYPE_PRIMITIVE && t->as.ptr.base->as.primitive == PRIM_CHAR)) {
+            LLVMValueRef str = LLVMBuildBitCast(ctx->builder, val, i8ptr, "str_cast");
+            print_batch_arg(b, "%s", LLVMBuildSelect(ctx->builder, is_null,
+                                                     LLVMBuildGlobalStringPtr(ctx->builder, "(null)", "print_null"), str, "str_or_null"));
+        } else {
+            // "%p" without its null spelling: the prefix reads "null" and a zero address prints no digits
+            print_batch_arg(b, "%s", LLVMBuildSelect(ctx->builder, is_null,
+                                                     LLVMBuildGlobalStringPtr(ctx->builder, "null", "print_null"),
+                                                     LLVMBuildGlobalStringPtr(ctx->builder, "0x", "print_hex"), "ptr_prefix"));
+            print_batch_arg(b, "%.0llx", LLVMBuildPtrToInt(ctx->builder, val, LLVMInt64TypeInContext(c), "ptr_bits"));
+        }
+    } else if (t->kind == TYPE_STRUCT || t->kind == TYPE_GENERIC_INST) {
+        if (t->kind == TYPE_GENERIC_INST) t = t->as.generic_inst.concrete_type;
+        print_batch_text(b, "{ ", true);
+        for (size_t i = 0; i < t->as.struct_type.field_count; i++) {
+            if (i > 0) print_batch_text(b, ", ", true);
+            Slice *fname = (Slice*)t->as.struct_type.fields[i].name->key;
+            char field_prefix[256];
+            snprintf(field_prefix, sizeof(field_prefix), "%.*s: ", (int)fname->len, fname->ptr);
+            print_batch_text(b, field_prefix, true);
+            print_batch_value(ctx, b, print_struct_field(ctx, val, t, i), t->as.struct_type.fields[i].type);
+        }
+        print_batch_text(b, " }", true);
+    } else if (t->kind == TYPE_VECTOR) {
+        LLVMTypeRef i32_ty = LLVMInt32TypeInContext(c);
+        print_batch_text(b, "<", true);
+        for (int64_t i = 0; i < t->as.vector.lanes; i++) {
+            if (i > 0) print_batch_text(b, ", ", true);
+            LLVMValueRef lane = LLVMBuildExtractElement(ctx->builder, val, LLVMConstInt(i32_ty, (unsigned long long)i, 0), "lane");
+            print_batch_value(ctx, b, lane, t->as.vector.base);
+        }
+        print_batch_text(b, ">", true);
+    } else if (t->kind == TYPE_ARRAY || t->kind == TYPE_SLICE) {
+        print_batch_flush(ctx, b);
+        codegen_intrinsic_print_value(ctx, val, t);
+    }
+}
+
+/* `node` cannot write to stdout while it is evaluated, so earlier pieces may wait for it. */
+static bool print_arg_is_quiet(AstNode *node) {
+    if (!node || node->is_foldable_const) return true;
+    switch (node->node_type) {
+        case AST_LITERAL:
+        case AST_IDENTIFIER:
+        case AST_TYPE:
+            return true;
+        case AST_MEMBER_EXPR:
+            return print_arg_is_quiet(node->data.member_expr.target);
+        case AST_SUBSCRIPT_EXPR:
+            return print_arg_is_quiet(node->data.subscript_expr.target) && print_arg_is_quiet(node->data.subscript_expr.index);
+        case AST_UNARY_EXPR:
+            return print_arg_is_quiet(node->data.unary_expr.expr);
+        case AST_POSTFIX_EXPR:
+            return print_arg_is_quiet(node->data.postfix_expr.expr);
+        case AST_BINARY_EXPR:
+            return print_arg_is_quiet(node->data.binary_expr.left) && print_arg_is_quiet(node->data.binary_expr.right);
+        case AST_ASSIGNMENT_EXPR:
+            return print_arg_is_quiet(node->data.assignment_expr.lvalue) && print_arg_is_quiet(node->data.assignment_expr.rvalue);
+        case AST_CAST:
+            return print_arg_is_quiet(node->data.cast_expr.expr);
+        case AST_GENERIC_INST_EXPR:
+            return print_arg_is_quiet(node->data.generic_inst_expr.base);
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) {
+                    if (!print_arg_is_quiet(init->expr)) return false;
+                }
+            }
+            return true;
+        case AST_INITIALIZER_LIST:
+            if (node->data.initializer_list.elements) {
+                DYNARRAY_FOREACH(AstNode*, elem_it, node->data.initializer_list.elements) {
+                    if (!print_arg_is_quiet(*elem_it)) return false;
+                }
+            }
+            return true;
+        case AST_INTRINSIC:
+            // The allocator hooks are calls, atomics are ordered and bulk memory writes; the vector intrinsics compute in place
+            if (node->data.intrinsic.kind == INTRINSIC_ALLOC || node->data.intrinsic.kind == INTRINSIC_FREE) return false;
+            if (intrinsic_is_atomic(node->data.intrinsic.kind) || intrinsic_is_bulk_memory(node->data.intrinsic.kind)) return false;
+            if (intrinsic_is_async(node->data.intrinsic.kind)) return false; // Runs other frames
+            if (node->data.intrinsic.args) {
+                DYNARRAY_FOREACH(AstNode*, arg_it, node->data.intrinsic.args) {
+                    if (!print_arg_is_quiet(*arg_it)) return false;
+                }
+            }
+            return true;
+        case AST_CALL_EXPR: {
+            // Only a callee known to write nothing it can see (so no output either)
+            AstNode *decl = purity_callee_decl(node->data.call_expr.callee);
+            if (!decl || decl->data.function_declaration.memory == FN_MEMORY_ANY) return false;
+            if (!print_arg_is_quiet(node->data.call_expr.callee)) return false;
+            if (node->data.call_expr.args) {
+                DYNARRAY_FOREACH(AstNode*, arg_it, node->data.call_expr.args) {
+                    if (!print_arg_is_quiet(*arg_it)) return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/* The text of `node` when it is a string known at compile time. */
+static const char *print_constant_text(AstNode *node) {
+    if (node->node_type == AST_LITERAL && node->data.literal.type == STRING_LITERAL) {
+        return ((Slice*)node->data.literal.value.string_val->key)->ptr;
+    }
+    if (node->is_foldable_const && node->const_value.type == STRING_LITERAL && node->const_value.value.string_val) {
+        return ((Slice*)node->const_value.value.string_val->key)->ptr;
+    }
+    return NULL;
+}
+
+static void codegen_intrinsic_print(CodegenContext *ctx, DynArray *call_args, bool newline) {
+    PrintBatch batch = {0};
+    dynarray_init(&batch.args, sizeof(LLVMValueRef));
+
+    size_t arg_count = call_args ? call_args->count : 0;
+    for (size_t i = 0; i < arg_count; i++) {
+        AstNode *arg = DYNARRAY_AT(AstNode*, call_args, i);
+        const char *text = print_constant_text(arg);
+        if (text) {
+            print_batch_text(&batch, text, true);
+            continue;
+        }
+        if (!print_arg_is_quiet(arg)) print_batch_flush(ctx, &batch);
+        print_batch_value(ctx, &batch, codegen_expr(ctx, arg), arg->type);
+    }
+    if (newline) print_batch_text(&batch, "\n", false);
+
+    print_batch_flush(ctx, &batch);
+    dynarray_free(&batch.args);
+    free(batch.format);
+}
+
 // =============================================================================
 // SECTION: CORE CALL EXPRESSION GENERATION
 // =============================================================================
 
+static LLVMValueRef emit_call(CodegenContext *ctx, AstNode *expr, LLVMValueRef callee, LLVMValueRef sret_dest, LLVMValueRef *call_out);
+
 LLVMValueRef codegen_expr_call(CodegenContext *ctx, AstNode *expr) {
     // Sanity check: Ensure the node passed semantic analysis
     if (!expr->type) {
@@ -250,40 +498,72 @@ LLVMValueRef codegen_expr_call(CodegenContext *ctx, AstNode *expr) {
         if (sym && sym->kind == SYMBOL_VALUE_INTRINSIC) {
             // Intercept print() and println()
             if (sym->intrinsic_kind == INTRINSIC_PRINT || sym->intrinsic_kind == INTRINSIC_PRINT_NEWLINE) {
-                bool newline = (sym->intrinsic_kind == INTRINSIC_PRINT_NEWLINE);
-
-                size_t arg_count = call->args ? call->args->count : 0;
-                for (size_t i = 0; i < arg_count; i++) {
-                    AstNode *arg = *(AstNode**)dynarray_get(call->args, i);
-                    LLVMValueRef val = codegen_expr(ctx, arg);
-                    codegen_intrinsic_print_value(ctx, val, arg->type);
-                }
-
-                if (newline) {
-                    LLVMTypeRef fn_ty = LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), NULL, 0, 0);
-                    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, "print_newline");
-                    if (!fn) fn = LLVMAddFunction(ctx->module, "print_newline", fn_ty);
-                    LLVMBuildCall2(ctx->builder, fn_ty, fn, NULL, 0, "");
-                }
-
+                codegen_intrinsic_print(ctx, call->args, sym->intrinsic_kind == INTRINSIC_PRINT_NEWLINE);
                 return NULL; // Print intrinsics return void
             }
         }
     }
 
+    // A forwarding method of a known allocator calls its function directly
+    bool forwarded;
+    LLVMValueRef direct = codegen_forwarding_call(ctx, expr, &forwarded);
+    if (forwarded) return direct;
+
     // -------------------------------------------------------------------------
     // 2. STANDARD FUNCTION CALLS (ABI Compliance)
     // -------------------------------------------------------------------------
-    LLVMValueRef callee = codegen_expr(ctx, call->callee);
-    Type *fn_type = call->callee->type;
-    
-    // Unwrap pointer-to-function if necessary
-    if (fn_type->kind == TYPE_POINTER) fn_type = fn_type->as.ptr.base;
+    LLVMValueRef call_instr;
+    return emit_call(ctx, expr, codegen_expr(ctx, call->callee), NULL, &call_instr);
+}
+
+/*
+ * Lowers `expr` into `dest` when it is a call whose result comes back in
+ * memory: the callee writes the caller's storage through its sret pointer,
+ * with no temporary to copy out of. False, with nothing emitted, for any
+ * other expression. `dest` must be memory the arguments cannot reach.
+ */
+bool codegen_call_into(CodegenContext *ctx, AstNode *expr, LLVMValueRef dest) {
+    if (expr->node_type != AST_CALL_EXPR || !expr->type) return false;
+    AstNode *callee = expr->data.call_expr.callee;
+    if (callee->node_type == AST_IDENTIFIER && callee->data.identifier.symbol &&
+        callee->data.identifier.symbol->kind == SYMBOL_VALUE_INTRINSIC) return false;
+    Type *fn_type = callee->type;
+    if (fn_type && fn_type->kind == TYPE_POINTER) fn_type = fn_type->as.ptr.base;
+    if (!fn_type || fn_type->kind != TYPE_FUNCTION || codegen_abi_signature(ctx, fn_type)->ret.kind != ABI_INDIRECT) return false;
+
+    bool forwarded;
+    LLVMValueRef direct = codegen_forwarding_call(ctx, expr, &forwarded);
+    if (forwarded) {
+        codegen_store_value(ctx, direct, dest, expr->type);
+        return true;
+    }
+    LLVMValueRef call_instr;
+    emit_call(ctx, expr, codegen_expr(ctx, callee), dest, &call_instr);
+    return true;
+}
+
+/* The function type a call goes through, looking past a function pointer. */
+static Type *call_fn_type(AstNode *call_node) {
+    Type *fn_type = call_node->data.call_expr.callee->type;
+    if (fn_type && fn_type->kind == TYPE_POINTER) fn_type = fn_type->as.ptr.base;
     if (!fn_type || fn_type->kind != TYPE_FUNCTION) ICE("Callee must be a function type");
+    return fn_type;
+}
 
-    // ABI: If returning a large struct (>16 bytes), System V requires an 'sret' (Struct Return).
-    // The caller allocates the memory and passes a hidden pointer as the 1st parameter.
-    bool sret = type_is_indirect(ctx, fn_type->as.func.return_type);
+/*
+ * Emits the call of `expr` to `callee` and returns its result. A result in
+ * memory (sret) is written to `sret_dest`, and NULL returned, or loaded from
+ * a fresh slot when it is NULL; *call_out is the call instruction itself.
+ */
+static LLVMValueRef emit_call(CodegenContext *ctx, AstNode *expr, LLVMValueRef callee, LLVMValueRef sret_dest, LLVMValueRef *call_out) {
+    AstCallExpr *call = &expr->data.call_expr;
+    Type *fn_type = call_fn_type(expr);
+
+    // ABI: each argument and the result cross the call as the C convention
+    // classifies them (codegen_abi.c). A result in memory (sret) goes to a
+    // slot the caller allocates, passed as a hidden first parameter.
+    const AbiSignature *sig = codegen_abi_signature(ctx, fn_type);
+    bool sret = sig->ret.kind == ABI_INDIRECT;
     size_t param_count = fn_type->as.func.param_count;
     size_t llvm_arg_count = param_count + (sret ? 1 : 0);
     
@@ -296,18 +576,26 @@ LLVMValueRef codegen_expr_call(CodegenContext *ctx, AstNode *expr) {
     // Setup hidden sret pointer
     if (sret) {
         LLVMTypeRef ret_ty = get_llvm_type(ctx, fn_type->as.func.return_type);
-        sret_alloca = create_entry_block_alloca(ctx, ret_ty, "sret_tmp");
+        sret_alloca = sret_dest ? sret_dest : create_entry_block_alloca(ctx, ret_ty, "sret_tmp");
         args[idx++] = sret_alloca;
     }
 
     // Process explicit arguments
     for (size_t i = 0; i < param_count; i++) {
-        AstNode *arg_node = *(AstNode**)dynarray_get(call->args, i);
-        Type *param_ty = fn_type->as.func.params[i];
+        AstNode *arg_node = DYNARRAY_AT(AstNode*, call->args, i);
+        const AbiArg *abi = &sig->params[i];
         
-        // ABI: If a struct argument is large, it must be passed via a pointer with 'byval'
-        if (type_is_indirect(ctx, param_ty)) {
-            args[idx++] = codegen_lvalue(ctx, arg_node);
+        if (abi->kind == ABI_INDIRECT && abi->byval) {
+            // byval: the callee's copy is made from this address, which is an array's value
+            args[idx++] = type_is_address_only(arg_node->type) ? codegen_expr(ctx, arg_node) : codegen_lvalue(ctx, arg_node);
+        } else if (abi->kind == ABI_INDIRECT) {
+            // By reference: the callee may write to what it is given, so pass a copy
+            LLVMValueRef val = codegen_expr(ctx, arg_node);
+            LLVMValueRef copy = create_entry_block_alloca(ctx, LLVMTypeOf(val), "arg_copy");
+            LLVMBuildStore(ctx->builder, val, copy);
+            args[idx++] = copy;
+        } else if (abi->kind == ABI_COERCE) {
+            args[idx++] = codegen_abi_coerce(ctx, codegen_expr(ctx, arg_node), abi->coerce);
         } else {
             args[idx++] = codegen_expr(ctx, arg_node);
         }
@@ -323,32 +611,306 @@ LLVMValueRef codegen_expr_call(CodegenContext *ctx, AstNode *expr) {
         (unsigned)llvm_arg_count, 
         (type_is_void(expr->type) || sret) ? "" : "calltmp"
     );
-    
-    // -------------------------------------------------------------------------
-    // 3. ATTACH ABI ATTRIBUTES
-    // -------------------------------------------------------------------------
-    if (sret) {
-        LLVMTypeRef ret_ty = get_llvm_type(ctx, fn_type->as.func.return_type);
-        // FIXED: LLAddCallSiteAttribute -> LLVMAddCallSiteAttribute
-        LLVMAddCallSiteAttribute(call_instr, 1, LLVMCreateTypeAttribute(ctx->context, 
-            LLVMGetEnumAttributeKindForName("sret", 4), ret_ty));
-    }
-    
-    size_t attr_idx = sret ? 2 : 1; // Attributes shift by 1 if there's a hidden sret arg
-    for (size_t i = 0; i < param_count; i++) {
-        if (type_is_indirect(ctx, fn_type->as.func.params[i])) {
-            LLVMTypeRef param_ty = get_llvm_type(ctx, fn_type->as.func.params[i]);
-            LLVMAddCallSiteAttribute(call_instr, (unsigned)(attr_idx + i), LLVMCreateTypeAttribute(ctx->context, 
-                LLVMGetEnumAttributeKindForName("byval", 5), param_ty));
-        }
-    }
+    codegen_abi_attributes(ctx, call_instr, fn_type);
+    *call_out = call_instr;
 
     if (args) free(args);
 
     // If we used an sret, the true return value is sitting inside our local alloca
     if (sret) {
-        return codegen_load_value(ctx, sret_alloca, fn_type->as.func.return_type);
+        return sret_dest ? NULL : codegen_load_value(ctx, sret_alloca, fn_type->as.func.return_type);
+    }
+    if (sig->ret.kind == ABI_COERCE) {
+        return codegen_abi_coerce(ctx, call_instr, get_llvm_type(ctx, fn_type->as.func.return_type));
     }
 
     return call_instr;
-}
\ No newline at end of file
+}
+
+/*
+ * A call back into the current function stores its arguments over the
+ * parameters and jumps to the top of the body, at every optimization level.
+ * Any other callee has the caller's signature (sema checked it), so its
+ * raw result is returned as it comes and the call is marked `tail`: it
+ * passes nothing in memory, and LLVM turns it into a jump. The C API has
+ * no musttail; the checks in sema are what make the marker hold.
+ */
+void codegen_tail_call(CodegenContext *ctx, AstNode *expr) {
+    AstNode *call_node = DYNARRAY_AT(AstNode*, expr->data.intrinsic.args, 0);
+    AstCallExpr *call = &call_node->data.call_expr;
+    Type *fn_type = call_fn_type(call_node);
+    LLVMValueRef callee = codegen_expr(ctx, call->callee);
+    LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+
+    if (ctx->tail_entry_bb && callee == func) {
+        size_t param_count = fn_type->as.func.param_count;
+        LLVMValueRef *vals = xmalloc(sizeof(LLVMValueRef) * (param_count ? param_count : 1));
+        for (size_t i = 0; i < param_count; i++) {
+            Type *param_ty = fn_type->as.func.params[i];
+            vals[i] = codegen_expr(ctx, DYNARRAY_AT(AstNode*, call->args, i));
+            // An array comes by address, possibly of a parameter the stores below overwrite
+            if (type_is_address_only(param_ty)) {
+                LLVMValueRef tmp = create_entry_block_alloca(ctx, get_llvm_type(ctx, param_ty), "tail_arg");
+                codegen_store_value(ctx, vals[i], tmp, param_ty);
+                vals[i] = tmp;
+            }
+        }
+        for (size_t i = 0; i < param_count; i++) {
+            codegen_store_value(ctx, vals[i], ctx->tail_param_slots[i], fn_type->as.func.params[i]);
+        }
+        free(vals);
+        LLVMBuildBr(ctx->builder, ctx->tail_entry_bb);
+        return;
+    }
+
+    LLVMValueRef call_instr;
+    emit_call(ctx, call_node, callee, ctx->sret_ptr, &call_instr);
+    const AbiSignature *sig = codegen_abi_signature(ctx, fn_type);
+    bool frame_copy = false; // A by-reference argument is a copy in this frame
+    for (size_t i = 0; i < fn_type->as.func.param_count; i++) {
+        if (sig->params[i].kind == ABI_INDIRECT && !sig->params[i].byval) frame_copy = true;
+    }
+    if (!frame_copy) LLVMSetTailCall(call_instr, 1);
+
+    if (sig->ret.kind == ABI_INDIRECT || type_is_void(fn_type->as.func.return_type)) LLVMBuildRetVoid(ctx->builder);
+    else LLVMBuildRet(ctx->builder, call_instr);
+}
+// =============================================================================
+// SECTION: IN-MODULE RUNTIME
+// =============================================================================
+
+typedef enum { RT_ARG_NONE, RT_ARG_I8, RT_ARG_I32, RT_ARG_I64, RT_ARG_F32, RT_ARG_F64, RT_ARG_BOOL, RT_ARG_STR, RT_ARG_PTR } RuntimeArg;
+
+// Mirrors src/core/runtime.c
+static const struct { const char *name; RuntimeArg arg; const char *format; } RUNTIME_PRINTERS[] = {
+    { "print_i32",     RT_ARG_I32,  "%d" },
+    { "print_i64",     RT_ARG_I64,  "%lld" },
+    { "print_f32",     RT_ARG_F32,  "%g" },
+    { "print_f64",     RT_ARG_F64,  "%g" },
+    { "print_bool",    RT_ARG_BOOL, "%s" },
+    { "print_str",     RT_ARG_STR,  "%s" },
+    { "print_char",    RT_ARG_I8,   "%c" },
+    { "print_ptr",     RT_ARG_PTR,  "%p" },
+    { "print_newline", RT_ARG_NONE, "\n" },
+};
+
+/* True where va_list is a plain pointer rather than an array of register save state. */
+static bool va_list_is_pointer(CodegenContext *ctx) {
+    const char *triple = LLVMGetTarget(ctx->module);
+    if (!triple || !*triple) return false;
+    if (strstr(triple, "windows")) return true;
+    return (strstr(triple, "apple") || strstr(triple, "darwin")) &&
+           (strstr(triple, "aarch64") || strstr(triple, "arm64"));
+}
+
+static LLVMValueRef runtime_global(CodegenContext *ctx, const char *name) {
+    LLVMValueRef g = LLVMGetNamedGlobal(ctx->module, name);
+    if (g) return g;
+    LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+    g = LLVMAddGlobal(ctx->module, i8ptr, name);
+    LLVMSetInitializer(g, LLVMConstNull(i8ptr));
+    LLVMSetLinkage(g, LLVMInternalLinkage);
+    return g;
+}
+
+/*
+ * Defines newt_print, which every print goes through, and
+ * newt_set_print_sink, which std.io calls to send print output into a
+ * buffered writer. While the sink's ctx is null newt_print is vprintf.
+ * Otherwise the text is formatted into a stack buffer (the heap if it does
+ * not fit) and handed to sink(ctx, text, len), so print and the writer's own
+ * output stay in order.
+ */
+static void define_print_entry(CodegenContext *ctx, LLVMBuilderRef b) {
+    LLVMContextRef c = ctx->context;
+    LLVMTypeRef void_ty = LLVMVoidTypeInContext(c);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(c);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(c);
+    LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(c), 0);
+
+    LLVMValueRef sink_ctx = runtime_global(ctx, "newt_print_sink_ctx");
+    LLVMValueRef sink_fn = runtime_global(ctx, "newt_print_sink_fn");
+
+    LLVMTypeRef set_params[2] = { i8ptr, i8ptr };
+    LLVMTypeRef set_ty = LLVMFunctionType(void_ty, set_params, 2, 0);
+    LLVMValueRef set = LLVMGetNamedFunction(ctx->module, "newt_set_print_sink");
+    if (!set) set = LLVMAddFunction(ctx->module, "newt_set_print_sink", set_ty);
+    if (LLVMCountBasicBlocks(set) == 0 && LLVMCountParams(set) == 2) {
+        if (!ctx->export_runtime) LLVMSetLinkage(set, LLVMInternalLinkage);
+        LLVMPositionBuilderAtEnd(b, LLVMAppendBasicBlockInContext(c, set, "entry"));
+        LLVMBuildStore(b, LLVMBuildPointerCast(b, LLVMGetParam(set, 0), i8ptr, ""), sink_ctx);
+        LLVMBuildStore(b, LLVMBuildPointerCast(b, LLVMGetParam(set, 1), i8ptr, ""), sink_fn);
+        LLVMBuildRetVoid(b);
+    }
+
+    LLVMTypeRef print_ty;
+    LLVMValueRef print = runtime_print(ctx, &print_ty);
+    if (LLVMCountBasicBlocks(print) > 0) return;
+    if (!ctx->export_runtime) LLVMSetLinkage(print, LLVMInternalLinkage);
+
+    LLVMTypeRef va_fn_ty = LLVMFunctionType(void_ty, &i8ptr, 1, 0);
+    LLVMValueRef va_start = runtime_decl(ctx, "llvm.va_start", va_fn_ty);
+    LLVMValueRef va_end = runtime_decl(ctx, "llvm.va_end", va_fn_ty);
+    LLVMTypeRef va_copy_ty = LLVMFunctionType(void_ty, set_params, 2, 0);
+    LLVMValueRef va_copy = runtime_decl(ctx, "llvm.va_copy", va_copy_ty);
+
+    LLVMTypeRef vprintf_params[2] = { i8ptr, i8ptr };
+    LLVMTypeRef vprintf_ty = LLVMFunctionType(i32, vprintf_params, 2, 0);
+    LLVMValueRef vprintf_fn = runtime_decl(ctx, "vprintf", vprintf_ty);
+    LLVMTypeRef vsnprintf_params[4] = { i8ptr, i64, i8ptr, i8ptr };
+    LLVMTypeRef vsnprintf_ty = LLVMFunctionType(i32, vsnprintf_params, 4, 0);
+    LLVMValueRef vsnprintf_fn = runtime_decl(ctx, "vsnprintf", vsnprintf_ty);
+    LLVMTypeRef malloc_ty = LLVMFunctionType(i8ptr, &i64, 1, 0);
+    LLVMValueRef malloc_fn = runtime_decl(ctx, "malloc", malloc_ty);
+    LLVMTypeRef free_ty = LLVMFunctionType(void_ty, &i8ptr, 1, 0);
+    LLVMValueRef free_fn = runtime_decl(ctx, "free", free_ty);
+    LLVMTypeRef sink_params[3] = { i8ptr, i8ptr, i64 };
+    LLVMTypeRef sink_ty = LLVMFunctionType(void_ty, sink_params, 3, 0);
+
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(c, print, "entry");
+    LLVMBasicBlockRef direct = LLVMAppendBasicBlockInContext(c, print, "direct");
+    LLVMBasicBlockRef buffered = LLVMAppendBasicBlockInContext(c, print, "buffered");
+    LLVMBasicBlockRef measured = LLVMAppendBasicBlockInContext(c, print, "measured");
+    LLVMBasicBlockRef fits = LLVMAppendBasicBlockInContext(c, print, "fits");
+    LLVMBasicBlockRef spill = LLVMAppendBasicBlockInContext(c, print, "spill");
+    LLVMBasicBlockRef spilled = LLVMAppendBasicBlockInContext(c, print, "spilled");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(c, print, "done");
+    const unsigned stack_len = 512;
+
+    // Room for any target's va_list: 24 bytes on x86-64, 32 on AArch64, a pointer elsewhere
+    LLVMPositionBuilderAtEnd(b, entry);
+    LLVMTypeRef va_ty = LLVMArrayType(LLVMInt8TypeInContext(c), 32);
+    LLVMValueRef ap = LLVMBuildAlloca(b, va_ty, "ap");
+    LLVMValueRef ap_copy = LLVMBuildAlloca(b, va_ty, "ap_copy");
+    LLVMSetAlignment(ap, 16);
+    LLVMSetAlignment(ap_copy, 16);
+    LLVMValueRef text = LLVMBuildAlloca(b, LLVMArrayType(LLVMInt8TypeInContext(c), stack_len), "text");
+    LLVMValueRef ap_raw = LLVMBuildPointerCast(b, ap, i8ptr, "");
+    LLVMValueRef ap_copy_raw = LLVMBuildPointerCast(b, ap_copy, i8ptr, "");
+    LLVMValueRef text_raw = LLVMBuildPointerCast(b, text, i8ptr, "");
+    LLVMValueRef fmt = LLVMGetParam(print, 0);
+    LLVMBuildCall2(b, va_fn_ty, va_start, &ap_raw, 1, "");
+    LLVMValueRef ctx_val = LLVMBuildLoad2(b, i8ptr, sink_ctx, "sink_ctx");
+    LLVMBuildCondBr(b, LLVMBuildIsNull(b, ctx_val, ""), direct, buffered);
+
+    bool va_ptr = va_list_is_pointer(ctx);
+    #define VA_ARG(raw) (va_ptr ? LLVMBuildLoad2(b, i8ptr, LLVMBuildPointerCast(b, raw, LLVMPointerType(i8ptr, 0), ""), "") : raw)
+
+    LLVMPositionBuilderAtEnd(b, direct);
+    LLVMValueRef vprintf_args[2] = { fmt, VA_ARG(ap_raw) };
+    LLVMBuildCall2(b, vprintf_ty, vprintf_fn, vprintf_args, 2, "");
+    LLVMBuildCall2(b, va_fn_ty, va_end, &ap_raw, 1, "");
+    LLVMBuildRetVoid(b);
+
+    // vsnprintf consumes the list, so keep a copy for a second pass into the heap
+    LLVMPositionBuilderAtEnd(b, buffered);
+    LLVMValueRef copy_args[2] = { ap_copy_raw, ap_raw };
+    LLVMBuildCall2(b, va_copy_ty, va_copy, copy_args, 2, "");
+    LLVMValueRef first_args[4] = { text_raw, LLVMConstInt(i64, stack_len, 0), fmt, VA_ARG(ap_raw) };
+    LLVMValueRef n = LLVMBuildCall2(b, vsnprintf_ty, vsnprintf_fn, first_args, 4, "n");
+    LLVMValueRef n64 = LLVMBuildSExt(b, n, i64, "");
+    LLVMValueRef sink = LLVMBuildLoad2(b, i8ptr, sink_fn, "sink");
+    LLVMValueRef fn_ptr = LLVMBuildPointerCast(b, sink, LLVMPointerType(sink_ty, 0), "");
+    LLVMBuildCondBr(b, LLVMBuildICmp(b, LLVMIntSLT, n, LLVMConstInt(i32, 0, 0), ""), done, measured);
+
+    LLVMPositionBuilderAtEnd(b, measured);
+    LLVMBuildCondBr(b, LLVMBuildICmp(b, LLVMIntSGE, n, LLVMConstInt(i32, stack_len, 0), ""), spill, fits);
+
+    LLVMPositionBuilderAtEnd(b, fits);
+    LLVMValueRef fit_args[3] = { ctx_val, text_raw, n64 };
+    LLVMBuildCall2(b, sink_ty, fn_ptr, fit_args, 3, "");
+    LLVMBuildBr(b, done);
+
+    LLVMPositionBuilderAtEnd(b, spill);
+    LLVMValueRef size = LLVMBuildAdd(b, n64, LLVMConstInt(i64, 1, 0), "");
+    LLVMValueRef heap = LLVMBuildCall2(b, malloc_ty, malloc_fn, &size, 1, "heap");
+    LLVMBuildCondBr(b, LLVMBuildIsNull(b, heap, ""), done, spilled);
+
+    LLVMPositionBuilderAtEnd(b, spilled);
+    LLVMValueRef second_args[4] = { heap, size, fmt, VA_ARG(ap_copy_raw) };
+    LLVMBuildCall2(b, vsnprintf_ty, vsnprintf_fn, second_args, 4, "");
+    LLVMValueRef spill_args[3] = { ctx_val, heap, n64 };
+    LLVMBuildCall2(b, sink_ty, fn_ptr, spill_args, 3, "");
+    LLVMBuildCall2(b, free_ty, free_fn, &heap, 1, "");
+    LLVMBuildBr(b, done);
+    #undef VA_ARG
+
+    LLVMPositionBuilderAtEnd(b, done);
+    LLVMBuildCall2(b, va_fn_ty, va_end, &ap_copy_raw, 1, "");
+    LLVMBuildCall2(b, va_fn_ty, va_end, &ap_raw, 1, "");
+    LLVMBuildRetVoid(b);
+}
+
+/**
+ * Defines every print_* runtime function in the module as a newt_print
+ * wrapper, so the result links without compiling src/core/runtime.c. They
+ * are internal, free to inline into their callers and dropped when unused,
+ * unless objects linked next to the module call them too.
+ */
+void codegen_define_runtime(CodegenContext *ctx) {
+    if (!ctx->module) return;
+
+    LLVMContextRef c = ctx->context;
+    LLVMTypeRef i8 = LLVMInt8TypeInContext(c);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(c);
+    LLVMTypeRef i8ptr = LLVMPointerType(i8, 0);
+    LLVMTypeRef dbl = LLVMDoubleTypeInContext(c);
+
+    LLVMTypeRef print_ty;
+    LLVMValueRef print_fn = runtime_print(ctx, &print_ty);
+
+    LLVMBuilderRef b = LLVMCreateBuilderInContext(c);
+    for (size_t i = 0; i < sizeof(RUNTIME_PRINTERS) / sizeof(RUNTIME_PRINTERS[0]); i++) {
+        RuntimeArg kind = RUNTIME_PRINTERS[i].arg;
+        LLVMTypeRef param_ty = NULL;
+        switch (kind) {
+            case RT_ARG_I8:   param_ty = i8; break;
+            case RT_ARG_I32:
+            case RT_ARG_BOOL: param_ty = i32; break;
+            case RT_ARG_I64:  param_ty = LLVMInt64TypeInContext(c); break;
+            case RT_ARG_F32:  param_ty = LLVMFloatTypeInContext(c); break;
+            case RT_ARG_F64:  param_ty = dbl; break;
+            case RT_ARG_STR:
+            case RT_ARG_PTR:  param_ty = i8ptr; break;
+            case RT_ARG_NONE: break;
+        }
+        LLVMTypeRef fn_ty = LLVMFunctionType(LLVMVoidTypeInContext(c), &param_ty, param_ty ? 1 : 0, 0);
+
+        LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, RUNTIME_PRINTERS[i].name);
+        if (!fn) fn = LLVMAddFunction(ctx->module, RUNTIME_PRINTERS[i].name, fn_ty);
+        if (LLVMCountBasicBlocks(fn) > 0) continue;
+        if (!ctx->export_runtime) LLVMSetLinkage(fn, LLVMInternalLinkage);
+
+        LLVMPositionBuilderAtEnd(b, LLVMAppendBasicBlockInContext(c, fn, "entry"));
+        LLVMValueRef fmt = LLVMBuildGlobalStringPtr(b, RUNTIME_PRINTERS[i].format, "rt_fmt");
+        LLVMValueRef args[2] = { fmt, NULL };
+        LLVMValueRef p = param_ty ? LLVMGetParam(fn, 0) : NULL;
+        unsigned argc = 2;
+
+        switch (kind) {
+            case RT_ARG_I8:  args[1] = LLVMBuildSExt(b, p, i32, ""); break;
+            case RT_ARG_F32: args[1] = LLVMBuildFPExt(b, p, dbl, ""); break;
+            case RT_ARG_BOOL:
+                args[1] = LLVMBuildSelect(b, LLVMBuildICmp(b, LLVMIntNE, p, LLVMConstInt(i32, 0, 0), ""),
+                                          LLVMBuildGlobalStringPtr(b, "true", "rt_true"),
+                                          LLVMBuildGlobalStringPtr(b, "false", "rt_false"), "");
+                break;
+            case RT_ARG_STR:
+                args[1] = LLVMBuildSelect(b, LLVMBuildIsNull(b, p, ""),
+                                          LLVMBuildGlobalStringPtr(b, "(null)", "rt_null"), p, "");
+                break;
+            case RT_ARG_PTR:
+                // vprintf ignores the surplus argument on the "null" path
+                args[0] = LLVMBuildSelect(b, LLVMBuildIsNull(b, p, ""),
+                                          LLVMBuildGlobalStringPtr(b, "null", "rt_null"), fmt, "");
+                args[1] = p;
+                break;
+            case RT_ARG_NONE: argc = 1; break;
+            default:         args[1] = p; break;
+        }
+        LLVMBuildCall2(b, print_ty, print_fn, args, argc, "");
+        LLVMBuildRetVoid(b);
+    }
+    define_print_entry(ctx, b);
+    LLVMDisposeBuilder(b);
+}
@@ -1,33 +1,159 @@
 #include "codegen_internal.h"
 #include "dynamic_array.h"
+#ifdef _WIN32
+    #include <io.h>
+    #define dup _dup
+    #define dup2 _dup2
+    #define close _close
+    #define fileno _fileno
+#else
+    #include <unistd.h>
+#endif
 
-CodegenMap* codegen_map_create(CodegenContext *ctx, CodegenMap *parent) {
-    CodegenMap *m = xmalloc(sizeof(CodegenMap));
-    m->map = hashmap_create(NULL, 8);
-    m->parent = parent;
-    return m;
+/* Open a scope: returns the mark to hand to codegen_locals_leave. */
+size_t codegen_locals_enter(CodegenContext *ctx) {
+    return ctx->locals.undo.count;
 }
 
-void codegen_map_destroy(CodegenMap *m) {
-    if (!m) return;
-    hashmap_destroy(m->map, NULL, NULL);
-    free(m);
+/* Close the scope opened at `mark`, restoring every binding it shadowed. */
+void codegen_locals_leave(CodegenContext *ctx, size_t mark) {
+    CodegenLocals *l = &ctx->locals;
+    while (l->undo.count > mark) {
+        CodegenLocalUndo *u = &DYNARRAY_AT(CodegenLocalUndo, &l->undo, l->undo.count - 1);
+        l->slots[u->name] = u->prev;
+        l->undo.count--;
+    }
 }
 
-void codegen_map_put(CodegenMap *m, void *key, LLVMValueRef val) {
-    hashmap_put(m->map, key, val, ptr_hash, ptr_cmp);
+/*
+ * Show the bindings as they were at `mark` without closing the scopes after
+ * it (code deferred there runs here). Each undo entry above the mark swaps
+ * with its slot; codegen_locals_replay(mark, top) swaps them back.
+ */
+size_t codegen_locals_rewind(CodegenContext *ctx, size_t mark) {
+    CodegenLocals *l = &ctx->locals;
+    for (size_t i = l->undo.count; i-- > mark; ) {
+        CodegenLocalUndo *u = &DYNARRAY_AT(CodegenLocalUndo, &l->undo, i);
+        LLVMValueRef cur = l->slots[u->name];
+        l->slots[u->name] = u->prev;
+        u->prev = cur;
+    }
+    return l->undo.count;
 }
 
-LLVMValueRef codegen_map_get(CodegenMap *m, void *key) {
-    while (m) {
-        LLVMValueRef val = hashmap_get(m->map, key, ptr_hash, ptr_cmp);
-        if (val) return val;
-        m = m->parent;
+void codegen_locals_replay(CodegenContext *ctx, size_t mark, size_t top) {
+    CodegenLocals *l = &ctx->locals;
+    for (size_t i = mark; i < top; i++) {
+        CodegenLocalUndo *u = &DYNARRAY_AT(CodegenLocalUndo, &l->undo, i);
+        LLVMValueRef prev = l->slots[u->name];
+        l->slots[u->name] = u->prev;
+        u->prev = prev;
     }
-    return NULL;
 }
 
-CodegenContext* codegen_context_create(TypeStore *store, const char *module_name, int opt_level, ModuleLoader *loader) {
+void codegen_locals_put(CodegenContext *ctx, int name, LLVMValueRef val) {
+    CodegenLocals *l = &ctx->locals;
+    if (name < 0) return;
+    if ((size_t)name >= l->capacity) {
+        size_t cap = l->capacity ? l->capacity : 256;
+        while (cap <= (size_t)name) cap *= 2;
+        LLVMValueRef *grown = realloc(l->slots, cap * sizeof(LLVMValueRef));
+        if (!grown) ICE("Out of memory growing the codegen locals table");
+        l->slots = grown;
+        memset(l->slots + l->capacity, 0, (cap - l->capacity) * sizeof(LLVMValueRef));
+        l->capacity = cap;
+    }
+    CodegenLocalUndo u = { name, l->slots[name] };
+    dynarray_push_value(&l->undo, &u);
+    l->slots[name] = val;
+}
+
+LLVMValueRef codegen_locals_get(CodegenContext *ctx, int name) {
+    if (name < 0 || (size_t)name >= ctx->locals.capacity) return NULL;
+    return ctx->locals.slots[name];
+}
+
+/*
+ * LLVM has no C interface to its CPU and feature tables: it only reports an
+ * unknown name on stderr, once each time it builds a subtarget, and goes on
+ * with a generic one (which, for an unknown CPU, may not even do 64-bit
+ * code). So a machine is built once with stderr sent to a temporary file,
+ * and whatever LLVM says about the names becomes an error.
+ */
+bool codegen_check_target(const char *cpu, const char *features) {
+    bool host_cpu = !cpu || strcmp(cpu, "native") == 0;
+    if (host_cpu && !features) return true;
+
+    char *triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target = NULL;
+    char *error = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, &error) != 0) {
+        fprintf(stderr, "Error: No target for %s: %s\n", triple, error);
+        LLVMDisposeMessage(error);
+        LLVMDisposeMessage(triple);
+        return false;
+    }
+    char *host_name = host_cpu ? LLVMGetHostCPUName() : NULL;
+
+    FILE *capture = tmpfile();
+    int stderr_save = capture ? dup(2) : -1;
+    if (stderr_save >= 0) {
+        fflush(stderr);
+        dup2(fileno(capture), 2);
+    }
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(target, triple, host_cpu ? host_name : cpu, features ? features : "",
+                                                           LLVMCodeGenLevelNone, LLVMRelocPIC, LLVMCodeModelDefault);
+    if (machine) LLVMDisposeTargetMachine(machine);
+    if (stderr_save >= 0) {
+        fflush(stderr);
+        dup2(stderr_save, 2);
+        close(stderr_save);
+    }
+
+    bool ok = machine != NULL;
+    if (!machine) fprintf(stderr, "Error: Cannot create a target machine for %s\n", triple);
+    // The machine may build its subtarget more than once: report each line once
+    long size = capture ? ftell(capture) : 0;
+    char *said = size > 0 ? xmalloc((size_t)size + 1) : NULL;
+    if (said) {
+        rewind(capture);
+        size = (long)fread(said, 1, (size_t)size, capture);
+        said[size] = '\0';
+    }
+    for (char *line = said, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        next = next ? next + 1 : line + strlen(line);
+        size_t len = (size_t)(next - line);
+        bool repeated = false;
+        for (char *seen = said; seen < line && !repeated; seen = strchr(seen, '\n') + 1) {
+            repeated = strncmp(seen, line, len) == 0;
+        }
+        if (repeated) continue;
+        ok = false;
+        char *quote = line[0] == '\'' ? memchr(line + 1, '\'', len - 1) : NULL;
+        int name_len = quote ? (int)(quote - line - 1) : 0;
+        if (quote && strncmp(quote, "' is not a recognized processor", 31) == 0) {
+            fprintf(stderr, "Error: Unknown target CPU '%.*s' for %s (try --target-cpu generic)\n", name_len, line + 1, triple);
+        } else if (quote && strncmp(quote, "' is not a recognized feature", 29) == 0) {
+            fprintf(stderr, "Error: Unknown target feature '%.*s' for %s\n", name_len, line + 1, triple);
+        } else {
+            fprintf(stderr, "%.*s", (int)len, line);
+        }
+    }
+    free(said);
+    if (capture) fclose(capture);
+    if (host_name) LLVMDisposeMessage(host_name);
+    LLVMDisposeMessage(triple);
+    return ok;
+}
+
+/*
+ * A context lowering into a fresh module. With `parent` it borrows the
+ * parent's target machine (and so its CPU, features and backend effort)
+ * instead of building its own.
+ */
+static CodegenContext *context_create(TypeStore *store, const char *module_name, int opt_level,
+                                      ModuleLoader *loader, CodegenContext *parent) {
     CodegenContext *ctx = xmalloc(sizeof(CodegenContext));
     ctx->store = store;
     ctx->context = LLVMContextCreate();
@@ -41,6 +167,7 @@ CodegenContext* codegen_context_create(TypeStore *store, const char *module_name
 
     char *target_triple = LLVMGetDefaultTargetTriple();
     LLVMSetTarget(ctx->module, target_triple);
+    ctx->abi = codegen_abi_for_triple(target_triple);
 
     char *error = NULL;
     if (LLVMGetTargetFromTriple(target_triple, &ctx->target, &error) != 0) {
@@ -50,18 +177,47 @@ CodegenContext* codegen_context_create(TypeStore *store, const char *module_name
         ICE("LLVMGetTargetFromTriple failed: %s", err_msg);
     }
 
-    // 2. Initialize Machine with Host CPU
-    char *cpu = LLVMGetHostCPUName();
-    char *features = LLVMGetHostCPUFeatures();
+    // 2. Initialize Machine: host CPU unless -march / --target-cpu name another
+    Options *opts = loader ? loader->opts : NULL;
+    ctx->fast_compile = opts && opts->fast_compile;
+    if (parent) {
+        ctx->machine = parent->machine;
+        ctx->codegen_level = parent->codegen_level;
+        ctx->owns_machine = false;
+        ctx->target_cpu = xstrdup(parent->target_cpu);
+        ctx->target_features = xstrdup(parent->target_features);
+    } else {
+        const char *cpu_opt = opts ? opts->target_cpu : NULL;
+        bool host_cpu = !cpu_opt || strcmp(cpu_opt, "native") == 0;
+        char *host_name = host_cpu ? LLVMGetHostCPUName() : NULL;
+        char *host_features = host_cpu && !(opts && opts->target_features) ? LLVMGetHostCPUFeatures() : NULL;
+        const char *cpu = host_cpu ? host_name : cpu_opt;
+        const char *features = opts && opts->target_features ? opts->target_features : host_features ? host_features : "";
 
-    ctx->machine = LLVMCreateTargetMachine(
-        ctx->target, target_triple, cpu, features,
-        LLVMCodeGenLevelAggressive, LLVMRelocDefault, LLVMCodeModelDefault
-    );
+        // PIC: cc links position-independent executables by default. -Odev
+        // asks for no backend effort, which selects FastISel and the fast
+        // register allocator.
+        ctx->codegen_level = ctx->fast_compile ? LLVMCodeGenLevelNone : LLVMCodeGenLevelAggressive;
+        ctx->machine = LLVMCreateTargetMachine(
+            ctx->target, target_triple, cpu, features,
+            ctx->codegen_level, LLVMRelocPIC, LLVMCodeModelDefault
+        );
+        ctx->owns_machine = true;
+        ctx->target_cpu = xstrdup(cpu);
+        ctx->target_features = xstrdup(features);
+        if (host_name) LLVMDisposeMessage(host_name);
+        if (host_features) LLVMDisposeMessage(host_features);
+    }
+    ctx->prefer_vector_width = opts ? opts->prefer_vector_width : 0;
+    ctx->strict_overflow = opts && opts->strict_overflow;
+    ctx->strict_aliasing = opts && opts->strict_aliasing;
+    ctx->bounds_checks = opts && opts->bounds_checks;
+    ctx->instrument = opts && opts->instrument;
+    ctx->fold_instances = opts && opts->fold_instances;
+    ctx->comdats = !strstr(target_triple, "apple") && !strstr(target_triple, "darwin");
+    memset(ctx->tbaa_tags, 0, sizeof(ctx->tbaa_tags));
 
     LLVMDisposeMessage(target_triple);
-    LLVMDisposeMessage(cpu);
-    LLVMDisposeMessage(features);
 
     if (!ctx->machine) {
         ICE("Failed to create LLVMTargetMachine");
@@ -71,39 +227,72 @@ CodegenContext* codegen_context_create(TypeStore *store, const char *module_name
     ctx->target_data = LLVMCreateTargetDataLayout(ctx->machine);
     LLVMSetModuleDataLayout(ctx->module, ctx->target_data);
 
-    ctx->globals = hashmap_create(NULL, 1024);
+    ctx->decl_values = hashmap_create(NULL, 1024);
     ctx->type_cache = hashmap_create(NULL, 256);
-    ctx->locals = codegen_map_create(ctx, NULL);
+    ctx->field_slots = hashmap_create(NULL, 16);
+    ctx->type_aligns = hashmap_create(NULL, 16);
+    ctx->abi_signatures = hashmap_create(NULL, 256);
+    ctx->locals = (CodegenLocals){0};
+    dynarray_init(&ctx->locals.undo, sizeof(CodegenLocalUndo));
     ctx->loop_cond_bb = NULL;
     ctx->loop_end_bb = NULL;
     ctx->opt_level = opt_level;
+    ctx->export_wrappers = false;
+    ctx->emit_definitions = true;
+    ctx->cached_bodies = NULL;
+    ctx->export_runtime = false;
+    ctx->stack_allocs = NULL;
+    ctx->safe_subscripts = NULL;
+    ctx->bounds_trap_bb = NULL;
     ctx->current_func_type = NULL;
     ctx->sret_ptr = NULL;
+    ctx->sret_local = NULL;
+    ctx->tail_entry_bb = NULL;
+    ctx->tail_param_slots = NULL;
     ctx->deferred_actions = xmalloc(sizeof(DynArray));
-    dynarray_init(ctx->deferred_actions, sizeof(AstNode*));
+    dynarray_init(ctx->deferred_actions, sizeof(void*));
     ctx->loop_defer_count = 0;
+    ctx->ret_val_var = NULL;
+    ctx->async_frame = NULL;
+    ctx->async_resumes = NULL;
     return ctx;
 }
 
+CodegenContext* codegen_context_create(TypeStore *store, const char *module_name, int opt_level, ModuleLoader *loader) {
+    return context_create(store, module_name, opt_level, loader, NULL);
+}
+
+CodegenContext *codegen_context_derive(CodegenContext *parent, const char *module_name, int opt_level) {
+    return context_create(parent->store, module_name, opt_level, parent->loader, parent);
+}
+
+void codegen_release_module(CodegenContext *ctx) {
+    if (ctx->builder) LLVMDisposeBuilder(ctx->builder);
+    if (ctx->module) LLVMDisposeModule(ctx->module);
+    if (ctx->context) LLVMContextDispose(ctx->context);
+    ctx->builder = NULL;
+    ctx->module = NULL;
+    ctx->context = NULL;
+}
+
 void codegen_context_destroy(CodegenContext *ctx) {
-    hashmap_destroy(ctx->globals, NULL, NULL);
+    hashmap_destroy(ctx->decl_values, NULL, NULL);
     hashmap_destroy(ctx->type_cache, NULL, NULL);
+    hashmap_destroy(ctx->field_slots, NULL, free);
+    hashmap_destroy(ctx->type_aligns, NULL, NULL);
+    hashmap_destroy(ctx->abi_signatures, NULL, free);
+    hashmap_destroy(ctx->stack_allocs, NULL, NULL);
+    hashmap_destroy(ctx->safe_subscripts, NULL, NULL);
     dynarray_free(ctx->deferred_actions);
     free(ctx->deferred_actions);
+    free(ctx->target_cpu);
+    free(ctx->target_features);
     LLVMDisposeTargetData(ctx->target_data);
-    LLVMDisposeTargetMachine(ctx->machine);
-    while (ctx->locals) {
-        CodegenMap *parent = ctx->locals->parent;
-        codegen_map_destroy(ctx->locals);
-        ctx->locals = parent;
-    }
-    LLVMDisposeBuilder(ctx->builder);
-    
-    // CRITICAL FIX: Only dispose the module if the JIT Engine didn't take ownership.
-    if (ctx->module) {
-        LLVMDisposeModule(ctx->module);
-    }
-    
-    LLVMContextDispose(ctx->context);
+    if (ctx->owns_machine) LLVMDisposeTargetMachine(ctx->machine);
+    free(ctx->locals.slots);
+    dynarray_free(&ctx->locals.undo);
+
+    // The module is gone when the JIT took ownership or it was released early
+    codegen_release_module(ctx);
     free(ctx);
 }
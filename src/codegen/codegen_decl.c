@@ -1,53 +1,64 @@
 #include "codegen_internal.h"
 #include "sema/type_utils.h"
+#include "core/trace.h"
+#include "core/stats.h"
+#include "parsing/template_body.h"
+#include <llvm-c/Comdat.h>
+
+/* String attribute `key`=`value` on the function itself. */
+static void add_function_string_attribute(CodegenContext *ctx, LLVMValueRef func, const char *key, const char *value) {
+    LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+        LLVMCreateStringAttribute(ctx->context, key, (unsigned)strlen(key), value, (unsigned)strlen(value)));
+}
 
-static LLVMTypeRef *collect_llvm_param_types(CodegenContext *ctx, Type *fn_type, bool sret, size_t *out_count) {
-    size_t param_count = fn_type->as.func.param_count;
-    size_t llvm_param_count = param_count + (sret ? 1 : 0);
-    LLVMTypeRef *llvm_params = xmalloc(sizeof(LLVMTypeRef) * llvm_param_count);
+/* Enum attribute `name` on the function itself. */
+static void add_function_enum_attribute(CodegenContext *ctx, LLVMValueRef func, const char *name) {
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex, LLVMCreateEnumAttribute(ctx->context, kind, 0));
+}
 
-    size_t idx = 0;
-    if (sret) {
-        llvm_params[idx++] = LLVMPointerType(get_llvm_type(ctx, fn_type->as.func.return_type), 0);
+/* @inline/@noinline/@hot/@cold, and the memory effects sema inferred (sema/purity.h). */
+static void apply_source_attributes(CodegenContext *ctx, LLVMValueRef func, AstFunctionDeclaration *fdecl, Type *fn_type) {
+    if (fdecl->attrs & FN_ATTR_INLINE)   add_function_enum_attribute(ctx, func, "alwaysinline");
+    if (fdecl->attrs & FN_ATTR_NOINLINE) add_function_enum_attribute(ctx, func, "noinline");
+    if (fdecl->attrs & FN_ATTR_HOT)      add_function_enum_attribute(ctx, func, "hot");
+    if (fdecl->attrs & FN_ATTR_COLD)     add_function_enum_attribute(ctx, func, "cold");
+
+    // @noalias params; LLVM numbers them after the sret slot
+    const AbiSignature *sig = codegen_abi_signature(ctx, fn_type);
+    unsigned first_param = sig->ret.kind == ABI_INDIRECT ? 2 : 1;
+    for (size_t i = 0; fdecl->params && i < fdecl->params->count; i++) {
+        AstNode *param = DYNARRAY_AT(AstNode*, fdecl->params, i);
+        if (!param->data.param.is_noalias) continue;
+        unsigned kind = LLVMGetEnumAttributeKindForName("noalias", 7);
+        LLVMAddAttributeAtIndex(func, first_param + (unsigned)i, LLVMCreateEnumAttribute(ctx->context, kind, 0));
     }
 
-    for (size_t i = 0; i < param_count; i++) {
-        Type *param_ty = fn_type->as.func.params[i];
-        if (type_is_indirect(ctx, param_ty)) {
-            llvm_params[idx++] = LLVMPointerType(get_llvm_type(ctx, param_ty), 0);
-        } else {
-            llvm_params[idx++] = get_llvm_type(ctx, param_ty);
-        }
+    // The sret slot is the caller's memory; indirect arguments are read through their pointer.
+    // Instrumented bodies write their counters, so every call has to stay.
+    FunctionMemory memory = (FunctionMemory)fdecl->memory;
+    if (sig->ret.kind == ABI_INDIRECT || memory == FN_MEMORY_ANY || ctx->instrument) return;
+    for (size_t i = 0; memory == FN_MEMORY_NONE && i < sig->param_count; i++) {
+        if (sig->params[i].kind == ABI_INDIRECT) memory = FN_MEMORY_READ;
     }
-
-    *out_count = llvm_param_count;
-    return llvm_params;
+    add_function_enum_attribute(ctx, func, memory == FN_MEMORY_NONE ? "readnone" : "readonly");
 }
 
-static void apply_function_attributes(CodegenContext *ctx, LLVMValueRef func, Type *fn_type, bool sret) {
-    if (sret) {
-        LLVMAddAttributeAtIndex(func, 1, LLVMCreateTypeAttribute(ctx->context, 
-            LLVMGetEnumAttributeKindForName("sret", 4), get_llvm_type(ctx, fn_type->as.func.return_type)));
-    }
-
-    size_t idx = sret ? 1 : 0;
-    size_t param_count = fn_type->as.func.param_count;
-    for (size_t i = 0; i < param_count; i++) {
-        if (type_is_indirect(ctx, fn_type->as.func.params[i])) {
-            LLVMTypeRef param_ty = get_llvm_type(ctx, fn_type->as.func.params[i]);
-            LLVMAddAttributeAtIndex(func, (unsigned)(idx + i + 1), LLVMCreateTypeAttribute(ctx->context, 
-                LLVMGetEnumAttributeKindForName("byval", 5), param_ty));
-        }
+/* Per-function subtarget, so the vectorizers see the same CPU as the backend */
+void codegen_target_attributes(CodegenContext *ctx, LLVMValueRef func) {
+    add_function_string_attribute(ctx, func, "target-cpu", ctx->target_cpu);
+    if (ctx->target_features[0]) add_function_string_attribute(ctx, func, "target-features", ctx->target_features);
+    if (ctx->prefer_vector_width > 0) {
+        char width[16];
+        snprintf(width, sizeof(width), "%d", ctx->prefer_vector_width);
+        add_function_string_attribute(ctx, func, "prefer-vector-width", width);
+        add_function_string_attribute(ctx, func, "min-legal-vector-width", "0");
     }
 }
 
-static char *get_mangled_func_name(CodegenContext *ctx, AstNode *decl) {
-    AstFunctionDeclaration *fdecl = &decl->data.function_declaration;
-    if (fdecl->intern_result && fdecl->intern_result->key) {
-        CompilationUnit *u = module_loader_get_unit(ctx->loader, decl->filename);
-        return mangle_name(ctx, u, fdecl->intern_result, decl->type);
-    }
-    return NULL;
+static void apply_function_attributes(CodegenContext *ctx, LLVMValueRef func, Type *fn_type) {
+    codegen_target_attributes(ctx, func);
+    codegen_abi_attributes(ctx, func, fn_type);
 }
 
 static void codegen_func_proto(CodegenContext *ctx, AstNode *decl) {
@@ -57,96 +68,149 @@ static void codegen_func_proto(CodegenContext *ctx, AstNode *decl) {
         ICE("Function declaration missing type or has incorrect type kind: %d", fn_type_sema ? fn_type_sema->kind : -1);
     }
 
-    // Return type: Use indirect return if large struct
-    bool sret = type_is_indirect(ctx, fn_type_sema->as.func.return_type);
-    LLVMTypeRef ret_type = sret ? LLVMVoidTypeInContext(ctx->context) : get_llvm_type(ctx, fn_type_sema->as.func.return_type);
-    
-    size_t llvm_param_count = 0;
-    LLVMTypeRef *llvm_params = collect_llvm_param_types(ctx, fn_type_sema, sret, &llvm_param_count);
+    const char *name = codegen_decl_name(ctx, decl);
+    if (!name) name = "anon_func";
 
-    char *allocated_name = get_mangled_func_name(ctx, decl);
-    const char *name = allocated_name ? allocated_name : "anon_func";
+    // An async fn is called through its ramp, which only Newt code calls (codegen_async.c)
+    if (decl->data.function_declaration.attrs & FN_ATTR_ASYNC) {
+        LLVMValueRef ramp = LLVMAddFunction(ctx->module, name, codegen_async_ramp_type(ctx, fn_type_sema));
+        ptrmap_put(ctx->decl_values, decl, ramp);
+        codegen_target_attributes(ctx, ramp);
+        return;
+    }
 
-    LLVMTypeRef func_type = LLVMFunctionType(ret_type, llvm_params, (unsigned)llvm_param_count, 0);
-    LLVMValueRef func = LLVMAddFunction(ctx->module, name, func_type);
+    // Parameters and result as the C ABI passes them (codegen_abi.c)
+    LLVMValueRef func = LLVMAddFunction(ctx->module, name, get_llvm_function_type(ctx, fn_type_sema));
+    ptrmap_put(ctx->decl_values, decl, func);
     
-    apply_function_attributes(ctx, func, fn_type_sema, sret);
-
-    if (allocated_name) free(allocated_name);
-    if (llvm_params)     free(llvm_params);
+    apply_function_attributes(ctx, func, fn_type_sema);
+    apply_source_attributes(ctx, func, &decl->data.function_declaration, fn_type_sema);
 }
 
 static void codegen_var_proto(CodegenContext *ctx, AstNode *decl) {
-    AstVariableDeclaration *vdecl = &decl->data.variable_declaration;
     if (!decl->type) ICE("Variable declaration missing type.");
     LLVMTypeRef ty = get_llvm_type(ctx, decl->type);
 
-    const char *name           = "global_var";
-    char       *allocated_name = NULL;
-    if (vdecl->intern_result && vdecl->intern_result->key) {
-        CompilationUnit *u = module_loader_get_unit(ctx->loader, decl->filename);
-        allocated_name = mangle_name(ctx, u, vdecl->intern_result, NULL);
-        name = allocated_name;
-    }
+    const char *name = codegen_decl_name(ctx, decl);
+    if (!name) name = "global_var";
 
     LLVMValueRef gvar = LLVMAddGlobal(ctx->module, ty, name);
-    if (LLVMGetTypeKind(ty) != LLVMVoidTypeKind)
+    codegen_align_storage(ctx, gvar, ty);
+    if (ctx->emit_definitions && LLVMGetTypeKind(ty) != LLVMVoidTypeKind)
         LLVMSetInitializer(gvar, LLVMConstNull(ty));
-
-    if (vdecl->intern_result) {
-        hashmap_put(ctx->globals,
-                    (void*)(intptr_t)(vdecl->intern_result->entry->dense_index + 1),
-                    gvar, ptr_hash, ptr_cmp);
-    }
-    if (allocated_name) free(allocated_name);
+    ptrmap_put(ctx->decl_values, decl, gvar);
 }
 
 void codegen_decl_proto(CodegenContext *ctx, AstNode *decl) {
     if (decl->node_type == AST_FUNCTION_DECLARATION) {
         if (decl->data.function_declaration.type_params && decl->data.function_declaration.type_params->count > 0) return;
+        if (decl->flags & AST_FLAG_PRUNED) return;
         codegen_func_proto(ctx, decl);
     } else if (decl->node_type == AST_VARIABLE_DECLARATION) {
         codegen_var_proto(ctx, decl);
     } else if (decl->node_type == AST_IMPL_DECLARATION) {
         AstImplDeclaration *impl = &decl->data.impl_declaration;
         if (impl->methods) {
-            for (size_t i = 0; i < impl->methods->count; i++) {
-                AstNode *method = *(AstNode**)dynarray_get(impl->methods, i);
+            DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                AstNode *method = *method_it;
                 codegen_decl_proto(ctx, method);
             }
         }
     }
 }
 
+typedef struct {
+    AstNode *local;  // The variable the returns seen so far return
+    HashMap *locals; // var decl -> itself: declared in the body (not globals)
+    bool ok;
+} NamedResult;
+
+static void find_named_result_in(NamedResult *r, AstNode *node) {
+    if (!node || !r->ok) return;
+    switch (node->node_type) {
+        case AST_BLOCK:
+            DYNARRAY_FOREACH(AstNode*, stmt_it, node->data.block.statements) find_named_result_in(r, *stmt_it);
+            break;
+        case AST_IF_STATEMENT:
+            find_named_result_in(r, node->data.if_statement.then_branch);
+            find_named_result_in(r, node->data.if_statement.else_branch);
+            break;
+        case AST_WHILE_STATEMENT:
+            find_named_result_in(r, node->data.while_statement.body);
+            break;
+        case AST_FOR_STATEMENT:
+            find_named_result_in(r, node->data.for_statement.init);
+            find_named_result_in(r, node->data.for_statement.body);
+            break;
+        case AST_SWITCH_STATEMENT:
+            DYNARRAY_FOREACH(AstNode*, arm_it, node->data.switch_statement.cases) find_named_result_in(r, (*arm_it)->data.switch_case.body);
+            find_named_result_in(r, node->data.switch_statement.else_body);
+            break;
+        case AST_VARIABLE_DECLARATION:
+            ptrmap_put(r->locals, node, node);
+            break;
+        case AST_DEFER_STATEMENT:
+            // A defer could still change the variable after the value is taken
+            r->ok = false;
+            break;
+        case AST_RETURN_STATEMENT: {
+            AstNode *expr = node->data.return_statement.expression;
+            Symbol *sym = expr && expr->node_type == AST_IDENTIFIER ? expr->data.identifier.symbol : NULL;
+            AstNode *local = sym && sym->kind == SYMBOL_VARIABLE ? sym->decl_node : NULL;
+            if (!local || local->node_type != AST_VARIABLE_DECLARATION || (r->local && local != r->local)) r->ok = false;
+            else r->local = local;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*
+ * The local an sret function can build its result in (NRVO): every return
+ * returns it, it has the result's own type, and no defer runs after the
+ * value would be taken. It then lives in the caller's slot instead of an
+ * alloca copied out at each return.
+ */
+static AstNode *find_named_result(AstNode *decl, Type *return_type) {
+    NamedResult r = { .locals = hashmap_create(NULL, 16), .ok = true };
+    find_named_result_in(&r, decl->data.function_declaration.body);
+    bool found = r.ok && r.local && ptrmap_get(r.locals, r.local) && r.local->type == return_type;
+    hashmap_destroy(r.locals, NULL, NULL);
+    return found ? r.local : NULL;
+}
+
 static void codegen_func_body(CodegenContext *ctx, AstNode *decl) {
     AstFunctionDeclaration *fdecl = &decl->data.function_declaration;
     Type *fn_type_sema = decl->type;
 
-    const char *name           = "anon_func";
-    char       *allocated_name = NULL;
-    if (fdecl->intern_result && fdecl->intern_result->key) {
-        CompilationUnit *u = module_loader_get_unit(ctx->loader, decl->filename);
-        allocated_name = mangle_name(ctx, u, fdecl->intern_result, decl->type);
-        name = allocated_name;
-    }
+    const char *name = codegen_decl_name(ctx, decl);
+    if (!name) name = "anon_func";
 
-    LLVMValueRef func = LLVMGetNamedFunction(ctx->module, name);
+    LLVMValueRef func = codegen_decl_value(ctx, decl);
     if (!func) ICE("codegen_decl_body: function '%s' not declared in proto pass", name);
+    if (!fdecl->body && fdecl->lazy_body) ICE("codegen_decl_body: body of '%s' was never parsed", name);
+    trace_begin("codegen", name);
 
-    if (fdecl->body) {
+    if (fdecl->body && (fdecl->attrs & FN_ATTR_ASYNC)) {
+        codegen_async_function(ctx, decl, func);
+    } else if (fdecl->body) {
         LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->context, func, "entry");
         LLVMPositionBuilderAtEnd(ctx->builder, entry);
 
-        ctx->locals = codegen_map_create(ctx, ctx->locals);
+        size_t locals_mark = codegen_locals_enter(ctx);
         ctx->current_func_type = fn_type_sema;
         ctx->deferred_actions->count = 0; // Clear for new function
+        codegen_find_stack_allocs(ctx, decl);
+        codegen_find_safe_subscripts(ctx, decl);
 
-        ctx->current_cleanup_bb = NULL;
-        ctx->exit_dest_var = create_entry_block_alloca(ctx, LLVMInt32TypeInContext(ctx->context), "exit_dest");
+        ctx->loop_defer_count = 0;
         
-        bool sret = type_is_indirect(ctx, fn_type_sema->as.func.return_type);
+        const AbiSignature *sig = codegen_abi_signature(ctx, fn_type_sema);
+        bool sret = sig->ret.kind == ABI_INDIRECT;
         if (sret) {
             ctx->sret_ptr = LLVMGetParam(func, 0);
+            ctx->sret_local = find_named_result(decl, fn_type_sema->as.func.return_type);
             ctx->ret_val_var = NULL;
         } else {
             ctx->sret_ptr = NULL;
@@ -162,23 +226,36 @@ static void codegen_func_body(CodegenContext *ctx, AstNode *decl) {
         size_t idx = sret ? 1 : 0;
 
         for (size_t i = 0; i < param_count; i++) {
-            AstNode *param_node = *(AstNode**)dynarray_get(fdecl->params, i);
+            AstNode *param_node = DYNARRAY_AT(AstNode*, fdecl->params, i);
             AstParam *param = &param_node->data.param;
             LLVMValueRef val = LLVMGetParam(func, (unsigned int)idx++);
             Type *param_ty = fn_type_sema->as.func.params[i];
             
             LLVMValueRef storage;
-            if (type_is_indirect(ctx, param_ty)) {
+            if (sig->params[i].kind == ABI_INDIRECT) {
                 storage = val;
             } else {
                 LLVMTypeRef ty = get_llvm_type(ctx, param_node->type);
+                if (sig->params[i].kind == ABI_COERCE) val = codegen_abi_coerce(ctx, val, get_llvm_type(ctx, param_ty));
                 storage = LLVMBuildAlloca(ctx->builder, ty, "param");
+                codegen_align_storage(ctx, storage, ty);
                 LLVMBuildStore(ctx->builder, val, storage);
             }
 
             if (param->name_idx != -1) {
-                codegen_map_put(ctx->locals, (void*)(intptr_t)(param->name_idx + 1), storage);
+                codegen_locals_put(ctx, param->name_idx, storage);
             }
+            if (decl->flags & AST_FLAG_SELF_TAIL_CALL) {
+                if (!ctx->tail_param_slots) ctx->tail_param_slots = xmalloc(sizeof(LLVMValueRef) * param_count);
+                ctx->tail_param_slots[i] = storage;
+            }
+        }
+
+        // A self tail call stores its arguments over the parameters and jumps back here
+        if (decl->flags & AST_FLAG_SELF_TAIL_CALL) {
+            ctx->tail_entry_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "tailrecurse");
+            LLVMBuildBr(ctx->builder, ctx->tail_entry_bb);
+            LLVMPositionBuilderAtEnd(ctx->builder, ctx->tail_entry_bb);
         }
         
         if (fdecl->body) {
@@ -187,17 +264,19 @@ static void codegen_func_body(CodegenContext *ctx, AstNode *decl) {
 
         LLVMBasicBlockRef current_block = LLVMGetInsertBlock(ctx->builder);
         if (current_block && !LLVMGetBasicBlockTerminator(current_block)) {
-            bool sret_implicit = type_is_indirect(ctx, fn_type_sema->as.func.return_type);
-            LLVMTypeRef ret_ty = sret_implicit ? LLVMVoidTypeInContext(ctx->context) : get_llvm_type(ctx, fn_type_sema->as.func.return_type);
+            LLVMTypeRef ret_ty = LLVMGetReturnType(LLVMGlobalGetValueType(func));
             if (LLVMGetTypeKind(ret_ty) == LLVMVoidTypeKind) LLVMBuildRetVoid(ctx->builder);
             else LLVMBuildRet(ctx->builder, LLVMConstNull(ret_ty));
         }
+        if (ctx->instrument) codegen_instrument_function(ctx, decl, func);
 
-        CodegenMap *old = ctx->locals;
-        ctx->locals = old->parent;
-        codegen_map_destroy(old);
+        codegen_locals_leave(ctx, locals_mark);
         ctx->current_func_type = NULL;
         ctx->sret_ptr = NULL;
+        ctx->sret_local = NULL;
+        ctx->tail_entry_bb = NULL;
+        free(ctx->tail_param_slots);
+        ctx->tail_param_slots = NULL;
         
     } else if (fdecl->link_name) {
         Slice *s = (Slice*)fdecl->link_name->key;
@@ -205,12 +284,16 @@ static void codegen_func_body(CodegenContext *ctx, AstNode *decl) {
         memcpy(ext_name, s->ptr, s->len);
         ext_name[s->len] = '\0';
 
-        LLVMSetLinkage(func, LLVMInternalLinkage);
+        if (!ctx->export_wrappers) LLVMSetLinkage(func, LLVMInternalLinkage);
         LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->context, func, "entry");
         LLVMPositionBuilderAtEnd(ctx->builder, entry);
 
+        // The wrapper already has the C signature: forward it with the same sret / byval
         LLVMValueRef ext_func = LLVMGetNamedFunction(ctx->module, ext_name);
-        if (!ext_func) ext_func = LLVMAddFunction(ctx->module, ext_name, LLVMGlobalGetValueType(func));
+        if (!ext_func) {
+            ext_func = LLVMAddFunction(ctx->module, ext_name, LLVMGlobalGetValueType(func));
+            codegen_abi_attributes(ctx, ext_func, fn_type_sema);
+        }
 
         size_t param_count = LLVMCountParams(func);
         LLVMValueRef *args = NULL;
@@ -221,46 +304,94 @@ static void codegen_func_body(CodegenContext *ctx, AstNode *decl) {
 
         LLVMTypeRef ret_ty = LLVMGetReturnType(LLVMGlobalGetValueType(func));
         if (LLVMGetTypeKind(ret_ty) == LLVMVoidTypeKind) {
-            LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(ext_func), ext_func, args, (unsigned int)param_count, "");
+            LLVMValueRef call = LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(ext_func), ext_func, args, (unsigned int)param_count, "");
+            codegen_abi_attributes(ctx, call, fn_type_sema);
             LLVMBuildRetVoid(ctx->builder);
         } else {
             LLVMValueRef call_res = LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(ext_func), ext_func, args, (unsigned int)param_count, "ffi_call");
+            codegen_abi_attributes(ctx, call_res, fn_type_sema);
             LLVMBuildRet(ctx->builder, call_res);
         }
         if (args) free(args);
         free(ext_name);
     }
-    if (allocated_name) free(allocated_name);
+    STAT_INC(CODEGEN_FUNCTIONS);
+    STAT_ADD(CODEGEN_BLOCKS, LLVMCountBasicBlocks(func));
+    trace_end();
 }
 
 void codegen_decl_body(CodegenContext *ctx, AstNode *decl) {
     if (decl->node_type == AST_FUNCTION_DECLARATION) {
         if (decl->data.function_declaration.type_params && decl->data.function_declaration.type_params->count > 0) return;
+        if (decl->flags & (AST_FLAG_PRUNED | AST_FLAG_REUSED)) return;
+        if (ctx->cached_bodies && ptrmap_get(ctx->cached_bodies, decl)) return;
+        // An instance lowers its template's body with what sema wrote for it patched in
+        AstFunctionDeclaration *fdecl = &decl->data.function_declaration;
+        TemplateBody *shared = fdecl->body_patch ? fdecl->template_body : NULL;
+        if (shared && !template_body_bind(shared, fdecl->body_patch)) ICE("codegen_decl_body: template body is already held by this thread");
         codegen_func_body(ctx, decl);
+        if (shared) template_body_unbind(shared);
     } else if (decl->node_type == AST_VARIABLE_DECLARATION) {
         AstVariableDeclaration *vdecl = &decl->data.variable_declaration;
         if (vdecl->initializer) {
-            const char *name           = "global_var";
-            char       *allocated_name = NULL;
-            if (vdecl->intern_result && vdecl->intern_result->key) {
-                CompilationUnit *u = module_loader_get_unit(ctx->loader, decl->filename);
-                allocated_name = mangle_name(ctx, u, vdecl->intern_result, NULL);
-                name = allocated_name;
-            }
-            LLVMValueRef gvar = LLVMGetNamedGlobal(ctx->module, name);
+            LLVMValueRef gvar = codegen_decl_value(ctx, decl);
             if (gvar) {
-                LLVMValueRef init_val = codegen_expr(ctx, vdecl->initializer);
-                if (init_val && LLVMIsConstant(init_val)) LLVMSetInitializer(gvar, init_val);
+                LLVMValueRef init_val = codegen_const_aggregate(ctx, vdecl->initializer);
+                if (init_val && LLVMIsConstant(init_val)) {
+                    LLVMSetInitializer(gvar, init_val);
+                    // Constant tables go to .rodata instead of .data
+                    if (vdecl->is_const) LLVMSetGlobalConstant(gvar, 1);
+                }
             }
-            if (allocated_name) free(allocated_name);
         }
     } else if (decl->node_type == AST_IMPL_DECLARATION) {
         AstImplDeclaration *impl = &decl->data.impl_declaration;
         if (impl->methods) {
-            for (size_t i = 0; i < impl->methods->count; i++) {
-                AstNode *method = *(AstNode**)dynarray_get(impl->methods, i);
+            DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                AstNode *method = *method_it;
                 codegen_decl_body(ctx, method);
             }
         }
     }
 }
+
+/* Give @link wrappers their internal linkage once partitions are linked. */
+void codegen_decl_linkage(CodegenContext *ctx, AstNode *decl) {
+    if (decl->node_type == AST_FUNCTION_DECLARATION) {
+        AstFunctionDeclaration *fdecl = &decl->data.function_declaration;
+        if (fdecl->body || !fdecl->link_name) return;
+        if (fdecl->type_params && fdecl->type_params->count > 0) return;
+        LLVMValueRef func = codegen_decl_value(ctx, decl);
+        if (func && !LLVMIsDeclaration(func)) LLVMSetLinkage(func, LLVMInternalLinkage);
+    } else if (decl->node_type == AST_IMPL_DECLARATION) {
+        AstImplDeclaration *impl = &decl->data.impl_declaration;
+        if (impl->methods) {
+            for (size_t i = 0; i < impl->methods->count; i++) {
+                codegen_decl_linkage(ctx, DYNARRAY_AT(AstNode*, impl->methods, i));
+            }
+        }
+    }
+}
+
+/*
+ * Generic instances are defined by every module that needs them: linkonce_odr
+ * in a COMDAT named after the symbol, so the linker keeps one copy of each,
+ * and unnamed_addr, so --icf may fold instances whose code is the same. A
+ * `keep` instance (the only function of a cached object) is weak_odr, which
+ * nothing in its own module has to reference to keep it alive.
+ */
+void codegen_decl_instance_linkage(CodegenContext *ctx, AstNode *decl, bool keep) {
+    if (decl->node_type == AST_FUNCTION_DECLARATION) {
+        if (!decl->data.function_declaration.body) return;
+        LLVMValueRef func = codegen_decl_value(ctx, decl);
+        if (!func || LLVMIsDeclaration(func)) return;
+        LLVMSetLinkage(func, keep ? LLVMWeakODRLinkage : LLVMLinkOnceODRLinkage);
+        LLVMSetUnnamedAddress(func, LLVMGlobalUnnamedAddr);
+        if (ctx->comdats) LLVMSetComdat(func, LLVMGetOrInsertComdat(ctx->module, codegen_decl_name(ctx, decl)));
+    } else if (decl->node_type == AST_IMPL_DECLARATION) {
+        AstImplDeclaration *impl = &decl->data.impl_declaration;
+        if (impl->methods) {
+            DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) codegen_decl_instance_linkage(ctx, *method_it, keep);
+        }
+    }
+}
@@ -0,0 +1,217 @@
+/**
+ * @file codegen_devirt.c
+ * @brief Direct calls through the function-pointer fields of known allocators.
+ *
+ * @alloc, @free and Allocator's forwarding methods call through the `_alloc`
+ * and `_free` pointers of an allocator struct. Often the struct plainly comes
+ * from a literal naming the functions: the constant std.heap.allocator, a
+ * local initialized from a struct literal, or from a call whose whole body
+ * returns one (FixedArena.get_allocator). Such a call compares the loaded
+ * pointer with that function and calls it directly on a match, so LLVM can
+ * inline a bump allocation into the caller. The compare keeps the call right
+ * when the allocator was reassigned or written through a pointer since; where
+ * the stored pointer is visible to the optimizer, it folds away.
+ */
+
+#include "codegen_internal.h"
+#include "codegen/codegen_utils.h"
+
+#define KNOWN_LITERAL_DEPTH 4 // Variables and constructor calls followed to reach a literal
+
+static Symbol *expr_symbol(AstNode *expr) {
+    if (expr->node_type == AST_IDENTIFIER) return expr->data.identifier.symbol;
+    if (expr->node_type == AST_MEMBER_EXPR && !expr->data.member_expr.is_instance_method) return expr->data.member_expr.symbol;
+    return NULL;
+}
+
+/* The statement `fn` consists of, or NULL when its body is not exactly one. */
+static AstNode *only_statement(AstNode *fn) {
+    if (!fn || fn->node_type != AST_FUNCTION_DECLARATION) return NULL;
+    AstFunctionDeclaration *f = &fn->data.function_declaration;
+    if (f->type_params && f->type_params->count > 0) return NULL;
+    AstNode *body = f->body;
+    if (!body || body->node_type != AST_BLOCK || !body->data.block.statements) return NULL;
+    if (body->data.block.statements->count != 1) return NULL;
+    return DYNARRAY_AT(AstNode*, body->data.block.statements, 0);
+}
+
+/* The struct literal the value of `expr` (or what it points to) was built from, as far as it is visible. */
+static AstNode *known_literal(AstNode *expr, int depth) {
+    if (!expr || depth > KNOWN_LITERAL_DEPTH) return NULL;
+    switch (expr->node_type) {
+        case AST_STRUCT_LITERAL:
+            return expr;
+        case AST_UNARY_EXPR:
+            if (expr->data.unary_expr.op != OP_ADDRESS) return NULL;
+            return known_literal(expr->data.unary_expr.expr, depth);
+        case AST_IDENTIFIER:
+        case AST_MEMBER_EXPR: {
+            Symbol *sym = expr_symbol(expr);
+            while (sym && sym->kind == SYMBOL_VALUE_ALIAS) sym = sym->target_symbol;
+            if (!sym || sym->kind != SYMBOL_VARIABLE || !sym->decl_node) return NULL;
+            if (sym->decl_node->node_type != AST_VARIABLE_DECLARATION) return NULL;
+            return known_literal(sym->decl_node->data.variable_declaration.initializer, depth + 1);
+        }
+        case AST_CALL_EXPR: {
+            // A constructor: fn f(...) -> Allocator { return Allocator { ... }; }
+            Symbol *sym = expr_symbol(expr->data.call_expr.callee);
+            if (!sym && expr->data.call_expr.callee->node_type == AST_MEMBER_EXPR) sym = expr->data.call_expr.callee->data.member_expr.symbol;
+            AstNode *stmt = sym ? only_statement(sym->decl_node) : NULL;
+            if (!stmt || stmt->node_type != AST_RETURN_STATEMENT) return NULL;
+            AstNode *ret = stmt->data.return_statement.expression;
+            return ret && ret->node_type == AST_STRUCT_LITERAL ? ret : NULL;
+        }
+        default:
+            return NULL;
+    }
+}
+
+LLVMValueRef codegen_known_field_fn(CodegenContext *ctx, AstNode *aggregate, InternResult *field) {
+    AstNode *lit = known_literal(aggregate, 0);
+    if (!lit || !lit->data.struct_literal.fields) return NULL;
+    DYNARRAY_FOREACH(AstFieldInit, init, lit->data.struct_literal.fields) {
+        if (init->name != field) continue;
+        Symbol *sym = expr_symbol(init->expr);
+        while (sym && sym->kind == SYMBOL_VALUE_ALIAS) sym = sym->target_symbol;
+        if (!sym || sym->kind != SYMBOL_VALUE_FUNCTION || !sym->decl_node) return NULL;
+        if (sym->decl_node->node_type != AST_FUNCTION_DECLARATION || !sym->decl_node->data.function_declaration.mangled_name) return NULL;
+        return codegen_decl_value(ctx, sym->decl_node);
+    }
+    return NULL;
+}
+
+LLVMValueRef codegen_devirt_call(CodegenContext *ctx, LLVMTypeRef fn_ty, LLVMValueRef fn_ptr, LLVMValueRef known,
+                                 LLVMValueRef *args, unsigned nargs, const char *name) {
+    bool has_result = LLVMGetTypeKind(LLVMGetReturnType(fn_ty)) != LLVMVoidTypeKind;
+    if (!has_result) name = "";
+    if (!known || LLVMGlobalGetValueType(known) != fn_ty) return LLVMBuildCall2(ctx->builder, fn_ty, fn_ptr, args, nargs, name);
+    if (fn_ptr == known) return LLVMBuildCall2(ctx->builder, fn_ty, known, args, nargs, name);
+
+    LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+    LLVMBasicBlockRef direct_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "devirt.direct");
+    LLVMBasicBlockRef indirect_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "devirt.indirect");
+    LLVMBasicBlockRef join_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "devirt.join");
+
+    LLVMValueRef same = LLVMBuildICmp(ctx->builder, LLVMIntEQ, fn_ptr, known, "devirt.known");
+    LLVMValueRef br = LLVMBuildCondBr(ctx->builder, same, direct_bb, indirect_bb);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+    LLVMMetadataRef weights[] = {
+        LLVMMDStringInContext2(ctx->context, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 2000, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 1, 0)),
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(ctx->context, "prof", 4),
+                    LLVMMetadataAsValue(ctx->context, LLVMMDNodeInContext2(ctx->context, weights, 3)));
+
+    LLVMPositionBuilderAtEnd(ctx->builder, direct_bb);
+    LLVMValueRef direct = LLVMBuildCall2(ctx->builder, fn_ty, known, args, nargs, name);
+    LLVMBuildBr(ctx->builder, join_bb);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, indirect_bb);
+    LLVMValueRef indirect = LLVMBuildCall2(ctx->builder, fn_ty, fn_ptr, args, nargs, name);
+    LLVMBuildBr(ctx->builder, join_bb);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, join_bb);
+    if (!has_result) return direct;
+    LLVMValueRef phi = LLVMBuildPhi(ctx->builder, LLVMGetReturnType(fn_ty), name);
+    LLVMValueRef vals[] = { direct, indirect };
+    LLVMBasicBlockRef blocks[] = { direct_bb, indirect_bb };
+    LLVMAddIncoming(phi, vals, blocks, 2);
+    return phi;
+}
+
+/* A type that crosses a call as itself, with no ABI rewriting. */
+static bool passes_directly(Type *t) {
+    return t && (type_is_void(t) || type_is_integer(t) || type_is_bool(t) || type_is_char(t) ||
+                 type_is_float(t) || t->kind == TYPE_POINTER);
+}
+
+/* The index of the parameter of `fn` that `node` names, or -1. */
+static int param_index(AstNode *fn, AstNode *node) {
+    if (node->node_type != AST_IDENTIFIER || !node->data.identifier.symbol) return -1;
+    DynArray *params = fn->data.function_declaration.params;
+    for (size_t i = 0; params && i < params->count; i++) {
+        if (node->data.identifier.symbol->decl_node == DYNARRAY_AT(AstNode*, params, i)) return (int)i;
+    }
+    return -1;
+}
+
+/* `node` is `self.<field>` on the method's receiver: the field, else NULL. */
+static InternResult *receiver_field(AstNode *fn, AstNode *node) {
+    if (node->node_type != AST_MEMBER_EXPR || node->data.member_expr.is_instance_method) return NULL;
+    return param_index(fn, node->data.member_expr.target) == 0 ? node->data.member_expr.member : NULL;
+}
+
+/*
+ * A method whose body is only `self.f(a, ...)` or `return self.f(a, ...)`,
+ * `f` a function-pointer field and each argument a receiver field or a
+ * parameter, like Allocator.alloc(size) and Allocator.free(ptr). Returns the
+ * inner call.
+ */
+static AstNode *forwarded_call(AstNode *method) {
+    AstNode *stmt = only_statement(method);
+    if (!stmt) return NULL;
+    AstNode *call = stmt->node_type == AST_RETURN_STATEMENT ? stmt->data.return_statement.expression :
+                    stmt->node_type == AST_EXPR_STATEMENT ? stmt->data.expr_statement.expression : NULL;
+    if (!call || call->node_type != AST_CALL_EXPR) return NULL;
+    AstNode *callee = call->data.call_expr.callee;
+    if (!receiver_field(method, callee) || !callee->type || callee->type->kind != TYPE_FUNCTION) return NULL;
+
+    Type *fn_type = callee->type;
+    if (!passes_directly(fn_type->as.func.return_type)) return NULL;
+    for (size_t i = 0; i < fn_type->as.func.param_count; i++) {
+        if (!passes_directly(fn_type->as.func.params[i])) return NULL;
+        AstNode *arg = DYNARRAY_AT(AstNode*, call->data.call_expr.args, i);
+        if (!receiver_field(method, arg) && param_index(method, arg) <= 0) return NULL;
+    }
+    return call;
+}
+
+LLVMValueRef codegen_forwarding_call(CodegenContext *ctx, AstNode *expr, bool *handled) {
+    *handled = false;
+    AstNode *callee = expr->data.call_expr.callee;
+    DynArray *call_args = expr->data.call_expr.args;
+    if (callee->node_type != AST_MEMBER_EXPR || !callee->data.member_expr.self_injected || !call_args) return NULL;
+    Symbol *method_sym = callee->data.member_expr.symbol;
+    AstNode *method = method_sym ? method_sym->decl_node : NULL;
+    AstNode *inner = method ? forwarded_call(method) : NULL;
+    if (!inner) return NULL;
+
+    // The injected receiver is argument 0, a pointer to the struct
+    AstNode *receiver = DYNARRAY_AT(AstNode*, call_args, 0);
+    if (!receiver->type || receiver->type->kind != TYPE_POINTER) return NULL;
+    Type *self_type = receiver->type->as.ptr.base;
+    if (!self_type || self_type->kind != TYPE_STRUCT) return NULL;
+    InternResult *fn_field = inner->data.call_expr.callee->data.member_expr.member;
+    LLVMValueRef known = codegen_known_field_fn(ctx, receiver, fn_field);
+    if (!known) return NULL;
+    *handled = true;
+
+    LLVMValueRef *outer = xmalloc(sizeof(LLVMValueRef) * call_args->count);
+    for (size_t i = 0; i < call_args->count; i++) outer[i] = codegen_expr(ctx, DYNARRAY_AT(AstNode*, call_args, i));
+    LLVMValueRef self_val = codegen_load_value(ctx, outer[0], self_type);
+
+    Type *fn_type = inner->data.call_expr.callee->type;
+    size_t nargs = fn_type->as.func.param_count;
+    LLVMValueRef *args = xmalloc(sizeof(LLVMValueRef) * (nargs + 1));
+    for (size_t i = 0; i < nargs; i++) {
+        AstNode *arg = DYNARRAY_AT(AstNode*, inner->data.call_expr.args, i);
+        InternResult *field = receiver_field(method, arg);
+        size_t idx;
+        if (!field) {
+            args[i] = outer[param_index(method, arg)];
+        } else if (get_struct_field_index(self_type, field, &idx)) {
+            args[i] = LLVMBuildExtractValue(ctx->builder, self_val, codegen_field_slot(ctx, self_type, idx), "fwd_field");
+        } else {
+            ICE_AT(arg, "forwarded field missing from the receiver");
+        }
+    }
+
+    size_t fn_idx;
+    if (!get_struct_field_index(self_type, fn_field, &fn_idx)) ICE_AT(expr, "forwarded function field missing from the receiver");
+    LLVMValueRef fn_ptr = LLVMBuildExtractValue(ctx->builder, self_val, codegen_field_slot(ctx, self_type, fn_idx), "fwd_fn");
+    LLVMValueRef result = codegen_devirt_call(ctx, get_llvm_function_type(ctx, fn_type), fn_ptr, known, args, (unsigned)nargs, "fwd_call");
+    free(outer);
+    free(args);
+    return type_is_void(expr->type) ? NULL : result;
+}
@@ -1,8 +1,29 @@
 #include "codegen_internal.h"
+#include "core/trace.h"
+#include "core/stats.h"
+#include "core/runtime.h"
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/PassBuilder.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Support.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Comdat.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Object.h>
+#include <llvm/Config/llvm-config.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
 
 void codegen_initialize(void) {
     LLVMInitializeAllTargetInfos();
@@ -13,6 +34,14 @@ void codegen_initialize(void) {
     LLVMLinkInMCJIT();
     LLVMLoadLibraryPermanently(NULL);
 
+#if LLVM_VERSION_MAJOR < 15
+    // Codegen assumes opaque pointers (every pointer is `ptr`). LLVM 14 only
+    // offers them behind a command-line switch, so turn it on before any
+    // context is created.
+    const char *llvm_args[] = { "newt", "-opaque-pointers" };
+    LLVMParseCommandLineOptions(2, llvm_args, NULL);
+#endif
+
 #ifdef _WIN32
     // On Windows, LLVMLoadLibraryPermanently(NULL) does not expose CRT symbols
     // to the JIT. We must explicitly load the UCRT DLL so that @link("malloc"),
@@ -22,15 +51,91 @@ void codegen_initialize(void) {
 #endif
 }
 
-static void run_optimizations(CodegenContext *ctx) {
-    if (ctx->opt_level <= 0) return;
+/* The new-PM pipeline text for -O<level>. */
+static void default_pipeline(char *buf, size_t size, int level) {
+#if LLVM_VERSION_MAJOR < 15
+    // LLVM 14's loop access analysis and argument promotion still ask a
+    // pointer for its pointee type, which opaque pointers do not have:
+    // loop-vectorize and loop-load-elim crash on the first loop that needs
+    // a runtime alias check, -O3's argpromotion on a promotable argument.
+    // Run the default simplification (at most -O2) and its optimization
+    // tail without those passes; the SLP vectorizer still runs.
+    int simplify = level < 2 ? level : 2;
+    snprintf(buf, size,
+             "thinlto-pre-link<O%d>,function(float2int,lower-constant-intrinsics,loop(loop-rotate,loop-deletion),"
+             "inject-tli-mappings,slp-vectorizer,vector-combine,instcombine,loop-unroll<O%d>,transform-warning,"
+             "instcombine,loop-mssa(licm),alignment-from-assumptions,loop-sink,instsimplify,div-rem-pairs,simplifycfg),"
+             "globaldce,constmerge,rel-lookup-table-converter",
+             simplify, level);
+#else
+    snprintf(buf, size, "default<O%d>", level);
+#endif
+}
 
-    char passes[32];
-    snprintf(passes, sizeof(passes), "default<O%d>", ctx->opt_level);
+static bool has_always_inline(LLVMModuleRef mod) {
+    unsigned kind = LLVMGetEnumAttributeKindForName("alwaysinline", strlen("alwaysinline"));
+    for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMGetEnumAttributeAtIndex(fn, LLVMAttributeFunctionIndex, kind)) return true;
+    }
+    return false;
+}
 
+static void run_optimizations(CodegenContext *ctx) {
+    // -O0 still honours @inline, and only needs the pass manager for it
+    char passes[512];
+    if (ctx->opt_level <= 0) {
+        if (!has_always_inline(ctx->module)) return;
+        snprintf(passes, sizeof(passes), "always-inline");
+    } else {
+        default_pipeline(passes, sizeof(passes), ctx->opt_level);
+    }
+
+    trace_begin("codegen", passes);
     LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
     LLVMRunPasses(ctx->module, passes, ctx->machine, opts);
     LLVMDisposePassBuilderOptions(opts);
+    trace_end();
+}
+
+/*
+ * Whether to run the module verifier after lowering. -Odev trusts the
+ * lowering for compile latency; development builds of the compiler always
+ * verify.
+ */
+static bool should_verify(CodegenContext *ctx) {
+#ifdef DEV_BUILD
+    (void)ctx;
+    return true;
+#else
+    return !ctx->fast_compile;
+#endif
+}
+
+/*
+ * Identical code folding: mergefunc keeps one of every set of functions with
+ * the same body. Instances are unnamed_addr and discardable, so the others
+ * are replaced outright; any other function becomes a jump to its twin.
+ */
+static void fold_identical_functions(CodegenContext *ctx) {
+    size_t before = 0, after = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) before++;
+    }
+
+    trace_begin("codegen", "mergefunc");
+    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef err = LLVMRunPasses(ctx->module, "mergefunc,globaldce", ctx->machine, opts);
+    LLVMDisposePassBuilderOptions(opts);
+    trace_end();
+    if (err) {
+        char *msg = LLVMGetErrorMessage(err);
+        ICE("Folding identical functions failed: %s", msg);
+    }
+
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) after++;
+    }
+    STAT_ADD(CODEGEN_FOLDED, before - after);
 }
 
 static bool is_generic_template(AstNode *decl) {
@@ -48,60 +153,636 @@ static bool is_generic_template(AstNode *decl) {
     return false;
 }
 
-int codegen_program(CodegenContext *ctx) {
-    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return -1;
+static void codegen_unit_protos(CodegenContext *ctx, CompilationUnit *unit) {
+    if (!unit->ast_root) return;
 
-    // Pass 1: Protos (All units)
-    for (size_t i = 0; i < ctx->loader->units_ordered->count; i++) {
-        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(ctx->loader->units_ordered, i);
-        if (!unit->ast_root) continue;
-        
-        AstProgram *prog = &unit->ast_root->data.program;
-        if (!prog->decls) continue;
+    AstProgram *prog = &unit->ast_root->data.program;
+    if (!prog->decls) return;
 
-        for (size_t j = 0; j < prog->decls->count; j++) {
-            AstNode *decl = *(AstNode**)dynarray_get(prog->decls, j);
-            if (decl->node_type != AST_IMPORT_DECLARATION && !is_generic_template(decl)) {
-                codegen_decl_proto(ctx, decl);
-            }
+    // Globals of a prebuilt unit are defined in its object.
+    bool emit_definitions = ctx->emit_definitions;
+    if (unit->prebuilt) ctx->emit_definitions = false;
+    DYNARRAY_FOREACH(AstNode*, decl_it, prog->decls) {
+        AstNode *decl = *decl_it;
+        if (decl->node_type != AST_IMPORT_DECLARATION && !is_generic_template(decl)) {
+            codegen_decl_proto(ctx, decl);
+        }
+    }
+    ctx->emit_definitions = emit_definitions;
+
+    if (unit->mono_instances) {
+        DYNARRAY_FOREACH(AstNode*, mono_decl_it, unit->mono_instances) {
+            AstNode *mono_decl = *mono_decl_it;
+            codegen_decl_proto(ctx, mono_decl);
+        }
+    }
+}
+
+/*
+ * Lower the unit's own declarations (`decls`) and/or its generic instances
+ * (`monos`). A prebuilt unit only ever needs its instances: those depend on
+ * the program, everything else is in the cached object.
+ */
+static void codegen_unit_bodies(CodegenContext *ctx, CompilationUnit *unit, bool decls, bool monos) {
+    if (!unit->ast_root) return;
+
+    AstProgram *prog = &unit->ast_root->data.program;
+    if (!prog->decls) return;
+
+    for (size_t j = 0; decls && j < prog->decls->count; j++) {
+        AstNode *decl = DYNARRAY_AT(AstNode*, prog->decls, j);
+        if (decl->node_type != AST_IMPORT_DECLARATION && !is_generic_template(decl)) {
+            codegen_decl_body(ctx, decl);
         }
+    }
+
+    if (monos && unit->mono_instances) {
+        DYNARRAY_FOREACH(AstNode*, mono_decl_it, unit->mono_instances) {
+            AstNode *mono_decl = *mono_decl_it;
+            codegen_decl_body(ctx, mono_decl);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Partitioned IR generation
+// -----------------------------------------------------------------------------
+//
+// With -j N the units are split into contiguous, roughly equal slices. Each
+// slice is lowered on its own thread into a private LLVM context and module:
+// protos for every unit (so cross-unit references resolve to declarations),
+// bodies only for the units it owns. The slices travel back as bitcode and
+// are linked into ctx->module in unit order, which keeps the result
+// deterministic. Sema state is only read while lowering.
+
+typedef struct {
+    CodegenContext *ctx;
+    size_t first;               // Owned units: [first, last) of units_ordered
+    size_t last;
+    LLVMMemoryBufferRef bitcode;
+} CodegenPartition;
 
+typedef struct {
+    CodegenPartition *parts;
+    size_t count;
+    size_t first;               // This worker lowers first, first + stride, ...
+    size_t stride;
+    pthread_t thread;
+} PartitionWorker;
+
+static size_t unit_weight(CompilationUnit *unit) {
+    size_t w = 1;
+    if (unit->ast_root && unit->ast_root->data.program.decls) w += unit->ast_root->data.program.decls->count;
+    if (unit->mono_instances) w += unit->mono_instances->count;
+    return w;
+}
+
+/*
+ * Symbol names are cached on the declarations on first use. Partitions share
+ * the AST, so everything they can declare is named here, before any thread
+ * starts, and the threads only ever read the cache.
+ */
+static void codegen_name_decl(CodegenContext *ctx, AstNode *decl) {
+    if (decl->node_type == AST_FUNCTION_DECLARATION || decl->node_type == AST_VARIABLE_DECLARATION) {
+        codegen_decl_name(ctx, decl);
+    } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+        DYNARRAY_FOREACH(AstNode*, method_it, decl->data.impl_declaration.methods) codegen_name_decl(ctx, *method_it);
+    }
+}
+
+static void codegen_name_program(CodegenContext *ctx) {
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type != AST_IMPORT_DECLARATION && !is_generic_template(decl)) codegen_name_decl(ctx, decl);
+        }
         if (unit->mono_instances) {
-            for (size_t k = 0; k < unit->mono_instances->count; k++) {
-                AstNode *mono_decl = *(AstNode**)dynarray_get(unit->mono_instances, k);
-                codegen_decl_proto(ctx, mono_decl);
-            }
+            DYNARRAY_FOREACH(AstNode*, mono_decl_it, unit->mono_instances) codegen_name_decl(ctx, *mono_decl_it);
         }
     }
-    
-    // Pass 2: Bodies (All units)
-    for (size_t i = 0; i < ctx->loader->units_ordered->count; i++) {
-        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(ctx->loader->units_ordered, i);
-        if (!unit->ast_root) continue;
+}
+
+static void *codegen_partition_main(void *arg) {
+    CodegenPartition *part = arg;
+    CodegenContext *ctx = part->ctx;
+    DynArray *units = ctx->loader->units_ordered;
+    trace_begin("codegen", LLVMGetModuleIdentifier(ctx->module, &(size_t){0}));
+
+    for (size_t i = 0; i < units->count; i++) {
+        ctx->emit_definitions = i >= part->first && i < part->last;
+        codegen_unit_protos(ctx, DYNARRAY_AT(CompilationUnit*, units, i));
+    }
+    ctx->emit_definitions = true;
+    for (size_t i = part->first; i < part->last; i++) {
+        CompilationUnit *unit = DYNARRAY_AT(CompilationUnit*, units, i);
+        codegen_unit_bodies(ctx, unit, !unit->prebuilt, true);
+    }
+
+    part->bitcode = LLVMWriteBitcodeToMemoryBuffer(ctx->module);
+    trace_end();
+    return NULL;
+}
+
+static void *codegen_partition_worker(void *arg) {
+    PartitionWorker *w = arg;
+    for (size_t p = w->first; p < w->count; p += w->stride) {
+        codegen_partition_main(&w->parts[p]);
+    }
+    return NULL;
+}
+
+static void *codegen_partition_thread(void *arg) {
+    codegen_partition_worker(arg);
+    arena_scratch_release(); // Type layouts use the per-thread scratch arena
+    return NULL;
+}
+
+/* Lower every partition on up to `threads` threads (the caller's included). */
+static void codegen_lower_partitions(CodegenPartition *parts, size_t count, size_t threads) {
+    if (threads > count) threads = count;
+    if (threads < 1) threads = 1;
+    if (count > 0) codegen_name_program(parts[0].ctx);
+
+    PartitionWorker *workers = xcalloc(threads, sizeof(PartitionWorker));
+    for (size_t t = 0; t < threads; t++) {
+        workers[t] = (PartitionWorker){ parts, count, t, threads, 0 };
+    }
+
+    size_t started = 0;
+    for (size_t t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, codegen_partition_thread, &workers[t]) != 0) break;
+        started = t;
+    }
+    codegen_partition_worker(&workers[0]);
+    for (size_t t = 1; t <= started; t++) pthread_join(workers[t].thread, NULL);
+    for (size_t t = started + 1; t < threads; t++) codegen_partition_worker(&workers[t]);
+    free(workers);
+}
+
+static void codegen_program_partitioned(CodegenContext *ctx, size_t parts) {
+    DynArray *units = ctx->loader->units_ordered;
+    CodegenPartition *partitions = xcalloc(parts, sizeof(CodegenPartition));
+
+    size_t total = 0;
+    for (size_t i = 0; i < units->count; i++) total += unit_weight(DYNARRAY_AT(CompilationUnit*, units, i));
+
+    // Contiguous split: close a slice once it reaches its share of the weight.
+    size_t next = 0, acc = 0;
+    for (size_t p = 0; p < parts; p++) {
+        partitions[p].first = next;
+        size_t goal = total * (p + 1) / parts;
+        while (next < units->count && (acc < goal || p == parts - 1) &&
+               units->count - next > parts - p - 1) {
+            acc += unit_weight(DYNARRAY_AT(CompilationUnit*, units, next));
+            next++;
+        }
+        partitions[p].last = next;
+    }
+
+    char name[32];
+    for (size_t p = 0; p < parts; p++) {
+        snprintf(name, sizeof(name), "cgu_%zu", p);
+        partitions[p].ctx = codegen_context_derive(ctx, name, ctx->opt_level);
+        partitions[p].ctx->export_wrappers = true;
+        partitions[p].ctx->cached_bodies = ctx->cached_bodies;
+    }
+
+    codegen_lower_partitions(partitions, parts, parts);
 
-        AstProgram *prog = &unit->ast_root->data.program;
-        if (!prog->decls) continue;
+    trace_begin("codegen", "merge partitions");
+    for (size_t p = 0; p < parts; p++) {
+        LLVMModuleRef piece = NULL;
+        if (LLVMParseBitcodeInContext2(ctx->context, partitions[p].bitcode, &piece) != 0) {
+            ICE("Failed to read back IR of codegen partition %zu", p);
+        }
+        if (LLVMLinkModules2(ctx->module, piece) != 0) {
+            ICE("Failed to link codegen partition %zu", p);
+        }
+        LLVMDisposeMemoryBuffer(partitions[p].bitcode);
+        codegen_context_destroy(partitions[p].ctx);
+    }
+    trace_end();
+    free(partitions);
 
-        for (size_t j = 0; j < prog->decls->count; j++) {
-            AstNode *decl = *(AstNode**)dynarray_get(prog->decls, j);
+    // Linking replaces declarations with the definitions of later pieces
+    hashmap_destroy(ctx->decl_values, NULL, NULL);
+    ctx->decl_values = hashmap_create(NULL, 1024);
+
+    // Wrappers stay external until every partition is linked in, and for
+    // good when cached instances call into them.
+    if (ctx->export_wrappers) return;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DynArray *decls = unit->ast_root->data.program.decls;
+        DYNARRAY_FOREACH(AstNode*, decl_it, decls) {
+            AstNode *decl = *decl_it;
             if (decl->node_type != AST_IMPORT_DECLARATION && !is_generic_template(decl)) {
-                codegen_decl_body(ctx, decl);
+                codegen_decl_linkage(ctx, decl);
             }
         }
+    }
+}
 
-        if (unit->mono_instances) {
-            for (size_t k = 0; k < unit->mono_instances->count; k++) {
-                AstNode *mono_decl = *(AstNode**)dynarray_get(unit->mono_instances, k);
-                codegen_decl_body(ctx, mono_decl);
+// -----------------------------------------------------------------------------
+// Prebuilt library objects
+// -----------------------------------------------------------------------------
+//
+// The non-generic code of a library unit only depends on the sources of the
+// unit and its imports, the opt level and the target. It is compiled once
+// into <cache_dir>/<key>.o and the program module then only declares it.
+
+#define PREBUILT_FORMAT_VERSION 3
+
+static uint64_t fnv_mix(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t fnv_mix_str(uint64_t h, const char *s) {
+    return fnv_mix(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+/* Fold the source hashes of `unit` and everything it imports into `h`. */
+static uint64_t mix_import_closure(CodegenContext *ctx, CompilationUnit *unit, HashMap *seen, uint64_t h) {
+    if (ptrmap_get(seen, unit)) return h;
+    ptrmap_put(seen, unit, unit);
+
+    h = fnv_mix(h, &unit->cache_key, sizeof(unit->cache_key));
+    h = fnv_mix_str(h, unit->logical_path);
+
+    DynArray *decls = unit->ast_root ? unit->ast_root->data.program.decls : NULL;
+    for (size_t i = 0; decls && i < decls->count; i++) {
+        AstNode *decl = DYNARRAY_AT(AstNode*, decls, i);
+        if (decl->node_type != AST_IMPORT_DECLARATION) continue;
+        const char *logical = decl->data.import_declaration.resolved_logical_path;
+        CompilationUnit *dep = logical ? hashmap_get(ctx->loader->units_by_logical_path, (void*)logical, str_hash, str_cmp) : NULL;
+        if (dep) h = mix_import_closure(ctx, dep, seen, h);
+    }
+    return h;
+}
+
+/* Everything an object depends on besides its sources. */
+static uint64_t mix_target(CodegenContext *ctx, uint64_t h) {
+    int version = PREBUILT_FORMAT_VERSION;
+    h = fnv_mix(h, &version, sizeof(version));
+    h = fnv_mix(h, &ctx->opt_level, sizeof(ctx->opt_level));
+    h = fnv_mix(h, &ctx->codegen_level, sizeof(ctx->codegen_level));
+    h = fnv_mix(h, &ctx->prefer_vector_width, sizeof(ctx->prefer_vector_width));
+    h = fnv_mix(h, &ctx->strict_overflow, sizeof(ctx->strict_overflow));
+    h = fnv_mix(h, &ctx->strict_aliasing, sizeof(ctx->strict_aliasing));
+    h = fnv_mix(h, &ctx->bounds_checks, sizeof(ctx->bounds_checks));
+
+    char *triple = LLVMGetTargetMachineTriple(ctx->machine);
+    char *cpu = LLVMGetTargetMachineCPU(ctx->machine);
+    char *features = LLVMGetTargetMachineFeatureString(ctx->machine);
+    h = fnv_mix_str(h, triple);
+    h = fnv_mix_str(h, cpu);
+    h = fnv_mix_str(h, features);
+    LLVMDisposeMessage(triple);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+    return h;
+}
+
+static uint64_t prebuilt_key(CodegenContext *ctx, CompilationUnit *unit) {
+    uint64_t h = mix_target(ctx, 0xcbf29ce484222325ULL);
+    HashMap *seen = hashmap_create(NULL, 16);
+    h = mix_import_closure(ctx, unit, seen, h);
+    hashmap_destroy(seen, NULL, NULL);
+    return h;
+}
+
+/*
+ * Optimize `lib`, verify it and publish it as the object at `path`.
+ * Destroys `lib`.
+ */
+static bool write_cached_object(CodegenContext *lib, const char *path) {
+    run_optimizations(lib);
+
+    bool ok = !should_verify(lib) || LLVMVerifyModule(lib->module, LLVMReturnStatusAction, NULL) == 0;
+    if (ok) {
+        char tmp_path[4096 + 32];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+        char *error = NULL;
+        trace_begin("codegen", "emit cached object");
+        ok = LLVMTargetMachineEmitToFile(lib->machine, lib->module, tmp_path, LLVMObjectFile, &error) == 0;
+        trace_end();
+        if (error) LLVMDisposeMessage(error);
+        if (ok && rename(tmp_path, path) != 0) {
+            // Another compiler may have published the same entry first.
+            remove(tmp_path);
+            FILE *existing = fopen(path, "rb");
+            ok = existing != NULL;
+            if (existing) fclose(existing);
+        }
+    }
+    codegen_context_destroy(lib);
+    return ok;
+}
+
+/* Compile the non-generic part of `unit` into `path`. */
+static bool emit_prebuilt_object(CodegenContext *ctx, CompilationUnit *unit, const char *path) {
+    const char *name = unit->logical_path ? unit->logical_path : "library";
+    CodegenContext *lib = codegen_context_derive(ctx, name, ctx->opt_level);
+    lib->export_wrappers = true;
+
+    DynArray *units = ctx->loader->units_ordered;
+    DYNARRAY_FOREACH(CompilationUnit*, u_it, units) {
+        CompilationUnit *u = *u_it;
+        lib->emit_definitions = u == unit;
+        codegen_unit_protos(lib, u);
+    }
+    lib->emit_definitions = true;
+    codegen_unit_bodies(lib, unit, true, false);
+    return write_cached_object(lib, path);
+}
+
+static const char *cache_object_path(const char *cache_dir, uint64_t key, Arena *arena) {
+#ifdef _WIN32
+    const char *obj_ext = ".obj";
+#else
+    const char *obj_ext = ".o";
+#endif
+    size_t len = strlen(cache_dir) + 32;
+    char *path = arena_alloc(arena, len);
+    snprintf(path, len, "%s/%016llx%s", cache_dir, (unsigned long long)key, obj_ext);
+    return path;
+}
+
+static bool cache_object_present(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f != NULL;
+}
+
+int codegen_use_prebuilt_libraries(CodegenContext *ctx, const char *cache_dir, Arena *arena, DynArray *objects) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered || !cache_dir) return -1;
+
+#ifdef _WIN32
+    _mkdir(cache_dir);
+#else
+    mkdir(cache_dir, 0777);
+#endif
+
+    DynArray *units = ctx->loader->units_ordered;
+    int built = 0;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->is_library || !unit->ast_root) continue;
+
+        const char *path = cache_object_path(cache_dir, prebuilt_key(ctx, unit), arena);
+        if (!cache_object_present(path) && !emit_prebuilt_object(ctx, unit, path)) continue;
+
+        unit->prebuilt = true;
+        dynarray_push_value(objects, &path);
+        built++;
+    }
+    // The objects call the print runtime the program module defines.
+    if (built > 0) ctx->export_runtime = true;
+    return built;
+}
+
+// -----------------------------------------------------------------------------
+// Cached generic instances
+// -----------------------------------------------------------------------------
+//
+// An instance of a library template is compiled code that depends on the
+// template's unit (and what it imports), on its type arguments and on the
+// target. Argument types are folded in by the units that declare them, and
+// structs by their fields as well, so Vec[Point] is rebuilt when Point
+// changes but Vec[i32] is shared by every program. Sema still instantiates
+// and checks each instance: call sites need its signature and the instances
+// it uses in turn.
+
+/* Fold the sources `t` depends on into `h`. */
+static uint64_t mix_type_sources(CodegenContext *ctx, Type *t, HashMap *seen, HashMap *seen_units, uint64_t h) {
+    if (!t || ptrmap_get(seen, t)) return h;
+    ptrmap_put(seen, t, t);
+
+    h = fnv_mix(h, &t->kind, sizeof(t->kind));
+    switch (t->kind) {
+        case TYPE_PRIMITIVE:
+            h = fnv_mix(h, &t->as.primitive, sizeof(t->as.primitive));
+            break;
+        case TYPE_POINTER:
+            h = mix_type_sources(ctx, t->as.ptr.base, seen, seen_units, h);
+            break;
+        case TYPE_ARRAY:
+            h = fnv_mix(h, &t->as.array.size, sizeof(t->as.array.size));
+            h = mix_type_sources(ctx, t->as.array.base, seen, seen_units, h);
+            break;
+        case TYPE_SLICE:
+            h = mix_type_sources(ctx, t->as.slice.base, seen, seen_units, h);
+            break;
+        case TYPE_VECTOR:
+            h = fnv_mix(h, &t->as.vector.lanes, sizeof(t->as.vector.lanes));
+            h = mix_type_sources(ctx, t->as.vector.base, seen, seen_units, h);
+            break;
+        case TYPE_FUNCTION:
+            h = mix_type_sources(ctx, t->as.func.return_type, seen, seen_units, h);
+            for (size_t i = 0; i < t->as.func.param_count; i++) {
+                h = mix_type_sources(ctx, t->as.func.params[i], seen, seen_units, h);
+            }
+            break;
+        case TYPE_STRUCT: {
+            AstNode *decl = t->as.struct_type.decl_node;
+            CompilationUnit *unit = decl ? module_loader_unit_for_file(ctx->loader, decl->span.file) : NULL;
+            if (unit) h = mix_import_closure(ctx, unit, seen_units, h);
+            for (size_t i = 0; i < t->as.struct_type.field_count; i++) {
+                h = mix_type_sources(ctx, t->as.struct_type.fields[i].type, seen, seen_units, h);
+            }
+            break;
+        }
+        case TYPE_ENUM: {
+            AstNode *decl = t->as.enum_type.decl_node;
+            CompilationUnit *unit = decl ? module_loader_unit_for_file(ctx->loader, decl->span.file) : NULL;
+            if (unit) h = mix_import_closure(ctx, unit, seen_units, h);
+            break;
+        }
+        case TYPE_GENERIC_INST:
+            h = mix_type_sources(ctx, t->as.generic_inst.base, seen, seen_units, h);
+            for (size_t i = 0; i < t->as.generic_inst.arg_count; i++) {
+                h = mix_type_sources(ctx, t->as.generic_inst.args[i], seen, seen_units, h);
             }
+            h = mix_type_sources(ctx, t->as.generic_inst.concrete_type, seen, seen_units, h);
+            break;
+        case TYPE_CONST_ARG:
+            h = fnv_mix(h, &t->as.const_arg.value, sizeof(t->as.const_arg.value));
+            break;
+        default:
+            break;
+    }
+    return h;
+}
+
+static uint64_t instance_key(CodegenContext *ctx, CompilationUnit *unit, AstNode *mono, DynArray *args) {
+    uint64_t h = mix_target(ctx, 0x84222325cbf29ce4ULL);
+    HashMap *seen_units = hashmap_create(NULL, 16);
+    HashMap *seen_types = hashmap_create(NULL, 16);
+    h = mix_import_closure(ctx, unit, seen_units, h);
+
+    // The symbol name: the template and how its arguments are spelled.
+    char *name = mangle_name(ctx, unit, mono->data.function_declaration.intern_result, mono->type);
+    h = fnv_mix_str(h, name);
+    free(name);
+    DYNARRAY_FOREACH(Type*, arg_it, args) {
+        h = mix_type_sources(ctx, *arg_it, seen_types, seen_units, h);
+    }
+
+    hashmap_destroy(seen_types, NULL, NULL);
+    hashmap_destroy(seen_units, NULL, NULL);
+    return h;
+}
+
+/* Compile the single function `func` (an `instance` or a program function) into `path`. */
+static bool emit_body_object(CodegenContext *ctx, AstNode *func, bool instance, const char *path) {
+    CodegenContext *lib = codegen_context_derive(ctx, "instance", ctx->opt_level);
+    lib->export_wrappers = true;
+    lib->emit_definitions = false;
+
+    DynArray *units = ctx->loader->units_ordered;
+    DYNARRAY_FOREACH(CompilationUnit*, u_it, units) {
+        codegen_unit_protos(lib, *u_it);
+    }
+    lib->emit_definitions = true;
+    codegen_decl_body(lib, func);
+    if (instance) codegen_decl_instance_linkage(lib, func, true);
+    return write_cached_object(lib, path);
+}
+
+int codegen_use_cached_instances(CodegenContext *ctx, const char *cache_dir, Arena *arena, DynArray *objects) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered || !cache_dir || !arena) return -1;
+
+    DynArray *units = ctx->loader->units_ordered;
+    int reused = 0;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->prebuilt || !unit->mono_instances || !unit->mono_args) continue;
+
+        DYNARRAY_FOREACH(AstNode*, mono_it, unit->mono_instances) {
+            AstNode *mono = *mono_it;
+            if (mono->node_type != AST_FUNCTION_DECLARATION || !mono->data.function_declaration.body) continue;
+            DynArray *args = ptrmap_get(unit->mono_args, mono);
+            if (!args) continue;
+
+            const char *path = cache_object_path(cache_dir, instance_key(ctx, unit, mono, args), arena);
+            if (!cache_object_present(path) && !emit_body_object(ctx, mono, true, path)) continue;
+
+            if (!ctx->cached_bodies) ctx->cached_bodies = hashmap_create(arena, 16);
+            ptrmap_put(ctx->cached_bodies, mono, mono);
+            dynarray_push_value(objects, &path);
+            reused++;
         }
     }
+    // Cached instances call the program's @link wrappers from outside.
+    if (reused > 0) ctx->export_wrappers = ctx->export_runtime = true;
+    return reused;
+}
+
+// -----------------------------------------------------------------------------
+// Cached function bodies (--incremental)
+// -----------------------------------------------------------------------------
+//
+// Sema keyed every eligible function of the program's own modules on what
+// its body depends on (sema/decl_deps.h) and skipped the ones whose object
+// is already cached. Those are only declared here; the others that were
+// checked without generic instances get their object written now, for the
+// next build.
+
+static void use_cached_body(CodegenContext *ctx, CompilationUnit *unit, AstNode *func, Arena *arena, DynArray *objects, int *count) {
+    const char *path = unit->body_objects ? ptrmap_get(unit->body_objects, func) : NULL;
+    if (!path) return;
+    if (!(func->flags & AST_FLAG_REUSED)) {
+        if (func->flags & AST_FLAG_USES_INSTANCES) return;
+        if (!emit_body_object(ctx, func, false, path)) return;
+    }
+    if (!ctx->cached_bodies) ctx->cached_bodies = hashmap_create(arena, 16);
+    ptrmap_put(ctx->cached_bodies, func, func);
+    // Sema's copy goes with the front end's memory; the link comes later
+    size_t len = strlen(path) + 1;
+    char *copy = arena_alloc(arena, len);
+    memcpy(copy, path, len);
+    dynarray_push_value(objects, &copy);
+    (*count)++;
+}
+
+int codegen_use_cached_bodies(CodegenContext *ctx, Arena *arena, DynArray *objects) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered || !arena) return -1;
+
+    int count = 0;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->body_objects || !unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type == AST_FUNCTION_DECLARATION) {
+                use_cached_body(ctx, unit, decl, arena, objects, &count);
+            } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+                DYNARRAY_FOREACH(AstNode*, method_it, decl->data.impl_declaration.methods) {
+                    use_cached_body(ctx, unit, *method_it, arena, objects, &count);
+                }
+            }
+        }
+    }
+    if (count > 0) ctx->export_wrappers = ctx->export_runtime = true;
+    return count;
+}
+
+int codegen_program(CodegenContext *ctx) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return -1;
+
+    DynArray *units = ctx->loader->units_ordered;
+    int jobs = ctx->loader->opts ? ctx->loader->opts->jobs : 1;
+    size_t parts = jobs > 1 ? (size_t)jobs : 1;
+    if (parts > units->count) parts = units->count;
+
+    if (parts > 1) {
+        codegen_program_partitioned(ctx, parts);
+    } else {
+        // Pass 1: Protos (All units)
+        for (size_t i = 0; i < units->count; i++) {
+            codegen_unit_protos(ctx, DYNARRAY_AT(CompilationUnit*, units, i));
+        }
+
+        // Pass 2: Bodies (All units)
+        DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+            CompilationUnit *unit = *unit_it;
+            codegen_unit_bodies(ctx, unit, !unit->prebuilt, true);
+        }
+    }
+
+    // Instances become linkonce_odr only now: the linker would drop one
+    // that a partition defines before the partition calling it is linked
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->mono_instances) continue;
+        DYNARRAY_FOREACH(AstNode*, mono_it, unit->mono_instances) codegen_decl_instance_linkage(ctx, *mono_it, false);
+    }
+
+    // The print runtime goes in before the passes so that it can inline
+    codegen_define_runtime(ctx);
+
+    // So does the --instrument runtime, and the table of its records
+    codegen_instrument_program(ctx);
+
+    // PGO instrumentation or profile weights go in before the pipeline
+    codegen_profile_program(ctx);
 
     // Run optimizations
     run_optimizations(ctx);
 
+    // --icf: instances of different types often lower to the same code
+    if (ctx->fold_instances) fold_identical_functions(ctx);
+
     char *v_error = NULL;
-    if (LLVMVerifyModule(ctx->module, LLVMPrintMessageAction, &v_error) == 1) {
+    if (should_verify(ctx) && LLVMVerifyModule(ctx->module, LLVMPrintMessageAction, &v_error) == 1) {
         fprintf(stderr, "Error: LLVM Code generation pass failed\n");
         LLVMDisposeMessage(v_error);
         exit(5);
@@ -114,14 +795,540 @@ void codegen_dump_module(CodegenContext *ctx) {
     if (ctx->module) LLVMDumpModule(ctx->module);
 }
 
+char *codegen_module_ir(CodegenContext *ctx) {
+    if (!ctx->module) return NULL;
+    char *ir = LLVMPrintModuleToString(ctx->module);
+    char *copy = xstrdup(ir);
+    LLVMDisposeMessage(ir);
+    return copy;
+}
+
 void codegen_emit_object(CodegenContext *ctx, const char *filename) {
     if (!ctx->module) return;
     char *error = NULL;
+    trace_begin("codegen", "emit object");
     if (LLVMTargetMachineEmitToFile(ctx->machine, ctx->module, (char *)filename,
                                     LLVMObjectFile, &error)) {
         fprintf(stderr, "Error emitting object file: %s\n", error);
         LLVMDisposeMessage(error);
     }
+    trace_end();
+}
+
+unsigned char *codegen_emit_object_buffer(CodegenContext *ctx, size_t *out_size) {
+    if (!ctx->module) return NULL;
+    char *error = NULL;
+    LLVMMemoryBufferRef mem = NULL;
+    trace_begin("codegen", "emit object");
+    LLVMBool failed = LLVMTargetMachineEmitToMemoryBuffer(ctx->machine, ctx->module, LLVMObjectFile, &error, &mem);
+    trace_end();
+    if (failed) {
+        fprintf(stderr, "Error emitting object file: %s\n", error);
+        LLVMDisposeMessage(error);
+        return NULL;
+    }
+    size_t size = LLVMGetBufferSize(mem);
+    unsigned char *buf = malloc(size ? size : 1);
+    if (buf) memcpy(buf, LLVMGetBufferStart(mem), size);
+    LLVMDisposeMemoryBuffer(mem);
+    *out_size = size;
+    return buf;
+}
+
+// -----------------------------------------------------------------------------
+// Codegen units (--codegen-units)
+// -----------------------------------------------------------------------------
+//
+// Instruction selection runs on one module at a time, so after the whole
+// program is optimized its bitcode is read back once per unit, each on its
+// own thread, context and target machine. A unit keeps the bodies of its
+// share of the functions and demotes the others to declarations
+// (available_externally, then elim-avail-extern); unit 0 also keeps every
+// global variable. Local symbols become hidden externals so that the
+// objects can reference each other; nameless ones are named first, in
+// module order, which is the same in every copy.
+
+typedef struct {
+    const CodegenContext *ctx;
+    LLVMMemoryBufferRef bitcode;
+    const uint32_t *owner;      // Unit of each function definition, in module order
+    uint32_t index;
+    CodegenObject *out;
+    pthread_t thread;
+} CodegenUnitJob;
+
+static size_t function_weight(LLVMValueRef fn) {
+    size_t w = 1;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst; inst = LLVMGetNextInstruction(inst)) w++;
+    }
+    return w;
+}
+
+static void unit_export_local(LLVMValueRef v, size_t *anon) {
+    LLVMLinkage linkage = LLVMGetLinkage(v);
+    if (linkage != LLVMInternalLinkage && linkage != LLVMPrivateLinkage) return;
+    size_t len = 0;
+    LLVMGetValueName2(v, &len);
+    if (len == 0) {
+        char name[32];
+        snprintf(name, sizeof(name), "newt.cgu.%zu", (*anon)++);
+        LLVMSetValueName2(v, name, strlen(name));
+    }
+    LLVMSetLinkage(v, LLVMExternalLinkage);
+    LLVMSetVisibility(v, LLVMHiddenVisibility);
+}
+
+static void unit_declare_only(LLVMValueRef v) {
+    LLVMSetComdat(v, NULL);
+    LLVMSetLinkage(v, LLVMAvailableExternallyLinkage);
+}
+
+static void codegen_unit_emit(CodegenUnitJob *job) {
+    char name[32];
+    snprintf(name, sizeof(name), "cgu_%u", job->index);
+    trace_begin("codegen", name);
+
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef mod = NULL;
+    LLVMMemoryBufferRef view = LLVMCreateMemoryBufferWithMemoryRange(
+        LLVMGetBufferStart(job->bitcode), LLVMGetBufferSize(job->bitcode), name, false);
+    if (LLVMParseBitcodeInContext2(context, view, &mod) != 0) ICE("Failed to read back IR of codegen unit %u", job->index);
+    LLVMDisposeMemoryBuffer(view);
+
+    size_t anon = 0;
+    for (LLVMValueRef g = LLVMGetFirstGlobal(mod); g; g = LLVMGetNextGlobal(g)) unit_export_local(g, &anon);
+    for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn)) unit_export_local(fn, &anon);
+
+    size_t def = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        if (job->owner[def++] != job->index) unit_declare_only(fn);
+        // An instance only the other units call must survive globaldce
+        else if (LLVMGetLinkage(fn) == LLVMLinkOnceODRLinkage) LLVMSetLinkage(fn, LLVMWeakODRLinkage);
+    }
+    if (job->index != 0) {
+        LLVMValueRef g = LLVMGetFirstGlobal(mod);
+        while (g) {
+            LLVMValueRef next = LLVMGetNextGlobal(g);
+            size_t len = 0;
+            const char *gname = LLVMGetValueName2(g, &len);
+            if (LLVMGetLinkage(g) == LLVMAppendingLinkage || (len > 5 && strncmp(gname, "llvm.", 5) == 0)) {
+                LLVMDeleteGlobal(g); // llvm.used, ctors and the like: unit 0 emits them
+            } else if (!LLVMIsDeclaration(g)) {
+                unit_declare_only(g);
+            }
+            g = next;
+        }
+    }
+
+    char *error = NULL;
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(
+        job->ctx->target, LLVMGetTarget(mod), job->ctx->target_cpu, job->ctx->target_features,
+        job->ctx->codegen_level, LLVMRelocPIC, LLVMCodeModelDefault);
+    if (!machine) ICE("Failed to create the target machine of codegen unit %u", job->index);
+
+    LLVMPassBuilderOptionsRef pass_opts = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef err = LLVMRunPasses(mod, "elim-avail-extern,globaldce", machine, pass_opts);
+    LLVMDisposePassBuilderOptions(pass_opts);
+    if (err) {
+        char *msg = LLVMGetErrorMessage(err);
+        ICE("Failed to split codegen unit %u: %s", job->index, msg);
+    }
+
+    LLVMMemoryBufferRef mem = NULL;
+    if (LLVMTargetMachineEmitToMemoryBuffer(machine, mod, LLVMObjectFile, &error, &mem)) {
+        fprintf(stderr, "Error emitting object file: %s\n", error);
+        LLVMDisposeMessage(error);
+    } else {
+        job->out->size = LLVMGetBufferSize(mem);
+        job->out->data = malloc(job->out->size ? job->out->size : 1);
+        if (job->out->data) memcpy(job->out->data, LLVMGetBufferStart(mem), job->out->size);
+        LLVMDisposeMemoryBuffer(mem);
+    }
+
+    LLVMDisposeTargetMachine(machine);
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(context);
+    trace_end();
+}
+
+static void *codegen_unit_thread(void *arg) {
+    codegen_unit_emit(arg);
+    return NULL;
+}
+
+static int compare_weight_desc(const void *a, const void *b) {
+    const size_t *x = a, *y = b; // {weight, index} pairs
+    if (x[0] != y[0]) return x[0] < y[0] ? 1 : -1;
+    return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
+size_t codegen_emit_object_units(CodegenContext *ctx, size_t units, CodegenObject *objects) {
+    if (!ctx->module || units < 2) return 0;
+    if (LLVMGetFirstGlobalAlias(ctx->module) || LLVMGetFirstGlobalIFunc(ctx->module)) return 0;
+
+    size_t defs = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) defs++;
+    }
+    if (units > defs) units = defs;
+    if (units < 2) return 0;
+
+    // Largest first onto the lightest unit, ties by module order
+    size_t (*order)[2] = xcalloc(defs, sizeof(*order));
+    size_t def = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) { order[def][0] = function_weight(fn); order[def][1] = def; def++; }
+    }
+    qsort(order, defs, sizeof(*order), compare_weight_desc);
+    uint32_t *owner = xcalloc(defs, sizeof(uint32_t));
+    size_t *load = xcalloc(units, sizeof(size_t));
+    for (size_t i = 0; i < defs; i++) {
+        size_t lightest = 0;
+        for (size_t u = 1; u < units; u++) if (load[u] < load[lightest]) lightest = u;
+        owner[order[i][1]] = (uint32_t)lightest;
+        load[lightest] += order[i][0];
+    }
+    free(load);
+    free(order);
+
+    trace_begin("codegen", "split units");
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(ctx->module);
+    trace_end();
+
+    CodegenUnitJob *jobs = xcalloc(units, sizeof(CodegenUnitJob));
+    for (size_t u = 0; u < units; u++) {
+        objects[u] = (CodegenObject){0};
+        jobs[u] = (CodegenUnitJob){ ctx, bitcode, owner, (uint32_t)u, &objects[u], 0 };
+    }
+    size_t started = 0;
+    for (size_t u = 1; u < units; u++) {
+        if (pthread_create(&jobs[u].thread, NULL, codegen_unit_thread, &jobs[u]) != 0) break;
+        started = u;
+    }
+    codegen_unit_emit(&jobs[0]);
+    for (size_t u = 1; u <= started; u++) pthread_join(jobs[u].thread, NULL);
+    for (size_t u = started + 1; u < units; u++) codegen_unit_emit(&jobs[u]);
+
+    free(jobs);
+    free(owner);
+    LLVMDisposeMemoryBuffer(bitcode);
+
+    for (size_t u = 0; u < units; u++) {
+        if (objects[u].data) continue;
+        for (size_t v = 0; v < units; v++) free(objects[v].data);
+        return SIZE_MAX;
+    }
+    return units;
+}
+
+// -----------------------------------------------------------------------------
+// Lazy ORC JIT (--run)
+// -----------------------------------------------------------------------------
+//
+// Every unit is lowered into its own module, in the same way as a -j N
+// partition. Its externally visible functions are renamed to "<name>$lazy"
+// and the plain names are defined as lazy re-exports: call-through stubs
+// that compile the owning module the first time one of them is called.
+// Calls across units go through the stubs, so a unit whose functions are
+// never reached is neither optimized nor handed to the backend.
+
+typedef struct {
+    LLVMTargetMachineRef machine;
+    char passes[512];
+} LazyJitTier;
+
+static LLVMErrorRef lazy_jit_optimize_module(void *arg, LLVMModuleRef mod) {
+    LazyJitTier *tier = arg;
+    trace_begin("jit", LLVMGetModuleIdentifier(mod, &(size_t){0}));
+    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef err = LLVMRunPasses(mod, tier->passes, tier->machine, opts);
+    LLVMDisposePassBuilderOptions(opts);
+    trace_end();
+    return err;
+}
+
+/* IR transform layer hook: optimize a unit only once it is materialized. */
+static LLVMErrorRef lazy_jit_transform(void *arg, LLVMOrcThreadSafeModuleRef *mod,
+                                       LLVMOrcMaterializationResponsibilityRef mr) {
+    (void)mr;
+    return LLVMOrcThreadSafeModuleWithModuleDo(*mod, lazy_jit_optimize_module, arg);
+}
+
+static void lazy_jit_compile_failed(void) {
+    fprintf(stderr, "Error: JIT compilation of a called function failed\n");
+    abort();
+}
+
+static bool lazy_jit_check(LLVMErrorRef err, const char *what) {
+    if (!err) return true;
+    char *msg = LLVMGetErrorMessage(err);
+    fprintf(stderr, "Error: %s: %s\n", what, msg);
+    LLVMDisposeErrorMessage(msg);
+    return false;
+}
+
+static LLVMCodeGenOptLevel codegen_level_for(int opt_level) {
+    switch (opt_level) {
+        case 0:  return LLVMCodeGenLevelNone;
+        case 1:  return LLVMCodeGenLevelLess;
+        case 2:  return LLVMCodeGenLevelDefault;
+        default: return LLVMCodeGenLevelAggressive;
+    }
+}
+
+/*
+ * Hand one unit's module to the JIT behind lazy stubs. `exported` holds the
+ * names that already have a stub, in case an instance is defined twice.
+ */
+static bool lazy_jit_add_module(LLVMOrcLLJITRef jit, LLVMOrcJITDylibRef jd,
+                                LLVMOrcLazyCallThroughManagerRef lctm, LLVMOrcIndirectStubsManagerRef ism,
+                                LLVMMemoryBufferRef bitcode, HashMap *exported) {
+    LLVMOrcThreadSafeContextRef tsc = LLVMOrcCreateNewThreadSafeContext();
+    LLVMModuleRef mod = NULL;
+    if (LLVMParseBitcodeInContext2(LLVMOrcThreadSafeContextGetContext(tsc), bitcode, &mod) != 0) {
+        LLVMOrcDisposeThreadSafeContext(tsc);
+        return false;
+    }
+
+    size_t count = 0, cap = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn)) cap++;
+    LLVMOrcCSymbolAliasMapPair *aliases = xcalloc(cap ? cap : 1, sizeof(LLVMOrcCSymbolAliasMapPair));
+    for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        LLVMLinkage linkage = LLVMGetLinkage(fn);
+        if (linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage) continue;
+
+        size_t len = 0;
+        const char *name = LLVMGetValueName2(fn, &len);
+        char *body_name = xmalloc(len + sizeof("$lazy"));
+        memcpy(body_name, name, len);
+        memcpy(body_name + len, "$lazy", sizeof("$lazy"));
+        char *stub_name = xstrdup(body_name);
+        stub_name[len] = '\0';
+        LLVMSetValueName2(fn, body_name, len + sizeof("$lazy") - 1);
+
+        if (hashmap_get(exported, stub_name, str_hash, str_cmp)) {
+            free(stub_name);
+        } else {
+            hashmap_put(exported, stub_name, stub_name, str_hash, str_cmp);
+            aliases[count].Name = LLVMOrcLLJITMangleAndIntern(jit, stub_name);
+            aliases[count].Entry.Name = LLVMOrcLLJITMangleAndIntern(jit, body_name);
+            aliases[count].Entry.Flags.GenericFlags = LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable;
+            aliases[count].Entry.Flags.TargetFlags = 0;
+            count++;
+        }
+        free(body_name);
+    }
+
+    bool ok = lazy_jit_check(LLVMOrcLLJITAddLLVMIRModule(jit, jd, LLVMOrcCreateNewThreadSafeModule(mod, tsc)),
+                             "Failed to add module to JIT");
+    LLVMOrcDisposeThreadSafeContext(tsc);
+    if (ok && count > 0) {
+        LLVMOrcMaterializationUnitRef mu = LLVMOrcLazyReexports(lctm, ism, jd, aliases, count);
+        ok = lazy_jit_check(LLVMOrcJITDylibDefine(jd, mu), "Failed to define lazy JIT stubs");
+    }
+    free(aliases);
+    return ok;
+}
+
+/*
+ * --perf-map: /tmp/perf-<pid>.map, the file perf reads to name samples in
+ * code it cannot find on disk. The object layer notes the function symbols
+ * of every object the JIT links; their addresses are only final once linked,
+ * so the map is written after main returns. Each line is
+ * "<start> <size> <name>" in hex, with the display name of the function
+ * (codegen_display_name) where the symbol is a Newt function's.
+ */
+typedef struct {
+    char *name;
+    uint64_t size;
+} PerfMapSymbol;
+
+typedef struct {
+    pthread_mutex_t lock;
+    DynArray symbols; // DynArray<PerfMapSymbol>
+} PerfMap;
+
+static LLVMErrorRef perf_map_transform(void *arg, LLVMMemoryBufferRef *obj) {
+    PerfMap *map = arg;
+    char *msg = NULL;
+    LLVMBinaryRef bin = LLVMCreateBinary(*obj, NULL, &msg);
+    if (!bin) {
+        LLVMDisposeMessage(msg);
+        return NULL;
+    }
+    LLVMSectionIteratorRef sect = LLVMObjectFileCopySectionIterator(bin);
+    LLVMSymbolIteratorRef sym = LLVMObjectFileCopySymbolIterator(bin);
+    pthread_mutex_lock(&map->lock);
+    for (; !LLVMObjectFileIsSymbolIteratorAtEnd(bin, sym); LLVMMoveToNextSymbol(sym)) {
+        const char *name = LLVMGetSymbolName(sym);
+        uint64_t size = LLVMGetSymbolSize(sym);
+        if (!name || !*name || size == 0) continue;
+        LLVMMoveToContainingSection(sect, sym);
+        if (LLVMObjectFileIsSectionIteratorAtEnd(bin, sect)) continue;
+        const char *section = LLVMGetSectionName(sect);
+        if (!section || !strstr(section, "text")) continue;
+        PerfMapSymbol entry = { xstrdup(name), size };
+        dynarray_push_value(&map->symbols, &entry);
+    }
+    pthread_mutex_unlock(&map->lock);
+    LLVMDisposeSymbolIterator(sym);
+    LLVMDisposeSectionIterator(sect);
+    LLVMDisposeBinary(bin);
+    return NULL;
+}
+
+static void perf_map_name_decl(CodegenContext *ctx, HashMap *names, AstNode *decl) {
+    if (decl->node_type == AST_FUNCTION_DECLARATION) {
+        const char *symbol = codegen_decl_name(ctx, decl);
+        if (symbol && !hashmap_get(names, (void *)symbol, str_hash, str_cmp)) {
+            hashmap_put(names, xstrdup(symbol), codegen_display_name(ctx, decl), str_hash, str_cmp);
+        }
+    } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+        DYNARRAY_FOREACH(AstNode*, method_it, decl->data.impl_declaration.methods) perf_map_name_decl(ctx, names, *method_it);
+    }
+}
+
+static void perf_map_write(CodegenContext *ctx, LLVMOrcLLJITRef jit, PerfMap *map) {
+    HashMap *names = hashmap_create(NULL, 256);
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (unit->ast_root && unit->ast_root->data.program.decls) {
+            DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+                if (!is_generic_template(*decl_it)) perf_map_name_decl(ctx, names, *decl_it);
+            }
+        }
+        if (unit->mono_instances) {
+            DYNARRAY_FOREACH(AstNode*, mono_it, unit->mono_instances) perf_map_name_decl(ctx, names, *mono_it);
+        }
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    FILE *out = fopen(path, "w");
+    if (!out) fprintf(stderr, "Warning: --perf-map: cannot write '%s'\n", path);
+    char prefix = LLVMOrcLLJITGetGlobalPrefix(jit);
+    for (size_t i = 0; out && i < map->symbols.count; i++) {
+        PerfMapSymbol *entry = dynarray_get(&map->symbols, i);
+        char *name = entry->name;
+        if (prefix && name[0] == prefix) name++;
+
+        // Local symbols are not in the JIT's symbol table: they have no address to give
+        LLVMOrcJITTargetAddress addr = 0;
+        LLVMErrorRef err = LLVMOrcLLJITLookup(jit, &addr, name);
+        if (err) {
+            LLVMConsumeError(err);
+            continue;
+        }
+        size_t len = strlen(name);
+        if (len > 5 && strcmp(name + len - 5, "$lazy") == 0) name[len - 5] = '\0';
+        const char *display = hashmap_get(names, name, str_hash, str_cmp);
+        fprintf(out, "%llx %llx %s\n", (unsigned long long)addr, (unsigned long long)entry->size, display ? display : name);
+    }
+    if (out) fclose(out);
+    hashmap_destroy(names, free, free);
+}
+
+int codegen_run_lazy_jit(CodegenContext *ctx, int opt_level) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return -1;
+
+    DynArray *units = ctx->loader->units_ordered;
+    size_t parts = units->count;
+    if (parts == 0) return -1;
+
+    CodegenPartition *partitions = xcalloc(parts, sizeof(CodegenPartition));
+    char name[32];
+    for (size_t p = 0; p < parts; p++) {
+        snprintf(name, sizeof(name), "jit_%zu", p);
+        partitions[p].ctx = codegen_context_derive(ctx, name, opt_level);
+        partitions[p].ctx->export_wrappers = true;
+        partitions[p].first = p;
+        partitions[p].last = p + 1;
+    }
+    int jobs = ctx->loader->opts ? ctx->loader->opts->jobs : 1;
+    codegen_lower_partitions(partitions, parts, jobs > 1 ? (size_t)jobs : 1);
+
+    // JIT tier target machine: host CPU, backend effort from `opt_level`
+    char *triple = LLVMGetTargetMachineTriple(ctx->machine);
+    char *cpu = LLVMGetTargetMachineCPU(ctx->machine);
+    char *features = LLVMGetTargetMachineFeatureString(ctx->machine);
+    LLVMTargetMachineRef tm = LLVMCreateTargetMachine(ctx->target, triple, cpu, features,
+                                                      codegen_level_for(opt_level), LLVMRelocDefault, LLVMCodeModelJITDefault);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(builder, LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(tm));
+
+    int result = -1;
+    LLVMOrcLLJITRef jit = NULL;
+    LLVMOrcLazyCallThroughManagerRef lctm = NULL;
+    LLVMOrcIndirectStubsManagerRef ism = NULL;
+    HashMap *exported = hashmap_create(NULL, 256);
+    bool ok = lazy_jit_check(LLVMOrcCreateLLJIT(&jit, builder), "Failed to create JIT");
+
+    LLVMOrcJITDylibRef jd = NULL;
+    if (ok) {
+        jd = LLVMOrcLLJITGetMainJITDylib(jit);
+        LLVMOrcDefinitionGeneratorRef process = NULL;
+        ok = lazy_jit_check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&process, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL),
+                            "Failed to expose process symbols to the JIT");
+        if (ok) LLVMOrcJITDylibAddGenerator(jd, process);
+    }
+    if (ok) {
+        ok = lazy_jit_check(LLVMOrcCreateLocalLazyCallThroughManager(triple, LLVMOrcLLJITGetExecutionSession(jit),
+                                                                     (LLVMOrcJITTargetAddress)(uintptr_t)lazy_jit_compile_failed, &lctm),
+                            "Failed to create lazy call-through manager");
+    }
+    if (ok) ism = LLVMOrcCreateLocalIndirectStubsManager(triple);
+
+    Options *opts = ctx->loader->opts;
+    PerfMap perf_map = { .symbols = { 0 } };
+    bool write_perf_map = ok && opts && opts->perf_map;
+    if (write_perf_map) {
+        pthread_mutex_init(&perf_map.lock, NULL);
+        dynarray_init(&perf_map.symbols, sizeof(PerfMapSymbol));
+        LLVMOrcObjectTransformLayerSetTransform(LLVMOrcLLJITGetObjTransformLayer(jit), perf_map_transform, &perf_map);
+    }
+
+    LazyJitTier tier = { ctx->machine, "" };
+    default_pipeline(tier.passes, sizeof(tier.passes), opt_level);
+    if (ok && opt_level > 0) {
+        LLVMOrcIRTransformLayerSetTransform(LLVMOrcLLJITGetIRTransformLayer(jit), lazy_jit_transform, &tier);
+    }
+
+    for (size_t p = 0; p < parts; p++) {
+        if (ok && !lazy_jit_add_module(jit, jd, lctm, ism, partitions[p].bitcode, exported)) ok = false;
+        LLVMDisposeMemoryBuffer(partitions[p].bitcode);
+        codegen_context_destroy(partitions[p].ctx);
+    }
+    trace_end();
+    free(partitions);
+    LLVMDisposeMessage(triple);
+
+    if (ok) {
+        LLVMOrcJITTargetAddress addr = 0;
+        if (lazy_jit_check(LLVMOrcLLJITLookup(jit, &addr, "main"), "Failed to resolve main") && addr) {
+            int (*main_ptr)(void) = (int (*)(void))(uintptr_t)addr;
+            result = main_ptr();
+        }
+        if (opts && opts->instrument) newt_instrument_report();
+        if (write_perf_map) perf_map_write(ctx, jit, &perf_map);
+    }
+
+    // Stubs and call-through manager go first: they point into the session.
+    if (ism) LLVMOrcDisposeIndirectStubsManager(ism);
+    if (lctm) LLVMOrcDisposeLazyCallThroughManager(lctm);
+    if (jit) LLVMOrcDisposeLLJIT(jit);
+    hashmap_destroy(exported, free, NULL);
+    if (write_perf_map) {
+        for (size_t i = 0; i < perf_map.symbols.count; i++) free(((PerfMapSymbol *)dynarray_get(&perf_map.symbols, i))->name);
+        dynarray_free(&perf_map.symbols);
+        pthread_mutex_destroy(&perf_map.lock);
+    }
+    return result;
 }
 
 int codegen_run_jit(CodegenContext *ctx) {
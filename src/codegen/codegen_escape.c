@@ -0,0 +1,306 @@
+/**
+ * @file codegen_escape.c
+ * @brief Escape analysis for @alloc: stack promotion of local allocations.
+ *
+ * An allocation is promoted when it initializes a local `p: *T = @alloc(T, a, N)`
+ * with a constant count, its size fits STACK_ALLOC_MAX_BYTES, and `p` is
+ * only ever dereferenced, indexed, compared or handed to @free. Anything
+ * else (assigning `p`, passing it, returning it, casting it, taking the
+ * address of what it points to, calling a method on it) may let the pointer
+ * outlive the frame and keeps the allocator call.
+ */
+
+#include "codegen_internal.h"
+#include "core/source_map.h"
+
+#define STACK_ALLOC_MAX_BYTES      1024 // Per allocation
+#define STACK_ALLOC_FUNCTION_BYTES 8192 // Per function
+
+typedef struct {
+    AstNode *decl;   // The local the allocation initializes
+    AstNode *alloc;  // Its @alloc
+    DynArray frees;  // DynArray<AstNode*>: @free calls on it
+    uint64_t bytes;
+    bool escapes;
+} StackCandidate;
+
+typedef struct {
+    CodegenContext *ctx;
+    DynArray candidates; // DynArray<StackCandidate>
+    HashMap *by_decl;    // var decl -> index + 1 into candidates
+    int address_depth;   // > 0 while inside `&...` or a method receiver
+} EscapeScan;
+
+/* Expressions that can be dropped without losing a side effect. */
+static bool operand_is_pure(AstNode *node) {
+    if (!node) return true;
+    switch (node->node_type) {
+        case AST_IDENTIFIER:
+        case AST_LITERAL:
+            return true;
+        case AST_MEMBER_EXPR:
+            return !node->data.member_expr.is_instance_method && operand_is_pure(node->data.member_expr.target);
+        case AST_UNARY_EXPR:
+            return (node->data.unary_expr.op == OP_DEREF || node->data.unary_expr.op == OP_ADDRESS) &&
+                   operand_is_pure(node->data.unary_expr.expr);
+        case AST_SUBSCRIPT_EXPR:
+            return operand_is_pure(node->data.subscript_expr.target) && operand_is_pure(node->data.subscript_expr.index);
+        default:
+            return false;
+    }
+}
+
+static StackCandidate *candidate_of(EscapeScan *s, AstNode *ident) {
+    if (!ident || ident->node_type != AST_IDENTIFIER) return NULL;
+    Symbol *sym = ident->data.identifier.symbol;
+    if (!sym || sym->kind != SYMBOL_VARIABLE || !sym->decl_node) return NULL;
+    size_t idx = (size_t)(uintptr_t)ptrmap_get(s->by_decl, sym->decl_node);
+    return idx ? &DYNARRAY_AT(StackCandidate, &s->candidates, idx - 1) : NULL;
+}
+
+/* `decl` is `p: *T = @alloc(T, a[, N])` with a small constant size. */
+static void consider_candidate(EscapeScan *s, AstNode *decl) {
+    AstNode *init = decl->data.variable_declaration.initializer;
+    if (!init || init->node_type != AST_INTRINSIC || init->data.intrinsic.kind != INTRINSIC_ALLOC || !init->type) return;
+    DynArray *args = init->data.intrinsic.args;
+    if (!args || args->count < 2 || !operand_is_pure(DYNARRAY_AT(AstNode*, args, 1))) return;
+
+    uint64_t count = 1;
+    if (args->count == 3) {
+        AstNode *count_arg = DYNARRAY_AT(AstNode*, args, 2);
+        if (count_arg->node_type != AST_LITERAL || count_arg->data.literal.type != INT_LITERAL) return;
+        if (count_arg->data.literal.value.int_val <= 0) return;
+        count = (uint64_t)count_arg->data.literal.value.int_val;
+    }
+
+    Type *elem = init->type->kind == TYPE_SLICE ? init->type->as.slice.base : init->type->as.ptr.base;
+    uint64_t elem_bytes = LLVMABISizeOfType(s->ctx->target_data, get_llvm_type(s->ctx, elem));
+    if (elem_bytes == 0 || count > STACK_ALLOC_MAX_BYTES / elem_bytes) return;
+
+    StackCandidate cand = { .decl = decl, .alloc = init, .bytes = count * elem_bytes };
+    dynarray_init(&cand.frees, sizeof(AstNode*));
+    dynarray_push_value(&s->candidates, &cand);
+    ptrmap_put(s->by_decl, decl, (void*)(uintptr_t)s->candidates.count);
+}
+
+static void find_candidates(EscapeScan *s, AstNode *node) {
+    if (!node) return;
+    switch (node->node_type) {
+        case AST_BLOCK:
+            DYNARRAY_FOREACH(AstNode*, stmt_it, node->data.block.statements) find_candidates(s, *stmt_it);
+            break;
+        case AST_IF_STATEMENT:
+            find_candidates(s, node->data.if_statement.then_branch);
+            find_candidates(s, node->data.if_statement.else_branch);
+            break;
+        case AST_WHILE_STATEMENT:
+            find_candidates(s, node->data.while_statement.body);
+            break;
+        case AST_SWITCH_STATEMENT:
+            DYNARRAY_FOREACH(AstNode*, arm_it, node->data.switch_statement.cases) find_candidates(s, (*arm_it)->data.switch_case.body);
+            find_candidates(s, node->data.switch_statement.else_body);
+            break;
+        case AST_FOR_STATEMENT:
+            find_candidates(s, node->data.for_statement.init);
+            find_candidates(s, node->data.for_statement.body);
+            break;
+        case AST_VARIABLE_DECLARATION:
+            consider_candidate(s, node);
+            break;
+        default:
+            break;
+    }
+}
+
+static void scan(EscapeScan *s, AstNode *node, bool as_base);
+
+static void scan_list(EscapeScan *s, DynArray *nodes) {
+    if (!nodes) return;
+    DYNARRAY_FOREACH(AstNode*, node_it, nodes) scan(s, *node_it, false);
+}
+
+/* A pointee access through `target`: fine for the pointer itself unless its address is taken. */
+static void scan_base(EscapeScan *s, AstNode *target) {
+    scan(s, target, s->address_depth == 0);
+}
+
+/*
+ * Mark every candidate whose pointer can leave the frame through `node`.
+ * `as_base` is set where a bare candidate only has its pointee accessed.
+ */
+static void scan(EscapeScan *s, AstNode *node, bool as_base) {
+    if (!node) return;
+    switch (node->node_type) {
+        case AST_IDENTIFIER: {
+            StackCandidate *cand = candidate_of(s, node);
+            if (cand && !as_base) cand->escapes = true;
+            break;
+        }
+
+        case AST_VARIABLE_DECLARATION:
+            if (!ptrmap_get(s->by_decl, node)) scan(s, node->data.variable_declaration.initializer, false);
+            break;
+
+        case AST_BLOCK:
+            scan_list(s, node->data.block.statements);
+            break;
+        case AST_IF_STATEMENT:
+            scan(s, node->data.if_statement.condition, false);
+            scan(s, node->data.if_statement.then_branch, false);
+            scan(s, node->data.if_statement.else_branch, false);
+            break;
+        case AST_WHILE_STATEMENT:
+            scan(s, node->data.while_statement.condition, false);
+            scan(s, node->data.while_statement.body, false);
+            break;
+        case AST_SWITCH_STATEMENT:
+            scan(s, node->data.switch_statement.subject, false);
+            DYNARRAY_FOREACH(AstNode*, arm_it, node->data.switch_statement.cases) scan(s, (*arm_it)->data.switch_case.body, false);
+            scan(s, node->data.switch_statement.else_body, false);
+            break;
+        case AST_FOR_STATEMENT:
+            scan(s, node->data.for_statement.init, false);
+            scan(s, node->data.for_statement.condition, false);
+            scan(s, node->data.for_statement.post, false);
+            scan(s, node->data.for_statement.range, false);
+            scan(s, node->data.for_statement.body, false);
+            break;
+        case AST_RETURN_STATEMENT:
+            scan(s, node->data.return_statement.expression, false);
+            break;
+        case AST_DEFER_STATEMENT:
+            scan(s, node->data.defer_statement.body, false);
+            break;
+        case AST_EXPR_STATEMENT:
+            scan(s, node->data.expr_statement.expression, false);
+            break;
+
+        case AST_SUBSCRIPT_EXPR:
+            scan_base(s, node->data.subscript_expr.target);
+            scan(s, node->data.subscript_expr.index, false);
+            break;
+
+        case AST_MEMBER_EXPR:
+            if (node->data.member_expr.is_instance_method) scan(s, node->data.member_expr.target, false);
+            else scan_base(s, node->data.member_expr.target);
+            break;
+
+        case AST_UNARY_EXPR:
+            if (node->data.unary_expr.op == OP_DEREF) {
+                scan_base(s, node->data.unary_expr.expr);
+            } else if (node->data.unary_expr.op == OP_ADDRESS) {
+                s->address_depth++;
+                scan(s, node->data.unary_expr.expr, false);
+                s->address_depth--;
+            } else {
+                scan(s, node->data.unary_expr.expr, false);
+            }
+            break;
+
+        case AST_BINARY_EXPR: {
+            // Comparing the pointer does not leak it
+            OpKind op = node->data.binary_expr.op;
+            bool compare = op == OP_EQ || op == OP_NEQ;
+            scan(s, node->data.binary_expr.left, compare);
+            scan(s, node->data.binary_expr.right, compare);
+            break;
+        }
+
+        case AST_POSTFIX_EXPR:
+            scan(s, node->data.postfix_expr.expr, false);
+            break;
+
+        case AST_ASSIGNMENT_EXPR:
+            // Rebinding the variable would free (or leak) another pointer
+            scan(s, node->data.assignment_expr.lvalue, false);
+            scan(s, node->data.assignment_expr.rvalue, false);
+            break;
+
+        case AST_CALL_EXPR: {
+            // A method call passes its receiver's address
+            AstNode *callee = node->data.call_expr.callee;
+            if (callee->node_type == AST_MEMBER_EXPR) {
+                s->address_depth++;
+                scan(s, callee->data.member_expr.target, false);
+                s->address_depth--;
+            } else {
+                scan(s, callee, false);
+            }
+            scan_list(s, node->data.call_expr.args);
+            break;
+        }
+
+        case AST_INTRINSIC: {
+            DynArray *args = node->data.intrinsic.args;
+            if (node->data.intrinsic.kind == INTRINSIC_FREE && args && args->count == 2) {
+                AstNode *ptr_arg = DYNARRAY_AT(AstNode*, args, 1);
+                StackCandidate *cand = candidate_of(s, ptr_arg);
+                scan(s, DYNARRAY_AT(AstNode*, args, 0), false);
+                if (cand) dynarray_push_value(&cand->frees, &node);
+                else scan(s, ptr_arg, false);
+            } else {
+                scan_list(s, args);
+            }
+            break;
+        }
+
+        case AST_GENERIC_INST_EXPR:
+            scan(s, node->data.generic_inst_expr.base, false);
+            break;
+
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) scan(s, init->expr, false);
+            }
+            break;
+
+        case AST_CAST:
+            scan(s, node->data.cast_expr.expr, false);
+            break;
+
+        case AST_INITIALIZER_LIST:
+            scan_list(s, node->data.initializer_list.elements);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void report_promotion(StackCandidate *cand) {
+    SourcePos pos = span_start_pos(cand->alloc->span);
+    const char *path = source_path(cand->alloc->span.file);
+    fprintf(stderr, "%s:%u:%u: @alloc of %llu bytes promoted to the stack\n",
+            path ? path : "<input>", pos.line, pos.col, (unsigned long long)cand->bytes);
+}
+
+void codegen_find_stack_allocs(CodegenContext *ctx, AstNode *func) {
+    if (ctx->stack_allocs) hashmap_destroy(ctx->stack_allocs, NULL, NULL);
+    ctx->stack_allocs = NULL;
+
+    AstNode *body = func->data.function_declaration.body;
+    if (!body) return;
+
+    EscapeScan s = { .ctx = ctx, .by_decl = hashmap_create(NULL, 16) };
+    dynarray_init(&s.candidates, sizeof(StackCandidate));
+    find_candidates(&s, body);
+
+    if (s.candidates.count > 0) {
+        scan(&s, body, false);
+        bool report = ctx->loader && ctx->loader->opts && ctx->loader->opts->report_stack_allocs;
+        uint64_t budget = STACK_ALLOC_FUNCTION_BYTES;
+        DYNARRAY_FOREACH(StackCandidate, cand, &s.candidates) {
+            if (!cand->escapes && cand->bytes <= budget) {
+                budget -= cand->bytes;
+                if (!ctx->stack_allocs) ctx->stack_allocs = hashmap_create(NULL, 16);
+                ptrmap_put(ctx->stack_allocs, cand->alloc, cand->alloc);
+                DYNARRAY_FOREACH(AstNode*, free_it, &cand->frees) ptrmap_put(ctx->stack_allocs, *free_it, *free_it);
+                if (report) report_promotion(cand);
+            }
+            dynarray_free(&cand->frees);
+        }
+    }
+
+    dynarray_free(&s.candidates);
+    hashmap_destroy(s.by_decl, NULL, NULL);
+}
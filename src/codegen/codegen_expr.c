@@ -17,6 +17,157 @@ LLVMValueRef codegen_expr(CodegenContext *ctx, AstNode *expr);
 // SECTION 1: INTRINSICS
 // =============================================================================
 
+/* The address a @memcpy/@memmove/@memset operand (a T[N], T[] or *T) starts at. */
+static LLVMValueRef bulk_memory_address(CodegenContext *ctx, AstNode *mem) {
+    switch (mem->type->kind) {
+        case TYPE_ARRAY: return codegen_lvalue(ctx, mem);
+        case TYPE_SLICE: return LLVMBuildExtractValue(ctx->builder, codegen_expr(ctx, mem), 0, "slice_ptr");
+        default:         return codegen_expr(ctx, mem);
+    }
+}
+
+/*
+ * One llvm.memcpy/memmove/memset of count * sizeof(T) bytes. A *T is aligned
+ * for T, so the intrinsic can use wide accesses, or become plain loads and
+ * stores when the count is constant.
+ */
+static LLVMValueRef codegen_bulk_memory(CodegenContext *ctx, AstNode *expr) {
+    DynArray *args = expr->data.intrinsic.args;
+    AstNode *dst_arg = DYNARRAY_AT(AstNode*, args, 0);
+    Type *dst_type = dst_arg->type;
+    Type *elem = dst_type->kind == TYPE_ARRAY ? dst_type->as.array.base :
+                 dst_type->kind == TYPE_SLICE ? dst_type->as.slice.base : dst_type->as.ptr.base;
+
+    unsigned long long elem_size = 1;
+    unsigned align = 1;
+    if (!type_is_void(elem)) {
+        LLVMTypeRef elem_ty = get_llvm_type(ctx, elem);
+        elem_size = LLVMABISizeOfType(ctx->target_data, elem_ty);
+        align = LLVMABIAlignmentOfType(ctx->target_data, elem_ty);
+    }
+
+    IntrinsicKind kind = expr->data.intrinsic.kind;
+    AstNode *second_arg = DYNARRAY_AT(AstNode*, args, 1); // The source, or @memset's byte
+    LLVMValueRef dst = bulk_memory_address(ctx, dst_arg);
+    LLVMValueRef second = kind == INTRINSIC_MEMSET ? codegen_expr(ctx, second_arg) : bulk_memory_address(ctx, second_arg);
+    LLVMTypeRef i64ty = LLVMInt64TypeInContext(ctx->context);
+    LLVMValueRef count = LLVMBuildIntCast(ctx->builder, codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 2)), i64ty, "count_i64");
+    LLVMValueRef bytes = elem_size == 1 ? count : LLVMBuildMul(ctx->builder, count, LLVMConstInt(i64ty, elem_size, 0), "bulk_bytes");
+
+    switch (kind) {
+        case INTRINSIC_MEMCPY:  LLVMBuildMemCpy(ctx->builder, dst, align, second, align, bytes); break;
+        case INTRINSIC_MEMMOVE: LLVMBuildMemMove(ctx->builder, dst, align, second, align, bytes); break;
+        default:                LLVMBuildMemSet(ctx->builder, dst, second, bytes, align); break;
+    }
+    return NULL;
+}
+
+static LLVMValueRef call_llvm_intrinsic(CodegenContext *ctx, const char *name, LLVMTypeRef *overloads, unsigned noverloads,
+                                        LLVMValueRef *args, unsigned nargs, const char *label) {
+    unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+    if (!id) ICE("LLVM has no intrinsic '%s'", name);
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(ctx->module, id, overloads, noverloads);
+    return LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(fn), fn, args, nargs, label);
+}
+
+/*
+ * @likely/@unlikely become llvm.expect, which the optimizer turns into
+ * branch weights on the branch the value feeds; @assume is llvm.assume and
+ * @prefetch llvm.prefetch of the data cache. @unreachable ends the block,
+ * so codegen_statement skips whatever follows it, as it does after a return.
+ */
+static LLVMValueRef codegen_hint_intrinsic(CodegenContext *ctx, AstNode *expr) {
+    DynArray *args = expr->data.intrinsic.args;
+    LLVMTypeRef i1 = LLVMInt1TypeInContext(ctx->context);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+
+    switch (expr->data.intrinsic.kind) {
+        case INTRINSIC_LIKELY:
+        case INTRINSIC_UNLIKELY: {
+            LLVMValueRef cond = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0));
+            LLVMTypeRef bool_ty = LLVMTypeOf(cond);
+            LLVMValueRef expect_args[2] = { LLVMBuildTrunc(ctx->builder, cond, i1, "cond_i1"),
+                                            LLVMConstInt(i1, expr->data.intrinsic.kind == INTRINSIC_LIKELY, 0) };
+            LLVMValueRef expected = call_llvm_intrinsic(ctx, "llvm.expect", &i1, 1, expect_args, 2, "expect");
+            return bool_ty == i1 ? expected : LLVMBuildZExt(ctx->builder, expected, bool_ty, "expect_bool");
+        }
+        case INTRINSIC_ASSUME: {
+            LLVMValueRef cond = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0));
+            cond = LLVMBuildTrunc(ctx->builder, cond, i1, "cond_i1");
+            call_llvm_intrinsic(ctx, "llvm.assume", NULL, 0, &cond, 1, "");
+            return NULL;
+        }
+        case INTRINSIC_PREFETCH: {
+            LLVMValueRef addr = bulk_memory_address(ctx, DYNARRAY_AT(AstNode*, args, 0));
+            LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+            Slice *rw = (Slice*)DYNARRAY_AT(AstNode*, args, 1)->data.identifier.intern_result->key;
+            AstNode *locality = DYNARRAY_AT(AstNode*, args, 2);
+            LLVMValueRef prefetch_args[4] = {
+                LLVMBuildPointerCast(ctx->builder, addr, i8ptr, "prefetch_addr"),
+                LLVMConstInt(i32, rw->len == 5, 0), // 1: write
+                LLVMConstInt(i32, (unsigned long long)locality->const_value.value.int_val, 0),
+                LLVMConstInt(i32, 1, 0),            // Data cache
+            };
+            call_llvm_intrinsic(ctx, "llvm.prefetch", &i8ptr, 1, prefetch_args, 4, "");
+            return NULL;
+        }
+        default:
+            LLVMBuildUnreachable(ctx->builder);
+            return NULL;
+    }
+}
+
+/*
+ * Math intrinsics become the llvm.* intrinsic overloaded on the operand
+ * type, so f32 stays f32, a vector computes lane-wise and the optimizer
+ * can fold and vectorize them; LLVM calls libm only where the target has
+ * no instruction. Integer @abs, @min and @max pick the signed or unsigned form.
+ */
+static LLVMValueRef codegen_math_intrinsic(CodegenContext *ctx, AstNode *expr) {
+    IntrinsicKind kind = expr->data.intrinsic.kind;
+    DynArray *args = expr->data.intrinsic.args;
+    LLVMValueRef ops[3];
+    size_t n = args->count;
+    for (size_t i = 0; i < n; i++) ops[i] = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, i));
+
+    Type *lane = expr->type->kind == TYPE_VECTOR ? expr->type->as.vector.base : expr->type;
+    LLVMTypeRef ty = LLVMTypeOf(ops[0]);
+    if (!type_is_float(lane)) {
+        bool is_unsigned = type_is_unsigned(lane);
+        if (kind == INTRINSIC_ABS) {
+            if (is_unsigned) return ops[0];
+            ops[1] = LLVMConstInt(LLVMInt1TypeInContext(ctx->context), 0, 0); // The most negative value wraps to itself
+            return call_llvm_intrinsic(ctx, "llvm.abs", &ty, 1, ops, 2, "abs");
+        }
+        const char *name = kind == INTRINSIC_MIN ? (is_unsigned ? "llvm.umin" : "llvm.smin")
+                                                 : (is_unsigned ? "llvm.umax" : "llvm.smax");
+        return call_llvm_intrinsic(ctx, name, &ty, 1, ops, 2, "minmax");
+    }
+
+    const char *name = NULL;
+    switch (kind) {
+        case INTRINSIC_SQRT:     name = "llvm.sqrt"; break;
+        case INTRINSIC_FLOOR:    name = "llvm.floor"; break;
+        case INTRINSIC_CEIL:     name = "llvm.ceil"; break;
+        case INTRINSIC_TRUNC:    name = "llvm.trunc"; break;
+        case INTRINSIC_ROUND:    name = "llvm.round"; break;
+        case INTRINSIC_SIN:      name = "llvm.sin"; break;
+        case INTRINSIC_COS:      name = "llvm.cos"; break;
+        case INTRINSIC_EXP:      name = "llvm.exp"; break;
+        case INTRINSIC_EXP2:     name = "llvm.exp2"; break;
+        case INTRINSIC_LOG:      name = "llvm.log"; break;
+        case INTRINSIC_LOG2:     name = "llvm.log2"; break;
+        case INTRINSIC_LOG10:    name = "llvm.log10"; break;
+        case INTRINSIC_ABS:      name = "llvm.fabs"; break;
+        case INTRINSIC_MIN:      name = "llvm.minnum"; break;
+        case INTRINSIC_MAX:      name = "llvm.maxnum"; break;
+        case INTRINSIC_COPYSIGN: name = "llvm.copysign"; break;
+        case INTRINSIC_POW:      name = "llvm.pow"; break;
+        default:                 name = "llvm.fma"; break;
+    }
+    return call_llvm_intrinsic(ctx, name, &ty, 1, ops, (unsigned)n, "math");
+}
+
 static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
     if (!expr->type) ICE("Intrinsic node (kind %d) missing type.", expr->data.intrinsic.kind);
     IntrinsicKind kind = expr->data.intrinsic.kind;
@@ -26,9 +177,16 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
     LLVMTypeRef i8ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
     LLVMTypeRef i64ty = LLVMInt64TypeInContext(ctx->context);
 
+    if (kind >= INTRINSIC_SPLAT && kind <= INTRINSIC_ALL) return codegen_vector_intrinsic(ctx, expr);
+    if (intrinsic_is_atomic(kind)) return codegen_atomic_intrinsic(ctx, expr);
+    if (intrinsic_is_bulk_memory(kind)) return codegen_bulk_memory(ctx, expr);
+    if (intrinsic_is_hint(kind)) return codegen_hint_intrinsic(ctx, expr);
+    if (intrinsic_is_math(kind)) return codegen_math_intrinsic(ctx, expr);
+    if (intrinsic_is_async(kind)) return codegen_async_intrinsic(ctx, expr);
+
     if (kind == INTRINSIC_ALLOC) {
-        AstNode *allocator_arg = *(AstNode**)dynarray_get(args, 1);
-        AstNode *count_arg = args->count == 3 ? *(AstNode**)dynarray_get(args, 2) : NULL;
+        AstNode *allocator_arg = DYNARRAY_AT(AstNode*, args, 1);
+        AstNode *count_arg = args->count == 3 ? DYNARRAY_AT(AstNode*, args, 2) : NULL;
 
         // 1. Target Type Extraction
         Type *target_type = expr->type;
@@ -37,6 +195,20 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
         
         LLVMTypeRef llvm_target_type = get_llvm_type(ctx, target_type);
 
+        // Promoted by escape analysis: a frame slot, the allocator is never called
+        if (ctx->stack_allocs && ptrmap_get(ctx->stack_allocs, expr)) {
+            unsigned long long count = count_arg ? (unsigned long long)count_arg->data.literal.value.int_val : 1;
+            LLVMValueRef slot = create_entry_block_alloca(ctx, LLVMArrayType(llvm_target_type, (unsigned)count), "stack_alloc");
+            LLVMValueRef typed_ptr = LLVMBuildBitCast(ctx->builder, slot, LLVMPointerType(llvm_target_type, 0), "stack_mem");
+            if (expr->type->kind == TYPE_SLICE) {
+                LLVMValueRef fat = LLVMGetUndef(get_llvm_type(ctx, expr->type));
+                fat = LLVMBuildInsertValue(ctx->builder, fat, typed_ptr, 0, "fat_ptr");
+                fat = LLVMBuildInsertValue(ctx->builder, fat, LLVMConstInt(i64ty, count, 0), 1, "fat_len");
+                return fat;
+            }
+            return typed_ptr;
+        }
+
         // 2. Compute Allocation Size (count * sizeof(T))
         LLVMValueRef count_val = count_arg ? codegen_expr(ctx, count_arg) : LLVMConstInt(i64ty, 1, 0);
         
@@ -65,13 +237,15 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
             ICE(" @alloc allocator missing required fields");
         }
 
-        LLVMValueRef ctx_val = LLVMBuildExtractValue(ctx->builder, allocator_val, (unsigned)ctx_idx, "ctx_val");
-        LLVMValueRef alloc_fn = LLVMBuildExtractValue(ctx->builder, allocator_val, (unsigned)alloc_idx, "alloc_fn_val");
+        LLVMValueRef ctx_val = LLVMBuildExtractValue(ctx->builder, allocator_val, codegen_field_slot(ctx, allocator_type, ctx_idx), "ctx_val");
+        LLVMValueRef alloc_fn = LLVMBuildExtractValue(ctx->builder, allocator_val, codegen_field_slot(ctx, allocator_type, alloc_idx), "alloc_fn_val");
 
         // 5. Invoke Custom Allocator
         LLVMTypeRef alloc_fn_ty = LLVMFunctionType(i8ptr, (LLVMTypeRef[]){i8ptr, i64ty}, 2, 0);
         LLVMValueRef call_args[] = { ctx_val, total_bytes };
-        LLVMValueRef raw_mem = LLVMBuildCall2(ctx->builder, alloc_fn_ty, alloc_fn, call_args, 2, "raw_mem");
+        LLVMValueRef known = allocator_type->kind == TYPE_STRUCT
+            ? codegen_known_field_fn(ctx, allocator_arg, allocator_type->as.struct_type.fields[alloc_idx].name) : NULL;
+        LLVMValueRef raw_mem = codegen_devirt_call(ctx, alloc_fn_ty, alloc_fn, known, call_args, 2, "raw_mem");
 
         LLVMValueRef typed_ptr = LLVMBuildBitCast(ctx->builder, raw_mem, LLVMPointerType(llvm_target_type, 0), "typed_mem");
         
@@ -87,8 +261,10 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
         return typed_ptr;
     }
     else if (kind == INTRINSIC_FREE) {
-        AstNode *allocator_arg = *(AstNode**)dynarray_get(args, args->count == 3 ? 1 : 0);
-        AstNode *ptr_arg = *(AstNode**)dynarray_get(args, args->count == 3 ? 2 : 1);
+        if (ctx->stack_allocs && ptrmap_get(ctx->stack_allocs, expr)) return NULL;
+
+        AstNode *allocator_arg = DYNARRAY_AT(AstNode*, args, args->count == 3 ? 1 : 0);
+        AstNode *ptr_arg = DYNARRAY_AT(AstNode*, args, args->count == 3 ? 2 : 1);
 
         Type *allocator_type = allocator_arg->type;
         LLVMValueRef allocator_val = codegen_expr(ctx, allocator_arg);
@@ -109,8 +285,8 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
             ICE(" @free allocator missing required fields");
         }
 
-        LLVMValueRef ctx_val = LLVMBuildExtractValue(ctx->builder, allocator_val, (unsigned)ctx_idx, "ctx_val");
-        LLVMValueRef free_fn = LLVMBuildExtractValue(ctx->builder, allocator_val, (unsigned)free_idx, "free_fn_val");
+        LLVMValueRef ctx_val = LLVMBuildExtractValue(ctx->builder, allocator_val, codegen_field_slot(ctx, allocator_type, ctx_idx), "ctx_val");
+        LLVMValueRef free_fn = LLVMBuildExtractValue(ctx->builder, allocator_val, codegen_field_slot(ctx, allocator_type, free_idx), "free_fn_val");
 
         // If passing a slice, extract the raw pointer member (index 0)
         if (ptr_arg->type->kind == TYPE_SLICE) {
@@ -122,7 +298,9 @@ static LLVMValueRef codegen_expr_intrinsic(CodegenContext *ctx, AstNode *expr) {
         LLVMTypeRef free_fn_ty = LLVMFunctionType(void_ty, (LLVMTypeRef[]){i8ptr, i8ptr}, 2, 0);
         LLVMValueRef call_args[] = { ctx_val, LLVMBuildBitCast(ctx->builder, ptr_val, i8ptr, "ptr_to_free") };
         
-        return LLVMBuildCall2(ctx->builder, free_fn_ty, free_fn, call_args, 2, "");
+        LLVMValueRef known = allocator_type->kind == TYPE_STRUCT
+            ? codegen_known_field_fn(ctx, allocator_arg, allocator_type->as.struct_type.fields[free_idx].name) : NULL;
+        return codegen_devirt_call(ctx, free_fn_ty, free_fn, known, call_args, 2, "");
     }
 
     return NULL;
@@ -180,6 +358,8 @@ static LLVMValueRef codegen_expr_member(CodegenContext *ctx, AstNode *expr) {
 // SECTION 3: AGGREGATE CREATION
 // =============================================================================
 
+static LLVMValueRef codegen_vector_list(CodegenContext *ctx, AstNode *expr);
+
 static LLVMValueRef codegen_expr_struct_literal(CodegenContext *ctx, AstNode *expr) {
     AstStructLiteral *lit = &expr->data.struct_literal;
     LLVMTypeRef struct_ty = get_llvm_type(ctx, expr->type);
@@ -189,20 +369,7 @@ static LLVMValueRef codegen_expr_struct_literal(CodegenContext *ctx, AstNode *ex
 
     // Constant Folding Path (Global Initializers)
     if (expr->is_llvm_const_safe || is_global) {
-        LLVMValueRef *fields = xmalloc(sizeof(LLVMValueRef) * lit->fields->count);
-        for (size_t i = 0; i < lit->fields->count; i++) {
-            AstFieldInit *init = (AstFieldInit*)dynarray_get(lit->fields, i);
-            
-            size_t idx;
-            if (!get_struct_field_index(expr->type, init->name, &idx)) {
-                ICE_AT(expr, "Field index not found in codegen");
-            }
-            
-            fields[idx] = codegen_expr(ctx, init->expr);
-        }
-        LLVMValueRef val = LLVMConstNamedStruct(struct_ty, fields, (unsigned)lit->fields->count);
-        free(fields);
-        return val;
+        return codegen_const_aggregate(ctx, expr);
     }
 
     // Dynamic Runtime Path (Local Structs)
@@ -216,64 +383,207 @@ static LLVMValueRef codegen_expr_struct_literal(CodegenContext *ctx, AstNode *ex
         if (!get_struct_field_index(expr->type, init->name, &idx)) {
             ICE_AT(expr, "Field index not found in codegen");
         }
+        // An array field's value is its address
+        if (init->expr->type->kind == TYPE_ARRAY && LLVMGetTypeKind(LLVMTypeOf(field_val)) == LLVMPointerTypeKind) {
+            field_val = LLVMBuildLoad2(ctx->builder, get_llvm_type(ctx, init->expr->type), field_val, "array_field");
+        }
         
-        val = LLVMBuildInsertValue(ctx->builder, val, field_val, (unsigned)idx, "struct_init");
+        val = LLVMBuildInsertValue(ctx->builder, val, field_val, codegen_field_slot(ctx, expr->type, idx), "struct_init");
     }
 
     return val;
 }
 
-static LLVMValueRef codegen_expr_initializer_list(CodegenContext *ctx, AstNode *expr) {
-    AstInitializeList *list = &expr->data.initializer_list;
+/* Writes a struct literal into `dst` field by field, without building the value first. */
+void codegen_struct_literal_into(CodegenContext *ctx, AstNode *expr, LLVMValueRef dst) {
+    if (expr->is_llvm_const_safe) {
+        codegen_store_value(ctx, codegen_const_aggregate(ctx, expr), dst, expr->type);
+        return;
+    }
+    AstStructLiteral *lit = &expr->data.struct_literal;
+    LLVMTypeRef struct_ty = get_llvm_type(ctx, expr->type);
+    for (size_t i = 0; i < lit->fields->count; i++) {
+        AstFieldInit *init = (AstFieldInit*)dynarray_get(lit->fields, i);
+        LLVMValueRef field_val = codegen_expr(ctx, init->expr);
+        size_t idx;
+        if (!get_struct_field_index(expr->type, init->name, &idx)) {
+            ICE_AT(expr, "Field index not found in codegen");
+        }
+        LLVMValueRef slot = LLVMBuildStructGEP2(ctx->builder, struct_ty, dst, codegen_field_slot(ctx, expr->type, idx), "field_init");
+        codegen_store_value(ctx, field_val, slot, init->expr->type);
+    }
+}
+
+/*
+ * A struct literal or initializer list whose elements are all constants, as
+ * one LLVM constant. Nested lists are built in place here: through
+ * codegen_expr they would become storage of their own.
+ */
+LLVMValueRef codegen_const_aggregate(CodegenContext *ctx, AstNode *expr) {
+    if (expr->node_type == AST_STRUCT_LITERAL) {
+        AstStructLiteral *lit = &expr->data.struct_literal;
+        LLVMTypeRef struct_ty = get_llvm_type(ctx, expr->type);
+        // Elements no field sets (padding of an explicit layout) are zero
+        unsigned elem_count = LLVMCountStructElementTypes(struct_ty);
+        LLVMValueRef *fields = xmalloc(sizeof(LLVMValueRef) * (elem_count ? elem_count : 1));
+        for (unsigned e = 0; e < elem_count; e++) fields[e] = LLVMConstNull(LLVMStructGetTypeAtIndex(struct_ty, e));
+        for (size_t i = 0; i < lit->fields->count; i++) {
+            AstFieldInit *init = (AstFieldInit*)dynarray_get(lit->fields, i);
+
+            size_t idx;
+            if (!get_struct_field_index(expr->type, init->name, &idx)) {
+                ICE_AT(expr, "Field index not found in codegen");
+            }
+
+            fields[codegen_field_slot(ctx, expr->type, idx)] = codegen_const_aggregate(ctx, init->expr);
+        }
+        LLVMValueRef val = LLVMConstNamedStruct(struct_ty, fields, elem_count);
+        free(fields);
+        return val;
+    }
+
+    if (expr->node_type != AST_INITIALIZER_LIST || expr->is_foldable_const) return codegen_expr(ctx, expr);
     Type *t = expr->type;
-    bool is_slice = (t->kind == TYPE_SLICE);
-    if (t->kind != TYPE_ARRAY && t->kind != TYPE_SLICE) ICE("Initializer list must have array/slice type in Codegen");
+    if (t->kind == TYPE_VECTOR) return codegen_vector_list(ctx, expr);
 
-    LLVMTypeRef arr_ty = is_slice ? LLVMArrayType(get_llvm_type(ctx, t->as.slice.base), (unsigned)list->elements->count) : get_llvm_type(ctx, t);
-    LLVMTypeRef elem_ty = get_llvm_type(ctx, is_slice ? t->as.slice.base : t->as.array.base);
+    DynArray *elements = expr->data.initializer_list.elements;
+    LLVMTypeRef elem_ty = get_llvm_type(ctx, t->kind == TYPE_SLICE ? t->as.slice.base : t->as.array.base);
+    LLVMValueRef *elems = xmalloc(sizeof(LLVMValueRef) * (elements->count ? elements->count : 1));
+    for (size_t i = 0; i < elements->count; i++) {
+        elems[i] = codegen_const_aggregate(ctx, DYNARRAY_AT(AstNode*, elements, i));
+    }
+    LLVMValueRef val = LLVMConstArray(elem_ty, elems, (unsigned)elements->count);
+    free(elems);
+    return val;
+}
 
-    // Check if the LLVM builder is active
+/* `{a, b, ...}` as a vec<T, N>: a constant vector, or one insertelement per lane. */
+static LLVMValueRef codegen_vector_list(CodegenContext *ctx, AstNode *expr) {
+    DynArray *elements = expr->data.initializer_list.elements;
+    unsigned count = (unsigned)elements->count;
     bool is_global = LLVMGetInsertBlock(ctx->builder) == NULL;
 
     if (expr->is_llvm_const_safe || is_global) {
-        LLVMValueRef *elems = xmalloc(sizeof(LLVMValueRef) * list->elements->count);
-        for (size_t i = 0; i < list->elements->count; i++) {
-            AstNode *elem = *(AstNode**)dynarray_get(list->elements, i);
-            elems[i] = codegen_expr(ctx, elem);
-        }
-        LLVMValueRef val = LLVMConstArray(elem_ty, elems, (unsigned)list->elements->count);
-        free(elems);
+        LLVMValueRef *lanes = xmalloc(sizeof(LLVMValueRef) * count);
+        for (unsigned i = 0; i < count; i++) lanes[i] = codegen_expr(ctx, DYNARRAY_AT(AstNode*, elements, i));
+        LLVMValueRef val = LLVMConstVector(lanes, count);
+        free(lanes);
         return val;
     }
 
-    LLVMValueRef arr_val = LLVMGetUndef(arr_ty);
+    LLVMTypeRef i32_ty = LLVMInt32TypeInContext(ctx->context);
+    LLVMValueRef val = LLVMGetUndef(get_llvm_type(ctx, expr->type));
+    for (unsigned i = 0; i < count; i++) {
+        LLVMValueRef lane = codegen_expr(ctx, DYNARRAY_AT(AstNode*, elements, i));
+        val = LLVMBuildInsertElement(ctx->builder, val, lane, LLVMConstInt(i32_ty, i, 0), "vec_init");
+    }
+    return val;
+}
+
+/* `init` as a private constant global: the read-only storage of a table literal. */
+static LLVMValueRef codegen_rodata(CodegenContext *ctx, LLVMValueRef init) {
+    LLVMTypeRef ty = LLVMTypeOf(init);
+    LLVMValueRef global = LLVMAddGlobal(ctx->module, ty, "const_table");
+    LLVMSetInitializer(global, init);
+    LLVMSetGlobalConstant(global, 1);
+    LLVMSetLinkage(global, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+    LLVMSetAlignment(global, LLVMABIAlignmentOfType(ctx->target_data, ty));
+    codegen_align_storage(ctx, global, ty);
+    return global;
+}
+
+/*
+ * Writes an array or slice initializer list into `dst`, an `arr_ty`. When at
+ * least half of the elements are constants they arrive in one memcpy from
+ * read-only data, with zeros in the other slots; those are then stored one
+ * at a time, nested lists straight into their slot.
+ */
+static void codegen_list_into(CodegenContext *ctx, AstNode *list, LLVMValueRef dst, LLVMTypeRef arr_ty, Type *elem_type) {
+    DynArray *elements = list->data.initializer_list.elements;
+    size_t count = elements->count;
+    LLVMTypeRef elem_ty = get_llvm_type(ctx, elem_type);
+    LLVMTypeRef i64ty = LLVMInt64TypeInContext(ctx->context);
 
-    for (size_t i = 0; i < list->elements->count; i++) {
-        AstNode *elem = *(AstNode**)dynarray_get(list->elements, i);
-        LLVMValueRef elem_val = codegen_expr(ctx, elem);
-        arr_val = LLVMBuildInsertValue(ctx->builder, arr_val, elem_val, (unsigned)i, "arr_init");
+    size_t constants = 0;
+    DYNARRAY_FOREACH(AstNode*, elem_it, elements) {
+        if ((*elem_it)->is_llvm_const_safe) constants++;
+    }
+    bool bulk = constants > 0 && constants * 2 >= count;
+    if (bulk) {
+        LLVMValueRef *elems = xmalloc(sizeof(LLVMValueRef) * count);
+        for (size_t i = 0; i < count; i++) {
+            AstNode *elem = DYNARRAY_AT(AstNode*, elements, i);
+            elems[i] = elem->is_llvm_const_safe ? codegen_const_aggregate(ctx, elem) : LLVMConstNull(elem_ty);
+        }
+        LLVMValueRef table = codegen_rodata(ctx, LLVMConstArray(elem_ty, elems, (unsigned)count));
+        free(elems);
+        unsigned align = LLVMABIAlignmentOfType(ctx->target_data, elem_ty);
+        LLVMBuildMemCpy(ctx->builder, dst, align, table, align, LLVMConstInt(i64ty, LLVMABISizeOfType(ctx->target_data, arr_ty), 0));
     }
 
-    if (is_slice) {
-        LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder, arr_ty, "slice_lit_alloca");
-        LLVMBuildStore(ctx->builder, arr_val, alloca);
-        
-        LLVMTypeRef slice_ty = get_llvm_type(ctx, t);
-        LLVMValueRef slice_val = LLVMGetUndef(slice_ty);
-        
-        // ptr is the alloca, which is already a pointer to the array (and thus its first element)
-        LLVMTypeRef ptr_ty = LLVMPointerType(elem_ty, 0);
-        LLVMValueRef ptr_cast = LLVMBuildBitCast(ctx->builder, alloca, ptr_ty, "slice_lit_ptr");
-        
-        slice_val = LLVMBuildInsertValue(ctx->builder, slice_val, ptr_cast, 0, "slice_ptr");
-        slice_val = LLVMBuildInsertValue(ctx->builder, slice_val, LLVMConstInt(LLVMInt64TypeInContext(ctx->context), list->elements->count, 0), 1, "slice_len");
-        return slice_val;
+    for (size_t i = 0; i < count; i++) {
+        AstNode *elem = DYNARRAY_AT(AstNode*, elements, i);
+        if (bulk && elem->is_llvm_const_safe) continue;
+        LLVMValueRef indices[2] = { LLVMConstInt(i64ty, 0, 0), LLVMConstInt(i64ty, i, 0) };
+        LLVMValueRef slot = LLVMBuildInBoundsGEP2(ctx->builder, arr_ty, dst, indices, 2, "elem_slot");
+        if (elem->node_type == AST_INITIALIZER_LIST && elem->type->kind == TYPE_ARRAY) {
+            codegen_list_into(ctx, elem, slot, elem_ty, elem->type->as.array.base);
+        } else {
+            codegen_store_value(ctx, codegen_expr(ctx, elem), slot, elem_type);
+        }
     }
+}
+
+/* Writes an initializer list of array type into `dst` without a temporary. */
+void codegen_initializer_into(CodegenContext *ctx, AstNode *list, LLVMValueRef dst) {
+    codegen_list_into(ctx, list, dst, get_llvm_type(ctx, list->type), list->type->as.array.base);
+}
+
+/*
+ * An array literal is, like every array, its address: a constant one is
+ * read-only data emitted once, a dynamic one a stack temporary written in
+ * place. A slice literal always gets its own writable stack copy.
+ */
+static LLVMValueRef codegen_expr_initializer_list(CodegenContext *ctx, AstNode *expr) {
+    AstInitializeList *list = &expr->data.initializer_list;
+    Type *t = expr->type;
+    if (t->kind == TYPE_VECTOR) return codegen_vector_list(ctx, expr);
+    bool is_slice = (t->kind == TYPE_SLICE);
+    if (t->kind != TYPE_ARRAY && t->kind != TYPE_SLICE) ICE("Initializer list must have array/slice type in Codegen");
 
-    return arr_val;
+    // Global initializers are constants (there is no builder)
+    if (LLVMGetInsertBlock(ctx->builder) == NULL) return codegen_const_aggregate(ctx, expr);
+
+    if (!is_slice && expr->is_llvm_const_safe) return codegen_rodata(ctx, codegen_const_aggregate(ctx, expr));
+
+    Type *elem_type = is_slice ? t->as.slice.base : t->as.array.base;
+    LLVMTypeRef arr_ty = is_slice ? LLVMArrayType(get_llvm_type(ctx, elem_type), (unsigned)list->elements->count) : get_llvm_type(ctx, t);
+    LLVMValueRef storage = create_entry_block_alloca(ctx, arr_ty, is_slice ? "slice_lit" : "arr_lit");
+    codegen_align_storage(ctx, storage, arr_ty);
+    codegen_list_into(ctx, expr, storage, arr_ty, elem_type);
+    if (!is_slice) return storage;
+
+    LLVMValueRef slice_val = LLVMGetUndef(get_llvm_type(ctx, t));
+    slice_val = LLVMBuildInsertValue(ctx->builder, slice_val, storage, 0, "slice_ptr");
+    slice_val = LLVMBuildInsertValue(ctx->builder, slice_val, LLVMConstInt(LLVMInt64TypeInContext(ctx->context), list->elements->count, 0), 1, "slice_len");
+    return slice_val;
 }
 
 static LLVMValueRef codegen_expr_subscript(CodegenContext *ctx, AstNode *expr) {
+    AstSubscriptExpr *sub = &expr->data.subscript_expr;
+    if (type_is_vector(sub->target->type)) {
+        LLVMValueRef vec = codegen_expr(ctx, sub->target);
+        return LLVMBuildExtractElement(ctx->builder, vec, codegen_expr(ctx, sub->index), "lane");
+    }
+    if (sub->target->node_type == AST_INITIALIZER_LIST && sub->target->type->kind == TYPE_ARRAY) {
+        // A lookup in a table literal reads the table itself, not a copy
+        LLVMValueRef indices[] = { LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0), codegen_expr(ctx, sub->index) };
+        LLVMValueRef len = LLVMConstInt(LLVMInt64TypeInContext(ctx->context), (unsigned long long)sub->target->type->as.array.size, 0);
+        codegen_bounds_check(ctx, expr, indices[1], len);
+        LLVMValueRef ptr = LLVMBuildInBoundsGEP2(ctx->builder, get_llvm_type(ctx, sub->target->type), codegen_expr(ctx, sub->target), indices, 2, "tableidx");
+        return codegen_load_value(ctx, ptr, expr->type);
+    }
     LLVMValueRef ptr = codegen_lvalue(ctx, expr);
     return codegen_load_value(ctx, ptr, expr->type);
 }
@@ -282,10 +592,28 @@ static LLVMValueRef codegen_expr_subscript(CodegenContext *ctx, AstNode *expr) {
 // SECTION 4: CONSTANTS & DISPATCH
 // =============================================================================
 
+/* `str` as an i8*. Global initializers are emitted with no insert block,
+ * where LLVMBuildGlobalStringPtr cannot be used, so build the global here. */
+static LLVMValueRef codegen_string_literal(CodegenContext *ctx, InternResult *str) {
+    const char *text = ((Slice*)str->key)->ptr;
+    if (LLVMGetInsertBlock(ctx->builder)) return LLVMBuildGlobalStringPtr(ctx->builder, text, "str_lit");
+
+    LLVMValueRef init = LLVMConstStringInContext(ctx->context, text, (unsigned)strlen(text), 0);
+    LLVMTypeRef arr_ty = LLVMTypeOf(init);
+    LLVMValueRef global = LLVMAddGlobal(ctx->module, arr_ty, "str_lit");
+    LLVMSetInitializer(global, init);
+    LLVMSetGlobalConstant(global, 1);
+    LLVMSetLinkage(global, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+    LLVMValueRef zero = LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0);
+    LLVMValueRef indices[2] = { zero, zero };
+    return LLVMConstInBoundsGEP2(arr_ty, global, indices, 2);
+}
+
 static LLVMValueRef codegen_const_value(CodegenContext *ctx, Type *type, ConstValue *val) {
     switch (val->type) {
         case STRING_LITERAL:
-            return LLVMBuildGlobalStringPtr(ctx->builder, ((Slice*)val->value.string_val->key)->ptr, "str_lit");
+            return codegen_string_literal(ctx, val->value.string_val);
         
         case INT_LITERAL: {
             LLVMTypeRef llvm_type = get_llvm_type(ctx, type);
@@ -325,7 +653,7 @@ LLVMValueRef codegen_expr(CodegenContext *ctx, AstNode *expr) {
     switch (expr->node_type) {
         case AST_LITERAL: {
             if (expr->data.literal.type == STRING_LITERAL) {
-                return LLVMBuildGlobalStringPtr(ctx->builder, ((Slice*)expr->data.literal.value.string_val->key)->ptr, "str_lit");
+                return codegen_string_literal(ctx, expr->data.literal.value.string_val);
             }
             return codegen_const_value(ctx, expr->type, &expr->const_value);
         }
@@ -0,0 +1,360 @@
+/**
+ * @file codegen_instrument.c
+ * @brief Function-level instrumentation: --instrument.
+ *
+ * Every Newt function body calls newt_instrument_enter(record) on entry and
+ * newt_instrument_leave(record) before each return. The record is a
+ * per-function global holding the call count, the inclusive and exclusive
+ * (self) cycles and the function's display name, worked out here rather
+ * than demangled at run time. Each thread keeps a shadow stack of its open
+ * calls: a return charges its elapsed cycles to the caller's children, and
+ * a recursive activation does not add to the inclusive time again.
+ *
+ * --run calls the C implementation in src/core/runtime.c, which is linked
+ * into the compiler. Executables do not link runtime.c: codegen_instrument_program
+ * links the same routines in as IR instead, with the report as a global
+ * destructor.
+ */
+
+#include "codegen_internal.h"
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Linker.h>
+
+#define INSTRUMENT_RECORD_PREFIX "newt.instr.rec."
+
+/* { calls, inclusive, self, active, registered, name, next }: struct InstrumentRecord in runtime.c */
+static LLVMTypeRef record_type(CodegenContext *ctx) {
+    LLVMContextRef c = ctx->context;
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(c);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(c);
+    LLVMTypeRef ptr = LLVMPointerType(LLVMInt8TypeInContext(c), 0);
+    LLVMTypeRef fields[] = { i64, i64, i64, i32, i32, ptr, ptr };
+    return LLVMStructTypeInContext(c, fields, 7, false);
+}
+
+static LLVMValueRef hook(CodegenContext *ctx, const char *name, LLVMTypeRef *fn_ty) {
+    LLVMTypeRef ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+    *fn_ty = LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), &ptr, 1, false);
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, name);
+    if (!fn) fn = LLVMAddFunction(ctx->module, name, *fn_ty);
+    return fn;
+}
+
+/* Called by codegen_func_body once `func` holds the whole body of `decl`. */
+void codegen_instrument_function(CodegenContext *ctx, AstNode *decl, LLVMValueRef func) {
+    LLVMContextRef c = ctx->context;
+    char *display = codegen_display_name(ctx, decl);
+    size_t display_len = strlen(display);
+    LLVMValueRef text = LLVMConstStringInContext(c, display, (unsigned)display_len, false);
+    LLVMValueRef name = LLVMAddGlobal(ctx->module, LLVMTypeOf(text), "newt.instr.name");
+    LLVMSetInitializer(name, text);
+    LLVMSetGlobalConstant(name, true);
+    LLVMSetLinkage(name, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(name, LLVMGlobalUnnamedAddr);
+    free(display);
+
+    LLVMTypeRef rec_ty = record_type(ctx);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(c);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(c);
+    LLVMValueRef init[] = {
+        LLVMConstNull(i64), LLVMConstNull(i64), LLVMConstNull(i64),
+        LLVMConstNull(i32), LLVMConstNull(i32),
+        name, LLVMConstNull(LLVMPointerType(LLVMInt8TypeInContext(c), 0)),
+    };
+    size_t len = 0;
+    const char *fn_name = LLVMGetValueName2(func, &len);
+    char *rec_name = xmalloc(sizeof(INSTRUMENT_RECORD_PREFIX) + len);
+    memcpy(rec_name, INSTRUMENT_RECORD_PREFIX, sizeof(INSTRUMENT_RECORD_PREFIX) - 1);
+    memcpy(rec_name + sizeof(INSTRUMENT_RECORD_PREFIX) - 1, fn_name, len + 1);
+    LLVMValueRef record = LLVMAddGlobal(ctx->module, rec_ty, rec_name);
+    free(rec_name);
+    LLVMSetInitializer(record, LLVMConstStructInContext(c, init, 7, false));
+    LLVMSetLinkage(record, LLVMInternalLinkage);
+    LLVMSetAlignment(record, 8);
+
+    LLVMTypeRef enter_ty, leave_ty;
+    LLVMValueRef enter = hook(ctx, "newt_instrument_enter", &enter_ty);
+    LLVMValueRef leave = hook(ctx, "newt_instrument_leave", &leave_ty);
+
+    // Ahead of the parameter spills, so that a self tail call stays inside one activation
+    LLVMBuilderRef b = LLVMCreateBuilderInContext(c);
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(func);
+    LLVMValueRef first = LLVMGetFirstInstruction(entry);
+    if (first) LLVMPositionBuilderBefore(b, first);
+    else LLVMPositionBuilderAtEnd(b, entry);
+    LLVMBuildCall2(b, enter_ty, enter, &record, 1, "");
+
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef term = LLVMGetBasicBlockTerminator(bb);
+        if (!term || LLVMGetInstructionOpcode(term) != LLVMRet) continue;
+        LLVMPositionBuilderBefore(b, term);
+        LLVMBuildCall2(b, leave_ty, leave, &record, 1, "");
+    }
+    LLVMDisposeBuilder(b);
+}
+
+/*
+ * The executable's runtime: `%zu` is the number of records in
+ * @newt.instr.table, and `%s` (twice) reads the cycle counter.
+ */
+static const char INSTRUMENT_RUNTIME_IR[] =
+    "%%newt.instr.rec = type { i64, i64, i64, i32, i32, ptr, ptr }\n"
+    "%%newt.instr.frame = type { ptr, i64, i64, i32 }\n"
+    "\n"
+    "@newt.instr.table = external hidden global [%zu x ptr]\n"
+    "@newt.instr.depth = internal thread_local(initialexec) global i32 0\n"
+    "@newt.instr.stack = internal thread_local(initialexec) global [%d x %%newt.instr.frame] zeroinitializer\n"
+    "@newt.instr.env = private constant [21 x i8] c\"NEWT_INSTRUMENT_FILE\\00\"\n"
+    "@newt.instr.mode = private constant [2 x i8] c\"w\\00\"\n"
+    "@newt.instr.header = private constant [67 x i8] c\"     calls  inclusive cycles       self cycles   self%%%%  function\\0A\\00\"\n"
+    "@newt.instr.row = private constant [34 x i8] c\"%%10llu %%17llu %%17llu %%6.2f%%%%  %%s\\0A\\00\"\n"
+    "@llvm.global_dtors = appending global [1 x { i32, ptr, ptr }] [{ i32, ptr, ptr } { i32 0, ptr @newt.instr.report, ptr null }]\n"
+    "\n"
+    "declare i64 @llvm.readcyclecounter()\n"
+    "declare ptr @getenv(ptr)\n"
+    "declare ptr @fopen(ptr, ptr)\n"
+    "declare ptr @fdopen(i32, ptr)\n"
+    "declare i32 @fprintf(ptr, ptr, ...)\n"
+    "declare i32 @fflush(ptr)\n"
+    "declare i32 @fclose(ptr)\n"
+    "declare void @qsort(ptr, i64, i64, ptr)\n"
+    "\n"
+    "define void @newt_instrument_enter(ptr %%rec) {\n"
+    "entry:\n"
+    "  %%calls = atomicrmw add ptr %%rec, i64 1 monotonic\n"
+    "  %%depth = load i32, ptr @newt.instr.depth\n"
+    "  %%next = add i32 %%depth, 1\n"
+    "  store i32 %%next, ptr @newt.instr.depth\n"
+    "  %%room = icmp ult i32 %%depth, %d\n"
+    "  br i1 %%room, label %%push, label %%done\n"
+    "push:\n"
+    "  %%active_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 3\n"
+    "  %%active = atomicrmw add ptr %%active_ptr, i32 1 monotonic\n"
+    "  %%idle = icmp eq i32 %%active, 0\n"
+    "  br i1 %%idle, label %%open, label %%scan\n"
+    "scan:\n" // Active somewhere: recursive only if it is on this thread's stack
+    "  %%i = phi i32 [ 0, %%push ], [ %%i.next, %%scan.frame ]\n"
+    "  %%more = icmp ult i32 %%i, %%depth\n"
+    "  br i1 %%more, label %%scan.frame, label %%open\n"
+    "scan.frame:\n"
+    "  %%si = zext i32 %%i to i64\n"
+    "  %%sframe = getelementptr inbounds [%d x %%newt.instr.frame], ptr @newt.instr.stack, i64 0, i64 %%si\n"
+    "  %%srec = load ptr, ptr %%sframe\n"
+    "  %%same = icmp eq ptr %%srec, %%rec\n"
+    "  %%i.next = add i32 %%i, 1\n"
+    "  br i1 %%same, label %%open, label %%scan\n"
+    "open:\n"
+    "  %%outer = phi i32 [ 1, %%push ], [ 1, %%scan ], [ 0, %%scan.frame ]\n"
+    "  %%idx = zext i32 %%depth to i64\n"
+    "  %%frame = getelementptr inbounds [%d x %%newt.instr.frame], ptr @newt.instr.stack, i64 0, i64 %%idx\n"
+    "  store ptr %%rec, ptr %%frame\n"
+    "  %%child_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 2\n"
+    "  store i64 0, ptr %%child_ptr\n"
+    "  %%outer_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 3\n"
+    "  store i32 %%outer, ptr %%outer_ptr\n"
+    "  %%now = %s\n"
+    "  %%start_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 1\n"
+    "  store i64 %%now, ptr %%start_ptr\n"
+    "  br label %%done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n"
+    "\n"
+    "define void @newt_instrument_leave(ptr %%rec) {\n"
+    "entry:\n"
+    "  %%depth = load i32, ptr @newt.instr.depth\n"
+    "  %%top = sub i32 %%depth, 1\n"
+    "  store i32 %%top, ptr @newt.instr.depth\n"
+    "  %%room = icmp ult i32 %%top, %d\n"
+    "  br i1 %%room, label %%pop, label %%done\n"
+    "pop:\n"
+    "  %%now = %s\n"
+    "  %%idx = zext i32 %%top to i64\n"
+    "  %%frame = getelementptr inbounds [%d x %%newt.instr.frame], ptr @newt.instr.stack, i64 0, i64 %%idx\n"
+    "  %%start_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 1\n"
+    "  %%start = load i64, ptr %%start_ptr\n"
+    "  %%child_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 2\n"
+    "  %%child = load i64, ptr %%child_ptr\n"
+    "  %%outer_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%frame, i32 0, i32 3\n"
+    "  %%outer = load i32, ptr %%outer_ptr\n"
+    "  %%elapsed = sub i64 %%now, %%start\n"
+    "  %%self = sub i64 %%elapsed, %%child\n"
+    "  %%self_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 2\n"
+    "  %%old_self = atomicrmw add ptr %%self_ptr, i64 %%self monotonic\n"
+    "  %%active_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 3\n"
+    "  %%old_active = atomicrmw sub ptr %%active_ptr, i32 1 monotonic\n"
+    "  %%is_outer = icmp ne i32 %%outer, 0\n"
+    "  br i1 %%is_outer, label %%inclusive, label %%parent\n"
+    "inclusive:\n"
+    "  %%incl_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 1\n"
+    "  %%old_incl = atomicrmw add ptr %%incl_ptr, i64 %%elapsed monotonic\n"
+    "  br label %%parent\n"
+    "parent:\n"
+    "  %%nested = icmp ne i32 %%top, 0\n"
+    "  br i1 %%nested, label %%charge, label %%done\n"
+    "charge:\n"
+    "  %%pidx = sub i64 %%idx, 1\n"
+    "  %%pframe = getelementptr inbounds [%d x %%newt.instr.frame], ptr @newt.instr.stack, i64 0, i64 %%pidx\n"
+    "  %%pchild_ptr = getelementptr inbounds %%newt.instr.frame, ptr %%pframe, i32 0, i32 2\n"
+    "  %%pchild = load i64, ptr %%pchild_ptr\n"
+    "  %%pchild.new = add i64 %%pchild, %%elapsed\n"
+    "  store i64 %%pchild.new, ptr %%pchild_ptr\n"
+    "  br label %%done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n"
+    "\n"
+    "define internal i32 @newt.instr.compare(ptr %%a, ptr %%b) {\n" // By self cycles, most first
+    "entry:\n"
+    "  %%ra = load ptr, ptr %%a\n"
+    "  %%rb = load ptr, ptr %%b\n"
+    "  %%sa_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%ra, i32 0, i32 2\n"
+    "  %%sb_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rb, i32 0, i32 2\n"
+    "  %%sa = load atomic i64, ptr %%sa_ptr monotonic, align 8\n"
+    "  %%sb = load atomic i64, ptr %%sb_ptr monotonic, align 8\n"
+    "  %%less = icmp ult i64 %%sa, %%sb\n"
+    "  %%more = icmp ugt i64 %%sa, %%sb\n"
+    "  %%after = select i1 %%less, i32 1, i32 0\n"
+    "  %%order = select i1 %%more, i32 -1, i32 %%after\n"
+    "  ret i32 %%order\n"
+    "}\n"
+    "\n"
+    "define internal void @newt.instr.report() {\n"
+    "entry:\n"
+    "  %%env = call ptr @getenv(ptr @newt.instr.env)\n"
+    "  %%has_env = icmp ne ptr %%env, null\n"
+    "  br i1 %%has_env, label %%to_file, label %%to_stderr\n"
+    "to_file:\n"
+    "  %%named = call ptr @fopen(ptr %%env, ptr @newt.instr.mode)\n"
+    "  br label %%opened\n"
+    "to_stderr:\n"
+    "  %%err = call ptr @fdopen(i32 2, ptr @newt.instr.mode)\n"
+    "  br label %%opened\n"
+    "opened:\n"
+    "  %%file = phi ptr [ %%named, %%to_file ], [ %%err, %%to_stderr ]\n"
+    "  %%usable = icmp ne ptr %%file, null\n"
+    "  br i1 %%usable, label %%sort, label %%done\n"
+    "sort:\n"
+    "  %%pending = call i32 @fflush(ptr null)\n" // The program's own output comes first
+    "  call void @qsort(ptr @newt.instr.table, i64 %zu, i64 8, ptr @newt.instr.compare)\n"
+    "  br label %%total\n"
+    "total:\n"
+    "  %%ti = phi i64 [ 0, %%sort ], [ %%ti.next, %%total.add ]\n"
+    "  %%sum = phi i64 [ 0, %%sort ], [ %%sum.next, %%total.add ]\n"
+    "  %%tmore = icmp ult i64 %%ti, %zu\n"
+    "  br i1 %%tmore, label %%total.add, label %%print\n"
+    "total.add:\n"
+    "  %%tslot = getelementptr inbounds [%zu x ptr], ptr @newt.instr.table, i64 0, i64 %%ti\n"
+    "  %%trec = load ptr, ptr %%tslot\n"
+    "  %%tself_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%trec, i32 0, i32 2\n"
+    "  %%tself = load atomic i64, ptr %%tself_ptr monotonic, align 8\n"
+    "  %%sum.next = add i64 %%sum, %%tself\n"
+    "  %%ti.next = add i64 %%ti, 1\n"
+    "  br label %%total\n"
+    "print:\n"
+    "  %%sum1 = icmp eq i64 %%sum, 0\n"
+    "  %%divisor = select i1 %%sum1, i64 1, i64 %%sum\n"
+    "  %%total_f = uitofp i64 %%divisor to double\n"
+    "  %%header = call i32 (ptr, ptr, ...) @fprintf(ptr %%file, ptr @newt.instr.header)\n"
+    "  br label %%row\n"
+    "row:\n"
+    "  %%ri = phi i64 [ 0, %%print ], [ %%ri.next, %%row.next ]\n"
+    "  %%rmore = icmp ult i64 %%ri, %zu\n"
+    "  br i1 %%rmore, label %%row.load, label %%close\n"
+    "row.load:\n"
+    "  %%slot = getelementptr inbounds [%zu x ptr], ptr @newt.instr.table, i64 0, i64 %%ri\n"
+    "  %%rec = load ptr, ptr %%slot\n"
+    "  %%calls = load atomic i64, ptr %%rec monotonic, align 8\n"
+    "  %%called = icmp ne i64 %%calls, 0\n"
+    "  br i1 %%called, label %%row.print, label %%row.next\n"
+    "row.print:\n"
+    "  %%incl_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 1\n"
+    "  %%incl = load atomic i64, ptr %%incl_ptr monotonic, align 8\n"
+    "  %%self_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 2\n"
+    "  %%self = load atomic i64, ptr %%self_ptr monotonic, align 8\n"
+    "  %%name_ptr = getelementptr inbounds %%newt.instr.rec, ptr %%rec, i32 0, i32 5\n"
+    "  %%name = load ptr, ptr %%name_ptr\n"
+    "  %%self_f = uitofp i64 %%self to double\n"
+    "  %%share = fdiv double %%self_f, %%total_f\n"
+    "  %%pct = fmul double %%share, 100.0\n"
+    "  %%line = call i32 (ptr, ptr, ...) @fprintf(ptr %%file, ptr @newt.instr.row, i64 %%calls, i64 %%incl, i64 %%self, double %%pct, ptr %%name)\n"
+    "  br label %%row.next\n"
+    "row.next:\n"
+    "  %%ri.next = add i64 %%ri, 1\n"
+    "  br label %%row\n"
+    "close:\n"
+    "  br i1 %%has_env, label %%close.file, label %%close.stderr\n"
+    "close.file:\n"
+    "  %%closed = call i32 @fclose(ptr %%file)\n"
+    "  br label %%done\n"
+    "close.stderr:\n" // Flushed only: fd 2 stays open for other destructors
+    "  %%flushed = call i32 @fflush(ptr %%file)\n"
+    "  br label %%done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n";
+
+// Frames per thread; deeper calls are counted but not timed
+#define INSTRUMENT_STACK_DEPTH 1024
+
+/* The cycle counter: the TSC on x86, the virtual counter (readable from user space) on AArch64. */
+static const char *cycle_counter_ir(CodegenContext *ctx) {
+    const char *triple = LLVMGetTarget(ctx->module);
+    if (strncmp(triple, "aarch64", 7) == 0 || strncmp(triple, "arm64", 5) == 0) {
+        return "call i64 asm sideeffect \"mrs $0, cntvct_el0\", \"=r\"()";
+    }
+    return "call i64 @llvm.readcyclecounter()";
+}
+
+/*
+ * Gathers the records of the lowered program into @newt.instr.table and
+ * links the runtime in. Runs before the pipeline, so that the hooks inline.
+ */
+void codegen_instrument_program(CodegenContext *ctx) {
+    if (!ctx->module || !ctx->instrument) return;
+
+    DynArray records;
+    dynarray_init(&records, sizeof(LLVMValueRef));
+    for (LLVMValueRef g = LLVMGetFirstGlobal(ctx->module); g; g = LLVMGetNextGlobal(g)) {
+        size_t len = 0;
+        const char *name = LLVMGetValueName2(g, &len);
+        if (len > sizeof(INSTRUMENT_RECORD_PREFIX) - 1 &&
+            strncmp(name, INSTRUMENT_RECORD_PREFIX, sizeof(INSTRUMENT_RECORD_PREFIX) - 1) == 0) {
+            dynarray_push_value(&records, &g);
+        }
+    }
+    if (records.count == 0) {
+        dynarray_free(&records);
+        return;
+    }
+
+    LLVMTypeRef ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->context), 0);
+    LLVMTypeRef table_ty = LLVMArrayType(ptr, (unsigned)records.count);
+    LLVMValueRef table = LLVMAddGlobal(ctx->module, table_ty, "newt.instr.table");
+    LLVMSetInitializer(table, LLVMConstArray(ptr, (LLVMValueRef *)records.data, (unsigned)records.count));
+    LLVMSetVisibility(table, LLVMHiddenVisibility);
+
+    size_t n = records.count;
+    dynarray_free(&records);
+    const char *clock = cycle_counter_ir(ctx);
+    int depth = INSTRUMENT_STACK_DEPTH;
+    size_t size = sizeof(INSTRUMENT_RUNTIME_IR) + 2 * strlen(clock) + 256;
+    char *ir = xmalloc(size);
+    snprintf(ir, size, INSTRUMENT_RUNTIME_IR, n, depth, depth, depth, depth, clock, depth, clock, depth, depth, n, n, n, n, n);
+
+    LLVMMemoryBufferRef buf = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir, strlen(ir), "newt_instrument_runtime");
+    free(ir);
+    LLVMModuleRef runtime = NULL;
+    char *msg = NULL;
+    if (LLVMParseIRInContext(ctx->context, buf, &runtime, &msg) != 0) {
+        ICE("Instrumentation runtime IR does not parse: %s", msg ? msg : "?");
+    }
+    LLVMSetTarget(runtime, LLVMGetTarget(ctx->module));
+    LLVMSetModuleDataLayout(runtime, ctx->target_data);
+    if (LLVMLinkModules2(ctx->module, runtime) != 0) ICE("Failed to link the instrumentation runtime");
+
+    // Only externally visible to be linked against: nothing outside the module uses them
+    LLVMSetLinkage(LLVMGetNamedGlobal(ctx->module, "newt.instr.table"), LLVMInternalLinkage);
+    LLVMSetLinkage(LLVMGetNamedFunction(ctx->module, "newt_instrument_enter"), LLVMInternalLinkage);
+    LLVMSetLinkage(LLVMGetNamedFunction(ctx->module, "newt_instrument_leave"), LLVMInternalLinkage);
+}
@@ -6,22 +6,39 @@
 #include "codegen_internal.h"
 #include "codegen/codegen_utils.h"
 
+/*
+ * The function or global `sym` was declared as, straight from the decl
+ * cache. Only declarations that already got their symbol name qualify, which
+ * keeps locals (and anything protos never saw) on the by-name path.
+ */
+static LLVMValueRef symbol_decl_value(CodegenContext *ctx, Symbol *sym) {
+    AstNode *decl = sym->decl_node;
+    if (!decl) return NULL;
+    if (decl->node_type == AST_FUNCTION_DECLARATION) {
+        if (!decl->data.function_declaration.mangled_name) return NULL;
+    } else if (decl->node_type == AST_VARIABLE_DECLARATION) {
+        if (!decl->data.variable_declaration.mangled_name) return NULL;
+    } else {
+        return NULL;
+    }
+    return codegen_decl_value(ctx, decl);
+}
+
 static LLVMValueRef codegen_lvalue_identifier(CodegenContext *ctx, AstNode *expr) {
     AstIdentifier *ident = &expr->data.identifier;
     
     // 1a. Try local variables first
     if (ident->intern_result) {
-        void *key = (void*)(intptr_t)(ident->intern_result->entry->dense_index + 1);
-        LLVMValueRef val = codegen_map_get(ctx->locals, key);
+        LLVMValueRef val = codegen_locals_get(ctx, ident->intern_result->entry->dense_index);
         if (val) return val;
     }
 
     // 1b. Try global symbols
-    CompilationUnit *current_unit = module_loader_get_unit(ctx->loader, expr->filename);
+    CompilationUnit *current_unit = module_loader_unit_for_file(ctx->loader, expr->span.file);
     if (current_unit && current_unit->global_scope) {
         Symbol *sym = ident->symbol; // Use the symbol resolved by semantic analysis
         if (!sym) {
-            sym = scope_lookup_symbol(current_unit->global_scope, ident->intern_result, expr->filename);
+            sym = scope_lookup_symbol(current_unit->global_scope, ident->intern_result, expr->span.file);
         }
         if (sym) {
             while (sym && sym->kind == SYMBOL_VALUE_ALIAS) {
@@ -29,7 +46,10 @@ static LLVMValueRef codegen_lvalue_identifier(CodegenContext *ctx, AstNode *expr
             }
             if (!sym) ICE_AT(expr, "Alias '%s' resolved to NULL.", ((Slice*)ident->intern_result->key)->ptr);
 
-            CompilationUnit *origin_unit = module_loader_get_unit(ctx->loader, sym->filename);
+            LLVMValueRef cached = symbol_decl_value(ctx, sym);
+            if (cached) return cached;
+
+            CompilationUnit *origin_unit = module_loader_unit_for_file(ctx->loader, sym->file);
             Type *fn_type = (sym->kind == SYMBOL_VALUE_FUNCTION) ? sym->type : NULL;
             char *mangled = mangle_name(ctx, origin_unit, sym->name_rec, fn_type);
             
@@ -53,6 +73,7 @@ static LLVMValueRef codegen_lvalue_subscript(CodegenContext *ctx, AstNode *expr)
     if (target_type->kind == TYPE_ARRAY) {
         LLVMValueRef target = codegen_lvalue(ctx, sub->target);
         LLVMTypeRef arr_ty = get_llvm_type(ctx, target_type);
+        codegen_bounds_check(ctx, expr, idx, LLVMConstInt(LLVMInt64TypeInContext(ctx->context), (unsigned long long)target_type->as.array.size, 0));
         LLVMValueRef indices[] = {
             LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0),
             idx
@@ -65,13 +86,25 @@ static LLVMValueRef codegen_lvalue_subscript(CodegenContext *ctx, AstNode *expr)
         LLVMValueRef data_ptr_ptr = LLVMBuildStructGEP2(ctx->builder, struct_ty, struct_ptr, 0, "data_ptr_ptr");
         LLVMTypeRef elem_ptr_ty = LLVMStructGetTypeAtIndex(struct_ty, 0);
         LLVMValueRef data_ptr = LLVMBuildLoad2(ctx->builder, elem_ptr_ty, data_ptr_ptr, "data_ptr");
+        if (ctx->bounds_checks) {
+            LLVMValueRef len_ptr = LLVMBuildStructGEP2(ctx->builder, struct_ty, struct_ptr, 1, "len_ptr");
+            LLVMValueRef len = LLVMBuildLoad2(ctx->builder, LLVMStructGetTypeAtIndex(struct_ty, 1), len_ptr, "len");
+            codegen_bounds_check(ctx, expr, idx, len);
+        }
         LLVMTypeRef elem_ty = get_llvm_type(ctx, target_type->as.slice.base);
-        return LLVMBuildGEP2(ctx->builder, elem_ty, data_ptr, &idx, 1, "sliceidx");
+        return LLVMBuildInBoundsGEP2(ctx->builder, elem_ty, data_ptr, &idx, 1, "sliceidx");
     } 
     else if (target_type->kind == TYPE_POINTER) {
         LLVMValueRef target = codegen_expr(ctx, sub->target);
         LLVMTypeRef elem_ty = get_llvm_type(ctx, target_type->as.ptr.base);
-        return LLVMBuildGEP2(ctx->builder, elem_ty, target, &idx, 1, "ptr_idx");
+        return LLVMBuildInBoundsGEP2(ctx->builder, elem_ty, target, &idx, 1, "ptr_idx");
+    }
+    else if (target_type->kind == TYPE_VECTOR) {
+        // A vector's lanes are laid out like an array of them
+        LLVMValueRef target = codegen_lvalue(ctx, sub->target);
+        LLVMTypeRef lane_ty = get_llvm_type(ctx, target_type->as.vector.base);
+        LLVMValueRef lanes = LLVMBuildBitCast(ctx->builder, target, LLVMPointerType(lane_ty, 0), "lanes_ptr");
+        return LLVMBuildInBoundsGEP2(ctx->builder, lane_ty, lanes, &idx, 1, "laneidx");
     }
 
     ICE_AT(sub->target, "Subscript target must be array, slice, or pointer");
@@ -83,7 +116,9 @@ static LLVMValueRef codegen_lvalue_member(CodegenContext *ctx, AstNode *expr) {
     
     // Module/Namespace Access
     if (mem_expr->symbol) {
-        CompilationUnit *u = module_loader_get_unit(ctx->loader, mem_expr->symbol->filename);
+        LLVMValueRef cached = symbol_decl_value(ctx, mem_expr->symbol);
+        if (cached) return cached;
+        CompilationUnit *u = module_loader_unit_for_file(ctx->loader, mem_expr->symbol->file);
         Type *fn_type = (mem_expr->symbol->kind == SYMBOL_VALUE_FUNCTION) ? mem_expr->symbol->type : NULL;
         char *mangled = mangle_name(ctx, u, mem_expr->symbol->name_rec, fn_type);
         LLVMValueRef val = LLVMGetNamedFunction(ctx->module, mangled);
@@ -112,7 +147,7 @@ static LLVMValueRef codegen_lvalue_member(CodegenContext *ctx, AstNode *expr) {
         }
         size_t idx;
         if (!get_struct_field_index(underlying, mem_expr->member, &idx)) ICE_AT(expr, "Field index not found");
-        return LLVMBuildStructGEP2(ctx->builder, struct_ty, target_lvalue, (unsigned)idx, "field_gep");
+        return LLVMBuildStructGEP2(ctx->builder, struct_ty, target_lvalue, codegen_field_slot(ctx, underlying, idx), "field_gep");
     }
 
     ICE_AT(expr, "Member access requires struct or slice");
@@ -123,7 +158,7 @@ static LLVMValueRef codegen_materialize_rvalue(CodegenContext *ctx, AstNode *exp
     LLVMTypeRef ty = get_llvm_type(ctx, expr->type);
     LLVMValueRef slot = create_entry_block_alloca(ctx, ty, "rvalue_tmp");
     LLVMValueRef val = codegen_expr(ctx, expr);
-    LLVMBuildStore(ctx->builder, val, slot);
+    codegen_store_value(ctx, val, slot, expr->type);
     return slot;
 }
 
@@ -148,6 +183,10 @@ LLVMValueRef codegen_lvalue(CodegenContext *ctx, AstNode *expr) {
             }
             return codegen_lvalue(ctx, expr->data.cast_expr.expr);
         }
+        case AST_INITIALIZER_LIST:
+            // A dynamic array literal is a fresh temporary already; a constant one is read-only data
+            if (expr->type->kind == TYPE_ARRAY && !expr->is_llvm_const_safe) return codegen_expr(ctx, expr);
+            break;
         default: break;
     }
 
@@ -37,11 +37,11 @@ LLVMValueRef codegen_materialize_slice(CodegenContext *ctx, LLVMValueRef val, Ty
     // Loop through rows and materialize inner slices
     for (size_t i = 0; i < n; i++) {
         LLVMValueRef idx[] = { LLVMConstInt(i32_ty, 0, 0), LLVMConstInt(i32_ty, (unsigned)i, 0) };
-        LLVMValueRef row_ptr = LLVMBuildGEP2(ctx->builder, outer_arr_ty, val, idx, 2, "row_ptr");
+        LLVMValueRef row_ptr = LLVMBuildInBoundsGEP2(ctx->builder, outer_arr_ty, val, idx, 2, "row_ptr");
         
         LLVMValueRef row_fat = codegen_materialize_slice(ctx, row_ptr, src_inner, dst_inner);
         
-        LLVMValueRef hdr_ptr = LLVMBuildGEP2(ctx->builder, hdrs_arr_ty, hdrs, idx, 2, "hdr_ptr");
+        LLVMValueRef hdr_ptr = LLVMBuildInBoundsGEP2(ctx->builder, hdrs_arr_ty, hdrs, idx, 2, "hdr_ptr");
         LLVMBuildStore(ctx->builder, row_fat, hdr_ptr);
     }
 
@@ -49,6 +49,16 @@ LLVMValueRef codegen_materialize_slice(CodegenContext *ctx, LLVMValueRef val, Ty
     return build_fat_ptr(ctx, dst_ty, hdrs, n);
 }
 
+/* Integer +, - or *: nsw on signed operands when their overflow is undefined (--strict-overflow). */
+static LLVMValueRef build_int_arith(CodegenContext *ctx, OpKind op, LLVMValueRef L, LLVMValueRef R, bool is_unsigned, const char *name) {
+    bool nsw = ctx->strict_overflow && !is_unsigned;
+    switch (op) {
+        case OP_ADD: return nsw ? LLVMBuildNSWAdd(ctx->builder, L, R, name) : LLVMBuildAdd(ctx->builder, L, R, name);
+        case OP_SUB: return nsw ? LLVMBuildNSWSub(ctx->builder, L, R, name) : LLVMBuildSub(ctx->builder, L, R, name);
+        default:     return nsw ? LLVMBuildNSWMul(ctx->builder, L, R, name) : LLVMBuildMul(ctx->builder, L, R, name);
+    }
+}
+
 LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
     if (expr->node_type == AST_CAST) {
         AstCastExpr *cast_node = &expr->data.cast_expr;
@@ -56,6 +66,10 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
         LLVMTypeRef  dst_ty = get_llvm_type(ctx, cast_node->target_type);
         if (!val || !dst_ty) return val;
 
+        if (type_is_vector(cast_node->expr->type) && type_is_vector(cast_node->target_type)) {
+            return codegen_vector_cast(ctx, val, cast_node->expr->type, cast_node->target_type);
+        }
+
         LLVMTypeRef  src_ty = LLVMTypeOf(val);
         LLVMTypeKind src_k  = LLVMGetTypeKind(src_ty);
         LLVMTypeKind dst_k  = LLVMGetTypeKind(dst_ty);
@@ -95,11 +109,13 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
         } else {
             // Special Case: Array to Slice (Fat Pointer)
             if (cast_node->expr->type->kind == TYPE_ARRAY && cast_node->target_type->kind == TYPE_SLICE) {
-                // If val is not a pointer (e.g., an inline array value from an initializer list), spill it.
-                if (LLVMGetTypeKind(LLVMTypeOf(val)) != LLVMPointerTypeKind) {
-                    LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder, LLVMTypeOf(val), "array_spill");
-                    LLVMBuildStore(ctx->builder, val, alloca);
-                    val = alloca;
+                // A constant array literal is read-only data: the slice gets a writable copy
+                if (LLVMIsAGlobalVariable(val) && LLVMIsGlobalConstant(val)) {
+                    LLVMTypeRef arr_ty = get_llvm_type(ctx, cast_node->expr->type);
+                    LLVMValueRef copy = create_entry_block_alloca(ctx, arr_ty, "array_copy");
+                    codegen_align_storage(ctx, copy, arr_ty);
+                    codegen_store_value(ctx, val, copy, cast_node->expr->type);
+                    val = copy;
                 }
                 return codegen_materialize_slice(ctx, val, cast_node->expr->type, cast_node->target_type);
             }
@@ -131,16 +147,23 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
         if (!L || !R) return NULL;
 
         Type *ltype    = expr->data.binary_expr.left->type;
+        Type *rtype    = expr->data.binary_expr.right->type;
+        if (type_is_vector(ltype) || type_is_vector(rtype)) {
+            return codegen_vector_binary(ctx, expr->data.binary_expr.op, L, R, type_is_vector(ltype) ? ltype : rtype, expr->type);
+        }
         int   is_float = (ltype && ltype->kind == TYPE_PRIMITIVE &&
                           (ltype->as.primitive == PRIM_F32 ||
                            ltype->as.primitive == PRIM_F64));
+        bool  is_unsigned = ltype && type_is_unsigned(ltype);
 
         switch (expr->data.binary_expr.op) {
-            case OP_ADD:  return is_float ? LLVMBuildFAdd(ctx->builder, L, R, "addtmp") : LLVMBuildAdd(ctx->builder, L, R, "addtmp");
-            case OP_SUB:  return is_float ? LLVMBuildFSub(ctx->builder, L, R, "subtmp") : LLVMBuildSub(ctx->builder, L, R, "subtmp");
-            case OP_MUL:  return is_float ? LLVMBuildFMul(ctx->builder, L, R, "multmp") : LLVMBuildMul(ctx->builder, L, R, "multmp");
-            case OP_DIV:  return is_float ? LLVMBuildFDiv(ctx->builder, L, R, "divtmp") : LLVMBuildSDiv(ctx->builder, L, R, "divtmp");
-            case OP_MOD:  return is_float ? LLVMBuildFRem(ctx->builder, L, R, "modtmp") : LLVMBuildSRem(ctx->builder, L, R, "modtmp");
+            case OP_ADD:  return is_float ? LLVMBuildFAdd(ctx->builder, L, R, "addtmp") : build_int_arith(ctx, OP_ADD, L, R, is_unsigned, "addtmp");
+            case OP_SUB:  return is_float ? LLVMBuildFSub(ctx->builder, L, R, "subtmp") : build_int_arith(ctx, OP_SUB, L, R, is_unsigned, "subtmp");
+            case OP_MUL:  return is_float ? LLVMBuildFMul(ctx->builder, L, R, "multmp") : build_int_arith(ctx, OP_MUL, L, R, is_unsigned, "multmp");
+            case OP_DIV:  return is_float ? LLVMBuildFDiv(ctx->builder, L, R, "divtmp")
+                                 : is_unsigned ? LLVMBuildUDiv(ctx->builder, L, R, "divtmp") : LLVMBuildSDiv(ctx->builder, L, R, "divtmp");
+            case OP_MOD:  return is_float ? LLVMBuildFRem(ctx->builder, L, R, "modtmp")
+                                 : is_unsigned ? LLVMBuildURem(ctx->builder, L, R, "modtmp") : LLVMBuildSRem(ctx->builder, L, R, "modtmp");
             case OP_EQ: {
                 LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOEQ, L, R, "eqtmp")  : LLVMBuildICmp(ctx->builder, LLVMIntEQ,  L, R, "eqtmp");
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
@@ -150,19 +173,19 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
             }
             case OP_LT: {
-                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOLT, L, R, "lttmp") : LLVMBuildICmp(ctx->builder, LLVMIntSLT, L, R, "lttmp");
+                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOLT, L, R, "lttmp") : LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntULT : LLVMIntSLT, L, R, "lttmp");
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
             }
             case OP_GT: {
-                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOGT, L, R, "gttmp") : LLVMBuildICmp(ctx->builder, LLVMIntSGT, L, R, "gttmp");
+                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOGT, L, R, "gttmp") : LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntUGT : LLVMIntSGT, L, R, "gttmp");
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
             }
             case OP_LE: {
-                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOLE, L, R, "letmp") : LLVMBuildICmp(ctx->builder, LLVMIntSLE, L, R, "letmp");
+                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOLE, L, R, "letmp") : LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntULE : LLVMIntSLE, L, R, "letmp");
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
             }
             case OP_GE: {
-                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOGE, L, R, "getmp") : LLVMBuildICmp(ctx->builder, LLVMIntSGE, L, R, "getmp");
+                LLVMValueRef res = is_float ? LLVMBuildFCmp(ctx->builder, LLVMRealOGE, L, R, "getmp") : LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntUGE : LLVMIntSGE, L, R, "getmp");
                 return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
             }
             case OP_AND: {
@@ -186,28 +209,38 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
         if (!ptr || !rval) return NULL;
 
         if (assign->op == OP_ASSIGN) {
-            LLVMBuildStore(ctx->builder, rval, ptr);
+            codegen_store_value(ctx, rval, ptr, assign->lvalue->type);
             return rval;
         }
 
         LLVMTypeRef  ty   = get_llvm_type(ctx, assign->lvalue->type);
         LLVMValueRef lval = LLVMBuildLoad2(ctx->builder, ty, ptr, "loadtmp");
+        codegen_tbaa(ctx, lval, assign->lvalue->type);
         LLVMValueRef res  = NULL;
 
         Type *ltype    = assign->lvalue->type;
+        if (type_is_vector(ltype)) {
+            static const OpKind ops[] = { [OP_PLUS_EQ] = OP_ADD, [OP_MINUS_EQ] = OP_SUB, [OP_MUL_EQ] = OP_MUL, [OP_DIV_EQ] = OP_DIV, [OP_MOD_EQ] = OP_MOD };
+            res = codegen_vector_binary(ctx, ops[assign->op], lval, rval, ltype, ltype);
+            LLVMBuildStore(ctx->builder, res, ptr);
+            return res;
+        }
         int   is_float = (ltype && ltype->kind == TYPE_PRIMITIVE &&
                           (ltype->as.primitive == PRIM_F32 ||
                            ltype->as.primitive == PRIM_F64));
+        bool  is_unsigned = ltype && type_is_unsigned(ltype);
 
         switch (assign->op) {
-            case OP_PLUS_EQ:  res = is_float ? LLVMBuildFAdd(ctx->builder, lval, rval, "addtmp") : LLVMBuildAdd(ctx->builder, lval, rval, "addtmp"); break;
-            case OP_MINUS_EQ: res = is_float ? LLVMBuildFSub(ctx->builder, lval, rval, "subtmp") : LLVMBuildSub(ctx->builder, lval, rval, "subtmp"); break;
-            case OP_MUL_EQ:   res = is_float ? LLVMBuildFMul(ctx->builder, lval, rval, "multmp") : LLVMBuildMul(ctx->builder, lval, rval, "multmp"); break;
-            case OP_DIV_EQ:   res = is_float ? LLVMBuildFDiv(ctx->builder, lval, rval, "divtmp") : LLVMBuildSDiv(ctx->builder, lval, rval, "divtmp"); break;
-            case OP_MOD_EQ:   res = is_float ? LLVMBuildFRem(ctx->builder, lval, rval, "modtmp") : LLVMBuildSRem(ctx->builder, lval, rval, "modtmp"); break;
+            case OP_PLUS_EQ:  res = is_float ? LLVMBuildFAdd(ctx->builder, lval, rval, "addtmp") : build_int_arith(ctx, OP_ADD, lval, rval, is_unsigned, "addtmp"); break;
+            case OP_MINUS_EQ: res = is_float ? LLVMBuildFSub(ctx->builder, lval, rval, "subtmp") : build_int_arith(ctx, OP_SUB, lval, rval, is_unsigned, "subtmp"); break;
+            case OP_MUL_EQ:   res = is_float ? LLVMBuildFMul(ctx->builder, lval, rval, "multmp") : build_int_arith(ctx, OP_MUL, lval, rval, is_unsigned, "multmp"); break;
+            case OP_DIV_EQ:   res = is_float ? LLVMBuildFDiv(ctx->builder, lval, rval, "divtmp")
+                                       : is_unsigned ? LLVMBuildUDiv(ctx->builder, lval, rval, "divtmp") : LLVMBuildSDiv(ctx->builder, lval, rval, "divtmp"); break;
+            case OP_MOD_EQ:   res = is_float ? LLVMBuildFRem(ctx->builder, lval, rval, "modtmp")
+                                       : is_unsigned ? LLVMBuildURem(ctx->builder, lval, rval, "modtmp") : LLVMBuildSRem(ctx->builder, lval, rval, "modtmp"); break;
             default:           res = rval; break;
         }
-        if (res) LLVMBuildStore(ctx->builder, res, ptr);
+        if (res) codegen_tbaa(ctx, LLVMBuildStore(ctx->builder, res, ptr), ltype);
         return res;
     }
 
@@ -222,15 +255,18 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
         } else if (ue->op == OP_SUB) {
             LLVMValueRef val = codegen_expr(ctx, ue->expr);
             LLVMTypeRef  ty  = LLVMTypeOf(val);
-            if (LLVMGetTypeKind(ty) == LLVMIntegerTypeKind)
+            if (LLVMGetTypeKind(ty) == LLVMVectorTypeKind) ty = LLVMGetElementType(ty);
+            if (LLVMGetTypeKind(ty) == LLVMIntegerTypeKind) {
+                if (ctx->strict_overflow && !type_is_unsigned(ue->expr->type)) return LLVMBuildNSWNeg(ctx->builder, val, "negtmp");
                 return LLVMBuildNeg(ctx->builder, val, "negtmp");
+            }
             return LLVMBuildFNeg(ctx->builder, val, "fnegtmp");
         } else if (ue->op == OP_NOT) {
             LLVMValueRef val = codegen_expr(ctx, ue->expr);
             LLVMTypeRef ty = LLVMTypeOf(val);
-            if (LLVMGetTypeKind(ty) == LLVMIntegerTypeKind) {
+            if (LLVMGetTypeKind(ty) == LLVMIntegerTypeKind || LLVMGetTypeKind(ty) == LLVMVectorTypeKind) {
                 // Logical NOT: val == 0
-                LLVMValueRef res = LLVMBuildICmp(ctx->builder, LLVMIntEQ, val, LLVMConstInt(ty, 0, 0), "nottmp");
+                LLVMValueRef res = LLVMBuildICmp(ctx->builder, LLVMIntEQ, val, LLVMConstNull(ty), "nottmp");
                 // Convert i1 result back to the original type (e.g. i8 for bool)
                 return LLVMBuildZExt(ctx->builder, res, ty, "not_bool");
             }
@@ -244,21 +280,23 @@ LLVMValueRef codegen_expr_ops(CodegenContext *ctx, AstNode *expr) {
 
             LLVMValueRef val     = LLVMBuildLoad2(ctx->builder, ty, ptr, "loadtmp");
             LLVMValueRef new_val = NULL;
+            codegen_tbaa(ctx, val, ue->expr->type);
+            bool is_unsigned = type_is_unsigned(ue->expr->type);
             int is_float = (LLVMGetTypeKind(ty) == LLVMFloatTypeKind ||
                             LLVMGetTypeKind(ty) == LLVMDoubleTypeKind);
 
             if (!is_float) {
                 if (ue->op == OP_POST_INC || ue->op == OP_PRE_INC)
-                    new_val = LLVMBuildAdd(ctx->builder, val, LLVMConstInt(ty, 1, 0), "inc");
+                    new_val = build_int_arith(ctx, OP_ADD, val, LLVMConstInt(ty, 1, 0), is_unsigned, "inc");
                 else
-                    new_val = LLVMBuildSub(ctx->builder, val, LLVMConstInt(ty, 1, 0), "dec");
+                    new_val = build_int_arith(ctx, OP_SUB, val, LLVMConstInt(ty, 1, 0), is_unsigned, "dec");
             } else {
                 if (ue->op == OP_POST_INC || ue->op == OP_PRE_INC)
                     new_val = LLVMBuildFAdd(ctx->builder, val, LLVMConstReal(ty, 1.0), "inc");
                 else
                     new_val = LLVMBuildFSub(ctx->builder, val, LLVMConstReal(ty, 1.0), "dec");
             }
-            if (new_val) LLVMBuildStore(ctx->builder, new_val, ptr);
+            if (new_val) codegen_tbaa(ctx, LLVMBuildStore(ctx->builder, new_val, ptr), ue->expr->type);
             return (ue->op == OP_POST_INC || ue->op == OP_POST_DEC) ? val : new_val;
         }
         ICE("codegen_expr_ops: unhandled unary operator %d", ue->op);
@@ -0,0 +1,198 @@
+/**
+ * @file codegen_profile.c
+ * @brief Profile-guided optimization: --profile-generate and --profile-use.
+ *
+ * Instrumentation is LLVM's IR-level PGO (`pgo-instr-gen` + `instrprof`)
+ * run on the unoptimized program module, so that `pgo-instr-use` later sees
+ * the same control flow and matches every function's hash. There is no
+ * compiler-rt here: the module itself carries a small writer that runs as a
+ * global destructor and dumps the counter sections as a raw profile
+ * (merge it with `llvm-profdata merge -o app.profdata default.profraw`).
+ */
+
+#include "codegen_internal.h"
+#include "core/trace.h"
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <llvm/Config/llvm-config.h>
+
+// Size of one __llvm_profile_data record (raw format version 8, 64-bit)
+#define PROFILE_DATA_RECORD_BYTES 48
+#define PROFILE_VALUE_KIND_LAST   1 // IPVK_MemOPSize
+
+/*
+ * The pass options below are LLVM command-line flags; each can only be
+ * given once per process.
+ */
+static void set_llvm_flag(const char *flag) {
+    const char *args[] = { "newt", flag };
+    LLVMParseCommandLineOptions(2, args, NULL);
+}
+
+/*
+ * Value profiling would need the compiler-rt callbacks, so the instrumented
+ * build records no value sites; the use build must not expect any either,
+ * or pgo-instr-use warns about every function with an indirect call or a
+ * memory intrinsic. Counters are bumped atomically: LLVM 14's loop access
+ * analysis crashes on the plain load/add/store of a counter under opaque
+ * pointers, and it leaves loops with atomics alone (counts stay exact
+ * across threads).
+ */
+static void set_instrumentation_flags(void) {
+    static bool applied = false;
+    if (applied) return;
+    applied = true;
+    set_llvm_flag("-disable-vp");
+    set_llvm_flag("-instrprof-atomic-counter-update-all");
+}
+
+static bool use_profile_file(const char *path) {
+    static char *applied = NULL;
+    if (applied) {
+        if (strcmp(applied, path) == 0) return true;
+        fprintf(stderr, "Warning: --profile-use '%s' ignored: this process already applies '%s'\n", path, applied);
+        return false;
+    }
+    applied = xstrdup(path);
+    char flag[4096 + 32];
+    snprintf(flag, sizeof(flag), "-pgo-test-profile-file=%s", path);
+    set_llvm_flag(flag);
+    return true;
+}
+
+static void run_passes(CodegenContext *ctx, const char *passes) {
+    trace_begin("codegen", passes);
+    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef err = LLVMRunPasses(ctx->module, passes, ctx->machine, opts);
+    if (err) {
+        char *msg = LLVMGetErrorMessage(err);
+        ICE("Running '%s' failed: %s", passes, msg);
+    }
+    LLVMDisposePassBuilderOptions(opts);
+    trace_end();
+}
+
+/* The raw profile writer; `path_len` and `path` fill in the default file name. */
+static const char PROFILE_WRITER_IR[] =
+    "@__start___llvm_prf_data = external hidden global i8\n"
+    "@__stop___llvm_prf_data = external hidden global i8\n"
+    "@__start___llvm_prf_cnts = external hidden global i8\n"
+    "@__stop___llvm_prf_cnts = external hidden global i8\n"
+    "@__start___llvm_prf_names = external hidden global i8\n"
+    "@__stop___llvm_prf_names = external hidden global i8\n"
+    "@__llvm_profile_raw_version = external global i64\n"
+    "@__llvm_profile_runtime = weak hidden global i32 0\n"
+    "@newt.profile.path = private constant [%zu x i8] c\"%s\\00\"\n"
+    "@newt.profile.env = private constant [18 x i8] c\"LLVM_PROFILE_FILE\\00\"\n"
+    "@newt.profile.mode = private constant [3 x i8] c\"wb\\00\"\n"
+    "@newt.profile.zero = private constant [8 x i8] zeroinitializer\n"
+    "@llvm.global_dtors = appending global [1 x { i32, ptr, ptr }] [{ i32, ptr, ptr } { i32 0, ptr @newt.profile.write, ptr null }]\n"
+    "\n"
+    "declare ptr @getenv(ptr)\n"
+    "declare ptr @fopen(ptr, ptr)\n"
+    "declare i64 @fwrite(ptr, i64, i64, ptr)\n"
+    "declare i32 @fclose(ptr)\n"
+    "\n"
+    "define internal void @newt.profile.write() {\n"
+    "entry:\n"
+    "  %%env = call ptr @getenv(ptr @newt.profile.env)\n"
+    "  %%has_env = icmp ne ptr %%env, null\n"
+    "  %%path = select i1 %%has_env, ptr %%env, ptr @newt.profile.path\n"
+    "  %%file = call ptr @fopen(ptr %%path, ptr @newt.profile.mode)\n"
+    "  %%opened = icmp ne ptr %%file, null\n"
+    "  br i1 %%opened, label %%write, label %%done\n"
+    "write:\n"
+    "  %%data_begin = ptrtoint ptr @__start___llvm_prf_data to i64\n"
+    "  %%data_end = ptrtoint ptr @__stop___llvm_prf_data to i64\n"
+    "  %%cnts_begin = ptrtoint ptr @__start___llvm_prf_cnts to i64\n"
+    "  %%cnts_end = ptrtoint ptr @__stop___llvm_prf_cnts to i64\n"
+    "  %%names_begin = ptrtoint ptr @__start___llvm_prf_names to i64\n"
+    "  %%names_end = ptrtoint ptr @__stop___llvm_prf_names to i64\n"
+    "  %%data_bytes = sub i64 %%data_end, %%data_begin\n"
+    "  %%cnts_bytes = sub i64 %%cnts_end, %%cnts_begin\n"
+    "  %%names_bytes = sub i64 %%names_end, %%names_begin\n"
+    "  %%version = load i64, ptr @__llvm_profile_raw_version\n"
+    "  %%header = alloca [11 x i64]\n"
+    "  store i64 -41534659755609471, ptr %%header\n" // 0xff6c70726f667281: \377lprofr\201
+    "  %%h1 = getelementptr i64, ptr %%header, i64 1\n"
+    "  store i64 %%version, ptr %%h1\n"
+    "  %%h2 = getelementptr i64, ptr %%header, i64 2\n"
+    "  store i64 0, ptr %%h2\n"                          // BinaryIdsSize
+    "  %%h3 = getelementptr i64, ptr %%header, i64 3\n"
+    "  %%records = udiv i64 %%data_bytes, %d\n"
+    "  store i64 %%records, ptr %%h3\n"                  // DataSize (records)
+    "  %%h4 = getelementptr i64, ptr %%header, i64 4\n"
+    "  store i64 0, ptr %%h4\n"                          // PaddingBytesBeforeCounters
+    "  %%h5 = getelementptr i64, ptr %%header, i64 5\n"
+    "  %%counters = udiv i64 %%cnts_bytes, 8\n"
+    "  store i64 %%counters, ptr %%h5\n"                 // CountersSize (counters)
+    "  %%h6 = getelementptr i64, ptr %%header, i64 6\n"
+    "  store i64 0, ptr %%h6\n"                          // PaddingBytesAfterCounters
+    "  %%h7 = getelementptr i64, ptr %%header, i64 7\n"
+    "  store i64 %%names_bytes, ptr %%h7\n"              // NamesSize
+    "  %%h8 = getelementptr i64, ptr %%header, i64 8\n"
+    "  %%counters_delta = sub i64 %%cnts_begin, %%data_begin\n"
+    "  store i64 %%counters_delta, ptr %%h8\n"           // CountersDelta
+    "  %%h9 = getelementptr i64, ptr %%header, i64 9\n"
+    "  store i64 %%names_begin, ptr %%h9\n"              // NamesDelta
+    "  %%h10 = getelementptr i64, ptr %%header, i64 10\n"
+    "  store i64 %d, ptr %%h10\n"                        // ValueKindLast
+    "  call i64 @fwrite(ptr %%header, i64 1, i64 88, ptr %%file)\n"
+    "  call i64 @fwrite(ptr @__start___llvm_prf_data, i64 1, i64 %%data_bytes, ptr %%file)\n"
+    "  call i64 @fwrite(ptr @__start___llvm_prf_cnts, i64 1, i64 %%cnts_bytes, ptr %%file)\n"
+    "  call i64 @fwrite(ptr @__start___llvm_prf_names, i64 1, i64 %%names_bytes, ptr %%file)\n"
+    "  %%neg_names = sub i64 0, %%names_bytes\n"
+    "  %%padding = and i64 %%neg_names, 7\n"
+    "  call i64 @fwrite(ptr @newt.profile.zero, i64 1, i64 %%padding, ptr %%file)\n"
+    "  call i32 @fclose(ptr %%file)\n"
+    "  br label %%done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n";
+
+static void link_profile_writer(CodegenContext *ctx, const char *path) {
+    // The default path goes into a c"..." literal: escape what IR would not take as is
+    size_t cap = strlen(path) * 3 + 1, len = 0, bytes = 0;
+    char *escaped = xmalloc(cap);
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++, bytes++) {
+        if (*p < 0x20 || *p >= 0x7f || *p == '"' || *p == '\\') len += (size_t)snprintf(escaped + len, cap - len, "\\%02X", *p);
+        else escaped[len++] = (char)*p;
+    }
+    escaped[len] = '\0';
+
+    size_t size = sizeof(PROFILE_WRITER_IR) + len + 64;
+    char *ir = xmalloc(size);
+    snprintf(ir, size, PROFILE_WRITER_IR, bytes + 1, escaped, PROFILE_DATA_RECORD_BYTES, PROFILE_VALUE_KIND_LAST);
+    free(escaped);
+
+    LLVMMemoryBufferRef buf = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir, strlen(ir), "newt_profile_writer");
+    free(ir);
+    LLVMModuleRef writer = NULL;
+    char *msg = NULL;
+    if (LLVMParseIRInContext(ctx->context, buf, &writer, &msg) != 0) {
+        ICE("Profile writer IR does not parse: %s", msg ? msg : "?");
+    }
+    LLVMSetTarget(writer, LLVMGetTarget(ctx->module));
+    LLVMSetModuleDataLayout(writer, ctx->target_data);
+    if (LLVMLinkModules2(ctx->module, writer) != 0) ICE("Failed to link the profile writer");
+}
+
+void codegen_profile_program(CodegenContext *ctx) {
+    Options *opts = ctx->loader ? ctx->loader->opts : NULL;
+    if (!opts) return;
+
+    if (opts->profile_generate) {
+#if LLVM_VERSION_MAJOR > 16
+        fprintf(stderr, "Warning: --profile-generate does not know the raw profile format of LLVM %d\n", LLVM_VERSION_MAJOR);
+        return;
+#endif
+        set_instrumentation_flags();
+        run_passes(ctx, "pgo-instr-gen,instrprof");
+        link_profile_writer(ctx, opts->profile_generate);
+    } else if (opts->profile_use) {
+        set_instrumentation_flags();
+        if (use_profile_file(opts->profile_use)) run_passes(ctx, "pgo-instr-use");
+    }
+}
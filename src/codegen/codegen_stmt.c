@@ -1,11 +1,120 @@
 #include "codegen_internal.h"
 #include "dynamic_array.h"
+#include <llvm-c/DebugInfo.h>
+
+/*
+ * Deferred statements run at every exit of their block: falling off its end,
+ * and each return, break or continue that leaves it. A small body is emitted
+ * again at each of those edges, so exits stay straight-line code. A body
+ * above DEFER_CLONE_MAX_NAMES is emitted once, when its block closes; each
+ * exit stores its id in the defer's dest_var, jumps there, and the body ends
+ * in a switch back to where that exit continues.
+ */
+#define DEFER_CLONE_MAX_NAMES 8 // Names the body refers to (about two calls)
 
 typedef struct {
     AstNode *body;
-    LLVMBasicBlockRef bb;
+    size_t locals_mark;     // The bindings the body sees
+    bool shared;
+    LLVMBasicBlockRef bb;   // shared: the body
+    LLVMValueRef dest_var;  // shared: id of the exit being taken
+    DynArray exits;         // shared: DynArray<LLVMBasicBlockRef>, continuation of each exit id
 } DeferInfo;
 
+static void count_name(InternResult *name, void *user) {
+    (void)name;
+    (*(size_t*)user)++;
+}
+
+static bool defer_is_shared(AstNode *body) {
+    size_t names = 0;
+    ast_visit_names(body, count_name, &names);
+    return names > DEFER_CLONE_MAX_NAMES;
+}
+
+/*
+ * Emit the body of deferred_actions[index] at the insertion point: with the
+ * bindings of where it was deferred, the defers below it as the ones a
+ * return inside it runs, and no loop for a break to leave.
+ */
+static void emit_defer_body(CodegenContext *ctx, size_t index) {
+    DynArray *pending = ctx->deferred_actions;
+    DeferInfo *info = DYNARRAY_AT(DeferInfo*, pending, index);
+
+    DynArray outer;
+    dynarray_init(&outer, sizeof(DeferInfo*));
+    for (size_t i = 0; i < index; i++) dynarray_push_value(&outer, &DYNARRAY_AT(DeferInfo*, pending, i));
+
+    LLVMBasicBlockRef loop_cond = ctx->loop_cond_bb, loop_end = ctx->loop_end_bb;
+    size_t loop_defers = ctx->loop_defer_count;
+    ctx->deferred_actions = &outer;
+    ctx->loop_cond_bb = ctx->loop_end_bb = NULL;
+    size_t top = codegen_locals_rewind(ctx, info->locals_mark);
+    size_t locals_mark = codegen_locals_enter(ctx);
+
+    codegen_statement(ctx, info->body);
+
+    codegen_locals_leave(ctx, locals_mark);
+    codegen_locals_replay(ctx, info->locals_mark, top);
+    ctx->deferred_actions = pending;
+    ctx->loop_cond_bb = loop_cond;
+    ctx->loop_end_bb = loop_end;
+    ctx->loop_defer_count = loop_defers;
+    dynarray_free(&outer);
+}
+
+/* Run the pending defers above `down_to`, innermost first, on the way out of their blocks. */
+static void emit_scope_exit(CodegenContext *ctx, size_t down_to) {
+    for (size_t i = ctx->deferred_actions->count; i-- > down_to; ) {
+        LLVMBasicBlockRef from = LLVMGetInsertBlock(ctx->builder);
+        if (LLVMGetBasicBlockTerminator(from)) return; // A return inside a deferred body
+        DeferInfo *info = DYNARRAY_AT(DeferInfo*, ctx->deferred_actions, i);
+        if (!info->shared) {
+            emit_defer_body(ctx, i);
+            continue;
+        }
+
+        LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+        if (!info->dest_var) info->dest_var = create_entry_block_alloca(ctx, i32, "defer_dest");
+        LLVMBuildStore(ctx->builder, LLVMConstInt(i32, info->exits.count, 0), info->dest_var);
+        LLVMBuildBr(ctx->builder, info->bb);
+
+        LLVMBasicBlockRef cont = LLVMAppendBasicBlockInContext(ctx->context, LLVMGetBasicBlockParent(from), "defer.cont");
+        dynarray_push_value(&info->exits, &cont);
+        LLVMPositionBuilderAtEnd(ctx->builder, cont);
+    }
+}
+
+/* Emit a shared body once its block has closed: every exit through it is known. */
+static void close_shared_defer(CodegenContext *ctx, size_t index) {
+    DeferInfo *info = DYNARRAY_AT(DeferInfo*, ctx->deferred_actions, index);
+    if (info->exits.count == 0) {
+        LLVMDeleteBasicBlock(info->bb);
+        return;
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, info->bb);
+    emit_defer_body(ctx, index);
+    if (LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) return;
+
+    LLVMBasicBlockRef *exits = (LLVMBasicBlockRef*)info->exits.data;
+    if (info->exits.count == 1) {
+        LLVMBuildBr(ctx->builder, exits[0]);
+        return;
+    }
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+    LLVMValueRef dest = LLVMBuildLoad2(ctx->builder, i32, info->dest_var, "dest");
+    LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, dest, exits[0], (unsigned)info->exits.count - 1);
+    for (size_t i = 1; i < info->exits.count; i++) LLVMAddCase(sw, LLVMConstInt(i32, i, 0), exits[i]);
+}
+
+static bool shared_defer_pending(CodegenContext *ctx) {
+    DYNARRAY_FOREACH(DeferInfo*, info_it, ctx->deferred_actions) {
+        if ((*info_it)->shared) return true;
+    }
+    return false;
+}
+
 static LLVMValueRef coerce_to_bool(CodegenContext *ctx, LLVMValueRef val) {
     LLVMTypeRef ty = LLVMTypeOf(val);
     LLVMTypeKind kind = LLVMGetTypeKind(ty);
@@ -25,6 +134,131 @@ static LLVMValueRef coerce_to_bool(CodegenContext *ctx, LLVMValueRef val) {
     return val;
 }
 
+/* The result as the C ABI returns it (codegen_abi.c). */
+static LLVMValueRef codegen_return_value(CodegenContext *ctx, LLVMValueRef val) {
+    const AbiSignature *sig = codegen_abi_signature(ctx, ctx->current_func_type);
+    return sig->ret.kind == ABI_COERCE ? codegen_abi_coerce(ctx, val, sig->ret.coerce) : val;
+}
+
+static LLVMMetadataRef loop_property(CodegenContext *ctx, const char *name, LLVMValueRef value) {
+    LLVMMetadataRef ops[2] = { LLVMMDStringInContext2(ctx->context, name, strlen(name)), NULL };
+    if (value) ops[1] = LLVMValueAsMetadata(value);
+    return LLVMMDNodeInContext2(ctx->context, ops, value ? 2 : 1);
+}
+
+/* The llvm.loop node for `hints`: !{self, properties...}, or NULL without any hint. */
+static LLVMValueRef loop_metadata(CodegenContext *ctx, const LoopHints *hints) {
+    if (!hints->unroll && !hints->vectorize && !hints->nounroll) return NULL;
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(ctx->context);
+    LLVMMetadataRef ops[4];
+    size_t n = 0;
+    LLVMMetadataRef self = LLVMTemporaryMDNode(ctx->context, NULL, 0);
+    ops[n++] = self;
+    if (hints->unroll) ops[n++] = loop_property(ctx, "llvm.loop.unroll.count", LLVMConstInt(i32, hints->unroll, 0));
+    if (hints->nounroll) ops[n++] = loop_property(ctx, "llvm.loop.unroll.disable", NULL);
+    if (hints->vectorize) {
+        // Width 1 is how LLVM spells "do not vectorize"
+        ops[n++] = loop_property(ctx, "llvm.loop.vectorize.width", LLVMConstInt(i32, hints->vectorize, 0));
+        if (hints->vectorize > 1) {
+            ops[n++] = loop_property(ctx, "llvm.loop.vectorize.enable", LLVMConstInt(LLVMInt1TypeInContext(ctx->context), 1, 0));
+        }
+    }
+    LLVMMetadataRef node = LLVMMDNodeInContext2(ctx->context, ops, n);
+    LLVMMetadataReplaceAllUsesWith(self, node);
+    return LLVMMetadataAsValue(ctx->context, node);
+}
+
+/*
+ * Attach the llvm.loop node to every latch: each terminator in the function
+ * that jumps to `header`, other than `entry`, the jump into the loop. LLVM
+ * drops the hints unless all latches (a continue makes one more) carry them.
+ */
+static void tag_loop_latches(CodegenContext *ctx, LLVMBasicBlockRef header, LLVMValueRef entry, const LoopHints *hints) {
+    LLVMValueRef md = loop_metadata(ctx, hints);
+    if (!md) return;
+    unsigned kind = LLVMGetMDKindIDInContext(ctx->context, "llvm.loop", 9);
+    LLVMValueRef func = LLVMGetBasicBlockParent(header);
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef term = LLVMGetBasicBlockTerminator(bb);
+        if (!term || term == entry) continue;
+        unsigned succs = LLVMGetNumSuccessors(term);
+        for (unsigned i = 0; i < succs; i++) {
+            if (LLVMGetSuccessor(term, i) == header) {
+                LLVMSetMetadata(term, kind, md);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * for (x in range): the range is evaluated once and its length hoisted. A
+ * usize index walks it and each element is copied into x through an
+ * inbounds GEP, the counted form the vectorizer recognizes.
+ */
+static void codegen_range_for(CodegenContext *ctx, AstNode *stmt) {
+    AstForStatement *fst = &stmt->data.for_statement;
+    LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+    Type *range_type = fst->range->type;
+    LLVMTypeRef elem_ty = get_llvm_type(ctx, fst->init->type);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(ctx->context);
+
+    size_t locals_mark = codegen_locals_enter(ctx);
+    LLVMValueRef range = codegen_expr(ctx, fst->range); // An array is its address
+    LLVMValueRef base, len;
+    if (range_type->kind == TYPE_ARRAY) {
+        base = range;
+        len = LLVMConstInt(i64, (unsigned long long)range_type->as.array.size, 0);
+    } else {
+        base = LLVMBuildExtractValue(ctx->builder, range, 0, "range.ptr");
+        len = LLVMBuildExtractValue(ctx->builder, range, 1, "range.len");
+    }
+    codegen_statement(ctx, fst->init);
+    LLVMValueRef var = codegen_locals_get(ctx, fst->init->data.variable_declaration.intern_result->entry->dense_index);
+    LLVMValueRef idx = create_entry_block_alloca(ctx, i64, "range.idx");
+    LLVMBuildStore(ctx->builder, LLVMConstInt(i64, 0, 0), idx);
+
+    LLVMBasicBlockRef cond_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "range.cond");
+    LLVMBasicBlockRef body_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "range.body");
+    LLVMBasicBlockRef post_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "range.post");
+    LLVMBasicBlockRef end_bb  = LLVMAppendBasicBlockInContext(ctx->context, func, "range.end");
+
+    LLVMValueRef entry = LLVMBuildBr(ctx->builder, cond_bb);
+    LLVMPositionBuilderAtEnd(ctx->builder, cond_bb);
+    LLVMValueRef i = LLVMBuildLoad2(ctx->builder, i64, idx, "range.i");
+    LLVMBuildCondBr(ctx->builder, LLVMBuildICmp(ctx->builder, LLVMIntULT, i, len, "range.more"), body_bb, end_bb);
+
+    LLVMBasicBlockRef old_cond = ctx->loop_cond_bb;
+    LLVMBasicBlockRef old_end  = ctx->loop_end_bb;
+
+    size_t old_defers = ctx->loop_defer_count;
+    ctx->loop_cond_bb = post_bb;
+    ctx->loop_end_bb  = end_bb;
+    ctx->loop_defer_count = ctx->deferred_actions->count;
+
+    LLVMPositionBuilderAtEnd(ctx->builder, body_bb);
+    LLVMValueRef elem = LLVMBuildInBoundsGEP2(ctx->builder, elem_ty, base, &i, 1, "range.elem");
+    LLVMBuildStore(ctx->builder, LLVMBuildLoad2(ctx->builder, elem_ty, elem, "range.val"), var);
+    codegen_statement(ctx, fst->body);
+    if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)))
+        LLVMBuildBr(ctx->builder, post_bb);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, post_bb);
+    LLVMValueRef next = LLVMBuildNUWAdd(ctx->builder, LLVMBuildLoad2(ctx->builder, i64, idx, "range.i"),
+                                        LLVMConstInt(i64, 1, 0), "range.next");
+    LLVMBuildStore(ctx->builder, next, idx);
+    LLVMBuildBr(ctx->builder, cond_bb);
+    tag_loop_latches(ctx, cond_bb, entry, &fst->hints);
+
+    ctx->loop_cond_bb = old_cond;
+    ctx->loop_end_bb  = old_end;
+    ctx->loop_defer_count = old_defers;
+
+    LLVMPositionBuilderAtEnd(ctx->builder, end_bb);
+    codegen_locals_leave(ctx, locals_mark);
+}
+
+
 void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
     if (!stmt) return;
     
@@ -39,6 +273,7 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             case AST_IF_STATEMENT:
             case AST_WHILE_STATEMENT:
             case AST_FOR_STATEMENT:
+            case AST_SWITCH_STATEMENT:
             case AST_RETURN_STATEMENT:
             case AST_BREAK_STATEMENT:
             case AST_CONTINUE_STATEMENT:
@@ -53,94 +288,33 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
     switch (stmt->node_type) {
         case AST_BLOCK: {
             DynArray *stmts = stmt->data.block.statements;
-            ctx->locals = codegen_map_create(ctx, ctx->locals);
+            size_t locals_mark = codegen_locals_enter(ctx);
             
             size_t previous_defer_count = ctx->deferred_actions->count;
-            LLVMBasicBlockRef prev_cleanup = ctx->current_cleanup_bb;
 
-            for (size_t i = 0; i < stmts->count; i++) {
-                AstNode *s = *(AstNode**)dynarray_get(stmts, i);
+            DYNARRAY_FOREACH(AstNode*, s_it, stmts) {
+                AstNode *s = *s_it;
                 codegen_statement(ctx, s);
             }
 
             size_t current_defer_count = ctx->deferred_actions->count;
-
             if (current_defer_count > previous_defer_count) {
-                LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
-                LLVMBasicBlockRef after_cleanup_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "after_cleanup");
-
                 current_block = LLVMGetInsertBlock(ctx->builder);
-                if (current_block && !LLVMGetBasicBlockTerminator(current_block)) {
-                    LLVMBuildStore(ctx->builder, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 3, 0), ctx->exit_dest_var);
-                    LLVMBuildBr(ctx->builder, ctx->current_cleanup_bb);
-                }
-
-                for (int i = (int)current_defer_count - 1; i >= (int)previous_defer_count; i--) {
-                    DeferInfo *info = *(DeferInfo**)dynarray_get(ctx->deferred_actions, i);
-                    LLVMPositionBuilderAtEnd(ctx->builder, info->bb);
-
-                    LLVMBasicBlockRef target_next = (i == (int)previous_defer_count) 
-                                                  ? after_cleanup_bb 
-                                                  : (*(DeferInfo**)dynarray_get(ctx->deferred_actions, i - 1))->bb;
-                    
-                    ctx->current_cleanup_bb = target_next;
-                    codegen_statement(ctx, info->body);
-
-                    LLVMBasicBlockRef curr_clean = LLVMGetInsertBlock(ctx->builder);
-                    if (curr_clean && !LLVMGetBasicBlockTerminator(curr_clean)) {
-                        LLVMBuildBr(ctx->builder, ctx->current_cleanup_bb);
-                    }
-                }
-
-                LLVMPositionBuilderAtEnd(ctx->builder, after_cleanup_bb);
-                LLVMValueRef dest = LLVMBuildLoad2(ctx->builder, LLVMInt32TypeInContext(ctx->context), ctx->exit_dest_var, "dest");
-                LLVMBasicBlockRef natural_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "natural");
-                LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, dest, natural_bb, 3);
-
-                if (prev_cleanup) {
-                    LLVMAddCase(sw, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0), prev_cleanup);
-                } else {
-                    LLVMBasicBlockRef ret_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "ret");
-                    LLVMAddCase(sw, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0), ret_bb);
-                    LLVMPositionBuilderAtEnd(ctx->builder, ret_bb);
-
-                    bool sret = type_is_indirect(ctx, ctx->current_func_type->as.func.return_type);
-                    if (sret) {
-                        LLVMBuildRetVoid(ctx->builder);
-                    } else if (ctx->ret_val_var) {
-                        LLVMValueRef final_ret = codegen_load_value(ctx, ctx->ret_val_var, ctx->current_func_type->as.func.return_type);
-                        LLVMBuildRet(ctx->builder, final_ret);
-                    } else {
-                        LLVMBuildRetVoid(ctx->builder);
-                    }
-                }
-
-                if (ctx->loop_end_bb) {
-                    LLVMBasicBlockRef next_bb = prev_cleanup ? prev_cleanup : ctx->loop_end_bb;
-                    LLVMAddCase(sw, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 1, 0), next_bb);
-                }
-
-                if (ctx->loop_cond_bb) {
-                    LLVMBasicBlockRef next_bb = prev_cleanup ? prev_cleanup : ctx->loop_cond_bb;
-                    LLVMAddCase(sw, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 2, 0), next_bb);
-                }
-
-                LLVMPositionBuilderAtEnd(ctx->builder, natural_bb);
-                
-                // Cleanup allocated DeferInfos for this block
-                for (size_t i = previous_defer_count; i < current_defer_count; i++) {
-                    free(*(DeferInfo**)dynarray_get(ctx->deferred_actions, i));
+                if (!LLVMGetBasicBlockTerminator(current_block)) emit_scope_exit(ctx, previous_defer_count);
+                LLVMBasicBlockRef natural_bb = LLVMGetInsertBlock(ctx->builder);
+
+                // Innermost first: a return in a shared body may still pass through the ones around it
+                for (size_t i = current_defer_count; i-- > previous_defer_count; ) {
+                    DeferInfo *info = DYNARRAY_AT(DeferInfo*, ctx->deferred_actions, i);
+                    if (info->shared) close_shared_defer(ctx, i);
+                    dynarray_free(&info->exits);
+                    free(info);
                 }
                 ctx->deferred_actions->count = previous_defer_count;
-
-            } else {
-                // No defers, just continue
+                LLVMPositionBuilderAtEnd(ctx->builder, natural_bb);
             }
 
-            ctx->current_cleanup_bb = prev_cleanup;
-            CodegenMap *old = ctx->locals;
-            ctx->locals = old->parent;
-            codegen_map_destroy(old);
+            codegen_locals_leave(ctx, locals_mark);
             break;
         }
 
@@ -169,6 +343,41 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             break;
         }
 
+        case AST_SWITCH_STATEMENT: {
+            // One switch instruction: the backend picks a jump table, a bit test or a compare tree
+            AstSwitchStatement *sw = &stmt->data.switch_statement;
+            LLVMValueRef subject = codegen_expr(ctx, sw->subject);
+            LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
+
+            LLVMBasicBlockRef end_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "switch.end");
+            LLVMBasicBlockRef default_bb = end_bb;
+            if (sw->else_body) default_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "switch.else");
+
+            unsigned value_count = 0;
+            DYNARRAY_FOREACH(AstNode*, arm_it, sw->cases) value_count += (unsigned)(*arm_it)->data.switch_case.values->count;
+            LLVMValueRef inst = LLVMBuildSwitch(ctx->builder, subject, default_bb, value_count);
+
+            DYNARRAY_FOREACH(AstNode*, arm_it, sw->cases) {
+                AstSwitchCase *arm = &(*arm_it)->data.switch_case;
+                LLVMBasicBlockRef arm_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "switch.case");
+                DYNARRAY_FOREACH(AstNode*, value_it, arm->values) LLVMAddCase(inst, codegen_expr(ctx, *value_it), arm_bb);
+
+                LLVMPositionBuilderAtEnd(ctx->builder, arm_bb);
+                codegen_statement(ctx, arm->body);
+                if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)))
+                    LLVMBuildBr(ctx->builder, end_bb);
+            }
+            if (sw->else_body) {
+                LLVMPositionBuilderAtEnd(ctx->builder, default_bb);
+                codegen_statement(ctx, sw->else_body);
+                if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)))
+                    LLVMBuildBr(ctx->builder, end_bb);
+            }
+
+            LLVMPositionBuilderAtEnd(ctx->builder, end_bb);
+            break;
+        }
+
         case AST_WHILE_STATEMENT: {
             AstWhileStatement *whl = &stmt->data.while_statement;
             LLVMValueRef func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
@@ -177,7 +386,7 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             LLVMBasicBlockRef body_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "while.body");
             LLVMBasicBlockRef end_bb  = LLVMAppendBasicBlockInContext(ctx->context, func, "while.end");
 
-            LLVMBuildBr(ctx->builder, cond_bb);
+            LLVMValueRef entry = LLVMBuildBr(ctx->builder, cond_bb);
             LLVMPositionBuilderAtEnd(ctx->builder, cond_bb);
 
             LLVMValueRef cond = coerce_to_bool(ctx, codegen_expr(ctx, whl->condition));
@@ -186,16 +395,20 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             LLVMBasicBlockRef old_cond = ctx->loop_cond_bb;
             LLVMBasicBlockRef old_end  = ctx->loop_end_bb;
 
+            size_t old_defers = ctx->loop_defer_count;
             ctx->loop_cond_bb = cond_bb;
             ctx->loop_end_bb  = end_bb;
+            ctx->loop_defer_count = ctx->deferred_actions->count;
 
             LLVMPositionBuilderAtEnd(ctx->builder, body_bb);
             codegen_statement(ctx, whl->body);
             if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)))
                 LLVMBuildBr(ctx->builder, cond_bb);
+            tag_loop_latches(ctx, cond_bb, entry, &whl->hints);
 
             ctx->loop_cond_bb = old_cond;
             ctx->loop_end_bb  = old_end;
+            ctx->loop_defer_count = old_defers;
 
             LLVMPositionBuilderAtEnd(ctx->builder, end_bb);
             break;
@@ -203,9 +416,13 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
 
         case AST_FOR_STATEMENT: {
             AstForStatement *fst  = &stmt->data.for_statement;
+            if (fst->range) {
+                codegen_range_for(ctx, stmt);
+                break;
+            }
             LLVMValueRef     func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder));
 
-            ctx->locals = codegen_map_create(ctx, ctx->locals);
+            size_t locals_mark = codegen_locals_enter(ctx);
             if (fst->init) codegen_statement(ctx, fst->init);
 
             LLVMBasicBlockRef cond_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "for.cond");
@@ -213,7 +430,7 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             LLVMBasicBlockRef post_bb = LLVMAppendBasicBlockInContext(ctx->context, func, "for.post");
             LLVMBasicBlockRef end_bb  = LLVMAppendBasicBlockInContext(ctx->context, func, "for.end");
 
-            LLVMBuildBr(ctx->builder, cond_bb);
+            LLVMValueRef entry = LLVMBuildBr(ctx->builder, cond_bb);
             LLVMPositionBuilderAtEnd(ctx->builder, cond_bb);
 
             if (fst->condition) {
@@ -226,8 +443,10 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             LLVMBasicBlockRef old_cond = ctx->loop_cond_bb;
             LLVMBasicBlockRef old_end  = ctx->loop_end_bb;
 
+            size_t old_defers = ctx->loop_defer_count;
             ctx->loop_cond_bb = post_bb;
             ctx->loop_end_bb  = end_bb;
+            ctx->loop_defer_count = ctx->deferred_actions->count;
 
             LLVMPositionBuilderAtEnd(ctx->builder, body_bb);
             codegen_statement(ctx, fst->body);
@@ -238,23 +457,44 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             if (fst->post) codegen_expr(ctx, fst->post);
             if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)))
                 LLVMBuildBr(ctx->builder, cond_bb);
+            tag_loop_latches(ctx, cond_bb, entry, &fst->hints);
 
             ctx->loop_cond_bb = old_cond;
             ctx->loop_end_bb  = old_end;
+            ctx->loop_defer_count = old_defers;
 
             LLVMPositionBuilderAtEnd(ctx->builder, end_bb);
-            CodegenMap *old = ctx->locals;
-            ctx->locals = old->parent;
-            codegen_map_destroy(old);
+            codegen_locals_leave(ctx, locals_mark);
             break;
         }
 
         case AST_RETURN_STATEMENT: {
             Type *fn_type = ctx->current_func_type;
             if (!fn_type) ICE("Return statement outside of function context.");
+
+            AstNode *ret_expr = stmt->data.return_statement.expression;
+            if (ret_expr && ret_expr->node_type == AST_INTRINSIC && ret_expr->data.intrinsic.kind == INTRINSIC_TAIL) {
+                codegen_tail_call(ctx, ret_expr); // Sema saw to it that no defer is pending
+                break;
+            }
             
+            // A result in memory is built in the caller's slot: the named result
+            // already lives there, and a call or struct literal writes it in place
+            bool in_place = false;
+            if (ctx->sret_ptr && ret_expr) {
+                Symbol *sym = ret_expr->node_type == AST_IDENTIFIER ? ret_expr->data.identifier.symbol : NULL;
+                if (ctx->sret_local && sym && sym->decl_node == ctx->sret_local) {
+                    in_place = true;
+                } else if (ret_expr->type == fn_type->as.func.return_type && codegen_call_into(ctx, ret_expr, ctx->sret_ptr)) {
+                    in_place = true;
+                } else if (ret_expr->node_type == AST_STRUCT_LITERAL && ret_expr->type == fn_type->as.func.return_type) {
+                    codegen_struct_literal_into(ctx, ret_expr, ctx->sret_ptr);
+                    in_place = true;
+                }
+            }
+
             LLVMValueRef retval = NULL;
-            if (stmt->data.return_statement.expression) {
+            if (ret_expr && !in_place) {
                 retval = codegen_expr(ctx, stmt->data.return_statement.expression);
                 if (!retval) {
                     LLVMTypeRef ty = get_llvm_type(ctx, stmt->data.return_statement.expression->type);
@@ -263,49 +503,43 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
                 }
             }
 
-            bool sret = type_is_indirect(ctx, fn_type->as.func.return_type);
-            if (sret) {
-                if (retval) LLVMBuildStore(ctx->builder, retval, ctx->sret_ptr);
-            } else if (retval && ctx->ret_val_var) {
-                LLVMBuildStore(ctx->builder, retval, ctx->ret_val_var);
+            // An async fn leaves its result in its frame (codegen_async.c)
+            if (ctx->async_frame) {
+                if (retval) codegen_store_value(ctx, retval, ctx->ret_val_var, fn_type->as.func.return_type);
+                emit_scope_exit(ctx, 0);
+                if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) codegen_async_return(ctx);
+                break;
             }
 
-            LLVMBuildStore(ctx->builder, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 0, 0), ctx->exit_dest_var);
+            bool sret = ctx->sret_ptr != NULL;
+            if (sret && retval) codegen_store_value(ctx, retval, ctx->sret_ptr, ctx->current_func_type->as.func.return_type);
 
-            if (ctx->current_cleanup_bb) {
-                LLVMBuildBr(ctx->builder, ctx->current_cleanup_bb);
-            } else {
-                if (sret) {
-                    LLVMBuildRetVoid(ctx->builder);
-                } else if (retval) {
-                    LLVMBuildRet(ctx->builder, retval);
-                } else {
-                    LLVMBuildRetVoid(ctx->builder);
-                }
+            // The value is taken before the defers run; it only needs a slot if a shared body is on the way
+            if (ctx->deferred_actions->count > 0) {
+                bool spill = !sret && retval && ctx->ret_val_var && shared_defer_pending(ctx);
+                if (spill) LLVMBuildStore(ctx->builder, retval, ctx->ret_val_var);
+                emit_scope_exit(ctx, 0);
+                if (LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) break;
+                if (spill) retval = codegen_load_value(ctx, ctx->ret_val_var, fn_type->as.func.return_type);
             }
-            break;
-        }
 
-        case AST_BREAK_STATEMENT: {
-            if (ctx->loop_end_bb) {
-                LLVMBuildStore(ctx->builder, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 1, 0), ctx->exit_dest_var);
-                if (ctx->current_cleanup_bb) {
-                    LLVMBuildBr(ctx->builder, ctx->current_cleanup_bb);
-                } else {
-                    LLVMBuildBr(ctx->builder, ctx->loop_end_bb);
-                }
+            if (sret) {
+                LLVMBuildRetVoid(ctx->builder);
+            } else if (retval) {
+                LLVMBuildRet(ctx->builder, codegen_return_value(ctx, retval));
+            } else {
+                LLVMBuildRetVoid(ctx->builder);
             }
             break;
         }
 
+        case AST_BREAK_STATEMENT:
         case AST_CONTINUE_STATEMENT: {
-            if (ctx->loop_cond_bb) {
-                LLVMBuildStore(ctx->builder, LLVMConstInt(LLVMInt32TypeInContext(ctx->context), 2, 0), ctx->exit_dest_var);
-                if (ctx->current_cleanup_bb) {
-                    LLVMBuildBr(ctx->builder, ctx->current_cleanup_bb);
-                } else {
-                    LLVMBuildBr(ctx->builder, ctx->loop_cond_bb);
-                }
+            // Only the defers inside the loop body run
+            LLVMBasicBlockRef target = stmt->node_type == AST_BREAK_STATEMENT ? ctx->loop_end_bb : ctx->loop_cond_bb;
+            if (target) {
+                emit_scope_exit(ctx, ctx->loop_defer_count);
+                if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) LLVMBuildBr(ctx->builder, target);
             }
             break;
         }
@@ -314,16 +548,22 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
             AstVariableDeclaration *vdecl = &stmt->data.variable_declaration;
             if (!stmt->type) ICE_AT(stmt, "Variable declaration missing type.");
 
+            // The named result of an sret function lives in the caller's slot
             LLVMTypeRef  ty    = get_llvm_type(ctx, stmt->type);
-            LLVMValueRef alloca = create_entry_block_alloca(ctx, ty, "var");
+            LLVMValueRef alloca = stmt == ctx->sret_local ? ctx->sret_ptr : create_entry_block_alloca(ctx, ty, "var");
 
             if (vdecl->intern_result) {
-                void *key = (void*)(intptr_t)(vdecl->intern_result->entry->dense_index + 1);
-                codegen_map_put(ctx->locals, key, alloca);
+                codegen_locals_put(ctx, vdecl->intern_result->entry->dense_index, alloca);
             }
-            if (vdecl->initializer) {
+            if (vdecl->initializer && vdecl->initializer->node_type == AST_INITIALIZER_LIST && vdecl->initializer->type->kind == TYPE_ARRAY) {
+                codegen_initializer_into(ctx, vdecl->initializer, alloca);
+            } else if (vdecl->initializer && vdecl->initializer->type == stmt->type && codegen_call_into(ctx, vdecl->initializer, alloca)) {
+                // The callee wrote the value into the variable
+            } else if (vdecl->initializer && vdecl->initializer->node_type == AST_STRUCT_LITERAL && vdecl->initializer->type == stmt->type) {
+                codegen_struct_literal_into(ctx, vdecl->initializer, alloca);
+            } else if (vdecl->initializer) {
                 LLVMValueRef init_val = codegen_expr(ctx, vdecl->initializer);
-                if (init_val) LLVMBuildStore(ctx->builder, init_val, alloca);
+                if (init_val) codegen_store_value(ctx, init_val, alloca, stmt->type);
             }
             break;
         }
@@ -336,10 +576,12 @@ void codegen_statement(CodegenContext *ctx, AstNode *stmt) {
         case AST_DEFER_STATEMENT: {
             DeferInfo *info = xmalloc(sizeof(DeferInfo));
             info->body = stmt->data.defer_statement.body;
-            info->bb = LLVMAppendBasicBlockInContext(ctx->context, LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder)), "defer_bb");
-            
+            info->locals_mark = codegen_locals_enter(ctx);
+            info->shared = defer_is_shared(info->body);
+            info->bb = info->shared ? LLVMAppendBasicBlockInContext(ctx->context, LLVMGetBasicBlockParent(LLVMGetInsertBlock(ctx->builder)), "defer_bb") : NULL;
+            info->dest_var = NULL;
+            dynarray_init(&info->exits, sizeof(LLVMBasicBlockRef));
             dynarray_push_value(ctx->deferred_actions, &info);
-            ctx->current_cleanup_bb = info->bb;
             break;
         }
 
@@ -1,66 +1,179 @@
 #include "codegen_internal.h"
+#include "sema/type_layout.h"
 
-LLVMTypeRef get_llvm_function_type(CodegenContext *ctx, Type *t) {
-    if (!t || t->kind != TYPE_FUNCTION) return LLVMFunctionType(LLVMVoidTypeInContext(ctx->context), NULL, 0, 0);
+bool type_is_address_only(Type *t) {
+    if (!t) ICE("type_is_address_only: NULL type reached codegen");
+    switch (t->kind) {
+        case TYPE_ARRAY:    return true;                         // [N]T lives at its address
+        case TYPE_SLICE:    return false;                        // T[] (slice) is loaded as a value
+        case TYPE_VOID:     return true;                         // nothing to load
+        default:            return false;                        // primitives, pointers, structs -> load by value
+    }
+}
 
-    bool sret = type_is_indirect(ctx, t->as.func.return_type);
-    LLVMTypeRef ret_type = sret ? LLVMVoidTypeInContext(ctx->context) : get_llvm_type(ctx, t->as.func.return_type);
-    
-    size_t param_count = t->as.func.param_count;
-    size_t llvm_arg_count = param_count + (sret ? 1 : 0);
-    LLVMTypeRef *llvm_params = xmalloc(sizeof(LLVMTypeRef) * llvm_arg_count);
+LLVMValueRef codegen_load_value(CodegenContext *ctx, LLVMValueRef ptr, Type *type) {
+    if (!ptr) ICE("codegen_load_value: NULL lvalue for type kind %d", type ? type->kind : -1);
+    if (type_is_address_only(type)) return ptr;
+    LLVMValueRef load = LLVMBuildLoad2(ctx->builder, get_llvm_type(ctx, type), ptr, "loadtmp");
+    codegen_tbaa(ctx, load, type);
+    return load;
+}
 
-    size_t idx = 0;
-    if (sret) {
-        llvm_params[idx++] = LLVMPointerType(get_llvm_type(ctx, t->as.func.return_type), 0);
+void codegen_store_value(CodegenContext *ctx, LLVMValueRef val, LLVMValueRef ptr, Type *type) {
+    if (type && type->kind == TYPE_ARRAY && LLVMGetTypeKind(LLVMTypeOf(val)) == LLVMPointerTypeKind) {
+        LLVMTypeRef ty = get_llvm_type(ctx, type);
+        unsigned align = LLVMABIAlignmentOfType(ctx->target_data, ty);
+        LLVMValueRef bytes = LLVMConstInt(LLVMInt64TypeInContext(ctx->context), LLVMABISizeOfType(ctx->target_data, ty), 0);
+        LLVMBuildMemCpy(ctx->builder, ptr, align, val, align, bytes);
+        return;
     }
+    codegen_tbaa(ctx, LLVMBuildStore(ctx->builder, val, ptr), type);
+}
 
-    for (size_t i = 0; i < param_count; i++) {
-        Type *param_ty = t->as.func.params[i];
-        if (type_is_indirect(ctx, param_ty)) {
-            llvm_params[idx++] = LLVMPointerType(get_llvm_type(ctx, param_ty), 0);
-        } else {
-            llvm_params[idx++] = get_llvm_type(ctx, param_ty);
+/*
+ * Type-based alias analysis (--strict-aliasing). Every scalar kind gets a
+ * node under "omnipotent char", as in C: integers of one width share a node
+ * whatever their signedness, and all pointers share one. Byte-sized types,
+ * vectors and aggregates are left untagged, so they may alias anything,
+ * which keeps byte views of memory (*u8, @load on vec<u8, N>) valid.
+ */
+typedef enum { TBAA_I16, TBAA_I32, TBAA_I64, TBAA_F32, TBAA_F64, TBAA_PTR, TBAA_NONE } TbaaKind;
+
+static TbaaKind tbaa_kind(CodegenContext *ctx, Type *t) {
+    if (!t) return TBAA_NONE;
+    switch (t->kind) {
+        case TYPE_POINTER:
+        case TYPE_FUNCTION:
+            return TBAA_PTR;
+        case TYPE_PRIMITIVE:
+        case TYPE_ENUM: {
+            LLVMTypeRef ty = get_llvm_type(ctx, t);
+            switch (LLVMGetTypeKind(ty)) {
+                case LLVMFloatTypeKind:  return TBAA_F32;
+                case LLVMDoubleTypeKind: return TBAA_F64;
+                case LLVMIntegerTypeKind:
+                    switch (LLVMGetIntTypeWidth(ty)) {
+                        case 16: return TBAA_I16;
+                        case 32: return TBAA_I32;
+                        case 64: return TBAA_I64;
+                        default: return TBAA_NONE;
+                    }
+                default: return TBAA_NONE;
+            }
         }
+        default:
+            return TBAA_NONE;
     }
+}
 
-    LLVMTypeRef fn_ty = LLVMFunctionType(ret_type, llvm_params, (unsigned)llvm_arg_count, 0);
-    free(llvm_params);
-    return fn_ty;
+static LLVMMetadataRef tbaa_md(CodegenContext *ctx, LLVMMetadataRef *ops, size_t n) {
+    return LLVMMDNodeInContext2(ctx->context, ops, n);
 }
 
-bool type_is_address_only(Type *t) {
-    if (!t) ICE("type_is_address_only: NULL type reached codegen");
-    switch (t->kind) {
-        case TYPE_ARRAY:    return true;                         // [N]T lives at its address
-        case TYPE_SLICE:    return false;                        // T[] (slice) is loaded as a value
-        case TYPE_VOID:     return true;                         // nothing to load
-        default:            return false;                        // primitives, pointers, structs -> load by value
+static LLVMMetadataRef tbaa_string(CodegenContext *ctx, const char *s) {
+    return LLVMMDStringInContext2(ctx->context, s, strlen(s));
+}
+
+/* The access tag !{scalar, scalar, 0} for `kind`. */
+static LLVMValueRef tbaa_tag(CodegenContext *ctx, TbaaKind kind) {
+    if (ctx->tbaa_tags[kind]) return ctx->tbaa_tags[kind];
+    static const char *names[] = { "i16", "i32", "i64", "f32", "f64", "any pointer" };
+    LLVMMetadataRef zero = LLVMValueAsMetadata(LLVMConstInt(LLVMInt64TypeInContext(ctx->context), 0, 0));
+    LLVMMetadataRef root_ops[] = { tbaa_string(ctx, "Newt TBAA") };
+    LLVMMetadataRef root = tbaa_md(ctx, root_ops, 1);
+    LLVMMetadataRef char_ops[] = { tbaa_string(ctx, "omnipotent char"), root, zero };
+    LLVMMetadataRef any = tbaa_md(ctx, char_ops, 3);
+    LLVMMetadataRef scalar_ops[] = { tbaa_string(ctx, names[kind]), any, zero };
+    LLVMMetadataRef scalar = tbaa_md(ctx, scalar_ops, 3);
+    LLVMMetadataRef tag_ops[] = { scalar, scalar, zero };
+    ctx->tbaa_tags[kind] = LLVMMetadataAsValue(ctx->context, tbaa_md(ctx, tag_ops, 3));
+    return ctx->tbaa_tags[kind];
+}
+
+void codegen_tbaa(CodegenContext *ctx, LLVMValueRef access, Type *type) {
+    if (!ctx->strict_aliasing || !access) return;
+    TbaaKind kind = tbaa_kind(ctx, type);
+    if (kind == TBAA_NONE) return;
+    LLVMSetMetadata(access, LLVMGetMDKindIDInContext(ctx->context, "tbaa", 4), tbaa_tag(ctx, kind));
+}
+
+/*
+ * Body of a struct sema laid out itself (@packed, @align, @reorder): fields in
+ * offset order, with [N x i8] padding wherever LLVM would not put the next
+ * one and at the tail. The body stays unpacked when that reproduces every
+ * offset (loads keep their natural alignment); otherwise it is packed.
+ * Field i lives at element slots[i], see codegen_field_slot.
+ */
+static void set_explicit_struct_body(CodegenContext *ctx, Type *t, LLVMTypeRef struct_ty) {
+    size_t count = t->as.struct_type.field_count;
+    StructField *fields = t->as.struct_type.fields;
+    size_t *order = xmalloc(sizeof(size_t) * (count ? count : 1));
+    unsigned *slots = xmalloc(sizeof(unsigned) * (count ? count : 1));
+    LLVMTypeRef *elems = xmalloc(sizeof(LLVMTypeRef) * (2 * count + 1));
+    LLVMTypeRef i8 = LLVMInt8TypeInContext(ctx->context);
+
+    for (size_t k = 0; k < count; k++) {
+        size_t i = k;
+        while (i > 0 && fields[order[i - 1]].offset > fields[k].offset) {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = k;
+    }
+
+    for (int packed = 0; packed <= 1; packed++) {
+        unsigned n = 0;
+        uint64_t at = 0;
+        for (size_t k = 0; k < count; k++) {
+            size_t i = order[k];
+            uint64_t offset = (uint64_t)fields[i].offset;
+            if (offset > at) elems[n++] = LLVMArrayType(i8, (unsigned)(offset - at));
+            slots[i] = n;
+            elems[n] = get_llvm_type(ctx, fields[i].type);
+            at = offset + LLVMABISizeOfType(ctx->target_data, elems[n++]);
+        }
+        uint64_t size = (uint64_t)t->as.struct_type.size;
+        if (size > at) elems[n++] = LLVMArrayType(i8, (unsigned)(size - at));
+
+        LLVMTypeRef probe = LLVMStructTypeInContext(ctx->context, elems, n, packed);
+        bool exact = LLVMABISizeOfType(ctx->target_data, probe) == size;
+        for (size_t i = 0; exact && i < count; i++) {
+            exact = LLVMOffsetOfElement(ctx->target_data, probe, slots[i]) == (uint64_t)fields[i].offset;
+        }
+        if (exact) {
+            LLVMStructSetBody(struct_ty, elems, n, packed);
+            break;
+        }
+        if (packed) ICE("get_llvm_type: cannot lay out struct as sema did");
+    }
+
+    // LLVM has no over-aligned struct types: its storage gets the alignment instead
+    if ((uint64_t)t->as.struct_type.align > LLVMABIAlignmentOfType(ctx->target_data, struct_ty)) {
+        ptrmap_put(ctx->type_aligns, struct_ty, (void*)(uintptr_t)t->as.struct_type.align);
     }
+    ptrmap_put(ctx->field_slots, t, slots);
+    free(elems);
+    free(order);
 }
 
-bool type_is_indirect(CodegenContext *ctx, Type *t) {
-    // Fixed-size arrays are always passed by value via byval pointer.
-    // The caller's array alloca is passed as a pointer; LLVM copies it
-    // onto the callee's stack frame, giving true pass-by-value semantics.
-    if (t->kind == TYPE_ARRAY) return true;
-    if (t->kind != TYPE_STRUCT && t->kind != TYPE_GENERIC_INST) return false;
-    LLVMTypeRef llvm_ty = get_llvm_type(ctx, t);
-    // Threshold: 16 bytes (2 x 64-bit registers)
-    return LLVMABISizeOfType(ctx->target_data, llvm_ty) > 16;
+unsigned codegen_field_slot(CodegenContext *ctx, Type *struct_type, size_t field) {
+    if (struct_type->kind == TYPE_GENERIC_INST) struct_type = struct_type->as.generic_inst.concrete_type;
+    get_llvm_type(ctx, struct_type);
+    unsigned *slots = ptrmap_get(ctx->field_slots, struct_type);
+    return slots ? slots[field] : (unsigned)field;
 }
 
-LLVMValueRef codegen_load_value(CodegenContext *ctx, LLVMValueRef ptr, Type *type) {
-    if (!ptr) ICE("codegen_load_value: NULL lvalue for type kind %d", type ? type->kind : -1);
-    if (type_is_address_only(type)) return ptr;
-    return LLVMBuildLoad2(ctx->builder, get_llvm_type(ctx, type), ptr, "loadtmp");
+void codegen_align_storage(CodegenContext *ctx, LLVMValueRef storage, LLVMTypeRef ty) {
+    while (LLVMGetTypeKind(ty) == LLVMArrayTypeKind) ty = LLVMGetElementType(ty);
+    unsigned align = (unsigned)(uintptr_t)ptrmap_get(ctx->type_aligns, ty);
+    if (align > LLVMGetAlignment(storage)) LLVMSetAlignment(storage, align);
 }
 
 LLVMTypeRef get_llvm_type(CodegenContext *ctx, Type *t) {
     if (!t) ICE("get_llvm_type: received NULL type.");
     
     // Check cache for ALL types
-    LLVMTypeRef cached = hashmap_get(ctx->type_cache, t, ptr_hash, ptr_cmp);
+    LLVMTypeRef cached = ptrmap_get(ctx->type_cache, t);
     if (cached) return cached;
 
     LLVMTypeRef res = NULL;
@@ -93,6 +206,10 @@ LLVMTypeRef get_llvm_type(CodegenContext *ctx, Type *t) {
         case TYPE_ARRAY:
             res = LLVMArrayType(get_llvm_type(ctx, t->as.array.base), (unsigned int)t->as.array.size);
             break;
+        case TYPE_VECTOR:
+            // bool lanes stay i8 (0 or 1) like scalar bools, so masks load and store as bytes
+            res = LLVMVectorType(get_llvm_type(ctx, t->as.vector.base), (unsigned int)t->as.vector.lanes);
+            break;
         case TYPE_SLICE:
             {
                 // FAT POINTER (Slice): struct { T* ptr, i64 len }
@@ -113,7 +230,13 @@ LLVMTypeRef get_llvm_type(CodegenContext *ctx, Type *t) {
             LLVMTypeRef struct_ty = LLVMStructCreateNamed(ctx->context, struct_name);
             
             // Cache before resolving body to handle recursive types
-            hashmap_put(ctx->type_cache, (void*)t, struct_ty, ptr_hash, ptr_cmp);
+            ptrmap_put(ctx->type_cache, (void*)t, struct_ty);
+
+            if (t->as.struct_type.layout == STRUCT_LAYOUT_PENDING) type_struct_layout(t);
+            if (t->as.struct_type.layout == STRUCT_LAYOUT_EXPLICIT) {
+                set_explicit_struct_body(ctx, t, struct_ty);
+                return struct_ty;
+            }
 
             // Now resolve the body
             size_t field_count = t->as.struct_type.field_count;
@@ -144,7 +267,7 @@ LLVMTypeRef get_llvm_type(CodegenContext *ctx, Type *t) {
     }
 
     if (res) {
-        hashmap_put(ctx->type_cache, (void*)t, res, ptr_hash, ptr_cmp);
+        ptrmap_put(ctx->type_cache, (void*)t, res);
     }
     return res;
 }
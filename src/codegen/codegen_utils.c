@@ -1,5 +1,6 @@
 #include "codegen_internal.h"
 #include "codegen_utils.h"
+#include "sema/type_print.h"
 
 LLVMValueRef create_entry_block_alloca(CodegenContext *ctx, LLVMTypeRef ty, const char *name) {
     LLVMBasicBlockRef current_block = LLVMGetInsertBlock(ctx->builder);
@@ -18,6 +19,7 @@ LLVMValueRef create_entry_block_alloca(CodegenContext *ctx, LLVMTypeRef ty, cons
 
     LLVMValueRef alloca = LLVMBuildAlloca(tmp_builder, ty, name);
     LLVMDisposeBuilder(tmp_builder);
+    codegen_align_storage(ctx, alloca, ty);
 
     return alloca;
 }
@@ -59,6 +61,11 @@ static void mangle_type_recursive(char *buf, size_t *pos, size_t cap, Type *t) {
             buf[(*pos)++] = 'S';
             mangle_type_recursive(buf, pos, cap, t->as.slice.base);
             break;
+        case TYPE_VECTOR:
+            buf[(*pos)++] = 'V';
+            *pos += snprintf(buf + *pos, cap - *pos, "%lld", (long long)t->as.vector.lanes);
+            mangle_type_recursive(buf, pos, cap, t->as.vector.base);
+            break;
         case TYPE_STRUCT:
             buf[(*pos)++] = 'T';
             if (t->as.struct_type.name) {
@@ -118,6 +125,77 @@ char* mangle_name(CodegenContext *ctx, CompilationUnit *unit, InternResult *symb
     return mangled;
 }
 
+/*
+ * The symbol name of a function or global declaration, mangled once and kept
+ * on the declaration (in the loader's arena). Partitioned lowering names
+ * every declaration up front (codegen_name_program), so worker threads only
+ * ever read the cached name.
+ */
+const char *codegen_decl_name(CodegenContext *ctx, AstNode *decl) {
+    const char **slot;
+    InternResult *name;
+    Type *fn_type = NULL;
+    if (decl->node_type == AST_FUNCTION_DECLARATION) {
+        slot = &decl->data.function_declaration.mangled_name;
+        name = decl->data.function_declaration.intern_result;
+        fn_type = decl->type;
+    } else if (decl->node_type == AST_VARIABLE_DECLARATION) {
+        slot = &decl->data.variable_declaration.mangled_name;
+        name = decl->data.variable_declaration.intern_result;
+    } else {
+        return NULL;
+    }
+    if (*slot) return *slot;
+    if (!name || !name->key) return NULL;
+
+    CompilationUnit *u = module_loader_unit_for_file(ctx->loader, decl->span.file);
+    char *mangled = mangle_name(ctx, u, name, fn_type);
+    size_t len = strlen(mangled);
+    char *stored = arena_alloc(ctx->loader->arena, len + 1);
+    memcpy(stored, mangled, len + 1);
+    free(mangled);
+    *slot = stored;
+    return stored;
+}
+
+/*
+ * What profiles and symbol maps call a function: its module's logical path,
+ * its name and its parameter types, which is what the mangled name encodes.
+ */
+char *codegen_display_name(CodegenContext *ctx, AstNode *decl) {
+    InternResult *name = decl->data.function_declaration.intern_result;
+    Slice *s = name && name->key ? (Slice*)name->key : NULL;
+    if (!s) return xstrdup("anon_func");
+
+    CompilationUnit *u = module_loader_unit_for_file(ctx->loader, decl->span.file);
+    const char *log_path = u && u->logical_path ? u->logical_path : "main";
+    Type *fn_type = decl->type;
+    size_t count = fn_type && fn_type->kind == TYPE_FUNCTION ? fn_type->as.func.param_count : 0;
+
+    size_t len = strlen(log_path) + s->len + 3;
+    for (size_t i = 0; i < count; i++) len += type_format(NULL, 0, fn_type->as.func.params[i]) + 2;
+    char *out = xmalloc(len + 1);
+    size_t pos = (size_t)snprintf(out, len + 1, "%s.%.*s(", log_path, (int)s->len, s->ptr);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) pos += (size_t)snprintf(out + pos, len + 1 - pos, ", ");
+        pos += type_format(out + pos, len + 1 - pos, fn_type->as.func.params[i]);
+    }
+    snprintf(out + pos, len + 1 - pos, ")");
+    return out;
+}
+
+/* The function or global `decl` defines, as declared in this module; NULL if it is not. */
+LLVMValueRef codegen_decl_value(CodegenContext *ctx, AstNode *decl) {
+    LLVMValueRef val = ptrmap_get(ctx->decl_values, decl);
+    if (val) return val;
+    const char *name = codegen_decl_name(ctx, decl);
+    if (!name) return NULL;
+    val = decl->node_type == AST_FUNCTION_DECLARATION ? LLVMGetNamedFunction(ctx->module, name)
+                                                      : LLVMGetNamedGlobal(ctx->module, name);
+    if (val) ptrmap_put(ctx->decl_values, decl, val);
+    return val;
+}
+
 bool struct_field_index(Type *struct_type, const char *field_name, size_t *out_index) {
     if (struct_type->kind == TYPE_GENERIC_INST) {
         struct_type = struct_type->as.generic_inst.concrete_type;
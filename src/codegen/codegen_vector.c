@@ -0,0 +1,238 @@
+/**
+ * @file codegen_vector.c
+ * @brief Lowers vec<T, N>: lane-wise operators, casts and the vector intrinsics.
+ *
+ * A vec<T, N> is an LLVM <N x T> value. bool lanes are i8 holding 0 or 1,
+ * the same as a scalar bool, so a mask is <N x i8>: comparisons produce
+ * <N x i1> and widen it, @select/@any/@all narrow it back.
+ */
+
+#include "codegen_internal.h"
+
+static bool lane_is_float(Type *vec) {
+    return type_is_float(vec->as.vector.base);
+}
+
+static LLVMValueRef to_i1_lanes(CodegenContext *ctx, LLVMValueRef mask) {
+    return LLVMBuildICmp(ctx->builder, LLVMIntNE, mask, LLVMConstNull(LLVMTypeOf(mask)), "mask_bits");
+}
+
+LLVMValueRef codegen_splat(CodegenContext *ctx, LLVMValueRef scalar, LLVMTypeRef vec_ty) {
+    unsigned lanes = LLVMGetVectorSize(vec_ty);
+    LLVMTypeRef i32_ty = LLVMInt32TypeInContext(ctx->context);
+    LLVMValueRef one = LLVMBuildInsertElement(ctx->builder, LLVMGetUndef(vec_ty), scalar, LLVMConstInt(i32_ty, 0, 0), "splat_lane");
+    LLVMValueRef zeros = LLVMConstNull(LLVMVectorType(i32_ty, lanes));
+    return LLVMBuildShuffleVector(ctx->builder, one, LLVMGetUndef(vec_ty), zeros, "splat");
+}
+
+LLVMValueRef codegen_vector_binary(CodegenContext *ctx, OpKind op, LLVMValueRef L, LLVMValueRef R, Type *vec, Type *result) {
+    LLVMTypeRef vec_ty = get_llvm_type(ctx, vec);
+    if (LLVMGetTypeKind(LLVMTypeOf(L)) != LLVMVectorTypeKind) L = codegen_splat(ctx, L, vec_ty);
+    if (LLVMGetTypeKind(LLVMTypeOf(R)) != LLVMVectorTypeKind) R = codegen_splat(ctx, R, vec_ty);
+
+    bool is_float = lane_is_float(vec);
+    bool is_unsigned = type_is_unsigned(vec->as.vector.base);
+    LLVMBuilderRef b = ctx->builder;
+
+    LLVMIntPredicate ipred;
+    LLVMRealPredicate fpred;
+    switch (op) {
+        case OP_ADD: return is_float ? LLVMBuildFAdd(b, L, R, "vaddtmp") : LLVMBuildAdd(b, L, R, "vaddtmp");
+        case OP_SUB: return is_float ? LLVMBuildFSub(b, L, R, "vsubtmp") : LLVMBuildSub(b, L, R, "vsubtmp");
+        case OP_MUL: return is_float ? LLVMBuildFMul(b, L, R, "vmultmp") : LLVMBuildMul(b, L, R, "vmultmp");
+        case OP_DIV: return is_float ? LLVMBuildFDiv(b, L, R, "vdivtmp") :
+                            is_unsigned ? LLVMBuildUDiv(b, L, R, "vdivtmp") : LLVMBuildSDiv(b, L, R, "vdivtmp");
+        case OP_MOD: return is_float ? LLVMBuildFRem(b, L, R, "vmodtmp") :
+                            is_unsigned ? LLVMBuildURem(b, L, R, "vmodtmp") : LLVMBuildSRem(b, L, R, "vmodtmp");
+        case OP_AND: return LLVMBuildAnd(b, L, R, "vandtmp");
+        case OP_OR:  return LLVMBuildOr(b, L, R, "vortmp");
+        case OP_EQ:  ipred = LLVMIntEQ; fpred = LLVMRealOEQ; break;
+        case OP_NEQ: ipred = LLVMIntNE; fpred = LLVMRealONE; break;
+        case OP_LT:  ipred = is_unsigned ? LLVMIntULT : LLVMIntSLT; fpred = LLVMRealOLT; break;
+        case OP_GT:  ipred = is_unsigned ? LLVMIntUGT : LLVMIntSGT; fpred = LLVMRealOGT; break;
+        case OP_LE:  ipred = is_unsigned ? LLVMIntULE : LLVMIntSLE; fpred = LLVMRealOLE; break;
+        case OP_GE:  ipred = is_unsigned ? LLVMIntUGE : LLVMIntSGE; fpred = LLVMRealOGE; break;
+        default:
+            ICE("codegen_vector_binary: unhandled operator %d", op);
+    }
+    LLVMValueRef bits = is_float ? LLVMBuildFCmp(b, fpred, L, R, "vcmptmp") : LLVMBuildICmp(b, ipred, L, R, "vcmptmp");
+    return LLVMBuildZExt(b, bits, get_llvm_type(ctx, result), "mask_zext");
+}
+
+LLVMValueRef codegen_vector_cast(CodegenContext *ctx, LLVMValueRef val, Type *from, Type *to) {
+    LLVMTypeRef dst_ty = get_llvm_type(ctx, to);
+    Type *src_lane = from->as.vector.base, *dst_lane = to->as.vector.base;
+    bool src_float = type_is_float(src_lane), dst_float = type_is_float(dst_lane);
+    // bool lanes are 0 or 1: widen them like unsigned integers
+    bool src_unsigned = type_is_unsigned(src_lane) || type_is_bool(src_lane);
+
+    if (src_float && dst_float) {
+        unsigned long long src_bits = LLVMSizeOfTypeInBits(ctx->target_data, LLVMGetElementType(LLVMTypeOf(val)));
+        unsigned long long dst_bits = LLVMSizeOfTypeInBits(ctx->target_data, LLVMGetElementType(dst_ty));
+        if (src_bits == dst_bits) return val;
+        return src_bits < dst_bits ? LLVMBuildFPExt(ctx->builder, val, dst_ty, "vfpext")
+                                   : LLVMBuildFPTrunc(ctx->builder, val, dst_ty, "vfptrunc");
+    }
+    if (src_float) {
+        return type_is_unsigned(dst_lane) ? LLVMBuildFPToUI(ctx->builder, val, dst_ty, "vfptoui")
+                                          : LLVMBuildFPToSI(ctx->builder, val, dst_ty, "vfptosi");
+    }
+    if (dst_float) {
+        return src_unsigned ? LLVMBuildUIToFP(ctx->builder, val, dst_ty, "vuitofp")
+                            : LLVMBuildSIToFP(ctx->builder, val, dst_ty, "vsitofp");
+    }
+    return LLVMBuildIntCast2(ctx->builder, val, dst_ty, !src_unsigned, "vintcast");
+}
+
+/* --- Reductions --- */
+
+static LLVMValueRef call_vector_intrinsic(CodegenContext *ctx, const char *name, LLVMValueRef *args, unsigned nargs, LLVMTypeRef overload) {
+    unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+    if (!id) ICE("LLVM has no intrinsic '%s'", name);
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(ctx->module, id, &overload, 1);
+    return LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(fn), fn, args, nargs, "vreduce");
+}
+
+/*
+ * Float add/mul reductions are ordered in LLVM (a sequential chain) unless
+ * they may reassociate. Halving the vector instead gives a log2(N) tree that
+ * stays vectorized; non-power-of-two widths keep the ordered intrinsic.
+ */
+static LLVMValueRef reduce_float_tree(CodegenContext *ctx, LLVMValueRef val, bool mul) {
+    LLVMTypeRef i32_ty = LLVMInt32TypeInContext(ctx->context);
+    unsigned width = LLVMGetVectorSize(LLVMTypeOf(val));
+    while (width > 1) {
+        unsigned half = width / 2;
+        LLVMValueRef *lo = xmalloc(sizeof(LLVMValueRef) * half);
+        LLVMValueRef *hi = xmalloc(sizeof(LLVMValueRef) * half);
+        for (unsigned i = 0; i < half; i++) {
+            lo[i] = LLVMConstInt(i32_ty, i, 0);
+            hi[i] = LLVMConstInt(i32_ty, half + i, 0);
+        }
+        LLVMValueRef undef = LLVMGetUndef(LLVMTypeOf(val));
+        LLVMValueRef a = LLVMBuildShuffleVector(ctx->builder, val, undef, LLVMConstVector(lo, half), "rlo");
+        LLVMValueRef b = LLVMBuildShuffleVector(ctx->builder, val, undef, LLVMConstVector(hi, half), "rhi");
+        free(lo);
+        free(hi);
+        val = mul ? LLVMBuildFMul(ctx->builder, a, b, "rmul") : LLVMBuildFAdd(ctx->builder, a, b, "radd");
+        width = half;
+    }
+    return LLVMBuildExtractElement(ctx->builder, val, LLVMConstInt(i32_ty, 0, 0), "reduced");
+}
+
+static LLVMValueRef codegen_reduce(CodegenContext *ctx, IntrinsicKind kind, LLVMValueRef val, Type *vec) {
+    LLVMTypeRef vec_ty = LLVMTypeOf(val);
+    LLVMTypeRef lane_ty = LLVMGetElementType(vec_ty);
+    unsigned lanes = LLVMGetVectorSize(vec_ty);
+    bool is_float = lane_is_float(vec);
+    bool is_unsigned = type_is_unsigned(vec->as.vector.base);
+
+    if (is_float && (kind == INTRINSIC_REDUCE_ADD || kind == INTRINSIC_REDUCE_MUL)) {
+        bool mul = kind == INTRINSIC_REDUCE_MUL;
+        if ((lanes & (lanes - 1)) == 0) return reduce_float_tree(ctx, val, mul);
+        LLVMValueRef args[] = { LLVMConstReal(lane_ty, mul ? 1.0 : 0.0), val };
+        return call_vector_intrinsic(ctx, mul ? "llvm.vector.reduce.fmul" : "llvm.vector.reduce.fadd", args, 2, vec_ty);
+    }
+
+    const char *name = NULL;
+    switch (kind) {
+        case INTRINSIC_REDUCE_ADD: name = "llvm.vector.reduce.add"; break;
+        case INTRINSIC_REDUCE_MUL: name = "llvm.vector.reduce.mul"; break;
+        case INTRINSIC_REDUCE_MIN: name = is_float ? "llvm.vector.reduce.fmin" : is_unsigned ? "llvm.vector.reduce.umin" : "llvm.vector.reduce.smin"; break;
+        case INTRINSIC_REDUCE_MAX: name = is_float ? "llvm.vector.reduce.fmax" : is_unsigned ? "llvm.vector.reduce.umax" : "llvm.vector.reduce.smax"; break;
+        default: ICE("codegen_reduce: not a reduction (%d)", kind);
+    }
+    return call_vector_intrinsic(ctx, name, &val, 1, vec_ty);
+}
+
+/* --- Intrinsics --- */
+
+/* Address of element `index` of the array, slice or pointer `mem`. */
+static LLVMValueRef lane_memory(CodegenContext *ctx, AstNode *mem, AstNode *index, Type *lane) {
+    LLVMTypeRef lane_ty = get_llvm_type(ctx, lane);
+    LLVMValueRef base;
+    switch (mem->type->kind) {
+        case TYPE_ARRAY:
+            base = codegen_lvalue(ctx, mem);
+            break;
+        case TYPE_SLICE:
+            base = LLVMBuildExtractValue(ctx->builder, codegen_expr(ctx, mem), 0, "slice_data");
+            break;
+        default:
+            base = codegen_expr(ctx, mem);
+            break;
+    }
+    base = LLVMBuildBitCast(ctx->builder, base, LLVMPointerType(lane_ty, 0), "lanes_ptr");
+    LLVMValueRef idx = codegen_expr(ctx, index);
+    return LLVMBuildInBoundsGEP2(ctx->builder, lane_ty, base, &idx, 1, "lanes_at");
+}
+
+static LLVMValueRef codegen_shuffle(CodegenContext *ctx, DynArray *args) {
+    AstNode *mask_node = DYNARRAY_AT(AstNode*, args, args->count - 1);
+    DynArray *indices = mask_node->data.initializer_list.elements;
+    LLVMTypeRef i32_ty = LLVMInt32TypeInContext(ctx->context);
+    LLVMValueRef *mask = xmalloc(sizeof(LLVMValueRef) * indices->count);
+    for (size_t i = 0; i < indices->count; i++) {
+        AstNode *idx = DYNARRAY_AT(AstNode*, indices, i);
+        mask[i] = LLVMConstInt(i32_ty, (unsigned long long)idx->const_value.value.int_val, 0);
+    }
+
+    LLVMValueRef a = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 0));
+    LLVMValueRef b = args->count == 3 ? codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1)) : LLVMGetUndef(LLVMTypeOf(a));
+    LLVMValueRef res = LLVMBuildShuffleVector(ctx->builder, a, b, LLVMConstVector(mask, (unsigned)indices->count), "shuffle");
+    free(mask);
+    return res;
+}
+
+LLVMValueRef codegen_vector_intrinsic(CodegenContext *ctx, AstNode *expr) {
+    DynArray *args = expr->data.intrinsic.args;
+    AstNode *a0 = DYNARRAY_AT(AstNode*, args, 0);
+
+    switch (expr->data.intrinsic.kind) {
+        case INTRINSIC_SPLAT:
+            return codegen_splat(ctx, codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1)), get_llvm_type(ctx, expr->type));
+
+        case INTRINSIC_LOAD: {
+            Type *lane = expr->type->as.vector.base;
+            LLVMValueRef at = lane_memory(ctx, DYNARRAY_AT(AstNode*, args, 1), DYNARRAY_AT(AstNode*, args, 2), lane);
+            LLVMTypeRef vec_ty = get_llvm_type(ctx, expr->type);
+            at = LLVMBuildBitCast(ctx->builder, at, LLVMPointerType(vec_ty, 0), "vec_ptr");
+            LLVMValueRef load = LLVMBuildLoad2(ctx->builder, vec_ty, at, "vload");
+            // Only the lanes' own alignment is known
+            LLVMSetAlignment(load, LLVMABIAlignmentOfType(ctx->target_data, get_llvm_type(ctx, lane)));
+            return load;
+        }
+
+        case INTRINSIC_STORE: {
+            AstNode *value = DYNARRAY_AT(AstNode*, args, 2);
+            LLVMValueRef val = codegen_expr(ctx, value);
+            Type *lane = value->type->as.vector.base;
+            LLVMValueRef at = lane_memory(ctx, a0, DYNARRAY_AT(AstNode*, args, 1), lane);
+            at = LLVMBuildBitCast(ctx->builder, at, LLVMPointerType(LLVMTypeOf(val), 0), "vec_ptr");
+            LLVMValueRef store = LLVMBuildStore(ctx->builder, val, at);
+            LLVMSetAlignment(store, LLVMABIAlignmentOfType(ctx->target_data, get_llvm_type(ctx, lane)));
+            return NULL;
+        }
+
+        case INTRINSIC_SHUFFLE:
+            return codegen_shuffle(ctx, args);
+
+        case INTRINSIC_SELECT: {
+            LLVMValueRef mask = to_i1_lanes(ctx, codegen_expr(ctx, a0));
+            LLVMValueRef a = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 1));
+            LLVMValueRef b = codegen_expr(ctx, DYNARRAY_AT(AstNode*, args, 2));
+            return LLVMBuildSelect(ctx->builder, mask, a, b, "vselect");
+        }
+
+        case INTRINSIC_ANY:
+        case INTRINSIC_ALL: {
+            LLVMValueRef bits = to_i1_lanes(ctx, codegen_expr(ctx, a0));
+            bool any = expr->data.intrinsic.kind == INTRINSIC_ANY;
+            LLVMValueRef res = call_vector_intrinsic(ctx, any ? "llvm.vector.reduce.or" : "llvm.vector.reduce.and", &bits, 1, LLVMTypeOf(bits));
+            return LLVMBuildZExt(ctx->builder, res, get_llvm_type(ctx, expr->type), "bool_zext");
+        }
+
+        default:
+            return codegen_reduce(ctx, expr->data.intrinsic.kind, codegen_expr(ctx, a0), a0->type);
+    }
+}
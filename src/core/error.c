@@ -1,4 +1,5 @@
 #include "core/error.h"
+#include "core/source_map.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -31,9 +32,11 @@ void ice_impl(const char *file, int line, const char *fmt, ...) {
     abort();
 }
 
-void ice_impl_at(const char *file, int line, const char *src_file, Span span, const char *fmt, ...) {
+void ice_impl_at(const char *file, int line, Span span, const char *fmt, ...) {
     fprintf(stderr, "\033[1;31mINTERNAL COMPILER ERROR\033[0m at %s:%d\n", file, line);
-    fprintf(stderr, "  Source: %s:%zu:%zu\n", src_file ? src_file : "?", span.start_line, span.start_col);
+    SourcePos pos = span_start_pos(span);
+    const char *src_file = source_path(span.file);
+    fprintf(stderr, "  Source: %s:%u:%u\n", src_file ? src_file : "?", pos.line, pos.col);
 
     va_list args;
     va_start(args, fmt);
@@ -0,0 +1,682 @@
+#include "linker.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+static LinkStatus link_error(char *err, size_t err_len, LinkStatus status, const char *fmt, ...) {
+    if (err && err_len > 0) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(err, err_len, fmt, ap);
+        va_end(ap);
+    }
+    return status;
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "arena.h"
+#include "dynamic_array.h"
+#include "hash_map.h"
+#include "utils.h"
+
+/*
+ * Output layout (non-PIE, vaddr == LINK_BASE + file offset):
+ *
+ *   R  : ELF header, program headers, .interp, .dynsym, .dynstr, .hash,
+ *        .rela.dyn, then every read-only input section
+ *   RX : _start, one PLT stub per import, then every executable section
+ *   RW : GOT (imports first), .dynamic, writable sections, then .bss
+ *
+ * Imports are bound eagerly (DF_BIND_NOW) through R_X86_64_GLOB_DAT.
+ */
+
+#define LINK_BASE   0x400000ULL
+#define LINK_PAGE   0x1000ULL
+#define INTERP_PATH "/lib64/ld-linux-x86-64.so.2"
+#define PHDR_COUNT  7
+#define PLT_ENTRY   8
+#define DYN_COUNT   14
+
+enum { SEG_RODATA, SEG_TEXT, SEG_DATA, SEG_BSS, SEG_COUNT, SEG_NONE = -1 };
+
+typedef struct LinkObject {
+    const LinkInput *input;
+    const unsigned char *base;
+    const Elf64_Ehdr *eh;
+    const Elf64_Shdr *sh;
+    const char *shstr;
+    const Elf64_Sym *syms;
+    size_t nsyms;
+    const char *strtab;
+    int *sec_seg;         // Per section: SEG_* or SEG_NONE (not loaded)
+    bool *discarded;      // Per section: member of a COMDAT group an earlier object provides
+    uint64_t *sec_off;    // Per section: offset inside its segment
+    uint32_t *got_local;  // Per symbol: local GOT slot (UINT32_MAX: none)
+    int32_t *import_of;   // Per symbol: import index (-1: not imported)
+} LinkObject;
+
+typedef struct {
+    LinkObject *obj;
+    size_t sym;
+    bool weak;
+} SymbolRef;
+
+typedef struct {
+    Arena *arena;
+    LinkObject *objs;
+    size_t nobjs;
+    HashMap *globals;     // char* -> SymbolRef* (defined globals)
+    HashMap *comdats;     // char* (group signature) -> LinkObject* that provides it
+    HashMap *import_map;  // char* -> (void*)(import index + 1)
+    DynArray imports;     // DynArray<const char*>
+    DynArray import_weak; // DynArray<bool>
+    DynArray got_locals;  // DynArray<SymbolRef> (GOT slots after the imports)
+
+    uint64_t seg_size[SEG_COUNT];
+    uint64_t seg_off[SEG_COUNT];  // File offset (not for SEG_BSS)
+    uint64_t seg_addr[SEG_COUNT];
+
+    // Prologue offsets inside their segments
+    uint64_t interp_off, dynsym_off, dynstr_off, dynstr_size, hash_off, hash_size, rela_off;
+    uint64_t plt_off, dynamic_off;
+
+    char *err;
+    size_t err_len;
+} Linker;
+
+static uint64_t align_to(uint64_t v, uint64_t a) {
+    return a > 1 ? (v + a - 1) & ~(a - 1) : v;
+}
+
+static const char *symbol_name(const LinkObject *o, size_t idx) {
+    return o->strtab + o->syms[idx].st_name;
+}
+
+/* Defined in a section that was dropped for another object's copy of its group. */
+static bool symbol_discarded(const LinkObject *o, const Elf64_Sym *s) {
+    return s->st_shndx < o->eh->e_shnum && o->discarded[s->st_shndx];
+}
+
+static bool reloc_supported(uint32_t type) {
+    switch (type) {
+        case R_X86_64_NONE:
+        case R_X86_64_64:
+        case R_X86_64_PC64:
+        case R_X86_64_PC32:
+        case R_X86_64_PLT32:
+        case R_X86_64_32:
+        case R_X86_64_32S:
+        case R_X86_64_GOTPCREL:
+        case R_X86_64_GOTPCRELX:
+        case R_X86_64_REX_GOTPCRELX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool reloc_uses_got(uint32_t type) {
+    return type == R_X86_64_GOTPCREL || type == R_X86_64_GOTPCRELX || type == R_X86_64_REX_GOTPCRELX;
+}
+
+static LinkStatus load_object(Linker *l, const LinkInput *in, LinkObject *o) {
+    const char *name = in->name ? in->name : "<object>";
+    const Elf64_Ehdr *eh = in->data;
+    if (in->size < sizeof(Elf64_Ehdr) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_ident[EI_DATA] != ELFDATA2LSB ||
+        eh->e_type != ET_REL || eh->e_machine != EM_X86_64) {
+        return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "%s: not an x86-64 ELF relocatable object", name);
+    }
+    if (eh->e_shentsize != sizeof(Elf64_Shdr) || eh->e_shoff > in->size ||
+        (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr) > in->size - eh->e_shoff || eh->e_shstrndx >= eh->e_shnum) {
+        return link_error(l->err, l->err_len, LINK_FAILED, "%s: malformed section table", name);
+    }
+
+    o->input = in;
+    o->base = in->data;
+    o->eh = eh;
+    o->sh = (const Elf64_Shdr*)(o->base + eh->e_shoff);
+    for (size_t i = 0; i < eh->e_shnum; i++) {
+        const Elf64_Shdr *s = &o->sh[i];
+        if (s->sh_type != SHT_NOBITS && (s->sh_offset > in->size || s->sh_size > in->size - s->sh_offset)) {
+            return link_error(l->err, l->err_len, LINK_FAILED, "%s: section %zu out of bounds", name, i);
+        }
+    }
+    o->shstr = (const char*)o->base + o->sh[eh->e_shstrndx].sh_offset;
+
+    o->sec_seg = arena_alloc(l->arena, eh->e_shnum * sizeof(int) + 1);
+    o->sec_off = arena_calloc(l->arena, eh->e_shnum * sizeof(uint64_t) + 1);
+    for (size_t i = 0; i < eh->e_shnum; i++) {
+        const Elf64_Shdr *s = &o->sh[i];
+        const char *sec_name = o->shstr + s->sh_name;
+        o->sec_seg[i] = SEG_NONE;
+
+        if (s->sh_type == SHT_SYMTAB) {
+            if (s->sh_link >= eh->e_shnum || s->sh_entsize != sizeof(Elf64_Sym)) {
+                return link_error(l->err, l->err_len, LINK_FAILED, "%s: malformed symbol table", name);
+            }
+            o->syms = (const Elf64_Sym*)(o->base + s->sh_offset);
+            o->nsyms = s->sh_size / sizeof(Elf64_Sym);
+            o->strtab = (const char*)o->base + o->sh[s->sh_link].sh_offset;
+        }
+        if (s->sh_type == SHT_REL) {
+            return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "%s: REL relocations", name);
+        }
+        if (!(s->sh_flags & SHF_ALLOC) || s->sh_size == 0) continue;
+
+        if (s->sh_flags & SHF_TLS) {
+            return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "%s: thread-local section %s", name, sec_name);
+        }
+        if (s->sh_type == SHT_INIT_ARRAY || s->sh_type == SHT_FINI_ARRAY || s->sh_type == SHT_PREINIT_ARRAY) {
+            return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "%s: static constructors (%s)", name, sec_name);
+        }
+        if (s->sh_addralign > LINK_PAGE) {
+            return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "%s: over-aligned section %s", name, sec_name);
+        }
+        // No unwinder runs in these programs, so unwind tables are dropped.
+        if (s->sh_type == SHT_X86_64_UNWIND || strcmp(sec_name, ".eh_frame") == 0) continue;
+
+        if (s->sh_type == SHT_NOBITS)        o->sec_seg[i] = SEG_BSS;
+        else if (s->sh_flags & SHF_EXECINSTR) o->sec_seg[i] = SEG_TEXT;
+        else if (s->sh_flags & SHF_WRITE)    o->sec_seg[i] = SEG_DATA;
+        else                                 o->sec_seg[i] = SEG_RODATA;
+    }
+
+    // COMDAT groups (generic instances are linkonce_odr): the first object
+    // with a signature keeps its sections, later copies are not loaded and
+    // their symbols resolve to the kept definitions.
+    o->discarded = arena_calloc(l->arena, eh->e_shnum * sizeof(bool) + 1);
+    for (size_t i = 0; i < eh->e_shnum; i++) {
+        const Elf64_Shdr *s = &o->sh[i];
+        if (s->sh_type != SHT_GROUP || s->sh_size < sizeof(uint32_t) || !o->syms || s->sh_info >= o->nsyms) continue;
+        const uint32_t *words = (const uint32_t*)(o->base + s->sh_offset);
+        if (!(words[0] & GRP_COMDAT)) continue;
+
+        const char *signature = symbol_name(o, s->sh_info);
+        if (!hashmap_get(l->comdats, (void*)signature, str_hash, str_cmp)) {
+            hashmap_put(l->comdats, (void*)signature, o, str_hash, str_cmp);
+            continue;
+        }
+        for (size_t w = 1; w < s->sh_size / sizeof(uint32_t); w++) {
+            if (words[w] >= eh->e_shnum) continue;
+            o->discarded[words[w]] = true;
+            o->sec_seg[words[w]] = SEG_NONE;
+        }
+    }
+
+    o->got_local = arena_alloc(l->arena, o->nsyms * sizeof(uint32_t) + 1);
+    o->import_of = arena_alloc(l->arena, o->nsyms * sizeof(int32_t) + 1);
+    for (size_t i = 0; i < o->nsyms; i++) {
+        o->got_local[i] = UINT32_MAX;
+        o->import_of[i] = -1;
+    }
+    return LINK_OK;
+}
+
+static LinkStatus collect_globals(Linker *l, LinkObject *o) {
+    for (size_t i = 1; i < o->nsyms; i++) {
+        const Elf64_Sym *s = &o->syms[i];
+        int bind = ELF64_ST_BIND(s->st_info);
+        if (bind == STB_LOCAL || s->st_shndx == SHN_UNDEF || symbol_discarded(o, s)) continue;
+        const char *name = symbol_name(o, i);
+        if (s->st_shndx == SHN_COMMON) {
+            return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "common symbol %s", name);
+        }
+
+        bool weak = bind == STB_WEAK;
+        SymbolRef *prev = hashmap_get(l->globals, (void*)name, str_hash, str_cmp);
+        if (prev && !prev->weak && !weak) {
+            return link_error(l->err, l->err_len, LINK_FAILED, "duplicate symbol %s", name);
+        }
+        if (prev && !(prev->weak && !weak)) continue;
+
+        SymbolRef *ref = arena_alloc(l->arena, sizeof(SymbolRef));
+        ref->obj = o;
+        ref->sym = i;
+        ref->weak = weak;
+        hashmap_put(l->globals, (void*)name, ref, str_hash, str_cmp);
+    }
+    return LINK_OK;
+}
+
+static int32_t add_import(Linker *l, const char *name, bool weak) {
+    void *found = hashmap_get(l->import_map, (void*)name, str_hash, str_cmp);
+    if (found) {
+        int32_t idx = (int32_t)((uintptr_t)found - 1);
+        if (!weak) *(bool*)dynarray_get(&l->import_weak, idx) = false;
+        return idx;
+    }
+    int32_t idx = (int32_t)l->imports.count;
+    dynarray_push_value(&l->imports, &name);
+    dynarray_push_value(&l->import_weak, &weak);
+    hashmap_put(l->import_map, (void*)name, (void*)(uintptr_t)(idx + 1), str_hash, str_cmp);
+    return idx;
+}
+
+/* Decide imports and GOT slots; nothing has an address yet. */
+static LinkStatus scan_relocations(Linker *l, LinkObject *o) {
+    for (size_t i = 0; i < o->eh->e_shnum; i++) {
+        const Elf64_Shdr *rs = &o->sh[i];
+        if (rs->sh_type != SHT_RELA || rs->sh_info >= o->eh->e_shnum) continue;
+        if (o->sec_seg[rs->sh_info] == SEG_NONE) continue;
+        if (o->sec_seg[rs->sh_info] == SEG_BSS) {
+            return link_error(l->err, l->err_len, LINK_FAILED, "relocations against a NOBITS section");
+        }
+
+        const Elf64_Rela *relas = (const Elf64_Rela*)(o->base + rs->sh_offset);
+        size_t count = rs->sh_size / sizeof(Elf64_Rela);
+        for (size_t r = 0; r < count; r++) {
+            uint32_t type = ELF64_R_TYPE(relas[r].r_info);
+            size_t sym = ELF64_R_SYM(relas[r].r_info);
+            if (!reloc_supported(type)) {
+                return link_error(l->err, l->err_len, LINK_UNSUPPORTED, "relocation type %u", type);
+            }
+            if (sym == 0) continue;
+            if (sym >= o->nsyms) {
+                return link_error(l->err, l->err_len, LINK_FAILED, "relocation symbol out of range");
+            }
+
+            const Elf64_Sym *s = &o->syms[sym];
+            bool imported = false;
+            if (s->st_shndx == SHN_UNDEF || symbol_discarded(o, s)) {
+                const char *name = symbol_name(o, sym);
+                if (!hashmap_get(l->globals, (void*)name, str_hash, str_cmp)) {
+                    o->import_of[sym] = add_import(l, name, ELF64_ST_BIND(s->st_info) == STB_WEAK);
+                    imported = true;
+                }
+            }
+            if (reloc_uses_got(type) && !imported && o->got_local[sym] == UINT32_MAX) {
+                o->got_local[sym] = (uint32_t)l->got_locals.count;
+                SymbolRef ref = { o, sym, false };
+                dynarray_push_value(&l->got_locals, &ref);
+            }
+        }
+    }
+    return LINK_OK;
+}
+
+static bool symbol_address(Linker *l, LinkObject *o, size_t idx, uint64_t *out) {
+    if (idx == 0) { *out = 0; return true; }
+    const Elf64_Sym *s = &o->syms[idx];
+    if (s->st_shndx == SHN_UNDEF || symbol_discarded(o, s)) {
+        if (o->import_of[idx] >= 0) {
+            *out = l->seg_addr[SEG_TEXT] + l->plt_off + (uint64_t)o->import_of[idx] * PLT_ENTRY;
+            return true;
+        }
+        SymbolRef *def = hashmap_get(l->globals, (void*)symbol_name(o, idx), str_hash, str_cmp);
+        if (!def) return false;
+        return symbol_address(l, def->obj, def->sym, out);
+    }
+    if (s->st_shndx == SHN_ABS) { *out = s->st_value; return true; }
+    if (s->st_shndx >= o->eh->e_shnum || o->sec_seg[s->st_shndx] == SEG_NONE) return false;
+
+    int seg = o->sec_seg[s->st_shndx];
+    *out = l->seg_addr[seg] + o->sec_off[s->st_shndx] + s->st_value;
+    return true;
+}
+
+static void place_sections(Linker *l) {
+    uint64_t bss_align = 1;
+    for (size_t k = 0; k < l->nobjs; k++) {
+        LinkObject *o = &l->objs[k];
+        for (size_t i = 0; i < o->eh->e_shnum; i++) {
+            int seg = o->sec_seg[i];
+            if (seg == SEG_NONE) continue;
+            uint64_t align = o->sh[i].sh_addralign ? o->sh[i].sh_addralign : 1;
+            if (seg == SEG_BSS && align > bss_align) bss_align = align;
+            l->seg_size[seg] = align_to(l->seg_size[seg], align);
+            o->sec_off[i] = l->seg_size[seg];
+            l->seg_size[seg] += o->sh[i].sh_size;
+        }
+    }
+
+    l->seg_off[SEG_RODATA] = 0;
+    l->seg_off[SEG_TEXT] = align_to(l->seg_off[SEG_RODATA] + l->seg_size[SEG_RODATA], LINK_PAGE);
+    l->seg_off[SEG_DATA] = align_to(l->seg_off[SEG_TEXT] + l->seg_size[SEG_TEXT], LINK_PAGE);
+    for (int seg = SEG_RODATA; seg <= SEG_DATA; seg++) {
+        l->seg_addr[seg] = LINK_BASE + l->seg_off[seg];
+    }
+    l->seg_addr[SEG_BSS] = align_to(l->seg_addr[SEG_DATA] + l->seg_size[SEG_DATA], bss_align);
+}
+
+static LinkStatus apply_relocations(Linker *l, LinkObject *o, unsigned char *out) {
+    uint64_t got_addr = l->seg_addr[SEG_DATA];
+    size_t nimports = l->imports.count;
+
+    for (size_t i = 0; i < o->eh->e_shnum; i++) {
+        const Elf64_Shdr *rs = &o->sh[i];
+        if (rs->sh_type != SHT_RELA || rs->sh_info >= o->eh->e_shnum) continue;
+        int seg = o->sec_seg[rs->sh_info];
+        if (seg == SEG_NONE) continue;
+
+        const Elf64_Shdr *target = &o->sh[rs->sh_info];
+        unsigned char *sec = out + l->seg_off[seg] + o->sec_off[rs->sh_info];
+        uint64_t sec_addr = l->seg_addr[seg] + o->sec_off[rs->sh_info];
+
+        const Elf64_Rela *relas = (const Elf64_Rela*)(o->base + rs->sh_offset);
+        size_t count = rs->sh_size / sizeof(Elf64_Rela);
+        for (size_t r = 0; r < count; r++) {
+            uint32_t type = ELF64_R_TYPE(relas[r].r_info);
+            size_t sym = ELF64_R_SYM(relas[r].r_info);
+            if (type == R_X86_64_NONE) continue;
+
+            size_t width = (type == R_X86_64_64 || type == R_X86_64_PC64) ? 8 : 4;
+            if (relas[r].r_offset > target->sh_size || width > target->sh_size - relas[r].r_offset) {
+                return link_error(l->err, l->err_len, LINK_FAILED, "relocation outside its section");
+            }
+
+            uint64_t S = 0;
+            if (!symbol_address(l, o, sym, &S)) {
+                return link_error(l->err, l->err_len, LINK_FAILED, "undefined reference to %s", symbol_name(o, sym));
+            }
+            int64_t A = relas[r].r_addend;
+            uint64_t P = sec_addr + relas[r].r_offset;
+            unsigned char *loc = sec + relas[r].r_offset;
+
+            int64_t v;
+            switch (type) {
+                case R_X86_64_64:
+                    v = (int64_t)(S + A);
+                    memcpy(loc, &v, 8);
+                    continue;
+                case R_X86_64_PC64:
+                    v = (int64_t)(S + A - P);
+                    memcpy(loc, &v, 8);
+                    continue;
+                case R_X86_64_PC32:
+                case R_X86_64_PLT32:
+                    v = (int64_t)(S + A - P);
+                    break;
+                case R_X86_64_32:
+                    v = (int64_t)(S + A);
+                    if ((uint64_t)v > UINT32_MAX) goto overflow;
+                    break;
+                case R_X86_64_32S:
+                    v = (int64_t)(S + A);
+                    break;
+                default: { // GOT-relative loads
+                    uint64_t slot = o->import_of[sym] >= 0 ? (uint64_t)o->import_of[sym] : nimports + o->got_local[sym];
+                    v = (int64_t)(got_addr + slot * 8 + A - P);
+                    break;
+                }
+            }
+            if (type != R_X86_64_32 && (v < INT32_MIN || v > INT32_MAX)) goto overflow;
+            uint32_t v32 = (uint32_t)v;
+            memcpy(loc, &v32, 4);
+            continue;
+
+        overflow:
+            return link_error(l->err, l->err_len, LINK_FAILED, "relocation overflow against %s",
+                              sym ? symbol_name(o, sym) : "<section>");
+        }
+    }
+    return LINK_OK;
+}
+
+static void put32(unsigned char *p, uint32_t v) { memcpy(p, &v, 4); }
+
+/* _start: the crt1 sequence, calling __libc_start_main(main, argc, argv, 0, 0, rtld_fini, sp). */
+static size_t write_start(unsigned char *p, uint64_t start_addr, uint64_t main_addr, uint64_t start_main_got) {
+    static const unsigned char head[] = {
+        0x31, 0xed,             // xor   %ebp, %ebp
+        0x49, 0x89, 0xd1,       // mov   %rdx, %r9
+        0x5e,                   // pop   %rsi
+        0x48, 0x89, 0xe2,       // mov   %rsp, %rdx
+        0x48, 0x83, 0xe4, 0xf0, // and   $-16, %rsp
+        0x50,                   // push  %rax
+        0x54,                   // push  %rsp
+        0x45, 0x31, 0xc0,       // xor   %r8d, %r8d
+        0x31, 0xc9,             // xor   %ecx, %ecx
+        0x48, 0xc7, 0xc7,       // mov   $main, %rdi
+    };
+    size_t n = sizeof(head);
+    memcpy(p, head, n);
+    put32(p + n, (uint32_t)main_addr);
+    n += 4;
+    p[n++] = 0xff; p[n++] = 0x15; // call  *__libc_start_main@GOT(%rip)
+    put32(p + n, (uint32_t)(int32_t)(start_main_got - (start_addr + n + 4)));
+    n += 4;
+    p[n++] = 0xf4;                // hlt
+    return n;
+}
+
+static LinkStatus write_output(const char *path, const unsigned char *buf, size_t size, char *err, size_t err_len) {
+    unlink(path); // A running copy of the old binary keeps its inode
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if (fd < 0) return link_error(err, err_len, LINK_FAILED, "cannot create %s", path);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, buf + done, size - done);
+        if (n <= 0) {
+            close(fd);
+            return link_error(err, err_len, LINK_FAILED, "cannot write %s", path);
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    return LINK_OK;
+}
+
+static LinkStatus link_all(Linker *l, const LinkInput *inputs, size_t count, const char *output_path) {
+    LinkStatus st;
+    for (size_t k = 0; k < count; k++) {
+        if ((st = load_object(l, &inputs[k], &l->objs[k])) != LINK_OK) return st;
+    }
+    for (size_t k = 0; k < count; k++) {
+        if ((st = collect_globals(l, &l->objs[k])) != LINK_OK) return st;
+    }
+
+    SymbolRef *main_ref = hashmap_get(l->globals, "main", str_hash, str_cmp);
+    if (!main_ref) return link_error(l->err, l->err_len, LINK_FAILED, "undefined reference to main");
+
+    int32_t start_main = add_import(l, "__libc_start_main", false);
+    for (size_t k = 0; k < count; k++) {
+        if ((st = scan_relocations(l, &l->objs[k])) != LINK_OK) return st;
+    }
+
+    // Prologues; input sections are appended to each segment after them.
+    size_t nimports = l->imports.count;
+    size_t ndynsym = nimports + 1;
+    l->dynstr_size = 1 + sizeof("libc.so.6") + sizeof("libm.so.6");
+    for (size_t i = 0; i < nimports; i++) {
+        l->dynstr_size += strlen(*(const char**)dynarray_get(&l->imports, i)) + 1;
+    }
+
+    uint64_t off = sizeof(Elf64_Ehdr) + PHDR_COUNT * sizeof(Elf64_Phdr);
+    l->interp_off = off;
+    off += sizeof(INTERP_PATH);
+    l->dynsym_off = off = align_to(off, 8);
+    off += ndynsym * sizeof(Elf64_Sym);
+    l->dynstr_off = off;
+    off += l->dynstr_size;
+    l->hash_off = off = align_to(off, 4);
+    l->hash_size = (2 + 1 + ndynsym) * sizeof(uint32_t);
+    off += l->hash_size;
+    l->rela_off = off = align_to(off, 8);
+    off += nimports * sizeof(Elf64_Rela);
+    l->seg_size[SEG_RODATA] = off;
+
+    l->plt_off = 48; // After _start
+    l->seg_size[SEG_TEXT] = l->plt_off + nimports * PLT_ENTRY;
+
+    size_t got_slots = nimports + l->got_locals.count;
+    l->dynamic_off = got_slots * 8;
+    l->seg_size[SEG_DATA] = l->dynamic_off + DYN_COUNT * sizeof(Elf64_Dyn);
+
+    place_sections(l);
+
+    size_t file_size = l->seg_off[SEG_DATA] + l->seg_size[SEG_DATA];
+    unsigned char *out = calloc(1, file_size);
+    if (!out) return link_error(l->err, l->err_len, LINK_FAILED, "out of memory");
+
+    for (size_t k = 0; k < count; k++) {
+        LinkObject *o = &l->objs[k];
+        for (size_t i = 0; i < o->eh->e_shnum; i++) {
+            int seg = o->sec_seg[i];
+            if (seg == SEG_NONE || seg == SEG_BSS) continue;
+            memcpy(out + l->seg_off[seg] + o->sec_off[i], o->base + o->sh[i].sh_offset, o->sh[i].sh_size);
+        }
+    }
+    for (size_t k = 0; k < count; k++) {
+        if ((st = apply_relocations(l, &l->objs[k], out)) != LINK_OK) { free(out); return st; }
+    }
+
+    uint64_t got_addr = l->seg_addr[SEG_DATA];
+    for (size_t i = 0; i < l->got_locals.count; i++) {
+        SymbolRef *ref = dynarray_get(&l->got_locals, i);
+        uint64_t addr = 0;
+        if (!symbol_address(l, ref->obj, ref->sym, &addr)) {
+            free(out);
+            return link_error(l->err, l->err_len, LINK_FAILED, "undefined reference to %s", symbol_name(ref->obj, ref->sym));
+        }
+        memcpy(out + l->seg_off[SEG_DATA] + (nimports + i) * 8, &addr, 8);
+    }
+
+    uint64_t main_addr = 0;
+    symbol_address(l, main_ref->obj, main_ref->sym, &main_addr);
+    uint64_t text_addr = l->seg_addr[SEG_TEXT];
+    unsigned char *text = out + l->seg_off[SEG_TEXT];
+    write_start(text, text_addr, main_addr, got_addr + (uint64_t)start_main * 8);
+
+    // PLT: jmp *slot(%rip), padded with a two-byte nop
+    for (size_t i = 0; i < nimports; i++) {
+        unsigned char *stub = text + l->plt_off + i * PLT_ENTRY;
+        uint64_t stub_addr = text_addr + l->plt_off + i * PLT_ENTRY;
+        stub[0] = 0xff; stub[1] = 0x25;
+        put32(stub + 2, (uint32_t)(int32_t)(got_addr + i * 8 - (stub_addr + 6)));
+        stub[6] = 0x66; stub[7] = 0x90;
+    }
+
+    // Dynamic symbols, strings and relocations
+    char *dynstr = (char*)out + l->dynstr_off;
+    size_t str_pos = 1;
+    size_t libc_name = str_pos;
+    memcpy(dynstr + str_pos, "libc.so.6", sizeof("libc.so.6"));
+    str_pos += sizeof("libc.so.6");
+    size_t libm_name = str_pos;
+    memcpy(dynstr + str_pos, "libm.so.6", sizeof("libm.so.6"));
+    str_pos += sizeof("libm.so.6");
+
+    Elf64_Sym *dynsym = (Elf64_Sym*)(out + l->dynsym_off);
+    Elf64_Rela *rela = (Elf64_Rela*)(out + l->rela_off);
+    for (size_t i = 0; i < nimports; i++) {
+        const char *name = *(const char**)dynarray_get(&l->imports, i);
+        bool weak = *(bool*)dynarray_get(&l->import_weak, i);
+        size_t len = strlen(name) + 1;
+        memcpy(dynstr + str_pos, name, len);
+        dynsym[i + 1].st_name = (uint32_t)str_pos;
+        dynsym[i + 1].st_info = ELF64_ST_INFO(weak ? STB_WEAK : STB_GLOBAL, STT_FUNC);
+        str_pos += len;
+
+        rela[i].r_offset = got_addr + i * 8;
+        rela[i].r_info = ELF64_R_INFO(i + 1, R_X86_64_GLOB_DAT);
+        rela[i].r_addend = 0;
+    }
+
+    // Single-bucket SysV hash: the executable exports nothing
+    uint32_t *hash = (uint32_t*)(out + l->hash_off);
+    hash[0] = 1;
+    hash[1] = (uint32_t)ndynsym;
+
+    uint64_t ro = l->seg_addr[SEG_RODATA];
+    Elf64_Dyn dyn[DYN_COUNT] = {
+        { DT_NEEDED,  { libc_name } },
+        { DT_NEEDED,  { libm_name } },
+        { DT_HASH,    { ro + l->hash_off } },
+        { DT_STRTAB,  { ro + l->dynstr_off } },
+        { DT_SYMTAB,  { ro + l->dynsym_off } },
+        { DT_STRSZ,   { l->dynstr_size } },
+        { DT_SYMENT,  { sizeof(Elf64_Sym) } },
+        { DT_RELA,    { ro + l->rela_off } },
+        { DT_RELASZ,  { nimports * sizeof(Elf64_Rela) } },
+        { DT_RELAENT, { sizeof(Elf64_Rela) } },
+        { DT_FLAGS,   { DF_BIND_NOW } },
+        { DT_FLAGS_1, { DF_1_NOW } },
+        { DT_DEBUG,   { 0 } },
+        { DT_NULL,    { 0 } },
+    };
+    memcpy(out + l->seg_off[SEG_DATA] + l->dynamic_off, dyn, sizeof(dyn));
+
+    memcpy(out + l->interp_off, INTERP_PATH, sizeof(INTERP_PATH));
+
+    Elf64_Ehdr *eh = (Elf64_Ehdr*)out;
+    memcpy(eh->e_ident, ELFMAG, SELFMAG);
+    eh->e_ident[EI_CLASS] = ELFCLASS64;
+    eh->e_ident[EI_DATA] = ELFDATA2LSB;
+    eh->e_ident[EI_VERSION] = EV_CURRENT;
+    eh->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh->e_type = ET_EXEC;
+    eh->e_machine = EM_X86_64;
+    eh->e_version = EV_CURRENT;
+    eh->e_entry = text_addr;
+    eh->e_phoff = sizeof(Elf64_Ehdr);
+    eh->e_ehsize = sizeof(Elf64_Ehdr);
+    eh->e_phentsize = sizeof(Elf64_Phdr);
+    eh->e_phnum = PHDR_COUNT;
+
+    uint64_t data_addr = l->seg_addr[SEG_DATA];
+    uint64_t data_memsz = l->seg_addr[SEG_BSS] + l->seg_size[SEG_BSS] - data_addr;
+    Elf64_Phdr *ph = (Elf64_Phdr*)(out + sizeof(Elf64_Ehdr));
+    ph[0] = (Elf64_Phdr){ PT_PHDR, PF_R, sizeof(Elf64_Ehdr), ro + sizeof(Elf64_Ehdr), ro + sizeof(Elf64_Ehdr),
+                          PHDR_COUNT * sizeof(Elf64_Phdr), PHDR_COUNT * sizeof(Elf64_Phdr), 8 };
+    ph[1] = (Elf64_Phdr){ PT_INTERP, PF_R, l->interp_off, ro + l->interp_off, ro + l->interp_off,
+                          sizeof(INTERP_PATH), sizeof(INTERP_PATH), 1 };
+    ph[2] = (Elf64_Phdr){ PT_LOAD, PF_R, 0, ro, ro,
+                          l->seg_size[SEG_RODATA], l->seg_size[SEG_RODATA], LINK_PAGE };
+    ph[3] = (Elf64_Phdr){ PT_LOAD, PF_R | PF_X, l->seg_off[SEG_TEXT], text_addr, text_addr,
+                          l->seg_size[SEG_TEXT], l->seg_size[SEG_TEXT], LINK_PAGE };
+    ph[4] = (Elf64_Phdr){ PT_LOAD, PF_R | PF_W, l->seg_off[SEG_DATA], data_addr, data_addr,
+                          l->seg_size[SEG_DATA], data_memsz, LINK_PAGE };
+    ph[5] = (Elf64_Phdr){ PT_DYNAMIC, PF_R | PF_W, l->seg_off[SEG_DATA] + l->dynamic_off,
+                          data_addr + l->dynamic_off, data_addr + l->dynamic_off,
+                          sizeof(dyn), sizeof(dyn), 8 };
+    ph[6] = (Elf64_Phdr){ PT_GNU_STACK, PF_R | PF_W, 0, 0, 0, 0, 0, 16 };
+
+    st = write_output(output_path, out, file_size, l->err, l->err_len);
+    free(out);
+    return st;
+}
+
+LinkStatus link_executable_in_process(const LinkInput *inputs, size_t count, const char *output_path,
+                                      char *err, size_t err_len) {
+    if (!inputs || count == 0 || !output_path) {
+        return link_error(err, err_len, LINK_FAILED, "nothing to link");
+    }
+    if (access(INTERP_PATH, R_OK) != 0) {
+        return link_error(err, err_len, LINK_UNSUPPORTED, "no glibc dynamic loader at %s", INTERP_PATH);
+    }
+
+    Linker l = {0};
+    l.arena = arena_create(64 * 1024);
+    l.objs = arena_calloc(l.arena, count * sizeof(LinkObject));
+    l.nobjs = count;
+    l.globals = hashmap_create(l.arena, 256);
+    l.comdats = hashmap_create(l.arena, 64);
+    l.import_map = hashmap_create(l.arena, 64);
+    dynarray_init_in_arena(&l.imports, l.arena, sizeof(const char*), 32);
+    dynarray_init_in_arena(&l.import_weak, l.arena, sizeof(bool), 32);
+    dynarray_init_in_arena(&l.got_locals, l.arena, sizeof(SymbolRef), 16);
+    l.err = err;
+    l.err_len = err_len;
+
+    LinkStatus st = link_all(&l, inputs, count, output_path);
+    arena_destroy(l.arena);
+    return st;
+}
+
+#else
+
+LinkStatus link_executable_in_process(const LinkInput *inputs, size_t count, const char *output_path,
+                                      char *err, size_t err_len) {
+    (void)inputs; (void)count; (void)output_path;
+    return link_error(err, err_len, LINK_UNSUPPORTED, "in-process linking needs x86-64 Linux");
+}
+
+#endif
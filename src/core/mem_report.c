@@ -0,0 +1,133 @@
+#include "core/mem_report.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Module rows come in pages so a new module never moves an existing row
+#define MEM_PAGE_SHIFT 6
+#define MEM_PAGE_ROWS  ((size_t)1 << MEM_PAGE_SHIFT)
+#define MEM_PAGES      1024
+
+typedef struct {
+    MemTally cats[MEM_CATEGORY_COUNT];
+} MemModuleRow;
+
+bool g_mem_report_enabled;
+
+static MemTally g_mem_kinds[MEM_CATEGORY_COUNT][MEM_KIND_COUNT + 1]; // Last slot: MEM_KIND_NONE
+static MemModuleRow *g_mem_pages[MEM_PAGES];
+static SourceId g_mem_module_limit;
+
+static _Thread_local SourceId t_mem_source;
+
+static const char *const MEM_CATEGORY_NAMES[MEM_CATEGORY_COUNT] = {
+    [MEM_TOKENS]  = "tokens",
+    [MEM_AST]     = "ast",
+    [MEM_TYPES]   = "types",
+    [MEM_SCOPES]  = "scopes",
+    [MEM_SYMBOLS] = "symbols",
+    [MEM_HASHMAP] = "hashmap",
+    [MEM_INTERN]  = "intern",
+    [MEM_MONO]    = "mono",
+};
+
+void mem_report_start(void) {
+    memset(g_mem_kinds, 0, sizeof(g_mem_kinds));
+    for (size_t i = 0; i < MEM_PAGES; i++) {
+        if (g_mem_pages[i]) memset(g_mem_pages[i], 0, MEM_PAGE_ROWS * sizeof(MemModuleRow));
+    }
+    g_mem_module_limit = 0;
+    g_mem_report_enabled = true;
+}
+
+void mem_report_stop(void) {
+    g_mem_report_enabled = false;
+}
+
+static void tally_add(MemTally *t, size_t bytes, size_t count) {
+    __atomic_fetch_add(&t->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&t->count, count, __ATOMIC_RELAXED);
+}
+
+static MemTally tally_load(const MemTally *t) {
+    return (MemTally){
+        .bytes = __atomic_load_n(&t->bytes, __ATOMIC_RELAXED),
+        .count = __atomic_load_n(&t->count, __ATOMIC_RELAXED),
+    };
+}
+
+/* Row of `file`, allocating its page on first use; NULL past the last page or out of memory. */
+static MemModuleRow *module_row(SourceId file, bool create) {
+    size_t page = file >> MEM_PAGE_SHIFT;
+    if (page >= MEM_PAGES) return NULL;
+
+    MemModuleRow *rows = __atomic_load_n(&g_mem_pages[page], __ATOMIC_ACQUIRE);
+    if (!rows && create) {
+        MemModuleRow *fresh = calloc(MEM_PAGE_ROWS, sizeof(MemModuleRow));
+        if (!fresh) return NULL;
+        if (__atomic_compare_exchange_n(&g_mem_pages[page], &rows, fresh, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            rows = fresh;
+        } else {
+            free(fresh); // Another thread won; `rows` now holds its page
+        }
+    }
+    return rows ? &rows[file & (MEM_PAGE_ROWS - 1)] : NULL;
+}
+
+void mem_account(MemCategory cat, int kind, SourceId file, size_t bytes, size_t count) {
+    if (cat >= MEM_CATEGORY_COUNT) return;
+    size_t slot = (kind >= 0 && kind < MEM_KIND_COUNT) ? (size_t)kind : MEM_KIND_COUNT;
+    tally_add(&g_mem_kinds[cat][slot], bytes, count);
+
+    if (file == SOURCE_NONE) file = t_mem_source;
+    MemModuleRow *row = module_row(file, true);
+    if (!row) {
+        file = SOURCE_NONE;
+        row = module_row(file, true);
+        if (!row) return;
+    }
+    tally_add(&row->cats[cat], bytes, count);
+
+    SourceId limit = __atomic_load_n(&g_mem_module_limit, __ATOMIC_RELAXED);
+    while (file >= limit &&
+           !__atomic_compare_exchange_n(&g_mem_module_limit, &limit, file + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+SourceId mem_report_set_source(SourceId file) {
+    SourceId previous = t_mem_source;
+    t_mem_source = file;
+    return previous;
+}
+
+MemTally mem_report_category(MemCategory cat) {
+    MemTally total = {0};
+    if (cat >= MEM_CATEGORY_COUNT) return total;
+    for (size_t k = 0; k <= MEM_KIND_COUNT; k++) {
+        MemTally t = tally_load(&g_mem_kinds[cat][k]);
+        total.bytes += t.bytes;
+        total.count += t.count;
+    }
+    return total;
+}
+
+MemTally mem_report_kind(MemCategory cat, int kind) {
+    if (cat >= MEM_CATEGORY_COUNT) return (MemTally){0};
+    size_t slot = (kind >= 0 && kind < MEM_KIND_COUNT) ? (size_t)kind : MEM_KIND_COUNT;
+    return tally_load(&g_mem_kinds[cat][slot]);
+}
+
+MemTally mem_report_module(SourceId file, MemCategory cat) {
+    if (cat >= MEM_CATEGORY_COUNT) return (MemTally){0};
+    MemModuleRow *row = module_row(file, false);
+    return row ? tally_load(&row->cats[cat]) : (MemTally){0};
+}
+
+SourceId mem_report_module_limit(void) {
+    return __atomic_load_n(&g_mem_module_limit, __ATOMIC_RELAXED);
+}
+
+const char *mem_category_name(MemCategory cat) {
+    return cat < MEM_CATEGORY_COUNT ? MEM_CATEGORY_NAMES[cat] : "?";
+}
@@ -0,0 +1,1109 @@
+#include "module_cache.h"
+#include "core/utils.h"
+#include "core/source_map.h"
+#include "parsing/parser.h"
+#include "datastructures/hash_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+#endif
+
+// Bump whenever the AST layout or the encoding below changes; old entries
+// then simply stop matching their key.
+#define CACHE_FORMAT_VERSION 12
+#define CACHE_MAGIC "NTC"
+#define INTERFACE_MAGIC "NTI"
+
+// Which interner an InternResult* came from.
+enum { REF_NULL, REF_KEYWORD, REF_IDENTIFIER, REF_STRING };
+
+uint64_t module_cache_key(const char *src, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a 64-bit */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)src[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= CACHE_FORMAT_VERSION;
+    h *= 0x100000001b3ULL;
+    return h;
+}
+
+static void entry_path(char *buf, size_t size, const char *cache_dir, uint64_t key, bool interface) {
+    snprintf(buf, size, "%s/%016llx.%s", cache_dir, (unsigned long long)key, interface ? "nti" : "ntc");
+}
+
+// -----------------------------------------------------------------------------
+// Encoding
+// -----------------------------------------------------------------------------
+//
+// Integers are LEB128 varints (signed ones zigzagged), so spans and counts
+// cost a byte or two. Nullable children and arrays are written as 0 for NULL
+// and value+1 otherwise.
+//
+// Interned names go into a table at the head of the entry, each distinct one
+// once, and the tree refers to them by index. Decoding interns every name a
+// single time instead of once per occurrence; a std module names `self`,
+// `len` and its own types hundreds of times.
+
+typedef struct CacheWriter {
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;
+    bool interface;     // Write parsed bodies as their byte range (.nti)
+    DenseArenaInterner *keywords;
+    DenseArenaInterner *identifiers;
+    DenseArenaInterner *strings;
+    HashMap *name_ids;              // InternResult* -> index + 1 in the table
+    size_t name_count;
+    struct CacheWriter *names;      // The name table: tag, length, bytes
+} CacheWriter;
+
+static void put_bytes(CacheWriter *w, const void *data, size_t n) {
+    if (w->failed) return;
+    if (w->len + n > w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 4096;
+        while (cap < w->len + n) cap *= 2;
+        unsigned char *grown = realloc(w->buf, cap);
+        if (!grown) { w->failed = true; return; }
+        w->buf = grown;
+        w->cap = cap;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_u8(CacheWriter *w, uint8_t v) {
+    put_bytes(w, &v, 1);
+}
+
+static void put_uv(CacheWriter *w, uint64_t v) {
+    unsigned char tmp[10];
+    size_t n = 0;
+    do {
+        uint8_t byte = v & 0x7f;
+        v >>= 7;
+        tmp[n++] = byte | (v ? 0x80 : 0);
+    } while (v);
+    put_bytes(w, tmp, n);
+}
+
+static void put_sv(CacheWriter *w, int64_t v) {
+    put_uv(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+// File ids are per process: a span is stored as start + 1 (0 for none) and
+// length, and the reader stamps in the id of the file it is loading
+static void put_span(CacheWriter *w, const Span *s) {
+    if (s->file == SOURCE_NONE) {
+        put_uv(w, 0);
+        return;
+    }
+    put_uv(w, (uint64_t)s->start + 1);
+    put_uv(w, s->end - s->start);
+}
+
+static void put_ref(CacheWriter *w, InternResult *r) {
+    if (!r) { put_uv(w, 0); return; }
+
+    uintptr_t id = (uintptr_t)ptrmap_get(w->name_ids, r);
+    if (!id) {
+        Slice *key = (Slice*)r->key;
+        uint8_t tag;
+        if (intern_peek(w->identifiers, key) == r) tag = REF_IDENTIFIER;
+        else if (intern_peek(w->keywords, key) == r) tag = REF_KEYWORD;
+        else if (intern_peek(w->strings, key) == r) tag = REF_STRING;
+        else { w->failed = true; return; } // Not from a loader interner: do not cache
+
+        put_u8(w->names, tag);
+        put_uv(w->names, key->len);
+        put_bytes(w->names, key->ptr, key->len);
+        id = ++w->name_count;
+        ptrmap_put(w->name_ids, r, (void*)id);
+    }
+    put_uv(w, id);
+}
+
+static void put_node(CacheWriter *w, AstNode *node);
+
+static void put_nodes(CacheWriter *w, DynArray *arr) {
+    if (!arr) { put_uv(w, 0); return; }
+    put_uv(w, arr->count + 1);
+    for (size_t i = 0; i < arr->count; i++) {
+        put_node(w, *(AstNode**)dynarray_get(arr, i));
+    }
+}
+
+static void put_refs(CacheWriter *w, DynArray *arr) {
+    if (!arr) { put_uv(w, 0); return; }
+    put_uv(w, arr->count + 1);
+    for (size_t i = 0; i < arr->count; i++) {
+        put_ref(w, *(InternResult**)dynarray_get(arr, i));
+    }
+}
+
+static void put_literal(CacheWriter *w, const ConstValue *lit) {
+    put_uv(w, lit->type);
+    switch (lit->type) {
+        case INT_LITERAL:    put_sv(w, lit->value.int_val); break;
+        case FLOAT_LITERAL:  put_bytes(w, &lit->value.float_val, sizeof(double)); break;
+        case BOOL_LITERAL:   put_uv(w, lit->value.bool_val ? 1 : 0); break;
+        case CHAR_LITERAL:   put_u8(w, (uint8_t)lit->value.char_val); break;
+        case STRING_LITERAL: put_ref(w, lit->value.string_val); break;
+        case NULL_LITERAL:   break;
+    }
+}
+
+static void put_type(CacheWriter *w, const AstType *ty) {
+    put_uv(w, ty->kind);
+    put_span(w, &ty->span);
+    switch (ty->kind) {
+        case AST_TYPE_PRIMITIVE:
+            put_ref(w, ty->u.base.intern_result);
+            put_node(w, ty->u.base.path);
+            break;
+        case AST_TYPE_PTR:
+            put_node(w, ty->u.ptr.target);
+            break;
+        case AST_TYPE_ARRAY:
+        case AST_TYPE_VECTOR:
+            put_node(w, ty->u.array.elem);
+            put_node(w, ty->u.array.size_expr);
+            break;
+        case AST_TYPE_FUNC:
+            put_nodes(w, ty->u.func.param_types);
+            put_node(w, ty->u.func.return_type);
+            break;
+        case AST_TYPE_APPLICATION:
+            put_node(w, ty->u.application.base);
+            put_nodes(w, ty->u.application.args);
+            break;
+    }
+}
+
+static void put_loop_hints(CacheWriter *w, const LoopHints *h) {
+    put_uv(w, h->unroll);
+    put_uv(w, h->vectorize);
+    put_u8(w, h->nounroll);
+}
+
+static void put_node(CacheWriter *w, AstNode *node) {
+    if (!node) { put_uv(w, 0); return; }
+    put_uv(w, (uint64_t)node->node_type + 1);
+    put_span(w, &node->span);
+
+    switch (node->node_type) {
+        case AST_PROGRAM:
+            put_nodes(w, node->data.program.decls);
+            break;
+
+        case AST_VARIABLE_DECLARATION: {
+            AstVariableDeclaration *v = &node->data.variable_declaration;
+            put_node(w, v->type);
+            put_ref(w, v->intern_result);
+            put_uv(w, v->is_const);
+            put_uv(w, v->is_pub);
+            put_node(w, v->initializer);
+            break;
+        }
+
+        case AST_FUNCTION_DECLARATION: {
+            AstFunctionDeclaration *f = &node->data.function_declaration;
+            put_node(w, f->return_type);
+            put_ref(w, f->intern_result);
+            put_refs(w, f->type_params);
+            put_nodes(w, f->const_params);
+            put_node(w, f->target_type_node);
+            put_nodes(w, f->params);
+            // A skimmed body is kept as its byte range: start + 1 (0 = none), length.
+            // An interface summary keeps every body that way.
+            uint32_t body_start = f->body_start, body_end = f->body_end;
+            bool deferred = !f->body && f->lazy_body;
+            if (w->interface && f->body) {
+                body_start = f->body->span.start;
+                body_end = f->body->span.end;
+                deferred = true;
+            }
+            put_node(w, deferred ? NULL : f->body);
+            put_uv(w, deferred ? (uint64_t)body_start + 1 : 0);
+            if (deferred) put_uv(w, body_end - body_start);
+            put_ref(w, f->link_name);
+            put_uv(w, f->is_pub);
+            put_uv(w, f->attrs);
+            break;
+        }
+
+        case AST_PARAM: {
+            AstParam *prm = &node->data.param;
+            put_ref(w, prm->name_idx >= 0 ? interner_get_result(w->identifiers, prm->name_idx) : NULL);
+            put_node(w, prm->type);
+            put_u8(w, prm->is_noalias);
+            break;
+        }
+
+        case AST_STRUCT_DECLARATION: {
+            AstStructDeclaration *s = &node->data.struct_declaration;
+            put_ref(w, s->intern_result);
+            put_refs(w, s->type_params);
+            put_nodes(w, s->const_params);
+            if (!s->fields) {
+                put_uv(w, 0);
+            } else {
+                put_uv(w, s->fields->count + 1);
+                for (size_t i = 0; i < s->fields->count; i++) {
+                    AstFieldDecl *fd = (AstFieldDecl*)dynarray_get(s->fields, i);
+                    put_ref(w, fd->name);
+                    put_node(w, fd->type);
+                }
+            }
+            put_nodes(w, s->methods);
+            put_uv(w, s->is_pub);
+            put_uv(w, s->attrs);
+            put_uv(w, s->align);
+            break;
+        }
+
+        case AST_ENUM_DECLARATION: {
+            AstEnumDeclaration *e = &node->data.enum_declaration;
+            put_ref(w, e->intern_result);
+            if (!e->variants) {
+                put_uv(w, 0);
+            } else {
+                put_uv(w, e->variants->count + 1);
+                for (size_t i = 0; i < e->variants->count; i++) {
+                    AstEnumVariant *ev = (AstEnumVariant*)dynarray_get(e->variants, i);
+                    put_ref(w, ev->name);
+                    put_node(w, ev->value);
+                }
+            }
+            put_uv(w, e->is_pub);
+            break;
+        }
+
+        case AST_IMPL_DECLARATION: {
+            AstImplDeclaration *impl = &node->data.impl_declaration;
+            put_node(w, impl->target_type_node);
+            put_refs(w, impl->type_params);
+            put_nodes(w, impl->methods);
+            break;
+        }
+
+        case AST_IMPORT_DECLARATION: {
+            // resolved_logical_path is filled in again by the loader.
+            AstImportDeclaration *imp = &node->data.import_declaration;
+            put_refs(w, imp->module_path);
+            put_ref(w, imp->module_alias);
+            if (!imp->specific_symbols) {
+                put_uv(w, 0);
+            } else {
+                put_uv(w, imp->specific_symbols->count + 1);
+                for (size_t i = 0; i < imp->specific_symbols->count; i++) {
+                    ImportSymbol *sym = *(ImportSymbol**)dynarray_get(imp->specific_symbols, i);
+                    put_ref(w, sym->original_name);
+                    put_ref(w, sym->alias_name);
+                }
+            }
+            put_uv(w, imp->leading_dots);
+            put_u8(w, imp->is_root_relative);
+            put_u8(w, imp->is_star);
+            put_u8(w, imp->is_pub);
+            break;
+        }
+
+        case AST_ALIAS_DECLARATION:
+            put_ref(w, node->data.alias_declaration.alias_name);
+            put_node(w, node->data.alias_declaration.target);
+            break;
+
+        case AST_INTRINSIC:
+            put_uv(w, node->data.intrinsic.kind);
+            put_nodes(w, node->data.intrinsic.args);
+            break;
+
+        case AST_BLOCK:
+            put_nodes(w, node->data.block.statements);
+            break;
+
+        case AST_IF_STATEMENT:
+            put_node(w, node->data.if_statement.condition);
+            put_node(w, node->data.if_statement.then_branch);
+            put_node(w, node->data.if_statement.else_branch);
+            break;
+
+        case AST_WHILE_STATEMENT:
+            put_node(w, node->data.while_statement.condition);
+            put_node(w, node->data.while_statement.body);
+            put_loop_hints(w, &node->data.while_statement.hints);
+            break;
+
+        case AST_FOR_STATEMENT:
+            put_node(w, node->data.for_statement.init);
+            put_node(w, node->data.for_statement.condition);
+            put_node(w, node->data.for_statement.post);
+            put_node(w, node->data.for_statement.range);
+            put_node(w, node->data.for_statement.body);
+            put_loop_hints(w, &node->data.for_statement.hints);
+            break;
+
+        case AST_SWITCH_STATEMENT:
+            put_node(w, node->data.switch_statement.subject);
+            put_nodes(w, node->data.switch_statement.cases);
+            put_node(w, node->data.switch_statement.else_body);
+            break;
+
+        case AST_SWITCH_CASE:
+            put_nodes(w, node->data.switch_case.values);
+            put_node(w, node->data.switch_case.body);
+            break;
+
+        case AST_RETURN_STATEMENT:
+            put_node(w, node->data.return_statement.expression);
+            break;
+
+        case AST_DEFER_STATEMENT:
+            put_node(w, node->data.defer_statement.body);
+            break;
+
+        case AST_BREAK_STATEMENT:
+        case AST_CONTINUE_STATEMENT:
+            break;
+
+        case AST_EXPR_STATEMENT:
+            put_node(w, node->data.expr_statement.expression);
+            break;
+
+        case AST_LITERAL:
+            put_literal(w, &node->data.literal);
+            break;
+
+        case AST_IDENTIFIER:
+            put_ref(w, node->data.identifier.intern_result);
+            break;
+
+        case AST_BINARY_EXPR:
+            put_uv(w, node->data.binary_expr.op);
+            put_node(w, node->data.binary_expr.left);
+            put_node(w, node->data.binary_expr.right);
+            break;
+
+        case AST_UNARY_EXPR:
+            put_uv(w, node->data.unary_expr.op);
+            put_node(w, node->data.unary_expr.expr);
+            break;
+
+        case AST_POSTFIX_EXPR:
+            put_uv(w, node->data.postfix_expr.op);
+            put_node(w, node->data.postfix_expr.expr);
+            break;
+
+        case AST_ASSIGNMENT_EXPR:
+            put_uv(w, node->data.assignment_expr.op);
+            put_node(w, node->data.assignment_expr.lvalue);
+            put_node(w, node->data.assignment_expr.rvalue);
+            break;
+
+        case AST_CALL_EXPR:
+            put_node(w, node->data.call_expr.callee);
+            put_nodes(w, node->data.call_expr.args);
+            break;
+
+        case AST_GENERIC_INST_EXPR:
+            put_node(w, node->data.generic_inst_expr.base);
+            put_nodes(w, node->data.generic_inst_expr.type_args);
+            break;
+
+        case AST_SUBSCRIPT_EXPR:
+            put_node(w, node->data.subscript_expr.target);
+            put_node(w, node->data.subscript_expr.index);
+            break;
+
+        case AST_MEMBER_EXPR:
+            put_node(w, node->data.member_expr.target);
+            put_ref(w, node->data.member_expr.member);
+            put_u8(w, node->data.member_expr.is_instance_method);
+            put_u8(w, node->data.member_expr.self_injected);
+            break;
+
+        case AST_STRUCT_LITERAL: {
+            AstStructLiteral *sl = &node->data.struct_literal;
+            put_node(w, sl->type_node);
+            if (!sl->fields) {
+                put_uv(w, 0);
+            } else {
+                put_uv(w, sl->fields->count + 1);
+                for (size_t i = 0; i < sl->fields->count; i++) {
+                    AstFieldInit *fi = (AstFieldInit*)dynarray_get(sl->fields, i);
+                    put_ref(w, fi->name);
+                    put_node(w, fi->expr);
+                }
+            }
+            break;
+        }
+
+        case AST_CAST:
+            put_node(w, node->data.cast_expr.expr);
+            put_node(w, node->data.cast_expr.target_type_node);
+            break;
+
+        case AST_TYPE:
+            put_type(w, &node->data.ast_type);
+            break;
+
+        case AST_INITIALIZER_LIST:
+            put_nodes(w, node->data.initializer_list.elements);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Decoding
+// -----------------------------------------------------------------------------
+
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    bool ok;
+    Arena *arena;
+    const char *filename;
+    SourceId file;
+    DenseArenaInterner *keywords;
+    DenseArenaInterner *identifiers;
+    DenseArenaInterner *strings;
+    InternResult **names;   // The entry's name table, interned up front
+    size_t name_count;
+    LazyBodySource *lazy;   // Shared by this module's deferred bodies, made on first use
+} CacheReader;
+
+static LazyBodySource *reader_lazy_source(CacheReader *r) {
+    if (r->lazy) return r->lazy;
+    size_t len = 0;
+    const char *text = source_text(r->file, &len);
+    if (!text) return NULL;
+    LazyBodySource *src = arena_alloc(r->arena, sizeof(LazyBodySource));
+    if (!src) return NULL;
+    *src = (LazyBodySource){
+        .source = text, .len = len, .file = r->file, .filename = (char *)r->filename,
+        .keywords = r->keywords, .identifiers = r->identifiers, .strings = r->strings,
+    };
+    r->lazy = src;
+    return src;
+}
+
+static uint8_t get_u8(CacheReader *r) {
+    if (!r->ok || r->p >= r->end) { r->ok = false; return 0; }
+    return *r->p++;
+}
+
+static uint64_t get_uv(CacheReader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = get_u8(r);
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return v;
+    }
+    r->ok = false;
+    return 0;
+}
+
+static int64_t get_sv(CacheReader *r) {
+    uint64_t v = get_uv(r);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static const unsigned char *get_bytes(CacheReader *r, size_t n) {
+    if (!r->ok || (size_t)(r->end - r->p) < n) { r->ok = false; return NULL; }
+    const unsigned char *at = r->p;
+    r->p += n;
+    return at;
+}
+
+static void get_span(CacheReader *r, Span *s) {
+    uint64_t start = get_uv(r);
+    if (start == 0) {
+        *s = (Span){0, 0, 0};
+        return;
+    }
+    s->file = r->file;
+    s->start = (uint32_t)(start - 1);
+    s->end = s->start + (uint32_t)get_uv(r);
+}
+
+static InternResult *get_ref(CacheReader *r) {
+    uint64_t id = get_uv(r);
+    if (id == 0) return NULL;
+    if (id > r->name_count) { r->ok = false; return NULL; }
+    return r->names[id - 1];
+}
+
+// Interns the entry's name table into r->names (malloc'd, freed by the caller).
+static bool get_names(CacheReader *r) {
+    uint64_t count = get_uv(r);
+    // Every name takes at least two bytes, which bounds corrupt counts.
+    if (!r->ok || count > (uint64_t)(r->end - r->p) / 2) return false;
+    r->names = malloc((count ? count : 1) * sizeof(InternResult*));
+    if (!r->names) return false;
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint8_t tag = get_u8(r);
+        uint64_t len = get_uv(r);
+        const unsigned char *bytes = get_bytes(r, len);
+        if (!bytes) return false;
+        Slice s = { .ptr = (const char*)bytes, .len = (uint32_t)len };
+
+        InternResult *res = NULL;
+        switch (tag) {
+            case REF_KEYWORD:    res = intern_peek(r->keywords, &s); break;
+            case REF_IDENTIFIER: res = intern(r->identifiers, &s, NULL); break;
+            case REF_STRING:     res = intern(r->strings, &s, NULL); break;
+            default: break;
+        }
+        if (!res) return false;
+        r->names[r->name_count++] = res;
+    }
+    return true;
+}
+
+// Count prefix of a nullable array: returns false for NULL, else sets *count.
+static bool get_count(CacheReader *r, size_t *count) {
+    uint64_t n = get_uv(r);
+    if (n == 0 || !r->ok) return false;
+    // Every element takes at least one byte, which bounds corrupt counts.
+    if (n - 1 > (uint64_t)(r->end - r->p)) { r->ok = false; return false; }
+    *count = (size_t)(n - 1);
+    return true;
+}
+
+static DynArray *new_array(CacheReader *r, size_t elem_size, size_t count) {
+    DynArray *arr = arena_alloc(r->arena, sizeof(DynArray));
+    if (!arr) { r->ok = false; return NULL; }
+    dynarray_init_in_arena(arr, r->arena, elem_size, count ? count : 1);
+    return arr;
+}
+
+static AstNode *get_node(CacheReader *r);
+
+static DynArray *get_nodes(CacheReader *r) {
+    size_t count;
+    if (!get_count(r, &count)) return NULL;
+    DynArray *arr = new_array(r, sizeof(AstNode*), count);
+    for (size_t i = 0; r->ok && i < count; i++) {
+        AstNode *child = get_node(r);
+        dynarray_push_value(arr, &child);
+    }
+    return arr;
+}
+
+static DynArray *get_refs(CacheReader *r) {
+    size_t count;
+    if (!get_count(r, &count)) return NULL;
+    DynArray *arr = new_array(r, sizeof(InternResult*), count);
+    for (size_t i = 0; r->ok && i < count; i++) {
+        InternResult *res = get_ref(r);
+        dynarray_push_value(arr, &res);
+    }
+    return arr;
+}
+
+static void get_literal(CacheReader *r, ConstValue *lit) {
+    lit->type = (LiteralType)get_uv(r);
+    switch (lit->type) {
+        case INT_LITERAL:    lit->value.int_val = get_sv(r); break;
+        case FLOAT_LITERAL: {
+            const unsigned char *bytes = get_bytes(r, sizeof(double));
+            if (bytes) memcpy(&lit->value.float_val, bytes, sizeof(double));
+            break;
+        }
+        case BOOL_LITERAL:   lit->value.bool_val = (int)get_uv(r); break;
+        case CHAR_LITERAL:   lit->value.char_val = (char)get_u8(r); break;
+        case STRING_LITERAL: lit->value.string_val = get_ref(r); break;
+        case NULL_LITERAL:   lit->value.int_val = 0; break;
+        default:             r->ok = false; break;
+    }
+}
+
+static void get_type(CacheReader *r, AstType *ty) {
+    ty->kind = (AstTypeKind)get_uv(r);
+    get_span(r, &ty->span);
+    switch (ty->kind) {
+        case AST_TYPE_PRIMITIVE:
+            ty->u.base.intern_result = get_ref(r);
+            ty->u.base.path = get_node(r);
+            break;
+        case AST_TYPE_PTR:
+            ty->u.ptr.target = get_node(r);
+            break;
+        case AST_TYPE_ARRAY:
+        case AST_TYPE_VECTOR:
+            ty->u.array.elem = get_node(r);
+            ty->u.array.size_expr = get_node(r);
+            break;
+        case AST_TYPE_FUNC:
+            ty->u.func.param_types = get_nodes(r);
+            ty->u.func.return_type = get_node(r);
+            break;
+        case AST_TYPE_APPLICATION:
+            ty->u.application.base = get_node(r);
+            ty->u.application.args = get_nodes(r);
+            break;
+        default:
+            r->ok = false;
+            break;
+    }
+}
+
+static void get_loop_hints(CacheReader *r, LoopHints *h) {
+    h->unroll = (uint32_t)get_uv(r);
+    h->vectorize = (uint32_t)get_uv(r);
+    h->nounroll = get_u8(r) != 0;
+}
+
+static AstNode *get_node(CacheReader *r) {
+    uint64_t tag = get_uv(r);
+    if (tag == 0 || !r->ok) return NULL;
+    if (tag - 1 > AST_INITIALIZER_LIST) { r->ok = false; return NULL; }
+
+    AstNode *node = ast_create_node((AstNodeType)(tag - 1), r->arena, r->file);
+    if (!node) { r->ok = false; return NULL; }
+    get_span(r, &node->span);
+    node->span.file = r->file; // Nodes stay attributed to the module even without a span
+
+    switch (node->node_type) {
+        case AST_PROGRAM:
+            node->data.program.decls = get_nodes(r);
+            break;
+
+        case AST_VARIABLE_DECLARATION: {
+            AstVariableDeclaration *v = &node->data.variable_declaration;
+            v->type = get_node(r);
+            v->intern_result = get_ref(r);
+            v->is_const = (int)get_uv(r);
+            v->is_pub = (int)get_uv(r);
+            v->initializer = get_node(r);
+            break;
+        }
+
+        case AST_FUNCTION_DECLARATION: {
+            AstFunctionDeclaration *f = &node->data.function_declaration;
+            f->return_type = get_node(r);
+            f->intern_result = get_ref(r);
+            f->type_params = get_refs(r);
+            f->const_params = get_nodes(r);
+            f->target_type_node = get_node(r);
+            f->params = get_nodes(r);
+            f->body = get_node(r);
+            uint64_t body_start = get_uv(r);
+            if (body_start) {
+                f->body_start = (uint32_t)(body_start - 1);
+                f->body_end = f->body_start + (uint32_t)get_uv(r);
+                f->lazy_body = reader_lazy_source(r);
+                if (!f->lazy_body || f->body_end > f->lazy_body->len) r->ok = false;
+            }
+            f->link_name = get_ref(r);
+            f->is_pub = (int)get_uv(r);
+            f->attrs = (uint8_t)get_uv(r);
+            break;
+        }
+
+        case AST_PARAM: {
+            InternResult *name = get_ref(r);
+            node->data.param.name_idx = name ? name->entry->dense_index : -1;
+            node->data.param.type = get_node(r);
+            node->data.param.is_noalias = get_u8(r) != 0;
+            break;
+        }
+
+        case AST_STRUCT_DECLARATION: {
+            AstStructDeclaration *s = &node->data.struct_declaration;
+            s->intern_result = get_ref(r);
+            s->type_params = get_refs(r);
+            s->const_params = get_nodes(r);
+            size_t count;
+            if (get_count(r, &count)) {
+                s->fields = new_array(r, sizeof(AstFieldDecl), count);
+                for (size_t i = 0; r->ok && i < count; i++) {
+                    AstFieldDecl fd = {0};
+                    fd.name = get_ref(r);
+                    fd.type = get_node(r);
+                    dynarray_push_value(s->fields, &fd);
+                }
+            }
+            s->methods = get_nodes(r);
+            s->is_pub = (int)get_uv(r);
+            s->attrs = (uint8_t)get_uv(r);
+            s->align = (uint32_t)get_uv(r);
+            break;
+        }
+
+        case AST_ENUM_DECLARATION: {
+            AstEnumDeclaration *e = &node->data.enum_declaration;
+            e->intern_result = get_ref(r);
+            size_t count;
+            if (get_count(r, &count)) {
+                e->variants = new_array(r, sizeof(AstEnumVariant), count);
+                for (size_t i = 0; r->ok && i < count; i++) {
+                    AstEnumVariant ev = {0};
+                    ev.name = get_ref(r);
+                    ev.value = get_node(r);
+                    dynarray_push_value(e->variants, &ev);
+                }
+            }
+            e->is_pub = (int)get_uv(r);
+            break;
+        }
+
+        case AST_IMPL_DECLARATION: {
+            AstImplDeclaration *impl = &node->data.impl_declaration;
+            impl->target_type_node = get_node(r);
+            impl->type_params = get_refs(r);
+            impl->methods = get_nodes(r);
+            break;
+        }
+
+        case AST_IMPORT_DECLARATION: {
+            AstImportDeclaration *imp = &node->data.import_declaration;
+            imp->module_path = get_refs(r);
+            imp->module_alias = get_ref(r);
+            size_t count;
+            if (get_count(r, &count)) {
+                imp->specific_symbols = new_array(r, sizeof(ImportSymbol*), count);
+                for (size_t i = 0; r->ok && i < count; i++) {
+                    ImportSymbol *sym = arena_alloc(r->arena, sizeof(ImportSymbol));
+                    if (!sym) { r->ok = false; break; }
+                    sym->original_name = get_ref(r);
+                    sym->alias_name = get_ref(r);
+                    dynarray_push_value(imp->specific_symbols, &sym);
+                }
+            }
+            imp->leading_dots = (int)get_uv(r);
+            imp->is_root_relative = get_u8(r) != 0;
+            imp->is_star = get_u8(r) != 0;
+            imp->is_pub = get_u8(r) != 0;
+            if (!imp->module_path) r->ok = false;
+            break;
+        }
+
+        case AST_ALIAS_DECLARATION:
+            node->data.alias_declaration.alias_name = get_ref(r);
+            node->data.alias_declaration.target = get_node(r);
+            break;
+
+        case AST_INTRINSIC:
+            node->data.intrinsic.kind = (IntrinsicKind)get_uv(r);
+            node->data.intrinsic.args = get_nodes(r);
+            break;
+
+        case AST_BLOCK:
+            node->data.block.statements = get_nodes(r);
+            break;
+
+        case AST_IF_STATEMENT:
+            node->data.if_statement.condition = get_node(r);
+            node->data.if_statement.then_branch = get_node(r);
+            node->data.if_statement.else_branch = get_node(r);
+            break;
+
+        case AST_WHILE_STATEMENT:
+            node->data.while_statement.condition = get_node(r);
+            node->data.while_statement.body = get_node(r);
+            get_loop_hints(r, &node->data.while_statement.hints);
+            break;
+
+        case AST_FOR_STATEMENT:
+            node->data.for_statement.init = get_node(r);
+            node->data.for_statement.condition = get_node(r);
+            node->data.for_statement.post = get_node(r);
+            node->data.for_statement.range = get_node(r);
+            node->data.for_statement.body = get_node(r);
+            get_loop_hints(r, &node->data.for_statement.hints);
+            break;
+
+        case AST_SWITCH_STATEMENT:
+            node->data.switch_statement.subject = get_node(r);
+            node->data.switch_statement.cases = get_nodes(r);
+            node->data.switch_statement.else_body = get_node(r);
+            break;
+
+        case AST_SWITCH_CASE:
+            node->data.switch_case.values = get_nodes(r);
+            node->data.switch_case.body = get_node(r);
+            break;
+
+        case AST_RETURN_STATEMENT:
+            node->data.return_statement.expression = get_node(r);
+            break;
+
+        case AST_DEFER_STATEMENT:
+            node->data.defer_statement.body = get_node(r);
+            break;
+
+        case AST_BREAK_STATEMENT:
+        case AST_CONTINUE_STATEMENT:
+            break;
+
+        case AST_EXPR_STATEMENT:
+            node->data.expr_statement.expression = get_node(r);
+            break;
+
+        case AST_LITERAL:
+            get_literal(r, &node->data.literal);
+            break;
+
+        case AST_IDENTIFIER:
+            node->data.identifier.intern_result = get_ref(r);
+            break;
+
+        case AST_BINARY_EXPR:
+            node->data.binary_expr.op = (OpKind)get_uv(r);
+            node->data.binary_expr.left = get_node(r);
+            node->data.binary_expr.right = get_node(r);
+            break;
+
+        case AST_UNARY_EXPR:
+            node->data.unary_expr.op = (OpKind)get_uv(r);
+            node->data.unary_expr.expr = get_node(r);
+            break;
+
+        case AST_POSTFIX_EXPR:
+            node->data.postfix_expr.op = (OpKind)get_uv(r);
+            node->data.postfix_expr.expr = get_node(r);
+            break;
+
+        case AST_ASSIGNMENT_EXPR:
+            node->data.assignment_expr.op = (OpKind)get_uv(r);
+            node->data.assignment_expr.lvalue = get_node(r);
+            node->data.assignment_expr.rvalue = get_node(r);
+            break;
+
+        case AST_CALL_EXPR:
+            node->data.call_expr.callee = get_node(r);
+            node->data.call_expr.args = get_nodes(r);
+            break;
+
+        case AST_GENERIC_INST_EXPR:
+            node->data.generic_inst_expr.base = get_node(r);
+            node->data.generic_inst_expr.type_args = get_nodes(r);
+            break;
+
+        case AST_SUBSCRIPT_EXPR:
+            node->data.subscript_expr.target = get_node(r);
+            node->data.subscript_expr.index = get_node(r);
+            break;
+
+        case AST_MEMBER_EXPR:
+            node->data.member_expr.target = get_node(r);
+            node->data.member_expr.member = get_ref(r);
+            node->data.member_expr.is_instance_method = get_u8(r) != 0;
+            node->data.member_expr.self_injected = get_u8(r) != 0;
+            break;
+
+        case AST_STRUCT_LITERAL: {
+            AstStructLiteral *sl = &node->data.struct_literal;
+            sl->type_node = get_node(r);
+            size_t count;
+            if (get_count(r, &count)) {
+                sl->fields = new_array(r, sizeof(AstFieldInit), count);
+                for (size_t i = 0; r->ok && i < count; i++) {
+                    AstFieldInit fi = {0};
+                    fi.name = get_ref(r);
+                    fi.expr = get_node(r);
+                    dynarray_push_value(sl->fields, &fi);
+                }
+            }
+            break;
+        }
+
+        case AST_CAST:
+            node->data.cast_expr.expr = get_node(r);
+            node->data.cast_expr.target_type_node = get_node(r);
+            break;
+
+        case AST_TYPE:
+            get_type(r, &node->data.ast_type);
+            break;
+
+        case AST_INITIALIZER_LIST:
+            node->data.initializer_list.elements = get_nodes(r);
+            break;
+    }
+    return node;
+}
+
+// -----------------------------------------------------------------------------
+// Entries
+// -----------------------------------------------------------------------------
+//
+// Layout: "NTC" ("NTI" for an interface summary), then varints (format
+// version, key, source length), then the name table (a count, then tag,
+// length and bytes per name), then the program node. Anything that does not
+// match is treated as a miss.
+
+// Maps the entry read-only (read into memory on Windows); NULL on a miss.
+static const unsigned char *map_entry(const char *path, size_t *size) {
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *buf = n > 0 ? malloc((size_t)n) : NULL;
+    if (!buf) { fclose(f); return NULL; }
+    *size = fread(buf, 1, (size_t)n, f);
+    fclose(f);
+    return buf;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return NULL; }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return map;
+#endif
+}
+
+static void unmap_entry(const unsigned char *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free((void*)data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+static AstNode *fetch_entry(const char *cache_dir, uint64_t key, size_t src_len, bool interface,
+                            Arena *arena, const char *filename, SourceId file,
+                            DenseArenaInterner *keywords,
+                            DenseArenaInterner *identifiers,
+                            DenseArenaInterner *strings) {
+    char path[4096];
+    entry_path(path, sizeof(path), cache_dir, key, interface);
+
+    size_t size = 0;
+    const unsigned char *data = map_entry(path, &size);
+    if (!data) return NULL;
+
+    CacheReader r = {
+        .p = data, .end = data + size, .ok = true,
+        .arena = arena, .filename = filename, .file = file,
+        .keywords = keywords, .identifiers = identifiers, .strings = strings,
+    };
+
+    AstNode *root = NULL;
+    const unsigned char *magic = get_bytes(&r, 3);
+    if (magic && memcmp(magic, interface ? INTERFACE_MAGIC : CACHE_MAGIC, 3) == 0 &&
+        get_uv(&r) == CACHE_FORMAT_VERSION &&
+        get_uv(&r) == key &&
+        get_uv(&r) == src_len && r.ok &&
+        get_names(&r)) {
+        root = get_node(&r);
+    }
+    // Interned keys are copies, so nothing decoded points into the mapping
+    free(r.names);
+    unmap_entry(data, size);
+
+    if (!r.ok || r.p != r.end || !root || root->node_type != AST_PROGRAM || !root->data.program.decls) {
+        return NULL;
+    }
+    return root;
+}
+
+static void ensure_dir(const char *dir) {
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+}
+
+static bool store_entry(const char *cache_dir, uint64_t key, size_t src_len, bool interface, AstNode *ast,
+                        DenseArenaInterner *keywords,
+                        DenseArenaInterner *identifiers,
+                        DenseArenaInterner *strings) {
+    if (!ast || ast->node_type != AST_PROGRAM) return false;
+
+    CacheWriter names = { 0 };
+    CacheWriter w = {
+        .interface = interface, .keywords = keywords, .identifiers = identifiers, .strings = strings,
+        .name_ids = hashmap_create(NULL, 256), .names = &names,
+    };
+    put_node(&w, ast);
+    hashmap_destroy(w.name_ids, NULL, NULL);
+
+    CacheWriter head = { 0 };
+    put_bytes(&head, interface ? INTERFACE_MAGIC : CACHE_MAGIC, 3);
+    put_uv(&head, CACHE_FORMAT_VERSION);
+    put_uv(&head, key);
+    put_uv(&head, src_len);
+    put_uv(&head, w.name_count);
+    if (w.failed || names.failed || head.failed) {
+        free(w.buf); free(names.buf); free(head.buf);
+        return false;
+    }
+
+    ensure_dir(cache_dir);
+
+    char path[4096], tmp_path[4096 + 32];
+    entry_path(path, sizeof(path), cache_dir, key, interface);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *f = fopen(tmp_path, "wb");
+    bool ok = f != NULL;
+    if (f) {
+        ok = fwrite(head.buf, 1, head.len, f) == head.len &&
+             fwrite(names.buf, 1, names.len, f) == names.len &&
+             fwrite(w.buf, 1, w.len, f) == w.len;
+        ok = (fclose(f) == 0) && ok;
+    }
+    free(head.buf); free(names.buf); free(w.buf);
+    if (!f) return false;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        // On Windows rename() refuses to replace an existing entry; the one
+        // already there is for the same content, so that is not an error.
+        remove(tmp_path);
+        return ok;
+    }
+    return true;
+}
+
+AstNode *module_cache_fetch(const char *cache_dir, uint64_t key, size_t src_len,
+                            Arena *arena, const char *filename, SourceId file,
+                            DenseArenaInterner *keywords,
+                            DenseArenaInterner *identifiers,
+                            DenseArenaInterner *strings) {
+    return fetch_entry(cache_dir, key, src_len, false, arena, filename, file, keywords, identifiers, strings);
+}
+
+bool module_cache_store(const char *cache_dir, uint64_t key, size_t src_len, AstNode *ast,
+                        DenseArenaInterner *keywords,
+                        DenseArenaInterner *identifiers,
+                        DenseArenaInterner *strings) {
+    return store_entry(cache_dir, key, src_len, false, ast, keywords, identifiers, strings);
+}
+
+AstNode *module_cache_fetch_interface(const char *cache_dir, uint64_t key, size_t src_len,
+                                      Arena *arena, const char *filename, SourceId file,
+                                      DenseArenaInterner *keywords,
+                                      DenseArenaInterner *identifiers,
+                                      DenseArenaInterner *strings) {
+    return fetch_entry(cache_dir, key, src_len, true, arena, filename, file, keywords, identifiers, strings);
+}
+
+bool module_cache_store_interface(const char *cache_dir, uint64_t key, size_t src_len, AstNode *ast,
+                                  DenseArenaInterner *keywords,
+                                  DenseArenaInterner *identifiers,
+                                  DenseArenaInterner *strings) {
+    return store_entry(cache_dir, key, src_len, true, ast, keywords, identifiers, strings);
+}
@@ -1,17 +1,22 @@
 #include "module_loader.h"
 #include "file.h"
+#include "module_cache.h"
 #include "lexing/lexer.h"
 #include "parsing/parser.h"
 #include "parsing/parse_statements.h"
 #include "parsing/parse_declarations.h"
 #include "core/utils.h"
+#include "core/trace.h"
+#include "core/mem_report.h"
 #include "core/exit_codes.h"
+#include "core/stats.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -23,9 +28,12 @@
 #else
     #include <unistd.h>
     #include <sys/stat.h>
+    #include <dirent.h>
 #endif
 
 #define MAX_RECURSION_DEPTH 256
+#define LOAD_INTERN_SHARDS 32
+#define TOKEN_ARENA_SIZE (64 * 1024) // Per-file lexer and token chunks (parse_module_file)
 
 typedef struct {
     char *buf;
@@ -79,6 +87,39 @@ static void strbuf_append_fmt(StrBuf *sb, const char *fmt, ...) {
     }
 }
 
+/*
+ * Import resolution cache. Every importer of std.vec builds the same
+ * candidate path, so the answers are kept: `import_files` maps the base path
+ * of an import (".../std/vec") to the file it names, `files` maps a module
+ * path to its absolute path. Below the library root each directory is listed
+ * once and existence and canonical form are read from the listings, so a
+ * library import needs no stat or realpath at all. The parallel load's
+ * workers share the cache; `lock` guards the maps and the loader arena they
+ * allocate from, but not the filesystem calls.
+ */
+typedef struct ResolveCache {
+    pthread_mutex_t lock;
+    HashMap *import_files;  // char* (import base path) -> char* (candidate file)
+    HashMap *files;         // char* (module path) -> char* (absolute path)
+    HashMap *library_dirs;  // char* (directory) -> HashMap* (char* entry name -> LibraryEntry)
+} ResolveCache;
+
+typedef enum {
+    LIBRARY_MISSING = 0,
+    LIBRARY_FILE,
+    LIBRARY_DIR,
+    LIBRARY_UNKNOWN,        // Symlink, special name or unreadable: ask the filesystem
+} LibraryEntry;
+
+static ResolveCache *resolve_cache_create(Arena *arena) {
+    ResolveCache *cache = arena_alloc(arena, sizeof(ResolveCache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->import_files = hashmap_create(arena, 64);
+    cache->files = hashmap_create(arena, 64);
+    cache->library_dirs = hashmap_create(arena, 16);
+    return cache;
+}
+
 ModuleLoader* module_loader_create(Arena *arena, Options *opts, 
                                    DenseArenaInterner *keywords, 
                                    DenseArenaInterner *identifiers, 
@@ -92,10 +133,13 @@ ModuleLoader* module_loader_create(Arena *arena, Options *opts,
 
     loader->units = hashmap_create(arena, 64);
     loader->units_by_logical_path = hashmap_create(arena, 64);
+    loader->units_by_file = hashmap_create(arena, 64);
     loader->units_ordered = arena_alloc(arena, sizeof(DynArray));
     dynarray_init_in_arena(loader->units_ordered, arena, sizeof(CompilationUnit*), 8);
 
     loader->project_root = NULL;
+    loader->stdlib_root = NULL;
+    loader->resolve_cache = resolve_cache_create(arena);
 
     return loader;
 }
@@ -128,94 +172,415 @@ CompilationUnit* module_loader_get_unit(ModuleLoader *loader, const char *path)
     return (CompilationUnit*)hashmap_get(loader->units, (void*)path, str_hash, str_cmp);
 }
 
-static bool file_exists(const char *path) {
+CompilationUnit* module_loader_unit_for_file(ModuleLoader *loader, SourceId file) {
+    if (file == SOURCE_NONE) return NULL;
+    return (CompilationUnit*)ptrmap_get(loader->units_by_file, (void*)(uintptr_t)file);
+}
+
+static char *arena_copy_str(Arena *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = arena_alloc(arena, len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+/* The path below the library root ("std/vec.nt"), or NULL outside it. */
+static const char *library_relative(ModuleLoader *loader, const char *path) {
+    const char *root = loader->stdlib_root;
+    if (!root) return NULL;
+    size_t len = strlen(root);
+    return strncmp(path, root, len) == 0 && path[len] == '/' ? path + len + 1 : NULL;
+}
+
+/* Entries of library directory `dir`, listed on first use. Lock held. */
+static HashMap *library_listing(ModuleLoader *loader, const char *dir) {
+#ifdef _WIN32
+    (void)loader; (void)dir;
+    return NULL;
+#else
+    ResolveCache *cache = loader->resolve_cache;
+    HashMap *listing = hashmap_get(cache->library_dirs, (void*)dir, str_hash, str_cmp);
+    if (listing) return listing;
+
+    // A directory that cannot be read keeps an empty listing: nothing is there
+    STAT_INC(MODULE_FS_PROBES);
+    listing = hashmap_create(loader->arena, 16);
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while (d && (entry = readdir(d))) {
+        if (entry->d_name[0] == '.') continue;
+        LibraryEntry kind = entry->d_type == DT_REG ? LIBRARY_FILE
+                          : entry->d_type == DT_DIR ? LIBRARY_DIR : LIBRARY_UNKNOWN;
+        hashmap_put(listing, arena_copy_str(loader->arena, entry->d_name), (void*)(uintptr_t)kind, str_hash, str_cmp);
+    }
+    if (d) closedir(d);
+    hashmap_put(cache->library_dirs, arena_copy_str(loader->arena, dir), listing, str_hash, str_cmp);
+    return listing;
+#endif
+}
+
+/*
+ * What `path` is according to the library listings. A path whose components
+ * are all plain entries is already canonical (the root is), anything else
+ * is LIBRARY_UNKNOWN, including every path outside the library.
+ */
+static LibraryEntry library_entry(ModuleLoader *loader, const char *path) {
+    const char *rel = library_relative(loader, path);
+    if (!rel) return LIBRARY_UNKNOWN;
+
+    ArenaScratch scratch = arena_scratch_begin();
+    char *buf = arena_copy_str(scratch.arena, path);
+    char *comp = buf + (rel - path);
+    LibraryEntry kind = LIBRARY_UNKNOWN;
+
+    pthread_mutex_lock(&loader->resolve_cache->lock);
+    for (;;) {
+        char *slash = strchr(comp, '/');
+        if (slash) *slash = '\0';
+        comp[-1] = '\0';   // `buf` is now the directory holding `comp`
+        HashMap *listing = library_listing(loader, buf);
+        comp[-1] = '/';
+
+        bool special = !*comp || strcmp(comp, ".") == 0 || strcmp(comp, "..") == 0;
+        kind = special || !listing ? LIBRARY_UNKNOWN
+             : (LibraryEntry)(uintptr_t)hashmap_get(listing, comp, str_hash, str_cmp);
+        if (!slash || kind != LIBRARY_DIR) {
+            // Nothing lives below a file or a missing entry
+            if (slash && kind == LIBRARY_FILE) kind = LIBRARY_MISSING;
+            break;
+        }
+        comp = slash + 1;
+    }
+    pthread_mutex_unlock(&loader->resolve_cache->lock);
+
+    arena_scratch_end(scratch);
+    return kind;
+}
+
+static bool file_exists(ModuleLoader *loader, const char *path) {
+    LibraryEntry kind = library_entry(loader, path);
+    if (kind != LIBRARY_UNKNOWN) return kind == LIBRARY_FILE;
+
+    STAT_INC(MODULE_FS_PROBES);
     struct stat st;
     return stat(path, &st) == 0 && S_ISREG(st.st_mode);
 }
 
-int load_module_recursive(ModuleLoader *loader, const char *path, const char *logical_path, const char *importer_path, int depth) {
-    if (depth > MAX_RECURSION_DEPTH) {
-        fprintf(stderr, "Error: Maximum recursion depth (%d) exceeded while loading modules.\n", MAX_RECURSION_DEPTH);
-        return EXIT_IO;
+/* Absolute, symlink-free form of an existing `path` (malloc'd), or NULL. */
+static char *canonical_path(ModuleLoader *loader, const char *path) {
+    LibraryEntry kind = library_entry(loader, path);
+    if (kind == LIBRARY_FILE || kind == LIBRARY_DIR) return xstrdup(path);
+    if (kind == LIBRARY_MISSING) return NULL;
+
+    STAT_INC(MODULE_FS_PROBES);
+    ArenaScratch scratch = arena_scratch_begin();
+    char *abs = get_absolute_path_real(scratch.arena, path);
+    char *result = abs ? xstrdup(abs) : NULL;
+    arena_scratch_end(scratch);
+    return result;
+}
+
+/*
+ * Canonicalize a module path, falling back to <path>/module.nt for packages.
+ * The result lives in the loader arena and is cached under both `path` and
+ * itself, so the file an import resolved to resolves again without a probe.
+ */
+static char *resolve_module_path(ModuleLoader *loader, const char *path, const char *importer_path) {
+    ResolveCache *cache = loader->resolve_cache;
+    STAT_INC(MODULE_RESOLVES);
+
+    pthread_mutex_lock(&cache->lock);
+    char *abs_path = hashmap_get(cache->files, (void*)path, str_hash, str_cmp);
+    pthread_mutex_unlock(&cache->lock);
+    if (abs_path) {
+        STAT_INC(MODULE_RESOLVE_HITS);
+        return abs_path;
     }
 
-    char *abs_path = get_absolute_path_real(loader->arena, path);
-    if (!abs_path) {
-        // Fallback for module.nt if path might be a directory
+    char *found = canonical_path(loader, path);
+    if (!found) {
+        ArenaScratch scratch = arena_scratch_begin();
         StrBuf fallback_sb;
-        strbuf_init(&fallback_sb, loader->arena);
+        strbuf_init(&fallback_sb, scratch.arena);
         strbuf_append_fmt(&fallback_sb, "%s/module.nt", path);
-        abs_path = get_absolute_path_real(loader->arena, fallback_sb.buf);
-        
-        if (!abs_path) {
-            if (importer_path) {
-                fprintf(stderr, "Error in %s: Could not resolve module path '%s'\n", importer_path, path);
-            } else {
-                fprintf(stderr, "Error: Could not resolve module path '%s'\n", path);
-            }
-            return EXIT_IO;
+        found = canonical_path(loader, fallback_sb.buf);
+        arena_scratch_end(scratch);
+    }
+
+    if (!found) {
+        if (importer_path) {
+            fprintf(stderr, "Error in %s: Could not resolve module path '%s'\n", importer_path, path);
+        } else {
+            fprintf(stderr, "Error: Could not resolve module path '%s'\n", path);
         }
+        return NULL;
     }
-    
-    // Set project_root on first call
-    if (!loader->project_root) {
-        char *dir = xstrdup(abs_path);
-        char *last_slash = strrchr(dir, '/');
-        if (last_slash) *last_slash = '\0';
-        loader->project_root = arena_alloc(loader->arena, strlen(dir) + 1);
-        strcpy(loader->project_root, dir);
-        free(dir);
+
+    pthread_mutex_lock(&cache->lock);
+    abs_path = hashmap_get(cache->files, found, str_hash, str_cmp);
+    if (!abs_path) {
+        abs_path = arena_copy_str(loader->arena, found);
+        hashmap_put(cache->files, abs_path, abs_path, str_hash, str_cmp);
     }
+    if (strcmp(path, abs_path) != 0) {
+        hashmap_put(cache->files, arena_copy_str(loader->arena, path), abs_path, str_hash, str_cmp);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    free(found);
+    return abs_path;
+}
 
-    // 1. Check if module is already loaded
-    CompilationUnit *unit = module_loader_get_unit(loader, abs_path);
-    if (unit) {
-        // Map to logical path if provided
-        if (logical_path) {
-            hashmap_put(loader->units_by_logical_path, (void*)logical_path, unit, str_hash, str_cmp);
-            if (!unit->logical_path) unit->logical_path = (char*)logical_path;
+/* Is `abs_path` inside the library directory (opts->stdlib_path)? */
+static bool is_library_path(ModuleLoader *loader, const char *abs_path) {
+    if (!loader->stdlib_root && loader->opts && loader->opts->stdlib_path) {
+        loader->stdlib_root = get_absolute_path_real(loader->arena, loader->opts->stdlib_path);
+    }
+    if (!loader->stdlib_root) return false;
+    size_t len = strlen(loader->stdlib_root);
+    return strncmp(abs_path, loader->stdlib_root, len) == 0 && abs_path[len] == '/';
+}
+
+static void set_project_root(ModuleLoader *loader, const char *abs_path) {
+    if (loader->project_root) return;
+    char *dir = xstrdup(abs_path);
+    char *last_slash = strrchr(dir, '/');
+    if (last_slash) *last_slash = '\0';
+    loader->project_root = arena_alloc(loader->arena, strlen(dir) + 1);
+    strcpy(loader->project_root, dir);
+    free(dir);
+}
+
+/* Directory of a module, used as the base for relative imports. */
+static void module_dir(StrBuf *sb, Arena *arena, const char *abs_path) {
+    strbuf_init(sb, arena);
+    const char *last_slash = strrchr(abs_path, '/');
+    if (last_slash) {
+        size_t len = (size_t)(last_slash - abs_path);
+        char *tmp = xmalloc(len + 1);
+        memcpy(tmp, abs_path, len);
+        tmp[len] = '\0';
+        strbuf_append(sb, tmp);
+        free(tmp);
+    } else {
+        strbuf_append(sb, ".");
+    }
+}
+
+/*
+ * Compute where an import points: the candidate file on disk and the logical
+ * module name. Either output may be NULL when the caller does not need it.
+ */
+static void import_target(ModuleLoader *loader, Arena *arena, const char *current_dir,
+                          const char *importer_logical, AstImportDeclaration *imp,
+                          char **out_file, char **out_logical) {
+    // Path pieces are built in scratch memory; only the outputs go to `arena`
+    ArenaScratch scratch = arena_scratch_begin();
+    StrBuf cp_sb, cl_sb;
+    strbuf_init(&cp_sb, scratch.arena);
+    strbuf_init(&cl_sb, scratch.arena);
+
+    for (size_t j = 0; j < imp->module_path->count; j++) {
+        InternResult *part = *(InternResult**)dynarray_get(imp->module_path, j);
+        Slice *s = (Slice*)part->key;
+        if (j > 0) strbuf_append(&cp_sb, "/");
+        strbuf_append_fmt(&cp_sb, "%.*s", (int)s->len, s->ptr);
+
+        if (j > 0) strbuf_append(&cl_sb, ".");
+        strbuf_append_fmt(&cl_sb, "%.*s", (int)s->len, s->ptr);
+    }
+
+    StrBuf mod_path_full_sb;
+    strbuf_init(&mod_path_full_sb, scratch.arena);
+    char *target_logical = NULL;
+
+    if (imp->leading_dots > 0) {
+        // Relative Import
+        StrBuf base_dir_sb;
+        strbuf_init(&base_dir_sb, scratch.arena);
+        strbuf_append(&base_dir_sb, current_dir);
+
+        // For .. or more, go up
+        for (int d = 1; d < imp->leading_dots; d++) {
+            char *up = strrchr(base_dir_sb.buf, '/');
+            if (up) {
+                *up = '\0';
+                base_dir_sb.len = strlen(base_dir_sb.buf);
+            }
         }
-        return EXIT_OK;
+
+        strbuf_append_fmt(&mod_path_full_sb, "%s/%s", base_dir_sb.buf, cp_sb.buf);
+
+        // Target logical name: importer's logical path + components_logical
+        if (importer_logical) {
+            size_t t_len = strlen(importer_logical) + cl_sb.len + 2;
+            target_logical = arena_alloc(arena, t_len);
+            snprintf(target_logical, t_len, "%s.%s", importer_logical, cl_sb.buf);
+        } else {
+            target_logical = arena_alloc(arena, cl_sb.len + 1);
+            strcpy(target_logical, cl_sb.buf);
+        }
+    } else if (imp->is_root_relative) {
+        // Root-relative Import
+        strbuf_append_fmt(&mod_path_full_sb, "%s/%s", loader->project_root, cp_sb.buf);
+        target_logical = arena_alloc(arena, cl_sb.len + 1);
+        strcpy(target_logical, cl_sb.buf);
+    } else {
+        // Absolute (Library) Import, below the resolved root so the listings answer it
+        const char *lib_root = loader->stdlib_root ? loader->stdlib_root : loader->opts->stdlib_path;
+        strbuf_append_fmt(&mod_path_full_sb, "%s/%s", lib_root, cp_sb.buf);
+        target_logical = arena_alloc(arena, cl_sb.len + 1);
+        strcpy(target_logical, cl_sb.buf);
     }
 
-    if (loader->opts->verbose) printf("Loading module: %s\n", abs_path);
+    if (out_logical) *out_logical = target_logical;
+    if (!out_file) {
+        arena_scratch_end(scratch);
+        return;
+    }
+
+    // Every importer of a module in the same directory asks the same question
+    ResolveCache *cache = loader->resolve_cache;
+    pthread_mutex_lock(&cache->lock);
+    *out_file = hashmap_get(cache->import_files, mod_path_full_sb.buf, str_hash, str_cmp);
+    pthread_mutex_unlock(&cache->lock);
+    if (*out_file) {
+        arena_scratch_end(scratch);
+        return;
+    }
+
+    // Try .nt then /module.nt
+    StrBuf target_file_sb;
+    strbuf_init(&target_file_sb, scratch.arena);
+    strbuf_append_fmt(&target_file_sb, "%s.nt", mod_path_full_sb.buf);
+
+    if (!file_exists(loader, target_file_sb.buf)) {
+         target_file_sb.len = 0;
+         target_file_sb.buf[0] = '\0';
+         strbuf_append_fmt(&target_file_sb, "%s/module.nt", mod_path_full_sb.buf);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    *out_file = arena_copy_str(loader->arena, target_file_sb.buf);
+    hashmap_put(cache->import_files, arena_copy_str(loader->arena, mod_path_full_sb.buf), *out_file, str_hash, str_cmp);
+    pthread_mutex_unlock(&cache->lock);
+    arena_scratch_end(scratch);
+}
+
+typedef struct {
+    AstNode *ast;
+    SourceId file;
+    uint64_t cache_key;     // Content hash of the source (--cache-dir only)
+    size_t source_len;
+    bool from_cache;
+    bool from_interface;
+} ParsedModule;
 
-    // 2. Read Source
-    char *raw_src = read_file(abs_path);
-    if (!raw_src) {
+/*
+ * Read, lex and parse one module into `arena`. The interners are the loader's
+ * shared ones. `diag_lock` (may be NULL) keeps multi-line diagnostics from
+ * interleaving when several workers fail at once. With a cache directory the
+ * AST is taken from there when the source is unchanged; an `imported` module
+ * comes from its interface summary when there is one.
+ */
+static int parse_module_file(ModuleLoader *loader, Arena *arena, char *abs_path, bool imported,
+                             pthread_mutex_t *diag_lock, ParsedModule *out) {
+    memset(out, 0, sizeof(*out));
+
+    // 1. Read Source
+    size_t src_len = 0;
+    char *src = read_file_into_arena(arena, abs_path, &src_len);
+    if (!src) {
         fprintf(stderr, "Error: Failed to read file: %s\n", abs_path);
         return EXIT_IO;
     }
-    size_t src_len = strlen(raw_src);
-    char *src = arena_alloc(loader->arena, src_len + 1);
-    memcpy(src, raw_src, src_len + 1);
-    free(raw_src);
+    out->source_len = src_len;
+    SourceId file = source_register(abs_path, src, src_len);
+    if (file == SOURCE_NONE) {
+        fprintf(stderr, "Error: Out of memory registering %s\n", abs_path);
+        return EXIT_IO;
+    }
+    out->file = file;
 
-    // 3. Lexing (Shared Interners)
-    Lexer *lexer = lexer_create_ex(src, src_len, loader->arena, loader->keywords, loader->identifiers, loader->strings);
-    if (!lexer_lex_all(lexer)) {
+    const char *cache_dir = loader->opts->cache_dir;
+    if (cache_dir) {
+        out->cache_key = module_cache_key(src, src_len);
+        if (imported && !is_library_path(loader, abs_path)) {
+            out->ast = module_cache_fetch_interface(cache_dir, out->cache_key, src_len, arena, abs_path, file,
+                                                    loader->keywords, loader->identifiers, loader->strings);
+            if (out->ast) {
+                if (loader->opts->verbose) printf("Loading module: %s (interface)\n", abs_path);
+                out->from_cache = out->from_interface = true;
+                return EXIT_OK;
+            }
+        }
+        out->ast = module_cache_fetch(cache_dir, out->cache_key, src_len, arena, abs_path, file,
+                                      loader->keywords, loader->identifiers, loader->strings);
+        if (out->ast) {
+            if (loader->opts->verbose) printf("Loading module: %s (cached)\n", abs_path);
+            out->from_cache = true;
+            return EXIT_OK;
+        }
+    }
+
+    if (loader->opts->verbose) printf("Loading module: %s\n", abs_path);
+
+    // 2. Lex and parse together (shared interners): the parser pulls tokens
+    // as it needs them, so the file's token array is never built. The lexer,
+    // its unescape buffers and the token chunks live in an arena of their
+    // own that is freed with the parse; the AST only holds interned records.
+    Arena *tokens = arena_create(TOKEN_ARENA_SIZE);
+    if (!tokens) {
+        fprintf(stderr, "Error: Out of memory lexing %s\n", abs_path);
+        return EXIT_IO;
+    }
+    SourceId old_mem_source = mem_report_set_source(file);
+    Lexer *lexer = lexer_create_ex(src, src_len, file, tokens, loader->keywords, loader->identifiers, loader->strings);
+    Parser *parser = lexer ? parser_create_streaming(lexer, abs_path, arena) : NULL;
+    // Generic bodies are re-parsed by every instance, so the template keeps
+    // none. Library bodies are only skimmed: most are never instantiated or
+    // called, and sema parses the rest on demand
+    if (parser && !parser_defer_bodies(parser, lexer, is_library_path(loader, abs_path))) parser = NULL;
+    if (!parser) {
+        mem_report_set_source(old_mem_source);
+        arena_destroy(tokens);
         fprintf(stderr, "Error: Lexing failed for %s\n", abs_path);
         return EXIT_LEX;
     }
 
-    // 4. Parsing
-    Parser *parser = parser_create(lexer->tokens, abs_path, loader->arena);
     ParseError parse_err = {0};
     AstNode *module_ast = parse_program(parser, &parse_err);
-    if (parse_err.message) {
+    mem_report_set_source(old_mem_source);
+    int status = EXIT_OK;
+    if (parser->stream_failed) {
+        fprintf(stderr, "Error: Lexing failed for %s\n", abs_path);
+        status = EXIT_LEX;
+    } else if (parse_err.message) {
+        if (diag_lock) pthread_mutex_lock(diag_lock);
         print_parse_error(&parse_err);
-        return EXIT_PARSE;
+        if (diag_lock) pthread_mutex_unlock(diag_lock);
+        status = EXIT_PARSE;
     }
+    arena_destroy(tokens); // After the error report, which points at a token
 
-    if (!module_ast) {
-        return EXIT_OK;
-    }
+    if (status == EXIT_OK) out->ast = module_ast;
+    return status;
+}
 
-    // Create CompilationUnit
-    unit = arena_alloc(loader->arena, sizeof(CompilationUnit));
+static CompilationUnit *create_unit(ModuleLoader *loader, char *abs_path, const char *logical_path, const ParsedModule *parsed) {
+    CompilationUnit *unit = arena_alloc(loader->arena, sizeof(CompilationUnit));
     unit->absolute_path = abs_path;
+    unit->file = parsed->file;
     unit->logical_path = (char*)logical_path; 
-    unit->ast_root = module_ast;
+    unit->ast_root = parsed->ast;
+    unit->cache_key = parsed->cache_key;
+    unit->source_len = parsed->source_len;
+    unit->from_cache = parsed->from_cache;
+    unit->from_interface = parsed->from_interface;
+    unit->is_library = is_library_path(loader, abs_path);
+    unit->prebuilt = false;
+    unit->bodies_checked = false;
+    unit->resident = false;
+    unit->body_objects = NULL;
     unit->global_scope = NULL; 
     unit->signatures_resolved = false;
     unit->imports_resolved = false;
@@ -224,113 +589,85 @@ int load_module_recursive(ModuleLoader *loader, const char *path, const char *lo
     if (unit->mono_instances) {
         dynarray_init_in_arena(unit->mono_instances, loader->arena, sizeof(AstNode*), 8);
     }
+    unit->mono_args = hashmap_create(loader->arena, 8);
     
     hashmap_put(loader->units, abs_path, unit, str_hash, str_cmp);
+    ptrmap_put(loader->units_by_file, (void*)(uintptr_t)unit->file, unit);
     if (logical_path) {
         hashmap_put(loader->units_by_logical_path, (void*)logical_path, unit, str_hash, str_cmp);
     }
+    return unit;
+}
+
+/* Map an already-loaded unit under one more logical path. */
+static void alias_unit(ModuleLoader *loader, CompilationUnit *unit, const char *logical_path) {
+    if (!logical_path) return;
+    hashmap_put(loader->units_by_logical_path, (void*)logical_path, unit, str_hash, str_cmp);
+    if (!unit->logical_path) unit->logical_path = (char*)logical_path;
+}
+
+static void forget_unit(ModuleLoader *loader, const char *abs_path, const char *logical_path) {
+    // M-2: Cleanup before returning failure
+    hashmap_remove(loader->units, (void*)abs_path, str_hash, str_cmp, NULL, NULL);
+    if (logical_path) {
+        hashmap_remove(loader->units_by_logical_path, (void*)logical_path, str_hash, str_cmp, NULL, NULL);
+    }
+}
+
+int load_module_recursive(ModuleLoader *loader, const char *path, const char *logical_path, const char *importer_path, int depth) {
+    if (depth > MAX_RECURSION_DEPTH) {
+        fprintf(stderr, "Error: Maximum recursion depth (%d) exceeded while loading modules.\n", MAX_RECURSION_DEPTH);
+        return EXIT_IO;
+    }
 
-    // 5. Recursive Loading
+    char *abs_path = resolve_module_path(loader, path, importer_path);
+    if (!abs_path) return EXIT_IO;
+    
+    // Set project_root on first call
+    set_project_root(loader, abs_path);
+
+    // 1. Check if module is already loaded
+    CompilationUnit *unit = module_loader_get_unit(loader, abs_path);
+    if (unit) {
+        alias_unit(loader, unit, logical_path);
+        return EXIT_OK;
+    }
+
+    // 2. Read, lex and parse
+    ParsedModule parsed;
+    trace_begin("module", abs_path);
+    int status = parse_module_file(loader, loader->arena, abs_path, importer_path != NULL, NULL, &parsed);
+    trace_end();
+    if (status != EXIT_OK) return status;
+
+    if (!parsed.ast) {
+        return EXIT_OK;
+    }
+
+    AstNode *module_ast = parsed.ast;
+    unit = create_unit(loader, abs_path, logical_path, &parsed);
+
+    // 3. Recursive Loading
     AstProgram *module_prog = &module_ast->data.program;
     
     // Get directory of current module for relative resolution
     StrBuf current_dir_sb;
-    strbuf_init(&current_dir_sb, loader->arena);
-    const char *last_slash = strrchr(abs_path, '/');
-    if (last_slash) {
-        size_t len = (size_t)(last_slash - abs_path);
-        char *tmp = xmalloc(len + 1);
-        memcpy(tmp, abs_path, len);
-        tmp[len] = '\0';
-        strbuf_append(&current_dir_sb, tmp);
-        free(tmp);
-    } else {
-        strbuf_append(&current_dir_sb, ".");
-    }
+    module_dir(&current_dir_sb, loader->arena, abs_path);
 
     for (size_t i = 0; i < module_prog->decls->count; i++) {
         AstNode *decl = *(AstNode**)dynarray_get(module_prog->decls, i);
         
         if (decl->node_type == AST_IMPORT_DECLARATION) {
-            AstImportDeclaration *imp = &decl->data.import_declaration;
-            
-            StrBuf cp_sb, cl_sb;
-            strbuf_init(&cp_sb, loader->arena);
-            strbuf_init(&cl_sb, loader->arena);
-            
-            for (size_t j = 0; j < imp->module_path->count; j++) {
-                InternResult *part = *(InternResult**)dynarray_get(imp->module_path, j);
-                Slice *s = (Slice*)part->key;
-                if (j > 0) strbuf_append(&cp_sb, "/");
-                strbuf_append_fmt(&cp_sb, "%.*s", (int)s->len, s->ptr);
-                
-                if (j > 0) strbuf_append(&cl_sb, ".");
-                strbuf_append_fmt(&cl_sb, "%.*s", (int)s->len, s->ptr);
-            }
-
-            StrBuf mod_path_full_sb;
-            strbuf_init(&mod_path_full_sb, loader->arena);
+            char *target_file = NULL;
             char *target_logical = NULL;
+            import_target(loader, loader->arena, current_dir_sb.buf, unit->logical_path,
+                          &decl->data.import_declaration, &target_file, &target_logical);
             
-            if (imp->leading_dots > 0) {
-                // Relative Import
-                StrBuf base_dir_sb;
-                strbuf_init(&base_dir_sb, loader->arena);
-                strbuf_append(&base_dir_sb, current_dir_sb.buf);
-                
-                // For .. or more, go up
-                for (int d = 1; d < imp->leading_dots; d++) {
-                    char *up = strrchr(base_dir_sb.buf, '/');
-                    if (up) {
-                        *up = '\0';
-                        base_dir_sb.len = strlen(base_dir_sb.buf);
-                    }
-                }
-                
-                strbuf_append_fmt(&mod_path_full_sb, "%s/%s", base_dir_sb.buf, cp_sb.buf);
-
-                // Target logical name: importer's logical path + components_logical
-                if (unit->logical_path) {
-                    size_t t_len = strlen(unit->logical_path) + cl_sb.len + 2;
-                    target_logical = arena_alloc(loader->arena, t_len);
-                    snprintf(target_logical, t_len, "%s.%s", unit->logical_path, cl_sb.buf);
-                } else {
-                    target_logical = arena_alloc(loader->arena, cl_sb.len + 1);
-                    strcpy(target_logical, cl_sb.buf);
-                }
-            } else if (imp->is_root_relative) {
-                // Root-relative Import
-                strbuf_append_fmt(&mod_path_full_sb, "%s/%s", loader->project_root, cp_sb.buf);
-                target_logical = arena_alloc(loader->arena, cl_sb.len + 1);
-                strcpy(target_logical, cl_sb.buf);
-            } else {
-                // Absolute (Library) Import
-                strbuf_append_fmt(&mod_path_full_sb, "%s/%s", loader->opts->stdlib_path, cp_sb.buf);
-                target_logical = arena_alloc(loader->arena, cl_sb.len + 1);
-                strcpy(target_logical, cl_sb.buf);
-            }
-
-            // Try .nt then /module.nt
-            StrBuf target_file_sb;
-            strbuf_init(&target_file_sb, loader->arena);
-            strbuf_append_fmt(&target_file_sb, "%s.nt", mod_path_full_sb.buf);
-            
-            if (!file_exists(target_file_sb.buf)) {
-                 target_file_sb.len = 0;
-                 target_file_sb.buf[0] = '\0';
-                 strbuf_append_fmt(&target_file_sb, "%s/module.nt", mod_path_full_sb.buf);
-            }
-            
-            int res = load_module_recursive(loader, target_file_sb.buf, target_logical, abs_path, depth + 1);
+            int res = load_module_recursive(loader, target_file, target_logical, abs_path, depth + 1);
             if (res == EXIT_OK) {
                 decl->data.import_declaration.resolved_logical_path = target_logical;
             } else {
-                // M-2: Cleanup before returning failure
-                hashmap_remove(loader->units, abs_path, str_hash, str_cmp, NULL, NULL);
-                if (logical_path) {
-                    hashmap_remove(loader->units_by_logical_path, (void*)logical_path, str_hash, str_cmp, NULL, NULL);
-                }
-                
+                forget_unit(loader, abs_path, logical_path);
                 return res;
             }
         }
@@ -341,3 +678,401 @@ int load_module_recursive(ModuleLoader *loader, const char *path, const char *lo
     
     return EXIT_OK;
 }
+
+// -----------------------------------------------------------------------------
+// Parallel loading
+// -----------------------------------------------------------------------------
+//
+// Files are read, lexed and parsed by a pool of worker threads. Every worker
+// owns a private arena; the shared interners run in sharded concurrent mode
+// for the duration of the load. Workers only resolve import *files* (which do not
+// depend on traversal order). Once the pool drains, the main thread replays
+// the serial depth-first walk over the parsed modules to assign logical
+// paths, create the CompilationUnits and build `units_ordered`, so the
+// result is identical to load_module_recursive().
+
+typedef struct {
+    char *abs_path;
+    int depth;              // Shortest import distance from the entry module
+    int status;             // EXIT_* from reading/lexing/parsing
+    ParsedModule parsed;
+    DynArray imports;       // char* absolute target per import decl (NULL: unresolved)
+    CompilationUnit *unit;
+    bool visited;           // Set during the serial replay
+} LoadJob;
+
+typedef struct {
+    ModuleLoader *loader;
+    pthread_mutex_t lock;   // Guards everything below
+    pthread_cond_t cond;
+    pthread_mutex_t diag_lock;
+    Arena *arena;           // LoadJob storage and `jobs` table
+    HashMap *jobs;          // char* (abs_path) -> LoadJob*
+    DynArray queue;         // LoadJob*, consumed from queue_head
+    size_t queue_head;
+    size_t pending;         // Jobs queued or in flight
+} LoadPool;
+
+typedef struct {
+    LoadPool *pool;
+    Arena *arena;
+    pthread_t thread;
+} LoadWorker;
+
+static LoadJob *load_pool_submit(LoadPool *pool, char *abs_path, int depth) {
+    pthread_mutex_lock(&pool->lock);
+    LoadJob *job = hashmap_get(pool->jobs, abs_path, str_hash, str_cmp);
+    if (!job) {
+        job = arena_calloc(pool->arena, sizeof(LoadJob));
+        job->abs_path = abs_path;
+        job->depth = depth;
+        hashmap_put(pool->jobs, abs_path, job, str_hash, str_cmp);
+        dynarray_push_value(&pool->queue, &job);
+        pool->pending++;
+        pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+static void load_job_run(LoadPool *pool, Arena *arena, LoadJob *job) {
+    ModuleLoader *loader = pool->loader;
+
+    if (job->depth > MAX_RECURSION_DEPTH) {
+        fprintf(stderr, "Error: Maximum recursion depth (%d) exceeded while loading modules.\n", MAX_RECURSION_DEPTH);
+        job->status = EXIT_IO;
+        return;
+    }
+
+    // Resident units (--serve) are already parsed; the replay reuses them.
+    if (module_loader_get_unit(loader, job->abs_path)) return;
+
+    trace_begin("module", job->abs_path);
+    job->status = parse_module_file(loader, arena, job->abs_path, job->depth > 0, &pool->diag_lock, &job->parsed);
+    trace_end();
+    if (job->status != EXIT_OK || !job->parsed.ast) return;
+
+    DynArray *decls = job->parsed.ast->data.program.decls;
+    dynarray_init_in_arena(&job->imports, arena, sizeof(char*), 4);
+
+    StrBuf current_dir_sb;
+    module_dir(&current_dir_sb, arena, job->abs_path);
+
+    for (size_t i = 0; i < decls->count; i++) {
+        AstNode *decl = *(AstNode**)dynarray_get(decls, i);
+        if (decl->node_type != AST_IMPORT_DECLARATION) continue;
+
+        char *target_file = NULL;
+        import_target(loader, arena, current_dir_sb.buf, NULL, &decl->data.import_declaration, &target_file, NULL);
+
+        char *target_abs = resolve_module_path(loader, target_file, job->abs_path);
+        if (target_abs) load_pool_submit(pool, target_abs, job->depth + 1);
+        dynarray_push_value(&job->imports, &target_abs);
+    }
+}
+
+static void *load_worker_main(void *arg) {
+    LoadWorker *worker = arg;
+    LoadPool *pool = worker->pool;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queue_head == pool->queue.count && pool->pending > 0) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (pool->queue_head == pool->queue.count) {
+            pthread_mutex_unlock(&pool->lock);
+            arena_scratch_release();
+            return NULL;
+        }
+        LoadJob *job = *(LoadJob**)dynarray_get(&pool->queue, pool->queue_head++);
+        pthread_mutex_unlock(&pool->lock);
+
+        load_job_run(pool, worker->arena, job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* Serial replay of load_module_recursive() over the pre-parsed jobs. */
+static int load_job_replay(ModuleLoader *loader, LoadPool *pool, LoadJob *job, const char *logical_path) {
+    if (job->visited) {
+        if (job->unit) alias_unit(loader, job->unit, logical_path);
+        return EXIT_OK;
+    }
+    job->visited = true;
+
+    CompilationUnit *resident = module_loader_get_unit(loader, job->abs_path);
+    if (resident) {
+        job->unit = resident;
+        alias_unit(loader, resident, logical_path);
+        return EXIT_OK;
+    }
+
+    if (job->status != EXIT_OK) return job->status;
+    if (!job->parsed.ast) return EXIT_OK;
+
+    CompilationUnit *unit = create_unit(loader, job->abs_path, logical_path, &job->parsed);
+    job->unit = unit;
+
+    AstProgram *module_prog = &job->parsed.ast->data.program;
+    StrBuf current_dir_sb;
+    module_dir(&current_dir_sb, loader->arena, job->abs_path);
+
+    size_t import_idx = 0;
+    for (size_t i = 0; i < module_prog->decls->count; i++) {
+        AstNode *decl = *(AstNode**)dynarray_get(module_prog->decls, i);
+        if (decl->node_type != AST_IMPORT_DECLARATION) continue;
+
+        char *target_abs = *(char**)dynarray_get(&job->imports, import_idx++);
+        LoadJob *child = target_abs ? hashmap_get(pool->jobs, target_abs, str_hash, str_cmp) : NULL;
+        if (!child) {
+            forget_unit(loader, job->abs_path, logical_path);
+            return EXIT_IO;
+        }
+
+        char *target_logical = NULL;
+        import_target(loader, loader->arena, current_dir_sb.buf, unit->logical_path,
+                      &decl->data.import_declaration, NULL, &target_logical);
+
+        int res = load_job_replay(loader, pool, child, target_logical);
+        if (res == EXIT_OK) {
+            decl->data.import_declaration.resolved_logical_path = target_logical;
+        } else {
+            forget_unit(loader, job->abs_path, logical_path);
+            return res;
+        }
+    }
+
+    dynarray_push_value(loader->units_ordered, &unit);
+    return EXIT_OK;
+}
+
+static int load_modules_parallel(ModuleLoader *loader, const char *path, int jobs) {
+    char *abs_path = resolve_module_path(loader, path, NULL);
+    if (!abs_path) return EXIT_IO;
+    set_project_root(loader, abs_path);
+
+    if (module_loader_get_unit(loader, abs_path)) return EXIT_OK;
+
+    LoadPool pool = {0};
+    pool.loader = loader;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    pthread_mutex_init(&pool.diag_lock, NULL);
+    pool.arena = arena_create(64 * 1024);
+    pool.jobs = hashmap_create(pool.arena, 64);
+    dynarray_init(&pool.queue, sizeof(LoadJob*));
+
+    // Keywords are only ever peeked while lexing, so they stay as they are.
+    if (!intern_table_begin_concurrent(loader->identifiers, LOAD_INTERN_SHARDS) ||
+        !intern_table_begin_concurrent(loader->strings, LOAD_INTERN_SHARDS)) {
+        intern_table_end_concurrent(loader->identifiers);
+        arena_destroy(pool.arena);
+        dynarray_free(&pool.queue);
+        pthread_mutex_destroy(&pool.diag_lock);
+        pthread_cond_destroy(&pool.cond);
+        pthread_mutex_destroy(&pool.lock);
+        return load_module_recursive(loader, path, NULL, NULL, 0);
+    }
+
+    LoadJob *root = load_pool_submit(&pool, abs_path, 0);
+
+    LoadWorker *workers = xmalloc(sizeof(LoadWorker) * (size_t)jobs);
+    int started = 0;
+    for (int i = 0; i < jobs; i++) {
+        workers[i].pool = &pool;
+        workers[i].arena = arena_create(1024 * 1024);
+        if (pthread_create(&workers[i].thread, NULL, load_worker_main, &workers[i]) != 0) {
+            arena_destroy(workers[i].arena);
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        // No threads available: drain the queue on this thread.
+        workers[0].arena = arena_create(1024 * 1024);
+        load_worker_main(&workers[0]);
+        started = 1;
+    } else {
+        for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+    }
+
+    intern_table_end_concurrent(loader->identifiers);
+    intern_table_end_concurrent(loader->strings);
+
+    int res = load_job_replay(loader, &pool, root, NULL);
+
+    // Parsed ASTs and job records live on; hand their memory to the loader.
+    for (int i = 0; i < started; i++) arena_merge(loader->arena, workers[i].arena);
+    arena_merge(loader->arena, pool.arena);
+    free(workers);
+
+    dynarray_free(&pool.queue);
+    pthread_mutex_destroy(&pool.diag_lock);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    return res;
+}
+
+/*
+ * Write an entry for every unit that was parsed from source this run, and an
+ * interface summary for every imported one that was not loaded from its own.
+ */
+static void store_cache_entries(ModuleLoader *loader, CompilationUnit *entry) {
+    const char *cache_dir = loader->opts->cache_dir;
+    for (size_t i = 0; i < loader->units_ordered->count; i++) {
+        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(loader->units_ordered, i);
+        if (unit->resident) continue;
+        if (!unit->from_cache &&
+            !module_cache_store(cache_dir, unit->cache_key, unit->source_len, unit->ast_root,
+                                loader->keywords, loader->identifiers, loader->strings)) {
+            if (loader->opts->verbose) printf("Could not cache module: %s\n", unit->absolute_path);
+        }
+        if (unit != entry && !unit->is_library && !unit->from_interface &&
+            !module_cache_store_interface(cache_dir, unit->cache_key, unit->source_len, unit->ast_root,
+                                          loader->keywords, loader->identifiers, loader->strings)) {
+            if (loader->opts->verbose) printf("Could not write interface summary: %s\n", unit->absolute_path);
+        }
+    }
+}
+
+int module_loader_load(ModuleLoader *loader, const char *path) {
+    int jobs = loader->opts ? loader->opts->jobs : 1;
+    // Resolve the library root up front; parse workers only read it
+    is_library_path(loader, path);
+    // Project files may come and go between --serve requests; the library
+    // listings are kept
+    ResolveCache *cache = loader->resolve_cache;
+    if (hashmap_size(cache->files) > 0) {
+        cache->import_files = hashmap_create(loader->arena, 64);
+        cache->files = hashmap_create(loader->arena, 64);
+    }
+    int res = jobs <= 1 ? load_module_recursive(loader, path, NULL, NULL, 0)
+                        : load_modules_parallel(loader, path, jobs);
+    if (res == EXIT_OK && loader->opts && loader->opts->cache_dir) {
+        // Post-order: the entry module is the last unit this load adds
+        DynArray *units = loader->units_ordered;
+        store_cache_entries(loader, units->count ? DYNARRAY_AT(CompilationUnit*, units, units->count - 1) : NULL);
+    }
+    return res;
+}
+
+// -----------------------------------------------------------------------------
+// Resident library (--serve)
+// -----------------------------------------------------------------------------
+
+#ifndef _WIN32
+/*
+ * Load the modules in `dir`, whose logical prefix is `prefix` (NULL at the
+ * root). A package's module.nt goes first, so its relative imports name
+ * the siblings ("std.mem", not "std.list.mem"); the rest follows in name
+ * order, which keeps the resident unit order the same on every start.
+ */
+static int preload_library_dir(ModuleLoader *loader, const char *dir, const char *prefix) {
+    struct dirent **entries = NULL;
+    int count = scandir(dir, &entries, NULL, alphasort);
+    if (count < 0) return EXIT_OK;
+
+    int res = EXIT_OK;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < count && res == EXIT_OK; i++) {
+            const char *name = entries[i]->d_name;
+            bool is_package_main = strcmp(name, "module.nt") == 0;
+            if (name[0] == '.' || is_package_main != (pass == 0)) continue;
+            if (is_package_main && !prefix) continue;
+
+            StrBuf path_sb, logical_sb;
+            strbuf_init(&path_sb, loader->arena);
+            strbuf_init(&logical_sb, loader->arena);
+            strbuf_append_fmt(&path_sb, "%s/%s", dir, name);
+
+            struct stat st;
+            if (stat(path_sb.buf, &st) != 0) continue;
+
+            // std/vec.nt -> "std.vec"; std/module.nt -> "std"
+            size_t len = strlen(name);
+            bool is_module = S_ISREG(st.st_mode) && len > 3 && strcmp(name + len - 3, ".nt") == 0;
+            if (!S_ISDIR(st.st_mode) && !is_module) continue;
+            if (prefix) strbuf_append(&logical_sb, prefix);
+            if (!is_package_main) {
+                if (prefix) strbuf_append(&logical_sb, ".");
+                strbuf_append_fmt(&logical_sb, "%.*s", (int)(is_module ? len - 3 : len), name);
+            }
+
+            if (is_module) {
+                res = load_module_recursive(loader, path_sb.buf, logical_sb.buf, NULL, 0);
+            } else {
+                res = preload_library_dir(loader, path_sb.buf, logical_sb.buf);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) free(entries[i]);
+    free(entries);
+    return res;
+}
+#endif
+
+int module_loader_preload_library(ModuleLoader *loader) {
+#ifdef _WIN32
+    fprintf(stderr, "Error: Preloading the library is not supported on this platform\n");
+    return EXIT_IO;
+#else
+    if (!loader->stdlib_root && loader->opts && loader->opts->stdlib_path) {
+        loader->stdlib_root = get_absolute_path_real(loader->arena, loader->opts->stdlib_path);
+    }
+    if (!loader->stdlib_root) {
+        fprintf(stderr, "Error: Could not resolve library path '%s'\n",
+                loader->opts && loader->opts->stdlib_path ? loader->opts->stdlib_path : "");
+        return EXIT_IO;
+    }
+
+    int res = preload_library_dir(loader, loader->stdlib_root, NULL);
+    loader->project_root = NULL;
+
+    for (size_t i = 0; i < loader->units_ordered->count; i++) {
+        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(loader->units_ordered, i);
+        unit->resident = true;
+    }
+    return res;
+#endif
+}
+
+/* Add `unit` and everything it imports to `seen`. */
+static void mark_reachable(ModuleLoader *loader, CompilationUnit *unit, HashMap *seen) {
+    if (ptrmap_get(seen, unit)) return;
+    ptrmap_put(seen, unit, unit);
+
+    DynArray *decls = unit->ast_root->data.program.decls;
+    for (size_t i = 0; i < decls->count; i++) {
+        AstNode *decl = *(AstNode**)dynarray_get(decls, i);
+        if (decl->node_type != AST_IMPORT_DECLARATION) continue;
+        const char *logical = decl->data.import_declaration.resolved_logical_path;
+        CompilationUnit *dep = logical ? hashmap_get(loader->units_by_logical_path, (void*)logical, str_hash, str_cmp) : NULL;
+        if (dep) mark_reachable(loader, dep, seen);
+    }
+}
+
+void module_loader_retain_reachable(ModuleLoader *loader, const char *path) {
+    char *abs_path = get_absolute_path_real(loader->arena, path);
+    CompilationUnit *entry = abs_path ? module_loader_get_unit(loader, abs_path) : NULL;
+    if (!entry) return;
+
+    // Filtering in place keeps the post-order of the full load.
+    HashMap *seen = hashmap_create(NULL, 64);
+    mark_reachable(loader, entry, seen);
+
+    DynArray *units = loader->units_ordered;
+    size_t kept = 0;
+    for (size_t i = 0; i < units->count; i++) {
+        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(units, i);
+        if (!ptrmap_get(seen, unit)) continue;
+        memcpy(dynarray_get(units, kept++), &unit, sizeof(unit));
+    }
+    units->count = kept;
+    hashmap_destroy(seen, NULL, NULL);
+}
@@ -1,5 +1,11 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
 
 #ifdef _WIN32
   #define RUNTIME_EXPORT __declspec(dllexport)
@@ -16,41 +22,201 @@ RUNTIME_EXPORT void print_str(const char *s);
 RUNTIME_EXPORT void print_char(char c);
 RUNTIME_EXPORT void print_ptr(void *p);
 RUNTIME_EXPORT void print_newline(void);
+RUNTIME_EXPORT void newt_print(const char *fmt, ...);
+RUNTIME_EXPORT void newt_set_print_sink(void *ctx, void (*sink)(void *ctx, const char *text, size_t len));
+
+typedef struct InstrumentRecord InstrumentRecord;
+RUNTIME_EXPORT void newt_instrument_enter(InstrumentRecord *rec);
+RUNTIME_EXPORT void newt_instrument_leave(InstrumentRecord *rec);
+RUNTIME_EXPORT void newt_instrument_report(void);
+
+static void *print_sink_ctx;
+static void (*print_sink)(void *ctx, const char *text, size_t len);
+
+RUNTIME_EXPORT void newt_set_print_sink(void *ctx, void (*sink)(void *ctx, const char *text, size_t len)) {
+    print_sink_ctx = ctx;
+    print_sink = sink;
+}
+
+// printf, or formatted into the sink std.io installed; a null ctx means none
+RUNTIME_EXPORT void newt_print(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (!print_sink_ctx) {
+        vprintf(fmt, ap);
+        va_end(ap);
+        return;
+    }
+    va_list again;
+    va_copy(again, ap);
+    char text[512];
+    int n = vsnprintf(text, sizeof(text), fmt, ap);
+    if (n >= 0 && (size_t)n < sizeof(text)) {
+        print_sink(print_sink_ctx, text, (size_t)n);
+    } else if (n >= 0) {
+        char *heap = malloc((size_t)n + 1);
+        if (heap) {
+            vsnprintf(heap, (size_t)n + 1, fmt, again);
+            print_sink(print_sink_ctx, heap, (size_t)n);
+            free(heap);
+        }
+    }
+    va_end(again);
+    va_end(ap);
+}
 
 RUNTIME_EXPORT void print_i32(int32_t val) {
-    printf("%d", val);
+    newt_print("%d", val);
 }
 
 RUNTIME_EXPORT void print_i64(int64_t val) {
-    printf("%lld", (long long)val);
+    newt_print("%lld", (long long)val);
 }
 
 RUNTIME_EXPORT void print_f32(float val) {
-    printf("%g", (double)val);
+    newt_print("%g", (double)val);
 }
 
 RUNTIME_EXPORT void print_f64(double val) {
-    printf("%g", val);
+    newt_print("%g", val);
 }
 
 RUNTIME_EXPORT void print_bool(int val) {
-    printf("%s", val ? "true" : "false");
+    newt_print("%s", val ? "true" : "false");
 }
 
 RUNTIME_EXPORT void print_str(const char *s) {
-    if (s) printf("%s", s);
-    else printf("(null)");
+    if (s) newt_print("%s", s);
+    else newt_print("(null)");
 }
 
 RUNTIME_EXPORT void print_char(char c) {
-    printf("%c", c);
+    newt_print("%c", c);
 }
 
 RUNTIME_EXPORT void print_ptr(void *p) {
-    if (p) printf("%p", p);
-    else printf("null");
+    if (p) newt_print("%p", p);
+    else newt_print("null");
 }
 
 RUNTIME_EXPORT void print_newline(void) {
-    printf("\n");
-}
\ No newline at end of file
+    newt_print("\n");
+}
+/*
+ * --instrument under --run (codegen_instrument.c). Executables carry the
+ * same routines as IR; a change to one is a change to the other. A record
+ * joins the list the first time its function is entered.
+ */
+struct InstrumentRecord {
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t self;
+    uint32_t active;     // Open activations, on any thread
+    uint32_t registered; // On `instrument_records`
+    const char *name;
+    InstrumentRecord *next;
+};
+
+typedef struct {
+    InstrumentRecord *rec;
+    uint64_t start;
+    uint64_t child; // Cycles of the calls it made
+    uint32_t outer; // Not a recursive activation: its cycles are inclusive
+} InstrumentFrame;
+
+// Frames per thread; deeper calls are counted but not timed
+#define INSTRUMENT_STACK_DEPTH 1024
+
+static InstrumentRecord *instrument_records;
+static _Thread_local uint32_t instrument_depth;
+static _Thread_local InstrumentFrame instrument_stack[INSTRUMENT_STACK_DEPTH];
+
+static inline uint64_t instrument_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    return (uint64_t)clock();
+#endif
+}
+
+RUNTIME_EXPORT void newt_instrument_enter(InstrumentRecord *rec) {
+    if (!__atomic_load_n(&rec->registered, __ATOMIC_ACQUIRE) && !__atomic_exchange_n(&rec->registered, 1, __ATOMIC_ACQ_REL)) {
+        InstrumentRecord *head = __atomic_load_n(&instrument_records, __ATOMIC_RELAXED);
+        do rec->next = head;
+        while (!__atomic_compare_exchange_n(&instrument_records, &head, rec, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    __atomic_fetch_add(&rec->calls, 1, __ATOMIC_RELAXED);
+    uint32_t depth = instrument_depth++;
+    if (depth >= INSTRUMENT_STACK_DEPTH) return;
+
+    uint32_t outer = 1;
+    if (__atomic_fetch_add(&rec->active, 1, __ATOMIC_RELAXED) != 0) {
+        // Active somewhere: recursive only if it is on this thread's stack
+        for (uint32_t i = 0; i < depth && outer; i++) outer = instrument_stack[i].rec != rec;
+    }
+    InstrumentFrame *frame = &instrument_stack[depth];
+    frame->rec = rec;
+    frame->child = 0;
+    frame->outer = outer;
+    frame->start = instrument_clock();
+}
+
+RUNTIME_EXPORT void newt_instrument_leave(InstrumentRecord *rec) {
+    uint32_t top = --instrument_depth;
+    if (top >= INSTRUMENT_STACK_DEPTH) return;
+
+    InstrumentFrame *frame = &instrument_stack[top];
+    uint64_t elapsed = instrument_clock() - frame->start;
+    __atomic_fetch_add(&rec->self, elapsed - frame->child, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&rec->active, 1, __ATOMIC_RELAXED);
+    if (frame->outer) __atomic_fetch_add(&rec->inclusive, elapsed, __ATOMIC_RELAXED);
+    if (top > 0) instrument_stack[top - 1].child += elapsed;
+}
+
+static int instrument_compare(const void *a, const void *b) {
+    uint64_t sa = (*(InstrumentRecord *const *)a)->self;
+    uint64_t sb = (*(InstrumentRecord *const *)b)->self;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/*
+ * Prints the functions entered so far by self cycles to $NEWT_INSTRUMENT_FILE
+ * or stderr, then forgets them: the records belong to the JIT's memory.
+ */
+RUNTIME_EXPORT void newt_instrument_report(void) {
+    InstrumentRecord *head = __atomic_exchange_n(&instrument_records, NULL, __ATOMIC_ACQ_REL);
+    size_t count = 0;
+    for (InstrumentRecord *r = head; r; r = r->next) count++;
+    if (count == 0) return;
+
+    InstrumentRecord **sorted = malloc(count * sizeof(*sorted));
+    if (!sorted) return;
+    uint64_t total = 0;
+    count = 0;
+    for (InstrumentRecord *r = head; r; r = r->next) {
+        sorted[count++] = r;
+        total += r->self;
+    }
+    qsort(sorted, count, sizeof(*sorted), instrument_compare);
+
+    fflush(NULL); // The program's own output comes first
+    const char *path = getenv("NEWT_INSTRUMENT_FILE");
+    FILE *out = path ? fopen(path, "w") : stderr;
+    if (out) {
+        fprintf(out, "%10s %17s %17s %7s  %s\n", "calls", "inclusive cycles", "self cycles", "self%", "function");
+        for (size_t i = 0; i < count; i++) {
+            InstrumentRecord *r = sorted[i];
+            double share = (double)r->self * 100.0 / (double)(total ? total : 1);
+            fprintf(out, "%10llu %17llu %17llu %6.2f%%  %s\n",
+                    (unsigned long long)r->calls, (unsigned long long)r->inclusive,
+                    (unsigned long long)r->self, share, r->name);
+        }
+        if (path) fclose(out);
+        else fflush(out);
+    }
+    free(sorted);
+}
@@ -0,0 +1,450 @@
+#include "server.h"
+#include "core/exit_codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// -----------------------------------------------------------------------------
+// Batch manifests
+// -----------------------------------------------------------------------------
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool batch_manifest_read(const char *path, const char *prog, BatchManifest *out) {
+    memset(out, 0, sizeof(*out));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Could not read batch manifest '%s'\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->text = malloc(size > 0 ? (size_t)size + 1 : 1);
+    size_t got = out->text && size > 0 ? fread(out->text, 1, (size_t)size, f) : 0;
+    fclose(f);
+    if (!out->text) return false;
+    out->text[got] = '\0';
+
+    // Every word needs at most one slot, plus the name and the terminator
+    size_t lines = 1, words = 0;
+    for (size_t i = 0; i < got; i++) {
+        if (out->text[i] == '\n') lines++;
+        if (!is_blank(out->text[i]) && out->text[i] != '\n' && (i == 0 || is_blank(out->text[i - 1]) || out->text[i - 1] == '\n')) words++;
+    }
+    out->entries = calloc(lines, sizeof(BatchEntry));
+    out->slots = calloc(words + 2 * lines, sizeof(char*));
+    if (!out->entries || !out->slots) {
+        batch_manifest_free(out);
+        return false;
+    }
+    char **slots = out->slots;
+
+    char *p = out->text;
+    for (int line = 1; *p; line++) {
+        char *end = strchr(p, '\n');
+        char *next = end ? end + 1 : p + strlen(p);
+        if (end) *end = '\0';
+        char *comment = strchr(p, '#');
+        if (comment) *comment = '\0';
+
+        BatchEntry *entry = &out->entries[out->count];
+        entry->argv = slots;
+        entry->line = line;
+        slots[entry->argc++] = (char*)prog;
+        for (char *word = strtok(p, " \t\r"); word; word = strtok(NULL, " \t\r")) {
+            slots[entry->argc++] = word;
+        }
+        if (entry->argc > 1) {
+            slots[entry->argc] = NULL;
+            slots += entry->argc + 1;
+            out->count++;
+        } else {
+            memset(entry, 0, sizeof(*entry));
+        }
+        p = next;
+    }
+    return true;
+}
+
+void batch_manifest_free(BatchManifest *manifest) {
+    free(manifest->slots);
+    free(manifest->entries);
+    free(manifest->text);
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+#ifdef _WIN32
+
+int server_batch(BatchManifest *manifest, int jobs, ServeHandler handler, void *arg) {
+    (void)manifest; (void)jobs; (void)handler; (void)arg;
+    fprintf(stderr, "Error: --batch is not supported on this platform\n");
+    return EXIT_IO;
+}
+
+int server_run(const char *socket_path, ServeHandler handler, void *arg) {
+    (void)socket_path; (void)handler; (void)arg;
+    fprintf(stderr, "Error: --serve is not supported on this platform\n");
+    return EXIT_IO;
+}
+
+int server_request(const char *socket_path, int argc, char **argv) {
+    (void)socket_path; (void)argc; (void)argv;
+    fprintf(stderr, "Error: --connect is not supported on this platform\n");
+    return EXIT_IO;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// Wire format: a RequestHeader sent together with the client's stdin,
+// stdout and stderr as SCM_RIGHTS, then `length` bytes of NUL-terminated
+// strings (working directory, argv[0], argv[1], ...). The reply is the
+// exit code as an int32_t.
+#define SERVE_MAGIC 0x4e545356u // "NTSV"
+#define SERVE_MAX_REQUEST (1u << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+} RequestHeader;
+
+static volatile sig_atomic_t g_stop_serving = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    g_stop_serving = 1;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool socket_address(struct sockaddr_un *addr, const char *path) {
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", path);
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+/* Child side of one connection: adopt the client's context, compile, reply. */
+static void serve_connection(int conn, ServeHandler handler, void *arg) {
+    RequestHeader hdr;
+    int fds[3];
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec iov = { &hdr, sizeof(hdr) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(conn, &msg, MSG_WAITALL) != (ssize_t)sizeof(hdr)) return;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (!cm || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        return;
+    }
+    memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    if (hdr.magic != SERVE_MAGIC || hdr.length == 0 || hdr.length > SERVE_MAX_REQUEST) return;
+
+    char *payload = malloc(hdr.length);
+    if (!payload || !read_all(conn, payload, hdr.length) || payload[hdr.length - 1] != '\0') {
+        free(payload);
+        return;
+    }
+
+    // Split into the working directory and a NULL-terminated argv
+    int argc = -1;
+    for (uint32_t i = 0; i < hdr.length; i++) {
+        if (payload[i] == '\0') argc++;
+    }
+    char **argv = calloc((size_t)argc + 1, sizeof(char*));
+    if (!argv) {
+        free(payload);
+        return;
+    }
+    char *p = payload + strlen(payload) + 1;
+    for (int i = 0; i < argc; i++) {
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+
+    int32_t code = EXIT_IO;
+    if (chdir(payload) != 0) {
+        fprintf(stderr, "Error: Compile server cannot enter '%s': %s\n", payload, strerror(errno));
+    } else {
+        code = handler(argc, argv, arg);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    write_all(conn, &code, sizeof(code));
+
+    free(argv);
+    free(payload);
+}
+
+int server_run(const char *socket_path, ServeHandler handler, void *arg) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, socket_path)) return EXIT_IO;
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(stderr, "Error: Could not create socket: %s\n", strerror(errno));
+        return EXIT_IO;
+    }
+
+    // A socket left behind by a daemon that did not shut down cleanly
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Could not listen on '%s': %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return EXIT_IO;
+    }
+
+    // No SA_RESTART, so a stop signal also breaks out of accept()
+    struct sigaction stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = on_stop_signal;
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    // Request children are reaped by the kernel
+    struct sigaction reap;
+    memset(&reap, 0, sizeof(reap));
+    reap.sa_handler = SIG_IGN;
+    sigemptyset(&reap.sa_mask);
+    sigaction(SIGCHLD, &reap, NULL);
+
+    while (!g_stop_serving) {
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Error: accept failed: %s\n", strerror(errno));
+            break;
+        }
+        // Keep the connection out of subprocesses such as the linker
+        fcntl(conn, F_SETFD, FD_CLOEXEC);
+
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listen_fd);
+            signal(SIGCHLD, SIG_DFL);   // run_command() waits for its children
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            serve_connection(conn, handler, arg);
+            _exit(0);
+        }
+        if (pid < 0) fprintf(stderr, "Error: fork failed: %s\n", strerror(errno));
+        close(conn);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return EXIT_OK;
+}
+
+int server_request(const char *socket_path, int argc, char **argv) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, socket_path)) return EXIT_IO;
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        fprintf(stderr, "Error: Could not read the working directory: %s\n", strerror(errno));
+        return EXIT_IO;
+    }
+
+    // The --connect option itself stays on this side
+    bool *skip = calloc((size_t)argc + 1, sizeof(bool));
+    if (!skip) return EXIT_IO;
+    size_t length = strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            skip[i] = skip[i + 1] = true;
+            i++;
+            continue;
+        }
+        length += strlen(argv[i]) + 1;
+    }
+    if (length > SERVE_MAX_REQUEST) {
+        fprintf(stderr, "Error: Command line too long for the compile server\n");
+        free(skip);
+        return EXIT_IO;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Error: No compile server at '%s': %s\n", socket_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        free(skip);
+        return EXIT_IO;
+    }
+
+    char *payload = malloc(length);
+    if (!payload) {
+        close(fd);
+        free(skip);
+        return EXIT_IO;
+    }
+    size_t pos = 0;
+    memcpy(payload, cwd, strlen(cwd) + 1);
+    pos += strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++) {
+        if (skip[i]) continue;
+        size_t len = strlen(argv[i]) + 1;
+        memcpy(payload + pos, argv[i], len);
+        pos += len;
+    }
+
+    RequestHeader hdr = { SERVE_MAGIC, (uint32_t)length };
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov = { &hdr, sizeof(hdr) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    int32_t code = EXIT_IO;
+    fflush(stdout);
+    fflush(stderr);
+    if (sendmsg(fd, &msg, 0) != (ssize_t)sizeof(hdr) || !write_all(fd, payload, length)) {
+        fprintf(stderr, "Error: Could not send the request to the compile server\n");
+    } else if (!read_all(fd, &code, sizeof(code))) {
+        fprintf(stderr, "Error: The compile server dropped the request\n");
+        code = EXIT_IO;
+    }
+
+    free(skip);
+    free(payload);
+    close(fd);
+    return code;
+}
+
+// Children report through a shared page rather than their exit status,
+// which would truncate codes past 255.
+#define BATCH_PENDING INT32_MIN
+
+int server_batch(BatchManifest *manifest, int jobs, ServeHandler handler, void *arg) {
+    size_t count = manifest->count;
+    if (count == 0) return EXIT_OK;
+    if (jobs < 1) jobs = 1;
+
+    size_t bytes = count * sizeof(int32_t);
+    int32_t *codes = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (codes == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not set up the batch: %s\n", strerror(errno));
+        return EXIT_IO;
+    }
+    for (size_t i = 0; i < count; i++) codes[i] = BATCH_PENDING;
+
+    size_t next = 0, running = 0;
+    while (next < count || running > 0) {
+        if (next < count && running < (size_t)jobs) {
+            BatchEntry *entry = &manifest->entries[next];
+            fflush(NULL);
+            pid_t pid = fork();
+            if (pid == 0) {
+                int32_t code = handler(entry->argc, entry->argv, arg);
+                fflush(stdout);
+                fflush(stderr);
+                codes[next] = code;
+                _exit(0);
+            }
+            if (pid < 0) {
+                fprintf(stderr, "Error: fork failed: %s\n", strerror(errno));
+                if (running == 0) {
+                    codes[next] = EXIT_IO;
+                    next++;
+                    continue;
+                }
+            } else {
+                next++;
+                running++;
+                continue;
+            }
+        }
+
+        pid_t done = wait(NULL);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running--;
+    }
+
+    int result = EXIT_OK;
+    for (size_t i = 0; i < count; i++) {
+        manifest->entries[i].code = codes[i] == BATCH_PENDING ? EXIT_IO : codes[i];
+        if (result == EXIT_OK && manifest->entries[i].code != EXIT_OK) result = manifest->entries[i].code;
+    }
+    munmap(codes, bytes);
+    return result;
+}
+
+#endif
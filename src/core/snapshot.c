@@ -0,0 +1,267 @@
+#include "core/snapshot.h"
+#include "core/utils.h"
+#include "lexing/lexer.h"
+#include "datastructures/hash_map.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define SNAPSHOT_SUPPORTED 1
+    #ifndef MAP_FIXED_NOREPLACE
+        #define MAP_FIXED_NOREPLACE 0x100000
+    #endif
+#endif
+
+// Bump whenever the layout of anything in the snapshot changes without the
+// executable changing with it (it always does, so this is belt and braces).
+#define SNAPSHOT_FORMAT_VERSION 1
+#define SNAPSHOT_MAGIC "NTSNAP"
+
+bool startup_state_build(Arena *arena, StartupState *out) {
+    HashMap *kw_map = hashmap_create(arena, 32);
+    HashMap *id_map = hashmap_create(arena, 256);
+    HashMap *str_map = hashmap_create(arena, 128);
+    if (!kw_map || !id_map || !str_map) return false;
+
+    out->keywords = intern_table_create(kw_map, arena, string_copy_func, slice_hash, slice_cmp);
+    out->identifiers = intern_table_create(id_map, arena, string_copy_func, slice_hash, slice_cmp);
+    out->strings = intern_table_create(str_map, arena, string_copy_func, slice_hash, slice_cmp);
+    if (!out->keywords || !out->identifiers || !out->strings) return false;
+
+    lexer_populate_default_keywords(out->keywords);
+
+    out->store = typestore_create(arena, out->identifiers, out->keywords);
+    return out->store && typestore_universe(out->store, out->keywords);
+}
+
+#ifdef SNAPSHOT_SUPPORTED
+
+// Where the snapshot is built and mapped back: far from where the kernel
+// puts executables, the heap and other mappings on 47-bit address spaces
+// (and clear of the sanitizer shadow). Where it is taken or does not exist,
+// the state is built in an ordinary arena.
+#define SNAPSHOT_BASE ((uintptr_t)0x3d5e00000000ULL)
+
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    // The executable that wrote it
+    uint64_t exe_dev, exe_ino, exe_size;
+    int64_t exe_mtime, exe_mtime_ns;
+    uint64_t base;
+    uint64_t region_size;   // The whole first block, the part behind the image left empty
+    uint64_t image_offset;  // Page-aligned file offset of the image
+    uint64_t image_size;
+    StartupState roots;
+} SnapshotHeader;
+
+// Bounds of the executable's own image, from the linker
+extern char __executable_start[];
+extern char _end[];
+
+static bool snapshot_identity(SnapshotHeader *h, size_t region_size) {
+    struct stat st;
+    if (stat("/proc/self/exe", &st) != 0) return false;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    h->version = SNAPSHOT_FORMAT_VERSION;
+    h->exe_dev = (uint64_t)st.st_dev;
+    h->exe_ino = (uint64_t)st.st_ino;
+    h->exe_size = (uint64_t)st.st_size;
+    h->exe_mtime = (int64_t)st.st_mtim.tv_sec;
+    h->exe_mtime_ns = (int64_t)st.st_mtim.tv_nsec;
+    h->base = SNAPSHOT_BASE;
+    h->region_size = region_size;
+    return true;
+}
+
+/* One file per executable, so a dev and a release build can share a cache. */
+static void snapshot_path(char *buf, size_t size, const char *cache_dir, const SnapshotHeader *id) {
+    uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a 64-bit over the identity */
+    const unsigned char *p = (const unsigned char*)id;
+    for (size_t i = 0; i < offsetof(SnapshotHeader, image_offset); i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    snprintf(buf, size, "%s/startup-%016llx.nts", cache_dir, (unsigned long long)h);
+}
+
+static void *reserve_region(size_t size) {
+    void *p = mmap((void*)SNAPSHOT_BASE, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (p != (void*)SNAPSHOT_BASE) {
+        // Kernels before 4.17 take the address as a hint only
+        munmap(p, size);
+        return NULL;
+    }
+    return p;
+}
+
+static DenseArenaInterner **interner_slot(StartupState *s, int i) {
+    DenseArenaInterner **slots[] = { &s->keywords, &s->identifiers, &s->strings, &s->store->type_interner };
+    return slots[i];
+}
+
+/* The roots and the interners, at least, have to lie inside the image. */
+static bool roots_in_image(StartupState *s, const SnapshotHeader *h) {
+    uintptr_t lo = (uintptr_t)h->base, hi = lo + h->image_size;
+    if ((uintptr_t)s->store < lo || (uintptr_t)s->store + sizeof(TypeStore) > hi) return false;
+    for (int i = 0; i < 4; i++) {
+        uintptr_t p = (uintptr_t)*interner_slot(s, i);
+        if (p < lo || p + sizeof(DenseArenaInterner) > hi) return false;
+    }
+    return true;
+}
+
+static Arena *snapshot_map(const char *path, const SnapshotHeader *id, ArenaBacking backing, StartupState *out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    SnapshotHeader h;
+    struct stat st;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    bool ok = pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+              fstat(fd, &st) == 0 &&
+              memcmp(&h, id, offsetof(SnapshotHeader, image_offset)) == 0 &&
+              h.image_offset % page == 0 && h.image_size <= h.region_size &&
+              (uint64_t)st.st_size == h.image_offset + h.image_size;
+
+    void *region = ok ? reserve_region((size_t)h.region_size) : NULL;
+    if (region && mmap(region, (size_t)h.image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                       fd, (off_t)h.image_offset) == MAP_FAILED) {
+        munmap(region, (size_t)h.region_size);
+        region = NULL;
+    }
+    close(fd);
+    if (!region) return NULL;
+
+    StartupState s = h.roots;
+    if (!roots_in_image(&s, &h)) {
+        munmap(region, (size_t)h.region_size);
+        return NULL;
+    }
+
+    // The one thing that moves: the executable
+    for (int i = 0; i < 3; i++) {
+        DenseArenaInterner *in = *interner_slot(&s, i);
+        in->copy_func = string_copy_func;
+        in->hash_func = slice_hash;
+        in->cmp_func = slice_cmp;
+    }
+    typestore_relink(s.store);
+
+    Arena *arena = region;
+    arena->backing = backing;
+    *out = s;
+    return arena;
+}
+
+static bool points_into_executable(const char *image, size_t size) {
+    uintptr_t lo = (uintptr_t)__executable_start, hi = (uintptr_t)_end;
+    for (size_t at = 0; at + sizeof(uintptr_t) <= size; at += sizeof(uintptr_t)) {
+        uintptr_t word;
+        memcpy(&word, image + at, sizeof(word));
+        if (word >= lo && word < hi) return true;
+    }
+    return false;
+}
+
+static void snapshot_save(const char *cache_dir, const char *path, Arena *arena,
+                          StartupState *s, const SnapshotHeader *id) {
+    // It all has to have fit in the region's one block
+    ArenaBlock *block = arena->blocks;
+    if (block->next || block->mapped != ARENA_IN_REGION || arena->adopted || arena->free_blocks) return;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    SnapshotHeader h = *id;
+    h.image_offset = sizeof(SnapshotHeader) <= page ? page : (sizeof(SnapshotHeader) + page - 1) / page * page;
+    h.image_size = (uint64_t)(block->data + block->used - (char*)arena);
+    h.roots = *s;
+
+    // The callbacks are not stored, and nothing else may point into the
+    // executable: it would be stale on the next run
+    DenseArenaInterner saved[4];
+    for (int i = 0; i < 4; i++) {
+        DenseArenaInterner *in = *interner_slot(s, i);
+        saved[i] = *in;
+        in->copy_func = NULL;
+        in->hash_func = NULL;
+        in->cmp_func = NULL;
+    }
+    bool clean = !points_into_executable((const char*)arena, (size_t)h.image_size);
+
+    char tmp_path[4096 + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+    FILE *f = NULL;
+    if (clean) {
+        mkdir(cache_dir, 0777);
+        f = fopen(tmp_path, "wb");
+    }
+    bool ok = f != NULL;
+    if (f) {
+        static const char zeros[256];
+        ok = fwrite(&h, 1, sizeof(h), f) == sizeof(h);
+        for (size_t at = sizeof(h); ok && at < h.image_offset; at += sizeof(zeros)) {
+            size_t n = h.image_offset - at < sizeof(zeros) ? (size_t)(h.image_offset - at) : sizeof(zeros);
+            ok = fwrite(zeros, 1, n, f) == n;
+        }
+        ok = ok && fwrite(arena, 1, (size_t)h.image_size, f) == h.image_size;
+        ok = (fclose(f) == 0) && ok;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        DenseArenaInterner *in = *interner_slot(s, i);
+        in->copy_func = saved[i].copy_func;
+        in->hash_func = saved[i].hash_func;
+        in->cmp_func = saved[i].cmp_func;
+    }
+
+    if (f && (!ok || rename(tmp_path, path) != 0)) remove(tmp_path);
+}
+
+#endif
+
+Arena *startup_state_open(const char *cache_dir, size_t size, ArenaBacking backing,
+                          StartupState *out, bool *mapped) {
+    if (mapped) *mapped = false;
+    Arena *arena = NULL;
+
+#ifdef SNAPSHOT_SUPPORTED
+    SnapshotHeader id;
+    char path[4096];
+    if (cache_dir && size % (size_t)sysconf(_SC_PAGESIZE) == 0 && snapshot_identity(&id, size)) {
+        snapshot_path(path, sizeof(path), cache_dir, &id);
+        arena = snapshot_map(path, &id, backing, out);
+        if (arena) {
+            if (mapped) *mapped = true;
+            return arena;
+        }
+
+        void *region = reserve_region(size);
+        arena = region ? arena_create_in(region, size, backing) : NULL;
+        if (arena) {
+            if (!startup_state_build(arena, out)) {
+                arena_destroy(arena);
+                return NULL;
+            }
+            snapshot_save(cache_dir, path, arena, out, &id);
+            return arena;
+        }
+        if (region) munmap(region, size);
+    }
+#endif
+
+    arena = arena_create_backed(size, backing);
+    if (!arena) return NULL;
+    if (!startup_state_build(arena, out)) {
+        arena_destroy(arena);
+        return NULL;
+    }
+    return arena;
+}
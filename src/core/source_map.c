@@ -0,0 +1,154 @@
+#include "core/source_map.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    char *path;             // Owned; NULL for in-memory input
+    const char *text;
+    uint32_t len;
+    uint32_t *line_starts;  // Offset of each line's first byte; NULL until first lookup
+    uint32_t line_count;
+} SourceFile;
+
+static struct {
+    pthread_mutex_t lock;   // Guards everything below
+    SourceFile *files;      // files[id - 1]
+    uint32_t count;
+    uint32_t cap;
+} g_sources = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+SourceId source_register(const char *path, const char *text, size_t len) {
+    char *path_copy = NULL;
+    if (path) {
+        path_copy = strdup(path);
+        if (!path_copy) return SOURCE_NONE;
+    }
+
+    pthread_mutex_lock(&g_sources.lock);
+    if (g_sources.count == g_sources.cap) {
+        uint32_t cap = g_sources.cap ? g_sources.cap * 2 : 64;
+        SourceFile *grown = realloc(g_sources.files, cap * sizeof(SourceFile));
+        if (!grown) {
+            pthread_mutex_unlock(&g_sources.lock);
+            free(path_copy);
+            return SOURCE_NONE;
+        }
+        g_sources.files = grown;
+        g_sources.cap = cap;
+    }
+    g_sources.files[g_sources.count] = (SourceFile){
+        .path = path_copy, .text = text, .len = (uint32_t)len,
+    };
+    SourceId id = ++g_sources.count;
+    pthread_mutex_unlock(&g_sources.lock);
+    return id;
+}
+
+const char *source_path(SourceId file) {
+    pthread_mutex_lock(&g_sources.lock);
+    const char *path = (file && file <= g_sources.count) ? g_sources.files[file - 1].path : NULL;
+    pthread_mutex_unlock(&g_sources.lock);
+    return path;
+}
+
+const char *source_text(SourceId file, size_t *len) {
+    const char *text = NULL;
+    size_t n = 0;
+    pthread_mutex_lock(&g_sources.lock);
+    if (file && file <= g_sources.count) {
+        text = g_sources.files[file - 1].text;
+        n = g_sources.files[file - 1].len;
+    }
+    pthread_mutex_unlock(&g_sources.lock);
+    if (len) *len = n;
+    return text;
+}
+
+// One memchr pass over the buffer; called with the lock held
+static bool build_line_starts(SourceFile *sf) {
+    uint32_t cap = 64, n = 0;
+    uint32_t *starts = malloc(cap * sizeof(uint32_t));
+    if (!starts) return false;
+    starts[n++] = 0;
+
+    const char *p = sf->text, *end = sf->text + sf->len;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        p++;
+        if (n == cap) {
+            cap *= 2;
+            uint32_t *grown = realloc(starts, cap * sizeof(uint32_t));
+            if (!grown) { free(starts); return false; }
+            starts = grown;
+        }
+        starts[n++] = (uint32_t)(p - sf->text);
+    }
+
+    sf->line_starts = starts;
+    sf->line_count = n;
+    return true;
+}
+
+SourcePos source_pos(SourceId file, uint32_t offset) {
+    SourcePos pos = {0, 0};
+    pthread_mutex_lock(&g_sources.lock);
+    if (file && file <= g_sources.count) {
+        SourceFile *sf = &g_sources.files[file - 1];
+        if (sf->line_starts || build_line_starts(sf)) {
+            // Last line starting at or before `offset`
+            uint32_t lo = 0, hi = sf->line_count;
+            while (hi - lo > 1) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (sf->line_starts[mid] <= offset) lo = mid;
+                else hi = mid;
+            }
+            pos.line = lo + 1;
+            pos.col = offset - sf->line_starts[lo] + 1;
+        }
+    }
+    pthread_mutex_unlock(&g_sources.lock);
+    return pos;
+}
+
+const char *source_line(SourceId file, uint32_t line, size_t *len) {
+    const char *text = NULL;
+    size_t n = 0;
+    pthread_mutex_lock(&g_sources.lock);
+    if (file && file <= g_sources.count && line > 0) {
+        SourceFile *sf = &g_sources.files[file - 1];
+        if (sf->text && (sf->line_starts || build_line_starts(sf)) && line <= sf->line_count) {
+            uint32_t start = sf->line_starts[line - 1];
+            uint32_t end = line < sf->line_count ? sf->line_starts[line] - 1 : sf->len;
+            text = sf->text + start;
+            n = end - start;
+        }
+    }
+    pthread_mutex_unlock(&g_sources.lock);
+    if (len) *len = n;
+    return text;
+}
+
+void print_source_excerpt_span(SourceId file, size_t line_no, size_t start_col, size_t end_col) {
+    size_t len = 0;
+    const char *line = source_line(file, (uint32_t)line_no, &len);
+    if (!line) return;
+
+    fprintf(stderr, "\x1b[33m%4zu\x1b[0m | %.*s\n", line_no, (int)len, line);
+    fprintf(stderr, "     | ");
+
+    // Spaces until start
+    for (size_t i = 1; i < start_col; i++) fputc(' ', stderr);
+
+    // Underline
+    fprintf(stderr, "\x1b[31m");
+    size_t width = (end_col >= start_col) ? (end_col - start_col) : 1;
+    if (width == 0) width = 1;
+    for (size_t i = 0; i < width; i++) fputc('^', stderr);
+    fprintf(stderr, "\x1b[0m\n");
+}
+
+void print_source_excerpt(SourceId file, size_t line_no, size_t col) {
+    print_source_excerpt_span(file, line_no, col, col + 1);
+}
@@ -0,0 +1,53 @@
+#include "core/stats.h"
+
+static const char *const STAT_NAMES[STAT_COUNT] = {
+#define STAT_NAME(id, name, desc) name,
+    NEWT_STAT_COUNTERS(STAT_NAME)
+#undef STAT_NAME
+};
+
+static const char *const STAT_DESCRIPTIONS[STAT_COUNT] = {
+#define STAT_DESC(id, name, desc) desc,
+    NEWT_STAT_COUNTERS(STAT_DESC)
+#undef STAT_DESC
+};
+
+#ifdef NEWT_STATS
+
+size_t g_stat_counters[STAT_COUNT];
+
+void stat_max(StatCounter id, size_t value) {
+    size_t seen = __atomic_load_n(&g_stat_counters[id], __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(&g_stat_counters[id], &seen, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+bool stats_enabled(void) { return true; }
+
+void stats_reset(void) {
+    for (size_t i = 0; i < STAT_COUNT; i++) {
+        __atomic_store_n(&g_stat_counters[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+size_t stats_get(StatCounter id) {
+    return __atomic_load_n(&g_stat_counters[id], __ATOMIC_RELAXED);
+}
+
+#else
+
+bool stats_enabled(void) { return false; }
+void stats_reset(void) {}
+size_t stats_get(StatCounter id) { return 0; }
+
+#endif
+
+const char *stats_name(StatCounter id) {
+    return id < STAT_COUNT ? STAT_NAMES[id] : "?";
+}
+
+const char *stats_description(StatCounter id) {
+    return id < STAT_COUNT ? STAT_DESCRIPTIONS[id] : "?";
+}
@@ -0,0 +1,115 @@
+#include "trace.h"
+#include "core/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    char phase;         // 'B' or 'E'
+    unsigned tid;
+    double ts_us;       // Since trace_start()
+    const char *cat;    // Static string
+    char *name;         // Owned; NULL for 'E'
+} TraceEvent;
+
+static struct {
+    bool enabled;
+    double t0;
+    pthread_mutex_t lock;   // Guards everything below
+    TraceEvent *events;
+    size_t count;
+    size_t cap;
+    unsigned next_tid;
+} g_trace = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Small per-thread ids read better in the viewer than pthread_t values
+static _Thread_local unsigned t_trace_tid;
+
+void trace_start(void) {
+    g_trace.t0 = now_seconds();
+    g_trace.enabled = true;
+}
+
+static void trace_push(char phase, const char *cat, char *name) {
+    double ts = (now_seconds() - g_trace.t0) * 1e6;
+
+    pthread_mutex_lock(&g_trace.lock);
+    if (!t_trace_tid) t_trace_tid = ++g_trace.next_tid;
+    if (g_trace.count == g_trace.cap) {
+        size_t cap = g_trace.cap ? g_trace.cap * 2 : 1024;
+        TraceEvent *grown = realloc(g_trace.events, cap * sizeof(TraceEvent));
+        if (!grown) {
+            pthread_mutex_unlock(&g_trace.lock);
+            free(name);
+            return;
+        }
+        g_trace.events = grown;
+        g_trace.cap = cap;
+    }
+    g_trace.events[g_trace.count++] = (TraceEvent){ phase, t_trace_tid, ts, cat, name };
+    pthread_mutex_unlock(&g_trace.lock);
+}
+
+void trace_begin(const char *cat, const char *name) {
+    if (!g_trace.enabled) return;
+    trace_push('B', cat, xstrdup(name ? name : "?"));
+}
+
+void trace_begin_n(const char *cat, const char *name, size_t len) {
+    if (!g_trace.enabled) return;
+    char *copy = xmalloc(len + 1);
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    trace_push('B', cat, copy);
+}
+
+void trace_end(void) {
+    if (!g_trace.enabled) return;
+    trace_push('E', NULL, NULL);
+}
+
+static void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+bool trace_write_json(const char *path) {
+    pthread_mutex_lock(&g_trace.lock);
+    g_trace.enabled = false;
+
+    FILE *f = fopen(path, "w");
+    if (f) {
+        fprintf(f, "{\"traceEvents\":[\n");
+        for (size_t i = 0; i < g_trace.count; i++) {
+            TraceEvent *ev = &g_trace.events[i];
+            fprintf(f, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", i ? ",\n" : "", ev->phase, ev->tid, ev->ts_us);
+            if (ev->name) {
+                fprintf(f, ",\"cat\":\"%s\",\"name\":", ev->cat ? ev->cat : "");
+                write_json_string(f, ev->name);
+            }
+            fputc('}', f);
+        }
+        fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    }
+    bool ok = f && !ferror(f);
+    if (f && fclose(f) != 0) ok = false;
+
+    for (size_t i = 0; i < g_trace.count; i++) free(g_trace.events[i].name);
+    free(g_trace.events);
+    g_trace.events = NULL;
+    g_trace.count = g_trace.cap = 0;
+    pthread_mutex_unlock(&g_trace.lock);
+    return ok;
+}
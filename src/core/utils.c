@@ -9,8 +9,6 @@
     #include <psapi.h>
     #include <io.h>
     #include <process.h>
-    #define access _access
-    #define F_OK 0
 #else
     #include <unistd.h>
     #include <sys/resource.h>
@@ -18,10 +16,6 @@
     #include <sys/wait.h>
 #endif
 
-#ifdef __APPLE__
-    #include <mach-o/dyld.h>
-#endif
-
 double now_seconds(void) {
 #ifdef _WIN32
     LARGE_INTEGER frequency;
@@ -82,64 +76,6 @@ char *xstrdup(const char *s) {
     return p;
 }
 
-char *get_runtime_path(void) {
-    // 1. Try environment variable
-    char *env = getenv("COMPILER_RUNTIME_PATH");
-    if (env) return xstrdup(env);
-
-    // 2. Try relative to CWD
-    if (access("src/core/runtime.c", F_OK) == 0) {
-        return xstrdup("src/core/runtime.c");
-    }
-
-    // 3. Try relative to executable
-    char exe_path[1024];
-#ifdef _WIN32
-    if (GetModuleFileNameA(NULL, exe_path, sizeof(exe_path))) {
-        char *last_slash = strrchr(exe_path, '\\');
-        if (!last_slash) last_slash = strrchr(exe_path, '/');
-        if (last_slash) {
-            *last_slash = '\0';
-            char runtime_path[1024];
-            snprintf(runtime_path, sizeof(runtime_path), "%s/../src/core/runtime.c", exe_path);
-            if (access(runtime_path, F_OK) == 0) {
-                return xstrdup(runtime_path);
-            }
-        }
-    }
-#elif defined(__APPLE__)
-    uint32_t size = sizeof(exe_path);
-    if (_NSGetExecutablePath(exe_path, &size) == 0) {
-        char *last_slash = strrchr(exe_path, '/');
-        if (last_slash) {
-            *last_slash = '\0';
-            char runtime_path[1024];
-            snprintf(runtime_path, sizeof(runtime_path), "%s/../src/core/runtime.c", exe_path);
-            if (access(runtime_path, F_OK) == 0) {
-                return xstrdup(runtime_path);
-            }
-        }
-    }
-#elif defined(__linux__)
-    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path)-1);
-    if (len != -1) {
-        exe_path[len] = '\0';
-        char *last_slash = strrchr(exe_path, '/');
-        if (last_slash) {
-            *last_slash = '\0';
-            char runtime_path[1024];
-            snprintf(runtime_path, sizeof(runtime_path), "%s/../src/core/runtime.c", exe_path);
-            if (access(runtime_path, F_OK) == 0) {
-                return xstrdup(runtime_path);
-            }
-        }
-    }
-#endif
-
-    // Fallback to hardcoded default
-    return xstrdup("src/core/runtime.c");
-}
-
 int run_command(const char *cmd, char *const argv[]) {
 #ifdef _WIN32
     // On Windows, we'll use _spawnvp which is roughly equivalent to fork+execvp
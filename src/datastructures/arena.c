@@ -6,12 +6,111 @@
 #include <stdint.h>
 #include <stdalign.h>
 #include <limits.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define ARENA_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
 
 static size_t align_up(size_t v, size_t a) {
     return (v + a - 1) & ~(a - 1);
 }
 
+#ifndef _WIN32
+/* Map `bytes` (a multiple of `align`) at an `align`-aligned address. */
+static void *map_aligned(size_t bytes, size_t align, int extra_flags) {
+    size_t len = bytes + (align > (size_t)sysconf(_SC_PAGESIZE) ? align : 0);
+    char *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (len == bytes) return p;
+
+    // Trim the slack so the block starts on a huge-page boundary
+    char *start = (char*)align_up((uintptr_t)p, align);
+    if (start > p) munmap(p, (size_t)(start - p));
+    size_t tail = (size_t)((p + len) - (start + bytes));
+    if (tail) munmap(start + bytes, tail);
+    return start;
+}
+#endif
+
+/* A fresh block with room for at least `capacity` bytes. */
+static ArenaBlock *block_new(ArenaBacking backing, size_t capacity) {
+    size_t header = sizeof(ArenaBlock);
+    if (capacity > SIZE_MAX - header - ARENA_HUGE_PAGE_SIZE) return NULL;
+
+#ifndef _WIN32
+    if (backing != ARENA_MALLOC) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        bool huge = backing == ARENA_HUGE_PAGES || backing == ARENA_HUGETLB;
+        size_t bytes = align_up(header + capacity, huge ? ARENA_HUGE_PAGE_SIZE : page);
+        void *p = NULL;
+#ifdef MAP_HUGETLB
+        if (backing == ARENA_HUGETLB) p = map_aligned(bytes, page, MAP_HUGETLB);
+#endif
+        if (!p) {
+            p = map_aligned(bytes, huge ? ARENA_HUGE_PAGE_SIZE : page, 0);
+#ifdef MADV_HUGEPAGE
+            if (p && huge) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+        }
+        if (p) {
+            ArenaBlock *block = p;
+            block->next = NULL;
+            block->capacity = bytes - header;
+            block->used = 0;
+            block->mapped = bytes;
+            return block;
+        }
+        // No mapping available: fall back to the heap
+    }
+#else
+    (void)backing;
+#endif
+
+    ArenaBlock *block = malloc(header + capacity);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    block->mapped = 0;
+    return block;
+}
+
+static void block_free(ArenaBlock *block) {
+    // Goes with the region, in arena_destroy()
+    if (block->mapped == ARENA_IN_REGION) return;
+#ifndef _WIN32
+    if (block->mapped) {
+        munmap(block, block->mapped);
+        return;
+    }
+#endif
+    free(block);
+}
+
+static void free_chain(ArenaBlock *b) {
+    while (b) {
+        ArenaBlock *n = b->next;
+        block_free(b);
+        b = n;
+    }
+}
+
+/* Blocks leaving the live list are kept for reuse. */
+static void recycle_block(Arena *arena, ArenaBlock *block) {
+    block->used = 0;
+    block->next = arena->free_blocks;
+    arena->free_blocks = block;
+}
+
 Arena *arena_create(size_t initial_capacity) {
+    return arena_create_backed(initial_capacity, ARENA_MALLOC);
+}
+
+Arena *arena_create_backed(size_t initial_capacity, ArenaBacking backing) {
     if (initial_capacity == 0) initial_capacity = 1024;
     /* sanity cap to avoid absurd allocations */
     if (initial_capacity > (SIZE_MAX / 2)) initial_capacity = 1024;
@@ -19,49 +118,101 @@ Arena *arena_create(size_t initial_capacity) {
     Arena *arena = malloc(sizeof(Arena));
     if (!arena) return NULL;
 
-    /* ensure initial allocation checked for overflow */
-    size_t header = sizeof(ArenaBlock);
-    size_t alloc_req;
-    if (initial_capacity > SIZE_MAX - header) { free(arena); return NULL; }
-    alloc_req = header + initial_capacity;
-
-    ArenaBlock *block = malloc(alloc_req);
+    ArenaBlock *block = block_new(backing, initial_capacity);
     if (!block) { free(arena); return NULL; }
 
+    arena->blocks = block;
+    arena->block_size = initial_capacity;
+    arena->next_block_size = initial_capacity;
+    arena->free_blocks = NULL;
+    arena->backing = backing;
+    arena->adopted = NULL;
+    arena->next_adopted = NULL;
+    arena->region_size = 0;
+    return arena;
+}
+
+Arena *arena_create_in(void *region, size_t size, ArenaBacking backing) {
+#ifndef _WIN32
+    size_t header = align_up(sizeof(Arena), alignof(max_align_t));
+    if (!region || size < header + sizeof(ArenaBlock) + 1024) return NULL;
+
+    Arena *arena = region;
+    ArenaBlock *block = (ArenaBlock*)((char*)region + header);
     block->next = NULL;
-    block->capacity = initial_capacity;
+    block->capacity = size - header - sizeof(ArenaBlock);
     block->used = 0;
+    block->mapped = ARENA_IN_REGION;
 
     arena->blocks = block;
-    arena->block_size = initial_capacity;
+    arena->block_size = block->capacity;
+    arena->next_block_size = block->capacity;
+    arena->free_blocks = NULL;
+    arena->backing = backing;
+    arena->adopted = NULL;
+    arena->next_adopted = NULL;
+    arena->region_size = size;
     return arena;
+#else
+    (void)region; (void)size; (void)backing;
+    return NULL;
+#endif
 }
 
 void arena_destroy(Arena *arena) {
     if (!arena) return;
-    ArenaBlock *b = arena->blocks;
-    while (b) {
-        ArenaBlock *n = b->next;
-        free(b);
-        b = n;
+    while (arena->adopted) {
+        Arena *next = arena->adopted->next_adopted;
+        arena_destroy(arena->adopted);
+        arena->adopted = next;
     }
+    free_chain(arena->blocks);
+    free_chain(arena->free_blocks);
+#ifndef _WIN32
+    if (arena->region_size) {
+        munmap(arena, arena->region_size);
+        return;
+    }
+#endif
     free(arena);
 }
 
-/* Reset arena: keep only the first block and reuse it. */
+/* Reset arena: keep the current block and park the rest on the free list. */
 void arena_reset(Arena *arena) {
     if (!arena) return;
-    /* free all but first block */
     ArenaBlock *b = arena->blocks->next;
     while (b) {
         ArenaBlock *n = b->next;
-        free(b);
+        recycle_block(arena, b);
         b = n;
     }
     arena->blocks->next = NULL;
     arena->blocks->used = 0;
 }
 
+/* Take a free block that fits `size`, or map/allocate the next one. */
+static ArenaBlock *arena_grow(Arena *arena, size_t size) {
+    for (ArenaBlock **link = &arena->free_blocks; *link; link = &(*link)->next) {
+        if ((*link)->capacity >= size) {
+            ArenaBlock *block = *link;
+            *link = block->next;
+            return block;
+        }
+    }
+
+    /* Geometric growth (capped), and never smaller than the request */
+    size_t new_capacity = arena->next_block_size;
+    if (new_capacity < ARENA_MAX_BLOCK_SIZE) {
+        size_t next = new_capacity * 2;
+        arena->next_block_size = next < ARENA_MAX_BLOCK_SIZE ? next : ARENA_MAX_BLOCK_SIZE;
+    }
+    while (new_capacity < size) {
+        if (new_capacity > SIZE_MAX / 2) { new_capacity = size; break; }
+        new_capacity *= 2;
+    }
+    return block_new(arena->backing, new_capacity);
+}
+
 /* Allocate aligned size from the arena. Returns NULL on OOM. */
 void *arena_alloc(Arena *arena, size_t size) {
     if (!arena) return NULL;
@@ -75,23 +226,12 @@ void *arena_alloc(Arena *arena, size_t size) {
     /* align the *offset*, not just the size */
     size_t offset = align_up(block->used, align);
 
-    /* If not enough room in current block, allocate a new one */
+    /* If not enough room in current block, switch to a new one */
     if (offset + size > block->capacity) {
-        /* Determine new capacity: at least arena->block_size, but grow until it fits */
-        size_t new_capacity = arena->block_size;
-        while (new_capacity < size) {
-            if (new_capacity > SIZE_MAX / 2) { new_capacity = size; break; }
-            new_capacity *= 2;
-        }
-
-        /* allocate block (check overflow) */
-        size_t header = sizeof(ArenaBlock);
-        if (new_capacity > SIZE_MAX - header) return NULL;
-        ArenaBlock *new_block = malloc(header + new_capacity);
+        ArenaBlock *new_block = arena_grow(arena, size);
         if (!new_block) return NULL;
 
         new_block->next = arena->blocks;
-        new_block->capacity = new_capacity;
         new_block->used = 0;
         arena->blocks = new_block;
         block = new_block;
@@ -110,12 +250,85 @@ void *arena_calloc(Arena *arena, size_t size) {
     return p;
 }
 
+/* Splice src's blocks behind dst's current block so dst keeps bumping from it. */
+void arena_merge(Arena *dst, Arena *src) {
+    if (!dst || !src) return;
+    while (src->free_blocks) {
+        ArenaBlock *n = src->free_blocks->next;
+        recycle_block(dst, src->free_blocks);
+        src->free_blocks = n;
+    }
+    while (src->adopted) {
+        Arena *next = src->adopted->next_adopted;
+        arena_adopt(dst, src->adopted);
+        src->adopted = next;
+    }
+    if (!src->blocks) { free(src); return; }
+
+    ArenaBlock *tail = src->blocks;
+    while (tail->next) tail = tail->next;
+
+    if (dst->blocks) {
+        tail->next = dst->blocks->next;
+        dst->blocks->next = src->blocks;
+    } else {
+        dst->blocks = src->blocks;
+    }
+    free(src);
+}
+
+void arena_adopt(Arena *dst, Arena *src) {
+    if (!dst || !src || dst == src) return;
+    src->next_adopted = dst->adopted;
+    dst->adopted = src;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark = { NULL, 0 };
+    if (!arena || !arena->blocks) return mark;
+    mark.block = arena->blocks;
+    mark.used = arena->blocks->used;
+    return mark;
+}
+
+/* Recycle the blocks opened after the mark, then restore its fill level. */
+void arena_rewind(Arena *arena, ArenaMark mark) {
+    if (!arena || !mark.block) return;
+    while (arena->blocks && arena->blocks != mark.block) {
+        ArenaBlock *n = arena->blocks->next;
+        recycle_block(arena, arena->blocks);
+        arena->blocks = n;
+    }
+    if (arena->blocks) arena->blocks->used = mark.used;
+}
+
+#define SCRATCH_BLOCK_SIZE (64 * 1024)
+
+static _Thread_local Arena *g_scratch = NULL;
+
+ArenaScratch arena_scratch_begin(void) {
+    if (!g_scratch) g_scratch = arena_create(SCRATCH_BLOCK_SIZE);
+    ArenaScratch scratch = { g_scratch, arena_mark(g_scratch) };
+    return scratch;
+}
+
+void arena_scratch_end(ArenaScratch scratch) {
+    arena_rewind(scratch.arena, scratch.mark);
+}
+
+void arena_scratch_release(void) {
+    arena_destroy(g_scratch);
+    g_scratch = NULL;
+}
+
 /* Debug helpers */
 size_t arena_bytes_used(const Arena *arena) {
     if (!arena) return 0;
     size_t total = 0;
     for (const ArenaBlock *b = arena->blocks; b; b = b->next)
         total += b->used;
+    for (const Arena *a = arena->adopted; a; a = a->next_adopted)
+        total += arena_bytes_used(a);
     return total;
 }
 
@@ -124,6 +337,8 @@ size_t arena_bytes_capacity(const Arena *arena) {
     size_t total = 0;
     for (const ArenaBlock *b = arena->blocks; b; b = b->next)
         total += b->capacity;
+    for (const Arena *a = arena->adopted; a; a = a->next_adopted)
+        total += arena_bytes_capacity(a);
     return total;
 }
 size_t arena_block_count(const Arena *arena) {
@@ -131,6 +346,8 @@ size_t arena_block_count(const Arena *arena) {
     size_t count = 0;
     for (const ArenaBlock *b = arena->blocks; b; b = b->next)
         count++;
+    for (const Arena *a = arena->adopted; a; a = a->next_adopted)
+        count += arena_block_count(a);
     return count;
 }
 
@@ -139,5 +356,7 @@ size_t arena_total_allocated(const Arena *arena) {
     size_t total = 0;
     for (const ArenaBlock *b = arena->blocks; b; b = b->next)
         total += b->used;
+    for (const Arena *a = arena->adopted; a; a = a->next_adopted)
+        total += arena_total_allocated(a);
     return total;
 }
\ No newline at end of file
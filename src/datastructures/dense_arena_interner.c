@@ -5,12 +5,17 @@
 #include <stdlib.h>
 #include "arena.h"
 #include "dynamic_array.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
+#include <stdint.h>
+#include <pthread.h>
 
 
 /* Predefined copy functions */
 void* string_copy_func(Arena *arena, const void *data, size_t len) {
     char *buf = arena_alloc(arena, len + 1);
     if (!buf) return NULL;
+    MEM_ACCOUNT(MEM_INTERN, MEM_KIND_NONE, SOURCE_NONE, len + 1, 1);
     memcpy(buf, data, len);
     buf[len] = '\0';  // null-terminate for strings
     return buf;
@@ -62,54 +67,217 @@ void intern_table_destroy(DenseArenaInterner *interner, void (*free_key)(void*),
     }
 }
 
-/* --- Generic intern function (returns InternResult* on success) --- */
-InternResult* intern(DenseArenaInterner *interner,
-                     Slice *slice,
-                     void *meta)
-{
-    if (!interner || !slice || !slice->ptr || slice->len == 0) return NULL;
-
-    /* Lookup existing entry */
-    InternResult *found = hashmap_get(interner->hashmap, slice, interner->hash_func, interner->cmp_func);
-    if (found) return found;
-
-    /* Allocate each component separately to ensure proper alignment */
-    Slice *key_slice = arena_calloc(interner->arena, sizeof(Slice));
-    if (!key_slice) return NULL;
-    
-    InternResult *res = arena_calloc(interner->arena, sizeof(InternResult));
-    if (!res) return NULL;
-    
-    Entry *ent = arena_calloc(interner->arena, sizeof(Entry));
-    if (!ent) return NULL;
+typedef struct {
+    pthread_mutex_t lock;
+    HashMap *hashmap;           /* keys interned into this shard while concurrent */
+    Arena *arena;               /* canonical keys + records for this shard */
+} InternShard;
+
+struct InternConcurrent {
+    InternShard *shards;
+    size_t shard_mask;
+    pthread_mutex_t dense_lock; /* guards dense_array / dense_index_count */
+    Arena *dense_arena;         /* dense_array growth while concurrent */
+    Arena *saved_dense_arena;
+};
+
+#define INTERN_SHARD_INITIAL_ARENA (16 * 1024)
+#define INTERN_SHARD_INITIAL_MAP   64
+
+/*
+ * Canonical keys carry the hash_func value they were inserted under, so a
+ * table rebuild (and folding the shards back after concurrent mode) reads it
+ * back instead of hashing every stored key again. Callers only ever see the
+ * leading Slice.
+ */
+typedef struct {
+    Slice slice;
+    size_t hash;
+} InternKey;
+
+static size_t intern_key_hash(void *key) {
+    return ((InternKey*)key)->hash;
+}
+
+/* Everything one key owns besides its bytes, in a single allocation. */
+typedef struct {
+    InternKey key;
+    InternResult res;
+    Entry entry;
+} InternRecord;
+
+/* Allocate the canonical copy and records for a new key and insert it into `map`. */
+static InternResult* intern_insert(DenseArenaInterner *interner, HashMap *map, Arena *arena,
+                                   Slice *slice, size_t hash, void *meta) {
+    /* One record per key; the copy below lands right behind it in the arena */
+    InternRecord *rec = arena_calloc(arena, sizeof(InternRecord));
+    if (!rec) return NULL;
+    MEM_ACCOUNT(MEM_INTERN, MEM_KIND_NONE, SOURCE_NONE, sizeof(InternRecord), 0);
+    InternKey *key = &rec->key;
+    InternResult *res = &rec->res;
+    Entry *ent = &rec->entry;
 
     /* Use the copy function to create canonical copy */
-    void *canonical_data = interner->copy_func(interner->arena, slice->ptr, slice->len);
+    void *canonical_data = interner->copy_func(arena, slice->ptr, slice->len);
     if (!canonical_data) return NULL;
 
-    key_slice->ptr = canonical_data;
-    key_slice->len = slice->len;
+    key->slice.ptr = canonical_data;
+    key->slice.len = slice->len;
+    key->hash = hash;
 
     ent->meta = meta;
-    ent->dense_index = interner->dense_index_count;
 
     res->entry = ent;
-    res->key = key_slice;
+    res->key = &key->slice;
+
+    /* Insert into hashmap using the arena-allocated key */
+    hashmap_put_hashed(map, key, res, hash, intern_key_hash, interner->cmp_func);
+    return res;
+}
 
-    /* Insert into hashmap using the arena-allocated key_slice */
-    hashmap_put(interner->hashmap, key_slice, res, interner->hash_func, interner->cmp_func);
+/* Give `res` the next dense index. Caller holds dense_lock when concurrent. */
+static bool intern_assign_dense(DenseArenaInterner *interner, InternResult *res) {
+    res->entry->dense_index = interner->dense_index_count;
 
     /* Push pointer to InternResult* into dense array */
     InternResult *res_ptr = res;
     if (dynarray_push_value(interner->dense_array, &res_ptr) != 0) {
         /* push failed; can't free arena allocations, return error. */
-        return NULL;
+        return false;
     }
 
     interner->dense_index_count++;
+    return true;
+}
+
+/* Pick a shard from the high bits so keys within a shard still spread over its table. */
+static InternShard* intern_shard_for(struct InternConcurrent *c, size_t hash) {
+    uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    return &c->shards[(size_t)(mixed >> 32) & c->shard_mask];
+}
+
+static InternResult* intern_concurrent(DenseArenaInterner *interner, Slice *slice, void *meta) {
+    struct InternConcurrent *c = interner->concurrent;
+
+    /* Hit path: the base table is read-only while concurrent. */
+    size_t hash = interner->hash_func(slice);
+    InternResult *found = hashmap_get_hashed(interner->hashmap, slice, hash, interner->cmp_func);
+    if (found) {
+        STAT_INC(INTERN_HITS);
+        return found;
+    }
+
+    InternShard *shard = intern_shard_for(c, hash);
+    pthread_mutex_lock(&shard->lock);
+
+    found = hashmap_get_hashed(shard->hashmap, slice, hash, interner->cmp_func);
+    if (found) {
+        STAT_INC(INTERN_HITS);
+    } else {
+        STAT_INC(INTERN_MISSES);
+        found = intern_insert(interner, shard->hashmap, shard->arena, slice, hash, meta);
+        if (found) {
+            pthread_mutex_lock(&c->dense_lock);
+            bool ok = intern_assign_dense(interner, found);
+            pthread_mutex_unlock(&c->dense_lock);
+            if (!ok) found = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+/* --- Generic intern function (returns InternResult* on success) --- */
+InternResult* intern(DenseArenaInterner *interner,
+                     Slice *slice,
+                     void *meta)
+{
+    if (!interner || !slice || !slice->ptr) return NULL; /* The empty slice is a key like any other */
+    if (interner->concurrent) return intern_concurrent(interner, slice, meta);
+
+    /* Lookup existing entry; a miss reuses the hash for the insert */
+    size_t hash = interner->hash_func(slice);
+    InternResult *found = hashmap_get_hashed(interner->hashmap, slice, hash, interner->cmp_func);
+    if (found) {
+        STAT_INC(INTERN_HITS);
+        return found;
+    }
+
+    STAT_INC(INTERN_MISSES);
+    InternResult *res = intern_insert(interner, interner->hashmap, interner->arena, slice, hash, meta);
+    if (!res || !intern_assign_dense(interner, res)) return NULL;
     return res;
 }
 
+bool intern_table_begin_concurrent(DenseArenaInterner *interner, size_t shard_count) {
+    if (!interner) return false;
+    if (interner->concurrent) return true;
+
+    size_t n = 1;
+    while (n < shard_count) n <<= 1;
+
+    struct InternConcurrent *c = calloc(1, sizeof(*c));
+    if (!c) return false;
+    c->shards = calloc(n, sizeof(InternShard));
+    c->dense_arena = arena_create(INTERN_SHARD_INITIAL_ARENA);
+    if (!c->shards || !c->dense_arena) {
+        free(c->shards);
+        arena_destroy(c->dense_arena);
+        free(c);
+        return false;
+    }
+    c->shard_mask = n - 1;
+
+    for (size_t i = 0; i < n; i++) {
+        InternShard *shard = &c->shards[i];
+        shard->arena = arena_create(INTERN_SHARD_INITIAL_ARENA);
+        shard->hashmap = shard->arena ? hashmap_create(shard->arena, INTERN_SHARD_INITIAL_MAP) : NULL;
+        if (!shard->hashmap) {
+            for (size_t j = 0; j <= i; j++) arena_destroy(c->shards[j].arena);
+            for (size_t j = 0; j < i; j++) pthread_mutex_destroy(&c->shards[j].lock);
+            arena_destroy(c->dense_arena);
+            free(c->shards);
+            free(c);
+            return false;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    pthread_mutex_init(&c->dense_lock, NULL);
+
+    /* Keep dense_array growth off the (possibly shared) interner arena. */
+    c->saved_dense_arena = interner->dense_array->arena;
+    interner->dense_array->arena = c->dense_arena;
+
+    interner->concurrent = c;
+    return true;
+}
+
+void intern_table_end_concurrent(DenseArenaInterner *interner) {
+    if (!interner || !interner->concurrent) return;
+    struct InternConcurrent *c = interner->concurrent;
+    interner->concurrent = NULL;
+
+    for (size_t i = 0; i <= c->shard_mask; i++) {
+        InternShard *shard = &c->shards[i];
+        HashMap *map = shard->hashmap;
+        void *key, *value;
+        for (size_t cursor = 0; hashmap_next(map, &cursor, &key, &value); ) {
+            hashmap_put_hashed(interner->hashmap, key, value, intern_key_hash(key),
+                               intern_key_hash, interner->cmp_func);
+        }
+        pthread_mutex_destroy(&shard->lock);
+        arena_merge(interner->arena, shard->arena);
+    }
+
+    interner->dense_array->arena = c->saved_dense_arena;
+    arena_merge(interner->arena, c->dense_arena);
+
+    pthread_mutex_destroy(&c->dense_lock);
+    free(c->shards);
+    free(c);
+}
+
 /* Return canonical key pointer (here: Slice*) or NULL */
 void* intern_ptr(DenseArenaInterner *I, Slice* slice, void *meta) {
     InternResult *r = intern(I, slice, meta);
@@ -126,10 +294,18 @@ int intern_idx(DenseArenaInterner *I, Slice* slice, void *meta) {
 
 InternResult* intern_peek(DenseArenaInterner *interner, Slice *slice)
 {
-    if (!interner || !slice || !slice->ptr || slice->len == 0) return NULL;
+    if (!interner || !slice || !slice->ptr) return NULL; /* Like intern, the empty slice is a key */
 
     /* Lookup existing entry without inserting */
-    return hashmap_get(interner->hashmap, slice, interner->hash_func, interner->cmp_func);
+    size_t hash = interner->hash_func(slice);
+    InternResult *found = hashmap_get_hashed(interner->hashmap, slice, hash, interner->cmp_func);
+    if (found || !interner->concurrent) return found;
+
+    InternShard *shard = intern_shard_for(interner->concurrent, hash);
+    pthread_mutex_lock(&shard->lock);
+    found = hashmap_get_hashed(shard->hashmap, slice, hash, interner->cmp_func);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
 }
 
 /* Return canonical C string for a dense index (for printing). Returns NULL for invalid idx. */
@@ -139,21 +315,10 @@ const char *interner_get_cstr(DenseArenaInterner *I, int idx) {
     if (idx < 0 || idx >= I->dense_index_count) return NULL;
     if (!I->dense_array) return NULL;
 
-    // Bounds check
-    size_t count = I->dense_array->count;
-    if ((size_t)idx >= count) return NULL;
-
     // get the InternResult* at dense index
-    void *elem_ptr = dynarray_get(I->dense_array, (size_t)idx);
-    if (!elem_ptr) return NULL;
-
-    // cast to InternResult*
-    InternResult *res = *(InternResult **)elem_ptr;
+    InternResult *res = *(InternResult **)dynarray_at(I->dense_array, (size_t)idx);
     if (!res || !res->key) return NULL;
-
-    // Extract pointer to in arena-allocated Slice
-    Slice *ks = (Slice *)res->key;
-    return ks->ptr;
+    return ((Slice *)res->key)->ptr;
 }
 
 InternResult *interner_get_result(DenseArenaInterner *I, int idx) {
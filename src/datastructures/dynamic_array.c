@@ -134,3 +134,18 @@ void dynarray_init_in_arena(DynArray *da, Arena *arena, size_t elem_size, size_t
         dynarray_reserve_in_arena(da, initial_capacity);
     }
 }
+
+#ifdef DEV_BUILD
+#include <stdio.h>
+
+void dynarray_index_fail(const DynArray *da, size_t index, size_t elem_size) {
+    if (!da) {
+        fprintf(stderr, "dynarray: access to a NULL array\n");
+    } else if (elem_size != da->elem_size) {
+        fprintf(stderr, "dynarray: element size %zu used on an array of %zu-byte elements\n", elem_size, da->elem_size);
+    } else {
+        fprintf(stderr, "dynarray: index %zu out of bounds (count %zu)\n", index, da->count);
+    }
+    abort();
+}
+#endif
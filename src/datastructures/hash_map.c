@@ -1,12 +1,193 @@
 #include "datastructures/hash_map.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define TOMBSTONE ((void*)-1)
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+// Control bytes: a full slot stores a 7-bit tag of its key's hash, so the
+// high bit alone tells full slots from free ones.
+#define CTRL_EMPTY   ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+#define CTRL_IS_FULL(c) ((c) < 0x80)
+
+#define GROUP HASHMAP_GROUP_WIDTH
+
+// The probe loops are written once, against `hash`/`cmp` parameters, and
+// forced inline into each entry point. The ptrmap_* entry points pass
+// ptr_hash/ptr_cmp as constants, so those calls fold into plain pointer
+// arithmetic and compares.
+#if defined(__GNUC__) || defined(__clang__)
+    #define PROBE_INLINE inline __attribute__((always_inline))
+#else
+    #define PROBE_INLINE inline
+#endif
+
+/* -----------------------------
+   Group matching
+   -----------------------------
+   A GroupMask has one set bit per matching slot of a 16-byte group; slot i
+   of the group is bit (i << MASK_SHIFT) (+3 on NEON, where the mask is
+   built from 4-bit lanes). */
+
+typedef uint64_t GroupMask;
+
+#if defined(__SSE2__)
+
+#define MASK_SHIFT 0
+
+static inline GroupMask group_match(const uint8_t *g, uint8_t c) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)g);
+    return (GroupMask)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+}
+
+static inline GroupMask group_match_free(const uint8_t *g) {
+    return (GroupMask)(unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)g));
+}
+
+#elif defined(__ARM_NEON)
+
+#define MASK_SHIFT 2
+
+static inline GroupMask neon_mask(uint8x16_t eq) {
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+}
+
+static inline GroupMask group_match(const uint8_t *g, uint8_t c) {
+    return neon_mask(vceqq_u8(vld1q_u8(g), vdupq_n_u8(c)));
+}
+
+static inline GroupMask group_match_free(const uint8_t *g) {
+    return neon_mask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(g)), vdupq_n_s8(0)));
+}
+
+#else
+
+#define MASK_SHIFT 0
+
+static inline GroupMask group_match(const uint8_t *g, uint8_t c) {
+    GroupMask m = 0;
+    for (int i = 0; i < GROUP; i++) m |= (GroupMask)(g[i] == c) << i;
+    return m;
+}
+
+static inline GroupMask group_match_free(const uint8_t *g) {
+    GroupMask m = 0;
+    for (int i = 0; i < GROUP; i++) m |= (GroupMask)(!CTRL_IS_FULL(g[i])) << i;
+    return m;
+}
+
+#endif
+
+static inline size_t mask_first(GroupMask m) {
+    return (size_t)__builtin_ctzll(m) >> MASK_SHIFT;
+}
+
+static inline size_t mask_last(GroupMask m) {
+    return (size_t)(63 - __builtin_clzll(m)) >> MASK_SHIFT;
+}
+
+/* -----------------------------
+   Table layout helpers
+   ----------------------------- */
+
+// The probe start comes straight from the caller's hash, which keeps keys
+// that hash to neighbouring values (ptr_hash on arena-allocated nodes) in
+// neighbouring slots. The 7-bit tag takes the top bits of a multiplicative
+// mix instead, since those hashes rarely vary in their own high bits.
+static inline uint8_t hash_tag(size_t h) {
+    return (uint8_t)(((uint64_t)h * 0x9E3779B97F4A7C15ull) >> 57);
+}
+
+// Keep at least 1/8 of the slots EMPTY so every probe terminates.
+static inline size_t max_load(size_t capacity) {
+    return capacity - capacity / 8;
+}
+
+static size_t round_capacity(size_t n) {
+    size_t cap = GROUP;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+// Groups are loaded unaligned, so a group starting near the end reads the
+// mirrored copy of the first GROUP control bytes.
+static inline void set_ctrl(HashMap *map, size_t i, uint8_t c) {
+    map->ctrl[i] = c;
+    map->ctrl[((i - GROUP) & (map->capacity - 1)) + GROUP] = c;
+}
+
+static bool alloc_table(Arena *arena, size_t capacity, KeyValue **entries, uint8_t **ctrl) {
+    size_t bytes = capacity * sizeof(KeyValue) + capacity + GROUP;
+    void *mem = arena ? arena_alloc(arena, bytes) : malloc(bytes);
+    if (!mem) return false;
+    MEM_ACCOUNT(MEM_HASHMAP, MEM_KIND_NONE, SOURCE_NONE, bytes, 0);
+    *entries = mem;
+    *ctrl = (uint8_t*)mem + capacity * sizeof(KeyValue);
+    memset(*ctrl, CTRL_EMPTY, capacity + GROUP);
+    return true;
+}
+
+/* Triangular probing over groups visits every group of a power-of-two table. */
+static PROBE_INLINE bool find_index(HashMap *map, void *key, size_t h, int (*cmp)(void*, void*), size_t *out) {
+    size_t mask = map->capacity - 1;
+    size_t pos = h & mask;
+    uint8_t tag = hash_tag(h);
+    STAT_INC(HASHMAP_LOOKUPS);
+
+    // Most keys sit in their home slot; check it before loading a group
+    if (map->ctrl[pos] == tag && cmp(map->entries[pos].key, key) == 0) {
+        *out = pos;
+        return true;
+    }
+
+    bool found = false;
+    size_t groups = 0;
+    for (size_t stride = 0; stride <= map->capacity; ) {
+        const uint8_t *g = map->ctrl + pos;
+        groups++;
+        for (GroupMask hits = group_match(g, tag); hits; hits &= hits - 1) {
+            size_t i = (pos + mask_first(hits)) & mask;
+            if (cmp(map->entries[i].key, key) == 0) {
+                *out = i;
+                found = true;
+                goto done;
+            }
+        }
+        if (group_match(g, CTRL_EMPTY)) break;
+        stride += GROUP;
+        pos = (pos + stride) & mask;
+    }
+done:
+    STAT_ADD(HASHMAP_PROBE_GROUPS, groups);
+    STAT_MAX(HASHMAP_PROBE_MAX, groups);
+    return found;
+}
+
+/* First EMPTY or DELETED slot on the probe sequence of `h`. */
+static size_t find_free_index(HashMap *map, size_t h) {
+    size_t mask = map->capacity - 1;
+    size_t pos = h & mask;
+
+    for (size_t stride = 0; ; ) {
+        GroupMask free_slots = group_match_free(map->ctrl + pos);
+        if (free_slots) return (pos + mask_first(free_slots)) & mask;
+        stride += GROUP;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/* -----------------------------
+   Public API
+   ----------------------------- */
 
 HashMap* hashmap_create(Arena *arena, size_t initial_capacity) {
-    if (initial_capacity < 8) initial_capacity = 8;
-    
     HashMap *map;
     if (arena) {
         map = arena_alloc(arena, sizeof(HashMap));
@@ -14,19 +195,15 @@ HashMap* hashmap_create(Arena *arena, size_t initial_capacity) {
         map = calloc(1, sizeof(HashMap));
     }
     if (!map) return NULL;
+    MEM_ACCOUNT(MEM_HASHMAP, MEM_KIND_NONE, SOURCE_NONE, sizeof(HashMap), 1);
 
     map->arena = arena;
-    map->capacity = initial_capacity;
+    map->capacity = round_capacity(initial_capacity);
     map->size = 0;
     map->tombstones = 0;
+    map->growth_left = max_load(map->capacity);
 
-    if (arena) {
-        map->entries = arena_calloc(arena, sizeof(KeyValue) * initial_capacity);
-    } else {
-        map->entries = calloc(initial_capacity, sizeof(KeyValue));
-    }
-
-    if (!map->entries) {
+    if (!alloc_table(arena, map->capacity, &map->entries, &map->ctrl)) {
         if (!arena) free(map);
         return NULL;
     }
@@ -43,11 +220,9 @@ void hashmap_destroy(
 
     if (free_key || free_value) {
         for (size_t i = 0; i < map->capacity; i++) {
-            void *k = map->entries[i].key;
-            if (k != NULL && k != TOMBSTONE) {
-                if (free_key) free_key(k);
-                if (free_value && map->entries[i].value) free_value(map->entries[i].value);
-            }
+            if (!CTRL_IS_FULL(map->ctrl[i])) continue;
+            if (free_key) free_key(map->entries[i].key);
+            if (free_value && map->entries[i].value) free_value(map->entries[i].value);
         }
     }
 
@@ -65,34 +240,119 @@ bool hashmap_rehash(
 ) {
     if (!map || new_capacity == 0 || !hash || !cmp) return false;
 
-    KeyValue *new_entries;
-    if (map->arena) {
-        new_entries = arena_calloc(map->arena, sizeof(KeyValue) * new_capacity);
-    } else {
-        new_entries = calloc(new_capacity, sizeof(KeyValue));
+    new_capacity = round_capacity(new_capacity);
+    while (max_load(new_capacity) <= map->size) new_capacity <<= 1;
+
+    KeyValue *old_entries = map->entries;
+    uint8_t *old_ctrl = map->ctrl;
+    size_t old_capacity = map->capacity;
+
+    if (!alloc_table(map->arena, new_capacity, &map->entries, &map->ctrl)) {
+        map->entries = old_entries;
+        map->ctrl = old_ctrl;
+        return false;
     }
-    if (!new_entries) return false;
+    map->capacity = new_capacity;
 
-    for (size_t i = 0; i < map->capacity; i++) {
-        void *k = map->entries[i].key;
-        if (k != NULL && k != TOMBSTONE) {
-            size_t h = hash(k);
-            size_t index = h % new_capacity;
-            
-            while (new_entries[index].key != NULL) {
-                index = (index + 1) % new_capacity;
-            }
-            new_entries[index] = map->entries[i];
-        }
+    // Keys are distinct, so reinsertion never needs `cmp`
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!CTRL_IS_FULL(old_ctrl[i])) continue;
+        size_t h = hash(old_entries[i].key);
+        size_t index = find_free_index(map, h);
+        set_ctrl(map, index, hash_tag(h));
+        map->entries[index] = old_entries[i];
     }
 
     if (!map->arena) {
-        free(map->entries);
+        free(old_entries);
     }
 
-    map->entries = new_entries;
-    map->capacity = new_capacity;
     map->tombstones = 0;
+    map->growth_left = max_load(new_capacity) - map->size;
+    return true;
+}
+
+// `hash` is only called again if the table has to be rebuilt, on the keys
+// already stored.
+static PROBE_INLINE bool put_impl(HashMap *map, void *key, void *value, size_t h,
+                                  size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    // One probe both looks for the key and remembers the first free slot
+    size_t mask = map->capacity - 1;
+    size_t pos = h & mask;
+    uint8_t tag = hash_tag(h);
+    size_t index = (size_t)-1;
+
+    for (size_t stride = 0; stride <= map->capacity; ) {
+        const uint8_t *g = map->ctrl + pos;
+        for (GroupMask hits = group_match(g, tag); hits; hits &= hits - 1) {
+            size_t i = (pos + mask_first(hits)) & mask;
+            if (cmp(map->entries[i].key, key) == 0) {
+                // Update existing
+                map->entries[i].value = value;
+                return true;
+            }
+        }
+        if (index == (size_t)-1) {
+            GroupMask free_slots = group_match_free(g);
+            if (free_slots) index = (pos + mask_first(free_slots)) & mask;
+        }
+        if (group_match(g, CTRL_EMPTY)) break;
+        stride += GROUP;
+        pos = (pos + stride) & mask;
+    }
+
+    if (map->ctrl[index] == CTRL_EMPTY && map->growth_left == 0) {
+        // Mostly tombstones: rebuild at the same size; otherwise grow
+        size_t new_cap = map->size < max_load(map->capacity) / 2 ? map->capacity : map->capacity * 2;
+        if (!hashmap_rehash(map, new_cap, hash, cmp)) return false;
+        index = find_free_index(map, h);
+    }
+
+    if (map->ctrl[index] == CTRL_DELETED) {
+        map->tombstones--;
+    } else {
+        map->growth_left--;
+    }
+    set_ctrl(map, index, hash_tag(h));
+    map->entries[index].key = key;
+    map->entries[index].value = value;
+    map->size++;
+    return true;
+}
+
+static PROBE_INLINE void *get_impl(HashMap *map, void *key, size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    size_t index;
+    if (!find_index(map, key, hash(key), cmp, &index)) return NULL;
+    return map->entries[index].value;
+}
+
+static PROBE_INLINE bool remove_impl(HashMap *map, void *key, size_t (*hash)(void*), int (*cmp)(void*, void*),
+                                     void (*free_key)(void*), void (*free_value)(void*)) {
+    size_t index;
+    if (!find_index(map, key, hash(key), cmp, &index)) return false;
+
+    if (free_key) free_key(map->entries[index].key);
+    if (free_value && map->entries[index].value) free_value(map->entries[index].value);
+    map->entries[index].key = NULL;
+    map->entries[index].value = NULL;
+    map->size--;
+
+    // A probe only walks past this slot if it saw a whole group without an
+    // EMPTY byte. When the full run around the slot is shorter than a group,
+    // no probe did, and the slot can go straight back to EMPTY.
+    size_t mask = map->capacity - 1;
+    GroupMask empty_after = group_match(map->ctrl + index, CTRL_EMPTY);
+    GroupMask empty_before = group_match(map->ctrl + ((index - GROUP) & mask), CTRL_EMPTY);
+    bool never_full = empty_after && empty_before &&
+                      mask_first(empty_after) + (GROUP - 1 - mask_last(empty_before)) < GROUP;
+
+    if (never_full) {
+        set_ctrl(map, index, CTRL_EMPTY);
+        map->growth_left++;
+    } else {
+        set_ctrl(map, index, CTRL_DELETED);
+        map->tombstones++;
+    }
     return true;
 }
 
@@ -104,43 +364,20 @@ bool hashmap_put(
     int (*cmp)(void*, void*)
 ) {
     if (!map || !key || !hash || !cmp) return false;
+    return put_impl(map, key, value, hash(key), hash, cmp);
+}
 
-    // Resize if load factor > 0.75 (counting tombstones as used)
-    if (map->size + map->tombstones >= (map->capacity * 3) / 4) {
-        size_t new_cap = map->capacity * 2;
-        hashmap_rehash(map, new_cap, hash, cmp);
-    }
-
-    size_t h = hash(key);
-    size_t index = h % map->capacity;
-    size_t first_tombstone = (size_t)-1;
-
-    for (size_t i = 0; i < map->capacity; i++) {
-        void *k = map->entries[index].key;
-        if (k == NULL) {
-            // Found empty slot
-            if (first_tombstone != (size_t)-1) {
-                index = first_tombstone;
-                map->tombstones--;
-            }
-            map->entries[index].key = key;
-            map->entries[index].value = value;
-            map->size++;
-            return true;
-        } else if (k == TOMBSTONE) {
-            if (first_tombstone == (size_t)-1) {
-                first_tombstone = index;
-            }
-        } else if (cmp(k, key) == 0) {
-            // Update existing
-            map->entries[index].value = value;
-            return true;
-        }
-        index = (index + 1) % map->capacity;
-    }
+bool hashmap_put_hashed(HashMap *map, void *key, void *value, size_t h,
+                        size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    if (!map || !key || !hash || !cmp) return false;
+    return put_impl(map, key, value, h, hash, cmp);
+}
 
-    // Should never reach here if resizing correctly
-    return false;
+void *hashmap_get_hashed(HashMap *map, void *key, size_t h, int (*cmp)(void*, void*)) {
+    if (!map || !key || !cmp) return NULL;
+    size_t index;
+    if (!find_index(map, key, h, cmp, &index)) return NULL;
+    return map->entries[index].value;
 }
 
 void* hashmap_get(
@@ -150,21 +387,7 @@ void* hashmap_get(
     int (*cmp)(void*, void*)
 ) {
     if (!map || !key || !hash || !cmp) return NULL;
-
-    size_t h = hash(key);
-    size_t index = h % map->capacity;
-
-    for (size_t i = 0; i < map->capacity; i++) {
-        void *k = map->entries[index].key;
-        if (k == NULL) {
-            return NULL;
-        } else if (k != TOMBSTONE && cmp(k, key) == 0) {
-            return map->entries[index].value;
-        }
-        index = (index + 1) % map->capacity;
-    }
-
-    return NULL;
+    return get_impl(map, key, hash, cmp);
 }
 
 bool hashmap_remove(
@@ -176,28 +399,45 @@ bool hashmap_remove(
     void (*free_value)(void*)
 ) {
     if (!map || !key || !hash || !cmp) return false;
+    return remove_impl(map, key, hash, cmp, free_key, free_value);
+}
 
-    size_t h = hash(key);
-    size_t index = h % map->capacity;
+/* -----------------------------
+   Pointer-keyed entry points
+   ----------------------------- */
 
-    for (size_t i = 0; i < map->capacity; i++) {
-        void *k = map->entries[index].key;
-        if (k == NULL) {
-            return false;
-        } else if (k != TOMBSTONE && cmp(k, key) == 0) {
-            if (free_key) free_key(k);
-            if (free_value && map->entries[index].value) free_value(map->entries[index].value);
-            
-            map->entries[index].key = TOMBSTONE;
-            map->entries[index].value = NULL;
-            map->size--;
-            map->tombstones++;
-            return true;
-        }
-        index = (index + 1) % map->capacity;
+bool ptrmap_put(HashMap *map, void *key, void *value) {
+    if (!map || !key) return false;
+    return put_impl(map, key, value, ptr_hash(key), ptr_hash, ptr_cmp);
+}
+
+void *ptrmap_get(HashMap *map, void *key) {
+    if (!map || !key) return NULL;
+    return get_impl(map, key, ptr_hash, ptr_cmp);
+}
+
+bool ptrmap_remove(HashMap *map, void *key) {
+    if (!map || !key) return false;
+    return remove_impl(map, key, ptr_hash, ptr_cmp, NULL, NULL);
+}
+
+size_t ptrmap_get_many(HashMap *map, void *const *keys, void **values, size_t count) {
+    if (!map) return 0;
+
+    // Touch every home group first so the misses overlap, then probe
+    size_t mask = map->capacity - 1;
+    for (size_t i = 0; i < count; i++) {
+        size_t pos = ptr_hash(keys[i]) & mask;
+        __builtin_prefetch(map->ctrl + pos);
+        __builtin_prefetch(map->entries + pos);
     }
 
-    return false;
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        values[i] = keys[i] ? get_impl(map, keys[i], ptr_hash, ptr_cmp) : NULL;
+        if (values[i]) found++;
+    }
+    return found;
 }
 
 void hashmap_foreach(
@@ -207,13 +447,26 @@ void hashmap_foreach(
     if (!map || !callback) return;
 
     for (size_t i = 0; i < map->capacity; i++) {
-        void *k = map->entries[i].key;
-        if (k != NULL && k != TOMBSTONE) {
-            callback(k, map->entries[i].value);
+        if (CTRL_IS_FULL(map->ctrl[i])) {
+            callback(map->entries[i].key, map->entries[i].value);
         }
     }
 }
 
+bool hashmap_next(HashMap* map, size_t *cursor, void **key, void **value) {
+    if (!map || !cursor) return false;
+
+    for (size_t i = *cursor; i < map->capacity; i++) {
+        if (!CTRL_IS_FULL(map->ctrl[i])) continue;
+        if (key) *key = map->entries[i].key;
+        if (value) *value = map->entries[i].value;
+        *cursor = i + 1;
+        return true;
+    }
+    *cursor = map->capacity;
+    return false;
+}
+
 size_t hashmap_size(HashMap* map) {
     return map ? map->size : 0;
 }
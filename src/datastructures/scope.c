@@ -1,6 +1,8 @@
 #include "datastructures/scope.h"
 #include "sema/type.h"
 #include "core/module_loader.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -8,6 +10,7 @@
 Scope *scope_create(Arena *arena, Scope *parent, int identifier_count, int kind) {
     Scope *scope = arena_calloc(arena, sizeof(Scope));
     if (!scope) return NULL;
+    MEM_ACCOUNT(MEM_SCOPES, MEM_KIND_NONE, SOURCE_NONE, sizeof(Scope), 1);
 
     // A small initial capacity is fine since hashmap handles resizing and 
     // we no longer rely on dense indices to determine scope boundaries.
@@ -27,8 +30,129 @@ Scope *scope_create(Arena *arena, Scope *parent, int identifier_count, int kind)
     return scope;
 }
 
+Arena *scope_set_arena(Scope *scope, Arena *arena) {
+    Arena *previous = scope->arena;
+    scope->arena = arena;
+    if (scope->symbols) scope->symbols->arena = arena;
+    scope->symbols_list.arena = arena;
+    return previous;
+}
+
+SymbolTable *symbol_table_create(Arena *arena, size_t identifier_count) {
+    SymbolTable *table = arena_calloc(arena, sizeof(SymbolTable));
+    if (!table) return NULL;
+    table->arena = arena;
+    table->capacity = identifier_count > 64 ? identifier_count : 64;
+    table->heads = arena_calloc(arena, table->capacity * sizeof(ScopeBinding*));
+    MEM_ACCOUNT(MEM_SCOPES, MEM_KIND_NONE, SOURCE_NONE, sizeof(SymbolTable) + table->capacity * sizeof(ScopeBinding*), 0);
+    return table;
+}
+
+Scope *scope_create_local(SymbolTable *table, Scope *parent) {
+    Scope *scope = arena_calloc(table->arena, sizeof(Scope));
+    if (!scope) return NULL;
+    MEM_ACCOUNT(MEM_SCOPES, MEM_KIND_NONE, SOURCE_NONE, sizeof(Scope), 1);
+
+    dynarray_init_in_arena(&scope->symbols_list, table->arena, sizeof(Symbol *), 4);
+
+    scope->depth = parent ? parent->depth + 1 : 0;
+    scope->parent = parent;
+    scope->arena = table->arena;
+    scope->kind = SCOPE_IDENTIFIERS;
+    scope->locals = table;
+    scope->outer = parent && parent->locals ? parent->outer : parent;
+
+    return scope;
+}
+
+void scope_exit(Scope *scope) {
+    if (!scope || !scope->locals) return;
+    ScopeBinding **heads = scope->locals->heads;
+
+    for (ScopeBinding *b = scope->bindings; b; b = b->next_in_scope) {
+        // Scopes normally close innermost first, so `b` is on top; a scope
+        // left open by an early exit can still sit above it
+        ScopeBinding **link = &heads[b->dense_index];
+        while (*link && *link != b) link = &(*link)->shadowed;
+        if (*link) *link = b->shadowed;
+    }
+    scope->bindings = NULL;
+}
+
+// Whether `outer` is `scope` or one of its ancestors
+static bool scope_encloses(Scope *outer, Scope *scope) {
+    while (scope && scope->depth > outer->depth) scope = scope->parent;
+    return scope == outer;
+}
+
+static ScopeBinding *local_binding_in(Scope *scope, InternResult *rec) {
+    size_t index = rec->entry->dense_index;
+    if (index >= scope->locals->capacity) return NULL;
+    for (ScopeBinding *b = scope->locals->heads[index]; b; b = b->shadowed) {
+        if (b->scope == scope) return b;
+    }
+    return NULL;
+}
+
+// Innermost binding visible from `scope`. Bindings of other functions
+// (a generic instance checked mid-body) or of closed sibling scopes are
+// skipped by the ancestry check.
+static Symbol *local_lookup(Scope *scope, InternResult *rec) {
+    size_t index = rec->entry->dense_index;
+    if (index >= scope->locals->capacity) return NULL;
+
+    ScopeBinding *best = NULL;
+    for (ScopeBinding *b = scope->locals->heads[index]; b; b = b->shadowed) {
+        if (b->scope == scope) return b->symbol;
+        if ((!best || b->scope->depth > best->scope->depth) && scope_encloses(b->scope, scope)) best = b;
+    }
+    return best ? best->symbol : NULL;
+}
+
+static void local_bind(Scope *scope, InternResult *rec, Symbol *symbol) {
+    // Keyword records use their own dense numbering; like before, a
+    // keyword-named local is kept in the list but never resolved
+    if (rec->entry->meta != NULL) return;
+
+    ScopeBinding *existing = local_binding_in(scope, rec);
+    if (existing) {
+        existing->symbol = symbol;
+        return;
+    }
+
+    SymbolTable *table = scope->locals;
+    size_t index = rec->entry->dense_index;
+    if (index >= table->capacity) {
+        // The interner keeps growing during checking (mangled names)
+        size_t capacity = table->capacity * 2;
+        while (capacity <= index) capacity *= 2;
+        ScopeBinding **heads = arena_calloc(table->arena, capacity * sizeof(ScopeBinding*));
+        MEM_ACCOUNT(MEM_SCOPES, MEM_KIND_NONE, SOURCE_NONE, capacity * sizeof(ScopeBinding*), 0);
+        memcpy(heads, table->heads, table->capacity * sizeof(ScopeBinding*));
+        table->heads = heads;
+        table->capacity = capacity;
+    }
+
+    ScopeBinding *b = arena_alloc(table->arena, sizeof(ScopeBinding));
+    MEM_ACCOUNT(MEM_SCOPES, MEM_KIND_NONE, SOURCE_NONE, sizeof(ScopeBinding), 0);
+    b->symbol = symbol;
+    b->scope = scope;
+    b->dense_index = index;
+    b->shadowed = table->heads[index];
+    b->next_in_scope = scope->bindings;
+    table->heads[index] = b;
+    scope->bindings = b;
+}
+
+static void scope_bind(Scope *scope, InternResult *rec, Symbol *symbol) {
+    // Pointer identity is enough: rec->key is a unique, interned Slice*
+    if (scope->locals) local_bind(scope, rec, symbol);
+    else ptrmap_put(scope->symbols, rec->key, symbol);
+}
+
 Symbol *scope_make_overload_set(Arena *arena, Symbol *first, Symbol *second) {
     Symbol *set = arena_calloc(arena, sizeof(Symbol));
+    MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, first->file, sizeof(Symbol) + sizeof(DynArray), 1);
     set->name_rec = first->name_rec;
     set->kind     = SYMBOL_OVERLOAD_SET;
     set->is_pub   = first->is_pub || second->is_pub;
@@ -45,7 +169,7 @@ bool scope_overload_set_add(Symbol *set, Symbol *fn_sym, Arena *arena) {
 
     // Reject identical signatures (same param types).
     for (size_t i = 0; i < set->overloads->count; i++) {
-        Symbol *existing = *(Symbol**)dynarray_get(set->overloads, i);
+        Symbol *existing = DYNARRAY_AT(Symbol*, set->overloads, i);
         Type *et = existing->type;
         Type *nt = fn_sym->type;
         
@@ -73,7 +197,7 @@ bool scope_overload_set_add(Symbol *set, Symbol *fn_sym, Arena *arena) {
     return true;
 }
 
-Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolValue kind, const char *filename, bool is_pub, AstNode *decl_node) {
+Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolValue kind, SourceId file, bool is_pub, AstNode *decl_node) {
     if (!scope || !rec) {
         return NULL;
     }
@@ -105,11 +229,12 @@ Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolV
 
             Symbol *candidate = arena_calloc(scope->arena, sizeof(Symbol));
             if (!candidate) return NULL;
+            MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, file, sizeof(Symbol), 1);
 
             candidate->name_rec  = rec;
             candidate->type      = type;
             candidate->kind      = SYMBOL_VALUE_FUNCTION;
-            candidate->filename  = filename;
+            candidate->file      = file;
             candidate->is_pub    = is_pub;
             candidate->decl_node = decl_node;
             candidate->flags     = SYMBOL_FLAG_NONE;
@@ -117,7 +242,7 @@ Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolV
             if (existing->kind == SYMBOL_VALUE_FUNCTION) {
                 // First collision -> upgrade to set
                 Symbol *set = scope_make_overload_set(scope->arena, existing, candidate);
-                hashmap_put(scope->symbols, rec->key, set, ptr_hash, ptr_cmp);
+                scope_bind(scope, rec, set);
                 
                 // Replace in symbols_list
                 for (size_t i = 0; i < scope->symbols_list.count; i++) {
@@ -143,19 +268,19 @@ Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolV
     if (!symbol) {
         return NULL;
     }
+    MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, file, sizeof(Symbol), 1);
 
     symbol->name_rec = rec;
     symbol->type = type;
     symbol->kind = kind;
     symbol->flags = SYMBOL_FLAG_NONE;
-    symbol->filename = filename;
+    symbol->file = file;
     symbol->is_pub = is_pub;
     symbol->decl_node = decl_node;
     symbol->module_scope = NULL;
 
-    // Use ptr_hash and ptr_cmp since rec->key is guaranteed to be a unique, interned Slice*
-    hashmap_put(scope->symbols, rec->key, symbol, ptr_hash, ptr_cmp);
-    
+    scope_bind(scope, rec, symbol);
+
     dynarray_push_value(&scope->symbols_list, &symbol);
 
     return symbol;
@@ -163,16 +288,34 @@ Symbol *scope_define_symbol(Scope *scope, InternResult *rec, Type *type, SymbolV
 
 Symbol *scope_lookup_symbol_local(Scope *scope, InternResult *rec) {
     if (!scope || !rec || !rec->key) return NULL;
-    return (Symbol*)hashmap_get(scope->symbols, rec->key, ptr_hash, ptr_cmp);
+    if (scope->locals) {
+        if (rec->entry->meta != NULL) return NULL;
+        ScopeBinding *b = local_binding_in(scope, rec);
+        return b ? b->symbol : NULL;
+    }
+    return (Symbol*)ptrmap_get(scope->symbols, rec->key);
 }
 
-Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, const char *caller_filename) {
-    if (!scope || !rec) return NULL;
-    
+/* The chain walk behind scope_lookup_symbol; `*walked` counts the scopes visited. */
+static Symbol *scope_lookup_walk(Scope *scope, InternResult *rec, SourceId caller_file, size_t *walked) {
     bool is_keyword_key = (rec->entry->meta != NULL);
 
     Scope *current = scope;
     while (current) {
+        (*walked)++;
+        // One probe covers every enclosing local scope of the function
+        if (current->locals) {
+            if (!is_keyword_key) {
+                Symbol *symbol = local_lookup(current, rec);
+                while (symbol && symbol->kind == SYMBOL_VALUE_ALIAS && symbol->target_symbol) {
+                    symbol = symbol->target_symbol;
+                }
+                if (symbol) return symbol; // Locals are always visible
+            }
+            current = current->outer;
+            continue;
+        }
+
         bool is_keyword_scope = (current->kind == SCOPE_KEYWORDS);
         
         if (is_keyword_key == is_keyword_scope) {
@@ -190,7 +333,7 @@ Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, const char *caller_
 
                  // Visibility check:
                  // 1. If this is the caller's own scope (e.g. its module global scope or a local block), everything is visible.
-                 if (current->unit && caller_filename && strcmp(current->unit->absolute_path, caller_filename) == 0) {
+                 if (current->unit && caller_file != SOURCE_NONE && current->unit->file == caller_file) {
                      return symbol;
                  }
                  
@@ -218,6 +361,17 @@ Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, const char *caller_
     return NULL;
 }
 
+Symbol *scope_lookup_symbol(Scope *scope, InternResult *rec, SourceId caller_file) {
+    if (!scope || !rec) return NULL;
+
+    size_t walked = 0;
+    Symbol *symbol = scope_lookup_walk(scope, rec, caller_file, &walked);
+    STAT_INC(SCOPE_LOOKUPS);
+    STAT_ADD(SCOPE_WALKED, walked);
+    STAT_MAX(SCOPE_DEPTH_MAX, walked);
+    return symbol;
+}
+
 
 Symbol *symbol_set_value_int(Symbol *symbol, int value){
     if (!symbol) return NULL;
@@ -246,7 +400,7 @@ size_t scope_get_symbol_count(Scope *scope){
 void scope_set_flags(Scope *scope, InternResult *rec, int flags){
     if (!scope || !rec) return;
 
-    Symbol *symbol = scope_lookup_symbol(scope, rec, NULL);
+    Symbol *symbol = scope_lookup_symbol(scope, rec, SOURCE_NONE);
     if (symbol) {
         symbol->flags |= flags;
     }
@@ -256,7 +410,7 @@ void scope_check_unused_symbols(Scope *scope){
     if (!scope) return;
 
     for (size_t i = 0; i < scope->symbols_list.count; i++) {
-        Symbol *symbol = *(Symbol**)dynarray_get(&scope->symbols_list, i);
+        Symbol *symbol = DYNARRAY_AT(Symbol*, &scope->symbols_list, i);
         if (symbol && !(symbol->flags & SYMBOL_FLAG_USED)) {
             // printf("Warning: Unused symbol '%s'\n", symbol->name_rec->key ? (char*)symbol->name_rec->key : "(unknown)");
         }
@@ -267,14 +421,14 @@ void scope_print_symbols(Scope *scope, int indent) {
     if (!scope) return;
 
     for (size_t i = 0; i < scope->symbols_list.count; ++i) {
-        Symbol *s = *(Symbol**)dynarray_get(&scope->symbols_list, i);
+        Symbol *s = DYNARRAY_AT(Symbol*, &scope->symbols_list, i);
         if (!s) continue;
         const char *name = s->name_rec && s->name_rec->key ? (char*)s->name_rec->key : "(unknown)";
         
         if (s->kind == SYMBOL_OVERLOAD_SET) {
             printf("%*s- Symbol: '%s' (OVERLOAD SET, count: %zu)\n", indent, "", name, s->overloads->count);
             for (size_t j = 0; j < s->overloads->count; j++) {
-                Symbol *cand = *(Symbol**)dynarray_get(s->overloads, j);
+                Symbol *cand = DYNARRAY_AT(Symbol*, s->overloads, j);
                 printf("%*s  [%zu] type: %s, flags: 0x%02x\n", indent, "", j, cand->type ? "(present)" : "(none)", (unsigned)cand->flags);
             }
         } else {
@@ -2,13 +2,14 @@
 // Lexer implementation using DynArray for token storage and the DenseArenaInterner
 //
 // Optimized: pointer-based scanning (cur/end), single-peek usage in branches,
-// and usage of intern_peek for keywords (no accidental insertion).
+// and a length-bucketed switch for keywords (no hash probe, no accidental insertion).
 
 #include "lexer.h"
 #include "dense_arena_interner.h"
 #include "token.h"
 #include "dynamic_array.h"
 #include "arena.h"
+#include "core/mem_report.h"
 
 
 #include <stdlib.h>
@@ -16,71 +17,339 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
 
 /* Initial token array capacity (used by dynarray as growth hint) */
 #define INITIAL_TOKEN_CAPACITY 256
 
-/* Keyword table for initial population (used only at startup) */
+/*
+ * Keyword table. lexer_populate_default_keywords interns it in this order,
+ * so a keyword's dense index in the keywords interner is its KW_* slot.
+ */
+enum {
+    KW_FN,
+    KW_IF,
+    KW_ELSE,
+    KW_WHILE,
+    KW_FOR,
+    KW_RETURN,
+    KW_BREAK,
+    KW_CONTINUE,
+    KW_DEFER,
+    KW_CONST,
+    KW_PUB,
+    KW_IMPORT,
+    KW_ALIAS,
+    KW_STRUCT,
+    KW_ENUM,
+    KW_IMPL,
+    KW_AS,
+    KW_I8,
+    KW_I16,
+    KW_I32,
+    KW_I64,
+    KW_U8,
+    KW_U16,
+    KW_U32,
+    KW_U64,
+    KW_BOOL,
+    KW_F32,
+    KW_F64,
+    KW_STR,
+    KW_CHAR,
+    KW_USIZE,
+    KW_ISIZE,
+    KW_VOID,
+    KW_TRUE,
+    KW_FALSE,
+    KW_NULL,
+    KW_SWITCH,
+    KW_CASE,
+    KW_ASYNC,
+    KW_AWAIT,
+    KW_COUNT
+};
+
 static const struct {
     const char *word;
     TokenKind type;
-} KEYWORDS[] = {
-    {"fn", TOK_FN},
-    {"if", TOK_IF},
-    {"else", TOK_ELSE},
-    {"while", TOK_WHILE},
-    {"for", TOK_FOR},
-    {"return", TOK_RETURN},
-    {"break", TOK_BREAK},
-    {"continue", TOK_CONTINUE},
-    {"defer", TOK_DEFER},
-    {"const", TOK_CONST},
-    {"pub", TOK_PUB},
-    {"import", TOK_IMPORT},
-    {"alias", TOK_ALIAS},
-    {"struct", TOK_STRUCT},
-    {"enum", TOK_ENUM},
-    {"impl", TOK_IMPL},
-    {"as", TOK_AS},
-    {"i8", TOK_I8},
-    {"i16", TOK_I16},
-    {"i32", TOK_I32},
-    {"i64", TOK_I64},
-    {"u8", TOK_U8},
-    {"u16", TOK_U16},
-    {"u32", TOK_U32},
-    {"u64", TOK_U64},
-    {"bool", TOK_BOOL},
-    {"f32", TOK_F32},
-    {"f64", TOK_F64},
-    {"str", TOK_STRING},
-    {"char", TOK_CHAR},
-    {"usize", TOK_USIZE},
-    {"isize", TOK_ISIZE},
-    {"void", TOK_VOID},
-    {"true", TOK_TRUE},
-    {"false", TOK_FALSE},
-    {"null", TOK_NULL},
-    {NULL, TOK_UNKNOWN}  /* sentinel */
+} KEYWORDS[KW_COUNT] = {
+    [KW_FN] = {"fn", TOK_FN},
+    [KW_IF] = {"if", TOK_IF},
+    [KW_ELSE] = {"else", TOK_ELSE},
+    [KW_WHILE] = {"while", TOK_WHILE},
+    [KW_FOR] = {"for", TOK_FOR},
+    [KW_RETURN] = {"return", TOK_RETURN},
+    [KW_BREAK] = {"break", TOK_BREAK},
+    [KW_CONTINUE] = {"continue", TOK_CONTINUE},
+    [KW_DEFER] = {"defer", TOK_DEFER},
+    [KW_CONST] = {"const", TOK_CONST},
+    [KW_PUB] = {"pub", TOK_PUB},
+    [KW_IMPORT] = {"import", TOK_IMPORT},
+    [KW_ALIAS] = {"alias", TOK_ALIAS},
+    [KW_STRUCT] = {"struct", TOK_STRUCT},
+    [KW_ENUM] = {"enum", TOK_ENUM},
+    [KW_IMPL] = {"impl", TOK_IMPL},
+    [KW_AS] = {"as", TOK_AS},
+    [KW_I8] = {"i8", TOK_I8},
+    [KW_I16] = {"i16", TOK_I16},
+    [KW_I32] = {"i32", TOK_I32},
+    [KW_I64] = {"i64", TOK_I64},
+    [KW_U8] = {"u8", TOK_U8},
+    [KW_U16] = {"u16", TOK_U16},
+    [KW_U32] = {"u32", TOK_U32},
+    [KW_U64] = {"u64", TOK_U64},
+    [KW_BOOL] = {"bool", TOK_BOOL},
+    [KW_F32] = {"f32", TOK_F32},
+    [KW_F64] = {"f64", TOK_F64},
+    [KW_STR] = {"str", TOK_STRING},
+    [KW_CHAR] = {"char", TOK_CHAR},
+    [KW_USIZE] = {"usize", TOK_USIZE},
+    [KW_ISIZE] = {"isize", TOK_ISIZE},
+    [KW_VOID] = {"void", TOK_VOID},
+    [KW_TRUE] = {"true", TOK_TRUE},
+    [KW_FALSE] = {"false", TOK_FALSE},
+    [KW_NULL] = {"null", TOK_NULL},
+    [KW_SWITCH] = {"switch", TOK_SWITCH},
+    [KW_CASE] = {"case", TOK_CASE},
+    [KW_ASYNC] = {"async", TOK_ASYNC},
+    [KW_AWAIT] = {"await", TOK_AWAIT},
 };
 
+/*
+ * Classify an identifier-shaped token as a keyword without touching a hash
+ * table: bucket by length, pick the single candidate by a character or two,
+ * then confirm with one memcmp. Returns the KW_* slot or -1.
+ */
+static int keyword_slot(const char *p, size_t len) {
+    int k = -1;
+    switch (len) {
+    case 2:
+        switch (p[0]) {
+        case 'f': k = KW_FN; break;
+        case 'i': k = p[1] == 'f' ? KW_IF : KW_I8; break;
+        case 'a': k = KW_AS; break;
+        case 'u': k = KW_U8; break;
+        }
+        break;
+    case 3:
+        switch (p[0]) {
+        case 'f': k = p[1] == 'o' ? KW_FOR : p[1] == '3' ? KW_F32 : KW_F64; break;
+        case 'i': k = p[1] == '1' ? KW_I16 : p[1] == '3' ? KW_I32 : KW_I64; break;
+        case 'u': k = p[1] == '1' ? KW_U16 : p[1] == '3' ? KW_U32 : KW_U64; break;
+        case 'p': k = KW_PUB; break;
+        case 's': k = KW_STR; break;
+        }
+        break;
+    case 4:
+        switch (p[0]) {
+        case 'e': k = p[1] == 'l' ? KW_ELSE : KW_ENUM; break;
+        case 'i': k = KW_IMPL; break;
+        case 'b': k = KW_BOOL; break;
+        case 'c': k = p[1] == 'h' ? KW_CHAR : KW_CASE; break;
+        case 'v': k = KW_VOID; break;
+        case 't': k = KW_TRUE; break;
+        case 'n': k = KW_NULL; break;
+        }
+        break;
+    case 5:
+        switch (p[0]) {
+        case 'w': k = KW_WHILE; break;
+        case 'b': k = KW_BREAK; break;
+        case 'd': k = KW_DEFER; break;
+        case 'c': k = KW_CONST; break;
+        case 'a': k = p[1] == 'l' ? KW_ALIAS : p[1] == 's' ? KW_ASYNC : KW_AWAIT; break;
+        case 'u': k = KW_USIZE; break;
+        case 'i': k = KW_ISIZE; break;
+        case 'f': k = KW_FALSE; break;
+        }
+        break;
+    case 6:
+        switch (p[0]) {
+        case 'r': k = KW_RETURN; break;
+        case 'i': k = KW_IMPORT; break;
+        case 's': k = p[1] == 't' ? KW_STRUCT : KW_SWITCH; break;
+        }
+        break;
+    case 8:
+        if (p[0] == 'c') k = KW_CONTINUE;
+        break;
+    }
+    if (k < 0 || memcmp(p, KEYWORDS[k].word, len) != 0) return -1;
+    return k;
+}
+
+/* -----------------------------
+   Block scanning
+   -----------------------------
+   Whitespace runs and identifier tails are found a block
+   at a time: 32 bytes with AVX2, 16 with SSE2 or NEON, 8 bytes through a
+   scalar loop elsewhere. A ScanMask has bit (i << SCAN_SHIFT) set when
+   byte i of the block belongs to the class (NEON builds it from 4-bit
+   lanes, as hash_map.c does). Blocks are only loaded when they lie wholly
+   before `end`; the tail is finished byte by byte. Identifier bytes are
+   [A-Za-z0-9_] and whitespace is ' ' and \t..\r, which is what isalpha/
+   isdigit/isspace accept in the C locale the compiler runs in. */
+
+typedef uint64_t ScanMask;
+
+/* Unsigned lo <= b <= hi, done as a biased signed compare */
+#define SCAN_RANGE_BIAS(lo)      ((char)(128 - (lo)))
+#define SCAN_RANGE_LIMIT(lo, hi) ((char)((hi) - (lo) - 127))
+
+#if defined(__AVX2__)
+
+#define SCAN_BLOCK 32
+#define SCAN_SHIFT 0
+
+static inline __m256i scan_in_range(__m256i v, int lo, int hi) {
+    __m256i biased = _mm256_add_epi8(v, _mm256_set1_epi8(SCAN_RANGE_BIAS(lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(SCAN_RANGE_LIMIT(lo, hi)), biased);
+}
+
+static inline ScanMask scan_ident(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i alpha = scan_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i digit = scan_in_range(v, '0', '9');
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+}
+
+static inline ScanMask scan_space(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i ctrl = scan_in_range(v, '\t', '\r');
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+}
+
+#elif defined(__SSE2__)
+
+#define SCAN_BLOCK 16
+#define SCAN_SHIFT 0
+
+static inline __m128i scan_in_range(__m128i v, int lo, int hi) {
+    __m128i biased = _mm_add_epi8(v, _mm_set1_epi8(SCAN_RANGE_BIAS(lo)));
+    return _mm_cmplt_epi8(biased, _mm_set1_epi8(SCAN_RANGE_LIMIT(lo, hi)));
+}
+
+static inline ScanMask scan_ident(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i alpha = scan_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = scan_in_range(v, '0', '9');
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+static inline ScanMask scan_space(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i ctrl = scan_in_range(v, '\t', '\r');
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(ctrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+}
+
+#elif defined(__ARM_NEON)
+
+#define SCAN_BLOCK 16
+#define SCAN_SHIFT 2
+
+static inline ScanMask scan_neon_mask(uint8x16_t m) {
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+}
+
+static inline uint8x16_t scan_in_range(uint8x16_t v, int lo, int hi) {
+    return vcleq_u8(vsubq_u8(v, vdupq_n_u8((uint8_t)lo)), vdupq_n_u8((uint8_t)(hi - lo)));
+}
+
+static inline ScanMask scan_ident(const char *p) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t alpha = scan_in_range(vorrq_u8(v, vdupq_n_u8(0x20)), 'a', 'z');
+    uint8x16_t digit = scan_in_range(v, '0', '9');
+    uint8x16_t under = vceqq_u8(v, vdupq_n_u8('_'));
+    return scan_neon_mask(vorrq_u8(vorrq_u8(alpha, digit), under));
+}
+
+static inline ScanMask scan_space(const char *p) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    return scan_neon_mask(vorrq_u8(scan_in_range(v, '\t', '\r'), vceqq_u8(v, vdupq_n_u8(' '))));
+}
+
+#else
+
+#define SCAN_BLOCK 8
+#define SCAN_SHIFT 0
+
+static inline bool scan_is_ident_byte(unsigned char b);
+static inline bool scan_is_space_byte(unsigned char b);
+
+static inline ScanMask scan_ident(const char *p) {
+    ScanMask m = 0;
+    for (int i = 0; i < SCAN_BLOCK; i++) m |= (ScanMask)scan_is_ident_byte((unsigned char)p[i]) << i;
+    return m;
+}
+
+static inline ScanMask scan_space(const char *p) {
+    ScanMask m = 0;
+    for (int i = 0; i < SCAN_BLOCK; i++) m |= (ScanMask)scan_is_space_byte((unsigned char)p[i]) << i;
+    return m;
+}
+
+#endif
+
+/* All SCAN_BLOCK lanes set */
+#define SCAN_FULL ((ScanMask)(SCAN_SHIFT ? 0x8888888888888888ull : \
+                              (SCAN_BLOCK == 64 ? ~0ull : (1ull << SCAN_BLOCK) - 1)))
+
+static inline bool scan_is_ident_byte(unsigned char b) {
+    return (unsigned)((b | 0x20) - 'a') < 26 || (unsigned)(b - '0') < 10 || b == '_';
+}
+
+static inline bool scan_is_space_byte(unsigned char b) {
+    return b == ' ' || (unsigned)(b - '\t') < 5;
+}
+
+/* First byte in [p, end) outside the class tested by `block`/`byte` */
+#define SCAN_WHILE(p, end, block, byte)                                          \
+    do {                                                                         \
+        while ((end) - (p) >= SCAN_BLOCK) {                                      \
+            ScanMask m_ = ~(block) & SCAN_FULL;                                  \
+            if (m_) return (p) + (__builtin_ctzll(m_) >> SCAN_SHIFT);            \
+            (p) += SCAN_BLOCK;                                                   \
+        }                                                                        \
+        while ((p) < (end) && (byte)) (p)++;                                     \
+        return (p);                                                              \
+    } while (0)
+
+static const char *scan_ident_end(const char *p, const char *end) {
+    SCAN_WHILE(p, end, scan_ident(p), scan_is_ident_byte((unsigned char)*p));
+}
+
+static const char *scan_space_end(const char *p, const char *end) {
+    SCAN_WHILE(p, end, scan_space(p), scan_is_space_byte((unsigned char)*p));
+}
 
 static inline char lexer_peek(const Lexer *lexer) {
     return lexer->cur < lexer->end ? *lexer->cur : '\0';
 }
 
-/* Advance returns the char consumed (like before) and updates pos/cur/line/col */
+/* Advance returns the char consumed; positions are byte offsets, lines are resolved later */
 static inline char lexer_advance(Lexer *lexer) {
     if (lexer->cur >= lexer->end) return '\0';
-    char c = *lexer->cur++;
     lexer->pos++;
-    if (c == '\n') {
-        lexer->line++;
-        lexer->col = 1;
-    } else {
-        lexer->col++;
-    }
-    return c;
+    return *lexer->cur++;
+}
+
+/* Move to `p` (at or after cur) */
+static inline void lexer_advance_to(Lexer *lexer, const char *p) {
+    lexer->pos += (size_t)(p - lexer->cur);
+    lexer->cur = p;
 }
 
 /* Portable classification: treat '_' as alpha, use ctype for letters/digits */
@@ -99,57 +368,50 @@ static Slice lexer_make_slice_from_ptrs(const char *start_ptr, const char *end_p
 /* Forward declarations */
 static bool lexer_add_token(Lexer *lexer, const Token *tok);
 
-/* Skip whitespace and comments (pointer-based) */
+/* Skip whitespace and comments: find the end of the whole run, then move there once */
 static void lexer_skip_whitespace(Lexer *lexer) {
-    while (lexer->cur < lexer->end) {
-        char c = *lexer->cur;
-
-        if (c == '\n') {
-            lexer_advance(lexer);
-            continue;
-        }
-
-        /* line comment // */
-        if (c == '/' && (lexer->cur + 1) < lexer->end && *(lexer->cur + 1) == '/') {
-            /* consume '//' */
-            lexer_advance(lexer);
-            lexer_advance(lexer);
-            while (lexer->cur < lexer->end && *lexer->cur != '\n') lexer_advance(lexer);
-            continue;
-        }
-
-        /* block comment ... */
-        if (c == '/' && (lexer->cur + 1) < lexer->end && *(lexer->cur + 1) == '*') {
-            lexer_advance(lexer); /* '/' */
-            lexer_advance(lexer); /* '*' */
-            while (lexer->cur < lexer->end) {
-                if (*lexer->cur == '*' && (lexer->cur + 1) < lexer->end && *(lexer->cur + 1) == '/') {
-                    lexer_advance(lexer); /* '*' */
-                    lexer_advance(lexer); /* '/' */
+    const char *p = lexer->cur;
+    const char *end = lexer->end;
+
+    while (p < end) {
+        p = scan_space_end(p, end);
+        if (p + 1 >= end || p[0] != '/') break;
+
+        if (p[1] == '/') {
+            /* line comment: the newline itself is whitespace for the next round */
+            const char *nl = memchr(p + 2, '\n', (size_t)(end - (p + 2)));
+            p = nl ? nl : end;
+        } else if (p[1] == '*') {
+            /* block comment: an unterminated one runs to the end of input */
+            const char *q = p + 2;
+            p = end;
+            while (q < end && (q = memchr(q, '*', (size_t)(end - q))) != NULL) {
+                if (q + 1 < end && q[1] == '/') {
+                    p = q + 2;
                     break;
                 }
-                lexer_advance(lexer);
+                q++;
             }
-            continue;
-        }
-
-        if (isspace((unsigned char)c)) {
-            lexer_advance(lexer);
-            continue;
+        } else {
+            break;
         }
-
-        break;
     }
+
+    lexer_advance_to(lexer, p);
 }
 
-/* Identifier or keyword (uses intern_peek to avoid insertion on keyword check) */
+/* Identifier or keyword: keywords are classified by keyword_slot, only identifiers reach a hash table */
 static void *lexer_lex_identifier(Lexer *lexer, const char *start_ptr, const char *end_ptr, TokenKind *out_type) {
     Slice slice = lexer_make_slice_from_ptrs(start_ptr, end_ptr);
 
-    /* Lookup keyword WITHOUT inserting. intern_peek must be available. */
-    InternResult *kwres = intern_peek(lexer->keywords, &slice);
-    if (kwres) {
-        *out_type = (TokenKind)(uintptr_t)kwres->entry->meta;
+    int k = keyword_slot(start_ptr, slice.len);
+    if (k >= 0) {
+        *out_type = KEYWORDS[k].type;
+        /* The record sits at dense index k unless the table was seeded some other way */
+        InternResult *kwres = interner_get_result(lexer->keywords, k);
+        if (!kwres || (TokenKind)(uintptr_t)kwres->entry->meta != KEYWORDS[k].type) {
+            kwres = intern_peek(lexer->keywords, &slice);
+        }
         return kwres;
     }
 
@@ -163,53 +425,93 @@ static void *lexer_lex_identifier(Lexer *lexer, const char *start_ptr, const cha
     return idres;
 }
 
-/* Number literal (pointer-based scan). Handles basic integer/float forms. */
-static TokenKind lexer_lex_number(Lexer *lexer, const char *start_ptr, const char **out_end_ptr) {
-    const char *p = start_ptr;
+static inline int hex_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
+    return -1;
+}
 
-    if (*p == '0') {
-        p++;
-        if (p < lexer->end && (*p == 'x' || *p == 'X')) {
-            p++;
-            while (p < lexer->end && (isxdigit((unsigned char)*p) || *p == '_')) p++;
-            *out_end_ptr = p;
-            return TOK_INT_LIT;
-        } else if (p < lexer->end && (*p == 'b' || *p == 'B')) {
-            p++;
-            while (p < lexer->end && (*p == '0' || *p == '1' || *p == '_')) p++;
+/*
+ * Number literal. Scans the literal and decodes it in the same pass, so the
+ * parser only copies the value: 0x/0b prefixes, `_` separators after the
+ * first digit, and a fraction with an optional exponent for floats. An
+ * integer with no digits after its prefix, or one past u64, comes back as
+ * TOK_BAD_INT_LIT for the parser to report.
+ */
+static TokenKind lexer_lex_number(Lexer *lexer, const char *start_ptr, const char **out_end_ptr, Token *out) {
+    const char *p = start_ptr;
+    const char *end = lexer->end;
+
+    if (*p == '0' && p + 1 < end) {
+        unsigned shift = (p[1] == 'x' || p[1] == 'X') ? 4
+                       : (p[1] == 'b' || p[1] == 'B') ? 1 : 0;
+        if (shift) {
+            uint64_t val = 0;
+            bool any_digits = false, overflow = false;
+            for (p += 2; p < end; p++) {
+                if (*p == '_') continue;
+                int d = shift == 4 ? hex_digit_value(*p) : (*p == '0' || *p == '1') ? *p - '0' : -1;
+                if (d < 0) break;
+                if (val >> (64 - shift)) overflow = true;
+                val = (val << shift) | (uint64_t)d;
+                any_digits = true;
+            }
             *out_end_ptr = p;
-            return TOK_INT_LIT;
+            out->int_value = val;
+            return (any_digits && !overflow) ? TOK_INT_LIT : TOK_BAD_INT_LIT;
         }
         // Fallthrough for decimal starting with 0
     }
 
-    while (p < lexer->end && (isdigit((unsigned char)*p) || *p == '_')) p++;
+    /* The integer part feeds both values until we know which one it is */
+    uint64_t ival = 0;
+    double fval = 0.0;
+    bool overflow = false;
+    for (; p < end; p++) {
+        if (*p == '_') continue;
+        if (!is_digit(*p)) break;
+        unsigned d = (unsigned)(*p - '0');
+        if (ival > UINT64_MAX / 10 || (ival == UINT64_MAX / 10 && d > UINT64_MAX % 10)) overflow = true;
+        ival = ival * 10 + d;
+        fval = fval * 10.0 + d;
+    }
 
-    /* fractional part */
-    if (p < lexer->end && *p == '.') {
-        const char *next = p + 1;
-        if (next < lexer->end && isdigit((unsigned char)*next)) {
-             p++; /* consume '.' */
-             while (p < lexer->end && (isdigit((unsigned char)*p) || *p == '_')) p++;
-        } else {
-             // 10. (might be a member access on an integer literal if supported, or just 10.0)
-             // If '.' is followed by non-digit, stop.
-             *out_end_ptr = p;
-             return TOK_INT_LIT;
+    /* A '.' not followed by a digit is left for the parser (member access) */
+    if (p + 1 < end && *p == '.' && is_digit(p[1])) {
+        double frac = 0.0, scale = 0.1;
+        for (p++; p < end; p++) {
+            if (*p == '_') continue;
+            if (!is_digit(*p)) break;
+            frac += (*p - '0') * scale;
+            scale *= 0.1;
         }
-        
+        fval += frac;
+
         /* exponent part */
-        if (p < lexer->end && (*p == 'e' || *p == 'E')) {
+        if (p < end && (*p == 'e' || *p == 'E')) {
             p++;
-            if (p < lexer->end && (*p == '+' || *p == '-')) p++;
-            while (p < lexer->end && (isdigit((unsigned char)*p) || *p == '_')) p++;
+            int exp_sign = 1;
+            if (p < end && (*p == '+' || *p == '-')) {
+                if (*p == '-') exp_sign = -1;
+                p++;
+            }
+            int exp_val = 0;
+            for (; p < end; p++) {
+                if (*p == '_') continue;
+                if (!is_digit(*p)) break;
+                if (exp_val < 100000) exp_val = exp_val * 10 + (*p - '0');
+            }
+            fval *= pow(10.0, exp_sign * exp_val);
         }
         *out_end_ptr = p;
+        out->float_value = fval;
         return TOK_FLOAT_LIT;
     }
 
     *out_end_ptr = p;
-    return TOK_INT_LIT;
+    out->int_value = ival;
+    return overflow ? TOK_BAD_INT_LIT : TOK_INT_LIT;
 }
 
 /* String literal (handles escapes). Returns end pointer after closing quote. */
@@ -284,8 +586,7 @@ static TokenKind lexer_lex_char(const char **curptr, const char *endptr, uint32_
    pointing into arena. The arena allocation size is conservatively raw.len (since unescaped <= raw.len)
    plus one for NUL. */
 static Slice unescape_string_into_arena(const Slice raw, Arena *arena) {
-    if (raw.len == 0) return (Slice){ .ptr = NULL, .len = 0 };
-    char *out = arena_alloc(arena, raw.len + 1);
+    char *out = arena_alloc(arena, raw.len + 1); /* "" still gets its terminator */
     if (!out) return (Slice){ .ptr = NULL, .len = 0 };
     char *w = out;
     const char *r = raw.ptr;
@@ -318,7 +619,7 @@ static Slice unescape_string_into_arena(const Slice raw, Arena *arena) {
 
 /* Create and initialize a new Lexer */
 void lexer_populate_default_keywords(DenseArenaInterner *keywords) {
-    for (size_t i = 0; KEYWORDS[i].word; i++) {
+    for (size_t i = 0; i < KW_COUNT; i++) {
         Slice slice = {
             .ptr = (char*)KEYWORDS[i].word,
             .len = strlen(KEYWORDS[i].word)
@@ -339,10 +640,11 @@ Lexer* lexer_create(const char *source, size_t source_len, Arena *arena) {
     /* Pre-intern keywords with TokenKind as metadata */
     lexer_populate_default_keywords(keywords);
 
-    return lexer_create_ex(source, source_len, arena, keywords, identifiers, strings);
+    SourceId file = source_register(NULL, source, source_len);
+    return lexer_create_ex(source, source_len, file, arena, keywords, identifiers, strings);
 }
 
-Lexer* lexer_create_ex(const char *source, size_t source_len, Arena *arena,
+Lexer* lexer_create_ex(const char *source, size_t source_len, SourceId file, Arena *arena,
                       DenseArenaInterner *keywords,
                       DenseArenaInterner *identifiers,
                       DenseArenaInterner *strings) {
@@ -354,8 +656,7 @@ Lexer* lexer_create_ex(const char *source, size_t source_len, Arena *arena,
     lexer->source = source;
     lexer->source_len = source_len;
     lexer->pos = 0;
-    lexer->line = 1;
-    lexer->col = 1;
+    lexer->file = file;
     lexer->arena = arena;
 
     /* pointer-based scanning state */
@@ -374,6 +675,13 @@ Lexer* lexer_create_ex(const char *source, size_t source_len, Arena *arena,
     return lexer;
 }
 
+void lexer_seek(Lexer *lexer, size_t pos) {
+    if (!lexer) return;
+    if (pos > lexer->source_len) pos = lexer->source_len;
+    lexer->pos = pos;
+    lexer->cur = lexer->source + pos;
+}
+
 /* Destroy lexer */
 void lexer_destroy(Lexer *lexer) {
     if (!lexer) return;
@@ -395,81 +703,58 @@ Token lexer_next_token(Lexer *lexer) {
     lexer_skip_whitespace(lexer);
 
     if (lexer_at_end(lexer)) {
-        return (Token){
-            .type = TOK_EOF,
-            .slice = {.ptr = (char*)lexer->cur, .len = 0},
-            .span = {lexer->line, lexer->col, lexer->line, lexer->col},
-            .record = NULL
-        };
+        return (Token){ .type = TOK_EOF, .len = 0, .offset = (uint32_t)lexer->pos, .record = NULL };
     }
 
     const char *start_ptr = lexer->cur;
-    size_t start_line = lexer->line;
-    size_t start_col = lexer->col;
+    uint32_t start_pos = (uint32_t)lexer->pos;
 
     char c = lexer_advance(lexer);
 
     TokenKind token_type = TOK_UNKNOWN;
-    void *rec = NULL;
-    Slice slice = { NULL, 0 };
+    Token tok = { .offset = start_pos, .record = NULL };
 
     if (is_alpha(c)) {
-        /* identifier or keyword: consume rest using pointer p */
-        const char *p = lexer->cur;
-        while (p < lexer->end && (is_alpha(*p) || is_digit(*p))) p++;
-        /* update lexer->cur/pos/line/col to p by advancing remaining chars quickly */
-        while (lexer->cur < p) lexer_advance(lexer);
+        /* identifier or keyword */
+        lexer_advance_to(lexer, scan_ident_end(lexer->cur, lexer->end));
 
-        slice = lexer_make_slice_from_ptrs(start_ptr, lexer->cur);
 
-        rec = lexer_lex_identifier(lexer, start_ptr, lexer->cur, &token_type);
+        tok.record = lexer_lex_identifier(lexer, start_ptr, lexer->cur, &token_type);
 
     } else if (is_digit(c)) {
         /* number — use pointer-based scan */
         const char *endptr = NULL;
-        token_type = lexer_lex_number(lexer, start_ptr, &endptr);
-        /* advance lexer->cur to endptr */
-        while (lexer->cur < endptr) lexer_advance(lexer);
-        slice = lexer_make_slice_from_ptrs(start_ptr, lexer->cur);
+        token_type = lexer_lex_number(lexer, start_ptr, &endptr, &tok);
+        lexer_advance_to(lexer, endptr);
 
     } else if (c == '"') {
         /* lex string using a helper that advances a local pointer, then sync */
         const char *tmpcur = lexer->cur - 1; /* points to opening quote */
         token_type = lexer_lex_string(&tmpcur, lexer->end);
-        /* advance lexer->cur to tmpcur */
-        while (lexer->cur < tmpcur) lexer_advance(lexer);
-        /* raw slice includes quotes; create content slice without quotes for unescaping */
+        lexer_advance_to(lexer, tmpcur);
+        /* the lexeme includes the quotes; unescape the content between them */
         const char *raw_start = start_ptr + 1; /* after opening quote */
         const char *raw_end = lexer->cur - 1;   /* before closing quote */
-        slice = lexer_make_slice_from_ptrs(start_ptr, lexer->cur);
 
         if (token_type == TOK_STRING_LIT) {
             Slice raw_content = lexer_make_slice_from_ptrs(raw_start, raw_end);
             Slice unescaped = unescape_string_into_arena(raw_content, lexer->arena);
             if (unescaped.ptr && unescaped.len > 0) {
                 /* Intern the unescaped string into the dedicated strings interner */
-                InternResult *ires = intern(lexer->strings, &unescaped, NULL);
-                rec = ires;
+                tok.record = intern(lexer->strings, &unescaped, NULL);
             } else if (unescaped.ptr) {
                 /* empty string: still intern an empty slice */
-                InternResult *ires = intern(lexer->strings, &unescaped, NULL);
-                rec = ires;
-            } else {
-                /* allocation failed or other error: leave rec NULL */
-                rec = NULL;
+                tok.record = intern(lexer->strings, &unescaped, NULL);
             }
+            /* allocation failed or other error: record stays NULL */
         }
 
     } else if (c == '\'') {
         const char *tmpcur = lexer->cur - 1;
         uint32_t cp = 0;
         token_type = lexer_lex_char(&tmpcur, lexer->end, &cp);
-        while (lexer->cur < tmpcur) lexer_advance(lexer);
-        slice = lexer_make_slice_from_ptrs(start_ptr, lexer->cur);
-        if (token_type == TOK_CHAR_LIT) {
-            /* store codepoint in record as integer-cast pointer */
-            rec = (void*)(uintptr_t)cp;
-        }
+        lexer_advance_to(lexer, tmpcur);
+        if (token_type == TOK_CHAR_LIT) tok.int_value = cp;
 
     } else {
         /* Operators & punctuation. read next char once where needed */
@@ -536,11 +821,18 @@ Token lexer_next_token(Lexer *lexer) {
             default:  token_type = TOK_UNKNOWN; break;
         }
 
-        slice = lexer_make_slice_from_ptrs(start_ptr, lexer->cur);
     }
 
-    Span span = { start_line, start_col, lexer->line, lexer->col };
-    return (Token){ .type = token_type, .slice = slice, .span = span, .record = rec };
+    size_t len = lexer->pos - start_pos;
+    if (len > TOKEN_MAX_LEN) {
+        /* Does not fit the packed length; the parser reports it */
+        token_type = TOK_UNKNOWN;
+        len = TOKEN_MAX_LEN;
+        tok.record = NULL;
+    }
+    tok.type = token_type;
+    tok.len = (uint32_t)len;
+    return tok;
 }
 
 /* Add token to lexer's token array (direct push; no extra intern lookups) */
@@ -549,6 +841,16 @@ static bool lexer_add_token(Lexer *lexer, const Token *tok) {
     return dynarray_push_value(lexer->tokens, tok) == 0;
 }
 
+/* Fill `out` with up to `max` tokens, stopping after EOF */
+size_t lexer_next_tokens(Lexer *lexer, Token *out, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+        out[n] = lexer_next_token(lexer);
+        if (out[n++].type == TOK_EOF) break;
+    }
+    return n;
+}
+
 /* Lex all tokens into the lexer's token array */
 bool lexer_lex_all(Lexer *lexer) {
     if (!lexer) return false;
@@ -563,6 +865,12 @@ bool lexer_lex_all(Lexer *lexer) {
         if (token.type == TOK_EOF) break;
     }
 
+    if (g_mem_report_enabled) {
+        // The array doubled from INITIAL_TOKEN_CAPACITY; outgrown buffers stay in the arena
+        size_t bytes = 0;
+        for (size_t cap = INITIAL_TOKEN_CAPACITY; cap <= lexer->tokens->capacity; cap *= 2) bytes += cap * sizeof(Token);
+        mem_account(MEM_TOKENS, MEM_KIND_NONE, lexer->file, bytes, lexer->tokens->count);
+    }
     return true;
 }
 
@@ -610,6 +918,7 @@ const char* token_type_to_string(TokenKind type) {
         case TOK_IDENTIFIER: return "IDENTIFIER";
         case TOK_INT_LIT: return "INT_LIT";
         case TOK_FLOAT_LIT: return "FLOAT_LIT";
+        case TOK_BAD_INT_LIT: return "BAD_INT_LIT";
         case TOK_STRING_LIT: return "STRING_LIT";
         case TOK_CHAR_LIT: return "CHAR_LIT";
         case TOK_EQ_EQ: return "EQUALSEQUALS";
@@ -650,6 +959,10 @@ const char* token_type_to_string(TokenKind type) {
         case TOK_AS: return "AS";
         case TOK_VOID: return "VOID";
         case TOK_DEFER: return "DEFER";
+        case TOK_SWITCH: return "SWITCH";
+        case TOK_CASE: return "CASE";
+        case TOK_ASYNC: return "ASYNC";
+        case TOK_AWAIT: return "AWAIT";
         case TOK_NULL: return "NULL";
         default: return "UNKNOWN";
     }
@@ -659,8 +972,6 @@ void lexer_reset(Lexer *lexer) {
     if (!lexer) return;
 
     lexer->pos = 0;
-    lexer->line = 1;
-    lexer->col = 1;
 
     /* reset pointer-based scanning state */
     lexer->cur = lexer->source;
@@ -677,22 +988,22 @@ void lexer_reset(Lexer *lexer) {
 
 
 /* Pretty token printing (table-like) */
-void print_token(const Token *tok) {
+void print_token(const Lexer *lexer, const Token *tok) {
     const char *type_str = token_type_to_string(tok->type);
-    printf("│ %3zu:%-3zu │ %-13s │ ",
-           tok->span.start_line,
-           tok->span.start_col,
+    SourcePos pos = source_pos(lexer->file, tok->offset);
+    printf("│ %3u:%-3u │ %-13s │ ",
+           pos.line,
+           pos.col,
            type_str);
-    if (tok->slice.ptr && tok->slice.len > 0) {
-        printf("'%.*s'", (int)tok->slice.len, tok->slice.ptr);
+    if (tok->len > 0) {
+        printf("'%.*s'", (int)tok->len, lexer->source + tok->offset);
     } else {
         printf("(no-lexeme)");
     }
 
-    /* If token.record holds a codepoint for char literal, print it */
-    if (tok->type == TOK_CHAR_LIT && tok->record) {
-        uint32_t cp = (uint32_t)(uintptr_t)tok->record;
-        printf("  (char: U+%04X)", cp);
+    /* Literals carry their decoded value */
+    if (tok->type == TOK_CHAR_LIT && tok->int_value) {
+        printf("  (char: U+%04X)", (uint32_t)tok->int_value);
     }
 
     printf("\n");
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "core/file.h"
 #include "lexing/lexer.h"
@@ -29,6 +30,12 @@
 #include "codegen/codegen.h"
 #include "core/module_loader.h"
 #include "core/exit_codes.h"
+#include "core/linker.h"
+#include "core/server.h"
+#include "core/trace.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
+#include "core/snapshot.h"
 
 /**
  * DEFINE: COMPILER_INIT_ARENA_SIZE
@@ -39,15 +46,43 @@
  */
 #define COMPILER_INIT_ARENA_SIZE (8 * 1024 * 1024)
 
+/*
+ * DEFINE: COMPILER_BACKEND_ARENA_SIZE
+ *
+ * Initial size of the arena for object paths and link inputs, which stays
+ * when the front end's arena is released after code generation.
+ */
+#define COMPILER_BACKEND_ARENA_SIZE (64 * 1024)
+
+/*
+ * DEFINE: COMPILER_FAST_EXIT
+ *
+ * One-shot compiles leave the process without tearing down arenas, the
+ * codegen context or LLVM's static state: the kernel reclaims all of it at
+ * once. Sanitizer builds tear down so leak checks still see every lifetime.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+    #define COMPILER_FAST_EXIT 0
+#elif defined(__has_feature)
+    #if __has_feature(address_sanitizer)
+        #define COMPILER_FAST_EXIT 0
+    #endif
+#endif
+#ifndef COMPILER_FAST_EXIT
+    #define COMPILER_FAST_EXIT 1
+#endif
+
 /**
  * struct CompilerState - Complete tracking state for a compilation transaction.
  * @opts: User-supplied command-line driver configuration options.
  * @arena: Pointer to the central arena allocator managing AST and symbol lifetimes.
+ * @backend_arena: Object paths and link inputs, which outlive @arena in one-shot compiles.
  * @keywords: Unique string pool interner containing keyword identifiers.
  * @identifiers: Unique string pool interner for user-defined symbols.
  * @strings: Unique string pool interner for string literals.
  * @loader: Coordinates file loading, parsing, and resolving the module dependency graph.
  * @store: Serves as the type registry and interner cache for type definitions.
+ * @resident_library: The loader holds the --serve daemon's preloaded library.
  * @t_start: Timestamp indicating when the compilation process was initiated.
  *
  * Encapsulates the configuration, allocator tables, and symbol pools required to
@@ -56,11 +91,13 @@
 typedef struct {
     Options *opts;
     Arena *arena;
+    Arena *backend_arena;
     DenseArenaInterner *keywords;
     DenseArenaInterner *identifiers;
     DenseArenaInterner *strings;
     ModuleLoader *loader;
     TypeStore *store;
+    bool resident_library;
     double t_start;
 } CompilerState;
 
@@ -70,8 +107,11 @@ typedef struct {
  * @opts: Parsed options to assign to this compiler session. Must not be NULL.
  *
  * Initializes the central memory arena, constructs keyword, identifier, and string
- * pools, registers default lexer keywords, and creates the module loader subsystem.
- * 
+ * pools, registers default lexer keywords, creates the TypeStore with its
+ * primitives and universe scope, and creates the module loader subsystem.
+ * With --cache-dir everything before the loader is mapped from the startup
+ * snapshot instead of being rebuilt (core/snapshot.h).
+ *
  * Return: EXIT_OK on success, or EXIT_IO on allocation failures.
  */
 static int compiler_init(CompilerState *state, Options *opts) {
@@ -83,35 +123,27 @@ static int compiler_init(CompilerState *state, Options *opts) {
     state->opts = opts;
     state->t_start = now_seconds();
     
-    /* Allocate primary linear allocator arena */
-    state->arena = arena_create(COMPILER_INIT_ARENA_SIZE);
+    /* Central arena with the interners, keywords and TypeStore (core/snapshot.h) */
+    ArenaBacking backing = opts->huge_pages == 2 ? ARENA_HUGETLB
+                         : opts->huge_pages == 1 ? ARENA_HUGE_PAGES : ARENA_MALLOC;
+    StartupState startup;
+    bool mapped = false;
+    state->arena = startup_state_open(opts->cache_dir, COMPILER_INIT_ARENA_SIZE, backing, &startup, &mapped);
     if (!state->arena) {
-        fprintf(stderr, "Error: Failed to allocate central compiler arena (size = %d)\n", COMPILER_INIT_ARENA_SIZE);
+        fprintf(stderr, "Error: Failed to allocate central compiler arena and string interner tables (size = %d)\n", COMPILER_INIT_ARENA_SIZE);
         return EXIT_IO;
     }
-
-    /* Allocate underlying hash map buffers for interning tables */
-    HashMap *kw_map = hashmap_create(state->arena, 32);
-    HashMap *id_map = hashmap_create(state->arena, 256);
-    HashMap *str_map = hashmap_create(state->arena, 128);
-
-    if (!kw_map || !id_map || !str_map) {
-        fprintf(stderr, "Error: Failed to construct hashmap buffers for string interning tables\n");
-        return EXIT_IO;
+    if (opts->verbose) {
+        printf("Startup state %s\n", mapped ? "mapped from snapshot" : "built");
     }
-
-    /* Initialize interner tables inside the arena */
-    state->keywords = intern_table_create(kw_map, state->arena, string_copy_func, slice_hash, slice_cmp);
-    state->identifiers = intern_table_create(id_map, state->arena, string_copy_func, slice_hash, slice_cmp);
-    state->strings = intern_table_create(str_map, state->arena, string_copy_func, slice_hash, slice_cmp);
-
-    if (!state->keywords || !state->identifiers || !state->strings) {
-        fprintf(stderr, "Error: Failed to initialize string interner tables\n");
+    state->backend_arena = arena_create(COMPILER_BACKEND_ARENA_SIZE);
+    if (!state->backend_arena) {
+        fprintf(stderr, "Error: Failed to allocate backend arena\n");
         return EXIT_IO;
     }
-
-    /* Pre-populate keyword table with built-in language words */
-    lexer_populate_default_keywords(state->keywords);
+    state->keywords = startup.keywords;
+    state->identifiers = startup.identifiers;
+    state->strings = startup.strings;
 
     /* Construct module loader subsystem */
     state->loader = module_loader_create(state->arena, opts, state->keywords, state->identifiers, state->strings);
@@ -120,7 +152,8 @@ static int compiler_init(CompilerState *state, Options *opts) {
         return EXIT_IO;
     }
 
-    state->store = NULL;
+    state->store = startup.store;
+    state->resident_library = false;
     return EXIT_OK;
 }
 
@@ -130,7 +163,9 @@ static int compiler_init(CompilerState *state, Options *opts) {
  * @path: Absolute or relative system path to the root module/file.
  *
  * Dispatches parsing of the entry path, resolving internal imports and compiling
- * dependency targets recursively.
+ * dependency targets recursively. With -j N the files are parsed on a worker
+ * pool; the unit order stays the same as the serial walk. Resident library
+ * units only stay in the program when it imports them.
  *
  * Return: EXIT_OK on success, or an exit code representation of parser failure.
  */
@@ -139,15 +174,20 @@ static int compiler_load_modules(CompilerState *state, const char *path) {
         fprintf(stderr, "Error: Invalid state or loader in compiler_load_modules\n");
         return EXIT_IO;
     }
-    return load_module_recursive(state->loader, path, NULL, NULL, 0);
+    int res = module_loader_load(state->loader, path);
+    if (res == EXIT_OK && state->resident_library) {
+        module_loader_retain_reachable(state->loader, path);
+    }
+    return res;
 }
 
 /**
  * compiler_run_sema() - Orchestrates the semantic type verification pass.
  * @state: Active compiler state transaction. Must not be NULL.
  *
- * Creates the type system store, establishes a global TypeCheckContext pointing
- * to the primary entry compilation unit, and recursively checks types. Generates
+ * Uses the TypeStore from compiler_init (created here if there is none), establishes a global
+ * TypeCheckContext pointing to the primary entry compilation unit, and recursively
+ * checks the units that have not been checked yet. Generates
  * descriptive diagnostic errors to stderr if any violations are found.
  *
  * Return: EXIT_OK on success, EXIT_TYPE if type check fails, or EXIT_IO on OOM.
@@ -169,14 +209,16 @@ static int compiler_run_sema(CompilerState *state) {
     }
 
     /* Allocate and initialize the central TypeStore */
-    state->store = typestore_create(state->arena, state->identifiers, state->keywords);
+    if (!state->store) {
+        state->store = typestore_create(state->arena, state->identifiers, state->keywords);
+    }
     if (!state->store) {
         fprintf(stderr, "Error: Failed to initialize TypeStore (Out of Memory).\n");
         return EXIT_IO;
     }
     
     /* Locate the root compilation unit (always at position 0 in ordered units) */
-    CompilationUnit *first_unit = *(CompilationUnit**)dynarray_get(state->loader->units_ordered, 0);
+    CompilationUnit *first_unit = DYNARRAY_AT(CompilationUnit*, state->loader->units_ordered, 0);
     if (!first_unit) {
         fprintf(stderr, "Error: Primary compilation unit is NULL.\n");
         return EXIT_IO;
@@ -184,7 +226,7 @@ static int compiler_run_sema(CompilerState *state) {
 
     /* Construct verification context */
     TypeCheckContext type_ctx = typecheck_context_create(
-        state->arena, state->store, state->identifiers, state->keywords, first_unit->absolute_path, state->loader
+        state->arena, state->store, state->identifiers, state->keywords, first_unit->file, state->loader
     );
 
     /* Perform the semantic validation pass */
@@ -225,7 +267,7 @@ static void compiler_dump_info(CompilerState *state) {
     if (state->opts->print_ast) {
         printf("--- AST ---\n");
         for (size_t i = 0; i < unit_count; i++) {
-            CompilationUnit *u = *(CompilationUnit**)dynarray_get(state->loader->units_ordered, i);
+            CompilationUnit *u = DYNARRAY_AT(CompilationUnit*, state->loader->units_ordered, i);
             if (u) {
                 printf("Module: %s\n", u->absolute_path ? u->absolute_path : "<unknown>");
                 print_ast(u->ast_root, 0, state->keywords, state->identifiers, state->strings);
@@ -235,22 +277,104 @@ static void compiler_dump_info(CompilerState *state) {
 
     /* Dump the global type store registers mapping to the main module */
     if (state->opts->print_types && state->store) {
-        CompilationUnit *main_unit = *(CompilationUnit**)dynarray_get(state->loader->units_ordered, unit_count - 1);
+        CompilationUnit *main_unit = DYNARRAY_AT(CompilationUnit*, state->loader->units_ordered, unit_count - 1);
         if (main_unit) {
             type_print_store_dump(state->store, main_unit->global_scope);
         }
     }
 }
 
+/* Writes each object image to its path; false (after reporting it) on failure. */
+static bool compiler_write_objects(const CodegenObject *objects, size_t count, char **paths) {
+    for (size_t i = 0; i < count; i++) {
+        FILE *f = fopen(paths[i], "wb");
+        bool ok = f && fwrite(objects[i].data, 1, objects[i].size, f) == objects[i].size;
+        if (f && fclose(f) != 0) ok = false;
+        if (!ok) {
+            fprintf(stderr, "Error: Could not write object file '%s'\n", paths[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * compiler_link_in_process() - Links the program without spawning a linker.
+ * @state: Active compiler state transaction. Must not be NULL.
+ * @objects: The program's object images, emitted in memory.
+ * @count: Number of @objects.
+ * @prebuilt: Paths of prebuilt library objects to link in.
+ * @obj_paths: Where to write the objects if the system linker has to take over.
+ *
+ * Hands the program's objects (which carry the print runtime), together with
+ * the prebuilt objects, to the in-process linker. When the inputs fall
+ * outside what that linker supports, the objects are written to @obj_paths
+ * instead so the caller can fall back to 'cc'.
+ *
+ * Return: LINK_OK when the executable was written, LINK_UNSUPPORTED when the
+ * caller must link @obj_paths itself, or LINK_FAILED on errors.
+ */
+static LinkStatus compiler_link_in_process(CompilerState *state, const CodegenObject *objects, size_t count,
+                                           DynArray *prebuilt, char **obj_paths) {
+    size_t input_count = 0;
+    LinkInput *inputs = arena_alloc(state->backend_arena, (prebuilt->count + count) * sizeof(LinkInput));
+    for (size_t i = 0; i < count; i++) {
+        inputs[input_count++] = (LinkInput){ objects[i].data, objects[i].size, obj_paths[i] };
+    }
+    for (size_t i = 0; i < prebuilt->count; i++) {
+        const char *path = DYNARRAY_AT(char*, prebuilt, i);
+        size_t len = 0;
+        char *data = read_file_into_arena(state->backend_arena, path, &len);
+        if (!data) return LINK_FAILED;
+        inputs[input_count++] = (LinkInput){ data, len, path };
+    }
+
+    char err[256] = "";
+    trace_begin("link", "in-process link");
+    LinkStatus status = link_executable_in_process(inputs, input_count, state->opts->output_name, err, sizeof(err));
+    trace_end();
+    if (status == LINK_FAILED) {
+        fprintf(stderr, "Error: In-process link failed: %s\n", err);
+    } else if (status == LINK_UNSUPPORTED) {
+        if (state->opts->verbose) {
+            printf("In-process link unavailable (%s), using the system linker\n", err);
+        }
+        if (!compiler_write_objects(objects, count, obj_paths)) status = LINK_FAILED;
+    }
+    return status;
+}
+
+/**
+ * compiler_release_front_end() - Frees the ASTs, scopes and types of a one-shot compile.
+ * @state: Active compiler state transaction. Must not be NULL.
+ *
+ * Called once the program module is generated: from there on the backend
+ * only needs the module and what it allocated in @state->backend_arena.
+ * The resident library of --serve and --batch lives in the same arena and
+ * stays.
+ */
+static void compiler_release_front_end(CompilerState *state) {
+    if (state->resident_library || !state->arena) return;
+    trace_begin("phase", "release front end");
+    arena_destroy(state->arena);
+    trace_end();
+    state->arena = NULL;
+    state->keywords = state->identifiers = state->strings = NULL;
+    state->loader = NULL;
+    state->store = NULL;
+}
+
 /**
- * compiler_run_backend() - Generates LLVM IR, object outputs, links, and runs execution.
+ * compiler_run_backend() - Generates LLVM IR, object outputs, links, or runs on the JIT.
  * @state: Active compiler state transaction. Must not be NULL.
  *
  * Coordinates creation of LLVM context, optimization, generation of machine object files,
- * platform-specific linking (via 'cc' / 'clang'), and optional test run behavior. Ensures
- * resource cleanup on error paths, specifically for raw heap buffers like linker outputs.
+ * and platform-specific linking (via 'cc' / 'clang'). With --run the program is instead
+ * executed on the lazy JIT and no object or executable is produced. Ensures resource
+ * cleanup on error paths, specifically for raw heap buffers like linker outputs.
  *
- * Return: EXIT_OK on success, EXIT_TYPE on codegen errors, or EXIT_IO on IO/Link failure.
+ * Return: EXIT_OK on success, EXIT_TYPE on codegen errors, EXIT_IO on IO/Link failure,
+ * or the program's own result with --run.
  */
 static int compiler_run_backend(CompilerState *state) {
     if (!state || !state->opts) {
@@ -269,6 +393,48 @@ static int compiler_run_backend(CompilerState *state) {
         return EXIT_TYPE;
     }
     
+    /* --run: start main on the lazy JIT; nothing is written to disk */
+    if (state->opts->run_executable) {
+        if (state->opts->print_ir && codegen_program(cg_ctx) == 0) {
+            codegen_dump_module(cg_ctx);
+        }
+        int level = state->opts->jit_opt_level >= 0 ? state->opts->jit_opt_level : state->opts->opt_level;
+        fflush(stdout);
+        trace_begin("jit", "run");
+        int result = codegen_run_lazy_jit(cg_ctx, level);
+        trace_end();
+        fflush(stdout);
+        codegen_context_destroy(cg_ctx);
+        return result;
+    }
+
+    /*
+     * With a cache directory the non-generic code of std modules, and the
+     * instances of their templates, is linked in from cached objects, and
+     * with --incremental so are the program's unchanged function bodies.
+     * Skipped for --ir so the dump stays self-contained, and when profiling
+     * so that every function is instrumented or gets its weights.
+     */
+    DynArray prebuilt_objects;
+    dynarray_init_in_arena(&prebuilt_objects, state->backend_arena, sizeof(char*), 8);
+    bool profiling = state->opts->profile_generate || state->opts->profile_use || state->opts->instrument;
+    if (state->opts->cache_dir && !state->opts->print_ir && !profiling) {
+        int prebuilt = codegen_use_prebuilt_libraries(cg_ctx, state->opts->cache_dir, state->backend_arena, &prebuilt_objects);
+        if (state->opts->verbose && prebuilt > 0) {
+            printf("Using %d prebuilt library object(s)\n", prebuilt);
+        }
+        int instances = codegen_use_cached_instances(cg_ctx, state->opts->cache_dir, state->backend_arena, &prebuilt_objects);
+        if (state->opts->verbose && instances > 0) {
+            printf("Using %d cached generic instance(s)\n", instances);
+        }
+        if (state->opts->incremental) {
+            int bodies = codegen_use_cached_bodies(cg_ctx, state->backend_arena, &prebuilt_objects);
+            if (state->opts->verbose && bodies > 0) {
+                printf("Using %d cached function bod%s\n", bodies, bodies == 1 ? "y" : "ies");
+            }
+        }
+    }
+
     /* Translate AST node semantics into LLVM intermediate representation */
     if (codegen_program(cg_ctx) != 0) {
         fprintf(stderr, "Error: LLVM Code generation pass failed\n");
@@ -281,6 +447,9 @@ static int compiler_run_backend(CompilerState *state) {
         codegen_dump_module(cg_ctx);
     }
 
+    /* The module is complete: the ASTs and types are not needed any more */
+    compiler_release_front_end(state);
+
     /* Determine target platform object file format suffix */
     const char *obj_ext = 
 #ifdef _WIN32
@@ -295,73 +464,320 @@ static int compiler_run_backend(CompilerState *state) {
         return EXIT_IO;
     }
 
-    /* Allocate buffer for object output file path */
-    size_t obj_path_len = strlen(state->opts->output_name) + strlen(obj_ext) + 1;
-    char *obj_path = arena_alloc(state->arena, obj_path_len);
-    if (!obj_path) {
-        fprintf(stderr, "Error: Out of memory during object path allocation.\n");
-        codegen_context_destroy(cg_ctx);
-        return EXIT_IO;
+    /*
+     * --codegen-units: the optimized module is generated as several objects
+     * in parallel. The first is written to <output>.o, unit i to <output>.<i>.o.
+     * Instrumented modules stay whole for the profile runtime's sections.
+     */
+    CodegenObject *objects = NULL;
+    size_t object_count = 0;
+    if (state->opts->codegen_units > 1 && !state->opts->profile_generate) {
+        objects = arena_alloc(state->backend_arena, (size_t)state->opts->codegen_units * sizeof(CodegenObject));
+        object_count = codegen_emit_object_units(cg_ctx, (size_t)state->opts->codegen_units, objects);
+        if (object_count == SIZE_MAX) {
+            codegen_context_destroy(cg_ctx);
+            return EXIT_IO;
+        }
     }
 
-    snprintf(obj_path, obj_path_len, "%s%s", state->opts->output_name, obj_ext);
-    
-    /* Write machine instruction object file to disk */
-    codegen_emit_object(cg_ctx, obj_path);
-    
-    if (state->opts->verbose) {
-        printf("Linking...\n");
+    /* Allocate buffers for object output file paths */
+    size_t obj_count = object_count ? object_count : 1;
+    char **obj_paths = arena_alloc(state->backend_arena, obj_count * sizeof(char*));
+    size_t obj_path_len = strlen(state->opts->output_name) + strlen(obj_ext) + 24;
+    for (size_t i = 0; i < obj_count; i++) {
+        obj_paths[i] = arena_alloc(state->backend_arena, obj_path_len);
+        if (i == 0) {
+            snprintf(obj_paths[i], obj_path_len, "%s%s", state->opts->output_name, obj_ext);
+        } else {
+            snprintf(obj_paths[i], obj_path_len, "%s.%zu%s", state->opts->output_name, i, obj_ext);
+        }
     }
 
-    /* Locate the compiler's support runtime library */
-    char *runtime_path = get_runtime_path();
-    const char *linker = 
-#ifdef _WIN32
-        "clang";
-#else
-        "cc";
-#endif
+    /*
+     * Link straight from memory when asked; otherwise write the objects for 'cc'.
+     * The profile writer needs the __start_/__stop_ section symbols of a system linker.
+     * Either way every object exists before the link, so the module goes first.
+     */
+    bool link_in_memory = state->opts->link_in_process && !state->opts->profile_generate;
+    bool written = true;
+    CodegenObject whole = {0};
+    if (object_count == 0 && link_in_memory) {
+        whole.data = codegen_emit_object_buffer(cg_ctx, &whole.size);
+        written = whole.data != NULL;
+        objects = &whole;
+        object_count = written ? 1 : 0;
+    } else if (object_count == 0) {
+        codegen_emit_object(cg_ctx, obj_paths[0]);
+    } else if (!link_in_memory) {
+        written = compiler_write_objects(objects, object_count, obj_paths);
+    }
+    codegen_release_module(cg_ctx);
 
-    /* Formulate linking arguments array (clang/cc <obj> <runtime> -o <output>) */
-    char *link_args[] = { (char*)linker, obj_path, runtime_path, "-o", (char*)state->opts->output_name, NULL };
-    int link_res = run_command(linker, link_args);
-    
-    /* runtime_path is allocated outside of arena, must free manually */
-    free(runtime_path);
+    if (state->opts->verbose) {
+        printf("Linking...\n");
+    }
 
-    if (link_res != 0) {
-        fprintf(stderr, "Error: Linker execution failed (code: %d)\n", link_res);
+    LinkStatus in_process = LINK_UNSUPPORTED;
+    if (written && link_in_memory) {
+        in_process = compiler_link_in_process(state, objects, object_count, &prebuilt_objects, obj_paths);
+        written = in_process != LINK_FAILED;
+    }
+    for (size_t i = 0; i < object_count; i++) free(objects[i].data);
+    if (!written) {
         codegen_context_destroy(cg_ctx);
         return EXIT_IO;
     }
 
-    if (state->opts->verbose) {
-        printf("Successfully compiled to '%s' executable.\n", state->opts->output_name);
-    }
-
-    /* Optionally execute compiled target directly */
-    if (state->opts->run_executable) {
-        char *run_cmd = NULL;
+    if (in_process != LINK_OK) {
+        const char *linker = 
 #ifdef _WIN32
-        run_cmd = (char*)state->opts->output_name;
+            "clang";
 #else
-        size_t len = strlen(state->opts->output_name) + 3;
-        run_cmd = arena_alloc(state->arena, len);
-        if (!run_cmd) {
-            fprintf(stderr, "Error: Out of memory preparing run path.\n");
+            "cc";
+#endif
+
+        /* Formulate linking arguments array (clang/cc <objs...> <prebuilt...> [-lm] -o <output>) */
+        size_t argc = 0;
+        char **link_args = arena_alloc(state->backend_arena, (obj_count + prebuilt_objects.count + 6) * sizeof(char*));
+        link_args[argc++] = (char*)linker;
+        for (size_t i = 0; i < obj_count; i++) link_args[argc++] = obj_paths[i];
+        for (size_t i = 0; i < prebuilt_objects.count; i++) {
+            link_args[argc++] = DYNARRAY_AT(char*, &prebuilt_objects, i);
+        }
+#ifndef _WIN32
+        /* std.libc binds libm; prebuilt objects keep every wrapper referenced */
+        link_args[argc++] = "-lm";
+#endif
+        link_args[argc++] = "-o";
+        link_args[argc++] = (char*)state->opts->output_name;
+        link_args[argc] = NULL;
+        trace_begin("link", linker);
+        int link_res = run_command(linker, link_args);
+        trace_end();
+
+        if (link_res != 0) {
+            fprintf(stderr, "Error: Linker execution failed (code: %d)\n", link_res);
             codegen_context_destroy(cg_ctx);
             return EXIT_IO;
         }
-        snprintf(run_cmd, len, "./%s", state->opts->output_name);
-#endif
-        char *run_args[] = { run_cmd, NULL };
-        run_command(run_cmd, run_args);
+    }
+
+    if (state->opts->verbose) {
+        printf("Successfully compiled to '%s' executable.\n", state->opts->output_name);
     }
 
     codegen_context_destroy(cg_ctx);
     return EXIT_OK;
 }
 
+/**
+ * compiler_run_stages() - Runs the full pipeline for the program at @path.
+ * @state: Initialized compiler state. Must not be NULL.
+ * @path: Entry module of the program.
+ *
+ * Loads, checks, optionally dumps, and lowers/links (or runs) the program,
+ * then prints the -T metrics.
+ *
+ * Return: EXIT_OK, a stage's exit code, or the program's result with --run.
+ */
+static int compiler_run_stages(CompilerState *state, const char *path) {
+    /* Recursive module loading & syntax parsing */
+    trace_begin("phase", "load");
+    int exit_code = compiler_load_modules(state, path);
+    trace_end();
+    if (exit_code != EXIT_OK) {
+        return exit_code;
+    }
+
+    double t_load = now_seconds() - state->t_start;
+
+    /* Semantic type verification */
+    double t_sema_start = now_seconds();
+    trace_begin("phase", "sema");
+    exit_code = compiler_run_sema(state);
+    trace_end();
+    double t_sema = now_seconds() - t_sema_start;
+
+    /* AST & Type system structure dumps */
+    compiler_dump_info(state);
+
+    if (exit_code != EXIT_OK) {
+        return exit_code;
+    }
+
+    /* Codegen and link steps */
+    double t_cg_start = now_seconds();
+    trace_begin("phase", "backend");
+    exit_code = compiler_run_backend(state);
+    trace_end();
+    double t_cg = now_seconds() - t_cg_start;
+
+    /* Report performance metrics if explicitly configured */
+    if (state->opts->print_time) {
+        printf("\n--- Metrics ---\n");
+        printf("Time Parse/Load: %.3fms\n", t_load * 1000);
+        printf("Time Sema:       %.3fms\n", t_sema * 1000);
+        printf("Time Codegen:    %.3fms\n", t_cg * 1000);
+        printf("Peak RSS:        %zu KB\n", get_peak_rss_kb());
+    }
+    return exit_code;
+}
+
+/**
+ * compiler_compile() - Compiles the program at @path, tracing it on request.
+ * @state: Initialized compiler state. Must not be NULL.
+ * @path: Entry module of the program.
+ *
+ * With --trace the spans recorded by every stage are written to the trace
+ * file once the pipeline is done, whether or not it succeeded; --stats
+ * and --mem-report print their counters the same way.
+ *
+ * Return: The pipeline's exit code, or EXIT_IO if only the trace failed.
+ */
+static int compiler_compile(CompilerState *state, const char *path) {
+    const char *trace_path = state->opts->trace_path;
+    if (trace_path) trace_start();
+    if (state->opts->print_stats) stats_reset();
+    if (state->opts->mem_report) mem_report_start();
+
+    int exit_code = compiler_run_stages(state, path);
+
+    if (state->opts->print_stats) {
+        if (stats_enabled()) print_stats_report();
+        else fprintf(stderr, "Warning: --stats needs a compiler built with NEWT_STATS (make dev, or make STATS=1)\n");
+    }
+    if (state->opts->mem_report) {
+        mem_report_stop();
+        print_mem_report();
+    }
+
+    if (trace_path && !trace_write_json(trace_path)) {
+        fprintf(stderr, "Error: Could not write trace file '%s'\n", trace_path);
+        if (exit_code == EXIT_OK) exit_code = EXIT_IO;
+    }
+    return exit_code;
+}
+
+/**
+ * compiler_serve_request() - Compiles one --connect request or --batch entry.
+ * @argc: Argument count of the request's command line.
+ * @argv: The request's command line, without --connect.
+ * @arg: The daemon's CompilerState, holding the resident library.
+ *
+ * Runs in a child forked for the request, inside the client's directory and
+ * with its standard streams; the warm state is a private copy, so the
+ * request may extend it freely. The library stays the daemon's.
+ *
+ * Return: The exit code the same command would have had locally.
+ */
+static int compiler_serve_request(int argc, char **argv, void *arg) {
+    CompilerState *state = arg;
+    Options opts;
+    const char *path = NULL;
+
+    if (!parse_options(argc, argv, &opts, &path)) {
+        return EXIT_USAGE;
+    }
+    if (opts.serve_socket || opts.connect_socket || opts.batch_manifest) {
+        fprintf(stderr, "Error: --serve, --connect and --batch cannot be sent to a compile server\n");
+        return EXIT_USAGE;
+    }
+    if (!codegen_check_target(opts.target_cpu, opts.target_features)) {
+        return EXIT_USAGE;
+    }
+
+    opts.stdlib_path = state->opts->stdlib_path;
+    state->opts = &opts;
+    state->loader->opts = &opts;
+    state->t_start = now_seconds();
+    return compiler_compile(state, path);
+}
+
+/**
+ * compiler_warm_library() - Loads and checks the resident library.
+ * @state: Freshly initialized compiler state. Must not be NULL.
+ *
+ * Parses and checks every library module once, the state --serve and
+ * --batch fork their requests from.
+ *
+ * Return: EXIT_OK, or the exit code of the load or the check.
+ */
+static int compiler_warm_library(CompilerState *state) {
+    int exit_code = module_loader_preload_library(state->loader);
+    if (exit_code == EXIT_OK) {
+        exit_code = compiler_run_sema(state);
+    }
+    if (exit_code != EXIT_OK) {
+        fprintf(stderr, "Error: Could not prepare the resident library\n");
+        return exit_code;
+    }
+
+    /* Requests come from other directories: resolve library imports absolutely */
+    state->opts->stdlib_path = state->loader->stdlib_root;
+    state->resident_library = true;
+    return EXIT_OK;
+}
+
+/**
+ * compiler_serve() - Runs the --serve compile daemon.
+ * @state: Freshly initialized compiler state. Must not be NULL.
+ *
+ * Warms the library, then answers requests on the socket until
+ * SIGINT/SIGTERM. LLVM targets are already initialized by main(), so
+ * requests only build what their own program needs.
+ *
+ * Return: EXIT_OK after a clean shutdown, or the warm-up's exit code.
+ */
+static int compiler_serve(CompilerState *state) {
+    int exit_code = compiler_warm_library(state);
+    if (exit_code != EXIT_OK) return exit_code;
+
+    if (!state->opts->quiet) {
+        printf("Serving on %s (%zu library modules resident)\n",
+               state->opts->serve_socket, state->loader->units_ordered->count);
+        fflush(stdout);
+    }
+    return server_run(state->opts->serve_socket, compiler_serve_request, state);
+}
+
+/**
+ * compiler_batch() - Compiles every entry of a --batch manifest.
+ * @state: Freshly initialized compiler state. Must not be NULL.
+ * @prog: Name the entries' command lines are parsed under.
+ *
+ * Warms the library like the daemon does, then forks one child per
+ * manifest line, -j of them at a time. Entries share the library's parsed
+ * units and checked signatures but nothing of each other's.
+ *
+ * Return: EXIT_OK if every entry compiled, else the first failure's code.
+ */
+static int compiler_batch(CompilerState *state, const char *prog) {
+    BatchManifest manifest;
+    if (!batch_manifest_read(state->opts->batch_manifest, prog, &manifest)) return EXIT_IO;
+
+    int exit_code = compiler_warm_library(state);
+    if (exit_code != EXIT_OK) {
+        batch_manifest_free(&manifest);
+        return exit_code;
+    }
+    bool quiet = state->opts->quiet;
+    exit_code = server_batch(&manifest, state->opts->jobs, compiler_serve_request, state);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < manifest.count; i++) {
+        BatchEntry *entry = &manifest.entries[i];
+        if (entry->code == EXIT_OK) continue;
+        failed++;
+        fprintf(stderr, "Error: %s:%d: '%s' failed with exit code %d\n",
+                state->opts->batch_manifest, entry->line, entry->argv[1], entry->code);
+    }
+    if (!quiet) {
+        printf("Batch: %zu of %zu entries compiled\n", manifest.count - failed, manifest.count);
+    }
+    batch_manifest_free(&manifest);
+    return exit_code;
+}
+
 /**
  * main() - Compiler CLI Application Entry Point.
  * @argc: Command line argument count.
@@ -369,8 +785,9 @@ static int compiler_run_backend(CompilerState *state) {
  *
  * Performs static initialization of the codegen target architecture registry,
  * parses CLI options, sets up compilation contexts, walks compilation stages,
- * and prints execution diagnostics. Releases all allocated resources through the
- * central arena interface before returning.
+ * and prints execution diagnostics. The daemon and --batch release all allocated
+ * resources through the arenas before returning; a one-shot compile exits
+ * without the teardown (COMPILER_FAST_EXIT).
  *
  * Return: Exit code (EXIT_OK, EXIT_USAGE, EXIT_IO, or EXIT_TYPE).
  */
@@ -386,6 +803,16 @@ int main(int argc, char **argv) {
         return EXIT_USAGE;
     }
 
+    /* Hand the whole command line to a --serve daemon */
+    if (opts.connect_socket) {
+        return server_request(opts.connect_socket, argc, argv);
+    }
+
+    /* An unknown CPU or feature name would otherwise only warn, or abort inside LLVM */
+    if (!codegen_check_target(opts.target_cpu, opts.target_features)) {
+        return EXIT_USAGE;
+    }
+
     CompilerState state;
     
     /* Set up string tables, loaders, and allocations */
@@ -394,44 +821,21 @@ int main(int argc, char **argv) {
         return exit_code;
     }
 
-    /* Recursive module loading & syntax parsing */
-    exit_code = compiler_load_modules(&state, path);
-    if (exit_code != EXIT_OK) {
-        goto cleanup;
-    }
-
-    double t_load = now_seconds() - state.t_start;
-
-    /* Semantic type verification */
-    double t_sema_start = now_seconds();
-    exit_code = compiler_run_sema(&state);
-    double t_sema = now_seconds() - t_sema_start;
-
-    /* AST & Type system structure dumps */
-    compiler_dump_info(&state);
-
-    if (exit_code != EXIT_OK) {
-        goto cleanup;
-    }
-
-    /* Codegen and link steps */
-    double t_cg_start = now_seconds();
-    exit_code = compiler_run_backend(&state);
-    double t_cg = now_seconds() - t_cg_start;
+    /* One compile, the daemon loop with --serve, or a --batch manifest */
+    exit_code = opts.serve_socket   ? compiler_serve(&state)
+              : opts.batch_manifest ? compiler_batch(&state, argv[0])
+                                    : compiler_compile(&state, path);
 
-    /* Report performance metrics if explicitly configured */
-    if (opts.print_time) {
-        printf("\n--- Metrics ---\n");
-        printf("Time Parse/Load: %.3fms\n", t_load * 1000);
-        printf("Time Sema:       %.3fms\n", t_sema * 1000);
-        printf("Time Codegen:    %.3fms\n", t_cg * 1000);
-        printf("Peak RSS:        %zu KB\n", get_peak_rss_kb());
+    /* A one-shot compile is done: skip the teardown */
+    if (COMPILER_FAST_EXIT && !opts.serve_socket && !opts.batch_manifest) {
+        fflush(NULL);
+        _Exit(exit_code);
     }
 
-cleanup:
     /* Safely release all system memory allocated during session */
     if (state.arena) {
         arena_destroy(state.arena);
     }
+    arena_destroy(state.backend_arena);
     return exit_code;
 }
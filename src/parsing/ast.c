@@ -1,6 +1,10 @@
 #include "ast.h"
 #include "type_print.h"
 #include "core/error.h"
+#include "core/source_map.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
+#include "parse_declarations.h"
 #include <stdio.h>
 
 /* Helper functions to convert enums to strings */
@@ -18,6 +22,8 @@ static const char *node_type_to_string(AstNodeType type) {
         [AST_IF_STATEMENT] = "IfStatement",
         [AST_WHILE_STATEMENT] = "WhileStatement",
         [AST_FOR_STATEMENT] = "ForStatement",
+        [AST_SWITCH_STATEMENT] = "SwitchStatement",
+        [AST_SWITCH_CASE] = "SwitchCase",
         [AST_RETURN_STATEMENT] = "ReturnStatement",
         [AST_BREAK_STATEMENT] = "BreakStatement",
         [AST_CONTINUE_STATEMENT] = "ContinueStatement",
@@ -52,6 +58,7 @@ static const char *type_kind_to_string(AstTypeKind kind) {
         case AST_TYPE_ARRAY: return "ArrayType";
         case AST_TYPE_FUNC: return "FunctionType";
         case AST_TYPE_APPLICATION: return "TypeApplication";
+        case AST_TYPE_VECTOR: return "VectorType";
         default: return "UnknownType";
     }
 }
@@ -117,20 +124,85 @@ static void print_escaped_char(char c) {
     printf("'");
 }
 
-AstNode *ast_create_node(AstNodeType type, Arena *arena, const char *filename) {
+#define PAYLOAD(member) sizeof(((AstNode *)0)->data.member)
+
+/* insert_cast turns any node into an AST_CAST and member access on arrays
+ * and enums folds into an AST_LITERAL, both in place, so every allocation
+ * keeps room for those two payloads. */
+#define MIN_PAYLOAD (PAYLOAD(cast_expr) > PAYLOAD(literal) ? PAYLOAD(cast_expr) : PAYLOAD(literal))
+
+size_t ast_node_size(AstNodeType type) {
+    static const size_t payload_sizes[] = {
+        [AST_PROGRAM] = PAYLOAD(program),
+        [AST_VARIABLE_DECLARATION] = PAYLOAD(variable_declaration),
+        [AST_FUNCTION_DECLARATION] = PAYLOAD(function_declaration),
+        [AST_PARAM] = PAYLOAD(param),
+        [AST_STRUCT_DECLARATION] = PAYLOAD(struct_declaration),
+        [AST_ENUM_DECLARATION] = PAYLOAD(enum_declaration),
+        [AST_IMPL_DECLARATION] = PAYLOAD(impl_declaration),
+        [AST_IMPORT_DECLARATION] = PAYLOAD(import_declaration),
+        [AST_ALIAS_DECLARATION] = PAYLOAD(alias_declaration),
+        [AST_INTRINSIC] = PAYLOAD(intrinsic),
+        [AST_BLOCK] = PAYLOAD(block),
+        [AST_IF_STATEMENT] = PAYLOAD(if_statement),
+        [AST_WHILE_STATEMENT] = PAYLOAD(while_statement),
+        [AST_FOR_STATEMENT] = PAYLOAD(for_statement),
+        [AST_SWITCH_STATEMENT] = PAYLOAD(switch_statement),
+        [AST_SWITCH_CASE] = PAYLOAD(switch_case),
+        [AST_RETURN_STATEMENT] = PAYLOAD(return_statement),
+        [AST_BREAK_STATEMENT] = PAYLOAD(break_statement),
+        [AST_CONTINUE_STATEMENT] = PAYLOAD(continue_statement),
+        [AST_DEFER_STATEMENT] = PAYLOAD(defer_statement),
+        [AST_EXPR_STATEMENT] = PAYLOAD(expr_statement),
+        [AST_LITERAL] = PAYLOAD(literal),
+        [AST_IDENTIFIER] = PAYLOAD(identifier),
+        [AST_BINARY_EXPR] = PAYLOAD(binary_expr),
+        [AST_UNARY_EXPR] = PAYLOAD(unary_expr),
+        [AST_POSTFIX_EXPR] = PAYLOAD(postfix_expr),
+        [AST_ASSIGNMENT_EXPR] = PAYLOAD(assignment_expr),
+        [AST_CALL_EXPR] = PAYLOAD(call_expr),
+        [AST_GENERIC_INST_EXPR] = PAYLOAD(generic_inst_expr),
+        [AST_SUBSCRIPT_EXPR] = PAYLOAD(subscript_expr),
+        [AST_MEMBER_EXPR] = PAYLOAD(member_expr),
+        [AST_STRUCT_LITERAL] = PAYLOAD(struct_literal),
+        [AST_CAST] = PAYLOAD(cast_expr),
+        [AST_TYPE] = PAYLOAD(ast_type),
+        [AST_INITIALIZER_LIST] = PAYLOAD(initializer_list),
+    };
+
+    size_t payload = sizeof(((AstNode *)0)->data);
+    if ((size_t)type < sizeof(payload_sizes) / sizeof(payload_sizes[0])) {
+        payload = payload_sizes[type];
+    }
+    if (payload < MIN_PAYLOAD) payload = MIN_PAYLOAD;
+
+    /* Round up so the next node in the arena stays pointer-aligned. */
+    size_t size = offsetof(AstNode, data) + payload;
+    return (size + _Alignof(AstNode) - 1) & ~(size_t)(_Alignof(AstNode) - 1);
+}
+
+#undef MIN_PAYLOAD
+#undef PAYLOAD
+
+AstNode *ast_create_node(AstNodeType type, Arena *arena, SourceId file) {
     if (!arena) return NULL;
 
-    AstNode *node = (AstNode*)arena_calloc(arena, sizeof(AstNode));
+    AstNode *node = (AstNode*)arena_calloc(arena, ast_node_size(type));
     if (!node) return NULL;
+    MEM_ACCOUNT(MEM_AST, type, file, ast_node_size(type), 1);
 
     node->node_type = type;
-    node->filename = filename;
+    node->span.file = file;
     node->flags = AST_FLAG_NONE;
-    /* arena_calloc zeroed the rest (span fields = 0, union memory = 0,
+    /* arena_calloc zeroed the rest (span offsets = 0, payload = 0,
        is_const_expr = 0, const_value = zero). */
     return node;
 }
 
+const char *ast_node_type_name(AstNodeType type) {
+    return node_type_to_string(type);
+}
+
 /* Return 1 if node is a syntactic lvalue (can appear on left side of =),
  * 0 otherwise.
  */
@@ -216,6 +288,14 @@ static void print_tree_prefix(int depth, int is_last) {
     print_tree_prefix_tracked(depth, is_last);
 }
 
+/* Inline " [line:col-line:col]", resolved from the span's byte offsets */
+static void print_span(Span span) {
+    if (span.file == SOURCE_NONE) return;
+    SourcePos start = span_start_pos(span);
+    SourcePos end = span_end_pos(span);
+    printf(" [%u:%u-%u:%u]", start.line, start.col, end.line, end.col);
+}
+
 /* Print a string representation of an operator */
 static const char *op_to_string(OpKind op) {
 
@@ -261,11 +341,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
     print_tree_prefix(depth, is_last);
     printf("%s", node_type_to_string(node->node_type));
     // Add span info inline
-    if (node->span.start_line > 0) {
-        printf(" [%zu:%zu-%zu:%zu]", 
-               node->span.start_line, node->span.start_col, 
-               node->span.end_line, node->span.end_col);
-    }
+    print_span(node->span);
     // Add type info if available
     if (node->type) {
         printf(" \033[36m<");
@@ -308,7 +384,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
         case AST_PROGRAM:
             if (node->data.program.decls && node->data.program.decls->count > 0) {
                 for (size_t i = 0; i < node->data.program.decls->count; ++i) {
-                    AstNode *decl = *(AstNode**)dynarray_get(node->data.program.decls, i);
+                    AstNode *decl = DYNARRAY_AT(AstNode*, node->data.program.decls, i);
                     print_ast_with_prefix(decl, depth + 1, i == node->data.program.decls->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -319,7 +395,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
             printf("module: ");
             if (node->data.import_declaration.module_path && node->data.import_declaration.module_path->count > 0) {
                 for (size_t i = 0; i < node->data.import_declaration.module_path->count; ++i) {
-                    InternResult *part = *(InternResult**)dynarray_get(node->data.import_declaration.module_path, i);
+                    InternResult *part = DYNARRAY_AT(InternResult*, node->data.import_declaration.module_path, i);
                     if (identifiers) {
                         const char *name = interner_get_cstr(identifiers, part->entry->dense_index);
                         printf("%s", name ? name : "?");
@@ -347,7 +423,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, 1);
                 printf("symbols:\n");
                 for (size_t i = 0; i < node->data.import_declaration.specific_symbols->count; ++i) {
-                    ImportSymbol *sym = *(ImportSymbol**)dynarray_get(node->data.import_declaration.specific_symbols, i);
+                    ImportSymbol *sym = DYNARRAY_AT(ImportSymbol*, node->data.import_declaration.specific_symbols, i);
                     print_tree_prefix(depth + 2, i == node->data.import_declaration.specific_symbols->count - 1);
                     if (sym->original_name && identifiers) {
                         const char *orig = interner_get_cstr(identifiers, sym->original_name->entry->dense_index);
@@ -365,15 +441,15 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
         case AST_INTRINSIC:
             print_tree_prefix(depth + 1, 0);
             printf("intrinsic: ");
-            if (node->data.intrinsic.kind == INTRINSIC_ALLOC) printf("@alloc\n");
-            else if (node->data.intrinsic.kind == INTRINSIC_FREE) printf("@free\n");
+            if (intrinsic_name(node->data.intrinsic.kind)) printf("@%s\n", intrinsic_name(node->data.intrinsic.kind));
+            else if (node->data.intrinsic.kind == INTRINSIC_AWAIT) printf("await\n");
             else printf("unknown\n");
             
             if (node->data.intrinsic.args && node->data.intrinsic.args->count > 0) {
                 print_tree_prefix(depth + 1, 1);
                 printf("arguments:\n");
                 for (size_t i = 0; i < node->data.intrinsic.args->count; ++i) {
-                    AstNode *arg = *(AstNode**)dynarray_get(node->data.intrinsic.args, i);
+                    AstNode *arg = DYNARRAY_AT(AstNode*, node->data.intrinsic.args, i);
                     print_ast_with_prefix(arg, depth + 2, i == node->data.intrinsic.args->count - 1, keywords, identifiers, strings);
                 }
             } else {
@@ -429,7 +505,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, 1);
                 printf("methods:\n");
                 for (size_t i = 0; i < node->data.impl_declaration.methods->count; ++i) {
-                    AstNode *method = *(AstNode**)dynarray_get(node->data.impl_declaration.methods, i);
+                    AstNode *method = DYNARRAY_AT(AstNode*, node->data.impl_declaration.methods, i);
                     print_ast_with_prefix(method, depth + 2, i == node->data.impl_declaration.methods->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -521,7 +597,14 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
             }
             printf("\n");
             
-            int has_body = node->data.function_declaration.body != NULL;
+            /* A skimmed body is parsed into scratch memory just for printing */
+            ArenaScratch scratch = {0};
+            AstNode *body = node->data.function_declaration.body;
+            if (!body && node->data.function_declaration.lazy_body) {
+                scratch = arena_scratch_begin();
+                body = parse_deferred_body(node, scratch.arena, NULL, NULL);
+            }
+            int has_body = body != NULL;
             int has_params = node->data.function_declaration.params && node->data.function_declaration.params->count > 0;
             
             // Print return type
@@ -536,7 +619,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, !has_body);
                 printf("parameters:\n");
                 for (size_t i = 0; i < node->data.function_declaration.params->count; ++i) {
-                    AstNode *param = *(AstNode**)dynarray_get(node->data.function_declaration.params, i);
+                    AstNode *param = DYNARRAY_AT(AstNode*, node->data.function_declaration.params, i);
                     print_ast_with_prefix(param, depth + 2, i == node->data.function_declaration.params->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -545,8 +628,9 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
             if (has_body) {
                 print_tree_prefix(depth + 1, 1);
                 printf("body:\n");
-                print_ast_with_prefix(node->data.function_declaration.body, depth + 2, 1, keywords, identifiers, strings);
+                print_ast_with_prefix(body, depth + 2, 1, keywords, identifiers, strings);
             }
+            if (scratch.arena) arena_scratch_end(scratch);
             break;
         }
 
@@ -572,7 +656,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
         case AST_BLOCK:
             if (node->data.block.statements && node->data.block.statements->count > 0) {
                 for (size_t i = 0; i < node->data.block.statements->count; ++i) {
-                    AstNode *stmt = *(AstNode**)dynarray_get(node->data.block.statements, i);
+                    AstNode *stmt = DYNARRAY_AT(AstNode*, node->data.block.statements, i);
                     print_ast_with_prefix(stmt, depth + 1, i == node->data.block.statements->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -614,11 +698,43 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
             }
             break;
 
+        case AST_SWITCH_STATEMENT: {
+            DynArray *cases = node->data.switch_statement.cases;
+            size_t n = cases ? cases->count : 0;
+            int has_else = node->data.switch_statement.else_body != NULL;
+            print_tree_prefix(depth + 1, n == 0 && !has_else);
+            printf("subject:\n");
+            print_ast_with_prefix(node->data.switch_statement.subject, depth + 2, 1, keywords, identifiers, strings);
+            for (size_t i = 0; i < n; ++i) {
+                print_ast_with_prefix(DYNARRAY_AT(AstNode*, cases, i), depth + 1, i == n - 1 && !has_else, keywords, identifiers, strings);
+            }
+            if (has_else) {
+                print_tree_prefix(depth + 1, 1);
+                printf("else:\n");
+                print_ast_with_prefix(node->data.switch_statement.else_body, depth + 2, 1, keywords, identifiers, strings);
+            }
+            break;
+        }
+
+        case AST_SWITCH_CASE: {
+            DynArray *values = node->data.switch_case.values;
+            print_tree_prefix(depth + 1, 0);
+            printf("values:\n");
+            for (size_t i = 0; values && i < values->count; ++i) {
+                print_ast_with_prefix(DYNARRAY_AT(AstNode*, values, i), depth + 2, i == values->count - 1, keywords, identifiers, strings);
+            }
+            print_tree_prefix(depth + 1, 1);
+            printf("body:\n");
+            print_ast_with_prefix(node->data.switch_case.body, depth + 2, 1, keywords, identifiers, strings);
+            break;
+        }
+
         case AST_FOR_STATEMENT: {
             int parts = 0;
             if (node->data.for_statement.init) parts++;
             if (node->data.for_statement.condition) parts++;
             if (node->data.for_statement.post) parts++;
+            if (node->data.for_statement.range) parts++;
             if (node->data.for_statement.body) parts++;
             
             int current = 0;
@@ -641,6 +757,12 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 printf("post:\n");
                 print_ast_with_prefix(node->data.for_statement.post, depth + 2, current == parts, keywords, identifiers, strings);
             }
+            if (node->data.for_statement.range) {
+                current++;
+                print_tree_prefix(depth + 1, current == parts);
+                printf("range:\n");
+                print_ast_with_prefix(node->data.for_statement.range, depth + 2, current == parts, keywords, identifiers, strings);
+            }
             if (node->data.for_statement.body) {
                 current++;
                 print_tree_prefix(depth + 1, 1);
@@ -786,7 +908,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, 1);
                 printf("arguments:\n");
                 for (size_t i = 0; i < node->data.call_expr.args->count; ++i) {
-                    AstNode *arg = *(AstNode**)dynarray_get(node->data.call_expr.args, i);
+                    AstNode *arg = DYNARRAY_AT(AstNode*, node->data.call_expr.args, i);
                     print_ast_with_prefix(arg, depth + 2, i == node->data.call_expr.args->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -803,7 +925,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, 1);
                 printf("type arguments:\n");
                 for (size_t i = 0; i < node->data.generic_inst_expr.type_args->count; ++i) {
-                    AstNode *arg = *(AstNode**)dynarray_get(node->data.generic_inst_expr.type_args, i);
+                    AstNode *arg = DYNARRAY_AT(AstNode*, node->data.generic_inst_expr.type_args, i);
                     print_ast_with_prefix(arg, depth + 2, i == node->data.generic_inst_expr.type_args->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -852,11 +974,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
         case AST_TYPE: {
             print_tree_prefix(depth + 1, 0);
             printf("kind: %s", type_kind_to_string(node->data.ast_type.kind));
-            if (node->data.ast_type.span.start_line > 0) {
-                printf(" [%zu:%zu-%zu:%zu]", 
-                       node->data.ast_type.span.start_line, node->data.ast_type.span.start_col,
-                       node->data.ast_type.span.end_line, node->data.ast_type.span.end_col);
-            }
+            print_span(node->data.ast_type.span);
             printf("\n");
             
             switch (node->data.ast_type.kind) {
@@ -902,6 +1020,15 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                         printf("size: (unspecified)\n");
                     }
                     break;
+
+                case AST_TYPE_VECTOR:
+                    print_tree_prefix(depth + 1, 0);
+                    printf("element_type:\n");
+                    print_ast_with_prefix(node->data.ast_type.u.array.elem, depth + 2, 0, keywords, identifiers, strings);
+                    print_tree_prefix(depth + 1, 1);
+                    printf("lanes:\n");
+                    print_ast_with_prefix(node->data.ast_type.u.array.size_expr, depth + 2, 1, keywords, identifiers, strings);
+                    break;
                     
                 case AST_TYPE_FUNC: {
                     int has_return = node->data.ast_type.u.func.return_type != NULL;
@@ -911,7 +1038,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                         print_tree_prefix(depth + 1, !has_return);
                         printf("parameters:\n");
                         for (size_t i = 0; i < node->data.ast_type.u.func.param_types->count; ++i) {
-                            AstNode *param_type = *(AstNode**)dynarray_get(node->data.ast_type.u.func.param_types, i);
+                            AstNode *param_type = DYNARRAY_AT(AstNode*, node->data.ast_type.u.func.param_types, i);
                             print_ast_with_prefix(param_type, depth + 2, i == node->data.ast_type.u.func.param_types->count - 1, keywords, identifiers, strings);
                         }
                     }
@@ -933,7 +1060,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                         print_tree_prefix(depth + 1, 1);
                         printf("type_args:\n");
                         for (size_t i = 0; i < node->data.ast_type.u.application.args->count; ++i) {
-                            AstNode *arg = *(AstNode**)dynarray_get(node->data.ast_type.u.application.args, i);
+                            AstNode *arg = DYNARRAY_AT(AstNode*, node->data.ast_type.u.application.args, i);
                             print_ast_with_prefix(arg, depth + 2, i == node->data.ast_type.u.application.args->count - 1, keywords, identifiers, strings);
                         }
                     }
@@ -948,7 +1075,7 @@ void print_ast_with_prefix(AstNode *node, int depth, int is_last, DenseArenaInte
                 print_tree_prefix(depth + 1, 1);
                 printf("elements:\n");
                 for (size_t i = 0; i < node->data.initializer_list.elements->count; ++i) {
-                    AstNode *elem = *(AstNode**)dynarray_get(node->data.initializer_list.elements, i);
+                    AstNode *elem = DYNARRAY_AT(AstNode*, node->data.initializer_list.elements, i);
                     print_ast_with_prefix(elem, depth + 2, i == node->data.initializer_list.elements->count - 1, keywords, identifiers, strings);
                 }
             }
@@ -970,8 +1097,9 @@ static DynArray *clone_dynarray_of_nodes(DynArray *src, Arena *arena) {
     DynArray *dst = arena_alloc(arena, sizeof(DynArray));
     if (!dst) return NULL;
     dynarray_init_in_arena(dst, arena, sizeof(AstNode*), src->count);
-    for (size_t i = 0; i < src->count; i++) {
-        AstNode *child = *(AstNode**)dynarray_get(src, i);
+    MEM_ACCOUNT(MEM_MONO, MEM_KIND_NONE, SOURCE_NONE, sizeof(DynArray) + dst->capacity * sizeof(AstNode*), 1);
+    DYNARRAY_FOREACH(AstNode*, child_it, src) {
+        AstNode *child = *child_it;
         AstNode *cloned_child = ast_clone_node(child, arena);
         dynarray_push_value(dst, &cloned_child);
     }
@@ -983,8 +1111,8 @@ static DynArray *clone_dynarray_of_results(DynArray *src, Arena *arena) {
     DynArray *dst = arena_alloc(arena, sizeof(DynArray));
     if (!dst) return NULL;
     dynarray_init_in_arena(dst, arena, sizeof(InternResult*), src->count);
-    for (size_t i = 0; i < src->count; i++) {
-        InternResult *res = *(InternResult**)dynarray_get(src, i);
+    DYNARRAY_FOREACH(InternResult*, res_it, src) {
+        InternResult *res = *res_it;
         dynarray_push_value(dst, &res);
     }
     return dst;
@@ -1028,8 +1156,8 @@ static DynArray *clone_import_symbols(DynArray *src, Arena *arena) {
     DynArray *dst = arena_alloc(arena, sizeof(DynArray));
     if (!dst) return NULL;
     dynarray_init_in_arena(dst, arena, sizeof(ImportSymbol*), src->count);
-    for (size_t i = 0; i < src->count; i++) {
-        ImportSymbol *sym = *(ImportSymbol**)dynarray_get(src, i);
+    DYNARRAY_FOREACH(ImportSymbol*, sym_it, src) {
+        ImportSymbol *sym = *sym_it;
         if (!sym) continue;
         ImportSymbol *cloned_sym = arena_alloc(arena, sizeof(ImportSymbol));
         if (cloned_sym) {
@@ -1045,8 +1173,8 @@ static DynArray* clone_variants(DynArray *src, Arena *arena) {
     if (!src) return NULL;
     DynArray *dst = arena_alloc(arena, sizeof(DynArray));
     dynarray_init_in_arena(dst, arena, sizeof(AstEnumVariant*), src->count);
-    for (size_t i = 0; i < src->count; i++) {
-        AstEnumVariant *variant = *(AstEnumVariant**)dynarray_get(src, i);
+    DYNARRAY_FOREACH(AstEnumVariant*, variant_it, src) {
+        AstEnumVariant *variant = *variant_it;
         if (!variant) continue;
         AstEnumVariant *cloned_variant = arena_alloc(arena, sizeof(AstEnumVariant));
         if (cloned_variant) {
@@ -1061,11 +1189,14 @@ static DynArray* clone_variants(DynArray *src, Arena *arena) {
 AstNode *ast_clone_node(AstNode *node, Arena *arena) {
     if (!node) return NULL;
 
-    AstNode *clone = arena_alloc(arena, sizeof(AstNode));
+    size_t size = ast_node_size(node->node_type);
+    AstNode *clone = arena_alloc(arena, size);
     if (!clone) return NULL;
+    STAT_INC(AST_NODES_CLONED);
+    MEM_ACCOUNT(MEM_MONO, node->node_type, node->span.file, size, 1);
 
     // Shallow copy all standard fields
-    memcpy(clone, node, sizeof(AstNode));
+    memcpy(clone, node, size);
 
     // Deep copy union data depending on node_type
     switch (node->node_type) {
@@ -1076,14 +1207,19 @@ AstNode *ast_clone_node(AstNode *node, Arena *arena) {
         case AST_VARIABLE_DECLARATION:
             clone->data.variable_declaration.type = ast_clone_node(node->data.variable_declaration.type, arena);
             clone->data.variable_declaration.initializer = ast_clone_node(node->data.variable_declaration.initializer, arena);
+            clone->data.variable_declaration.mangled_name = NULL;
             break;
 
         case AST_FUNCTION_DECLARATION:
             clone->data.function_declaration.return_type = ast_clone_node(node->data.function_declaration.return_type, arena);
             clone->data.function_declaration.type_params = clone_dynarray_of_results(node->data.function_declaration.type_params, arena);
+            clone->data.function_declaration.const_params = clone_dynarray_of_nodes(node->data.function_declaration.const_params, arena);
             clone->data.function_declaration.target_type_node = ast_clone_node(node->data.function_declaration.target_type_node, arena);
             clone->data.function_declaration.params = clone_dynarray_of_nodes(node->data.function_declaration.params, arena);
             clone->data.function_declaration.body = ast_clone_node(node->data.function_declaration.body, arena);
+            clone->data.function_declaration.mangled_name = NULL; // Instances get their own
+            clone->data.function_declaration.body_patch = NULL;
+            clone->data.function_declaration.memory = FN_MEMORY_ANY;
             break;
 
         case AST_PARAM:
@@ -1092,6 +1228,7 @@ AstNode *ast_clone_node(AstNode *node, Arena *arena) {
 
         case AST_STRUCT_DECLARATION:
             clone->data.struct_declaration.type_params = clone_dynarray_of_results(node->data.struct_declaration.type_params, arena);
+            clone->data.struct_declaration.const_params = clone_dynarray_of_nodes(node->data.struct_declaration.const_params, arena);
             clone->data.struct_declaration.fields = clone_fields(node->data.struct_declaration.fields, arena);
             clone->data.struct_declaration.methods = clone_dynarray_of_nodes(node->data.struct_declaration.methods, arena);
             break;
@@ -1142,10 +1279,22 @@ AstNode *ast_clone_node(AstNode *node, Arena *arena) {
             clone->data.while_statement.body = ast_clone_node(node->data.while_statement.body, arena);
             break;
 
+        case AST_SWITCH_STATEMENT:
+            clone->data.switch_statement.subject = ast_clone_node(node->data.switch_statement.subject, arena);
+            clone->data.switch_statement.cases = clone_dynarray_of_nodes(node->data.switch_statement.cases, arena);
+            clone->data.switch_statement.else_body = ast_clone_node(node->data.switch_statement.else_body, arena);
+            break;
+
+        case AST_SWITCH_CASE:
+            clone->data.switch_case.values = clone_dynarray_of_nodes(node->data.switch_case.values, arena);
+            clone->data.switch_case.body = ast_clone_node(node->data.switch_case.body, arena);
+            break;
+
         case AST_FOR_STATEMENT:
             clone->data.for_statement.init = ast_clone_node(node->data.for_statement.init, arena);
             clone->data.for_statement.condition = ast_clone_node(node->data.for_statement.condition, arena);
             clone->data.for_statement.post = ast_clone_node(node->data.for_statement.post, arena);
+            clone->data.for_statement.range = ast_clone_node(node->data.for_statement.range, arena);
             clone->data.for_statement.body = ast_clone_node(node->data.for_statement.body, arena);
             break;
 
@@ -1231,6 +1380,7 @@ AstNode *ast_clone_node(AstNode *node, Arena *arena) {
                     clone_ty->u.ptr.target = ast_clone_node(ast_ty->u.ptr.target, arena);
                     break;
                 case AST_TYPE_ARRAY:
+                case AST_TYPE_VECTOR:
                     clone_ty->u.array.elem = ast_clone_node(ast_ty->u.array.elem, arena);
                     clone_ty->u.array.size_expr = ast_clone_node(ast_ty->u.array.size_expr, arena);
                     break;
@@ -1253,3 +1403,201 @@ AstNode *ast_clone_node(AstNode *node, Arena *arena) {
 
     return clone;
 }
+
+static void visit_name_list(DynArray *nodes, AstNameVisitor visit, void *user) {
+    if (!nodes) return;
+    DYNARRAY_FOREACH(AstNode*, node_it, nodes) ast_visit_names(*node_it, visit, user);
+}
+
+void ast_visit_names(AstNode *node, AstNameVisitor visit, void *user) {
+    if (!node) return;
+    switch (node->node_type) {
+        case AST_PROGRAM:
+            visit_name_list(node->data.program.decls, visit, user);
+            break;
+
+        case AST_VARIABLE_DECLARATION:
+            ast_visit_names(node->data.variable_declaration.type, visit, user);
+            ast_visit_names(node->data.variable_declaration.initializer, visit, user);
+            break;
+
+        case AST_FUNCTION_DECLARATION:
+            ast_visit_names(node->data.function_declaration.target_type_node, visit, user);
+            visit_name_list(node->data.function_declaration.params, visit, user);
+            ast_visit_names(node->data.function_declaration.return_type, visit, user);
+            ast_visit_names(node->data.function_declaration.body, visit, user);
+            break;
+
+        case AST_PARAM:
+            ast_visit_names(node->data.param.type, visit, user);
+            break;
+
+        case AST_STRUCT_DECLARATION:
+            if (node->data.struct_declaration.fields) {
+                DYNARRAY_FOREACH(AstFieldDecl, field, node->data.struct_declaration.fields) {
+                    ast_visit_names(field->type, visit, user);
+                }
+            }
+            break;
+
+        case AST_ENUM_DECLARATION:
+            if (node->data.enum_declaration.variants) {
+                DYNARRAY_FOREACH(AstEnumVariant, variant, node->data.enum_declaration.variants) {
+                    ast_visit_names(variant->value, visit, user);
+                }
+            }
+            break;
+
+        case AST_IMPL_DECLARATION:
+            ast_visit_names(node->data.impl_declaration.target_type_node, visit, user);
+            visit_name_list(node->data.impl_declaration.methods, visit, user);
+            break;
+
+        case AST_ALIAS_DECLARATION:
+            ast_visit_names(node->data.alias_declaration.target, visit, user);
+            break;
+
+        case AST_INTRINSIC:
+            visit_name_list(node->data.intrinsic.args, visit, user);
+            break;
+
+        case AST_BLOCK:
+            visit_name_list(node->data.block.statements, visit, user);
+            break;
+
+        case AST_IF_STATEMENT:
+            ast_visit_names(node->data.if_statement.condition, visit, user);
+            ast_visit_names(node->data.if_statement.then_branch, visit, user);
+            ast_visit_names(node->data.if_statement.else_branch, visit, user);
+            break;
+
+        case AST_WHILE_STATEMENT:
+            ast_visit_names(node->data.while_statement.condition, visit, user);
+            ast_visit_names(node->data.while_statement.body, visit, user);
+            break;
+
+        case AST_SWITCH_STATEMENT:
+            ast_visit_names(node->data.switch_statement.subject, visit, user);
+            visit_name_list(node->data.switch_statement.cases, visit, user);
+            ast_visit_names(node->data.switch_statement.else_body, visit, user);
+            break;
+
+        case AST_SWITCH_CASE:
+            visit_name_list(node->data.switch_case.values, visit, user);
+            ast_visit_names(node->data.switch_case.body, visit, user);
+            break;
+
+        case AST_FOR_STATEMENT:
+            ast_visit_names(node->data.for_statement.init, visit, user);
+            ast_visit_names(node->data.for_statement.condition, visit, user);
+            ast_visit_names(node->data.for_statement.post, visit, user);
+            ast_visit_names(node->data.for_statement.range, visit, user);
+            ast_visit_names(node->data.for_statement.body, visit, user);
+            break;
+
+        case AST_RETURN_STATEMENT:
+            ast_visit_names(node->data.return_statement.expression, visit, user);
+            break;
+
+        case AST_DEFER_STATEMENT:
+            ast_visit_names(node->data.defer_statement.body, visit, user);
+            break;
+
+        case AST_EXPR_STATEMENT:
+            ast_visit_names(node->data.expr_statement.expression, visit, user);
+            break;
+
+        case AST_IDENTIFIER:
+            visit(node->data.identifier.intern_result, user);
+            break;
+
+        case AST_BINARY_EXPR:
+            ast_visit_names(node->data.binary_expr.left, visit, user);
+            ast_visit_names(node->data.binary_expr.right, visit, user);
+            break;
+
+        case AST_UNARY_EXPR:
+            ast_visit_names(node->data.unary_expr.expr, visit, user);
+            break;
+
+        case AST_POSTFIX_EXPR:
+            ast_visit_names(node->data.postfix_expr.expr, visit, user);
+            break;
+
+        case AST_ASSIGNMENT_EXPR:
+            ast_visit_names(node->data.assignment_expr.lvalue, visit, user);
+            ast_visit_names(node->data.assignment_expr.rvalue, visit, user);
+            break;
+
+        case AST_CALL_EXPR:
+            ast_visit_names(node->data.call_expr.callee, visit, user);
+            visit_name_list(node->data.call_expr.args, visit, user);
+            break;
+
+        case AST_GENERIC_INST_EXPR:
+            ast_visit_names(node->data.generic_inst_expr.base, visit, user);
+            visit_name_list(node->data.generic_inst_expr.type_args, visit, user);
+            break;
+
+        case AST_SUBSCRIPT_EXPR:
+            ast_visit_names(node->data.subscript_expr.target, visit, user);
+            ast_visit_names(node->data.subscript_expr.index, visit, user);
+            break;
+
+        case AST_MEMBER_EXPR:
+            ast_visit_names(node->data.member_expr.target, visit, user);
+            visit(node->data.member_expr.member, user);
+            break;
+
+        case AST_STRUCT_LITERAL:
+            ast_visit_names(node->data.struct_literal.type_node, visit, user);
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) {
+                    ast_visit_names(init->expr, visit, user);
+                }
+            }
+            break;
+
+        case AST_CAST:
+            ast_visit_names(node->data.cast_expr.expr, visit, user);
+            ast_visit_names(node->data.cast_expr.target_type_node, visit, user);
+            break;
+
+        case AST_TYPE: {
+            AstType *ty = &node->data.ast_type;
+            switch (ty->kind) {
+                case AST_TYPE_PRIMITIVE:
+                    if (ty->u.base.path) ast_visit_names(ty->u.base.path, visit, user);
+                    else visit(ty->u.base.intern_result, user);
+                    break;
+                case AST_TYPE_PTR:
+                    ast_visit_names(ty->u.ptr.target, visit, user);
+                    break;
+                case AST_TYPE_ARRAY:
+                case AST_TYPE_VECTOR:
+                    ast_visit_names(ty->u.array.elem, visit, user);
+                    ast_visit_names(ty->u.array.size_expr, visit, user);
+                    break;
+                case AST_TYPE_FUNC:
+                    visit_name_list(ty->u.func.param_types, visit, user);
+                    ast_visit_names(ty->u.func.return_type, visit, user);
+                    break;
+                case AST_TYPE_APPLICATION:
+                    ast_visit_names(ty->u.application.base, visit, user);
+                    visit_name_list(ty->u.application.args, visit, user);
+                    break;
+            }
+            break;
+        }
+
+        case AST_INITIALIZER_LIST:
+            visit_name_list(node->data.initializer_list.elements, visit, user);
+            break;
+
+        case AST_IMPORT_DECLARATION:
+        case AST_BREAK_STATEMENT:
+        case AST_CONTINUE_STATEMENT:
+        case AST_LITERAL:
+            break;
+    }
+}
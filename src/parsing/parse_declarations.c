@@ -6,6 +6,7 @@
 #include "dynamic_array.h"
 #include "lexer.h"
 #include "ast.h"
+#include <stdio.h>
 #include <string.h>
 
 static bool parse_program_decls(Parser *p, AstNode *program, ParseError *err, Span *first_span, Span *last_span, bool *have_any) {
@@ -27,18 +28,20 @@ static bool parse_program_decls(Parser *p, AstNode *program, ParseError *err, Sp
             *have_any = true;
         }
         *last_span = decl->span;
+
+        /* Nothing from this declaration is looked at again */
+        parser_release_consumed(p);
     }
     return true;
 }
 
 static void set_program_span(Parser *p, AstNode *program, bool have_any, Span first_span, Span last_span) {
     if (have_any) {
-        program->span = span_join(&first_span, &last_span);
-    } else if (p->tokens && p->tokens->count > 0) {
-        Token *first = (Token*)dynarray_get(p->tokens, 0);
-        program->span = first->span;
+        program->span = span_join(first_span, last_span);
+    } else if (parser_token_at(p, 0)) {
+        program->span = tok_span(p, parser_token_at(p, 0));
     } else {
-        program->span = (Span){0,0,0,0};
+        program->span = (Span){0,0,0};
     }
 }
 
@@ -73,35 +76,140 @@ AstNode *parse_program(Parser *p, ParseError *err) {
     return program;
 }
 
-AstNode *parse_declaration(Parser *p, ParseError *err) {
-    if (!p) return NULL;
+static const struct { const char *name; uint8_t bit; } FUNCTION_ATTRS[] = {
+    {"inline", FN_ATTR_INLINE}, {"noinline", FN_ATTR_NOINLINE},
+    {"hot", FN_ATTR_HOT}, {"cold", FN_ATTR_COLD}, {"pure", FN_ATTR_PURE},
+};
+
+static const struct { const char *name; uint8_t bit; } STRUCT_ATTRS[] = {
+    {"packed", STRUCT_ATTR_PACKED}, {"reorder", STRUCT_ATTR_REORDER},
+};
+
+/* Everything the `@...` prefix of a declaration can carry. */
+typedef struct {
+    InternResult *link_name; // @link("name")
+    uint8_t fn_attrs;        // FunctionAttrs
+    uint8_t struct_attrs;    // StructAttrs
+    uint32_t align;          // @align(N), 0 without one
+} DeclAttributes;
+
+static uint8_t attribute_bit(Slice name, bool *is_struct) {
+    for (size_t i = 0; i < sizeof(FUNCTION_ATTRS) / sizeof(FUNCTION_ATTRS[0]); i++) {
+        if (strlen(FUNCTION_ATTRS[i].name) == name.len && memcmp(FUNCTION_ATTRS[i].name, name.ptr, name.len) == 0) {
+            *is_struct = false;
+            return FUNCTION_ATTRS[i].bit;
+        }
+    }
+    for (size_t i = 0; i < sizeof(STRUCT_ATTRS) / sizeof(STRUCT_ATTRS[0]); i++) {
+        if (strlen(STRUCT_ATTRS[i].name) == name.len && memcmp(STRUCT_ATTRS[i].name, name.ptr, name.len) == 0) {
+            *is_struct = true;
+            return STRUCT_ATTRS[i].bit;
+        }
+    }
+    return 0;
+}
+
+/* '@' 'align' '(' <Int> ')': a power of two up to STRUCT_MAX_ALIGN */
+static bool parse_align_attribute(Parser *p, ParseError *err, Token *attr_name, DeclAttributes *out) {
+    if (out->align) {
+        if (err) create_parse_error(err, p, "duplicate attribute", attr_name);
+        return false;
+    }
+    if (!consume(p, TOK_LPAREN)) {
+        if (err) create_parse_error(err, p, "expected '(' after @align", current_token(p));
+        return false;
+    }
+    Token *value = consume(p, TOK_INT_LIT);
+    if (!value) {
+        if (err) create_parse_error(err, p, "expected integer literal in @align", current_token(p));
+        return false;
+    }
+    uint64_t n = value->int_value;
+    if (n == 0 || n > STRUCT_MAX_ALIGN || (n & (n - 1)) != 0) {
+        if (err) create_parse_error(err, p, "@align expects a power of two between 1 and 4096", value);
+        return false;
+    }
+    out->align = (uint32_t)n;
+    if (!consume(p, TOK_RPAREN)) {
+        if (err) create_parse_error(err, p, "expected ')' after @align value", current_token(p));
+        return false;
+    }
+    return true;
+}
 
-    InternResult *link_name = NULL;
-    if (current_token(p) && current_token(p)->type == TOK_AT) {
+/*
+ * { '@' ( 'link' '(' <String> ')' | 'align' '(' <Int> ')' | 'inline' | 'noinline'
+ *       | 'hot' | 'cold' | 'pure' | 'packed' | 'reorder' ) }
+ */
+static bool parse_attributes(Parser *p, ParseError *err, DeclAttributes *out) {
+    while (current_token(p) && current_token(p)->type == TOK_AT) {
         consume(p, TOK_AT);
         Token *attr_name = consume(p, TOK_IDENTIFIER);
-        if (attr_name) {
-            if (attr_name->slice.len == 4 && memcmp(attr_name->slice.ptr, "link", 4) == 0) {
-                if (!consume(p, TOK_LPAREN)) {
-                    if (err) create_parse_error(err, p, "expected '(' after @link", current_token(p));
-                    return NULL;
-                }
-                Token *name_lit = consume(p, TOK_STRING_LIT);
-                if (!name_lit) {
-                    if (err) create_parse_error(err, p, "expected string literal in @link", current_token(p));
-                    return NULL;
-                }
-                link_name = name_lit->record;
-                if (!consume(p, TOK_RPAREN)) {
-                    if (err) create_parse_error(err, p, "expected ')' after @link name", current_token(p));
-                    return NULL;
-                }
-            } else {
-                if (err) create_parse_error(err, p, "unknown attribute", attr_name);
-                return NULL;
+        if (!attr_name) continue;
+        Slice name = tok_slice(p, attr_name);
+
+        if (name.len == 4 && memcmp(name.ptr, "link", 4) == 0) {
+            if (!consume(p, TOK_LPAREN)) {
+                if (err) create_parse_error(err, p, "expected '(' after @link", current_token(p));
+                return false;
             }
+            Token *name_lit = consume(p, TOK_STRING_LIT);
+            if (!name_lit) {
+                if (err) create_parse_error(err, p, "expected string literal in @link", current_token(p));
+                return false;
+            }
+            out->link_name = name_lit->record;
+            if (!consume(p, TOK_RPAREN)) {
+                if (err) create_parse_error(err, p, "expected ')' after @link name", current_token(p));
+                return false;
+            }
+            continue;
+        }
+        if (name.len == 5 && memcmp(name.ptr, "align", 5) == 0) {
+            if (!parse_align_attribute(p, err, attr_name, out)) return false;
+            continue;
+        }
+
+        bool is_struct = false;
+        uint8_t bit = attribute_bit(name, &is_struct);
+        if (!bit) {
+            if (err) create_parse_error(err, p, "unknown attribute", attr_name);
+            return false;
+        }
+        uint8_t *attrs = is_struct ? &out->struct_attrs : &out->fn_attrs;
+        if (*attrs & bit) {
+            if (err) create_parse_error(err, p, "duplicate attribute", attr_name);
+            return false;
+        }
+        *attrs |= bit;
+        if ((out->fn_attrs & (FN_ATTR_INLINE | FN_ATTR_NOINLINE)) == (FN_ATTR_INLINE | FN_ATTR_NOINLINE)) {
+            if (err) create_parse_error(err, p, "@inline and @noinline are exclusive", attr_name);
+            return false;
+        }
+        if ((out->fn_attrs & (FN_ATTR_HOT | FN_ATTR_COLD)) == (FN_ATTR_HOT | FN_ATTR_COLD)) {
+            if (err) create_parse_error(err, p, "@hot and @cold are exclusive", attr_name);
+            return false;
         }
     }
+    return true;
+}
+
+/* Attributes in front of a declaration that does not take them. */
+static void reject_attributes(Parser *p, ParseError *err, const DeclAttributes *attrs, const char *what, Token *at) {
+    if (!err) return;
+    char msg[96];
+    if (attrs->link_name) snprintf(msg, sizeof(msg), "@link attribute not supported for %s", what);
+    else if (attrs->fn_attrs) snprintf(msg, sizeof(msg), "function attributes not supported for %s", what);
+    else if (attrs->struct_attrs || attrs->align) snprintf(msg, sizeof(msg), "struct attributes not supported for %s", what);
+    else return;
+    create_parse_error(err, p, msg, at);
+}
+
+AstNode *parse_declaration(Parser *p, ParseError *err) {
+    if (!p) return NULL;
+
+    DeclAttributes attrs = {0};
+    if (!parse_attributes(p, err, &attrs)) return NULL;
 
     bool is_pub = (parser_match(p, TOK_PUB) != 0);
 
@@ -132,37 +240,38 @@ AstNode *parse_declaration(Parser *p, ParseError *err) {
             }
             decl = parse_alias_declaration(p, err);
             return decl;
+        case TOK_ASYNC:
         case TOK_FN: 
             decl = parse_function_declaration(p, err); 
             if (decl) {
                 decl->data.function_declaration.is_pub = is_pub;
-                decl->data.function_declaration.link_name = link_name;
+                decl->data.function_declaration.link_name = attrs.link_name;
+                decl->data.function_declaration.attrs |= attrs.fn_attrs;
+                DeclAttributes rest = { .struct_attrs = attrs.struct_attrs, .align = attrs.align };
+                reject_attributes(p, err, &rest, "functions", current);
             }
             return decl;
         case TOK_STRUCT:
             decl = parse_struct_declaration(p, err); 
             if (decl) {
                 decl->data.struct_declaration.is_pub = is_pub;
-                if (link_name) {
-                    if (err) create_parse_error(err, p, "@link attribute not supported for structs", current);
-                }
+                decl->data.struct_declaration.attrs = attrs.struct_attrs;
+                decl->data.struct_declaration.align = attrs.align;
+                DeclAttributes rest = { .link_name = attrs.link_name, .fn_attrs = attrs.fn_attrs };
+                reject_attributes(p, err, &rest, "structs", current);
             }
             return decl;
         case TOK_ENUM:
             decl = parse_enum_declaration(p, err);
             if (decl) {
                 decl->data.enum_declaration.is_pub = is_pub;
-                if (link_name) {
-                    if (err) create_parse_error(err, p, "@link attribute not supported for enums", current);
-                }
+                reject_attributes(p, err, &attrs, "enums", current);
             }
             return decl;
         case TOK_IMPL:
             decl = parse_impl_declaration(p, err);
             if (decl) {
-                if (link_name) {
-                    if (err) create_parse_error(err, p, "@link attribute not supported for impl blocks", current);
-                }
+                reject_attributes(p, err, &attrs, "impl blocks", current);
             }
             return decl;
         case TOK_CONST:
@@ -170,9 +279,7 @@ AstNode *parse_declaration(Parser *p, ParseError *err) {
             decl = parse_declaration_stmt(p, err); 
             if (decl) {
                 decl->data.variable_declaration.is_pub = is_pub;
-                if (link_name) {
-                    if (err) create_parse_error(err, p, "@link attribute not supported for variables", current);
-                }
+                reject_attributes(p, err, &attrs, "variables", current);
             }
             return decl;
         default:
@@ -226,7 +333,7 @@ AstNode *parse_alias_declaration(Parser *p, ParseError *err) {
         return NULL;
     }
 
-    decl->span = span_join(&alias_tok->span, &semi->span);
+    decl->span = span_join(tok_span(p, alias_tok), tok_span(p, semi));
     return decl;
 }
 
@@ -321,10 +428,43 @@ AstNode *parse_import_declaration(Parser *p, ParseError *err) {
         return NULL;
     }
 
-    decl->span = span_join(&import_tok->span, &semi->span);
+    decl->span = span_join(tok_span(p, import_tok), tok_span(p, semi));
     return decl;
 }
 
+/*
+ * [ '<' <Param> { ',' <Param> } '>' ] where <Param> is a type parameter name
+ * or `name: <Type>`, a const parameter. `const_params` stays NULL unless one
+ * is const; then it holds each parameter's type, NULL at type parameters.
+ */
+static bool parse_type_params(Parser *p, ParseError *err, DynArray **type_params, DynArray **const_params) {
+    if (!current_token(p) || current_token(p)->type != TOK_LT) return true;
+    consume(p, TOK_LT);
+    *type_params = alloc_dynarray(p, err, sizeof(InternResult*), 2, "out of memory for type params");
+    if (!*type_params) return false;
+
+    do {
+        Token *tp = consume(p, TOK_IDENTIFIER);
+        if (!tp) { create_parse_error(err, p, "expected type parameter name", current_token(p)); return false; }
+        AstNode *const_type = NULL;
+        if (parser_match(p, TOK_COLON)) {
+            const_type = parse_type(p, err);
+            if (!const_type) return false;
+            if (!*const_params) {
+                *const_params = alloc_dynarray(p, err, sizeof(AstNode*), 2, "out of memory for const params");
+                if (!*const_params) return false;
+                AstNode *none = NULL;
+                for (size_t i = 0; i < (*type_params)->count; i++) dynarray_push_value(*const_params, &none);
+            }
+        }
+        dynarray_push_value(*type_params, &tp->record);
+        if (*const_params) dynarray_push_value(*const_params, &const_type);
+    } while (parser_match(p, TOK_COMMA));
+
+    if (!consume(p, TOK_GT)) { create_parse_error(err, p, "expected '>' after type parameters", current_token(p)); return false; }
+    return true;
+}
+
 AstNode *parse_struct_declaration(Parser *p, ParseError *err) {
     if (!p) return NULL;
     Token *struct_kw = consume(p, TOK_STRUCT);
@@ -340,25 +480,10 @@ AstNode *parse_struct_declaration(Parser *p, ParseError *err) {
     }
     decl->data.struct_declaration.intern_result = name_tok->record;
 
-    DynArray *type_params = NULL;
-    if (current_token(p) && current_token(p)->type == TOK_LT) {
-        consume(p, TOK_LT);
-        type_params = arena_alloc(p->arena, sizeof(DynArray));
-        if (!type_params) {
-            if (err) create_parse_error(err, p, "out of memory for type params", NULL);
-            return NULL;
-        }
-        dynarray_init_in_arena(type_params, p->arena, sizeof(InternResult*), 2);
-
-        do {
-            Token *tp = consume(p, TOK_IDENTIFIER);
-            if (!tp) { create_parse_error(err, p, "expected type parameter name", current_token(p)); return NULL; }
-            dynarray_push_value(type_params, &tp->record);
-        } while (parser_match(p, TOK_COMMA));
-
-        if (!consume(p, TOK_GT)) { create_parse_error(err, p, "expected '>' after type parameters", current_token(p)); return NULL; }
-    }
+    DynArray *type_params = NULL, *const_params = NULL;
+    if (!parse_type_params(p, err, &type_params, &const_params)) return NULL;
     decl->data.struct_declaration.type_params = type_params;
+    decl->data.struct_declaration.const_params = const_params;
 
     decl->data.struct_declaration.fields = arena_alloc(p->arena, sizeof(DynArray));
     if (!decl->data.struct_declaration.fields) {
@@ -406,7 +531,7 @@ AstNode *parse_struct_declaration(Parser *p, ParseError *err) {
         return NULL;
     }
 
-    decl->span = span_join(&struct_kw->span, &rbrace->span);
+    decl->span = span_join(tok_span(p, struct_kw), tok_span(p, rbrace));
     return decl;
 }
 
@@ -424,9 +549,8 @@ AstNode *parse_enum_declaration(Parser *p, ParseError *err) {
 
     InternResult *enum_name = name_tok->record;
     
-    AstNode *enum_node = arena_alloc(p->arena, sizeof(AstNode));
-    enum_node->node_type = AST_ENUM_DECLARATION;
-    enum_node->span = name_tok->span; // Might want to extend it to the end bracket later
+    AstNode *enum_node = ast_create_node(AST_ENUM_DECLARATION, p->arena, p->file);
+    enum_node->span = tok_span(p, name_tok); // Might want to extend it to the end bracket later
     enum_node->data.enum_declaration.intern_result = enum_name;
     enum_node->data.enum_declaration.is_pub = 0;
     
@@ -478,24 +602,10 @@ AstNode *parse_impl_declaration(Parser *p, ParseError *err) {
     AstNode *decl = new_node_or_err(p, AST_IMPL_DECLARATION, err, "out of memory creating impl declaration node");
     if (!decl) return NULL;
 
-    DynArray *type_params = NULL;
-    if (current_token(p) && current_token(p)->type == TOK_LT) {
-        consume(p, TOK_LT);
-        type_params = arena_alloc(p->arena, sizeof(DynArray));
-        if (!type_params) {
-            if (err) create_parse_error(err, p, "out of memory for type params", NULL);
-            return NULL;
-        }
-        dynarray_init_in_arena(type_params, p->arena, sizeof(InternResult*), 2);
-
-        do {
-            Token *tp = consume(p, TOK_IDENTIFIER);
-            if (!tp) { create_parse_error(err, p, "expected type parameter name", current_token(p)); return NULL; }
-            dynarray_push_value(type_params, &tp->record);
-        } while (parser_match(p, TOK_COMMA));
-
-        if (!consume(p, TOK_GT)) { create_parse_error(err, p, "expected '>' after type parameters", current_token(p)); return NULL; }
-    }
+    DynArray *type_params = NULL, *const_params = NULL;
+    if (!parse_type_params(p, err, &type_params, &const_params)) return NULL;
+    // The struct's own list says which parameters are constants; impl<T, N: usize> only names them
+    (void)const_params;
     decl->data.impl_declaration.type_params = type_params;
 
     AstNode *target_type = parse_type(p, err);
@@ -516,12 +626,23 @@ AstNode *parse_impl_declaration(Parser *p, ParseError *err) {
 
     Token *current = current_token(p);
     while (current && current->type != TOK_RBRACE && current->type != TOK_EOF) {
+        DeclAttributes attrs = {0};
+        if (!parse_attributes(p, err, &attrs)) return NULL;
+        DeclAttributes rest = { .link_name = attrs.link_name, .struct_attrs = attrs.struct_attrs, .align = attrs.align };
+        if (rest.link_name || rest.struct_attrs || rest.align) {
+            reject_attributes(p, err, &rest, "methods", current);
+            return NULL;
+        }
         bool is_pub = (parser_match(p, TOK_PUB) != 0);
 
+        bool outer_generic = p->in_generic_impl;
+        p->in_generic_impl = type_params != NULL;
         AstNode *method = parse_function_declaration(p, err);
+        p->in_generic_impl = outer_generic;
         if (!method) return NULL;
         
         method->data.function_declaration.is_pub = is_pub;
+        method->data.function_declaration.attrs |= attrs.fn_attrs;
         dynarray_push_value(decl->data.impl_declaration.methods, &method);
         
         current = current_token(p);
@@ -533,7 +654,7 @@ AstNode *parse_impl_declaration(Parser *p, ParseError *err) {
         return NULL;
     }
 
-    decl->span = span_join(&impl_kw->span, &rbrace->span);
+    decl->span = span_join(tok_span(p, impl_kw), tok_span(p, rbrace));
     return decl;
 }
 
@@ -549,7 +670,7 @@ AstNode *parse_declaration_stmt(Parser *p, ParseError *err) {
         return NULL;
     }
 
-    declaration->span = span_join(&declaration->span, &semi->span);
+    declaration->span = span_join(declaration->span, tok_span(p, semi));
     return declaration;
 }
 
@@ -569,9 +690,9 @@ AstNode *parse_variable_declaration(Parser *p, ParseError *err) {
     if (tok->type == TOK_CONST) {
         Token *const_tok = consume(p, TOK_CONST);
         declaration->data.variable_declaration.is_const = 1;
-        declaration->span = const_tok->span;
+        declaration->span = tok_span(p, const_tok);
     } else {
-        declaration->span = (Span){0,0,0,0};
+        declaration->span = (Span){0,0,0};
     }
 
     Token *name_tok = consume(p, TOK_IDENTIFIER);
@@ -582,8 +703,8 @@ AstNode *parse_variable_declaration(Parser *p, ParseError *err) {
     declaration->data.variable_declaration.intern_result = name_tok->record;
 
     /* ensure span covers the identifier (and 'const' if present) */
-    if (declaration->span.start_line == 0) declaration->span = name_tok->span;
-    else declaration->span = span_join(&declaration->span, &name_tok->span);
+    if (declaration->span.file == SOURCE_NONE) declaration->span = tok_span(p, name_tok);
+    else declaration->span = span_join(declaration->span, tok_span(p, name_tok));
 
     if (!consume(p, TOK_COLON)) {
         if (err) create_parse_error(err, p, "expected ':' after variable name", current_token(p));
@@ -605,17 +726,58 @@ AstNode *parse_variable_declaration(Parser *p, ParseError *err) {
             initializer = parse_expression(p, err);
         }
         if (!initializer) return NULL;
-        declaration->span = span_join(&declaration->span, &initializer->span);
+        declaration->span = span_join(declaration->span, initializer->span);
     } else {
-        declaration->span = span_join(&declaration->span, &type->span);
+        declaration->span = span_join(declaration->span, type->span);
     }
 
     declaration->data.variable_declaration.initializer = initializer;
     return declaration;
 }
 
+/* Step over a balanced `{...}` without building anything; returns the
+ * closing brace. Used for function bodies when bodies are deferred. */
+static Token *skim_block(Parser *p, ParseError *err) {
+    Token *open = consume(p, TOK_LBRACE);
+    if (!open) {
+        if (err) create_parse_error(err, p, "expected '{' at start of block", current_token(p));
+        return NULL;
+    }
+    size_t depth = 1;
+    for (;;) {
+        Token *tok = current_token(p);
+        if (!tok || tok->type == TOK_EOF) {
+            if (err) create_parse_error(err, p, "unexpected end of input in block, expected '}'", tok);
+            return NULL;
+        }
+        p->current++;
+        if (tok->type == TOK_LBRACE) depth++;
+        else if (tok->type == TOK_RBRACE && --depth == 0) return tok;
+    }
+}
+
+/* Parse a block only to check it: the nodes go to scratch memory and are
+ * dropped, tokens and error messages stay with the parser. Returns the
+ * closing brace. Used for generic bodies, which every instance re-parses. */
+static Token *validate_block(Parser *p, ParseError *err) {
+    ArenaScratch scratch = arena_scratch_begin();
+    Arena *arena = p->arena;
+    p->arena = scratch.arena;
+    AstNode *block = parse_block(p, err);
+    p->arena = arena;
+
+    Token *close = block ? parser_token_at(p, p->current - 1) : NULL;
+    if (!block && err && err->message) {
+        int use_prev = err->use_prev_token;
+        create_parse_error(err, p, err->message, err->token);
+        err->use_prev_token = use_prev;
+    }
+    arena_scratch_end(scratch);
+    return close;
+}
+
 AstNode *parse_function_declaration(Parser *p, ParseError *err) {
-    AstNode *func_decl = ast_create_node(AST_FUNCTION_DECLARATION, p->arena, p->filename);
+    AstNode *func_decl = ast_create_node(AST_FUNCTION_DECLARATION, p->arena, p->file);
     if (!func_decl) {
         if (err) create_parse_error(err, p, "out of memory creating function declaration node", NULL);  
         return NULL;
@@ -627,12 +789,14 @@ AstNode *parse_function_declaration(Parser *p, ParseError *err) {
     }
     dynarray_init_in_arena(func_decl->data.function_declaration.params, p->arena, sizeof(AstNode*), 4);
 
-    /* fn */
+    /* [async] fn */
+    Token *async_tok = consume(p, TOK_ASYNC);
+    if (async_tok) func_decl->data.function_declaration.attrs = FN_ATTR_ASYNC;
     Token *fn_tok = consume(p, TOK_FN);
     if (!fn_tok) { create_parse_error(err, p, "expected 'fn' keyword at start of function declaration", current_token(p)); return NULL; }
     
-    /* Initialize span with the fn token */
-    func_decl->span = fn_tok->span;
+    /* Initialize span with the first token */
+    func_decl->span = tok_span(p, async_tok ? async_tok : fn_tok);
 
     /* name */
     Token *name_tok = consume(p, TOK_IDENTIFIER);
@@ -641,25 +805,10 @@ AstNode *parse_function_declaration(Parser *p, ParseError *err) {
     func_decl->data.function_declaration.intern_result = name_tok->record;
     func_decl->data.function_declaration.target_type_node = NULL;
 
-    DynArray *type_params = NULL;
-    if (current_token(p) && current_token(p)->type == TOK_LT) {
-        consume(p, TOK_LT);
-        type_params = arena_alloc(p->arena, sizeof(DynArray));
-        if (!type_params) {
-            if (err) create_parse_error(err, p, "out of memory for type params", NULL);
-            return NULL;
-        }
-        dynarray_init_in_arena(type_params, p->arena, sizeof(InternResult*), 2);
-
-        do {
-            Token *tp = consume(p, TOK_IDENTIFIER);
-            if (!tp) { create_parse_error(err, p, "expected type parameter name", current_token(p)); return NULL; }
-            dynarray_push_value(type_params, &tp->record);
-        } while (parser_match(p, TOK_COMMA));
-
-        if (!consume(p, TOK_GT)) { create_parse_error(err, p, "expected '>' after type parameters", current_token(p)); return NULL; }
-    }
+    DynArray *type_params = NULL, *const_params = NULL;
+    if (!parse_type_params(p, err, &type_params, &const_params)) return NULL;
     func_decl->data.function_declaration.type_params = type_params;
+    func_decl->data.function_declaration.const_params = const_params;
 
     /* parameters */
     if (!consume(p, TOK_LPAREN)) { create_parse_error(err, p, "expected '(' after function name", current_token(p)); return NULL; }
@@ -687,18 +836,60 @@ AstNode *parse_function_declaration(Parser *p, ParseError *err) {
     if (tok && tok->type == TOK_SEMICOLON) {
         consume(p, TOK_SEMICOLON);
         func_decl->data.function_declaration.body = NULL;
-        func_decl->span = span_join(&func_decl->span, &tok->span);
+        func_decl->span = span_join(func_decl->span, tok_span(p, tok));
+    } else if (p->lazy_bodies && (p->defer_all_bodies || type_params || p->in_generic_impl)) {
+        Token *close = p->defer_all_bodies ? skim_block(p, err) : validate_block(p, err);
+        if (!close) return NULL;
+        func_decl->data.function_declaration.body = NULL;
+        func_decl->data.function_declaration.lazy_body = p->lazy_bodies;
+        func_decl->data.function_declaration.body_start = tok->offset;
+        func_decl->data.function_declaration.body_end = close->offset + close->len;
+        func_decl->span = span_join(func_decl->span, tok_span(p, close));
     } else {
         func_decl->data.function_declaration.body = parse_block(p, err);
         if (!func_decl->data.function_declaration.body) return NULL; /* parse_block produced an error */
         
         /* Update span to include the entire function from fn token to end of body */
-        func_decl->span = span_join(&func_decl->span, &func_decl->data.function_declaration.body->span);
+        func_decl->span = span_join(func_decl->span, func_decl->data.function_declaration.body->span);
     }
     
     return func_decl;
 }
 
+AstNode *parse_deferred_body(const AstNode *func_decl, Arena *arena, const char **err_msg, Span *err_span) {
+    const AstFunctionDeclaration *f = &func_decl->data.function_declaration;
+    const LazyBodySource *src = f->lazy_body;
+    if (!src) return f->body;
+
+    /* The lexer stops right after the closing brace; its tokens are scratch */
+    ArenaScratch scratch = arena_scratch_begin();
+    const char *msg = "out of memory parsing function body";
+    Span span = func_decl->span;
+    AstNode *body = NULL;
+
+    Lexer *lexer = lexer_create_ex(src->source, f->body_end, src->file, scratch.arena,
+                                   src->keywords, src->identifiers, src->strings);
+    if (lexer) {
+        lexer_seek(lexer, f->body_start);
+        Parser *p = lexer_lex_all(lexer) ? parser_create(lexer, src->filename, arena) : NULL;
+        if (p) {
+            ParseError err = {0};
+            body = parse_block(p, &err);
+            if (!body && err.message) {
+                msg = err.message;
+                if (err.token) span = tok_span(p, err.token);
+            }
+        }
+    }
+    arena_scratch_end(scratch);
+
+    if (!body) {
+        if (err_msg) *err_msg = msg;
+        if (err_span) *err_span = span;
+    }
+    return body;
+}
+
 int parse_parameter_list(Parser *p, AstNode *func_decl, ParseError *err) {
     if (!func_decl || func_decl->node_type != AST_FUNCTION_DECLARATION) {
         if (err) create_parse_error(err, p, "internal error: parse_parameter_list called with non-function-declaration node", current_token(p));
@@ -725,22 +916,39 @@ int parse_parameter_list(Parser *p, AstNode *func_decl, ParseError *err) {
             return 0;
         }
 
+        /* remember span of the identifier, or of @noalias before it (start of param) */
+        Span start_span = tok_span(p, tok);
+        bool is_noalias = false;
+        if (tok->type == TOK_AT) {
+            consume(p, TOK_AT);
+            Token *attr_name = consume(p, TOK_IDENTIFIER);
+            Slice name = attr_name ? tok_slice(p, attr_name) : (Slice){0};
+            if (!attr_name || name.len != 7 || memcmp(name.ptr, "noalias", 7) != 0) {
+                if (err) create_parse_error(err, p, "unknown parameter attribute (expected @noalias)", attr_name ? attr_name : current_token(p));
+                return 0;
+            }
+            is_noalias = true;
+            tok = current_token(p);
+            if (!tok) {
+                if (err) create_parse_error(err, p, "unexpected end of input in parameter list", NULL);
+                return 0;
+            }
+        }
+
         if (tok->type != TOK_IDENTIFIER) {
             if (err) create_parse_error(err, p, "expected identifier for parameter name", NULL);
             return 0;
         }
 
-        /* remember span of the identifier (start of param) */
-        Span start_span = tok->span;
-
         /* create and fill a new parameter node */
-        AstNode *param = ast_create_node(AST_PARAM, p->arena, p->filename);
+        AstNode *param = ast_create_node(AST_PARAM, p->arena, p->file);
         if (!param) {
             if (err) create_parse_error(err, p, "out of memory creating parameter node", NULL);
             return 0;
         }
 
         param->data.param.name_idx = tok->record ? tok->record->entry->dense_index : -1;
+        param->data.param.is_noalias = is_noalias;
         consume(p, TOK_IDENTIFIER);
 
         if (!consume(p, TOK_COLON)) {
@@ -754,7 +962,7 @@ int parse_parameter_list(Parser *p, AstNode *func_decl, ParseError *err) {
         }
 
         /* compute param span from identifier to end of type */
-        param->span = span_join(&start_span, &param->data.param.type->data.ast_type.span);
+        param->span = span_join(start_span, param->data.param.type->data.ast_type.span);
 
         /* push the parameter into the function declaration */
         if (dynarray_push_value(func_decl->data.function_declaration.params, &param) != 0) {
@@ -6,153 +6,93 @@
 #include "ast.h"
 #include "core/error.h"
 #include <limits.h>
-#include <math.h>
 #include <string.h>
 #include <stdint.h>
 
-static inline int detect_base(const char *s, size_t len, size_t *start) {
-    if (len > 2 && s[0] == '0') {
-        if (s[1] == 'x' || s[1] == 'X') {
-            *start = 2;
-            return 16;
-        } else if (s[1] == 'b' || s[1] == 'B') {
-            *start = 2;
-            return 2;
-        }
-    }
-    *start = 0;
-    return 10;
-}
-
-static inline int char_to_digit(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-    return -1;
-}
-
-bool parse_int_lit(const char *s, size_t len, unsigned long long *out) {
-    if (len == 0) return false;
-    
-    size_t start = 0;
-    int base = detect_base(s, len, &start);
-
-    uint64_t val = 0;
-    bool any_digits = false;
-
-    // Pre-calculate strict bounds for the specific base
-    uint64_t max_val = UINT64_MAX / base;
-    uint64_t rem = UINT64_MAX % base;
-
-    for (size_t i = start; i < len; i++) {
-        if (s[i] == '_') continue; // Support underscores
-
-        int d = char_to_digit(s[i]);
-        if (d == -1 || d >= base) return false; // invalid char
-
-        // Strict, cross-platform 64-bit overflow check
-        if (val > max_val || (val == max_val && (uint64_t)d > rem)) {
-            return false; 
-        }
-
-        val = val * (uint64_t)base + (uint64_t)d;
-        any_digits = true;
-    }
-
-    if (!any_digits) return false;
-
-    *out = val;
-    return true;
-}
-
-static inline bool parse_float_lit(const char *s, size_t len, double *out) {
-    double val = 0.0;
-    size_t i = 0;
+/*
+ * Binary operators are parsed by precedence climbing over a binding-power
+ * table instead of one function per level, so an operand costs the same
+ * handful of calls however many levels sit above it. Higher binds tighter;
+ * every level is left-associative. `as` sits above `*` and below prefix
+ * operators: `-x as T * y` is `((-x) as T) * y`.
+ */
+enum {
+    BP_NONE = 0,
+    BP_LOGICAL_OR,
+    BP_LOGICAL_AND,
+    BP_EQUALITY,
+    BP_RELATIONAL,
+    BP_ADDITIVE,
+    BP_MULTIPLICATIVE,
+    BP_CAST
+};
+
+typedef struct {
+    uint8_t bp;          /* BP_NONE: not a binary operator */
+    uint8_t op;          /* OpKind */
+    const char *oom_msg;
+} BinaryOpInfo;
+
+static const BinaryOpInfo binary_ops[TOK_UNKNOWN + 1] = {
+    [TOK_OR_OR]   = { BP_LOGICAL_OR,     OP_OR,  "out of memory creating logical-or node" },
+    [TOK_AND_AND] = { BP_LOGICAL_AND,    OP_AND, "out of memory creating logical-and node" },
+    [TOK_EQ_EQ]   = { BP_EQUALITY,       OP_EQ,  "out of memory creating equality node" },
+    [TOK_BANG_EQ] = { BP_EQUALITY,       OP_NEQ, "out of memory creating equality node" },
+    [TOK_LT]      = { BP_RELATIONAL,     OP_LT,  "out of memory creating relational node" },
+    [TOK_GT]      = { BP_RELATIONAL,     OP_GT,  "out of memory creating relational node" },
+    [TOK_LT_EQ]   = { BP_RELATIONAL,     OP_LE,  "out of memory creating relational node" },
+    [TOK_GT_EQ]   = { BP_RELATIONAL,     OP_GE,  "out of memory creating relational node" },
+    [TOK_PLUS]    = { BP_ADDITIVE,       OP_ADD, "out of memory creating additive node" },
+    [TOK_MINUS]   = { BP_ADDITIVE,       OP_SUB, "out of memory creating additive node" },
+    [TOK_STAR]    = { BP_MULTIPLICATIVE, OP_MUL, "out of memory creating multiplicative node" },
+    [TOK_SLASH]   = { BP_MULTIPLICATIVE, OP_DIV, "out of memory creating multiplicative node" },
+    [TOK_PERCENT] = { BP_MULTIPLICATIVE, OP_MOD, "out of memory creating multiplicative node" },
+    [TOK_AS]      = { BP_CAST,           OP_NULL, "out of memory creating cast node" },
+};
+
+/* Parse an expression whose operators all bind at least as tight as min_bp. */
+static AstNode *parse_binary(Parser *p, ParseError *err, int min_bp) {
+    AstNode *lhs = parse_unary(p, err);
+    if (!lhs) return NULL;
 
-    // integer part
-    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
-        val = val * 10.0 + (s[i] - '0');
-    }
+    for (;;) {
+        Token *token = current_token(p);
+        if (!token) return lhs;
+        const BinaryOpInfo *info = &binary_ops[token->type];
+        if (info->bp == BP_NONE || info->bp < min_bp) return lhs;
+        consume(p, token->type);
 
-    // fractional part
-    if (i < len && s[i] == '.') {
-        i++;
-        double frac = 0.0, base = 0.1;
-        while (i < len && s[i] >= '0' && s[i] <= '9') {
-            frac += (s[i] - '0') * base;
-            base *= 0.1;
-            i++;
-        }
-        val += frac;
-    }
+        if (info->bp == BP_CAST) {
+            AstNode *target_type_node = parse_type(p, err);
+            if (!target_type_node) return NULL;
 
-    // exponent part
-    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
-        i++;
-        int exp_sign = 1;
-        if (i < len && (s[i] == '+' || s[i] == '-')) {
-            if (s[i] == '-') exp_sign = -1;
-            i++;
-        }
+            AstNode *cast = new_node_or_err(p, AST_CAST, err, info->oom_msg);
+            if (!cast) return NULL;
 
-        int exp_val = 0;
-        while (i < len && s[i] >= '0' && s[i] <= '9') {
-            exp_val = exp_val * 10 + (s[i] - '0');
-            i++;
+            cast->data.cast_expr.expr = lhs;
+            cast->data.cast_expr.target_type = NULL;
+            cast->data.cast_expr.target_type_node = target_type_node;
+            cast->span = span_join(lhs->span, target_type_node->span);
+            lhs = cast;
+            continue;
         }
 
-        val *= pow(10.0, exp_sign * exp_val);
-    }
-
-    if (i != len) return false; // invalid chars remain
-
-    *out = val;
-    return true;
-}
-
-/* operand_parser: parse one operand/sublevel and return AST node (or NULL on error). */
-typedef AstNode *(*operand_parser_fn)(Parser *p, ParseError *err);
-typedef OpKind (*map_token_to_op_fn)(Token *tok);
-
-/* Generic left-associative binary parser */
-static AstNode *parse_left_assoc_binary(Parser *p, ParseError *err,
-                        operand_parser_fn parse_operand,
-                        map_token_to_op_fn map_op,
-                        const char *oom_msg)
-{
-    AstNode *lhs = parse_operand(p, err);
-    if (!lhs) return NULL;
-
-    Token *token = current_token(p);
-    int op;
-    while (token && (op = (int)map_op(token)) != OP_NULL) {
-        /* copy operator token for span/error reporting */
-        Token op_token = *token;
-        consume(p, token->type);
-
-        AstNode *rhs = parse_operand(p, err);
+        AstNode *rhs = parse_binary(p, err, info->bp + 1);
         if (!rhs) return NULL;
 
-        AstNode *bin = new_node_or_err(p, AST_BINARY_EXPR, err, oom_msg);
-        if (!bin) {
-            if (err) create_parse_error(err, p, oom_msg, &op_token);
-            return NULL;
-        }
+        AstNode *bin = new_node_or_err(p, AST_BINARY_EXPR, err, info->oom_msg);
+        if (!bin) return NULL;
 
         bin->data.binary_expr.left  = lhs;
         bin->data.binary_expr.right = rhs;
-        bin->data.binary_expr.op    = (OpKind)op;
-        bin->span = span_join(&lhs->span, &rhs->span);
-
+        bin->data.binary_expr.op    = (OpKind)info->op;
+        bin->span = span_join(lhs->span, rhs->span);
         lhs = bin;
-        token = current_token(p);
     }
-
-    return lhs;
 }
 
 AstNode *parse_expression(Parser *p, ParseError *err) {
-    AstNode *lhs = parse_logical_or(p, err);
+    AstNode *lhs = parse_binary(p, err, BP_LOGICAL_OR);
     if (!lhs) return NULL;
 
     Token *token = current_token(p);
@@ -201,100 +141,19 @@ AstNode* parse_assignment(Parser *p, AstNode *lhs, ParseError *err) {
     assign->data.assignment_expr.lvalue = lhs;
     assign->data.assignment_expr.rvalue = rhs;
     assign->data.assignment_expr.op = map_assignment_op(op_tok);
-    assign->span = span_join(&lhs->span, &rhs->span);
+    assign->span = span_join(lhs->span, rhs->span);
     return assign;
 }
 
-static OpKind map_logical_or_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    if (tok->type == TOK_OR_OR) return OP_OR;
-    return OP_NULL;
-}
-
-AstNode *parse_logical_or(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_logical_and, map_logical_or_op, "out of memory creating logical-or node");
-}
-
-static OpKind map_logical_and_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    if (tok->type == TOK_AND_AND) return OP_AND;
-    return OP_NULL;
-}
-AstNode *parse_logical_and(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_equality, map_logical_and_op, "out of memory creating logical-and node");
-}
-
-static OpKind map_equality_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    switch (tok->type) {
-        case TOK_EQ_EQ: return OP_EQ;
-        case TOK_BANG_EQ: return OP_NEQ;
-        default: return OP_NULL;
-    }
-}
-AstNode *parse_equality(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_relational, map_equality_op, "out of memory creating equality node");
-}
-
-static OpKind map_relational_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    switch (tok->type) {
-        case TOK_LT: return OP_LT;
-        case TOK_GT: return OP_GT;
-        case TOK_LT_EQ: return OP_LE;
-        case TOK_GT_EQ: return OP_GE;
-        default: return OP_NULL;
-    }
-}
-AstNode *parse_relational(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_additive, map_relational_op, "out of memory creating relational node");
-}
-
-static OpKind map_additive_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    switch (tok->type) {
-        case TOK_PLUS: return OP_ADD;
-        case TOK_MINUS: return OP_SUB;
-        default: return OP_NULL;
-    }
-}
-AstNode *parse_additive(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_multiplicative, map_additive_op, "out of memory creating additive node");
-}
-
-static OpKind map_multiplicative_op(Token *tok) {
-    if (!tok) return OP_NULL;
-    switch (tok->type) {
-        case TOK_STAR: return OP_MUL;
-        case TOK_SLASH: return OP_DIV;
-        case TOK_PERCENT: return OP_MOD;
-        default: return OP_NULL;
-    }
-}
-AstNode *parse_multiplicative(Parser *p, ParseError *err) {
-    return parse_left_assoc_binary(p, err, parse_cast, map_multiplicative_op, "out of memory creating multiplicative node");
-}
-
-AstNode *parse_cast(Parser *p, ParseError *err) {
-    AstNode *expr = parse_unary(p, err);
-    if (!expr) return NULL;
-
-    while (current_token(p) && current_token(p)->type == TOK_AS) {
-        consume(p, TOK_AS);
-        AstNode *target_type_node = parse_type(p, err);
-        if (!target_type_node) return NULL;
-
-        AstNode *cast = new_node_or_err(p, AST_CAST, err, "out of memory creating cast node");
-        if (!cast) return NULL;
-
-        cast->data.cast_expr.expr = expr;
-        cast->data.cast_expr.target_type = NULL;
-        cast->data.cast_expr.target_type_node = target_type_node;
-        cast->span = span_join(&expr->span, &target_type_node->span);
-        expr = cast;
-    }
-    return expr;
-}
+/* Entry points for a single precedence level, kept for callers that need
+ * one (each parses that level and everything tighter). */
+AstNode *parse_logical_or(Parser *p, ParseError *err)     { return parse_binary(p, err, BP_LOGICAL_OR); }
+AstNode *parse_logical_and(Parser *p, ParseError *err)    { return parse_binary(p, err, BP_LOGICAL_AND); }
+AstNode *parse_equality(Parser *p, ParseError *err)       { return parse_binary(p, err, BP_EQUALITY); }
+AstNode *parse_relational(Parser *p, ParseError *err)     { return parse_binary(p, err, BP_RELATIONAL); }
+AstNode *parse_additive(Parser *p, ParseError *err)       { return parse_binary(p, err, BP_ADDITIVE); }
+AstNode *parse_multiplicative(Parser *p, ParseError *err) { return parse_binary(p, err, BP_MULTIPLICATIVE); }
+AstNode *parse_cast(Parser *p, ParseError *err)           { return parse_binary(p, err, BP_CAST); }
 
 static OpKind map_unary_op(Token *tok) {
     if (!tok) return OP_NULL;
@@ -310,9 +169,26 @@ static OpKind map_unary_op(Token *tok) {
     }
 }
 
+/* await f(args): an intrinsic without an '@' name, the operand is checked to be a call by sema */
+static AstNode *parse_await(Parser *p, ParseError *err) {
+    Token *await_tok = consume(p, TOK_AWAIT);
+    AstNode *operand = parse_unary(p, err);
+    if (!operand) return NULL;
+
+    AstNode *intrinsic = new_node_or_err(p, AST_INTRINSIC, err, "out of memory creating await node");
+    if (!intrinsic) return NULL;
+    intrinsic->data.intrinsic.kind = INTRINSIC_AWAIT;
+    intrinsic->data.intrinsic.args = alloc_dynarray(p, err, sizeof(AstNode*), 1, "out of memory");
+    if (!intrinsic->data.intrinsic.args) return NULL;
+    dynarray_push_value(intrinsic->data.intrinsic.args, &operand);
+    intrinsic->span = span_join(tok_span(p, await_tok), operand->span);
+    return intrinsic;
+}
+
 AstNode *parse_unary(Parser *p, ParseError *err) {
     Token *token = current_token(p);
-    if (token && (token->type == TOK_PLUS || token->type == TOK_MINUS || token->type == TOK_BANG || token->type == TOK_STAR || token->type == TOK_AMP || token->type == TOK_PLUSPLUS || token->type == TOK_MINUSMINUS)) {
+    if (token && token->type == TOK_AWAIT) return parse_await(p, err);
+    if (token && map_unary_op(token) != OP_NULL) {
         Token *op_token = consume(p, token->type);
         if (!op_token) { if (err) create_parse_error(err, p, "failed to consume prefix operator", token); return NULL; }
         AstNode *operand = parse_unary(p, err);
@@ -323,7 +199,7 @@ AstNode *parse_unary(Parser *p, ParseError *err) {
 
         unary->data.unary_expr.expr = operand;
         unary->data.unary_expr.op = map_unary_op(op_token);
-        unary->span = span_join(&op_token->span, &operand->span);
+        unary->span = span_join(tok_span(p, op_token), operand->span);
         return unary;
     }
     return parse_postfix(p, err);
@@ -337,13 +213,13 @@ static AstNode *parse_postfix_generic_inst(Parser *p, AstNode *primary, ParseErr
     DynArray *type_args = alloc_dynarray(p, NULL, sizeof(AstNode*), 2, "out of memory");
     bool success = true;
 
-    AstNode *first_arg = parse_type(p, &ignored_err);
+    AstNode *first_arg = parse_generic_arg(p, &ignored_err);
     if (!first_arg) {
         success = false;
     } else {
         dynarray_push_value(type_args, &first_arg);
         while (parser_match(p, TOK_COMMA)) {
-            AstNode *next_arg = parse_type(p, &ignored_err);
+            AstNode *next_arg = parse_generic_arg(p, &ignored_err);
             if (!next_arg) { success = false; break; }
             dynarray_push_value(type_args, &next_arg);
         }
@@ -359,7 +235,7 @@ static AstNode *parse_postfix_generic_inst(Parser *p, AstNode *primary, ParseErr
             if (!inst) return NULL;
             inst->data.generic_inst_expr.base = primary;
             inst->data.generic_inst_expr.type_args = type_args;
-            inst->span = span_join(&primary->span, &rgt->span);
+            inst->span = span_join(primary->span, tok_span(p, rgt));
             return inst;
         }
     }
@@ -428,7 +304,7 @@ static AstNode *parse_postfix_struct_literal(Parser *p, AstNode *primary, ParseE
         return NULL;
     }
 
-    struct_lit->span = span_join(&primary->span, &rbrace->span);
+    struct_lit->span = span_join(primary->span, tok_span(p, rbrace));
     return struct_lit;
 }
 
@@ -436,26 +312,31 @@ AstNode *parse_postfix(Parser *p, ParseError *err) {
     AstNode *primary = parse_primary(p, err);
     if (!primary) return NULL;
 
-    Token *token = current_token(p);
-    while (token && (token->type == TOK_PLUSPLUS || token->type == TOK_MINUSMINUS || token->type == TOK_LBRACKET || token->type == TOK_LPAREN || token->type == TOK_DOT || token->type == TOK_LBRACE || token->type == TOK_LT)) {
-        if (token->type == TOK_PLUSPLUS || token->type == TOK_MINUSMINUS) {
+    for (;;) {
+        Token *token = current_token(p);
+        if (!token) return primary;
+
+        switch (token->type) {
+        case TOK_PLUSPLUS:
+        case TOK_MINUSMINUS: {
             Token *op_tok = consume(p, token->type);
             AstNode *postfix = new_node_or_err(p, AST_UNARY_EXPR, err, "out of memory creating postfix node");
             if (!postfix) return NULL;
             postfix->data.unary_expr.expr = primary;
             postfix->data.unary_expr.op = (op_tok->type == TOK_PLUSPLUS) ? OP_POST_INC : OP_POST_DEC;
-            postfix->span = span_join(&primary->span, &op_tok->span);
+            postfix->span = span_join(primary->span, tok_span(p, op_tok));
             primary = postfix;
+            break;
+        }
 
-        } else if (token->type == TOK_LT) {
+        case TOK_LT: {
             AstNode *inst = parse_postfix_generic_inst(p, primary, err);
-            if (inst) {
-                primary = inst;
-            } else {
-                break; // Not a generic instantiation, let relational ops handle it
-            }
+            if (!inst) return primary; // Not a generic instantiation, let relational ops handle it
+            primary = inst;
+            break;
+        }
 
-        } else if (token->type == TOK_LBRACKET) {
+        case TOK_LBRACKET: {
             consume(p, TOK_LBRACKET);
             AstNode *index = parse_expression(p, err);
             if (!index) return NULL;
@@ -466,10 +347,12 @@ AstNode *parse_postfix(Parser *p, ParseError *err) {
             if (!array_access) return NULL;
             array_access->data.subscript_expr.target = primary;
             array_access->data.subscript_expr.index = index;
-            array_access->span = span_join(&primary->span, &rbr->span);
+            array_access->span = span_join(primary->span, tok_span(p, rbr));
             primary = array_access;
+            break;
+        }
 
-        } else if (token->type == TOK_LPAREN) {
+        case TOK_LPAREN: {
             consume(p, TOK_LPAREN);
             AstNode *func_call = new_node_or_err(p, AST_CALL_EXPR, err, "out of memory creating function call node");
             if (!func_call) return NULL;
@@ -479,10 +362,12 @@ AstNode *parse_postfix(Parser *p, ParseError *err) {
             Token *rparen = consume(p, TOK_RPAREN);
             if (!rparen) { if (err) create_parse_error(err, p, "expected ')' after function call arguments", token); return NULL; }
             func_call->data.call_expr.callee = primary;
-            func_call->span = span_join(&primary->span, &rparen->span);
+            func_call->span = span_join(primary->span, tok_span(p, rparen));
             primary = func_call;
+            break;
+        }
 
-        } else if (token->type == TOK_DOT) {
+        case TOK_DOT: {
             consume(p, TOK_DOT);
             Token *name_tok = consume(p, TOK_IDENTIFIER);
             if (!name_tok) {
@@ -493,20 +378,22 @@ AstNode *parse_postfix(Parser *p, ParseError *err) {
             if (!member_access) return NULL;
             member_access->data.member_expr.target = primary;
             member_access->data.member_expr.member = name_tok->record;
-            member_access->span = span_join(&primary->span, &name_tok->span);
+            member_access->span = span_join(primary->span, tok_span(p, name_tok));
             primary = member_access;
+            break;
+        }
 
-        } else if (token->type == TOK_LBRACE) {
+        case TOK_LBRACE: {
             AstNode *struct_lit = parse_postfix_struct_literal(p, primary, err);
-            if (struct_lit) {
-                primary = struct_lit;
-            } else {
-                break; // Not a struct literal
-            }
+            if (!struct_lit) return primary; // Not a struct literal
+            primary = struct_lit;
+            break;
+        }
+
+        default:
+            return primary;
         }
-        token = current_token(p);
     }
-    return primary;
 }
 
 static LiteralType get_literal_type(TokenKind type) {
@@ -573,14 +460,20 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
             AstNode *intrinsic = new_node_or_err(p, AST_INTRINSIC, err, "out of memory creating intrinsic node");
             if (!intrinsic) return NULL;
             
-            if (name_tok->slice.len == 5 && memcmp(name_tok->slice.ptr, "alloc", 5) == 0) {
-                intrinsic->data.intrinsic.kind = INTRINSIC_ALLOC;
-            } else if (name_tok->slice.len == 4 && memcmp(name_tok->slice.ptr, "free", 4) == 0) {
-                intrinsic->data.intrinsic.kind = INTRINSIC_FREE;
-            } else {
+            intrinsic->data.intrinsic.kind = INTRINSIC_UNKNOWN;
+            for (IntrinsicKind kind = INTRINSIC_ALLOC; kind < INTRINSIC_UNKNOWN; kind++) {
+                const char *name = intrinsic_name(kind);
+                if (name && name_tok->len == strlen(name) && memcmp(tok_slice(p, name_tok).ptr, name, name_tok->len) == 0) {
+                    intrinsic->data.intrinsic.kind = kind;
+                    break;
+                }
+            }
+            if (intrinsic->data.intrinsic.kind == INTRINSIC_UNKNOWN) {
                 if (err) create_parse_error(err, p, "unknown compiler intrinsic", name_tok);
                 return NULL;
             }
+            IntrinsicKind kind = intrinsic->data.intrinsic.kind;
+            bool type_first = kind == INTRINSIC_ALLOC || kind == INTRINSIC_SPLAT || kind == INTRINSIC_LOAD;
             
             intrinsic->data.intrinsic.args = alloc_dynarray(p, err, sizeof(AstNode*), 4, "out of memory");
             if (!consume(p, TOK_LPAREN)) {
@@ -594,7 +487,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
                     AstNode *arg = NULL;
                     bool is_first_arg = intrinsic->data.intrinsic.args->count == 0;
                     
-                    if ((is_first_arg && intrinsic->data.intrinsic.kind == INTRINSIC_ALLOC) ||
+                    if ((is_first_arg && type_first) ||
                         (peek_tok && (peek_tok->type >= TOK_I8 && peek_tok->type <= TOK_VOID))) {
                          arg = parse_type(p, err);
                     } else {
@@ -613,10 +506,14 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
             }
             
             Token *rparen = consume(p, TOK_RPAREN);
-            intrinsic->span = span_join(&name_tok->span, &rparen->span);
+            intrinsic->span = span_join(tok_span(p, name_tok), tok_span(p, rparen));
             return intrinsic;
         }
 
+        case TOK_BAD_INT_LIT:
+            create_parse_error(err, p, "invalid integer literal or overflow", token);
+            return NULL;
+
         case TOK_INT_LIT: case TOK_FLOAT_LIT: case TOK_TRUE: case TOK_FALSE: case TOK_CHAR_LIT: case TOK_STRING_LIT: case TOK_NULL: {
             AstNode *literal = new_node_or_err(p, AST_LITERAL, err, "out of memory creating literal node");
             if (!literal) return NULL;
@@ -624,26 +521,12 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
             literal->data.literal.type = get_literal_type(token->type);
 
             switch (token->type) {
-                case TOK_INT_LIT: {
-                    unsigned long long v;
-                    if (parse_int_lit(token->slice.ptr, token->slice.len, &v)) {
-                        literal->data.literal.value.int_val = (long long)v;
-                    } else {
-                        create_parse_error(err, p, "invalid integer literal or overflow", token);
-                        return NULL;
-                    }
+                case TOK_INT_LIT:
+                    literal->data.literal.value.int_val = (long long)token->int_value;
                     break;
-                }
-                case TOK_FLOAT_LIT: {
-                    double v;
-                    if (parse_float_lit(token->slice.ptr, token->slice.len, &v)) {
-                        literal->data.literal.value.float_val = v;
-                    } else {
-                        create_parse_error(err, p, "invalid float literal or overflow", token);
-                        return NULL;
-                    }
+                case TOK_FLOAT_LIT:
+                    literal->data.literal.value.float_val = token->float_value;
                     break;
-                }
                 case TOK_TRUE:
                     literal->data.literal.value.bool_val = 1;
                     break;
@@ -651,7 +534,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
                     literal->data.literal.value.bool_val = 0;
                     break;
                 case TOK_CHAR_LIT:
-                    literal->data.literal.value.char_val = (char)(uintptr_t)token->record;
+                    literal->data.literal.value.char_val = (char)token->int_value;
                     break;
                 case TOK_STRING_LIT:
                     literal->data.literal.value.string_val = token->record;
@@ -666,7 +549,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
 
             literal->is_foldable_const = 0;
             literal->is_llvm_const_safe = 0;
-            literal->span = token->span;
+            literal->span = tok_span(p, token);
             consume(p, token->type);
             return literal;
         }
@@ -694,10 +577,10 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
                     AstNode *type_ident = new_node_or_err(p, AST_IDENTIFIER, err, "out of memory");
                     if (!type_ident) return NULL;
                     type_ident->data.identifier.intern_result = token->record;
-                    type_ident->span = token->span;
+                    type_ident->span = tok_span(p, token);
                     struct_lit->data.struct_literal.type_node = type_ident;
                     
-                    Span start_span = token->span;
+                    Span start_span = tok_span(p, token);
                     consume(p, token->type); /* consume name */
                     consume(p, TOK_LBRACE);     /* consume '{' */
 
@@ -743,7 +626,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
                         return NULL;
                     }
 
-                    struct_lit->span = span_join(&start_span, &rbrace->span);
+                    struct_lit->span = span_join(start_span, tok_span(p, rbrace));
                     return struct_lit;
                 }
             }
@@ -751,7 +634,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
             AstNode *identifier = new_node_or_err(p, AST_IDENTIFIER, err, "out of memory creating identifier node");
             if (!identifier) return NULL;
             identifier->data.identifier.intern_result = token->record;
-            identifier->span = token->span;
+            identifier->span = tok_span(p, token);
             consume(p, token->type);
             return identifier;
         }
@@ -762,7 +645,7 @@ AstNode *parse_primary(Parser *p, ParseError *err) {
             if (!expr) return NULL;
             Token *r = consume(p, TOK_RPAREN);
             if (!r) { if (err) err->use_prev_token = true; create_parse_error(err, p, "expected ')' after expression", current_token(p)); return NULL; }
-            expr->span = span_join(&lpar->span, &r->span);
+            expr->span = span_join(tok_span(p, lpar), tok_span(p, r));
             return expr;
         }
 
@@ -783,9 +666,9 @@ AstNode *parse_initializer_list(Parser *p, ParseError *err) {
         if (err) create_parse_error(err, p, "expected '{' to start initializer list", current_token(p));
         return NULL;
     }
-    Span start_span = start_tok->span;
+    Span start_span = tok_span(p, start_tok);
 
-    AstNode *init = ast_create_node(AST_INITIALIZER_LIST, p->arena, p->filename);
+    AstNode *init = ast_create_node(AST_INITIALIZER_LIST, p->arena, p->file);
     if (!init) {
         if (err) create_parse_error(err, p, "out of memory creating initializer node", NULL);
         return NULL;
@@ -805,7 +688,7 @@ AstNode *parse_initializer_list(Parser *p, ParseError *err) {
 
     if (tok->type == TOK_RBRACE) {
         Token *rbrace = consume(p, TOK_RBRACE);
-        init->span = span_join(&start_span, &rbrace->span);
+        init->span = span_join(start_span, tok_span(p, rbrace));
         return init;
     }
 
@@ -841,13 +724,13 @@ AstNode *parse_initializer_list(Parser *p, ParseError *err) {
             tok = current_token(p);
             if (tok && tok->type == TOK_RBRACE) {
                 Token *rbrace = consume(p, TOK_RBRACE);
-                init->span = span_join(&start_span, &rbrace->span);
+                init->span = span_join(start_span, tok_span(p, rbrace));
                 return init;
             }
             continue;
         } else if (tok->type == TOK_RBRACE) {
             Token *rbrace = consume(p, TOK_RBRACE);
-            init->span = span_join(&start_span, &rbrace->span);
+            init->span = span_join(start_span, tok_span(p, rbrace));
             return init;
         } else {
             err->use_prev_token = true;
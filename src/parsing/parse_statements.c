@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 static bool parse_block_statements(Parser *p, AstNode *block, ParseError *err, Span *start_span) {
     while (1) {
@@ -23,7 +24,7 @@ static bool parse_block_statements(Parser *p, AstNode *block, ParseError *err, S
 
         if (current->type == TOK_RBRACE) {
             Token *rbrace = consume(p, TOK_RBRACE);
-            block->span = span_join(start_span, &rbrace->span);
+            block->span = span_join(*start_span, tok_span(p, rbrace));
             return true;
         }
 
@@ -38,7 +39,7 @@ static bool parse_block_statements(Parser *p, AstNode *block, ParseError *err, S
 }
 
 AstNode *parse_block(Parser *p, ParseError *err) {
-    AstNode *block = ast_create_node(AST_BLOCK, p->arena, p->filename);
+    AstNode *block = ast_create_node(AST_BLOCK, p->arena, p->file);
     if (!block) {
         if (err) create_parse_error(err, p, "out of memory creating block node", NULL);
         return NULL;
@@ -56,7 +57,7 @@ AstNode *parse_block(Parser *p, ParseError *err) {
         create_parse_error(err, p, "expected '{' at start of block", current_token(p));
         return NULL;
     }
-    Span start_span = lbrace->span;
+    Span start_span = tok_span(p, lbrace);
 
     if (!parse_block_statements(p, block, err, &start_span)) return NULL;
 
@@ -69,7 +70,7 @@ AstNode *parse_defer_statement(Parser *p, ParseError *err) {
         if (err) create_parse_error(err, p, "expected 'defer' keyword", current_token(p));
         return NULL;
     }
-    Span start_span = defer_tok->span;
+    Span start_span = tok_span(p, defer_tok);
 
     AstNode *defer_stmt = new_node_or_err(p, AST_DEFER_STATEMENT, err, "out of memory creating defer statement node");
     if (!defer_stmt) return NULL;
@@ -84,10 +85,90 @@ AstNode *parse_defer_statement(Parser *p, ParseError *err) {
     if (!body) return NULL;
 
     defer_stmt->data.defer_statement.body = body;
-    defer_stmt->span = span_join(&start_span, &body->span);
+    defer_stmt->span = span_join(start_span, body->span);
     return defer_stmt;
 }
 
+static bool slice_is(Slice s, const char *text) {
+    return s.len == strlen(text) && memcmp(s.ptr, text, s.len) == 0;
+}
+
+/* '@' followed by one of the loop attributes; any other '@' starts an intrinsic call */
+static bool starts_loop_hint(Parser *p) {
+    Token *name = peek(p, 1);
+    if (!name || name->type != TOK_IDENTIFIER) return false;
+    Slice s = tok_slice(p, name);
+    return slice_is(s, "unroll") || slice_is(s, "nounroll") || slice_is(s, "vectorize");
+}
+
+/* '(' <Int> ')' after @unroll or @vectorize: a count between 1 and LOOP_HINT_MAX */
+static bool parse_loop_hint_count(Parser *p, ParseError *err, Token *attr_name, uint32_t *out) {
+    if (*out) {
+        if (err) create_parse_error(err, p, "duplicate loop attribute", attr_name);
+        return false;
+    }
+    if (!consume(p, TOK_LPAREN)) {
+        if (err) create_parse_error(err, p, "expected '(' after loop attribute", current_token(p));
+        return false;
+    }
+    Token *value = consume(p, TOK_INT_LIT);
+    if (!value) {
+        if (err) create_parse_error(err, p, "expected integer literal in loop attribute", current_token(p));
+        return false;
+    }
+    if (value->int_value == 0 || value->int_value > LOOP_HINT_MAX) {
+        if (err) create_parse_error(err, p, "loop attribute expects a count between 1 and 1024", value);
+        return false;
+    }
+    *out = (uint32_t)value->int_value;
+    if (!consume(p, TOK_RPAREN)) {
+        if (err) create_parse_error(err, p, "expected ')' after loop attribute", current_token(p));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * { '@' ( 'unroll' '(' <Int> ')' | 'nounroll' | 'vectorize' '(' <Int> ')' ) } ( <While> | <For> )
+ */
+static AstNode *parse_annotated_loop(Parser *p, ParseError *err) {
+    Span start_span = tok_span(p, current_token(p));
+    LoopHints hints = {0};
+    while (current_token(p) && current_token(p)->type == TOK_AT && starts_loop_hint(p)) {
+        consume(p, TOK_AT);
+        Token *attr_name = consume(p, TOK_IDENTIFIER);
+        Slice name = tok_slice(p, attr_name);
+        if (slice_is(name, "nounroll")) {
+            if (hints.nounroll) {
+                if (err) create_parse_error(err, p, "duplicate loop attribute", attr_name);
+                return NULL;
+            }
+            hints.nounroll = true;
+        } else if (!parse_loop_hint_count(p, err, attr_name, slice_is(name, "unroll") ? &hints.unroll : &hints.vectorize)) {
+            return NULL;
+        }
+        if (hints.nounroll && hints.unroll) {
+            if (err) create_parse_error(err, p, "@unroll and @nounroll are exclusive", attr_name);
+            return NULL;
+        }
+    }
+
+    Token *tok = current_token(p);
+    AstNode *loop = NULL;
+    if (tok && tok->type == TOK_WHILE) {
+        loop = parse_while_statement(p, err);
+        if (loop) loop->data.while_statement.hints = hints;
+    } else if (tok && tok->type == TOK_FOR) {
+        loop = parse_for_statement(p, err);
+        if (loop) loop->data.for_statement.hints = hints;
+    } else {
+        if (err) create_parse_error(err, p, "loop attributes must precede 'for' or 'while'", tok);
+        return NULL;
+    }
+    if (loop) loop->span = span_join(start_span, loop->span);
+    return loop;
+}
+
 AstNode *parse_statement(Parser *p, ParseError *err) {
     Token *tok = current_token(p);
     if (!tok) {
@@ -99,15 +180,19 @@ AstNode *parse_statement(Parser *p, ParseError *err) {
         case TOK_IF:       return parse_if_statement(p, err);
         case TOK_WHILE:    return parse_while_statement(p, err);
         case TOK_FOR:      return parse_for_statement(p, err);
+        case TOK_SWITCH:   return parse_switch_statement(p, err);
         case TOK_RETURN:   return parse_return_statement(p, err);
         case TOK_BREAK:    return parse_break_statement(p, err);
         case TOK_CONTINUE: return parse_continue_statement(p, err);
         case TOK_DEFER:    return parse_defer_statement(p, err);
         case TOK_LBRACE:   return parse_block(p, err);
+        case TOK_ASYNC:
         case TOK_FN:
             if (err) create_parse_error(err, p, "function declarations are not allowed inside statements or blocks", tok);
             return NULL;
         case TOK_CONST:    return parse_declaration_stmt(p, err);
+        case TOK_AT:
+            return starts_loop_hint(p) ? parse_annotated_loop(p, err) : parse_expression_statement(p, err);
         case TOK_IDENTIFIER: {
             Token *next = peek(p, 1);
             if (!next) {
@@ -126,9 +211,9 @@ AstNode *parse_if_statement(Parser *p, ParseError *err) {
         if (err) create_parse_error(err, p, "expected 'if' keyword", current_token(p));
         return NULL;
     }
-    Span start_span = if_tok->span;
+    Span start_span = tok_span(p, if_tok);
 
-    AstNode *if_stmt = ast_create_node(AST_IF_STATEMENT, p->arena, p->filename);
+    AstNode *if_stmt = ast_create_node(AST_IF_STATEMENT, p->arena, p->file);
     if (!if_stmt) {
         if (err) create_parse_error(err, p, "out of memory creating if statement node", current_token(p));
         return NULL;
@@ -157,7 +242,7 @@ AstNode *parse_if_statement(Parser *p, ParseError *err) {
         end_span = else_branch->span;
     }
 
-    if_stmt->span = span_join(&start_span, &end_span);
+    if_stmt->span = span_join(start_span, end_span);
     return if_stmt;
 }
 
@@ -174,15 +259,158 @@ AstNode *parse_while_statement(Parser *p, ParseError *err) {
     while_stmt->data.while_statement.body = parse_block(p, err);
     if (!while_stmt->data.while_statement.body) return NULL;
 
-    while_stmt->span = span_join(&while_tok->span, &while_stmt->data.while_statement.body->span);
+    while_stmt->span = span_join(tok_span(p, while_tok), while_stmt->data.while_statement.body->span);
     return while_stmt;
 }
 
+/* The statements of one switch arm, up to the next 'case', 'else' or '}', as a block */
+static AstNode *parse_switch_arm(Parser *p, ParseError *err, Token *colon) {
+    AstNode *body = new_node_or_err(p, AST_BLOCK, err, "out of memory creating switch arm");
+    if (!body) return NULL;
+    body->data.block.statements = arena_alloc(p->arena, sizeof(DynArray));
+    if (!body->data.block.statements) {
+        if (err) create_parse_error(err, p, "out of memory creating switch arm statements", NULL);
+        return NULL;
+    }
+    dynarray_init_in_arena(body->data.block.statements, p->arena, sizeof(AstNode*), 4);
+
+    body->span = tok_span(p, colon);
+    while (1) {
+        Token *current = current_token(p);
+        if (!current || current->type == TOK_EOF) {
+            if (err) {
+                err->use_prev_token = true;
+                create_parse_error(err, p, "unexpected end of input in switch, expected '}'", current);
+            }
+            return NULL;
+        }
+        if (current->type == TOK_CASE || current->type == TOK_ELSE || current->type == TOK_RBRACE) return body;
+
+        AstNode *stmt = parse_statement(p, err);
+        if (!stmt) return NULL;
+        if (dynarray_push_value(body->data.block.statements, &stmt) != 0) {
+            if (err) create_parse_error(err, p, "out of memory adding statement to switch arm", NULL);
+            return NULL;
+        }
+        body->span = span_join(body->span, stmt->span);
+    }
+}
+
+/* 'switch' <Expression> '{' { 'case' <Expression> { ',' <Expression> } ':' <Statements> } [ 'else' ':' <Statements> ] '}' */
+AstNode *parse_switch_statement(Parser *p, ParseError *err) {
+    Token *switch_tok = consume(p, TOK_SWITCH);
+    if (!switch_tok) { if (err) create_parse_error(err, p, "expected 'switch' keyword", current_token(p)); return NULL; }
+
+    AstNode *sw = new_node_or_err(p, AST_SWITCH_STATEMENT, err, "out of memory creating switch statement node");
+    if (!sw) return NULL;
+    sw->data.switch_statement.cases = arena_alloc(p->arena, sizeof(DynArray));
+    if (!sw->data.switch_statement.cases) {
+        if (err) create_parse_error(err, p, "out of memory creating switch cases array", NULL);
+        return NULL;
+    }
+    dynarray_init_in_arena(sw->data.switch_statement.cases, p->arena, sizeof(AstNode*), 4);
+
+    sw->data.switch_statement.subject = parse_expression(p, err);
+    if (!sw->data.switch_statement.subject) return NULL;
+
+    if (!consume(p, TOK_LBRACE)) {
+        if (err) create_parse_error(err, p, "expected '{' after switch subject", current_token(p));
+        return NULL;
+    }
+
+    while (1) {
+        Token *tok = current_token(p);
+        if (tok && tok->type == TOK_RBRACE) {
+            sw->span = span_join(tok_span(p, switch_tok), tok_span(p, consume(p, TOK_RBRACE)));
+            return sw;
+        }
+        if (tok && tok->type == TOK_ELSE) {
+            if (sw->data.switch_statement.else_body) {
+                if (err) create_parse_error(err, p, "switch has more than one 'else' arm", tok);
+                return NULL;
+            }
+            consume(p, TOK_ELSE);
+            Token *colon = consume(p, TOK_COLON);
+            if (!colon) {
+                if (err) create_parse_error(err, p, "expected ':' after 'else'", current_token(p));
+                return NULL;
+            }
+            sw->data.switch_statement.else_body = parse_switch_arm(p, err, colon);
+            if (!sw->data.switch_statement.else_body) return NULL;
+            continue;
+        }
+        if (!tok || tok->type != TOK_CASE) {
+            if (err) create_parse_error(err, p, "expected 'case', 'else' or '}' in switch", tok);
+            return NULL;
+        }
+        if (sw->data.switch_statement.else_body) {
+            if (err) create_parse_error(err, p, "'else' must be the last arm of a switch", tok);
+            return NULL;
+        }
+
+        Token *case_tok = consume(p, TOK_CASE);
+        AstNode *arm = new_node_or_err(p, AST_SWITCH_CASE, err, "out of memory creating switch case node");
+        if (!arm) return NULL;
+        arm->data.switch_case.values = arena_alloc(p->arena, sizeof(DynArray));
+        if (!arm->data.switch_case.values) {
+            if (err) create_parse_error(err, p, "out of memory creating case values array", NULL);
+            return NULL;
+        }
+        dynarray_init_in_arena(arm->data.switch_case.values, p->arena, sizeof(AstNode*), 2);
+        do {
+            AstNode *value = parse_expression(p, err);
+            if (!value) return NULL;
+            if (dynarray_push_value(arm->data.switch_case.values, &value) != 0) {
+                if (err) create_parse_error(err, p, "out of memory adding case value", NULL);
+                return NULL;
+            }
+        } while (consume(p, TOK_COMMA));
+
+        Token *colon = consume(p, TOK_COLON);
+        if (!colon) {
+            if (err) create_parse_error(err, p, "expected ':' after case values", current_token(p));
+            return NULL;
+        }
+        arm->data.switch_case.body = parse_switch_arm(p, err, colon);
+        if (!arm->data.switch_case.body) return NULL;
+        arm->span = span_join(tok_span(p, case_tok), arm->data.switch_case.body->span);
+        if (dynarray_push_value(sw->data.switch_statement.cases, &arm) != 0) {
+            if (err) create_parse_error(err, p, "out of memory adding switch case", NULL);
+            return NULL;
+        }
+    }
+}
+
+/* <Identifier> 'in' <Expression> ')' <Block>, after 'for' '(' */
+static AstNode *parse_range_for(Parser *p, ParseError *err, AstNode *for_node, Token *for_tok) {
+    AstNode *var = new_node_or_err(p, AST_VARIABLE_DECLARATION, err, "out of memory creating loop variable node");
+    if (!var) return NULL;
+    Token *name_tok = consume(p, TOK_IDENTIFIER);
+    var->data.variable_declaration.intern_result = name_tok->record;
+    var->span = tok_span(p, name_tok);
+    consume(p, TOK_IDENTIFIER); // in
+    for_node->data.for_statement.init = var;
+
+    for_node->data.for_statement.range = parse_expression(p, err);
+    if (!for_node->data.for_statement.range) return NULL;
+
+    if (!consume(p, TOK_RPAREN)) {
+        if (err) create_parse_error(err, p, "expected ')' after for range", current_token(p));
+        return NULL;
+    }
+
+    for_node->data.for_statement.body = parse_block(p, err);
+    if (!for_node->data.for_statement.body) return NULL;
+
+    for_node->span = span_join(tok_span(p, for_tok), for_node->data.for_statement.body->span);
+    return for_node;
+}
+
 AstNode *parse_for_statement(Parser *p, ParseError *err) {
     Token *for_tok = consume(p, TOK_FOR);
     if (!for_tok) { if (err) create_parse_error(err, p, "expected 'for' keyword", current_token(p)); return NULL; }
 
-    AstNode *for_node = ast_create_node(AST_FOR_STATEMENT, p->arena, p->filename);
+    AstNode *for_node = ast_create_node(AST_FOR_STATEMENT, p->arena, p->file);
     if (!for_node) return NULL;
 
     if (!consume(p, TOK_LPAREN)) {
@@ -190,6 +418,14 @@ AstNode *parse_for_statement(Parser *p, ParseError *err) {
         return NULL;
     }
 
+    // for (x in range): `in` is only a keyword here, between the loop variable and the range
+    Token *var_tok = current_token(p);
+    Token *in_tok = peek(p, 1);
+    if (var_tok && var_tok->type == TOK_IDENTIFIER && in_tok && in_tok->type == TOK_IDENTIFIER &&
+        slice_is(tok_slice(p, in_tok), "in")) {
+        return parse_range_for(p, err, for_node, for_tok);
+    }
+
     if (current_token(p)->type != TOK_SEMICOLON) {
         AstNode *init = parse_statement(p, err); 
         if (!init) return NULL;
@@ -218,7 +454,7 @@ AstNode *parse_for_statement(Parser *p, ParseError *err) {
     for_node->data.for_statement.body = parse_block(p, err);
     if (!for_node->data.for_statement.body) return NULL;
 
-    for_node->span = span_join(&for_tok->span, &for_node->data.for_statement.body->span);
+    for_node->span = span_join(tok_span(p, for_tok), for_node->data.for_statement.body->span);
     return for_node;
 }
 
@@ -232,16 +468,16 @@ AstNode *parse_return_statement(Parser *p, ParseError *err) {
     Token *semi = current_token(p);
     if (semi && semi->type == TOK_SEMICOLON) {
         return_stmt->data.return_statement.expression = NULL;
-        return_stmt->span = return_tok->span;
+        return_stmt->span = tok_span(p, return_tok);
     } else {
         return_stmt->data.return_statement.expression = parse_expression(p, err);
         if (!return_stmt->data.return_statement.expression) return NULL;
-        return_stmt->span = span_join(&return_tok->span, &return_stmt->data.return_statement.expression->span);
+        return_stmt->span = span_join(tok_span(p, return_tok), return_stmt->data.return_statement.expression->span);
     }
 
     semi = consume(p, TOK_SEMICOLON);
     if (!semi) { if (err) create_parse_error(err, p, "expected ';' after return statement", current_token(p)); return NULL; }
-    return_stmt->span = span_join(&return_stmt->span, &semi->span);
+    return_stmt->span = span_join(return_stmt->span, tok_span(p, semi));
 
     return return_stmt;
 }
@@ -255,7 +491,7 @@ AstNode *parse_break_statement(Parser *p, ParseError *err) {
 
     Token *semi = consume(p, TOK_SEMICOLON);
     if (!semi) { if (err) create_parse_error(err, p, "expected ';' after break statement", current_token(p)); return NULL; }
-    break_stmt->span = span_join(&break_tok->span, &semi->span);
+    break_stmt->span = span_join(tok_span(p, break_tok), tok_span(p, semi));
     return break_stmt;
 }
 
@@ -268,7 +504,7 @@ AstNode *parse_continue_statement(Parser *p, ParseError *err) {
 
     Token *semi = consume(p, TOK_SEMICOLON);
     if (!semi) { if (err) create_parse_error(err, p, "expected ';' after continue statement", current_token(p)); return NULL; }
-    cont_stmt->span = span_join(&cont_tok->span, &semi->span);
+    cont_stmt->span = span_join(tok_span(p, cont_tok), tok_span(p, semi));
     return cont_stmt;
 }
 
@@ -285,13 +521,13 @@ AstNode *parse_expression_statement(Parser *p, ParseError *err) {
         return NULL;
     }
     
-    AstNode *stmt = ast_create_node(AST_EXPR_STATEMENT, p->arena, p->filename);
+    AstNode *stmt = ast_create_node(AST_EXPR_STATEMENT, p->arena, p->file);
     if (!stmt) {
         if (err) create_parse_error(err, p, "out of memory creating expression statement node", NULL);
         return NULL;
     }
     
     stmt->data.expr_statement.expression = expr;
-    stmt->span = span_join(&expr->span, &semi->span);
+    stmt->span = span_join(expr->span, tok_span(p, semi));
     return stmt;
 }
@@ -17,7 +17,7 @@ static AstNode *parse_path(Parser *p, ParseError *err) {
     AstNode *primary = new_node_or_err(p, AST_IDENTIFIER, err, "out of memory");
     if (!primary) return NULL;
     primary->data.identifier.intern_result = tok->record;
-    primary->span = tok->span;
+    primary->span = tok_span(p, tok);
     consume(p, TOK_IDENTIFIER);
 
     while (current_token(p) && current_token(p)->type == TOK_DOT) {
@@ -33,12 +33,57 @@ static AstNode *parse_path(Parser *p, ParseError *err) {
 
         member_access->data.member_expr.target = primary;
         member_access->data.member_expr.member = name_tok->record;
-        member_access->span = span_join(&primary->span, &name_tok->span);
+        member_access->span = span_join(primary->span, tok_span(p, name_tok));
         primary = member_access;
     }
     return primary;
 }
 
+/* `vec` is a contextual keyword: only a bare `vec<` starts a vector type. */
+static bool is_vector_keyword(AstNode *base) {
+    if (base->data.ast_type.kind != AST_TYPE_PRIMITIVE || base->data.ast_type.u.base.path) return false;
+    InternResult *name = base->data.ast_type.u.base.intern_result;
+    if (!name) return false;
+    Slice *key = (Slice*)name->key;
+    return key->len == 3 && memcmp(key->ptr, "vec", 3) == 0;
+}
+
+/* <VectorType> ::= 'vec' LT <Type> COMMA <AdditiveExpr> GT */
+static AstNode *parse_vector_type(Parser *p, AstNode *keyword, ParseError *err) {
+    consume(p, TOK_LT);
+    AstNode *elem = parse_type(p, err);
+    if (!elem) return NULL;
+    if (!consume(p, TOK_COMMA)) { if (err) create_parse_error(err, p, "expected ',' after vector element type", current_token(p)); return NULL; }
+
+    // Stop below relational operators so the closing '>' is left alone
+    AstNode *lanes = parse_additive(p, err);
+    if (!lanes) return NULL;
+
+    Token *rgt = consume(p, TOK_GT);
+    if (!rgt) { if (err) create_parse_error(err, p, "expected '>' after vector lane count", current_token(p)); return NULL; }
+
+    AstNode *vec_type = new_node_or_err(p, AST_TYPE, err, "out of memory");
+    if (!vec_type) return NULL;
+    vec_type->data.ast_type.kind = AST_TYPE_VECTOR;
+    vec_type->data.ast_type.u.array.elem = elem;
+    vec_type->data.ast_type.u.array.size_expr = lanes;
+    vec_type->span = span_join(keyword->span, tok_span(p, rgt));
+    vec_type->data.ast_type.span = vec_type->span;
+    return vec_type;
+}
+
+/* <GenericArg> ::= <Type> | <AdditiveExpr>
+ * An integer literal, possibly negated, is a const argument; a name is left
+ * to sema, which knows whether it is a type or a constant. */
+AstNode *parse_generic_arg(Parser *p, ParseError *err) {
+    Token *tok = current_token(p);
+    if (tok && (tok->type == TOK_INT_LIT || tok->type == TOK_MINUS)) {
+        // Stop below relational operators so the closing '>' is left alone
+        return parse_additive(p, err);
+    }
+    return parse_type(p, err);
+}
+
 /* <Type> ::= { <PointerPrefix> } <TypeAtom> { <ArraySuffix> } { <PointerSuffix> } */
 AstNode *parse_type(Parser *p, ParseError *err) {
     if (!p) return NULL;
@@ -59,6 +104,12 @@ AstNode *parse_type(Parser *p, ParseError *err) {
 
     token = current_token(p);
 
+    if (token && token->type == TOK_LT && is_vector_keyword(base)) {
+        base = parse_vector_type(p, base, err);
+        if (!base) return NULL;
+        token = current_token(p);
+    }
+
     /* Handle generic type arguments: Vec<i32, bool> */
     if (token && token->type == TOK_LT) {
         consume(p, TOK_LT);
@@ -66,7 +117,7 @@ AstNode *parse_type(Parser *p, ParseError *err) {
         if (!type_args) return NULL;
 
         do {
-            AstNode *arg = parse_type(p, err);
+            AstNode *arg = parse_generic_arg(p, err);
             if (!arg) return NULL;
             dynarray_push_value(type_args, &arg);
             if (current_token(p) && current_token(p)->type == TOK_GT) break;
@@ -80,7 +131,7 @@ AstNode *parse_type(Parser *p, ParseError *err) {
         app_type->data.ast_type.kind = AST_TYPE_APPLICATION;
         app_type->data.ast_type.u.application.base = base;
         app_type->data.ast_type.u.application.args = type_args;
-        app_type->span = span_join(&base->span, &rgt->span);
+        app_type->span = span_join(base->span, tok_span(p, rgt));
         app_type->data.ast_type.span = app_type->span;
 
         base = app_type;
@@ -115,7 +166,7 @@ AstNode *parse_type(Parser *p, ParseError *err) {
         array_type->data.ast_type.u.array.size_expr = size_expr;
         array_type->data.ast_type.u.array.elem = NULL; // Set later
         // Temporary span covering just the brackets/size
-        array_type->span = span_join(&lbr->span, &rbr->span); 
+        array_type->span = span_join(tok_span(p, lbr), tok_span(p, rbr)); 
         array_type->data.ast_type.span = array_type->span;
 
         if (dynarray_push_value(dims, &array_type) != 0) {
@@ -127,10 +178,10 @@ AstNode *parse_type(Parser *p, ParseError *err) {
 
     /* Apply dimensions Backwards (Right-to-Left) */
     for (size_t i = dims->count; i > 0; i--) {
-        AstNode *dim_node = *(AstNode**)dynarray_get(dims, (int)i - 1);
+        AstNode *dim_node = DYNARRAY_AT(AstNode*, dims, (int)i - 1);
         dim_node->data.ast_type.u.array.elem = base;
         // Extend span to cover the base it wraps
-        dim_node->span = span_join(&base->span, &dim_node->span);
+        dim_node->span = span_join(base->span, dim_node->span);
         dim_node->data.ast_type.span = dim_node->span;
         base = dim_node;
     }
@@ -146,7 +197,7 @@ AstNode *parse_type(Parser *p, ParseError *err) {
         if (!ptr_type) return NULL;
         ptr_type->data.ast_type.kind = AST_TYPE_PTR;
         ptr_type->data.ast_type.u.ptr.target = base;
-        ptr_type->data.ast_type.span = span_join(&base->span, &star->span);
+        ptr_type->data.ast_type.span = span_join(base->span, tok_span(p, star));
         ptr_type->span = ptr_type->data.ast_type.span;
         base = ptr_type;
         token = current_token(p);
@@ -160,7 +211,7 @@ AstNode *parse_type(Parser *p, ParseError *err) {
 
         ptr_type->data.ast_type.kind = AST_TYPE_PTR;
         ptr_type->data.ast_type.u.ptr.target = base;
-        ptr_type->data.ast_type.span = span_join(&star->span, &base->span);
+        ptr_type->data.ast_type.span = span_join(tok_span(p, star), base->span);
         ptr_type->span = ptr_type->data.ast_type.span;
 
         base = ptr_type;
@@ -182,7 +233,7 @@ AstNode *parse_type_atom(Parser *p, ParseError *err) {
         if (!inner) return NULL;
         Token *rparen = consume(p, TOK_RPAREN);
         if (!rparen) { if (err) create_parse_error(err, p, "expected ')' after type", current_token(p)); return NULL; }
-        inner->span = span_join(&lpar->span, &rparen->span);
+        inner->span = span_join(tok_span(p, lpar), tok_span(p, rparen));
         inner->data.ast_type.span = inner->span;
         return inner;
     }
@@ -202,8 +253,8 @@ AstNode *parse_type_atom(Parser *p, ParseError *err) {
         if (tok->type >= TOK_I8 && tok->type <= TOK_VOID) {
             type_node->data.ast_type.u.base.intern_result = tok->record;
             type_node->data.ast_type.u.base.path = NULL;
-            type_node->data.ast_type.span = tok->span;
-            type_node->span = tok->span;
+            type_node->data.ast_type.span = tok_span(p, tok);
+            type_node->span = tok_span(p, tok);
             consume(p, tok->type);
         } else {
             AstNode *primary = parse_path(p, err);
@@ -256,7 +307,7 @@ AstNode *parse_function_type(Parser *p, ParseError *err) {
     if (!type_node) return NULL;
 
     type_node->data.ast_type.kind = AST_TYPE_FUNC;
-    type_node->data.ast_type.span = fn_tok->span;
+    type_node->data.ast_type.span = tok_span(p, fn_tok);
 
     Token *lparen = consume(p, TOK_LPAREN);
     if (!lparen) { if (err) create_parse_error(err, p, "expected '(' after 'fn type'", current_token(p)); return NULL; }
@@ -265,7 +316,7 @@ AstNode *parse_function_type(Parser *p, ParseError *err) {
     if (maybe && maybe->type == TOK_RPAREN) {
         Token *r = consume(p, TOK_RPAREN);
         type_node->data.ast_type.u.func.param_types = NULL;
-        type_node->data.ast_type.span = span_join(&type_node->data.ast_type.span, &r->span);
+        type_node->data.ast_type.span = span_join(type_node->data.ast_type.span, tok_span(p, r));
     } else {
         DynArray *params = alloc_dynarray(p, err, sizeof(AstNode*), 4, "out of memory creating param types array");
         if (!params) return NULL;
@@ -287,7 +338,7 @@ AstNode *parse_function_type(Parser *p, ParseError *err) {
         if (!rparen) { if (err) create_parse_error(err, p, "expected ')' after function parameter types", current_token(p)); return NULL; }
 
         type_node->data.ast_type.u.func.param_types = params;
-        type_node->data.ast_type.span = span_join(&type_node->data.ast_type.span, &rparen->span);
+        type_node->data.ast_type.span = span_join(type_node->data.ast_type.span, tok_span(p, rparen));
     }
 
     /* optional return type */
@@ -297,7 +348,7 @@ AstNode *parse_function_type(Parser *p, ParseError *err) {
         AstNode *ret = parse_type(p, err);
         if (!ret) return NULL;
         type_node->data.ast_type.u.func.return_type = ret;
-        type_node->data.ast_type.span = span_join(&type_node->data.ast_type.span, &ret->span);
+        type_node->data.ast_type.span = span_join(type_node->data.ast_type.span, ret->span);
     } else {
         /* already ensured closing paren covered span above */
         type_node->data.ast_type.u.func.return_type = NULL;
@@ -1,52 +1,112 @@
 #include "parser.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include "lexer.h"
 #include "colors.h"
-#include "file.h"
+#include "core/source_map.h"
+#include "core/mem_report.h"
 
-Parser *parser_create(DynArray *tokens, char *filename, Arena *arena) {
-    if (!arena) return NULL;
+Parser *parser_create(Lexer *lexer, char *filename, Arena *arena) {
+    if (!arena || !lexer || !lexer->tokens) return NULL;
     Parser *p = arena_alloc(arena, sizeof(Parser));
     if (!p) return NULL;
-    p->tokens = tokens;
-    p->current = 0;
-    p->end = tokens->count;
+    memset(p, 0, sizeof(*p));
+    p->flat = (Token*)lexer->tokens->data;
+    p->end = lexer->tokens->count;
+    p->lexed = lexer->tokens->count;
+    p->source = lexer->source;
+    p->file = lexer->file;
     p->arena = arena;
+    p->token_arena = arena;
+    p->filename = filename;
+    return p;
+}
+
+Parser *parser_create_streaming(Lexer *lexer, char *filename, Arena *arena) {
+    if (!arena || !lexer) return NULL;
+    Parser *p = arena_alloc(arena, sizeof(Parser));
+    if (!p) return NULL;
+    memset(p, 0, sizeof(*p));
+    p->lexer = lexer;
+    p->end = SIZE_MAX;
+    p->source = lexer->source;
+    p->file = lexer->file;
+    p->arena = arena;
+    p->token_arena = lexer->arena;
     p->filename = filename;
     return p;
 }
 
 void parser_free(Parser *parser) { (void)parser; }
 
-Token *current_token(Parser *p) {
-    if (!p || p->current >= p->end) return NULL;
-    return (Token*)dynarray_get(p->tokens, p->current);
+static TokenChunk *chunk_acquire(Parser *p) {
+    TokenChunk *c = p->free_chunks;
+    if (c) {
+        p->free_chunks = c->next_free;
+        return c;
+    }
+    MEM_ACCOUNT(MEM_TOKENS, MEM_KIND_NONE, p->lexer->file, sizeof(TokenChunk), 0);
+    return arena_alloc(p->token_arena, sizeof(TokenChunk));
 }
 
-Token *peek(Parser *p, size_t offset) {
-    if (!p) return NULL;
-    size_t index = p->current + offset;
-    if (index >= p->end) return NULL;
-    return (Token*)dynarray_get(p->tokens, index);
+/* Append an empty chunk to the window */
+static bool window_grow(Parser *p) {
+    if (p->window_len == p->window_cap) {
+        size_t cap = p->window_cap ? p->window_cap * 2 : 8;
+        TokenChunk **window = arena_alloc(p->token_arena, cap * sizeof(TokenChunk*));
+        if (!window) return false;
+        MEM_ACCOUNT(MEM_TOKENS, MEM_KIND_NONE, p->lexer->file, cap * sizeof(TokenChunk*), 0);
+        if (p->window_len) memcpy(window, p->window, p->window_len * sizeof(TokenChunk*));
+        p->window = window;
+        p->window_cap = cap;
+    }
+    TokenChunk *c = chunk_acquire(p);
+    if (!c) return false;
+    p->window[p->window_len++] = c;
+    return true;
 }
 
-Token *parser_advance(Parser *p) {
-    if (!p || p->current >= p->end) return NULL;
-    return (Token*)dynarray_get(p->tokens, p->current++);
+/* Lex until token `index` exists, a chunk at a time (so lexer_next_token
+   runs in a tight loop); false past EOF or out of memory */
+static bool stream_fill(Parser *p, size_t index) {
+    while (p->lexed <= index) {
+        if (p->lexed >= p->end) return false;
+        size_t slot = p->lexed - p->window_base;
+        if ((slot >> TOKEN_CHUNK_SHIFT) == p->window_len && !window_grow(p)) {
+            p->stream_failed = 1;
+            p->end = p->lexed;
+            return false;
+        }
+        Token *dst = &p->window[slot >> TOKEN_CHUNK_SHIFT]->tokens[slot & TOKEN_CHUNK_MASK];
+        size_t n = lexer_next_tokens(p->lexer, dst, TOKEN_CHUNK_SIZE - (slot & TOKEN_CHUNK_MASK));
+        p->lexed += n;
+        MEM_ACCOUNT(MEM_TOKENS, MEM_KIND_NONE, p->lexer->file, 0, n);
+        if (dst[n - 1].type == TOK_EOF) p->end = p->lexed;
+    }
+    return true;
 }
 
-Token *consume(Parser *p, TokenKind expected) {
-    Token *tok = current_token(p);
-    if (!tok || tok->type != expected) return NULL;
-    p->current++;
-    return tok;
+Token *parser_token_fetch(Parser *p, size_t index) {
+    if (!p->lexer || index >= p->end || index < p->window_base) return NULL;
+    if (!stream_fill(p, index)) return NULL;
+    size_t slot = index - p->window_base;
+    return &p->window[slot >> TOKEN_CHUNK_SHIFT]->tokens[slot & TOKEN_CHUNK_MASK];
 }
 
-int parser_match(Parser *p, TokenKind expected) {
-    Token *tok = current_token(p);
-    if (!tok || tok->type != expected) return 0;
-    p->current++;
-    return 1;
+void parser_release_consumed(Parser *p) {
+    if (!p || !p->lexer || p->window_len == 0) return;
+    /* Keep the previous token: errors reported "after" it point there */
+    size_t keep = p->current ? p->current - 1 : 0;
+    size_t drop = (keep - p->window_base) >> TOKEN_CHUNK_SHIFT;
+    if (drop == 0) return;
+    for (size_t i = 0; i < drop; i++) {
+        p->window[i]->next_free = p->free_chunks;
+        p->free_chunks = p->window[i];
+    }
+    p->window_len -= drop;
+    memmove(p->window, p->window + drop, p->window_len * sizeof(TokenChunk*));
+    p->window_base += drop * TOKEN_CHUNK_SIZE;
 }
 
 void create_parse_error(ParseError *err_out, Parser *p, const char *message, Token *token) {
@@ -58,7 +118,7 @@ void create_parse_error(ParseError *err_out, Parser *p, const char *message, Tok
 }
 
 AstNode *new_node_or_err(Parser *p, AstNodeType kind, ParseError *err, const char *oom_msg) {
-    AstNode *n = ast_create_node(kind, p->arena, p->filename);
+    AstNode *n = ast_create_node(kind, p->arena, p->file);
     if (!n && err) create_parse_error(err, p, oom_msg, NULL);
     return n;
 }
@@ -73,22 +133,38 @@ DynArray *alloc_dynarray(Parser *p, ParseError *err, size_t elem_size, int initi
     return arr;
 }
 
+bool parser_defer_bodies(Parser *p, const Lexer *lexer, bool all) {
+    if (!p || !lexer) return false;
+    LazyBodySource *src = arena_alloc(p->arena, sizeof(LazyBodySource));
+    if (!src) return false;
+    src->source = lexer->source;
+    src->len = lexer->source_len;
+    src->file = lexer->file;
+    src->filename = p->filename;
+    src->keywords = lexer->keywords;
+    src->identifiers = lexer->identifiers;
+    src->strings = lexer->strings;
+    p->lazy_bodies = src;
+    p->defer_all_bodies = all;
+    return true;
+}
+
 static void print_error_header(const char *msg) {
     fprintf(stderr, RED "error:" RESET " %s\n", msg);
 }
 
-static void print_error_location(const char *filename, Token *tok) {
-    fprintf(stderr, "   %s:%zu:%zu\n", filename, tok->span.start_line, tok->span.start_col);
+static void print_error_location(const char *filename, SourcePos pos) {
+    fprintf(stderr, "   %s:%u:%u\n", filename, pos.line, pos.col);
 }
 
-static void print_error_source(const char *filename, Token *tok, bool use_prev) {
+static void print_error_source(SourceId file, SourcePos start, SourcePos end, bool use_prev) {
     if (use_prev) {
-        print_source_excerpt(filename, tok->span.start_line, tok->span.start_col);
+        print_source_excerpt(file, start.line, start.col);
     } else {
-        if (tok->span.start_line == tok->span.end_line && tok->span.end_col > tok->span.start_col) {
-            print_source_excerpt_span(filename, tok->span.start_line, tok->span.start_col, tok->span.end_col);
+        if (start.line == end.line && end.col > start.col) {
+            print_source_excerpt_span(file, start.line, start.col, end.col);
         } else {
-            print_source_excerpt(filename, tok->span.start_line, tok->span.start_col);
+            print_source_excerpt(file, start.line, start.col);
         }
     }
 }
@@ -104,15 +180,18 @@ void print_parse_error(ParseError *error) {
         return;
     }
 
-    Token display_tok = *error->token;
+    Span span = tok_span(error->p, error->token);
     if (error->use_prev_token) {
         Token *prev = peek(error->p, -1);
         if (prev) {
-            display_tok = *prev;
-            display_tok.span.start_col += (size_t)display_tok.slice.len;
+            /* Just past the previous token */
+            span = tok_span(error->p, prev);
+            span.start = span.end;
         }
     }
 
-    print_error_location(filename, &display_tok);
-    print_error_source(filename, &display_tok, error->use_prev_token);
+    SourcePos start = span_start_pos(span);
+    SourcePos end = span_end_pos(span);
+    print_error_location(filename, start);
+    print_error_source(span.file, start, end, error->use_prev_token);
 }
@@ -0,0 +1,144 @@
+#include "template_body.h"
+#include "ast.h"
+#include "parse_declarations.h"
+#include "dynamic_array.h"
+#include "core/mem_report.h"
+#include <string.h>
+
+typedef struct {
+    uint32_t block;  // Index into TemplateBody.blocks
+    uint32_t offset;
+    uint32_t len;
+} PatchRun;
+
+struct BodyPatch {
+    size_t run_count;
+    PatchRun *runs;
+    char *bytes;     // The runs' new contents, back to back
+    size_t size;
+};
+
+// Changes closer than this are stored as one run
+#define PATCH_GAP 16
+#define PATCH_WORD 8
+
+TemplateBody *template_body_create(Arena *owner) {
+    TemplateBody *tb = arena_calloc(owner, sizeof(TemplateBody));
+    if (!tb) return NULL;
+    tb->arena = arena_create(4096);
+    if (!tb->arena) return NULL;
+    arena_adopt(owner, tb->arena);
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&tb->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return tb;
+}
+
+static void apply_patch(TemplateBody *tb, const BodyPatch *patch) {
+    const char *bytes = patch->bytes;
+    for (size_t i = 0; i < patch->run_count; i++) {
+        const PatchRun *run = &patch->runs[i];
+        memcpy(tb->blocks[run->block].block->data + run->offset, bytes, run->len);
+        bytes += run->len;
+    }
+}
+
+bool template_body_bind(TemplateBody *tb, const BodyPatch *patch) {
+    pthread_mutex_lock(&tb->lock);
+    if (tb->held) {
+        pthread_mutex_unlock(&tb->lock);
+        return false;
+    }
+    tb->held = true;
+    if (patch) apply_patch(tb, patch);
+    return true;
+}
+
+void template_body_unbind(TemplateBody *tb) {
+    // Codegen may leave marks of its own, so all of it goes back
+    for (size_t i = 0; i < tb->block_count; i++) {
+        TemplateBlock *b = &tb->blocks[i];
+        memcpy(b->block->data, b->parsed, b->used);
+    }
+    tb->held = false;
+    pthread_mutex_unlock(&tb->lock);
+}
+
+AstNode *template_body_parse(TemplateBody *tb, const AstNode *func_decl, const char **err_msg, Span *err_span) {
+    if (tb->root) return tb->root;
+    AstNode *root = parse_deferred_body(func_decl, tb->arena, err_msg, err_span);
+    if (!root) return NULL;
+
+    // Take the blocks as the parse left them before anything else comes from the arena
+    size_t count = 0;
+    for (ArenaBlock *b = tb->arena->blocks; b; b = b->next) count++;
+    ArenaScratch scratch = arena_scratch_begin();
+    TemplateBlock *taken = arena_alloc(scratch.arena, (count ? count : 1) * sizeof(TemplateBlock));
+    size_t n = 0;
+    for (ArenaBlock *b = tb->arena->blocks; b; b = b->next, n++) {
+        taken[n] = (TemplateBlock){ .block = b, .used = b->used };
+    }
+
+    tb->blocks = arena_alloc(tb->arena, (count ? count : 1) * sizeof(TemplateBlock));
+    for (size_t i = 0; i < count; i++) {
+        tb->blocks[i] = taken[i];
+        tb->blocks[i].parsed = arena_alloc(tb->arena, taken[i].used ? taken[i].used : 1);
+        memcpy(tb->blocks[i].parsed, taken[i].block->data, taken[i].used);
+    }
+    arena_scratch_end(scratch);
+    tb->block_count = count;
+    tb->root = root;
+    return root;
+}
+
+static bool word_differs(const TemplateBlock *b, size_t at) {
+    size_t len = b->used - at < PATCH_WORD ? b->used - at : PATCH_WORD;
+    return memcmp(b->block->data + at, b->parsed + at, len) != 0;
+}
+
+const BodyPatch *template_body_capture(TemplateBody *tb, Arena *arena) {
+    DynArray runs;
+    dynarray_init(&runs, sizeof(PatchRun));
+    size_t total = 0;
+    for (size_t i = 0; i < tb->block_count; i++) {
+        const TemplateBlock *b = &tb->blocks[i];
+        size_t at = 0;
+        while (at < b->used) {
+            if (!word_differs(b, at)) {
+                at += PATCH_WORD;
+                continue;
+            }
+            size_t start = at, end = at + PATCH_WORD;
+            for (size_t next = end; next < b->used && next - end < PATCH_GAP; next += PATCH_WORD) {
+                if (word_differs(b, next)) end = next + PATCH_WORD;
+            }
+            if (end > b->used) end = b->used;
+            PatchRun run = { .block = (uint32_t)i, .offset = (uint32_t)start, .len = (uint32_t)(end - start) };
+            dynarray_push_value(&runs, &run);
+            total += run.len;
+            at = end;
+        }
+    }
+
+    BodyPatch *patch = arena_alloc(arena, sizeof(BodyPatch));
+    patch->run_count = runs.count;
+    patch->runs = arena_alloc(arena, (runs.count ? runs.count : 1) * sizeof(PatchRun));
+    patch->bytes = arena_alloc(arena, total ? total : 1);
+    patch->size = sizeof(BodyPatch) + runs.count * sizeof(PatchRun) + total;
+    char *out = patch->bytes;
+    for (size_t i = 0; i < runs.count; i++) {
+        PatchRun *run = dynarray_get(&runs, i);
+        patch->runs[i] = *run;
+        memcpy(out, tb->blocks[run->block].block->data + run->offset, run->len);
+        out += run->len;
+    }
+    dynarray_free(&runs);
+    MEM_ACCOUNT(MEM_MONO, MEM_KIND_NONE, SOURCE_NONE, patch->size, 1);
+    return patch;
+}
+
+size_t body_patch_size(const BodyPatch *patch) {
+    return patch ? patch->size : 0;
+}
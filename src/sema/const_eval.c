@@ -0,0 +1,1459 @@
+#include "sema/const_eval.h"
+#include "sema/type_utils.h"
+#include "sema/type.h"
+#include "parsing/ast.h"
+#include "datastructures/dynamic_array.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/arena.h"
+#include "core/utils.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CE_MAX_STEPS  10000000ULL                 // Statements per initializer
+#define CE_MAX_DEPTH  512                         // Nested calls
+#define CE_MAX_MEMORY ((size_t)256 * 1024 * 1024) // Bytes of values alive at once
+
+// -----------------------------------------------------------------------------
+// Values
+// -----------------------------------------------------------------------------
+
+typedef enum {
+    CT_VOID,
+    CT_INT,   // Integers, bool, char, enums: sign-extended at the type's width
+    CT_FLOAT, // f32 values are kept rounded to float
+    CT_PTR,   // Pointers and slices
+    CT_FN,    // Function pointers
+    CT_AGG    // Arrays and structs, by element / field index
+} CtKind;
+
+typedef struct CtValue CtValue;
+struct CtValue {
+    CtKind kind;
+    union {
+        int64_t i;
+        double f;
+        struct {
+            CtValue *base;      // Element storage; NULL for null and strings
+            InternResult *str;  // String literal the pointer walks instead
+            int64_t index;      // Element pointed at
+            int64_t extent;     // Elements reachable from base (string: len + 1)
+            int64_t len;        // Slices only
+            bool readonly;      // Points into a global or a string literal
+        } ptr;
+        struct { AstNode *decl; Symbol *sym; } fn; // decl NULL: null
+        struct { CtValue *elems; size_t count; } agg;
+    } as;
+};
+
+/* Where an lvalue lives: element `index` of `base` (or of `str`). */
+typedef struct {
+    CtValue *base;
+    InternResult *str;
+    int64_t index;
+    int64_t extent;
+    const char *readonly; // What the storage is, when writes are refused
+} CtPlace;
+
+typedef enum { GLOBAL_PENDING, GLOBAL_RUNNING, GLOBAL_DONE, GLOBAL_FAILED } CtGlobalState;
+
+typedef struct {
+    AstNode *decl;
+    Symbol *sym;        // First symbol it was read through (for `&global`)
+    CtGlobalState state;
+    CtValue *storage;   // In ConstEval.statics once evaluated
+    const char *reason; // GLOBAL_FAILED
+    AstNode *where;
+} CtGlobal;
+
+typedef struct { AstNode *decl; CtValue *slot; } CtBinding;
+typedef struct CtDefer { AstNode *body; struct CtDefer *next; } CtDefer;
+
+/* One call: locals and parameters by declaring node, pending defers. */
+typedef struct {
+    CtBinding *bindings;
+    size_t count, capacity;
+    CtDefer *defers; // Newest first
+    CtValue *ret;    // Return slot, NULL for void
+} CtFrame;
+
+typedef enum { FLOW_NEXT, FLOW_BREAK, FLOW_CONTINUE, FLOW_RETURN, FLOW_FAIL } CtFlow;
+
+typedef struct {
+    TypeCheckContext *tc;
+    Arena *scratch;         // Frames and temporaries; rewound after each call
+    Arena *statics;         // Values of evaluated globals
+    HashMap *globals;       // var decl node -> CtGlobal*
+    HashMap *owners;        // global storage -> CtGlobal*
+    CtFrame *frame;
+    uint64_t steps;
+    int depth;
+    const char *reason;     // First failure, NULL while evaluation succeeds
+    AstNode *where;
+} ConstEval;
+
+static bool ce_expr(ConstEval *ce, AstNode *e, CtValue *out);
+static bool ce_place(ConstEval *ce, AstNode *e, CtPlace *out);
+static CtFlow ce_stmt(ConstEval *ce, AstNode *s);
+
+static const char *ce_name(InternResult *rec) {
+    return rec && rec->key ? ((Slice*)rec->key)->ptr : "<anonymous>";
+}
+
+static bool ce_fail(ConstEval *ce, AstNode *where, const char *fmt, ...) {
+    if (ce->reason) return false;
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    size_t n = strlen(buf) + 1;
+    char *msg = arena_alloc(ce->tc->arena, n);
+    memcpy(msg, buf, n);
+    ce->reason = msg;
+    ce->where = where;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// Types and storage
+// -----------------------------------------------------------------------------
+
+static Type *ce_concrete(Type *t) {
+    while (t && t->kind == TYPE_GENERIC_INST) t = t->as.generic_inst.concrete_type;
+    return t;
+}
+
+/* Width codegen gives an integer-like type (get_llvm_type). */
+static int ce_int_bits(Type *t) {
+    t = ce_concrete(t);
+    if (!t || t->kind != TYPE_PRIMITIVE) return 64; // Enums are i64
+    switch (t->as.primitive) {
+        case PRIM_I8: case PRIM_U8: case PRIM_BOOL: case PRIM_CHAR: return 8;
+        case PRIM_I16: case PRIM_U16: return 16;
+        case PRIM_I32: case PRIM_U32: return 32;
+        default: return 64;
+    }
+}
+
+static int64_t ce_wrap(int64_t v, Type *t) {
+    int bits = ce_int_bits(t);
+    if (bits >= 64) return v;
+    uint64_t u = (uint64_t)v << (64 - bits);
+    return (int64_t)u >> (64 - bits);
+}
+
+static double ce_round(double d, Type *t) {
+    t = ce_concrete(t);
+    if (t && t->kind == TYPE_PRIMITIVE && t->as.primitive == PRIM_F32) return (double)(float)d;
+    return d;
+}
+
+static bool ce_is_int_like(Type *t) {
+    t = ce_concrete(t);
+    if (!t) return false;
+    if (t->kind == TYPE_ENUM) return true;
+    return t->kind == TYPE_PRIMITIVE && !type_is_float(t);
+}
+
+static void *ce_alloc(ConstEval *ce, Arena *arena, AstNode *at, size_t count, size_t size) {
+    if (count == 0) count = 1;
+    if (count > CE_MAX_MEMORY / size ||
+        arena_bytes_used(ce->scratch) + arena_bytes_used(ce->statics) + count * size > CE_MAX_MEMORY) {
+        ce_fail(ce, at, "needs more than %zu MiB of memory", CE_MAX_MEMORY >> 20);
+        return NULL;
+    }
+    return arena_calloc(arena, count * size);
+}
+
+/* Zero value of `t` in *v, with storage for its elements from `arena`. */
+static bool ce_zero(ConstEval *ce, Arena *arena, AstNode *at, Type *t, CtValue *v) {
+    t = ce_concrete(t);
+    memset(v, 0, sizeof(*v));
+    if (!t) return true;
+    switch (t->kind) {
+        case TYPE_PRIMITIVE:
+            v->kind = type_is_float(t) ? CT_FLOAT : CT_INT;
+            return true;
+        case TYPE_ENUM:
+            v->kind = CT_INT;
+            return true;
+        case TYPE_POINTER:
+        case TYPE_SLICE:
+            v->kind = CT_PTR;
+            return true;
+        case TYPE_FUNCTION:
+            v->kind = CT_FN;
+            return true;
+        case TYPE_ARRAY:
+        case TYPE_VECTOR: {
+            // A vector folds like an array of its lanes
+            bool vec = t->kind == TYPE_VECTOR;
+            int64_t size = vec ? t->as.vector.lanes : t->as.array.size;
+            size_t n = size > 0 ? (size_t)size : 0;
+            CtValue *elems = ce_alloc(ce, arena, at, n, sizeof(CtValue));
+            if (!elems) return false;
+            for (size_t i = 0; i < n; i++) {
+                if (!ce_zero(ce, arena, at, vec ? t->as.vector.base : t->as.array.base, &elems[i])) return false;
+            }
+            v->kind = CT_AGG;
+            v->as.agg.elems = elems;
+            v->as.agg.count = n;
+            return true;
+        }
+        case TYPE_STRUCT: {
+            size_t n = t->as.struct_type.field_count;
+            CtValue *elems = ce_alloc(ce, arena, at, n, sizeof(CtValue));
+            if (!elems) return false;
+            for (size_t i = 0; i < n; i++) {
+                if (!ce_zero(ce, arena, at, t->as.struct_type.fields[i].type, &elems[i])) return false;
+            }
+            v->kind = CT_AGG;
+            v->as.agg.elems = elems;
+            v->as.agg.count = n;
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+/* Fresh zeroed storage for a `t` among the temporaries. */
+static CtValue *ce_new(ConstEval *ce, AstNode *at, Type *t) {
+    CtValue *slot = ce_alloc(ce, ce->scratch, at, 1, sizeof(CtValue));
+    if (!slot || !ce_zero(ce, ce->scratch, at, t, slot)) return NULL;
+    return slot;
+}
+
+/* Assignment: aggregates are copied into the storage `dst` already has. */
+static void ce_store(CtValue *dst, const CtValue *src) {
+    if (dst->kind == CT_AGG && src->kind == CT_AGG) {
+        if (dst->as.agg.elems == src->as.agg.elems) return;
+        size_t n = dst->as.agg.count < src->as.agg.count ? dst->as.agg.count : src->as.agg.count;
+        for (size_t i = 0; i < n; i++) ce_store(&dst->as.agg.elems[i], &src->as.agg.elems[i]);
+        return;
+    }
+    if (dst->kind == CT_AGG) return;
+    *dst = *src;
+}
+
+static bool ce_truthy(const CtValue *v) {
+    switch (v->kind) {
+        case CT_INT:   return v->as.i != 0;
+        case CT_FLOAT: return v->as.f != 0.0 || isnan(v->as.f);
+        case CT_PTR:   return v->as.ptr.base || v->as.ptr.str;
+        case CT_FN:    return v->as.fn.decl != NULL;
+        default:       return false;
+    }
+}
+
+static CtValue ce_int(int64_t i) {
+    CtValue v = { .kind = CT_INT };
+    v.as.i = i;
+    return v;
+}
+
+// -----------------------------------------------------------------------------
+// Frames and globals
+// -----------------------------------------------------------------------------
+
+static CtValue *ce_lookup(ConstEval *ce, AstNode *decl) {
+    CtFrame *f = ce->frame;
+    for (size_t i = f->count; i-- > 0;) {
+        if (f->bindings[i].decl == decl) return f->bindings[i].slot;
+    }
+    return NULL;
+}
+
+static bool ce_bind(ConstEval *ce, AstNode *decl, CtValue *slot) {
+    CtFrame *f = ce->frame;
+    if (f->count == f->capacity) {
+        size_t cap = f->capacity ? f->capacity * 2 : 8;
+        CtBinding *grown = ce_alloc(ce, ce->scratch, decl, cap, sizeof(CtBinding));
+        if (!grown) return false;
+        if (f->count) memcpy(grown, f->bindings, f->count * sizeof(CtBinding));
+        f->bindings = grown;
+        f->capacity = cap;
+    }
+    f->bindings[f->count++] = (CtBinding){ decl, slot };
+    return true;
+}
+
+/* Pointers kept by a global must point at other globals or string literals. */
+static bool ce_check_escape(ConstEval *ce, AstNode *at, const CtValue *v) {
+    if (v->kind == CT_PTR && v->as.ptr.base && !v->as.ptr.readonly) {
+        return ce_fail(ce, at, "keeps a pointer to memory that only exists during evaluation");
+    }
+    if (v->kind == CT_AGG) {
+        for (size_t i = 0; i < v->as.agg.count; i++) {
+            if (!ce_check_escape(ce, at, &v->as.agg.elems[i])) return false;
+        }
+    }
+    return true;
+}
+
+/* Evaluate `g` into its own storage; on failure the reason stays on `g`. */
+static bool ce_eval_global(ConstEval *ce, CtGlobal *g) {
+    AstNode *decl = g->decl;
+    AstNode *init = decl->data.variable_declaration.initializer;
+    g->state = GLOBAL_RUNNING;
+
+    const char *outer_reason = ce->reason;
+    AstNode *outer_where = ce->where;
+    CtFrame *outer_frame = ce->frame;
+    uint64_t outer_steps = ce->steps;
+    CtFrame frame = {0};
+    ce->reason = NULL;
+    ce->frame = &frame;
+    ce->steps = 0;
+
+    ArenaMark mark = arena_mark(ce->scratch);
+    CtValue *storage = ce_alloc(ce, ce->statics, decl, 1, sizeof(CtValue));
+    bool ok = storage && ce_zero(ce, ce->statics, decl, decl->type, storage);
+    if (ok && init) {
+        CtValue v;
+        ok = ce_expr(ce, init, &v);
+        if (ok) {
+            ce_store(storage, &v);
+            ok = ce_check_escape(ce, init, storage);
+        }
+    }
+    arena_rewind(ce->scratch, mark);
+
+    if (ok) {
+        g->state = GLOBAL_DONE;
+        g->storage = storage;
+        ptrmap_put(ce->owners, storage, g);
+    } else {
+        g->state = GLOBAL_FAILED;
+        g->reason = ce->reason ? ce->reason : "cannot be evaluated";
+        g->where = ce->where ? ce->where : decl;
+    }
+    ce->reason = outer_reason;
+    ce->where = outer_where;
+    ce->frame = outer_frame;
+    ce->steps = outer_steps;
+    return ok;
+}
+
+/* Storage of a global read during evaluation. */
+static CtValue *ce_global(ConstEval *ce, AstNode *at, CtGlobal *g, Symbol *sym) {
+    const char *name = ce_name(g->decl->data.variable_declaration.intern_result);
+    if (!g->sym) g->sym = sym;
+    switch (g->state) {
+        case GLOBAL_DONE:
+            return g->storage;
+        case GLOBAL_RUNNING:
+            ce_fail(ce, at, "depends on the value of '%s' while computing it", name);
+            return NULL;
+        case GLOBAL_PENDING:
+            if (ce_eval_global(ce, g)) return g->storage;
+            /* fall through */
+        case GLOBAL_FAILED:
+            ce_fail(ce, at, "reads '%s', which cannot be evaluated at compile time", name);
+            return NULL;
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Places
+// -----------------------------------------------------------------------------
+
+static CtValue ce_load(const CtPlace *pl) {
+    if (pl->str) {
+        Slice *s = (Slice*)pl->str->key;
+        return ce_int(pl->index < (int64_t)s->len ? (int64_t)(signed char)s->ptr[pl->index] : 0);
+    }
+    return pl->base[pl->index];
+}
+
+static bool ce_writable(ConstEval *ce, AstNode *at, const CtPlace *pl) {
+    if (pl->readonly) return ce_fail(ce, at, "writes to %s", pl->readonly);
+    return true;
+}
+
+static CtValue ce_address(const CtPlace *pl) {
+    CtValue v = { .kind = CT_PTR };
+    v.as.ptr.base = pl->base;
+    v.as.ptr.str = pl->str;
+    v.as.ptr.index = pl->index;
+    v.as.ptr.extent = pl->extent;
+    v.as.ptr.readonly = pl->readonly != NULL;
+    return v;
+}
+
+/* Element `offset` past where pointer `p` points. */
+static bool ce_deref(ConstEval *ce, AstNode *at, const CtValue *p, int64_t offset, CtPlace *out) {
+    if (p->kind != CT_PTR) return ce_fail(ce, at, "dereferences a value that is not a pointer");
+    if (!p->as.ptr.base && !p->as.ptr.str) return ce_fail(ce, at, "dereferences a null pointer");
+    int64_t idx = p->as.ptr.index + offset;
+    if (idx < 0 || idx >= p->as.ptr.extent) {
+        return ce_fail(ce, at, "accesses element %lld of %lld", (long long)idx, (long long)p->as.ptr.extent);
+    }
+    *out = (CtPlace){ .base = p->as.ptr.base, .str = p->as.ptr.str, .index = idx, .extent = p->as.ptr.extent };
+    if (p->as.ptr.str) out->readonly = "a string literal";
+    else if (p->as.ptr.readonly) out->readonly = "global storage";
+    return true;
+}
+
+/* A value with no storage of its own, kept in a temporary. */
+static bool ce_temp_place(ConstEval *ce, AstNode *e, CtPlace *out) {
+    CtValue v;
+    if (!ce_expr(ce, e, &v)) return false;
+    CtValue *slot = ce_alloc(ce, ce->scratch, e, 1, sizeof(CtValue));
+    if (!slot) return false;
+    *slot = v;
+    *out = (CtPlace){ .base = slot, .index = 0, .extent = 1 };
+    return true;
+}
+
+static bool ce_symbol_place(ConstEval *ce, AstNode *e, Symbol *sym, CtPlace *out) {
+    while (sym && sym->kind == SYMBOL_VALUE_ALIAS) sym = sym->target_symbol;
+    if (!sym || sym->kind != SYMBOL_VARIABLE) return ce_temp_place(ce, e, out);
+
+    CtValue *slot = ce_lookup(ce, sym->decl_node);
+    if (slot) {
+        *out = (CtPlace){ .base = slot, .index = 0, .extent = 1 };
+        return true;
+    }
+    CtGlobal *g = sym->decl_node ? ptrmap_get(ce->globals, sym->decl_node) : NULL;
+    if (!g) return ce_fail(ce, e, "reads '%s', which has no value at compile time", ce_name(sym->name_rec));
+    slot = ce_global(ce, e, g, sym);
+    if (!slot) return false;
+    *out = (CtPlace){ .base = slot, .index = 0, .extent = 1, .readonly = "a global" };
+    return true;
+}
+
+static bool ce_member_place(ConstEval *ce, AstNode *e, CtPlace *out) {
+    AstMemberExpr *mem = &e->data.member_expr;
+    if (mem->symbol) return ce_symbol_place(ce, e, mem->symbol, out);
+
+    // Member access goes through any number of pointers
+    Type *t = mem->target->type;
+    CtPlace base;
+    if (t && t->kind == TYPE_POINTER) {
+        CtValue p;
+        if (!ce_expr(ce, mem->target, &p)) return false;
+        while (t && t->kind == TYPE_POINTER) {
+            if (!ce_deref(ce, e, &p, 0, &base)) return false;
+            t = ce_concrete(t->as.ptr.base);
+            if (t && t->kind == TYPE_POINTER) p = ce_load(&base);
+        }
+    } else if (!ce_place(ce, mem->target, &base)) {
+        return false;
+    }
+    t = ce_concrete(t);
+    if (!t || base.str) return ce_fail(ce, e, "accesses a member it cannot evaluate");
+
+    CtValue *target = &base.base[base.index];
+    if (t->kind == TYPE_SLICE) {
+        CtValue field = *target;
+        if (mem->member == ce->tc->store->kw_len) {
+            field = ce_int(target->as.ptr.len);
+        } else {
+            field.as.ptr.len = 0;
+        }
+        CtValue *slot = ce_alloc(ce, ce->scratch, e, 1, sizeof(CtValue));
+        if (!slot) return false;
+        *slot = field;
+        *out = (CtPlace){ .base = slot, .index = 0, .extent = 1, .readonly = "a slice header" };
+        return true;
+    }
+    if (t->kind == TYPE_STRUCT && target->kind == CT_AGG) {
+        for (size_t i = 0; i < t->as.struct_type.field_count && i < target->as.agg.count; i++) {
+            if (t->as.struct_type.fields[i].name == mem->member) {
+                *out = (CtPlace){ .base = &target->as.agg.elems[i], .index = 0, .extent = 1, .readonly = base.readonly };
+                return true;
+            }
+        }
+    }
+    return ce_fail(ce, e, "accesses unknown member '%s'", ce_name(mem->member));
+}
+
+static bool ce_index(ConstEval *ce, AstNode *e, int64_t *out) {
+    CtValue v;
+    if (!ce_expr(ce, e, &v)) return false;
+    if (v.kind != CT_INT) return ce_fail(ce, e, "indexes with a value that is not an integer");
+    *out = v.as.i;
+    return true;
+}
+
+static bool ce_subscript_place(ConstEval *ce, AstNode *e, CtPlace *out) {
+    AstSubscriptExpr *sub = &e->data.subscript_expr;
+    Type *t = ce_concrete(sub->target->type);
+    if (!t) return ce_fail(ce, e, "indexes a value it cannot evaluate");
+
+    if (t->kind == TYPE_ARRAY || t->kind == TYPE_VECTOR) {
+        CtPlace arr;
+        int64_t i = 0;
+        if (!ce_place(ce, sub->target, &arr) || !ce_index(ce, sub->index, &i)) return false;
+        CtValue *a = &arr.base[arr.index];
+        if (arr.str || a->kind != CT_AGG) return ce_fail(ce, e, "indexes a value it cannot evaluate");
+        if (i < 0 || i >= (int64_t)a->as.agg.count) {
+            return ce_fail(ce, e, "accesses element %lld of an array of %zu", (long long)i, a->as.agg.count);
+        }
+        *out = (CtPlace){ .base = a->as.agg.elems, .index = i, .extent = (int64_t)a->as.agg.count, .readonly = arr.readonly };
+        return true;
+    }
+
+    CtValue p;
+    int64_t i = 0;
+    if (!ce_expr(ce, sub->target, &p) || !ce_index(ce, sub->index, &i)) return false;
+    if (t->kind == TYPE_SLICE && (i < 0 || i >= p.as.ptr.len)) {
+        return ce_fail(ce, e, "accesses element %lld of a slice of %lld", (long long)i, (long long)p.as.ptr.len);
+    }
+    return ce_deref(ce, e, &p, i, out);
+}
+
+static bool ce_place(ConstEval *ce, AstNode *e, CtPlace *out) {
+    switch (e->node_type) {
+        case AST_IDENTIFIER:
+            return ce_symbol_place(ce, e, e->data.identifier.symbol, out);
+        case AST_MEMBER_EXPR:
+            return ce_member_place(ce, e, out);
+        case AST_SUBSCRIPT_EXPR:
+            return ce_subscript_place(ce, e, out);
+        case AST_UNARY_EXPR:
+            if (e->data.unary_expr.op == OP_DEREF) {
+                CtValue p;
+                if (!ce_expr(ce, e->data.unary_expr.expr, &p)) return false;
+                return ce_deref(ce, e, &p, 0, out);
+            }
+            break;
+        case AST_CAST: {
+            // Like codegen_lvalue: only casts to a pointer or slice make a new value
+            Type *t = ce_concrete(e->type);
+            if (t && t->kind != TYPE_POINTER && t->kind != TYPE_SLICE) {
+                return ce_place(ce, e->data.cast_expr.expr, out);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return ce_temp_place(ce, e, out);
+}
+
+// -----------------------------------------------------------------------------
+// Operators
+// -----------------------------------------------------------------------------
+
+static bool ce_const(ConstEval *ce, AstNode *e, const ConstValue *cv, CtValue *out) {
+    Type *t = ce_concrete(e->type);
+    memset(out, 0, sizeof(*out));
+    switch (cv->type) {
+        case INT_LITERAL:
+            if (type_is_float(t)) {
+                out->kind = CT_FLOAT;
+                out->as.f = ce_round((double)cv->value.int_val, t);
+            } else if (t && (t->kind == TYPE_POINTER || t->kind == TYPE_SLICE)) {
+                if (cv->value.int_val != 0) return ce_fail(ce, e, "turns an integer into a pointer");
+                out->kind = CT_PTR;
+            } else {
+                *out = ce_int(ce_wrap(cv->value.int_val, t));
+            }
+            return true;
+        case FLOAT_LITERAL:
+            out->kind = CT_FLOAT;
+            out->as.f = ce_round(cv->value.float_val, t);
+            return true;
+        case BOOL_LITERAL:
+            *out = ce_int(cv->value.bool_val ? 1 : 0);
+            return true;
+        case CHAR_LITERAL:
+            *out = ce_int(ce_wrap((int64_t)cv->value.char_val, t));
+            return true;
+        case STRING_LITERAL:
+            out->kind = CT_PTR;
+            out->as.ptr.str = cv->value.string_val;
+            out->as.ptr.extent = (int64_t)((Slice*)cv->value.string_val->key)->len + 1;
+            out->as.ptr.readonly = true;
+            return true;
+        case NULL_LITERAL:
+            out->kind = (t && t->kind == TYPE_FUNCTION) ? CT_FN : CT_PTR;
+            return true;
+    }
+    return ce_fail(ce, e, "uses a literal it cannot evaluate");
+}
+
+static bool ce_same_pointer(const CtValue *l, const CtValue *r) {
+    if (l->kind == CT_FN || r->kind == CT_FN) {
+        return l->kind == r->kind && l->as.fn.decl == r->as.fn.decl;
+    }
+    bool lnull = !l->as.ptr.base && !l->as.ptr.str;
+    bool rnull = !r->as.ptr.base && !r->as.ptr.str;
+    if (lnull || rnull) return lnull == rnull;
+    return l->as.ptr.base == r->as.ptr.base && l->as.ptr.str == r->as.ptr.str && l->as.ptr.index == r->as.ptr.index;
+}
+
+/*
+ * `l op r`, as codegen_expr_ops computes it: integers wrap at the operand
+ * width, division, remainder and comparisons follow the operand's
+ * signedness, `&&`/`||` are
+ * bitwise on already evaluated operands.
+ */
+static bool ce_arith(ConstEval *ce, AstNode *e, OpKind op, Type *operand_type, Type *result_type,
+                     const CtValue *l, const CtValue *r, CtValue *out) {
+    if (l->kind == CT_FLOAT || r->kind == CT_FLOAT) {
+        double a = l->kind == CT_FLOAT ? l->as.f : (double)l->as.i;
+        double b = r->kind == CT_FLOAT ? r->as.f : (double)r->as.i;
+        double res;
+        switch (op) {
+            case OP_ADD: res = a + b; break;
+            case OP_SUB: res = a - b; break;
+            case OP_MUL: res = a * b; break;
+            case OP_DIV: res = a / b; break;
+            case OP_MOD: res = fmod(a, b); break;
+            case OP_EQ:  *out = ce_int(a == b); return true;
+            case OP_NEQ: *out = ce_int(a < b || a > b); return true;
+            case OP_LT:  *out = ce_int(a < b); return true;
+            case OP_GT:  *out = ce_int(a > b); return true;
+            case OP_LE:  *out = ce_int(a <= b); return true;
+            case OP_GE:  *out = ce_int(a >= b); return true;
+            default: return ce_fail(ce, e, "applies an operator it cannot evaluate to floats");
+        }
+        out->kind = CT_FLOAT;
+        out->as.f = ce_round(res, result_type);
+        return true;
+    }
+
+    if (l->kind == CT_PTR || l->kind == CT_FN || r->kind == CT_PTR || r->kind == CT_FN) {
+        if (op == OP_EQ)  { *out = ce_int(ce_same_pointer(l, r));  return true; }
+        if (op == OP_NEQ) { *out = ce_int(!ce_same_pointer(l, r)); return true; }
+        return ce_fail(ce, e, "does arithmetic on pointers");
+    }
+    if (l->kind != CT_INT || r->kind != CT_INT) return ce_fail(ce, e, "applies an operator to a value it cannot evaluate");
+
+    int64_t a = l->as.i, b = r->as.i;
+    uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+    bool is_unsigned = operand_type && type_is_unsigned(operand_type);
+    switch (op) {
+        case OP_ADD: *out = ce_int(ce_wrap((int64_t)(ua + ub), result_type)); return true;
+        case OP_SUB: *out = ce_int(ce_wrap((int64_t)(ua - ub), result_type)); return true;
+        case OP_MUL: *out = ce_int(ce_wrap((int64_t)(ua * ub), result_type)); return true;
+        case OP_DIV:
+        case OP_MOD: {
+            if (b == 0) return ce_fail(ce, e, "divides by zero");
+            if (is_unsigned) {
+                *out = ce_int(ce_wrap((int64_t)(op == OP_DIV ? ua / ub : ua % ub), result_type));
+                return true;
+            }
+            if (b == -1 && a == ce_wrap((int64_t)(UINT64_C(1) << (ce_int_bits(operand_type) - 1)), operand_type)) {
+                return ce_fail(ce, e, "overflows in a signed division");
+            }
+            *out = ce_int(ce_wrap(op == OP_DIV ? a / b : a % b, result_type));
+            return true;
+        }
+        case OP_EQ:  *out = ce_int(a == b); return true;
+        case OP_NEQ: *out = ce_int(a != b); return true;
+        case OP_LT:  *out = ce_int(is_unsigned ? ua < ub  : a < b);  return true;
+        case OP_GT:  *out = ce_int(is_unsigned ? ua > ub  : a > b);  return true;
+        case OP_LE:  *out = ce_int(is_unsigned ? ua <= ub : a <= b); return true;
+        case OP_GE:  *out = ce_int(is_unsigned ? ua >= ub : a >= b); return true;
+        case OP_AND: *out = ce_int(ce_wrap(a & b, result_type)); return true;
+        case OP_OR:  *out = ce_int(ce_wrap(a | b, result_type)); return true;
+        default: return ce_fail(ce, e, "applies an operator it cannot evaluate");
+    }
+}
+
+static OpKind ce_compound_op(OpKind op) {
+    switch (op) {
+        case OP_PLUS_EQ:  return OP_ADD;
+        case OP_MINUS_EQ: return OP_SUB;
+        case OP_MUL_EQ:   return OP_MUL;
+        case OP_DIV_EQ:   return OP_DIV;
+        case OP_MOD_EQ:   return OP_MOD;
+        default:          return OP_NULL;
+    }
+}
+
+static bool ce_assign(ConstEval *ce, AstNode *e, CtValue *out) {
+    AstAssignmentExpr *as = &e->data.assignment_expr;
+    CtPlace pl;
+    CtValue rv;
+    if (!ce_place(ce, as->lvalue, &pl) || !ce_writable(ce, e, &pl)) return false;
+    if (!ce_expr(ce, as->rvalue, &rv)) return false;
+    if (as->op == OP_ASSIGN) {
+        ce_store(&pl.base[pl.index], &rv);
+        *out = rv;
+        return true;
+    }
+    CtValue cur = ce_load(&pl);
+    Type *t = as->lvalue->type;
+    if (!ce_arith(ce, e, ce_compound_op(as->op), t, t, &cur, &rv, out)) return false;
+    ce_store(&pl.base[pl.index], out);
+    return true;
+}
+
+static bool ce_unary(ConstEval *ce, AstNode *e, CtValue *out) {
+    AstUnaryExpr *ue = &e->data.unary_expr;
+    switch (ue->op) {
+        case OP_ADDRESS: {
+            AstNode *x = ue->expr;
+            Symbol *sym = x->node_type == AST_IDENTIFIER ? x->data.identifier.symbol
+                        : x->node_type == AST_MEMBER_EXPR ? x->data.member_expr.symbol : NULL;
+            if (sym && sym->kind == SYMBOL_VALUE_FUNCTION) return ce_expr(ce, x, out);
+            CtPlace pl;
+            if (!ce_place(ce, x, &pl)) return false;
+            *out = ce_address(&pl);
+            return true;
+        }
+        case OP_DEREF: {
+            CtValue p;
+            CtPlace pl;
+            if (!ce_expr(ce, ue->expr, &p) || !ce_deref(ce, e, &p, 0, &pl)) return false;
+            *out = ce_load(&pl);
+            return true;
+        }
+        case OP_SUB: {
+            CtValue v;
+            if (!ce_expr(ce, ue->expr, &v)) return false;
+            if (v.kind == CT_FLOAT) {
+                v.as.f = -v.as.f;
+            } else if (v.kind == CT_INT) {
+                v.as.i = ce_wrap((int64_t)(0 - (uint64_t)v.as.i), e->type);
+            } else {
+                return ce_fail(ce, e, "negates a value it cannot evaluate");
+            }
+            *out = v;
+            return true;
+        }
+        case OP_NOT: {
+            CtValue v;
+            if (!ce_expr(ce, ue->expr, &v)) return false;
+            if (v.kind != CT_INT) return ce_fail(ce, e, "negates a value it cannot evaluate");
+            *out = ce_int(v.as.i == 0);
+            return true;
+        }
+        case OP_PRE_INC: case OP_PRE_DEC:
+        case OP_POST_INC: case OP_POST_DEC: {
+            CtPlace pl;
+            if (!ce_place(ce, ue->expr, &pl) || !ce_writable(ce, e, &pl)) return false;
+            CtValue old = ce_load(&pl), one = ce_int(1);
+            CtValue now;
+            OpKind op = (ue->op == OP_PRE_INC || ue->op == OP_POST_INC) ? OP_ADD : OP_SUB;
+            Type *t = ue->expr->type;
+            if (!ce_arith(ce, e, op, t, t, &old, &one, &now)) return false;
+            ce_store(&pl.base[pl.index], &now);
+            *out = (ue->op == OP_POST_INC || ue->op == OP_POST_DEC) ? old : now;
+            return true;
+        }
+        default:
+            return ce_fail(ce, e, "applies an operator it cannot evaluate");
+    }
+}
+
+/* Mirrors the cast lowering in codegen_expr_ops. */
+static bool ce_cast(ConstEval *ce, AstNode *e, CtValue *out) {
+    AstCastExpr *cast = &e->data.cast_expr;
+    Type *from = ce_concrete(cast->expr->type);
+    Type *to = ce_concrete(cast->target_type);
+    if (!from || !to) return ce_fail(ce, e, "casts a value it cannot evaluate");
+
+    if (from->kind == TYPE_ARRAY && (to->kind == TYPE_SLICE || to->kind == TYPE_POINTER)) {
+        Type *inner = ce_concrete(from->as.array.base);
+        if (to->kind == TYPE_SLICE && inner && inner->kind == TYPE_ARRAY) {
+            return ce_fail(ce, e, "slices a nested array");
+        }
+        CtPlace pl;
+        if (!ce_place(ce, cast->expr, &pl)) return false;
+        CtValue *arr = &pl.base[pl.index];
+        if (pl.str || arr->kind != CT_AGG) return ce_fail(ce, e, "casts a value it cannot evaluate");
+        *out = (CtValue){ .kind = CT_PTR };
+        out->as.ptr.base = arr->as.agg.elems;
+        out->as.ptr.extent = (int64_t)arr->as.agg.count;
+        out->as.ptr.len = to->kind == TYPE_SLICE ? (int64_t)arr->as.agg.count : 0;
+        out->as.ptr.readonly = pl.readonly != NULL;
+        return true;
+    }
+    if (from->kind == TYPE_POINTER && to->kind == TYPE_POINTER) {
+        Type *fb = ce_concrete(from->as.ptr.base), *tb = ce_concrete(to->as.ptr.base);
+        if (fb && tb && fb->kind == TYPE_ARRAY && tb->kind == TYPE_SLICE) {
+            return ce_fail(ce, e, "turns a pointer to an array into a pointer to a slice");
+        }
+    }
+
+    CtValue v;
+    if (!ce_expr(ce, cast->expr, &v)) return false;
+
+    if (ce_is_int_like(from) && ce_is_int_like(to)) {
+        int fw = ce_int_bits(from), tw = ce_int_bits(to);
+        int64_t i = v.as.i;
+        if (fw < tw && type_is_unsigned(from)) i = (int64_t)((uint64_t)i & (UINT64_MAX >> (64 - fw)));
+        *out = ce_int(ce_wrap(i, to));
+        return true;
+    }
+    if (ce_is_int_like(from) && type_is_float(to)) {
+        *out = (CtValue){ .kind = CT_FLOAT };
+        out->as.f = ce_round((double)v.as.i, to);
+        return true;
+    }
+    if (type_is_float(from) && ce_is_int_like(to)) {
+        double d = trunc(v.as.f);
+        int bits = ce_int_bits(to);
+        double limit = ldexp(1.0, bits - 1);
+        if (isnan(d) || d < -limit || d >= limit) {
+            return ce_fail(ce, e, "converts %g to an integer type too small for it", v.as.f);
+        }
+        *out = ce_int(ce_wrap((int64_t)d, to));
+        return true;
+    }
+    if (type_is_float(from) && type_is_float(to)) {
+        *out = (CtValue){ .kind = CT_FLOAT };
+        out->as.f = ce_round(v.as.f, to);
+        return true;
+    }
+    if (v.kind == CT_PTR && ce_is_int_like(to)) {
+        if (v.as.ptr.base || v.as.ptr.str) return ce_fail(ce, e, "turns a pointer into an integer");
+        *out = ce_int(0);
+        return true;
+    }
+    if (v.kind == CT_INT && (to->kind == TYPE_POINTER || to->kind == TYPE_FUNCTION)) {
+        if (v.as.i != 0) return ce_fail(ce, e, "turns an integer into a pointer");
+        *out = (CtValue){ .kind = to->kind == TYPE_FUNCTION ? CT_FN : CT_PTR };
+        return true;
+    }
+    // Pointer and function casts keep what they point at
+    *out = v;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Calls
+// -----------------------------------------------------------------------------
+
+static bool ce_call(ConstEval *ce, AstNode *e, CtValue *out) {
+    AstCallExpr *call = &e->data.call_expr;
+    AstNode *callee = call->callee;
+    if (callee->node_type == AST_GENERIC_INST_EXPR) callee = callee->data.generic_inst_expr.base;
+    if (callee->node_type == AST_IDENTIFIER && callee->data.identifier.symbol &&
+        callee->data.identifier.symbol->kind == SYMBOL_VALUE_INTRINSIC) {
+        return ce_fail(ce, e, "calls '%s'", ce_name(callee->data.identifier.intern_result));
+    }
+
+    CtValue fn;
+    if (!ce_expr(ce, call->callee, &fn)) return false;
+    if (fn.kind != CT_FN || !fn.as.fn.decl) return ce_fail(ce, e, "calls a null function pointer");
+    AstNode *decl = fn.as.fn.decl;
+    if (decl->node_type != AST_FUNCTION_DECLARATION) return ce_fail(ce, e, "calls something that is not a function");
+
+    AstFunctionDeclaration *fd = &decl->data.function_declaration;
+    const char *name = ce_name(fd->intern_result);
+    if (!fd->body) {
+        if (fd->link_name) return ce_fail(ce, e, "calls external function '%s'", name);
+        return ce_fail(ce, e, "calls '%s', whose body is not available", name);
+    }
+
+    Type *ft = decl->type;
+    if (!ft || ft->kind != TYPE_FUNCTION) {
+        ft = call->callee->type;
+        if (ft && ft->kind == TYPE_POINTER) ft = ft->as.ptr.base;
+    }
+    size_t argc = call->args ? call->args->count : 0;
+    size_t paramc = fd->params ? fd->params->count : 0;
+    if (!ft || ft->kind != TYPE_FUNCTION || ft->as.func.param_count != argc || paramc != argc) {
+        return ce_fail(ce, e, "calls '%s' with arguments it cannot evaluate", name);
+    }
+    if (ce->depth >= CE_MAX_DEPTH) return ce_fail(ce, e, "nests calls deeper than %d", CE_MAX_DEPTH);
+
+    // Arguments, and the slot the result lands in, belong to the caller
+    CtValue *args = ce_alloc(ce, ce->scratch, e, argc, sizeof(CtValue));
+    if (!args) return false;
+    for (size_t i = 0; i < argc; i++) {
+        if (!ce_expr(ce, DYNARRAY_AT(AstNode*, call->args, i), &args[i])) return false;
+    }
+    Type *ret_type = ft->as.func.return_type;
+    CtValue *ret = NULL;
+    if (ret_type && !type_is_void(ret_type)) {
+        ret = ce_new(ce, e, ret_type);
+        if (!ret) return false;
+    }
+
+    ArenaMark mark = arena_mark(ce->scratch);
+    CtFrame frame = { .ret = ret };
+    CtFrame *caller = ce->frame;
+    ce->frame = &frame;
+    ce->depth++;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < argc; i++) {
+        CtValue *slot = ce_new(ce, e, ft->as.func.params[i]);
+        ok = slot && ce_bind(ce, DYNARRAY_AT(AstNode*, fd->params, i), slot);
+        if (ok) ce_store(slot, &args[i]);
+    }
+    if (ok) ok = ce_stmt(ce, fd->body) != FLOW_FAIL;
+
+    ce->depth--;
+    ce->frame = caller;
+    arena_rewind(ce->scratch, mark);
+    if (!ok) return false;
+
+    *out = ret ? *ret : (CtValue){ .kind = CT_VOID };
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Expressions
+// -----------------------------------------------------------------------------
+
+static bool ce_aggregate(ConstEval *ce, AstNode *e, CtValue *out) {
+    Type *t = ce_concrete(e->type);
+    if (!t) return ce_fail(ce, e, "builds a value it cannot evaluate");
+
+    if (e->node_type == AST_STRUCT_LITERAL) {
+        if (t->kind != TYPE_STRUCT || !ce_zero(ce, ce->scratch, e, t, out)) {
+            return ce_fail(ce, e, "builds a value it cannot evaluate");
+        }
+        DYNARRAY_FOREACH(AstFieldInit, init, e->data.struct_literal.fields) {
+            size_t idx = 0;
+            while (idx < t->as.struct_type.field_count && t->as.struct_type.fields[idx].name != init->name) idx++;
+            if (idx == t->as.struct_type.field_count) return ce_fail(ce, e, "sets unknown field '%s'", ce_name(init->name));
+            CtValue v;
+            if (!ce_expr(ce, init->expr, &v)) return false;
+            ce_store(&out->as.agg.elems[idx], &v);
+        }
+        return true;
+    }
+
+    DynArray *elements = e->data.initializer_list.elements;
+    size_t n = elements ? elements->count : 0;
+    if (t->kind == TYPE_ARRAY || t->kind == TYPE_VECTOR) {
+        if (!ce_zero(ce, ce->scratch, e, t, out)) return false;
+    } else if (t->kind == TYPE_SLICE) {
+        // A slice literal points at an anonymous array of its elements
+        CtValue *elems = ce_alloc(ce, ce->scratch, e, n, sizeof(CtValue));
+        if (!elems) return false;
+        for (size_t i = 0; i < n; i++) {
+            if (!ce_zero(ce, ce->scratch, e, t->as.slice.base, &elems[i])) return false;
+        }
+        *out = (CtValue){ .kind = CT_AGG };
+        out->as.agg.elems = elems;
+        out->as.agg.count = n;
+    } else {
+        return ce_fail(ce, e, "builds a value it cannot evaluate");
+    }
+    for (size_t i = 0; i < n && i < out->as.agg.count; i++) {
+        CtValue v;
+        if (!ce_expr(ce, DYNARRAY_AT(AstNode*, elements, i), &v)) return false;
+        ce_store(&out->as.agg.elems[i], &v);
+    }
+    if (t->kind == TYPE_SLICE) {
+        CtValue *elems = out->as.agg.elems;
+        *out = (CtValue){ .kind = CT_PTR };
+        out->as.ptr.base = elems;
+        out->as.ptr.extent = (int64_t)n;
+        out->as.ptr.len = (int64_t)n;
+    }
+    return true;
+}
+
+static bool ce_symbol_value(ConstEval *ce, AstNode *e, Symbol *sym, CtValue *out) {
+    while (sym && sym->kind == SYMBOL_VALUE_ALIAS) sym = sym->target_symbol;
+    if (!sym) return ce_fail(ce, e, "reads a name it cannot resolve");
+    if (sym->kind == SYMBOL_VALUE_FUNCTION) {
+        *out = (CtValue){ .kind = CT_FN };
+        out->as.fn.decl = sym->decl_node;
+        out->as.fn.sym = sym;
+        return true;
+    }
+    if (sym->kind != SYMBOL_VARIABLE) return ce_fail(ce, e, "uses '%s', which has no value at compile time", ce_name(sym->name_rec));
+    CtPlace pl;
+    if (!ce_symbol_place(ce, e, sym, &pl)) return false;
+    *out = ce_load(&pl);
+    return true;
+}
+
+/* Hints evaluate to their operand; a false @assume or a reached @unreachable stops evaluation. */
+static bool ce_hint(ConstEval *ce, AstNode *e, CtValue *out) {
+    DynArray *args = e->data.intrinsic.args;
+    *out = (CtValue){ .kind = CT_VOID };
+    switch (e->data.intrinsic.kind) {
+        case INTRINSIC_LIKELY:
+        case INTRINSIC_UNLIKELY:
+            return ce_expr(ce, DYNARRAY_AT(AstNode*, args, 0), out);
+        case INTRINSIC_ASSUME: {
+            CtValue cond;
+            if (!ce_expr(ce, DYNARRAY_AT(AstNode*, args, 0), &cond)) return false;
+            return ce_truthy(&cond) || ce_fail(ce, e, "breaks an @assume");
+        }
+        case INTRINSIC_PREFETCH:
+            return true;
+        default:
+            return ce_fail(ce, e, "reaches @unreachable");
+    }
+}
+
+/* Math intrinsics on scalars, with libm at double precision rounded to the operand type. */
+static bool ce_math(ConstEval *ce, AstNode *e, CtValue *out) {
+    DynArray *args = e->data.intrinsic.args;
+    IntrinsicKind kind = e->data.intrinsic.kind;
+    Type *t = ce_concrete(e->type);
+    if (t && t->kind == TYPE_VECTOR) return ce_fail(ce, e, "computes on a vector");
+    CtValue v[3];
+    for (size_t i = 0; i < args->count; i++) {
+        if (!ce_expr(ce, DYNARRAY_AT(AstNode*, args, i), &v[i])) return false;
+    }
+
+    if (!type_is_float(t)) {
+        int64_t a = v[0].as.i, b = args->count > 1 ? v[1].as.i : 0;
+        bool less = type_is_unsigned(t) ? (uint64_t)a < (uint64_t)b : a < b;
+        int64_t r = kind == INTRINSIC_ABS ? (type_is_unsigned(t) || a >= 0 ? a : (int64_t)(0 - (uint64_t)a))
+                  : kind == INTRINSIC_MIN ? (less ? a : b) : (less ? b : a);
+        *out = ce_int(ce_wrap(r, t));
+        return true;
+    }
+
+    double a = v[0].as.f, b = args->count > 1 ? v[1].as.f : 0.0, r;
+    switch (kind) {
+        case INTRINSIC_SQRT:     r = sqrt(a); break;
+        case INTRINSIC_FLOOR:    r = floor(a); break;
+        case INTRINSIC_CEIL:     r = ceil(a); break;
+        case INTRINSIC_TRUNC:    r = trunc(a); break;
+        case INTRINSIC_ROUND:    r = round(a); break;
+        case INTRINSIC_SIN:      r = sin(a); break;
+        case INTRINSIC_COS:      r = cos(a); break;
+        case INTRINSIC_EXP:      r = exp(a); break;
+        case INTRINSIC_EXP2:     r = exp2(a); break;
+        case INTRINSIC_LOG:      r = log(a); break;
+        case INTRINSIC_LOG2:     r = log2(a); break;
+        case INTRINSIC_LOG10:    r = log10(a); break;
+        case INTRINSIC_ABS:      r = fabs(a); break;
+        case INTRINSIC_MIN:      r = fmin(a, b); break;
+        case INTRINSIC_MAX:      r = fmax(a, b); break;
+        case INTRINSIC_COPYSIGN: r = copysign(a, b); break;
+        case INTRINSIC_POW:      r = pow(a, b); break;
+        default: // f32 must round once too
+            r = t->kind == TYPE_PRIMITIVE && t->as.primitive == PRIM_F32 ? fmaf((float)a, (float)b, (float)v[2].as.f) : fma(a, b, v[2].as.f);
+            break;
+    }
+    *out = (CtValue){ .kind = CT_FLOAT };
+    out->as.f = ce_round(r, t);
+    return true;
+}
+
+static bool ce_expr(ConstEval *ce, AstNode *e, CtValue *out) {
+    if (!e) return ce_fail(ce, NULL, "evaluates a missing expression");
+    if (e->is_foldable_const) return ce_const(ce, e, &e->const_value, out);
+
+    switch (e->node_type) {
+        case AST_LITERAL:
+            return ce_const(ce, e, &e->data.literal, out);
+        case AST_IDENTIFIER:
+            return ce_symbol_value(ce, e, e->data.identifier.symbol, out);
+        case AST_MEMBER_EXPR: {
+            if (e->data.member_expr.symbol) return ce_symbol_value(ce, e, e->data.member_expr.symbol, out);
+            CtPlace pl;
+            if (!ce_member_place(ce, e, &pl)) return false;
+            *out = ce_load(&pl);
+            return true;
+        }
+        case AST_SUBSCRIPT_EXPR: {
+            CtPlace pl;
+            if (!ce_subscript_place(ce, e, &pl)) return false;
+            *out = ce_load(&pl);
+            return true;
+        }
+        case AST_GENERIC_INST_EXPR:
+            return ce_expr(ce, e->data.generic_inst_expr.base, out);
+        case AST_CALL_EXPR:
+            return ce_call(ce, e, out);
+        case AST_STRUCT_LITERAL:
+        case AST_INITIALIZER_LIST:
+            return ce_aggregate(ce, e, out);
+        case AST_CAST:
+            return ce_cast(ce, e, out);
+        case AST_BINARY_EXPR: {
+            AstBinaryExpr *bin = &e->data.binary_expr;
+            CtValue l, r;
+            if (!ce_expr(ce, bin->left, &l) || !ce_expr(ce, bin->right, &r)) return false;
+            return ce_arith(ce, e, bin->op, bin->left->type, e->type, &l, &r, out);
+        }
+        case AST_UNARY_EXPR:
+            return ce_unary(ce, e, out);
+        case AST_ASSIGNMENT_EXPR:
+            return ce_assign(ce, e, out);
+        case AST_INTRINSIC:
+            if (intrinsic_is_hint(e->data.intrinsic.kind)) return ce_hint(ce, e, out);
+            if (e->data.intrinsic.kind == INTRINSIC_TAIL) return ce_expr(ce, DYNARRAY_AT(AstNode*, e->data.intrinsic.args, 0), out);
+            if (intrinsic_is_math(e->data.intrinsic.kind)) return ce_math(ce, e, out);
+            if (intrinsic_is_atomic(e->data.intrinsic.kind)) return ce_fail(ce, e, "synchronizes with other threads");
+            return ce_fail(ce, e, "allocates or frees memory");
+        default:
+            return ce_fail(ce, e, "uses an expression it cannot evaluate");
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Statements
+// -----------------------------------------------------------------------------
+
+static CtFlow ce_condition(ConstEval *ce, AstNode *cond, bool *truthy) {
+    CtValue v;
+    if (!ce_expr(ce, cond, &v)) return FLOW_FAIL;
+    *truthy = ce_truthy(&v);
+    return FLOW_NEXT;
+}
+
+/* Runs a loop body; FLOW_NEXT means go on with the next iteration. */
+static CtFlow ce_loop_body(ConstEval *ce, AstNode *body, bool *stop) {
+    CtFlow flow = ce_stmt(ce, body);
+    *stop = flow == FLOW_BREAK || flow == FLOW_RETURN || flow == FLOW_FAIL;
+    if (flow == FLOW_BREAK || flow == FLOW_CONTINUE) flow = FLOW_NEXT;
+    return flow;
+}
+
+/* for (x in range): copies every element of the array or slice into x in turn. */
+static CtFlow ce_range_for(ConstEval *ce, AstNode *s) {
+    AstForStatement *fs = &s->data.for_statement;
+    Type *t = ce_concrete(fs->range->type);
+    CtValue range = {0};
+    CtValue *elems = NULL;
+    int64_t count = 0;
+    if (t && t->kind == TYPE_ARRAY) {
+        CtPlace arr;
+        if (!ce_place(ce, fs->range, &arr)) return FLOW_FAIL;
+        CtValue *a = &arr.base[arr.index];
+        if (arr.str || a->kind != CT_AGG) {
+            ce_fail(ce, fs->range, "iterates a value it cannot evaluate");
+            return FLOW_FAIL;
+        }
+        elems = a->as.agg.elems;
+        count = (int64_t)a->as.agg.count;
+    } else {
+        if (!ce_expr(ce, fs->range, &range)) return FLOW_FAIL;
+        count = range.as.ptr.len;
+    }
+
+    if (ce_stmt(ce, fs->init) == FLOW_FAIL) return FLOW_FAIL;
+    CtValue *var = ce_lookup(ce, fs->init);
+    for (int64_t i = 0; i < count; i++) {
+        CtPlace pl = { .base = elems, .index = i, .extent = count };
+        if (!elems && !ce_deref(ce, fs->range, &range, i, &pl)) return FLOW_FAIL;
+        CtValue v = ce_load(&pl);
+        ce_store(var, &v);
+        bool stop;
+        CtFlow flow = ce_loop_body(ce, fs->body, &stop);
+        if (stop) return flow;
+    }
+    return FLOW_NEXT;
+}
+
+static CtFlow ce_stmt(ConstEval *ce, AstNode *s) {
+    if (!s) return FLOW_NEXT;
+    if (++ce->steps > CE_MAX_STEPS) {
+        ce_fail(ce, s, "does not finish within %llu steps", (unsigned long long)CE_MAX_STEPS);
+        return FLOW_FAIL;
+    }
+
+    switch (s->node_type) {
+        case AST_BLOCK: {
+            CtDefer *outer = ce->frame->defers;
+            CtFlow flow = FLOW_NEXT;
+            if (s->data.block.statements) {
+                DYNARRAY_FOREACH(AstNode*, it, s->data.block.statements) {
+                    flow = ce_stmt(ce, *it);
+                    if (flow != FLOW_NEXT) break;
+                }
+            }
+            // Defers of this block run on every way out of it, newest first
+            while (ce->frame->defers != outer) {
+                CtDefer *d = ce->frame->defers;
+                ce->frame->defers = d->next;
+                if (flow != FLOW_FAIL && ce_stmt(ce, d->body) == FLOW_FAIL) flow = FLOW_FAIL;
+            }
+            return flow;
+        }
+        case AST_IF_STATEMENT: {
+            AstIfStatement *ifs = &s->data.if_statement;
+            bool truthy;
+            if (ce_condition(ce, ifs->condition, &truthy) == FLOW_FAIL) return FLOW_FAIL;
+            return ce_stmt(ce, truthy ? ifs->then_branch : ifs->else_branch);
+        }
+        case AST_WHILE_STATEMENT: {
+            AstWhileStatement *wh = &s->data.while_statement;
+            for (;;) {
+                bool truthy, stop;
+                if (ce_condition(ce, wh->condition, &truthy) == FLOW_FAIL) return FLOW_FAIL;
+                if (!truthy) return FLOW_NEXT;
+                CtFlow flow = ce_loop_body(ce, wh->body, &stop);
+                if (stop) return flow;
+            }
+        }
+        case AST_FOR_STATEMENT: {
+            AstForStatement *fs = &s->data.for_statement;
+            if (fs->range) return ce_range_for(ce, s);
+            if (ce_stmt(ce, fs->init) == FLOW_FAIL) return FLOW_FAIL;
+            for (;;) {
+                bool truthy = true, stop;
+                if (fs->condition && ce_condition(ce, fs->condition, &truthy) == FLOW_FAIL) return FLOW_FAIL;
+                if (!truthy) return FLOW_NEXT;
+                CtFlow flow = ce_loop_body(ce, fs->body, &stop);
+                if (stop) return flow;
+                CtValue ignored;
+                if (fs->post && !ce_expr(ce, fs->post, &ignored)) return FLOW_FAIL;
+            }
+        }
+        case AST_SWITCH_STATEMENT: {
+            AstSwitchStatement *sw = &s->data.switch_statement;
+            CtValue subject;
+            if (!ce_expr(ce, sw->subject, &subject)) return FLOW_FAIL;
+            DYNARRAY_FOREACH(AstNode*, arm_it, sw->cases) {
+                AstSwitchCase *arm = &(*arm_it)->data.switch_case;
+                DYNARRAY_FOREACH(AstNode*, value_it, arm->values) {
+                    CtValue v;
+                    if (!ce_expr(ce, *value_it, &v)) return FLOW_FAIL;
+                    if (v.as.i == subject.as.i) return ce_stmt(ce, arm->body);
+                }
+            }
+            return ce_stmt(ce, sw->else_body);
+        }
+        case AST_RETURN_STATEMENT: {
+            AstNode *value = s->data.return_statement.expression;
+            if (value) {
+                CtValue v;
+                if (!ce_expr(ce, value, &v)) return FLOW_FAIL;
+                if (ce->frame->ret) ce_store(ce->frame->ret, &v);
+            }
+            return FLOW_RETURN;
+        }
+        case AST_BREAK_STATEMENT:
+            return FLOW_BREAK;
+        case AST_CONTINUE_STATEMENT:
+            return FLOW_CONTINUE;
+        case AST_DEFER_STATEMENT: {
+            CtDefer *d = ce_alloc(ce, ce->scratch, s, 1, sizeof(CtDefer));
+            if (!d) return FLOW_FAIL;
+            d->body = s->data.defer_statement.body;
+            d->next = ce->frame->defers;
+            ce->frame->defers = d;
+            return FLOW_NEXT;
+        }
+        case AST_VARIABLE_DECLARATION: {
+            // A declaration run again (in a loop) keeps its storage, like its alloca
+            CtValue *slot = ce_lookup(ce, s);
+            if (!slot) {
+                slot = ce_new(ce, s, s->type);
+                if (!slot || !ce_bind(ce, s, slot)) return FLOW_FAIL;
+            }
+            AstNode *init = s->data.variable_declaration.initializer;
+            if (init) {
+                CtValue v;
+                if (!ce_expr(ce, init, &v)) return FLOW_FAIL;
+                ce_store(slot, &v);
+            }
+            return FLOW_NEXT;
+        }
+        case AST_EXPR_STATEMENT: {
+            CtValue ignored;
+            return ce_expr(ce, s->data.expr_statement.expression, &ignored) ? FLOW_NEXT : FLOW_FAIL;
+        }
+        case AST_ASSIGNMENT_EXPR:
+        case AST_CALL_EXPR:
+        case AST_UNARY_EXPR:
+        case AST_INTRINSIC: {
+            CtValue ignored;
+            return ce_expr(ce, s, &ignored) ? FLOW_NEXT : FLOW_FAIL;
+        }
+        default:
+            return FLOW_NEXT;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Writing values back as nodes
+// -----------------------------------------------------------------------------
+
+static AstNode *ce_node(ConstEval *ce, AstNodeType kind, AstNode *origin, Type *t) {
+    AstNode *n = ast_create_node(kind, ce->tc->arena, origin->span.file);
+    n->span = origin->span;
+    n->type = t;
+    n->is_llvm_const_safe = 1;
+    n->flags |= AST_FLAG_CHECKED;
+    return n;
+}
+
+static AstNode *ce_literal(ConstEval *ce, AstNode *origin, Type *t, ConstValue cv) {
+    AstNode *n = ce_node(ce, AST_LITERAL, origin, t);
+    n->data.literal = cv;
+    n->const_value = cv;
+    n->is_foldable_const = 1;
+    return n;
+}
+
+/* Nodes codegen turns into the constant `v` of type `t`; NULL if there are none. */
+static AstNode *ce_materialize(ConstEval *ce, AstNode *origin, Type *t, const CtValue *v) {
+    Type *ct = ce_concrete(t);
+    if (!ct) return NULL;
+    ConstValue cv = {0};
+
+    switch (ct->kind) {
+        case TYPE_PRIMITIVE:
+        case TYPE_ENUM:
+            if (type_is_float(ct)) {
+                cv.type = FLOAT_LITERAL;
+                cv.value.float_val = v->as.f;
+            } else if (type_is_bool(ct)) {
+                cv.type = BOOL_LITERAL;
+                cv.value.bool_val = v->as.i != 0;
+            } else if (type_is_char(ct)) {
+                cv.type = CHAR_LITERAL;
+                cv.value.char_val = (char)v->as.i;
+            } else {
+                int bits = ce_int_bits(ct);
+                cv.type = INT_LITERAL;
+                cv.value.int_val = (type_is_unsigned(ct) && bits < 64)
+                    ? (long long)((uint64_t)v->as.i & (UINT64_MAX >> (64 - bits)))
+                    : v->as.i;
+            }
+            return ce_literal(ce, origin, t, cv);
+
+        case TYPE_FUNCTION: {
+            if (!v->as.fn.decl) {
+                cv.type = NULL_LITERAL;
+                return ce_literal(ce, origin, t, cv);
+            }
+            AstNode *n = ce_node(ce, AST_IDENTIFIER, origin, t);
+            n->data.identifier.intern_result = v->as.fn.sym->name_rec;
+            n->data.identifier.symbol = v->as.fn.sym;
+            return n;
+        }
+
+        case TYPE_POINTER:
+        case TYPE_SLICE: {
+            if (!v->as.ptr.base && !v->as.ptr.str) {
+                cv.type = NULL_LITERAL;
+                return ce_literal(ce, origin, t, cv);
+            }
+            if (ct->kind == TYPE_SLICE) return NULL;
+            if (v->as.ptr.str) {
+                if (v->as.ptr.index != 0) return NULL;
+                cv.type = STRING_LITERAL;
+                cv.value.string_val = v->as.ptr.str;
+                return ce_literal(ce, origin, t, cv);
+            }
+            // `&global`, for a pointer to the whole of one
+            CtGlobal *g = v->as.ptr.index == 0 ? ptrmap_get(ce->owners, v->as.ptr.base) : NULL;
+            if (!g || !g->sym) return NULL;
+            AstNode *ident = ce_node(ce, AST_IDENTIFIER, origin, g->decl->type);
+            ident->is_llvm_const_safe = 0;
+            ident->data.identifier.intern_result = g->sym->name_rec;
+            ident->data.identifier.symbol = g->sym;
+            AstNode *n = ce_node(ce, AST_UNARY_EXPR, origin, t);
+            n->data.unary_expr.op = OP_ADDRESS;
+            n->data.unary_expr.expr = ident;
+            return n;
+        }
+
+        case TYPE_ARRAY:
+        case TYPE_VECTOR: {
+            if (v->kind != CT_AGG) return NULL;
+            Type *base = ct->kind == TYPE_VECTOR ? ct->as.vector.base : ct->as.array.base;
+            AstNode *n = ce_node(ce, AST_INITIALIZER_LIST, origin, t);
+            DynArray *elems = arena_alloc(ce->tc->arena, sizeof(DynArray));
+            dynarray_init_in_arena(elems, ce->tc->arena, sizeof(AstNode*), v->as.agg.count ? v->as.agg.count : 1);
+            for (size_t i = 0; i < v->as.agg.count; i++) {
+                AstNode *elem = ce_materialize(ce, origin, base, &v->as.agg.elems[i]);
+                if (!elem) return NULL;
+                dynarray_push_ptr(elems, elem);
+            }
+            n->data.initializer_list.elements = elems;
+            return n;
+        }
+
+        case TYPE_STRUCT: {
+            if (v->kind != CT_AGG) return NULL;
+            AstNode *n = ce_node(ce, AST_STRUCT_LITERAL, origin, t);
+            DynArray *fields = arena_alloc(ce->tc->arena, sizeof(DynArray));
+            dynarray_init_in_arena(fields, ce->tc->arena, sizeof(AstFieldInit), ct->as.struct_type.field_count ? ct->as.struct_type.field_count : 1);
+            for (size_t i = 0; i < ct->as.struct_type.field_count && i < v->as.agg.count; i++) {
+                AstFieldInit init = { .name = ct->as.struct_type.fields[i].name };
+                init.expr = ce_materialize(ce, origin, ct->as.struct_type.fields[i].type, &v->as.agg.elems[i]);
+                if (!init.expr) return NULL;
+                dynarray_push_value(fields, &init);
+            }
+            n->data.struct_literal.fields = fields;
+            return n;
+        }
+
+        default:
+            return NULL;
+    }
+}
+
+/* A scalar `const` becomes foldable for anything checked after this pass. */
+static void ce_record_const(CompilationUnit *unit, AstNode *decl, const ConstValue *cv) {
+    AstVariableDeclaration *var = &decl->data.variable_declaration;
+    if (!var->is_const || !unit->global_scope) return;
+    Symbol *sym = scope_lookup_symbol_local(unit->global_scope, var->intern_result);
+    if (!sym || sym->decl_node != decl) return;
+    switch (cv->type) {
+        case INT_LITERAL:   sym->value.int_val = cv->value.int_val; break;
+        case FLOAT_LITERAL: sym->value.float_val = cv->value.float_val; break;
+        case BOOL_LITERAL:  sym->value.bool_val = (bool)cv->value.bool_val; break;
+        case CHAR_LITERAL:  sym->value.int_val = (int64_t)cv->value.char_val; break;
+        default: return;
+    }
+    sym->flags |= SYMBOL_FLAG_CONST | SYMBOL_FLAG_COMPUTED_VALUE;
+}
+
+// -----------------------------------------------------------------------------
+// Entry point
+// -----------------------------------------------------------------------------
+
+static void ce_report(ConstEval *ce, AstNode *decl, CtGlobal *g) {
+    TypeError err = { .kind = TE_CONST_EVAL, .span = decl->span };
+    // Point at the failing construct when it is in the same module
+    if (g->where && g->where->span.file == decl->span.file) err.span = g->where->span;
+    err.as.const_eval.name = ce_name(decl->data.variable_declaration.intern_result);
+    err.as.const_eval.reason = g->reason;
+    dynarray_push_value(ce->tc->errors, &err);
+}
+
+void const_eval_program(TypeCheckContext *ctx) {
+    ConstEval ce = { .tc = ctx };
+    ce.scratch = arena_create(64 * 1024);
+    ce.statics = arena_create(64 * 1024);
+    ce.globals = hashmap_create(ce.statics, 64);
+    ce.owners = hashmap_create(ce.statics, 64);
+
+    // Every global can be read, whether or not its own initializer needs us
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        AstNode *root = (*unit_it)->ast_root;
+        if (!root || !root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type != AST_VARIABLE_DECLARATION || !decl->type) continue;
+            CtGlobal *g = arena_calloc(ce.statics, sizeof(CtGlobal));
+            g->decl = decl;
+            ptrmap_put(ce.globals, decl, g);
+        }
+    }
+
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        AstNode *root = unit->ast_root;
+        if (!root || !root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type != AST_VARIABLE_DECLARATION || !decl->type) continue;
+            AstNode *init = decl->data.variable_declaration.initializer;
+            if (!init || init->is_llvm_const_safe) continue;
+
+            CtGlobal *g = ptrmap_get(ce.globals, decl);
+            if (g->state == GLOBAL_PENDING) ce_eval_global(&ce, g);
+            if (g->state != GLOBAL_DONE) {
+                ce_report(&ce, decl, g);
+                continue;
+            }
+            AstNode *value = ce_materialize(&ce, init, decl->type, g->storage);
+            if (!value) continue; // Left to codegen as it was
+            decl->data.variable_declaration.initializer = value;
+            if (value->is_foldable_const) ce_record_const(unit, decl, &value->const_value);
+        }
+    }
+
+    arena_destroy(ce.scratch);
+    arena_destroy(ce.statics);
+}
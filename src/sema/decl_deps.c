@@ -0,0 +1,292 @@
+#include "sema/decl_deps.h"
+#include "parsing/ast.h"
+#include "parsing/parse_declarations.h"
+#include "datastructures/dynamic_array.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/scope.h"
+#include "core/module_loader.h"
+#include "core/source_map.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DECL_DEPS_FORMAT_VERSION 2
+
+typedef enum { MIX_NONE, MIX_INTERFACE, MIX_FULL } MixDepth;
+
+typedef struct {
+    Arena *arena;
+    HashMap *by_name; // InternResult* -> DynArray<AstNode*>: top-level declarations of every unit
+    HashMap *seen;    // decl -> MixDepth already folded into `h`
+    uint64_t h;
+    MixDepth reach;   // How deep the declarations the current names refer to are folded
+} DepWalk;
+
+static uint64_t mix_bytes(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t mix_str(uint64_t h, const char *s) {
+    return mix_bytes(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+/* Source bytes [start, end) of `file`, and their length. */
+static uint64_t mix_text(uint64_t h, SourceId file, uint32_t start, uint32_t end) {
+    size_t len = 0;
+    const char *text = source_text(file, &len);
+    if (!text || start > end || end > len) return mix_bytes(h, "?", 1);
+    uint32_t count = end - start;
+    h = mix_bytes(h, &count, sizeof(count));
+    return mix_bytes(h, text + start, count);
+}
+
+/* The body of `func`, parsing a deferred one; NULL if it does not parse (pass 2 reports that). */
+static AstNode *function_body(DepWalk *w, AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->body || !decl->lazy_body) return decl->body;
+    const char *msg = NULL;
+    Span span = func->span;
+    AstNode *body = parse_deferred_body(func, w->arena, &msg, &span);
+    if (body) decl->body = body;
+    return body;
+}
+
+/* Where the signature of `func` ends: its body's `{`, or the declaration's end. */
+static uint32_t signature_end(AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->lazy_body) return decl->body_start;
+    if (decl->body) return decl->body->span.start;
+    return func->span.end;
+}
+
+static InternResult *decl_name(AstNode *decl) {
+    switch (decl->node_type) {
+        case AST_FUNCTION_DECLARATION: return decl->data.function_declaration.intern_result;
+        case AST_STRUCT_DECLARATION:   return decl->data.struct_declaration.intern_result;
+        case AST_ENUM_DECLARATION:     return decl->data.enum_declaration.intern_result;
+        case AST_ALIAS_DECLARATION:    return decl->data.alias_declaration.alias_name;
+        case AST_VARIABLE_DECLARATION: return decl->data.variable_declaration.intern_result;
+        default: return NULL;
+    }
+}
+
+static uint64_t mix_interned(uint64_t h, InternResult *name) {
+    Slice *key = name ? (Slice*)name->key : NULL;
+    if (!key) return mix_bytes(h, "", 1);
+    h = mix_bytes(h, &key->len, sizeof(key->len));
+    return mix_bytes(h, key->ptr, key->len);
+}
+
+static void index_decl(DepWalk *w, AstNode *decl) {
+    InternResult *name = decl_name(decl);
+    if (!name) return;
+    DynArray *decls = ptrmap_get(w->by_name, name);
+    if (!decls) {
+        decls = arena_alloc(w->arena, sizeof(DynArray));
+        dynarray_init_in_arena(decls, w->arena, sizeof(AstNode*), 2);
+        ptrmap_put(w->by_name, name, decls);
+    }
+    dynarray_push_value(decls, &decl);
+}
+
+static void mix_decl(DepWalk *w, AstNode *decl, MixDepth depth);
+
+static void mix_name(InternResult *name, void *user) {
+    DepWalk *w = user;
+    DynArray *decls = name ? ptrmap_get(w->by_name, name) : NULL;
+    if (!decls) return;
+    DYNARRAY_FOREACH(AstNode*, decl_it, decls) mix_decl(w, *decl_it, w->reach);
+}
+
+/* Fold the names `node` mentions, reaching what they name at `reach`. */
+static void mix_names_of(DepWalk *w, AstNode *node, MixDepth reach) {
+    MixDepth saved = w->reach;
+    w->reach = reach;
+    ast_visit_names(node, mix_name, w);
+    w->reach = saved;
+}
+
+/*
+ * Fold `decl` into the key: its interface, or with MIX_FULL its whole
+ * source and everything that source can reach at compile time.
+ */
+static void mix_decl(DepWalk *w, AstNode *decl, MixDepth depth) {
+    MixDepth have = (MixDepth)(uintptr_t)ptrmap_get(w->seen, decl);
+    if (have >= depth) return;
+    ptrmap_put(w->seen, decl, (void*)(uintptr_t)depth);
+
+    w->h = mix_str(w->h, source_path(decl->span.file));
+    w->h = mix_bytes(w->h, &decl->node_type, sizeof(decl->node_type));
+    switch (decl->node_type) {
+        case AST_FUNCTION_DECLARATION: {
+            AstFunctionDeclaration *func = &decl->data.function_declaration;
+            w->h = mix_bytes(w->h, &func->is_pub, sizeof(func->is_pub));
+            w->h = mix_bytes(w->h, &func->attrs, sizeof(func->attrs));
+            if (depth == MIX_FULL) {
+                w->h = mix_text(w->h, decl->span.file, decl->span.start, decl->span.end);
+                function_body(w, decl);
+                mix_names_of(w, decl, MIX_FULL);
+            } else {
+                w->h = mix_text(w->h, decl->span.file, decl->span.start, signature_end(decl));
+                mix_names_of(w, func->target_type_node, MIX_INTERFACE);
+                if (func->params) {
+                    DYNARRAY_FOREACH(AstNode*, param_it, func->params) mix_names_of(w, *param_it, MIX_INTERFACE);
+                }
+                mix_names_of(w, func->return_type, MIX_INTERFACE);
+            }
+            break;
+        }
+        case AST_STRUCT_DECLARATION:
+            w->h = mix_bytes(w->h, &decl->data.struct_declaration.is_pub, sizeof(int));
+            // Layout attributes precede the span
+            w->h = mix_bytes(w->h, &decl->data.struct_declaration.attrs, sizeof(uint8_t));
+            w->h = mix_bytes(w->h, &decl->data.struct_declaration.align, sizeof(uint32_t));
+            w->h = mix_text(w->h, decl->span.file, decl->span.start, decl->span.end);
+            mix_names_of(w, decl, MIX_INTERFACE);
+            break;
+        case AST_ENUM_DECLARATION: {
+            // The declaration's span only covers its name
+            AstEnumDeclaration *en = &decl->data.enum_declaration;
+            w->h = mix_bytes(w->h, &en->is_pub, sizeof(en->is_pub));
+            w->h = mix_interned(w->h, en->intern_result);
+            if (en->variants) {
+                DYNARRAY_FOREACH(AstEnumVariant, variant, en->variants) {
+                    w->h = mix_interned(w->h, variant->name);
+                    if (variant->value) w->h = mix_text(w->h, variant->value->span.file, variant->value->span.start, variant->value->span.end);
+                }
+            }
+            mix_names_of(w, decl, MIX_INTERFACE);
+            break;
+        }
+        case AST_ALIAS_DECLARATION:
+            w->h = mix_text(w->h, decl->span.file, decl->span.start, decl->span.end);
+            mix_names_of(w, decl, MIX_INTERFACE);
+            break;
+        case AST_VARIABLE_DECLARATION:
+            // Initializers may be folded or evaluated into the readers
+            w->h = mix_bytes(w->h, &decl->data.variable_declaration.is_pub, sizeof(int));
+            w->h = mix_text(w->h, decl->span.file, decl->span.start, decl->span.end);
+            mix_names_of(w, decl, MIX_FULL);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Templates are checked per instance; their instances are never cached. */
+static bool is_template(Scope *scope, AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->type_params && decl->type_params->count > 0) return true;
+    if (decl->target_type_node && decl->target_type_node->node_type == AST_IDENTIFIER) {
+        Symbol *target = scope_lookup_symbol(scope, decl->target_type_node->data.identifier.intern_result, func->span.file);
+        if (target && target->kind == SYMBOL_GENERIC_STRUCT) return true;
+    }
+    return false;
+}
+
+static bool cacheable(CompilationUnit *unit, AstNode *func, HashMap *const_eval_reach) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->link_name || (!decl->body && !decl->lazy_body) || !func->type) return false;
+    if (is_template(unit->global_scope, func)) return false;
+    return (MixDepth)(uintptr_t)ptrmap_get(const_eval_reach, func) != MIX_FULL;
+}
+
+static uint64_t body_key(DepWalk *w, CompilationUnit *unit, AstNode *func, int opt_level) {
+    int version = DECL_DEPS_FORMAT_VERSION;
+    w->h = 0x6c62272e07bb0142ULL;
+    w->h = mix_bytes(w->h, &version, sizeof(version));
+    w->h = mix_bytes(w->h, &opt_level, sizeof(opt_level));
+    w->h = mix_str(w->h, unit->logical_path);
+
+    // Imports decide which declaration a name resolves to
+    DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+        AstNode *decl = *decl_it;
+        if (decl->node_type != AST_IMPORT_DECLARATION) continue;
+        w->h = mix_text(w->h, decl->span.file, decl->span.start, decl->span.end);
+        w->h = mix_str(w->h, decl->data.import_declaration.resolved_logical_path);
+    }
+
+    hashmap_destroy(w->seen, NULL, NULL);
+    w->seen = hashmap_create(NULL, 64);
+    w->h = mix_text(w->h, func->span.file, func->span.start, func->span.end);
+    w->h = mix_bytes(w->h, &func->data.function_declaration.attrs, sizeof(uint8_t));
+    ptrmap_put(w->seen, func, (void*)(uintptr_t)MIX_FULL);
+    function_body(w, func);
+    mix_names_of(w, func, MIX_INTERFACE);
+    return w->h;
+}
+
+static void plan_body(DepWalk *w, CompilationUnit *unit, AstNode *func, HashMap *const_eval_reach, const char *cache_dir, int opt_level) {
+    if (!cacheable(unit, func, const_eval_reach)) return;
+    uint64_t key = body_key(w, unit, func, opt_level);
+
+    size_t len = strlen(cache_dir) + 32;
+    char *path = arena_alloc(w->arena, len);
+    snprintf(path, len, "%s/%016llx.o", cache_dir, (unsigned long long)key);
+    if (!unit->body_objects) unit->body_objects = hashmap_create(w->arena, 16);
+    ptrmap_put(unit->body_objects, func, path);
+
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        fclose(f);
+        func->flags |= AST_FLAG_REUSED;
+    }
+}
+
+void decl_deps_program(TypeCheckContext *ctx) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return;
+    Options *opts = ctx->loader->opts;
+    if (!opts || !opts->incremental || !opts->cache_dir || opts->run_executable || opts->print_ir) return;
+    if (opts->profile_generate || opts->profile_use) return; // Every body is compiled again
+
+    DynArray *units = ctx->loader->units_ordered;
+    DepWalk w = { .arena = ctx->arena, .by_name = hashmap_create(NULL, 256), .seen = hashmap_create(NULL, 64) };
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+                DYNARRAY_FOREACH(AstNode*, method_it, decl->data.impl_declaration.methods) index_decl(&w, *method_it);
+            } else {
+                index_decl(&w, decl);
+            }
+        }
+    }
+
+    // Pass 3 interprets whatever the global initializers reach
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            if ((*decl_it)->node_type == AST_VARIABLE_DECLARATION) mix_decl(&w, *decl_it, MIX_FULL);
+        }
+    }
+    HashMap *const_eval_reach = w.seen;
+    w.seen = hashmap_create(NULL, 64);
+
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (unit->is_library || !unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type == AST_FUNCTION_DECLARATION) {
+                plan_body(&w, unit, decl, const_eval_reach, opts->cache_dir, opts->opt_level);
+            } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+                AstImplDeclaration *impl = &decl->data.impl_declaration;
+                if (impl->type_params && impl->type_params->count > 0) continue;
+                DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                    plan_body(&w, unit, *method_it, const_eval_reach, opts->cache_dir, opts->opt_level);
+                }
+            }
+        }
+    }
+
+    hashmap_destroy(const_eval_reach, NULL, NULL);
+    hashmap_destroy(w.seen, NULL, NULL);
+    hashmap_destroy(w.by_name, NULL, NULL);
+}
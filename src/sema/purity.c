@@ -0,0 +1,358 @@
+#include "sema/purity.h"
+#include "parsing/ast.h"
+#include "datastructures/dynamic_array.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/scope.h"
+#include "sema/type_report.h"
+#include "core/module_loader.h"
+
+typedef enum { ACCESS_ADDRESS, ACCESS_READ, ACCESS_WRITE } Access;
+
+typedef struct {
+    HashMap *globals; // module-level variable declarations
+    uint8_t memory;   // FunctionMemory of the body walked so far
+    AstNode *where;   // What first made it FN_MEMORY_ANY
+} PurityWalk;
+
+static void lower(PurityWalk *w, uint8_t memory, AstNode *where) {
+    if (memory >= w->memory) return;
+    w->memory = memory;
+    if (memory == FN_MEMORY_ANY && !w->where) w->where = where;
+}
+
+static bool is_global(PurityWalk *w, Symbol *sym) {
+    return sym && sym->kind == SYMBOL_VARIABLE && sym->decl_node && ptrmap_get(w->globals, sym->decl_node);
+}
+
+static void global_access(PurityWalk *w, AstNode *node, Access access) {
+    if (access == ACCESS_WRITE) lower(w, FN_MEMORY_ANY, node);
+    else if (access == ACCESS_READ && !node->is_foldable_const) lower(w, FN_MEMORY_READ, node);
+}
+
+/* Memory reached through a pointer or slice. */
+static void indirect_access(PurityWalk *w, AstNode *node, Access access) {
+    if (access == ACCESS_WRITE) lower(w, FN_MEMORY_ANY, node);
+    else if (access == ACCESS_READ) lower(w, FN_MEMORY_READ, node);
+}
+
+static bool is_pointer(AstNode *node) {
+    return node && node->type && node->type->kind == TYPE_POINTER;
+}
+
+AstNode *purity_callee_decl(AstNode *callee) {
+    if (callee->node_type == AST_GENERIC_INST_EXPR) callee = callee->data.generic_inst_expr.base;
+    Symbol *sym = NULL;
+    if (callee->node_type == AST_IDENTIFIER) sym = callee->data.identifier.symbol;
+    else if (callee->node_type == AST_MEMBER_EXPR) sym = callee->data.member_expr.symbol;
+    while (sym && sym->kind == SYMBOL_VALUE_ALIAS) sym = sym->target_symbol;
+    if (!sym || sym->kind != SYMBOL_VALUE_FUNCTION || !sym->decl_node) return NULL;
+    return sym->decl_node->node_type == AST_FUNCTION_DECLARATION ? sym->decl_node : NULL;
+}
+
+static void walk(PurityWalk *w, AstNode *node);
+
+static void walk_list(PurityWalk *w, DynArray *nodes) {
+    if (!nodes) return;
+    DYNARRAY_FOREACH(AstNode*, node_it, nodes) walk(w, *node_it);
+}
+
+/* The storage `node` names, accessed as `access`. */
+static void walk_place(PurityWalk *w, AstNode *node, Access access) {
+    if (!node) return;
+    switch (node->node_type) {
+        case AST_IDENTIFIER:
+            if (is_global(w, node->data.identifier.symbol)) global_access(w, node, access);
+            break;
+        case AST_SUBSCRIPT_EXPR: {
+            AstNode *target = node->data.subscript_expr.target;
+            walk(w, node->data.subscript_expr.index);
+            if (target->type && (target->type->kind == TYPE_ARRAY || target->type->kind == TYPE_VECTOR)) {
+                walk_place(w, target, access);
+            } else {
+                walk(w, target);
+                indirect_access(w, node, access);
+            }
+            break;
+        }
+        case AST_MEMBER_EXPR: {
+            AstMemberExpr *member = &node->data.member_expr;
+            if (member->symbol && member->symbol->kind != SYMBOL_VARIABLE) break; // A module's function or type
+            if (is_global(w, member->symbol)) {
+                global_access(w, node, access);
+            } else if (is_pointer(member->target)) {
+                walk(w, member->target);
+                indirect_access(w, node, access);
+            } else {
+                walk_place(w, member->target, access);
+            }
+            break;
+        }
+        case AST_UNARY_EXPR:
+            if (node->data.unary_expr.op == OP_DEREF) {
+                walk(w, node->data.unary_expr.expr);
+                indirect_access(w, node, access);
+                break;
+            }
+            // fallthrough
+        default:
+            walk(w, node);
+            if (access == ACCESS_WRITE) lower(w, FN_MEMORY_ANY, node);
+            break;
+    }
+}
+
+static void walk_call(PurityWalk *w, AstNode *node) {
+    AstNode *callee = node->data.call_expr.callee;
+    AstNode *decl = purity_callee_decl(callee);
+    if (!decl) {
+        lower(w, FN_MEMORY_ANY, node);
+    } else {
+        lower(w, decl->data.function_declaration.memory, node);
+        // A method call passes its receiver's address
+        if (callee->node_type == AST_MEMBER_EXPR && callee->data.member_expr.is_instance_method) {
+            AstNode *receiver = callee->data.member_expr.target;
+            walk_place(w, receiver, is_pointer(receiver) ? ACCESS_READ : ACCESS_ADDRESS);
+        }
+    }
+    walk_list(w, node->data.call_expr.args);
+}
+
+/* The lanes @load reads from or @store writes to: a local array, or memory behind a slice or pointer. */
+static void walk_lane_memory(PurityWalk *w, AstNode *mem, Access access) {
+    if (mem->type && mem->type->kind == TYPE_ARRAY) {
+        walk_place(w, mem, access);
+    } else {
+        walk(w, mem);
+        indirect_access(w, mem, access);
+    }
+}
+
+static void walk_intrinsic(PurityWalk *w, AstNode *node) {
+    DynArray *args = node->data.intrinsic.args;
+    switch (node->data.intrinsic.kind) {
+        case INTRINSIC_ALLOC:
+        case INTRINSIC_FREE:
+            // @alloc and @free run the allocator
+            lower(w, FN_MEMORY_ANY, node);
+            break;
+        case INTRINSIC_ATOMIC_LOAD:
+        case INTRINSIC_ATOMIC_STORE:
+        case INTRINSIC_ATOMIC_CAS:
+        case INTRINSIC_ATOMIC_RMW:
+        case INTRINSIC_FENCE:
+            // Atomics order memory against other threads: never hoisted, merged or dropped
+            lower(w, FN_MEMORY_ANY, node);
+            break;
+        case INTRINSIC_AWAIT:
+        case INTRINSIC_SPAWN:
+        case INTRINSIC_SUSPEND:
+        case INTRINSIC_FRAME:
+        case INTRINSIC_RESUME:
+        case INTRINSIC_DONE:
+        case INTRINSIC_DESTROY:
+            // Frames live in allocator memory and change state at every step
+            lower(w, FN_MEMORY_ANY, node);
+            break;
+        case INTRINSIC_LOAD: // (V, src, i)
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 1), ACCESS_READ);
+            walk(w, DYNARRAY_AT(AstNode*, args, 2));
+            break;
+        case INTRINSIC_STORE: // (dst, i, v)
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 0), ACCESS_WRITE);
+            walk(w, DYNARRAY_AT(AstNode*, args, 1));
+            walk(w, DYNARRAY_AT(AstNode*, args, 2));
+            break;
+        case INTRINSIC_MEMCPY: // (dst, src, count)
+        case INTRINSIC_MEMMOVE:
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 0), ACCESS_WRITE);
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 1), ACCESS_READ);
+            walk(w, DYNARRAY_AT(AstNode*, args, 2));
+            break;
+        case INTRINSIC_PREFETCH: // (mem, read|write, locality): counted as a read of mem
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 0), ACCESS_READ);
+            break;
+        case INTRINSIC_MEMSET: // (dst, byte, count)
+            walk_lane_memory(w, DYNARRAY_AT(AstNode*, args, 0), ACCESS_WRITE);
+            walk(w, DYNARRAY_AT(AstNode*, args, 1));
+            walk(w, DYNARRAY_AT(AstNode*, args, 2));
+            break;
+        default:
+            walk_list(w, args);
+            break;
+    }
+}
+
+static void walk(PurityWalk *w, AstNode *node) {
+    if (!node || w->memory == FN_MEMORY_ANY) return;
+    switch (node->node_type) {
+        case AST_BLOCK:
+            walk_list(w, node->data.block.statements);
+            break;
+        case AST_IF_STATEMENT:
+            walk(w, node->data.if_statement.condition);
+            walk(w, node->data.if_statement.then_branch);
+            walk(w, node->data.if_statement.else_branch);
+            break;
+        case AST_WHILE_STATEMENT:
+            walk(w, node->data.while_statement.condition);
+            walk(w, node->data.while_statement.body);
+            break;
+        case AST_SWITCH_STATEMENT:
+            walk(w, node->data.switch_statement.subject);
+            walk_list(w, node->data.switch_statement.cases);
+            walk(w, node->data.switch_statement.else_body);
+            break;
+        case AST_SWITCH_CASE:
+            walk(w, node->data.switch_case.body);
+            break;
+        case AST_FOR_STATEMENT:
+            walk(w, node->data.for_statement.init);
+            walk(w, node->data.for_statement.condition);
+            walk(w, node->data.for_statement.post);
+            walk(w, node->data.for_statement.range);
+            walk(w, node->data.for_statement.body);
+            break;
+        case AST_RETURN_STATEMENT:
+            walk(w, node->data.return_statement.expression);
+            break;
+        case AST_DEFER_STATEMENT:
+            walk(w, node->data.defer_statement.body);
+            break;
+        case AST_EXPR_STATEMENT:
+            walk(w, node->data.expr_statement.expression);
+            break;
+        case AST_VARIABLE_DECLARATION:
+            walk(w, node->data.variable_declaration.initializer);
+            break;
+
+        case AST_IDENTIFIER:
+        case AST_SUBSCRIPT_EXPR:
+        case AST_MEMBER_EXPR:
+            walk_place(w, node, ACCESS_READ);
+            break;
+
+        case AST_UNARY_EXPR: {
+            OpKind op = node->data.unary_expr.op;
+            if (op == OP_DEREF) walk_place(w, node, ACCESS_READ);
+            else if (op == OP_ADDRESS) walk_place(w, node->data.unary_expr.expr, ACCESS_ADDRESS);
+            else if (op == OP_PRE_INC || op == OP_PRE_DEC) walk_place(w, node->data.unary_expr.expr, ACCESS_WRITE);
+            else walk(w, node->data.unary_expr.expr);
+            break;
+        }
+        case AST_POSTFIX_EXPR:
+            walk_place(w, node->data.postfix_expr.expr, ACCESS_WRITE);
+            break;
+        case AST_ASSIGNMENT_EXPR:
+            walk_place(w, node->data.assignment_expr.lvalue, ACCESS_WRITE);
+            walk(w, node->data.assignment_expr.rvalue);
+            break;
+        case AST_BINARY_EXPR:
+            walk(w, node->data.binary_expr.left);
+            walk(w, node->data.binary_expr.right);
+            break;
+        case AST_CALL_EXPR:
+            walk_call(w, node);
+            break;
+        case AST_INTRINSIC:
+            walk_intrinsic(w, node);
+            break;
+        case AST_GENERIC_INST_EXPR:
+            walk(w, node->data.generic_inst_expr.base);
+            break;
+        case AST_STRUCT_LITERAL:
+            if (node->data.struct_literal.fields) {
+                DYNARRAY_FOREACH(AstFieldInit, init, node->data.struct_literal.fields) walk(w, init->expr);
+            }
+            break;
+        case AST_CAST:
+            walk(w, node->data.cast_expr.expr);
+            break;
+        case AST_INITIALIZER_LIST:
+            walk_list(w, node->data.initializer_list.elements);
+            break;
+        default:
+            break;
+    }
+}
+
+typedef struct {
+    AstNode *func;
+    bool analyzed; // Its checked body decides its memory
+} PurityFunction;
+
+static void collect_function(DynArray *funcs, AstNode *func, bool generic_impl) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (generic_impl || (decl->type_params && decl->type_params->count > 0)) return;
+    bool analyzed = decl->body && func->type && !(func->flags & (AST_FLAG_PRUNED | AST_FLAG_REUSED)) &&
+                    func->last_checked_pass > 0;
+    decl->memory = analyzed ? FN_MEMORY_NONE : (decl->attrs & FN_ATTR_PURE) ? FN_MEMORY_READ : FN_MEMORY_ANY;
+    if (decl->attrs & FN_ATTR_ASYNC) {
+        // The ramp allocates and writes the frame, whatever the body does
+        decl->memory = FN_MEMORY_ANY;
+        analyzed = false;
+    }
+    PurityFunction pf = { .func = func, .analyzed = analyzed };
+    dynarray_push_value(funcs, &pf);
+}
+
+static void report_impure(TypeCheckContext *ctx, AstNode *func, AstNode *where) {
+    TypeError err = { .kind = TE_NOT_PURE, .span = func->span };
+    if (where && where->span.file == func->span.file) err.span = where->span;
+    InternResult *name = func->data.function_declaration.intern_result;
+    err.as.name.name = name ? ((Slice*)name->key)->ptr : "<function>";
+    dynarray_push_value(ctx->errors, &err);
+}
+
+void purity_program(TypeCheckContext *ctx) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return;
+
+    PurityWalk w = { .globals = hashmap_create(NULL, 64) };
+    DynArray funcs;
+    dynarray_init(&funcs, sizeof(PurityFunction));
+
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root || !unit->ast_root->data.program.decls) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type == AST_VARIABLE_DECLARATION) {
+                ptrmap_put(w.globals, decl, decl);
+            } else if (decl->node_type == AST_FUNCTION_DECLARATION) {
+                collect_function(&funcs, decl, false);
+            } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+                AstImplDeclaration *impl = &decl->data.impl_declaration;
+                bool generic = impl->type_params && impl->type_params->count > 0;
+                DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) collect_function(&funcs, *method_it, generic);
+            }
+        }
+    }
+
+    // Effects only ever get worse, so this settles
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        DYNARRAY_FOREACH(PurityFunction, pf, &funcs) {
+            AstFunctionDeclaration *decl = &pf->func->data.function_declaration;
+            if (!pf->analyzed || decl->memory == FN_MEMORY_ANY) continue;
+            w.memory = FN_MEMORY_NONE;
+            w.where = NULL;
+            walk(&w, decl->body);
+            if (w.memory < decl->memory) {
+                decl->memory = w.memory;
+                changed = true;
+                if (w.memory == FN_MEMORY_ANY && (decl->attrs & FN_ATTR_PURE)) report_impure(ctx, pf->func, w.where);
+            }
+        }
+    }
+
+    Options *opts = ctx->loader->opts;
+    if (opts && opts->incremental) {
+        DYNARRAY_FOREACH(PurityFunction, pf, &funcs) {
+            AstFunctionDeclaration *decl = &pf->func->data.function_declaration;
+            decl->memory = (decl->attrs & FN_ATTR_PURE) ? FN_MEMORY_READ : FN_MEMORY_ANY;
+        }
+    }
+
+    dynarray_free(&funcs);
+    hashmap_destroy(w.globals, NULL, NULL);
+}
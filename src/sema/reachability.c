@@ -0,0 +1,185 @@
+#include "sema/reachability.h"
+#include "parsing/ast.h"
+#include "parsing/parse_declarations.h"
+#include "parsing/template_body.h"
+#include "datastructures/dynamic_array.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/scope.h"
+#include "core/module_loader.h"
+
+typedef struct {
+    Arena *arena;
+    HashMap *candidates; // InternResult* (name) -> DynArray<AstNode*> of still-pruned functions
+    DynArray worklist;   // DynArray<AstNode*>: live functions whose bodies are not scanned yet
+} Reach;
+
+/* Library units of this program whose bodies pass 2 has not checked yet. */
+static bool unit_prunable(CompilationUnit *unit, CompilationUnit *root) {
+    return unit != root && unit->is_library && !unit->resident && !unit->bodies_checked && unit->ast_root;
+}
+
+/* Templates are checked per instance, so any of them may come alive later. */
+static bool is_template(Scope *scope, AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->type_params && decl->type_params->count > 0) return true;
+    if (decl->target_type_node && decl->target_type_node->node_type == AST_IDENTIFIER) {
+        Symbol *target = scope_lookup_symbol(scope, decl->target_type_node->data.identifier.intern_result, func->span.file);
+        if (target && target->kind == SYMBOL_GENERIC_STRUCT) return true;
+    }
+    return false;
+}
+
+static void add_candidate(Reach *r, AstNode *func) {
+    InternResult *name = func->data.function_declaration.intern_result;
+    if (!name) return;
+    DynArray *decls = ptrmap_get(r->candidates, name);
+    if (!decls) {
+        decls = arena_alloc(r->arena, sizeof(DynArray));
+        dynarray_init_in_arena(decls, r->arena, sizeof(AstNode*), 2);
+        ptrmap_put(r->candidates, name, decls);
+    }
+    func->flags |= AST_FLAG_PRUNED;
+    dynarray_push_value(decls, &func);
+}
+
+/* Every pruned function called `name` is live now. */
+static void reach_name(InternResult *name, void *user) {
+    Reach *r = user;
+    if (!name) return;
+    DynArray *decls = ptrmap_get(r->candidates, name);
+    if (!decls) return;
+    ptrmap_remove(r->candidates, name);
+    DYNARRAY_FOREACH(AstNode*, decl_it, decls) {
+        AstNode *func = *decl_it;
+        func->flags &= ~AST_FLAG_PRUNED;
+        dynarray_push_value(&r->worklist, &func);
+    }
+}
+
+/*
+ * The body of `func`, parsing a deferred one. A body that fails to parse is
+ * left deferred for pass 2 to report.
+ */
+static AstNode *reach_body(Reach *r, AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->body || !decl->lazy_body) return decl->body;
+    const char *msg = NULL;
+    Span span = func->span;
+    AstNode *body = parse_deferred_body(func, r->arena, &msg, &span);
+    if (body) decl->body = body;
+    return body;
+}
+
+static void push_live(Reach *r, AstNode *func) {
+    dynarray_push_value(&r->worklist, &func);
+}
+
+/*
+ * A live template. Its body is parsed once into the tree its instances will
+ * share (see parsing/template_body.h) instead of into the template, which
+ * would leave every instance a copy of it.
+ */
+static void push_template(Reach *r, AstNode *func) {
+    AstFunctionDeclaration *decl = &func->data.function_declaration;
+    if (decl->lazy_body && !decl->body && !decl->template_body) decl->template_body = template_body_create(r->arena);
+    push_live(r, func);
+}
+
+static void scan_live(Reach *r, AstNode *func) {
+    TemplateBody *shared = func->data.function_declaration.template_body;
+    if (!shared) {
+        reach_body(r, func);
+        ast_visit_names(func, reach_name, r);
+        return;
+    }
+    ast_visit_names(func, reach_name, r);
+    if (!template_body_bind(shared, NULL)) return;
+    AstNode *body = template_body_parse(shared, func, NULL, NULL);
+    if (body) ast_visit_names(body, reach_name, r);
+    template_body_unbind(shared);
+}
+
+/* Library units contribute candidates; their templates and globals are roots. */
+static void collect_library_unit(Reach *r, CompilationUnit *unit) {
+    DynArray *decls = unit->ast_root->data.program.decls;
+    if (!decls) return;
+    DYNARRAY_FOREACH(AstNode*, decl_it, decls) {
+        AstNode *decl = *decl_it;
+        if (decl->node_type == AST_FUNCTION_DECLARATION) {
+            if (is_template(unit->global_scope, decl)) push_template(r, decl);
+            else add_candidate(r, decl);
+        } else if (decl->node_type == AST_IMPL_DECLARATION) {
+            AstImplDeclaration *impl = &decl->data.impl_declaration;
+            if (!impl->methods) continue;
+            bool generic = impl->type_params && impl->type_params->count > 0;
+            DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                AstNode *method = *method_it;
+                if (generic || is_template(unit->global_scope, method)) push_template(r, method);
+                else add_candidate(r, method);
+            }
+        }
+    }
+}
+
+/* The program's own units are live as a whole. */
+static void collect_root_unit(Reach *r, CompilationUnit *unit) {
+    DynArray *decls = unit->ast_root->data.program.decls;
+    if (!decls) return;
+    DYNARRAY_FOREACH(AstNode*, decl_it, decls) {
+        AstNode *decl = *decl_it;
+        if (decl->node_type == AST_FUNCTION_DECLARATION) {
+            if (is_template(unit->global_scope, decl)) push_template(r, decl);
+            else push_live(r, decl);
+        } else if (decl->node_type == AST_IMPL_DECLARATION && decl->data.impl_declaration.methods) {
+            AstImplDeclaration *impl = &decl->data.impl_declaration;
+            bool generic = impl->type_params && impl->type_params->count > 0;
+            DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                if (generic || is_template(unit->global_scope, *method_it)) push_template(r, *method_it);
+                else push_live(r, *method_it);
+            }
+        }
+    }
+}
+
+static void reach_globals(Reach *r, CompilationUnit *unit) {
+    DynArray *decls = unit->ast_root->data.program.decls;
+    if (!decls) return;
+    DYNARRAY_FOREACH(AstNode*, decl_it, decls) {
+        AstNode *decl = *decl_it;
+        if (decl->node_type == AST_VARIABLE_DECLARATION) ast_visit_names(decl->data.variable_declaration.initializer, reach_name, r);
+    }
+}
+
+void reachability_prune_program(TypeCheckContext *ctx) {
+    if (!ctx || !ctx->loader || !ctx->loader->units_ordered) return;
+    Options *opts = ctx->loader->opts;
+    if (!opts || opts->check_all || opts->cache_dir) return;
+
+    DynArray *units = ctx->loader->units_ordered;
+    if (units->count == 0) return;
+    CompilationUnit *root = DYNARRAY_AT(CompilationUnit*, units, units->count - 1);
+
+    Reach r = { .arena = ctx->arena, .candidates = hashmap_create(NULL, 256) };
+    dynarray_init(&r.worklist, sizeof(AstNode*));
+
+    // Candidates first, so that every root below can reach them
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (unit_prunable(unit, root)) collect_library_unit(&r, unit);
+    }
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, units) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->ast_root) continue;
+        if (!unit_prunable(unit, root)) collect_root_unit(&r, unit);
+        reach_globals(&r, unit);
+    }
+
+    while (r.worklist.count > 0) {
+        AstNode *func = DYNARRAY_AT(AstNode*, &r.worklist, r.worklist.count - 1);
+        r.worklist.count--;
+        scan_live(&r, func);
+    }
+
+    dynarray_free(&r.worklist);
+    hashmap_destroy(r.candidates, NULL, NULL);
+}
@@ -2,6 +2,7 @@
 #include "type.h"
 #include "sema/intrinsics.h"
 #include "datastructures/scope.h"
+#include "core/mem_report.h"
 
 // FNV-1a constants for 64-bit systems
 #define FNV_OFFSET 0xcbf29ce484222325ULL
@@ -15,20 +16,21 @@ static inline size_t hash_combine(size_t seed, size_t value) {
     return seed;
 }
 
-/*
-* HashMap expects void pointer input for hashing.
-* However, the interner stores keys as Slice* objects, so we need to
-* extract the actual Type* from the Slice.
-*/
-static size_t type_hasher(void *ptr) {
+// Children are canonical, so their address is their identity. Aligned
+// pointers have zero low bits; fold the high half in before mixing.
+static inline size_t hash_type_ref(size_t seed, const Type *child) {
+    uint64_t p = (uint64_t)(uintptr_t)child;
+    return hash_combine(seed, (size_t)(p ^ (p >> 32)));
+}
 
-    const Slice *slice = (const Slice*)ptr;
-    const Type *type = (const Type*)slice->ptr;
-    
-    // Start with a basis
+/*
+ * Hash-consing: a composite type's hash covers its own fields and the
+ * identities of its (already interned) children, never their structure, so
+ * hashing costs O(arity). Nominal types (structs, enums) are not interned
+ * and are only ever reached as children, through their address.
+ */
+static uint64_t type_compute_hash(const Type *type) {
     size_t h = FNV_OFFSET;
-
-    // Mix the Kind
     h = hash_combine(h, (size_t)type->kind);
 
     switch (type->kind) {
@@ -37,30 +39,32 @@ static size_t type_hasher(void *ptr) {
             break;
 
         case TYPE_POINTER:
-            h = hash_combine(h, type->as.ptr.base->cached_hash);
+            h = hash_type_ref(h, type->as.ptr.base);
             break;
 
         case TYPE_ARRAY:
-            // Mix Child's Hash + Size
-            h = hash_combine(h, type->as.array.base->cached_hash);
+            h = hash_type_ref(h, type->as.array.base);
             h = hash_combine(h, (size_t)type->as.array.size);
             break;
 
         case TYPE_SLICE:
-            // Mix Child's Hash
-            h = hash_combine(h, type->as.slice.base->cached_hash);
+            h = hash_type_ref(h, type->as.slice.base);
             break;
 
-        case TYPE_FUNCTION:
-            // Mix Return Type Hash
-            h = hash_combine(h, type->as.func.return_type->cached_hash);
+        case TYPE_VECTOR:
+            h = hash_type_ref(h, type->as.vector.base);
+            h = hash_combine(h, (size_t)type->as.vector.lanes);
+            break;
 
-            // Mix Param Count
-            h = hash_combine(h, (size_t)type->as.func.param_count);
+        case TYPE_CONST_ARG:
+            h = hash_combine(h, (size_t)type->as.const_arg.value);
+            break;
 
-            // Mix Hash of every parameter
+        case TYPE_FUNCTION:
+            h = hash_type_ref(h, type->as.func.return_type);
+            h = hash_combine(h, (size_t)type->as.func.param_count);
             for (size_t i = 0; i < type->as.func.param_count; i++) {
-                h = hash_combine(h, type->as.func.params[i]->cached_hash);
+                h = hash_type_ref(h, type->as.func.params[i]);
             }
             break;
 
@@ -70,10 +74,10 @@ static size_t type_hasher(void *ptr) {
             break;
 
         case TYPE_GENERIC_INST:
-            h = hash_combine(h, type->as.generic_inst.base->cached_hash);
+            h = hash_type_ref(h, type->as.generic_inst.base);
             h = hash_combine(h, (size_t)type->as.generic_inst.arg_count);
             for (size_t i = 0; i < type->as.generic_inst.arg_count; i++) {
-                h = hash_combine(h, type->as.generic_inst.args[i]->cached_hash);
+                h = hash_type_ref(h, type->as.generic_inst.args[i]);
             }
             break;
 
@@ -88,6 +92,16 @@ static size_t type_hasher(void *ptr) {
     return h;
 }
 
+/*
+ * Hash function for the DenseArenaInterner. Keys are Slice* wrapping a
+ * Type*; every key reaching the interner (prototype or canonical copy)
+ * already carries its cached_hash, so this is a load.
+ */
+static size_t type_hasher(void *ptr) {
+    const Slice *slice = (const Slice*)ptr;
+    return (size_t)((const Type*)slice->ptr)->cached_hash;
+}
+
 
 /*
  * Type Comparator for DenseArenaInterner
@@ -105,8 +119,8 @@ static int type_comparator(void *a, void *b) {
     // 1. Trivial Check (Same memory location)
     if (ta == tb) return 0;
 
-    // 2. Kind Check
-    if (ta->kind != tb->kind) return 1;
+    // 2. Hash and Kind Check
+    if (ta->cached_hash != tb->cached_hash || ta->kind != tb->kind) return 1;
 
     // 3. Structural Check
     switch (ta->kind) {
@@ -128,6 +142,13 @@ static int type_comparator(void *a, void *b) {
             // Compare element type pointer
             return (ta->as.slice.base == tb->as.slice.base) ? 0 : 1;
 
+        case TYPE_VECTOR:
+            if (ta->as.vector.lanes != tb->as.vector.lanes) return 1;
+            return (ta->as.vector.base == tb->as.vector.base) ? 0 : 1;
+
+        case TYPE_CONST_ARG:
+            return (ta->as.const_arg.value == tb->as.const_arg.value) ? 0 : 1;
+
         case TYPE_FUNCTION:
             // Compare Return Type (pointer check)
             if (ta->as.func.return_type != tb->as.func.return_type) return 1;
@@ -179,6 +200,7 @@ static void *type_copy_func(Arena *arena, const void *data, size_t len) {
     
     Type *copy = arena_calloc(arena, sizeof(Type));
     if (!copy) return NULL;
+    MEM_ACCOUNT(MEM_TYPES, src->kind, SOURCE_NONE, sizeof(Type), 1);
     
     // Copy the basic structure
     memcpy(copy, src, sizeof(Type));
@@ -191,6 +213,7 @@ static void *type_copy_func(Arena *arena, const void *data, size_t len) {
     if (src->kind == TYPE_FUNCTION && src->as.func.param_count > 0) {
         size_t params_size = sizeof(Type*) * src->as.func.param_count;
         Type **new_params = arena_alloc(arena, params_size);
+        MEM_ACCOUNT(MEM_TYPES, src->kind, SOURCE_NONE, params_size, 0);
         if (new_params) {
             memcpy(new_params, src->as.func.params, params_size);
             copy->as.func.params = new_params;
@@ -200,6 +223,7 @@ static void *type_copy_func(Arena *arena, const void *data, size_t len) {
     if (src->kind == TYPE_GENERIC_INST && src->as.generic_inst.arg_count > 0) {
         size_t args_size = sizeof(Type*) * src->as.generic_inst.arg_count;
         Type **new_args = arena_alloc(arena, args_size);
+        MEM_ACCOUNT(MEM_TYPES, src->kind, SOURCE_NONE, args_size, 0);
         if (new_args) {
             memcpy(new_args, src->as.generic_inst.args, args_size);
             copy->as.generic_inst.args = new_args;
@@ -233,14 +257,21 @@ static void *type_copy_func(Arena *arena, const void *data, size_t len) {
 InternResult *intern_type(TypeStore *ts, Type *prototype) {
     if (!ts || !prototype) return NULL;
 
-    // Pre-calculate hash for the prototype (required by interner)
-    prototype->cached_hash = type_hasher(&(Slice){.ptr = (char*)prototype, .len = sizeof(Type)});
+    // Computed once here; the interner reads it back through type_hasher()
+    prototype->cached_hash = type_compute_hash(prototype);
 
     Slice slice = { .ptr = (const char*)prototype, .len = sizeof(Type) };
-    InternResult *result = intern(ts->type_interner, &slice, NULL);
-    if (!result) return NULL;
+    return intern(ts->type_interner, &slice, NULL);
+}
+
+#define TYPE_INTERN_SHARDS 16
 
-    return result;
+bool typestore_begin_concurrent(TypeStore *ts) {
+    return ts && intern_table_begin_concurrent(ts->type_interner, TYPE_INTERN_SHARDS);
+}
+
+void typestore_end_concurrent(TypeStore *ts) {
+    if (ts) intern_table_end_concurrent(ts->type_interner);
 }
 
 // Helper to register a primitive
@@ -252,7 +283,7 @@ static void register_prim(TypeStore *ts, DenseArenaInterner *ids, const char *na
     // 2. Map Key -> Type*
     if (res && res->key) {
         // cast res->key via uintptr_t to uint64_t for hashmap key
-        hashmap_put(ts->primitive_registry, res->key, t, ptr_hash, ptr_cmp);
+        ptrmap_put(ts->primitive_registry, res->key, t);
     }
 }
 
@@ -260,8 +291,7 @@ static Type *create_primitive(TypeStore *ts, PrimitiveKind kind) {
     Type proto = {0};
     proto.kind = TYPE_PRIMITIVE;
     proto.as.primitive = kind;
-    // Pre-calculate hash for the prototype (required by interner)
-    proto.cached_hash = type_hasher(&(Slice){.ptr = (char*)&proto, .len = sizeof(Type)});
+    proto.cached_hash = type_compute_hash(&proto);
     
     InternResult *res = intern(ts->type_interner, &(Slice){.ptr = (char*)&proto, .len = sizeof(Type)}, NULL);
     if (!res) return NULL;
@@ -286,8 +316,9 @@ TypeStore *typestore_create(Arena *arena, DenseArenaInterner *identifiers, Dense
     if (!ts->type_interner) return NULL;
 
     ts->primitive_registry = hashmap_create(arena, 64);
-    ts->generic_inst_cache = hashmap_create(arena, 32);
     ts->impl_registry = hashmap_create(arena, 32);
+    ts->impl_method_index = hashmap_create(arena, 32);
+    ts->universe = NULL;
 
     // Create canonical primitives
     ts->t_i8  = create_primitive(ts, PRIM_I8);
@@ -349,23 +380,31 @@ TypeStore *typestore_create(Arena *arena, DenseArenaInterner *identifiers, Dense
     // Pre-intern "len" for O(1) field lookup on arrays/slices
     Slice len_slice = { .ptr = "len", .len = 3 };
     ts->kw_len = intern(identifiers, &len_slice, NULL);
+    ts->kw_print = intern(identifiers, &(Slice){ .ptr = "print", .len = 5 }, NULL);
+    ts->kw_println = intern(identifiers, &(Slice){ .ptr = "println", .len = 7 }, NULL);
     
     return ts;
 }
 
+void typestore_relink(TypeStore *ts) {
+    ts->type_interner->copy_func = type_copy_func;
+    ts->type_interner->hash_func = type_hasher;
+    ts->type_interner->cmp_func = type_comparator;
+}
+
 void register_intrinsics(TypeStore *ts, Scope *global_scope, DenseArenaInterner *identifiers) {
     // 1. print(...)
     Slice print_slice = { .ptr = "print", .len = 5 };
-    InternResult *print_res = intern(identifiers, &print_slice, NULL);
-    Symbol *print_sym = scope_define_symbol(global_scope, print_res, ts->t_void, SYMBOL_VALUE_INTRINSIC, "<builtin>", true, NULL);
+    InternResult *print_res = ts->kw_print ? ts->kw_print : intern(identifiers, &print_slice, NULL);
+    Symbol *print_sym = scope_define_symbol(global_scope, print_res, ts->t_void, SYMBOL_VALUE_INTRINSIC, SOURCE_NONE, true, NULL);
     if (print_sym) {
         print_sym->intrinsic_kind = INTRINSIC_PRINT;
     }
 
     // 2. println(...)
     Slice println_slice = { .ptr = "println", .len = 7 };
-    InternResult *println_res = intern(identifiers, &println_slice, NULL);
-    Symbol *println_sym = scope_define_symbol(global_scope, println_res, ts->t_void, SYMBOL_VALUE_INTRINSIC, "<builtin>", true, NULL);
+    InternResult *println_res = ts->kw_println ? ts->kw_println : intern(identifiers, &println_slice, NULL);
+    Symbol *println_sym = scope_define_symbol(global_scope, println_res, ts->t_void, SYMBOL_VALUE_INTRINSIC, SOURCE_NONE, true, NULL);
     if (println_sym) {
         println_sym->intrinsic_kind = INTRINSIC_PRINT_NEWLINE;
     }
@@ -378,8 +417,17 @@ void register_primitives_to_scope(TypeStore *ts, Scope *universe_scope, DenseAre
     for (int i = 0; i < 14; i++) {
         Slice s = { .ptr = (char*)prims[i], .len = strlen(prims[i]) };
         InternResult *res = intern(keywords, &s, NULL);
-        scope_define_symbol(universe_scope, res, ptypes[i], SYMBOL_VALUE_TYPE, "<builtin>", true, NULL);
+        scope_define_symbol(universe_scope, res, ptypes[i], SYMBOL_VALUE_TYPE, SOURCE_NONE, true, NULL);
+    }
+}
+
+Scope *typestore_universe(TypeStore *ts, DenseArenaInterner *keywords) {
+    if (!ts->universe) {
+        int universe_count = (keywords ? keywords->dense_index_count : 0) + 32;
+        ts->universe = scope_create(ts->arena, NULL, universe_count, SCOPE_KEYWORDS);
+        if (ts->universe) register_primitives_to_scope(ts, ts->universe, keywords);
     }
+    return ts->universe;
 }
 
 // --- Type construction helpers ---
@@ -416,6 +464,14 @@ Type *make_slice_type(TypeStore *ts, Type *base) {
     return (Type*)((Slice*)res->key)->ptr;
 }
 
+Type *make_vector_type(TypeStore *ts, Type *base, int64_t lanes) {
+    if (!ts || !base) return NULL;
+    Type proto = { .kind = TYPE_VECTOR, .as.vector = { .base = base, .lanes = lanes } };
+    InternResult *res = intern_type(ts, &proto);
+    if (!res) return NULL;
+    return (Type*)((Slice*)res->key)->ptr;
+}
+
 Type *make_function_type(TypeStore *ts, Type *return_type, Type **params, size_t param_count) {
     if (!ts || !return_type) return NULL;
     Type proto = { .kind = TYPE_FUNCTION, .as.func = { .return_type = return_type, .params = params, .param_count = param_count } };
@@ -424,68 +480,24 @@ Type *make_function_type(TypeStore *ts, Type *return_type, Type **params, size_t
     return (Type*)((Slice*)res->key)->ptr;
 }
 
-// --- Generic caching infrastructure ---
-
-typedef struct {
-    Type *base;
-    size_t arg_count;
-    Type **args;
-} MonoKey;
-
-static size_t mono_key_hash(void *ptr) {
-    MonoKey *key = (MonoKey*)ptr;
-    size_t h = hash_combine(0, (size_t)(uintptr_t)key->base);
-    h = hash_combine(h, key->arg_count);
-    for (size_t i = 0; i < key->arg_count; i++) {
-        h = hash_combine(h, (size_t)(uintptr_t)key->args[i]);
-    }
-    return h;
-}
-
-static int mono_key_cmp(void *a, void *b) {
-    MonoKey *ka = (MonoKey*)a;
-    MonoKey *kb = (MonoKey*)b;
-    if (ka->base != kb->base) return 1;
-    if (ka->arg_count != kb->arg_count) return 1;
-    for (size_t i = 0; i < ka->arg_count; i++) {
-        if (ka->args[i] != kb->args[i]) return 1;
-    }
-    return 0; // equal
-}
+// --- Generic instances ---
 
+// The interner canonicalizes (template, args) like any other composite type
+// and copies the argument array, so `args` may be a temporary.
 Type *make_generic_inst_type(TypeStore *ts, Type *base, Type **args, size_t arg_count) {
     if (!ts || !base) return NULL;
-
-    // Check the cache first
-    MonoKey lookup_key = { .base = base, .args = args, .arg_count = arg_count };
-    Type *cached = (Type*)hashmap_get(ts->generic_inst_cache, &lookup_key, mono_key_hash, mono_key_cmp);
-    if (cached) return cached;
-
-    // Build the TYPE_GENERIC_INST proto type
-    Type proto = {0};
-    proto.kind = TYPE_GENERIC_INST;
-    proto.as.generic_inst.base = base;
-    proto.as.generic_inst.args = args;
-    proto.as.generic_inst.arg_count = arg_count;
-    proto.as.generic_inst.concrete_type = NULL;
-
+    Type proto = { .kind = TYPE_GENERIC_INST, .as.generic_inst = { .base = base, .args = args, .arg_count = arg_count } };
     InternResult *res = intern_type(ts, &proto);
     if (!res) return NULL;
+    return (Type*)((Slice*)res->key)->ptr;
+}
 
-    Type *inst_type = (Type*)((Slice*)res->key)->ptr;
-
-    // Insert into cache
-    MonoKey *persistent_key = arena_alloc(ts->arena, sizeof(MonoKey));
-    persistent_key->base = base;
-    persistent_key->arg_count = arg_count;
-    persistent_key->args = arena_alloc(ts->arena, sizeof(Type*) * arg_count);
-    memcpy(persistent_key->args, args, sizeof(Type*) * arg_count);
-
-    inst_type->as.generic_inst.args = persistent_key->args;
-
-    hashmap_put(ts->generic_inst_cache, persistent_key, inst_type, mono_key_hash, mono_key_cmp);
-
-    return inst_type;
+Type *make_const_arg_type(TypeStore *ts, int64_t value) {
+    if (!ts) return NULL;
+    Type proto = { .kind = TYPE_CONST_ARG, .as.const_arg.value = value };
+    InternResult *res = intern_type(ts, &proto);
+    if (!res) return NULL;
+    return (Type*)((Slice*)res->key)->ptr;
 }
 
 // --- Generic type substitution ---
@@ -495,7 +507,7 @@ Type *type_substitute(TypeStore *ts, Type *t, HashMap *bindings) {
 
     switch (t->kind) {
         case TYPE_TYPEVAR: {
-            Type *bound = hashmap_get(bindings, t->as.typevar.name->key, ptr_hash, ptr_cmp);
+            Type *bound = ptrmap_get(bindings, t->as.typevar.name->key);
             return bound ? bound : t;
         }
 
@@ -517,17 +529,25 @@ Type *type_substitute(TypeStore *ts, Type *t, HashMap *bindings) {
             return make_slice_type(ts, sub_base);
         }
 
+        case TYPE_VECTOR: {
+            Type *sub_base = type_substitute(ts, t->as.vector.base, bindings);
+            if (sub_base == t->as.vector.base) return t;
+            return make_vector_type(ts, sub_base, t->as.vector.lanes);
+        }
+
         case TYPE_FUNCTION: {
             Type *sub_ret = type_substitute(ts, t->as.func.return_type, bindings);
             bool changed = (sub_ret != t->as.func.return_type);
 
+            // The prototype's parameter array is copied on intern
+            ArenaScratch scratch = arena_scratch_begin();
             Type **sub_params = NULL;
             if (t->as.func.param_count > 0) {
                 for (size_t i = 0; i < t->as.func.param_count; i++) {
                     Type *subbed = type_substitute(ts, t->as.func.params[i], bindings);
                     if (subbed != t->as.func.params[i]) {
                         if (!changed && !sub_params) {
-                            sub_params = arena_alloc(ts->arena, sizeof(Type*) * t->as.func.param_count);
+                            sub_params = arena_alloc(scratch.arena, sizeof(Type*) * t->as.func.param_count);
                             for (size_t j = 0; j < i; j++) sub_params[j] = t->as.func.params[j];
                         }
                         changed = true;
@@ -536,19 +556,22 @@ Type *type_substitute(TypeStore *ts, Type *t, HashMap *bindings) {
                 }
             }
 
-            if (!changed) return t;
-            return make_function_type(ts, sub_ret, sub_params ? sub_params : t->as.func.params, t->as.func.param_count);
+            Type *result = changed ? make_function_type(ts, sub_ret, sub_params ? sub_params : t->as.func.params, t->as.func.param_count) : t;
+            arena_scratch_end(scratch);
+            return result;
         }
 
         case TYPE_GENERIC_INST: {
             bool changed = false;
+            // make_generic_inst_type keeps its own copy of the arguments
+            ArenaScratch scratch = arena_scratch_begin();
             Type **sub_args = NULL;
             if (t->as.generic_inst.arg_count > 0) {
                 for (size_t i = 0; i < t->as.generic_inst.arg_count; i++) {
                     Type *subbed = type_substitute(ts, t->as.generic_inst.args[i], bindings);
                     if (subbed != t->as.generic_inst.args[i]) {
                         if (!changed && !sub_args) {
-                            sub_args = arena_alloc(ts->arena, sizeof(Type*) * t->as.generic_inst.arg_count);
+                            sub_args = arena_alloc(scratch.arena, sizeof(Type*) * t->as.generic_inst.arg_count);
                             for (size_t j = 0; j < i; j++) sub_args[j] = t->as.generic_inst.args[j];
                         }
                         changed = true;
@@ -560,9 +583,13 @@ Type *type_substitute(TypeStore *ts, Type *t, HashMap *bindings) {
             Type *sub_concrete = t->as.generic_inst.concrete_type ? type_substitute(ts, t->as.generic_inst.concrete_type, bindings) : NULL;
             if (sub_concrete != t->as.generic_inst.concrete_type) changed = true;
 
-            if (!changed) return t;
+            if (!changed) {
+                arena_scratch_end(scratch);
+                return t;
+            }
 
             Type *new_inst = make_generic_inst_type(ts, t->as.generic_inst.base, sub_args ? sub_args : t->as.generic_inst.args, t->as.generic_inst.arg_count);
+            arena_scratch_end(scratch);
             if (new_inst) {
                 new_inst->as.generic_inst.concrete_type = sub_concrete;
             }
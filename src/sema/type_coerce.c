@@ -127,6 +127,11 @@ bool type_can_explicit_cast(Type *target, Type *source) {
             return true;
         }
     }
+    // 6. Vector -> Vector: lane by lane, same lane count
+    if (source->kind == TYPE_VECTOR && target->kind == TYPE_VECTOR) {
+        return source->as.vector.lanes == target->as.vector.lanes &&
+               type_can_explicit_cast(target->as.vector.base, source->as.vector.base);
+    }
 
     return false;
 }
@@ -178,8 +183,9 @@ void insert_cast(TypeCheckContext *ctx, AstNode *node, Type *to_type) {
 
     // We clone the current node into a new memory location so the original
     // node can be transformed into the cast container.
-    AstNode *original = arena_alloc(ctx->store->arena, sizeof(AstNode));
-    memcpy(original, node, sizeof(AstNode));
+    size_t size = ast_node_size(node->node_type);
+    AstNode *original = arena_alloc(ctx->arena, size);
+    memcpy(original, node, size);
 
     node->node_type = AST_CAST;
     node->type = to_type;
@@ -217,7 +223,6 @@ Type* coerce_or_error(TypeCheckContext *ctx, AstNode *node, Type *expected) {
     TypeError err = {
         .kind = TE_TYPE_MISMATCH,
         .span = node->span,
-        .filename = ctx->filename,
         .as.mismatch = { .expected = expected, .actual = actual }
     };
     dynarray_push_value(ctx->errors, &err);
@@ -0,0 +1,145 @@
+#include "sema/type_layout.h"
+#include "parsing/ast.h"
+#include "datastructures/arena.h"
+
+static int64_t align_up(int64_t n, int64_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static bool primitive_layout(PrimitiveKind prim, int64_t *size, int32_t *align) {
+    switch (prim) {
+        case PRIM_I8: case PRIM_U8: case PRIM_BOOL: case PRIM_CHAR: *size = 1; break;
+        case PRIM_I16: case PRIM_U16:                               *size = 2; break;
+        case PRIM_I32: case PRIM_U32: case PRIM_F32:                *size = 4; break;
+        case PRIM_I64: case PRIM_U64: case PRIM_F64:
+        case PRIM_USIZE: case PRIM_ISIZE:                           *size = 8; break;
+        default: return false;
+    }
+    *align = (int32_t)*size;
+    return true;
+}
+
+bool type_layout(Type *t, int64_t *size, int32_t *align) {
+    if (!t) return false;
+    switch (t->kind) {
+        case TYPE_VOID:
+            *size = 0;
+            *align = 1;
+            return true;
+        case TYPE_PRIMITIVE:
+            return primitive_layout(t->as.primitive, size, align);
+        case TYPE_POINTER:
+        case TYPE_FUNCTION:
+        case TYPE_ENUM:
+            *size = 8;
+            *align = 8;
+            return true;
+        case TYPE_SLICE:
+            *size = 16;
+            *align = 8;
+            return true;
+        case TYPE_ARRAY: {
+            int64_t elem = 0;
+            if (!type_layout(t->as.array.base, &elem, align)) return false;
+            *size = elem * (t->as.array.size > 0 ? t->as.array.size : 0);
+            return true;
+        }
+        case TYPE_VECTOR: {
+            // Aligned to its size rounded up to a power of two, padded to that
+            int64_t lane = 0;
+            int32_t lane_align = 0;
+            if (!type_layout(t->as.vector.base, &lane, &lane_align)) return false;
+            int64_t bytes = lane * t->as.vector.lanes, pow2 = 1;
+            while (pow2 < bytes) pow2 <<= 1;
+            *align = (int32_t)pow2;
+            *size = align_up(bytes, pow2);
+            return true;
+        }
+        case TYPE_STRUCT:
+            if (!type_struct_layout(t)) return false;
+            *size = t->as.struct_type.size;
+            *align = t->as.struct_type.align;
+            return true;
+        case TYPE_GENERIC_INST:
+            return type_layout(t->as.generic_inst.concrete_type, size, align);
+        default:
+            return false;
+    }
+}
+
+/* A struct (or array of them) whose offsets LLVM's natural layout would not reproduce. */
+static bool has_explicit_layout(Type *t) {
+    while (t && t->kind == TYPE_ARRAY) t = t->as.array.base;
+    if (t && t->kind == TYPE_GENERIC_INST) t = t->as.generic_inst.concrete_type;
+    return t && t->kind == TYPE_STRUCT && t->as.struct_type.layout == STRUCT_LAYOUT_EXPLICIT;
+}
+
+bool type_struct_layout(Type *t) {
+    if (!t || t->kind != TYPE_STRUCT) return false;
+    if (t->as.struct_type.layout == STRUCT_LAYOUT_BUSY) return false;
+    if (t->as.struct_type.layout != STRUCT_LAYOUT_PENDING) return true;
+
+    size_t count = t->as.struct_type.field_count;
+    StructField *fields = t->as.struct_type.fields;
+    if (count > 0 && !fields) return false;
+
+    AstNode *decl = t->as.struct_type.decl_node;
+    uint8_t attrs = 0;
+    uint32_t forced_align = 0;
+    if (decl && decl->node_type == AST_STRUCT_DECLARATION) {
+        attrs = decl->data.struct_declaration.attrs;
+        forced_align = decl->data.struct_declaration.align;
+    }
+    bool packed = attrs & STRUCT_ATTR_PACKED;
+
+    t->as.struct_type.layout = STRUCT_LAYOUT_BUSY;
+    ArenaScratch scratch = arena_scratch_begin();
+    int64_t *sizes = arena_alloc(scratch.arena, sizeof(int64_t) * (count ? count : 1));
+    int32_t *aligns = arena_alloc(scratch.arena, sizeof(int32_t) * (count ? count : 1));
+    size_t *order = arena_alloc(scratch.arena, sizeof(size_t) * (count ? count : 1));
+
+    bool explicit_layout = packed;
+    for (size_t i = 0; i < count; i++) {
+        if (!type_layout(fields[i].type, &sizes[i], &aligns[i])) {
+            t->as.struct_type.layout = STRUCT_LAYOUT_PENDING;
+            arena_scratch_end(scratch);
+            return false;
+        }
+        if (packed) aligns[i] = 1;
+        if (has_explicit_layout(fields[i].type)) explicit_layout = true;
+        order[i] = i;
+    }
+
+    if (attrs & STRUCT_ATTR_REORDER) {
+        // Insertion sort keeps equally aligned fields in declaration order
+        for (size_t i = 1; i < count; i++) {
+            size_t f = order[i], j = i;
+            while (j > 0 && aligns[order[j - 1]] < aligns[f]) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = f;
+            if (j != i) explicit_layout = true;
+        }
+    }
+
+    int64_t offset = 0;
+    int32_t align = 1;
+    for (size_t k = 0; k < count; k++) {
+        size_t i = order[k];
+        offset = align_up(offset, aligns[i]);
+        fields[i].offset = offset;
+        offset += sizes[i];
+        if (aligns[i] > align) align = aligns[i];
+    }
+    if ((int32_t)forced_align > align) {
+        align = (int32_t)forced_align;
+        explicit_layout = true;
+    }
+
+    t->as.struct_type.size = align_up(offset, align);
+    t->as.struct_type.align = align;
+    t->as.struct_type.layout = explicit_layout ? STRUCT_LAYOUT_EXPLICIT : STRUCT_LAYOUT_NATURAL;
+    arena_scratch_end(scratch);
+    return true;
+}
@@ -10,6 +10,7 @@
 #include "sema/type.h"
 #include "sema/symbol_utils.h" // Needed for Symbol and Scope definitions
 #include "parsing/ast.h"
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include "core/colors.h"
@@ -26,7 +27,28 @@
 #define COL_PTR            MAGENTA
 #define COL_NUM            YELLOW
 
-static void print_primitive_kind(FILE *out, PrimitiveKind kind) {
+/* Where a type is printed: a stream, or a buffer that is filled like snprintf. */
+typedef struct {
+    FILE *file;
+    char *buf;
+    size_t cap;
+    size_t len;
+} TypeWriter;
+
+static void tw_printf(TypeWriter *out, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (out->file) {
+        vfprintf(out->file, fmt, args);
+    } else {
+        size_t room = out->len < out->cap ? out->cap - out->len : 0;
+        int n = vsnprintf(room ? out->buf + out->len : NULL, room, fmt, args);
+        if (n > 0) out->len += (size_t)n;
+    }
+    va_end(args);
+}
+
+static void print_primitive_kind(TypeWriter *out, PrimitiveKind kind) {
     static const char *primitive_names[] = {
         [PRIM_I8]   = "i8",
         [PRIM_I16]  = "i16",
@@ -47,65 +69,73 @@ static void print_primitive_kind(FILE *out, PrimitiveKind kind) {
     if (kind >= 0 && kind < (PrimitiveKind)(sizeof(primitive_names) / sizeof(primitive_names[0]))) {
         const char *name = primitive_names[kind];
         if (name) {
-            fprintf(out, "%s", name);
+            tw_printf(out, "%s", name);
             return;
         }
     }
 }
 
-static void type_print_internal(FILE *out, const Type *type) {
-    if (!type) { fprintf(out, "null"); return; }
+static void type_print_internal(TypeWriter *out, const Type *type) {
+    if (!type) { tw_printf(out, "null"); return; }
 
     switch (type->kind) {
-        case TYPE_VOID: fprintf(out, "void"); break;
+        case TYPE_VOID: tw_printf(out, "void"); break;
         case TYPE_PRIMITIVE: print_primitive_kind(out, type->as.primitive); break;
         case TYPE_POINTER:
-            fprintf(out, "*");
+            tw_printf(out, "*");
             type_print_internal(out, type->as.ptr.base);
             break;
         case TYPE_ARRAY:
             type_print_internal(out, type->as.array.base);
-            fprintf(out, "[%lld]", (long long)type->as.array.size);
+            tw_printf(out, "[%lld]", (long long)type->as.array.size);
             break;
         case TYPE_SLICE:
             type_print_internal(out, type->as.slice.base);
-            fprintf(out, "[]");
+            tw_printf(out, "[]");
+            break;
+        case TYPE_VECTOR:
+            tw_printf(out, "vec<");
+            type_print_internal(out, type->as.vector.base);
+            tw_printf(out, ", %lld>", (long long)type->as.vector.lanes);
             break;
         case TYPE_STRUCT:
             if (type->as.struct_type.name && type->as.struct_type.name->key) {
                 Slice *s = (Slice*)type->as.struct_type.name->key;
-                fprintf(out, "%.*s", (int)s->len, s->ptr);
-            } else fprintf(out, "struct");
+                tw_printf(out, "%.*s", (int)s->len, s->ptr);
+            } else tw_printf(out, "struct");
             break;
         case TYPE_ENUM:
             if (type->as.enum_type.name && type->as.enum_type.name->key) {
                 Slice *s = (Slice*)type->as.enum_type.name->key;
-                fprintf(out, "%.*s", (int)s->len, s->ptr);
-            } else fprintf(out, "enum");
+                tw_printf(out, "%.*s", (int)s->len, s->ptr);
+            } else tw_printf(out, "enum");
             break;
         case TYPE_FUNCTION:
-            fprintf(out, "fn(");
+            tw_printf(out, "fn(");
             for (size_t i = 0; i < type->as.func.param_count; i++) {
-                if (i > 0) fprintf(out, ", ");
+                if (i > 0) tw_printf(out, ", ");
                 type_print_internal(out, type->as.func.params[i]);
             }
-            fprintf(out, ") -> ");
+            tw_printf(out, ") -> ");
             type_print_internal(out, type->as.func.return_type);
             break;
         case TYPE_TYPEVAR:
             if (type->as.typevar.name && type->as.typevar.name->key) {
                 Slice *s = (Slice*)type->as.typevar.name->key;
-                fprintf(out, "%.*s", (int)s->len, s->ptr);
-            } else fprintf(out, "?");
+                tw_printf(out, "%.*s", (int)s->len, s->ptr);
+            } else tw_printf(out, "?");
             break;
         case TYPE_GENERIC_INST:
             type_print_internal(out, type->as.generic_inst.base);
-            fprintf(out, "[");
+            tw_printf(out, "[");
             for (size_t i = 0; i < type->as.generic_inst.arg_count; i++) {
-                if (i > 0) fprintf(out, ", ");
+                if (i > 0) tw_printf(out, ", ");
                 type_print_internal(out, type->as.generic_inst.args[i]);
             }
-            fprintf(out, "]");
+            tw_printf(out, "]");
+            break;
+        case TYPE_CONST_ARG:
+            tw_printf(out, "%lld", (long long)type->as.const_arg.value);
             break;
         default: break;
     }
@@ -115,30 +145,47 @@ static void type_print_internal(FILE *out, const Type *type) {
  * Public API wrapper for printing types.
  */
 void type_print(FILE *out, const Type *type) {
-    type_print_internal(out, type);
+    TypeWriter w = { out, NULL, 0, 0 };
+    type_print_internal(&w, type);
+}
+
+/**
+ * Formats a type into `buf` like snprintf: the result is always terminated
+ * (when `cap` > 0) and the return value is the full length.
+ */
+size_t type_format(char *buf, size_t cap, const Type *type) {
+    TypeWriter w = { NULL, buf, cap, 0 };
+    if (cap > 0) buf[0] = '\0';
+    type_print_internal(&w, type);
+    return w.len;
 }
 
 // =============================================================================
 // CLI DUMP FORMATTING HELPERS
 // =============================================================================
 
-static const char* get_kind_name(const Type *type) {
-    if (!type) return "NULL";
-    switch (type->kind) {
+const char *type_kind_name(TypeKind kind) {
+    switch (kind) {
         case TYPE_VOID:      return "Void";
         case TYPE_PRIMITIVE: return "Primitive";
         case TYPE_POINTER:   return "Pointer";
         case TYPE_ARRAY:     return "Array";
         case TYPE_SLICE:     return "Slice";
+        case TYPE_VECTOR:    return "Vector";
         case TYPE_STRUCT:    return "Struct";
         case TYPE_FUNCTION:  return "Function";
         case TYPE_ENUM:      return "Enum";
         case TYPE_TYPEVAR:     return "TypeVar";
         case TYPE_GENERIC_INST:return "GenericInst";
+        case TYPE_CONST_ARG:   return "ConstArg";
         default:             return "Unknown";
     }
 }
 
+static const char* get_kind_name(const Type *type) {
+    return type ? type_kind_name(type->kind) : "NULL";
+}
+
 static const char* get_kind_color(const Type *type) {
     if (!type) return RESET;
     switch (type->kind) {
@@ -147,6 +194,7 @@ static const char* get_kind_color(const Type *type) {
         case TYPE_POINTER:   return COL_KIND_POINTER;
         case TYPE_ARRAY:     return COL_KIND_ARRAY;
         case TYPE_SLICE:     return COL_KIND_SLICE;
+        case TYPE_VECTOR:    return COL_KIND_ARRAY;
         case TYPE_STRUCT:    return COL_KIND_STRUCT;
         case TYPE_FUNCTION:  return COL_KIND_FUNCTION;
         case TYPE_ENUM:      return COL_KIND_OTHER;
@@ -201,7 +249,7 @@ static void print_interned_type_line(int index, int index_width, const Type *typ
     printf("  " COL_INDEX "[%*d]" RESET "%*s", index_width, index,
         (int)(index_col_width - (index_width + 2) + 2), "");
     printf("%s%-9s" RESET "  ", get_kind_color(type), get_kind_name(type));
-    type_print_internal(stdout, type);
+    type_print(stdout, type);
     printf("\n");
 }
 
@@ -261,7 +309,7 @@ void type_print_store_dump(TypeStore *store, Scope *global_scope) {
     }
 
     for (size_t i = 0; i < global_scope->symbols_list.count; i++) {
-        Symbol *sym = *(Symbol**)dynarray_get(&global_scope->symbols_list, i);
+        Symbol *sym = DYNARRAY_AT(Symbol*, &global_scope->symbols_list, i);
         if (!sym) continue;
 
         const char *name = safe_symbol_name(sym->name_rec);
@@ -280,7 +328,7 @@ void type_print_store_dump(TypeStore *store, Scope *global_scope) {
         // Type Information
         if (sym->type) {
             printf("    type:   ");
-            type_print_internal(stdout, sym->type);
+            type_print(stdout, sym->type);
             printf("\n");
             
             // Nested Fields (For Structs)
@@ -289,7 +337,7 @@ void type_print_store_dump(TypeStore *store, Scope *global_scope) {
                 for (size_t f = 0; f < sym->type->as.struct_type.field_count; f++) {
                     StructField *field = &sym->type->as.struct_type.fields[f];
                     printf("      - %s: ", safe_symbol_name(field->name));
-                    type_print_internal(stdout, field->type);
+                    type_print(stdout, field->type);
                     printf(" %s(%s)" RESET "\n", get_kind_color(field->type), get_kind_name(field->type));
                 }
             }
@@ -302,14 +350,14 @@ void type_print_store_dump(TypeStore *store, Scope *global_scope) {
                 for (size_t p = 0; p < param_count; p++) {
                     Type *param_type = sym->type->as.func.params[p];
                     printf("      param[%zu]: ", p);
-                    type_print_internal(stdout, param_type);
+                    type_print(stdout, param_type);
                     printf(" %s(%s)" RESET "\n", get_kind_color(param_type), get_kind_name(param_type));
                 }
 
                 Type *return_type = sym->type->as.func.return_type;
                 if (return_type) {
                     printf("    return: ");
-                    type_print_internal(stdout, return_type);
+                    type_print(stdout, return_type);
                     printf(" %s(%s)" RESET "\n", get_kind_color(return_type), get_kind_name(return_type));
                 }
             }
@@ -332,8 +380,8 @@ void type_print_store_dump(TypeStore *store, Scope *global_scope) {
         }
 
         // Module Path Info
-        if (sym->kind == SYMBOL_VALUE_MODULE && sym->filename) {
-            printf("    path:   " DIM "%s" RESET "\n", sym->filename);
+        if (sym->kind == SYMBOL_VALUE_MODULE && source_path(sym->file)) {
+            printf("    path:   " DIM "%s" RESET "\n", source_path(sym->file));
         }
 
         printf("\n");
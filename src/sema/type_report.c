@@ -1,6 +1,6 @@
 #include "sema/type_report.h"
 #include "sema/type_print.h"
-#include "core/file.h"
+#include "core/source_map.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -46,10 +46,12 @@ static void print_type_quoted(FILE *f, const Type *type) {
 void print_type_error(TypeError *err) {
     if (!err) return;
 
-    fprintf(stderr, "%s%s:%zu:%zu: %serror:%s ", 
+    SourcePos start = span_start_pos(err->span);
+    const char *path = source_path(err->span.file);
+    fprintf(stderr, "%s%s:%u:%u: %serror:%s ", 
         COL_BOLD, 
-        err->filename ? err->filename : "<input>", 
-        err->span.start_line, err->span.start_col, 
+        path ? path : "<input>", 
+        start.line, start.col, 
         COL_RED, COL_RESET);
 
     switch (err->kind) {
@@ -79,6 +81,30 @@ void print_type_error(TypeError *err) {
         case TE_INSTANTIATION_DEPTH:
             fprintf(stderr, "Maximum generic instantiation depth exceeded for '%s%s%s'. Possible infinite recursion.\n", COL_YELLOW, err->as.name.name, COL_RESET);
             break;
+        case TE_SYNTAX:
+            fprintf(stderr, "Syntax error: %s.\n", err->as.name.name);
+            break;
+        case TE_CONST_EVAL:
+            fprintf(stderr, "Cannot evaluate '%s%s%s' at compile time: it %s.\n", COL_YELLOW, err->as.const_eval.name, COL_RESET, err->as.const_eval.reason);
+            break;
+        case TE_NOT_PURE:
+            fprintf(stderr, "'%s%s%s' is marked @pure but may write memory its callers can see.\n", COL_YELLOW, err->as.name.name, COL_RESET);
+            break;
+        case TE_INVALID_VECTOR:
+            fprintf(stderr, "Invalid vector operation: %s.\n", err->as.name.name);
+            break;
+        case TE_INVALID_ATOMIC:
+            fprintf(stderr, "Invalid atomic operation: %s.\n", err->as.name.name);
+            break;
+        case TE_INVALID_HINT:
+            fprintf(stderr, "Invalid optimizer hint: %s.\n", err->as.name.name);
+            break;
+        case TE_INVALID_TAIL_CALL:
+            fprintf(stderr, "Invalid tail call: %s.\n", err->as.name.name);
+            break;
+        case TE_INVALID_ASYNC:
+            fprintf(stderr, "Invalid async code: %s.\n", err->as.name.name);
+            break;
         case TE_INCOMPLETE_TYPE:
              fprintf(stderr, "Incomplete type: '%s%s%s'.\n", COL_YELLOW, err->as.name.name, COL_RESET);
              break;
@@ -155,6 +181,37 @@ void print_type_error(TypeError *err) {
             print_type_quoted(stderr, err->as.bad_usage.actual);
             fprintf(stderr, " is not callable.\n");
             break;
+        case TE_NOT_ITERABLE:
+            fprintf(stderr, "Expression of type ");
+            print_type_quoted(stderr, err->as.bad_usage.actual);
+            fprintf(stderr, " cannot be iterated; expected an array or slice.\n");
+            break;
+        case TE_NOT_SWITCHABLE:
+            fprintf(stderr, "Cannot switch over a value of type ");
+            print_type_quoted(stderr, err->as.bad_usage.actual);
+            fprintf(stderr, "; expected an integer, char or enum.\n");
+            break;
+        case TE_DUPLICATE_CASE:
+            fprintf(stderr, "Case value already handled by an earlier case of this switch.\n");
+            break;
+        case TE_NONEXHAUSTIVE_SWITCH:
+            fprintf(stderr, "Switch over ");
+            print_type_quoted(stderr, err->as.field.type);
+            fprintf(stderr, " does not handle '%s%s%s'; add a case or an else arm.\n", COL_YELLOW, err->as.field.name, COL_RESET);
+            break;
+        case TE_INVALID_CONST_ARG:
+            if (!err->as.field.type) {
+                fprintf(stderr, "Generic parameter '%s%s%s' takes a type, not a value.\n", COL_YELLOW, err->as.field.name, COL_RESET);
+            } else if (!type_is_integer(err->as.field.type)) {
+                fprintf(stderr, "Const parameter '%s%s%s' must have an integer type, not ", COL_YELLOW, err->as.field.name, COL_RESET);
+                print_type_quoted(stderr, err->as.field.type);
+                fprintf(stderr, ".\n");
+            } else {
+                fprintf(stderr, "Const parameter '%s%s%s' takes a constant that fits in ", COL_YELLOW, err->as.field.name, COL_RESET);
+                print_type_quoted(stderr, err->as.field.type);
+                fprintf(stderr, ".\n");
+            }
+            break;
         case TE_NOT_INDEXABLE:
             fprintf(stderr, "Expression of type ");
             print_type_quoted(stderr, err->as.bad_usage.actual);
@@ -200,11 +257,12 @@ void print_type_error(TypeError *err) {
             break;
     }
 
-    if (err->filename && err->span.start_line > 0) {
-        if (err->span.start_line == err->span.end_line && err->span.end_col > err->span.start_col) {
-            print_source_excerpt_span(err->filename, err->span.start_line, err->span.start_col, err->span.end_col);
+    if (start.line > 0) {
+        SourcePos end = span_end_pos(err->span);
+        if (start.line == end.line && end.col > start.col) {
+            print_source_excerpt_span(err->span.file, start.line, start.col, end.col);
         } else {
-            print_source_excerpt(err->filename, err->span.start_line, err->span.start_col);
+            print_source_excerpt(err->span.file, start.line, start.col);
         }
     }
 }
\ No newline at end of file
@@ -19,7 +19,7 @@ bool type_is_unsigned(Type *t) {
     if (!t) return false;
     if (t->kind != TYPE_PRIMITIVE) return false;
     switch (t->as.primitive) {
-        case PRIM_U8: case PRIM_U16: case PRIM_U32: case PRIM_U64:
+        case PRIM_U8: case PRIM_U16: case PRIM_U32: case PRIM_U64: case PRIM_USIZE:
             return true;
         default:
             return false;
@@ -44,6 +44,14 @@ bool type_is_char(Type *t) {
     return t->as.primitive == PRIM_CHAR;
 }
 
+bool type_is_vector(Type *t) {
+    return t && t->kind == TYPE_VECTOR;
+}
+
+bool type_is_mask(Type *t) {
+    return type_is_vector(t) && type_is_bool(t->as.vector.base);
+}
+
 bool type_is_void(Type *t) {
     return t && t->kind == TYPE_VOID;
 }
@@ -3,13 +3,24 @@
 #include "sema/type_utils.h"
 #include "sema/symbol_utils.h"
 #include "sema/typecheck_expr.h"
+#include "sema/const_eval.h"
+#include "sema/reachability.h"
+#include "sema/decl_deps.h"
+#include "sema/purity.h"
+#include "sema/type_layout.h"
 #include "core/utils.h"
 #include "core/error.h"
+#include "core/trace.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
 #include "datastructures/dynamic_array.h"
 #include "codegen/codegen_utils.h"
+#include "parsing/parse_declarations.h"
+#include "parsing/template_body.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 // Forward declarations
 static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt, Type *return_type);
@@ -19,8 +30,9 @@ static Type *instantiate_generic_struct(TypeCheckContext *ctx, Scope *scope, Sym
 static size_t type_mangled_len(Type *t);
 static void type_to_mangled_str_append(Type *t, char **buf);
 static void drain_mono_queue(TypeCheckContext *ctx);
+static void sort_mono_queue(TypeCheckContext *ctx, size_t start);
 
-TypeCheckContext typecheck_context_create(Arena *arena, TypeStore *store, DenseArenaInterner *identifiers, DenseArenaInterner *keywords, const char *filename, ModuleLoader *loader) {
+TypeCheckContext typecheck_context_create(Arena *arena, TypeStore *store, DenseArenaInterner *identifiers, DenseArenaInterner *keywords, SourceId file, ModuleLoader *loader) {
     DynArray *errors = arena_alloc(arena, sizeof(DynArray));
     dynarray_init_in_arena(errors, arena, sizeof(TypeError), 8);
     DynArray *mono_queue = arena_alloc(arena, sizeof(DynArray));
@@ -30,15 +42,126 @@ TypeCheckContext typecheck_context_create(Arena *arena, TypeStore *store, DenseA
         .store = store,
         .identifiers = identifiers,
         .keywords = keywords,
-        .filename = filename,
+        .file = file,
         .errors = errors,
         .loader = loader,
         .current_pass = 0,
-        .mono_queue = mono_queue
+        .mono_queue = mono_queue,
+        .locals = symbol_table_create(arena, identifiers ? identifiers->dense_index_count : 0),
+        .arena = store ? store->arena : arena
     };
 }
 
-#define FAST_GET(arr, i) (((AstNode**)(arr)->data)[i])
+// -----------------------------------------------------------------------------
+// Parallel Passes: Shared State
+// -----------------------------------------------------------------------------
+
+/* Where a job asked for an instance: after `at` of its own errors. */
+typedef struct {
+    void *key;  // See sema_note_instance
+    size_t at;
+} InstanceRequest;
+
+/*
+ * One job of a parallel pass: a unit's signatures (pass 1) or a body (pass
+ * 2). Pass 2 also keeps a job per global variable, checked up front, so its
+ * errors keep their place in declaration order.
+ */
+typedef struct {
+    CompilationUnit *unit; // Pass 1: the unit to resolve
+    AstNode *func;         // Pass 2: the function or method to check
+    Scope *scope;          // Global scope of its unit
+    DynArray errors;       // DynArray<TypeError> raised while running it
+    DynArray requests;     // DynArray<InstanceRequest>, in the order they were made
+} SemaJob;
+
+typedef struct SemaPool {
+    // Held for reading while a job runs and for writing while shared sema
+    // state changes (see sema_exclusive_begin)
+    pthread_rwlock_t sema_lock;
+    pthread_mutex_t queue_lock; // Guards `next`
+    SemaJob **queue;            // Jobs of the current run
+    size_t queue_count;
+    size_t next;
+    HashMap *late_errors;   // Instance key -> DynArray<TypeError>* raised checking it
+    HashMap *late_deps;     // Instance key -> DynArray<void*> of instances it asked for
+} SemaPool;
+
+typedef struct SemaWorker {
+    SemaPool *pool;
+    TypeCheckContext ctx;
+    Arena *arena;
+    int exclusive_depth;
+    DynArray *body_errors; // ctx.errors outside the current exclusive section
+    SemaJob *job;          // The job being run
+    DynArray section_errors; // DynArray<TypeError> of the current exclusive section
+    void *section_key;     // First instance asked for in it, which its errors belong to
+    pthread_t thread;
+} SemaWorker;
+
+/*
+ * Global scopes, struct method tables, the mono queue and global constants
+ * only change inside an exclusive section (pass 1 workers fill their own
+ * unit's scope outside of one). On a pool worker that trades the
+ * shared read lock for the write lock, so no other body is being checked
+ * meanwhile; serially both calls do nothing. Whichever worker first needs
+ * an instance checks it, while serially the first body in declaration order
+ * that asks for it would have. Errors raised in a section therefore belong
+ * to the first instance it asked for (sema_note_instance) and are merged
+ * where the first job to ask for that instance asked; a section that asks
+ * for none keeps its errors in the job's own list.
+ */
+static void sema_exclusive_begin(TypeCheckContext *ctx) {
+    SemaWorker *w = ctx->worker;
+    if (!w || w->exclusive_depth++ > 0) return;
+    pthread_rwlock_unlock(&w->pool->sema_lock);
+    pthread_rwlock_wrlock(&w->pool->sema_lock);
+    w->body_errors = ctx->errors;
+    w->section_key = NULL;
+    w->section_errors.count = 0;
+    ctx->errors = &w->section_errors;
+}
+
+static void sema_exclusive_end(TypeCheckContext *ctx) {
+    SemaWorker *w = ctx->worker;
+    if (!w || --w->exclusive_depth > 0) return;
+    DynArray *dest = w->body_errors;
+    if (w->section_key && w->section_errors.count > 0) {
+        dest = ptrmap_get(w->pool->late_errors, w->section_key);
+        if (!dest) {
+            dest = xcalloc(1, sizeof(DynArray));
+            dynarray_init(dest, sizeof(TypeError));
+            ptrmap_put(w->pool->late_errors, w->section_key, dest);
+        }
+    }
+    for (size_t e = 0; e < w->section_errors.count; e++) dynarray_push_value(dest, dynarray_get(&w->section_errors, e));
+    ctx->errors = w->body_errors;
+    pthread_rwlock_unlock(&w->pool->sema_lock);
+    pthread_rwlock_rdlock(&w->pool->sema_lock);
+}
+
+void sema_note_instance(TypeCheckContext *ctx, void *key) {
+    SemaWorker *w = ctx->worker;
+    if (!w || !w->job || !key) return;
+    if (w->exclusive_depth > 0 && w->section_key && w->section_key != key) {
+        // Asked for while checking another instance: merged right after it
+        DynArray *deps = ptrmap_get(w->pool->late_deps, w->section_key);
+        if (!deps) {
+            deps = xcalloc(1, sizeof(DynArray));
+            dynarray_init(deps, sizeof(void*));
+            ptrmap_put(w->pool->late_deps, w->section_key, deps);
+        }
+        dynarray_push_value(deps, &key);
+        return;
+    }
+    if (w->exclusive_depth > 0) {
+        if (w->section_key) return;
+        w->section_key = key;
+    }
+    DynArray *errors = w->exclusive_depth > 0 ? w->body_errors : ctx->errors;
+    InstanceRequest req = { key, errors->count };
+    dynarray_push_value(&w->job->requests, &req);
+}
 
 // -----------------------------------------------------------------------------
 // AST Patching & Resolution Helpers
@@ -56,7 +179,7 @@ static void patch_inferred_array_sizes(TypeCheckContext *ctx, AstNode *type_ast,
             );
 
             if (!type_ast->data.ast_type.u.array.size_expr) {
-                AstNode *size_lit = ast_create_node(AST_LITERAL, ctx->store->arena, ctx->filename);
+                AstNode *size_lit = ast_create_node(AST_LITERAL, ctx->arena, ctx->file);
                 if (size_lit) {
                     size_lit->node_type = AST_LITERAL;
                     size_lit->span = type_ast->span;
@@ -84,14 +207,14 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
     TypeStore *store = ctx->store;
 
     if (node->node_type == AST_IDENTIFIER) {
-        Symbol *sym = scope_lookup_symbol(scope, node->data.identifier.intern_result, ctx->filename);
+        Symbol *sym = scope_lookup_symbol(scope, node->data.identifier.intern_result, ctx->file);
         if (sym) {
             if (sym->kind == SYMBOL_VALUE_TYPE) {
                 if (sym->type) return sym->type;
                 if (sym->decl_node && sym->decl_node->type) return sym->decl_node->type;
             }
             if (sym->kind == SYMBOL_GENERIC_STRUCT || sym->kind == SYMBOL_GENERIC_FUNCTION) {
-                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
             }
@@ -106,7 +229,7 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
             }
         }
         // Also check primitives
-        Type *prim = (Type*)hashmap_get(store->primitive_registry, node->data.identifier.intern_result->key, ptr_hash, ptr_cmp);
+        Type *prim = (Type*)ptrmap_get(store->primitive_registry, node->data.identifier.intern_result->key);
         if (prim) return prim;
 
         return NULL;
@@ -124,13 +247,13 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                 if (curr->decl_node && curr->decl_node->type) return curr->decl_node->type;
             }
             if (curr && (curr->kind == SYMBOL_GENERIC_STRUCT || curr->kind == SYMBOL_GENERIC_FUNCTION)) {
-                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
             }
             if (!curr && sym && sym->type) return sym->type;
             if (!curr && sym && (sym->kind == SYMBOL_GENERIC_STRUCT || sym->kind == SYMBOL_GENERIC_FUNCTION)) {
-                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
             }
@@ -141,17 +264,17 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
     if (node->node_type == AST_GENERIC_INST_EXPR) {
         AstGenericInstExpr *inst = &node->data.generic_inst_expr;
         size_t count = inst->type_args ? inst->type_args->count : 0;
-        Type **arg_types = count > 0 ? arena_alloc(ctx->store->arena, sizeof(Type*) * count) : NULL;
+        Type **arg_types = count > 0 ? arena_alloc(ctx->arena, sizeof(Type*) * count) : NULL;
         for (size_t i = 0; i < count; i++) {
-            AstNode *arg_node = *(AstNode**)dynarray_get(inst->type_args, i);
-            Type *arg_t = resolve_ast_type(ctx, scope, arg_node);
+            AstNode *arg_node = DYNARRAY_AT(AstNode*, inst->type_args, i);
+            Type *arg_t = resolve_generic_arg(ctx, scope, arg_node);
             if (!arg_t) { return NULL; }
             arg_types[i] = arg_t;
         }
 
         Symbol *sym = NULL;
         if (inst->base->node_type == AST_IDENTIFIER) {
-            sym = scope_lookup_symbol(scope, inst->base->data.identifier.intern_result, ctx->filename);
+            sym = scope_lookup_symbol(scope, inst->base->data.identifier.intern_result, ctx->file);
         } else if (inst->base->node_type == AST_MEMBER_EXPR) {
             check_expression(ctx, scope, inst->base, NULL);
             if (inst->base->node_type == AST_MEMBER_EXPR) {
@@ -162,10 +285,12 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
         }
 
         if (sym && sym->kind == SYMBOL_GENERIC_STRUCT) {
+            sema_exclusive_begin(ctx);
             Type *inst_type = instantiate_generic_struct(ctx, scope, sym, arg_types, count, node->span);
             if (ctx->current_pass > 0) {
                 drain_mono_queue(ctx);
             }
+            sema_exclusive_end(ctx);
             return inst_type;
         }
 
@@ -194,22 +319,22 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                     if (!curr && sym && sym->type) return sym->type;
                 }
 
-                TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = node->span, .filename = ctx->filename, .as.name.name = "Path does not resolve to a type" };
+                TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = node->span, .as.name.name = "Path does not resolve to a type" };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
             }
 
             InternResult *name_res = ast_ty->u.base.intern_result;
             if (name_res && name_res->key) {
-                Type *prim = (Type*)hashmap_get(store->primitive_registry, name_res->key, ptr_hash, ptr_cmp);
+                Type *prim = (Type*)ptrmap_get(store->primitive_registry, name_res->key);
                 if (prim) return prim;
                 
                 if (scope) {
-                    Symbol *sym = scope_lookup_symbol(scope, name_res, ctx->filename);
+                    Symbol *sym = scope_lookup_symbol(scope, name_res, ctx->file);
                     if (sym) {
                         if (sym->kind == SYMBOL_VALUE_TYPE) return sym->type;
                         if (sym->kind == SYMBOL_GENERIC_STRUCT) {
-                            TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span, .filename = ctx->filename };
+                            TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span };
                             dynarray_push_value(ctx->errors, &err);
                             return NULL;
                         }
@@ -218,7 +343,7 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                              while (target && target->kind == SYMBOL_VALUE_ALIAS) target = target->target_symbol;
                              if (target && target->kind == SYMBOL_VALUE_TYPE) return target->type;
                              if (target && target->kind == SYMBOL_GENERIC_STRUCT) {
-                                 TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span, .filename = ctx->filename };
+                                 TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = node->span };
                                  dynarray_push_value(ctx->errors, &err);
                                  return NULL;
                              }
@@ -227,7 +352,7 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                     }
                 }
                 const char *name_str = ((Slice*)name_res->key)->ptr;
-                TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = node->span, .filename = ctx->filename, .as.name.name = name_str };
+                TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = node->span, .as.name.name = name_str };
                 dynarray_push_value(ctx->errors, &err);
             }
             return NULL; 
@@ -253,12 +378,12 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                 Type *sz_type = check_expression(ctx, scope, sz, store->t_i64);
                 if (sz_type) {
                     if (!type_is_integer(sz_type)) {
-                        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = sz->span, .filename = ctx->filename, .as.mismatch = { .expected = store->t_i64, .actual = sz_type } };
+                        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = sz->span, .as.mismatch = { .expected = store->t_i64, .actual = sz_type } };
                         dynarray_push_value(ctx->errors, &err);
                         return NULL;
                     }
                     if (!sz->is_foldable_const) {
-                        TypeError err = { .kind = TE_NOT_CONST, .span = sz->span, .filename = ctx->filename };
+                        TypeError err = { .kind = TE_NOT_CONST, .span = sz->span };
                         dynarray_push_value(ctx->errors, &err);
                         return NULL;
                     }
@@ -283,34 +408,69 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
             return res ? (Type*)((Slice*)res->key)->ptr : NULL;
         }
 
+        case AST_TYPE_VECTOR: {
+            Type *elem = resolve_ast_type(ctx, scope, ast_ty->u.array.elem);
+            if (!elem) return NULL;
+            if (!type_is_integer(elem) && !type_is_float(elem) && !type_is_bool(elem)) {
+                TypeError err = { .kind = TE_INVALID_VECTOR, .span = ast_ty->u.array.elem->span, .as.name.name = "lanes must be integers, floats or bool" };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+
+            AstNode *lanes = ast_ty->u.array.size_expr;
+            Type *lanes_type = check_expression(ctx, scope, lanes, store->t_i64);
+            if (!lanes_type) return NULL;
+            if (!type_is_integer(lanes_type)) {
+                TypeError err = { .kind = TE_TYPE_MISMATCH, .span = lanes->span, .as.mismatch = { .expected = store->t_i64, .actual = lanes_type } };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            if (!lanes->is_foldable_const) {
+                TypeError err = { .kind = TE_NOT_CONST, .span = lanes->span };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            int64_t count = lanes->const_value.value.int_val;
+            if (count <= 0 || count > VECTOR_MAX_LANES) {
+                TypeError err = { .kind = TE_INVALID_VECTOR, .span = lanes->span, .as.name.name = "lane count must be between 1 and 1024" };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            return make_vector_type(store, elem, count);
+        }
+
         case AST_TYPE_FUNC: {
              Type *ret = resolve_ast_type(ctx, scope, ast_ty->u.func.return_type);
              if (!ret) ret = store->t_void; 
              DynArray *params = ast_ty->u.func.param_types;
              size_t count = params ? params->count : 0;
+             // The prototype's parameter array is copied on intern
+             ArenaScratch scratch = arena_scratch_begin();
              Type **param_types = NULL;
              if (count > 0) {
-                 param_types = arena_alloc(ctx->store->arena, sizeof(Type*) * count);
+                 param_types = arena_alloc(scratch.arena, sizeof(Type*) * count);
              }
              for (size_t i = 0; i < count; i++) {
-                 AstNode *p_node = FAST_GET(params, i);
+                 AstNode *p_node = DYNARRAY_AT(AstNode*, params, i);
                  Type *pt = resolve_ast_type(ctx, scope, p_node);
                  if (!pt) {
+                     arena_scratch_end(scratch);
                      return NULL; 
                  }
                  param_types[i] = pt;
              }
              Type proto = { .kind = TYPE_FUNCTION, .as.func.return_type = ret, .as.func.param_count = count, .as.func.params = param_types };
              InternResult *res = intern_type(store, &proto);
+             arena_scratch_end(scratch);
              return res ? (Type*)((Slice*)res->key)->ptr : NULL;
         }
         case AST_TYPE_APPLICATION: {
              DynArray *args = ast_ty->u.application.args;
              size_t count = args ? args->count : 0;
-             Type **arg_types = count > 0 ? arena_alloc(ctx->store->arena, sizeof(Type*) * count) : NULL;
+             Type **arg_types = count > 0 ? arena_alloc(ctx->arena, sizeof(Type*) * count) : NULL;
              for (size_t i = 0; i < count; i++) {
-                 AstNode *arg_node = FAST_GET(args, i);
-                 Type *arg_t = resolve_ast_type(ctx, scope, arg_node);
+                 AstNode *arg_node = DYNARRAY_AT(AstNode*, args, i);
+                 Type *arg_t = resolve_generic_arg(ctx, scope, arg_node);
                  if (!arg_t) {
                      return NULL;
                  }
@@ -330,25 +490,27 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
                              sym = base_ty->u.base.path->data.identifier.symbol;
                          }
                      } else if (base_ty->u.base.intern_result) {
-                         sym = scope_lookup_symbol(scope, base_ty->u.base.intern_result, ctx->filename);
+                         sym = scope_lookup_symbol(scope, base_ty->u.base.intern_result, ctx->file);
                      }
                  }
              } else if (base_node && base_node->node_type == AST_IDENTIFIER) {
-                 sym = scope_lookup_symbol(scope, base_node->data.identifier.intern_result, ctx->filename);
+                 sym = scope_lookup_symbol(scope, base_node->data.identifier.intern_result, ctx->file);
              }
 
              if (sym && sym->kind == SYMBOL_GENERIC_STRUCT) {
+                 sema_exclusive_begin(ctx);
                  Type *inst_type = instantiate_generic_struct(ctx, scope, sym, arg_types, count, node->span);
                  if (ctx->current_pass > 0) {
                      drain_mono_queue(ctx);
                  }
+                 sema_exclusive_end(ctx);
                  return inst_type;
              }
 
              if (!sym) {
                  // Error handled elsewhere
              } else {
-                 TypeError err = { .kind = TE_NOT_GENERIC, .span = node->span, .filename = ctx->filename };
+                 TypeError err = { .kind = TE_NOT_GENERIC, .span = node->span };
                  err.as.name.name = ((Slice*)sym->name_rec->key)->ptr;
                  dynarray_push_value(ctx->errors, &err);
              }
@@ -359,6 +521,94 @@ Type *resolve_ast_type(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
     return NULL;
 }
 
+Type *resolve_generic_arg(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
+    if (!node) return NULL;
+    AstNode *value = node;
+    AstNode named = {0};
+    if (node->node_type == AST_TYPE) {
+        // The parser reads a bare name as a type; it is a value if it names a constant
+        AstType *ast_ty = &node->data.ast_type;
+        if (ast_ty->kind != AST_TYPE_PRIMITIVE || ast_ty->u.base.path || !ast_ty->u.base.intern_result || !scope) {
+            return resolve_ast_type(ctx, scope, node);
+        }
+        Symbol *sym = scope_lookup_symbol(scope, ast_ty->u.base.intern_result, ctx->file);
+        if (!sym || sym->kind != SYMBOL_VARIABLE) return resolve_ast_type(ctx, scope, node);
+        named.node_type = AST_IDENTIFIER;
+        named.span = node->span;
+        named.data.identifier.intern_result = ast_ty->u.base.intern_result;
+        value = &named;
+    }
+
+    Type *t = check_expression(ctx, scope, value, NULL);
+    if (!t) return NULL;
+    if (!type_is_integer(t) || !value->is_foldable_const || value->const_value.type != INT_LITERAL) {
+        TypeError err = { .kind = TE_NOT_CONST, .span = node->span };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    return make_const_arg_type(ctx->store, value->const_value.value.int_val);
+}
+
+/*
+ * Check the arguments of a template against its parameters: a type for each
+ * type parameter, and for each const parameter a constant that fits the
+ * parameter's integer type. `const_params` is the template's own list.
+ */
+static bool check_generic_arg_kinds(TypeCheckContext *ctx, Scope *scope, DynArray *type_params, DynArray *const_params, Type **args, size_t count, Span error_span) {
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        InternResult *tp_name = DYNARRAY_AT(InternResult*, type_params, i);
+        AstNode *const_type = const_params ? DYNARRAY_AT(AstNode*, const_params, i) : NULL;
+        bool is_value = args[i]->kind == TYPE_CONST_ARG;
+        TypeError err = { .kind = TE_INVALID_CONST_ARG, .span = error_span };
+        err.as.field.name = ((Slice*)tp_name->key)->ptr;
+
+        if (!const_type) {
+            if (!is_value) continue;
+        } else {
+            Type *param_type = resolve_ast_type(ctx, scope, const_type);
+            if (!param_type) { ok = false; continue; }
+            err.as.field.type = param_type;
+            int64_t size = 0;
+            int32_t align = 0;
+            if (is_value && type_is_integer(param_type) && type_layout(param_type, &size, &align)) {
+                int64_t v = args[i]->as.const_arg.value;
+                if (type_is_unsigned(param_type)) {
+                    if (v >= 0 && (size >= 8 || (uint64_t)v < (1ULL << (size * 8)))) continue;
+                } else {
+                    int64_t limit = size >= 8 ? INT64_MAX : (int64_t)(1ULL << (size * 8 - 1)) - 1;
+                    if (v <= limit && v >= -limit - 1) continue;
+                }
+            }
+        }
+        dynarray_push_value(ctx->errors, &err);
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+ * Bind the parameters of a template in an instance scope: a type parameter
+ * names its argument type, a const parameter is a constant of its declared
+ * type whose value folds wherever it is used (array sizes included).
+ */
+static void bind_type_params(TypeCheckContext *ctx, Scope *inst_scope, DynArray *type_params, DynArray *const_params, Type **args, size_t count, Span span, SourceId file) {
+    for (size_t i = 0; i < count; i++) {
+        InternResult *tp_name = DYNARRAY_AT(InternResult*, type_params, i);
+        AstNode *const_type = const_params ? DYNARRAY_AT(AstNode*, const_params, i) : NULL;
+        if (!const_type || args[i]->kind != TYPE_CONST_ARG) {
+            define_symbol_or_error(ctx, inst_scope, tp_name, args[i], SYMBOL_VALUE_TYPE, span, false, file, NULL);
+            continue;
+        }
+        Type *param_type = resolve_ast_type(ctx, inst_scope, const_type);
+        define_symbol_or_error(ctx, inst_scope, tp_name, param_type, SYMBOL_VARIABLE, span, false, file, NULL);
+        Symbol *param = scope_lookup_symbol_local(inst_scope, tp_name);
+        if (!param) continue;
+        param->flags |= SYMBOL_FLAG_CONST | SYMBOL_FLAG_COMPUTED_VALUE | SYMBOL_FLAG_INITIALIZED;
+        param->value.int_val = args[i]->as.const_arg.value;
+    }
+}
+
 static void resolve_function_decl(TypeCheckContext *ctx, Scope *scope, AstNode *func_node) {
     if (func_node->node_type != AST_FUNCTION_DECLARATION) return;
     AstFunctionDeclaration *decl = &func_node->data.function_declaration;
@@ -367,16 +617,21 @@ static void resolve_function_decl(TypeCheckContext *ctx, Scope *scope, AstNode *
     if (!ret_type) ret_type = ctx->store->t_void; 
 
     size_t param_count = decl->params ? decl->params->count : 0;
+    ArenaScratch scratch = arena_scratch_begin();
     Type **param_types = NULL;
-    if (param_count > 0) param_types = arena_alloc(ctx->store->arena, sizeof(Type*) * param_count);
+    if (param_count > 0) param_types = arena_alloc(scratch.arena, sizeof(Type*) * param_count);
 
     for (size_t i = 0; i < param_count; i++) {
-        AstNode *param_node = *(AstNode**)dynarray_get(decl->params, i);
+        AstNode *param_node = DYNARRAY_AT(AstNode*, decl->params, i);
         Type *pt = resolve_ast_type(ctx, scope, param_node->data.param.type);
         if (!pt) pt = ctx->store->t_void; 
         
         if (type_is_void(pt)) {
-            TypeError err = { .kind = TE_VOID_PARAMETER, .span = param_node->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_VOID_PARAMETER, .span = param_node->span };
+            dynarray_push_value(ctx->errors, &err);
+        }
+        if (param_node->data.param.is_noalias && pt->kind != TYPE_POINTER) {
+            TypeError err = { .kind = TE_INVALID_HINT, .span = param_node->span, .as.name.name = "@noalias needs a pointer parameter" };
             dynarray_push_value(ctx->errors, &err);
         }
 
@@ -384,6 +639,18 @@ static void resolve_function_decl(TypeCheckContext *ctx, Scope *scope, AstNode *
         param_node->type = pt;
     }
 
+    if (decl->attrs & FN_ATTR_ASYNC) {
+        Slice *name = decl->intern_result ? (Slice*)decl->intern_result->key : NULL;
+        const char *reason = NULL;
+        if (decl->target_type_node) reason = "methods cannot be async";
+        else if (!decl->body && !decl->lazy_body) reason = "an async fn needs a body";
+        else if (name && name->len == 4 && memcmp(name->ptr, "main", 4) == 0) reason = "main cannot be async";
+        if (reason) {
+            TypeError err = { .kind = TE_INVALID_ASYNC, .span = func_node->span, .as.name.name = reason };
+            dynarray_push_value(ctx->errors, &err);
+        }
+    }
+
     Type proto = {0};
     proto.kind = TYPE_FUNCTION;
     proto.as.func.return_type = ret_type;
@@ -391,6 +658,7 @@ static void resolve_function_decl(TypeCheckContext *ctx, Scope *scope, AstNode *
     proto.as.func.params = param_types;
     
     InternResult *res = intern_type(ctx->store, &proto);
+    arena_scratch_end(scratch);
     if (res) func_node->type = (Type*)((Slice*)res->key)->ptr;
 }
 
@@ -399,7 +667,7 @@ static bool check_struct_cycle(TypeCheckContext *ctx, Type *t, DynArray *path) {
 
     // Check if current type is already in the recursion path
     for (size_t i = 0; i < path->count; i++) {
-        if (*(Type**)dynarray_get(path, i) == t) return true;
+        if (DYNARRAY_AT(Type*, path, i) == t) return true;
     }
 
     dynarray_push_value(path, &t);
@@ -429,21 +697,31 @@ static bool check_struct_cycle(TypeCheckContext *ctx, Type *t, DynArray *path) {
 // SECTION 1: GLOBAL SYMBOL REGISTRATION (Phase 1)
 // -----------------------------------------------------------------------------
 
+/* Record a generic template in its unit's table, which grows from the loader's arena. */
+static void register_generic_template(TypeCheckContext *ctx, SourceId file, InternResult *name, AstNode *decl) {
+    CompilationUnit *unit = module_loader_unit_for_file(ctx->loader, file);
+    if (!unit || !unit->generic_templates) return;
+    sema_exclusive_begin(ctx);
+    ptrmap_put(unit->generic_templates, name->key, decl);
+    sema_exclusive_end(ctx);
+}
+
 static void register_program_structs(TypeCheckContext *ctx, Scope *global_scope) {
     if (!ctx || !ctx->program) return;
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_STRUCT_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstStructDeclaration *struct_decl = &decl->data.struct_declaration;
         if (!struct_decl->intern_result) continue;
 
         if (struct_decl->type_params && struct_decl->type_params->count > 0) {
-            Type *struct_type = arena_calloc(ctx->store->arena, sizeof(Type));
+            Type *struct_type = arena_calloc(ctx->arena, sizeof(Type));
+            MEM_ACCOUNT(MEM_TYPES, TYPE_STRUCT, ctx->file, sizeof(Type), 1);
             struct_type->kind = TYPE_STRUCT;
             struct_type->as.struct_type.name = struct_decl->intern_result;
             struct_type->as.struct_type.decl_node = decl;
@@ -453,16 +731,14 @@ static void register_program_structs(TypeCheckContext *ctx, Scope *global_scope)
             struct_type->as.struct_type.methods = NULL;
             decl->type = struct_type;
 
-            define_symbol_or_error(ctx, global_scope, struct_decl->intern_result, decl->type, SYMBOL_GENERIC_STRUCT, decl->span, struct_decl->is_pub, decl->filename, decl);
-            
-            CompilationUnit *unit = module_loader_get_unit(ctx->loader, decl->filename);
-            if (unit && unit->generic_templates) {
-                hashmap_put(unit->generic_templates, struct_decl->intern_result->key, decl, ptr_hash, ptr_cmp);
-            }
+            define_symbol_or_error(ctx, global_scope, struct_decl->intern_result, decl->type, SYMBOL_GENERIC_STRUCT, decl->span, struct_decl->is_pub, decl->span.file, decl);
+
+            register_generic_template(ctx, decl->span.file, struct_decl->intern_result, decl);
             continue;
         }
 
-        Type *struct_type = arena_calloc(ctx->store->arena, sizeof(Type));
+        Type *struct_type = arena_calloc(ctx->arena, sizeof(Type));
+        MEM_ACCOUNT(MEM_TYPES, TYPE_STRUCT, ctx->file, sizeof(Type), 1);
         struct_type->kind = TYPE_STRUCT;
         struct_type->as.struct_type.name = struct_decl->intern_result;
         struct_type->as.struct_type.decl_node = decl;
@@ -472,7 +748,7 @@ static void register_program_structs(TypeCheckContext *ctx, Scope *global_scope)
         struct_type->as.struct_type.methods = NULL; 
 
         decl->type = struct_type;
-        define_symbol_or_error(ctx, global_scope, struct_decl->intern_result, decl->type, SYMBOL_VALUE_TYPE, decl->span, struct_decl->is_pub, decl->filename, decl);
+        define_symbol_or_error(ctx, global_scope, struct_decl->intern_result, decl->type, SYMBOL_VALUE_TYPE, decl->span, struct_decl->is_pub, decl->span.file, decl);
     }
 }
 
@@ -481,15 +757,16 @@ static void register_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_ENUM_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstEnumDeclaration *enum_decl = &decl->data.enum_declaration;
         if (!enum_decl->intern_result) continue;
 
-        Type *enum_type = arena_calloc(ctx->store->arena, sizeof(Type));
+        Type *enum_type = arena_calloc(ctx->arena, sizeof(Type));
+        MEM_ACCOUNT(MEM_TYPES, TYPE_ENUM, ctx->file, sizeof(Type), 1);
         enum_type->kind = TYPE_ENUM;
         enum_type->as.enum_type.name = enum_decl->intern_result;
         enum_type->as.enum_type.decl_node = decl;
@@ -498,7 +775,7 @@ static void register_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
         enum_type->as.enum_type.variant_map = NULL;
         decl->type = enum_type;
 
-        define_symbol_or_error(ctx, global_scope, enum_decl->intern_result, decl->type, SYMBOL_VALUE_TYPE, decl->span, enum_decl->is_pub, decl->filename, decl);
+        define_symbol_or_error(ctx, global_scope, enum_decl->intern_result, decl->type, SYMBOL_VALUE_TYPE, decl->span, enum_decl->is_pub, decl->span.file, decl);
     }
 }
 
@@ -507,15 +784,15 @@ static void register_program_globals(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_VARIABLE_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstVariableDeclaration *var_decl = &decl->data.variable_declaration;
         
         if (var_decl->intern_result && !scope_lookup_symbol_local(global_scope, var_decl->intern_result)) {
-            define_symbol_or_error(ctx, global_scope, var_decl->intern_result, NULL, SYMBOL_VARIABLE, decl->span, var_decl->is_pub, decl->filename, decl);
+            define_symbol_or_error(ctx, global_scope, var_decl->intern_result, NULL, SYMBOL_VARIABLE, decl->span, var_decl->is_pub, decl->span.file, decl);
         }
     }
 }
@@ -525,11 +802,11 @@ static void register_program_functions(TypeCheckContext *ctx, Scope *global_scop
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_FUNCTION_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstFunctionDeclaration *func = &decl->data.function_declaration;
 
         // Methods are registered later, in a separate pass
@@ -537,14 +814,11 @@ static void register_program_functions(TypeCheckContext *ctx, Scope *global_scop
 
         if (func->intern_result) {
             if (func->type_params && func->type_params->count > 0) {
-                define_symbol_or_error(ctx, global_scope, func->intern_result, NULL, SYMBOL_GENERIC_FUNCTION, decl->span, func->is_pub, decl->filename, decl);
-                CompilationUnit *unit = module_loader_get_unit(ctx->loader, decl->filename);
-                if (unit && unit->generic_templates) {
-                    hashmap_put(unit->generic_templates, func->intern_result->key, decl, ptr_hash, ptr_cmp);
-                }
+                define_symbol_or_error(ctx, global_scope, func->intern_result, NULL, SYMBOL_GENERIC_FUNCTION, decl->span, func->is_pub, decl->span.file, decl);
+                register_generic_template(ctx, decl->span.file, func->intern_result, decl);
                 continue;
             }
-            define_symbol_or_error(ctx, global_scope, func->intern_result, NULL, SYMBOL_VALUE_FUNCTION, decl->span, func->is_pub, decl->filename, decl);
+            define_symbol_or_error(ctx, global_scope, func->intern_result, NULL, SYMBOL_VALUE_FUNCTION, decl->span, func->is_pub, decl->span.file, decl);
         }
     }
 }
@@ -554,15 +828,15 @@ static void register_program_aliases(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_ALIAS_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstAliasDeclaration *alias = &decl->data.alias_declaration;
 
         if (alias->alias_name && !scope_lookup_symbol_local(global_scope, alias->alias_name)) {
-            scope_define_symbol(global_scope, alias->alias_name, NULL, SYMBOL_VALUE_ALIAS, decl->filename, false, decl);
+            scope_define_symbol(global_scope, alias->alias_name, NULL, SYMBOL_VALUE_ALIAS, decl->span.file, false, decl);
         }
     }
 }
@@ -572,8 +846,8 @@ static void group_program_methods(TypeCheckContext *ctx, Scope *global_scope) {
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_FUNCTION_DECLARATION) continue;
 
         AstFunctionDeclaration *func = &decl->data.function_declaration;
@@ -581,7 +855,7 @@ static void group_program_methods(TypeCheckContext *ctx, Scope *global_scope) {
         
         Symbol *target_sym = NULL;
         if (func->target_type_node->node_type == AST_IDENTIFIER) {
-            target_sym = scope_lookup_symbol(global_scope, func->target_type_node->data.identifier.intern_result, decl->filename);
+            target_sym = scope_lookup_symbol(global_scope, func->target_type_node->data.identifier.intern_result, decl->span.file);
         }
         
         if (target_sym && (target_sym->kind == SYMBOL_GENERIC_STRUCT || target_sym->kind == SYMBOL_VALUE_TYPE)) {
@@ -589,8 +863,8 @@ static void group_program_methods(TypeCheckContext *ctx, Scope *global_scope) {
             if (struct_node && struct_node->node_type == AST_STRUCT_DECLARATION) {
                 AstStructDeclaration *struct_decl = &struct_node->data.struct_declaration;
                 if (!struct_decl->methods) {
-                    struct_decl->methods = arena_calloc(ctx->store->arena, sizeof(DynArray));
-                    dynarray_init_in_arena(struct_decl->methods, ctx->store->arena, sizeof(AstNode*), 4);
+                    struct_decl->methods = arena_calloc(ctx->arena, sizeof(DynArray));
+                    dynarray_init_in_arena(struct_decl->methods, ctx->arena, sizeof(AstNode*), 4);
                 }
                 dynarray_push_value(struct_decl->methods, &decl);
             }
@@ -607,22 +881,22 @@ static void resolve_program_structs(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_STRUCT_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstStructDeclaration *struct_decl = &decl->data.struct_declaration;
         Type *struct_type = decl->type;
         if (!struct_type || !struct_decl->fields) continue;
 
         if (struct_type->as.struct_type.fields) continue;
 
-        struct_type->as.struct_type.fields = arena_alloc(ctx->store->arena, sizeof(StructField) * struct_type->as.struct_type.field_count);
+        struct_type->as.struct_type.fields = arena_alloc(ctx->arena, sizeof(StructField) * struct_type->as.struct_type.field_count);
         
         // Initialize field_map and methods map
-        struct_type->as.struct_type.field_map = hashmap_create(ctx->store->arena, struct_type->as.struct_type.field_count);
-        struct_type->as.struct_type.methods   = hashmap_create(ctx->store->arena, 4); 
+        struct_type->as.struct_type.field_map = hashmap_create(ctx->arena, struct_type->as.struct_type.field_count);
+        struct_type->as.struct_type.methods   = hashmap_create(ctx->arena, 4); 
 
         for (size_t j = 0; j < struct_type->as.struct_type.field_count; j++) {
             AstFieldDecl *fdecl = (AstFieldDecl*)dynarray_get(struct_decl->fields, j);
@@ -630,15 +904,15 @@ static void resolve_program_structs(TypeCheckContext *ctx, Scope *global_scope)
             struct_type->as.struct_type.fields[j].type = resolve_ast_type(ctx, global_scope, fdecl->type);
             
             // Populate field_map with 1-based index to avoid NULL (0) collisions
-            hashmap_put(struct_type->as.struct_type.field_map, fdecl->name->key, (void*)(uintptr_t)(j + 1), ptr_hash, ptr_cmp);
+            ptrmap_put(struct_type->as.struct_type.field_map, fdecl->name->key, (void*)(uintptr_t)(j + 1));
         }
     }
 
     // Cycle Detection
     DynArray path;
     dynarray_init(&path, sizeof(Type*));
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_STRUCT_DECLARATION) continue;
 
         AstStructDeclaration *struct_decl = &decl->data.struct_declaration;
@@ -646,12 +920,14 @@ static void resolve_program_structs(TypeCheckContext *ctx, Scope *global_scope)
             continue; // Skip templates
         }
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         path.count = 0;
         if (check_struct_cycle(ctx, decl->type, &path)) {
-            TypeError err = { .kind = TE_INCOMPLETE_TYPE, .span = decl->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_INCOMPLETE_TYPE, .span = decl->span };
             err.as.name.name = "Recursive struct definition (infinite size)";
             dynarray_push_value(ctx->errors, &err);
+        } else {
+            type_struct_layout(decl->type);
         }
     }
     dynarray_free(&path);
@@ -662,11 +938,11 @@ static void resolve_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_ENUM_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         Type *enum_type = decl->type;
         if (!enum_type || enum_type->kind != TYPE_ENUM) continue;
 
@@ -675,8 +951,8 @@ static void resolve_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
         enum_type->as.enum_type.variant_count = count;
 
         if (count > 0) {
-            enum_type->as.enum_type.variants = arena_alloc(ctx->store->arena, sizeof(EnumVariant) * count);
-            enum_type->as.enum_type.variant_map = hashmap_create(ctx->store->arena, (count * 4) / 3 + 1);
+            enum_type->as.enum_type.variants = arena_alloc(ctx->arena, sizeof(EnumVariant) * count);
+            enum_type->as.enum_type.variant_map = hashmap_create(ctx->arena, (count * 4) / 3 + 1);
 
             int64_t current_val = 0;
             for (size_t v = 0; v < count; v++) {
@@ -691,7 +967,7 @@ static void resolve_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
                     if (variant_node->value->node_type == AST_LITERAL && variant_node->value->data.literal.type == INT_LITERAL) {
                         current_val = variant_node->value->data.literal.value.int_val;
                     } else {
-                        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = variant_node->value->span, .filename = ctx->filename };
+                        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = variant_node->value->span };
                         dynarray_push_value(ctx->errors, &err);
                     }
                 }
@@ -700,7 +976,7 @@ static void resolve_program_enums(TypeCheckContext *ctx, Scope *global_scope) {
 
                 // Check for duplicate variant
                 if (hashmap_get(enum_type->as.enum_type.variant_map, variant->name->key, str_hash, str_cmp)) {
-                    TypeError err = { .kind = TE_REDECLARATION, .span = decl->span, .filename = ctx->filename, .as.name.name = variant->name->key };
+                    TypeError err = { .kind = TE_REDECLARATION, .span = decl->span, .as.name.name = variant->name->key };
                     dynarray_push_value(ctx->errors, &err);
                 } else {
                     hashmap_put(enum_type->as.enum_type.variant_map, variant->name->key, variant, str_hash, str_cmp);
@@ -721,11 +997,11 @@ static void resolve_program_globals(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_VARIABLE_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstVariableDeclaration *var_decl = &decl->data.variable_declaration;
         
         Type *var_type = resolve_ast_type(ctx, global_scope, var_decl->type);
@@ -745,11 +1021,11 @@ static void resolve_program_functions(TypeCheckContext *ctx, Scope *global_scope
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_FUNCTION_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstFunctionDeclaration *func = &decl->data.function_declaration;
 
         // Skip methods, they are resolved separately
@@ -767,8 +1043,8 @@ static void resolve_program_functions(TypeCheckContext *ctx, Scope *global_scope
         if (top) {
             if (top->kind == SYMBOL_OVERLOAD_SET) {
                 // Find the candidate whose decl_node matches this AST node.
-                for (size_t j = 0; j < top->overloads->count; j++) {
-                    Symbol *c = *(Symbol**)dynarray_get(top->overloads, j);
+                DYNARRAY_FOREACH(Symbol*, c_it, top->overloads) {
+                    Symbol *c = *c_it;
                     if (c->decl_node == decl) { 
                         target = c; 
                         break; 
@@ -790,13 +1066,13 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl) continue;
 
         if (decl->node_type == AST_IMPL_DECLARATION) {
             AstImplDeclaration *impl = &decl->data.impl_declaration;
-            ctx->filename = decl->filename;
+            ctx->file = decl->span.file;
             
             Symbol *target_sym = NULL;
             AstNode *lookup_node = impl->target_type_node;
@@ -811,7 +1087,7 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
                             lookup_node = lookup_node->data.ast_type.u.base.path;
                             continue;
                         } else {
-                            target_sym = scope_lookup_symbol(global_scope, lookup_node->data.ast_type.u.base.intern_result, ctx->filename);
+                            target_sym = scope_lookup_symbol(global_scope, lookup_node->data.ast_type.u.base.intern_result, ctx->file);
                             break;
                         }
                     } else {
@@ -820,7 +1096,7 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
                 } else if (lookup_node->node_type == AST_GENERIC_INST_EXPR) {
                     lookup_node = lookup_node->data.generic_inst_expr.base;
                 } else if (lookup_node->node_type == AST_IDENTIFIER) {
-                    target_sym = scope_lookup_symbol(global_scope, lookup_node->data.identifier.intern_result, ctx->filename);
+                    target_sym = scope_lookup_symbol(global_scope, lookup_node->data.identifier.intern_result, ctx->file);
                     break;
                 } else if (lookup_node->node_type == AST_MEMBER_EXPR) {
                     target_sym = lookup_node->data.member_expr.symbol;
@@ -861,8 +1137,7 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
                     
                         TypeError err = { 
                             .kind = TE_GENERIC_ARG_MISMATCH, 
-                            .span = impl->target_type_node->span, 
-                            .filename = ctx->filename 
+                            .span = impl->target_type_node->span
                         };
                         err.as.generic_mismatch.name = target_name;
                         err.as.generic_mismatch.expected = expected_args;
@@ -876,13 +1151,15 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
                 if (target_sym && target_sym->decl_node && target_sym->decl_node->node_type == AST_STRUCT_DECLARATION) {
                     Type *base_type = target_sym->type;
                     if (base_type) {
-                        DynArray *impls = (DynArray*)hashmap_get(ctx->store->impl_registry, (void*)base_type, ptr_hash, ptr_cmp);
+                        sema_exclusive_begin(ctx); // The registry is shared by every unit
+                        DynArray *impls = (DynArray*)ptrmap_get(ctx->store->impl_registry, (void*)base_type);
                         if (!impls) {
-                            impls = arena_calloc(ctx->store->arena, sizeof(DynArray));
-                            dynarray_init_in_arena(impls, ctx->store->arena, sizeof(AstNode*), 4);
-                            hashmap_put(ctx->store->impl_registry, (void*)base_type, impls, ptr_hash, ptr_cmp);
+                            impls = arena_calloc(ctx->arena, sizeof(DynArray));
+                            dynarray_init_in_arena(impls, ctx->arena, sizeof(AstNode*), 4);
+                            ptrmap_put(ctx->store->impl_registry, (void*)base_type, impls);
                         }
                         dynarray_push_value(impls, &decl);
+                        sema_exclusive_end(ctx);
                     }
                 }
                 continue;
@@ -892,64 +1169,68 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
             if (!target_type || target_type->kind != TYPE_STRUCT) continue;
             
             if (impl->methods) {
-                for (size_t m = 0; m < impl->methods->count; m++) {
-                    AstNode *method_decl = *(AstNode**)dynarray_get(impl->methods, m);
+                DYNARRAY_FOREACH(AstNode*, method_decl_it, impl->methods) {
+                    AstNode *method_decl = *method_decl_it;
                     if (method_decl->node_type != AST_FUNCTION_DECLARATION) continue;
                     
                     AstFunctionDeclaration *func = &method_decl->data.function_declaration;
                     func->target_type_node = impl->target_type_node;
                     
                     if (func->type_params && func->type_params->count > 0) {
-                        Symbol *sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+                        Symbol *sym = arena_calloc(ctx->arena, sizeof(Symbol));
+                        MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
                         sym->name_rec = func->intern_result;
                         sym->type = NULL;
                         sym->kind = SYMBOL_GENERIC_FUNCTION;
                         sym->decl_node = method_decl;
                         sym->is_pub = func->is_pub;
-                        sym->filename = method_decl->filename;
-                        sym->overloads = arena_calloc(ctx->store->arena, sizeof(DynArray));
-            dynarray_init_in_arena(sym->overloads, ctx->store->arena, sizeof(Symbol*), 4);
+                        sym->file = method_decl->span.file;
+                        sym->overloads = arena_calloc(ctx->arena, sizeof(DynArray));
+            dynarray_init_in_arena(sym->overloads, ctx->arena, sizeof(Symbol*), 4);
 
-                        Symbol *existing_method = (Symbol*)hashmap_get(target_type->as.struct_type.methods, func->intern_result->key, ptr_hash, ptr_cmp);
+                        // The target may be an imported struct that other units extend too
+                        sema_exclusive_begin(ctx);
+                        Symbol *existing_method = (Symbol*)ptrmap_get(target_type->as.struct_type.methods, func->intern_result->key);
                         if (existing_method) {
                             if (existing_method->kind == SYMBOL_VALUE_FUNCTION || existing_method->kind == SYMBOL_GENERIC_FUNCTION) {
-                                Symbol *set = scope_make_overload_set(ctx->store->arena, existing_method, sym);
-                                hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, set, ptr_hash, ptr_cmp);
+                                Symbol *set = scope_make_overload_set(ctx->arena, existing_method, sym);
+                                ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, set);
                             } else if (existing_method->kind == SYMBOL_OVERLOAD_SET) {
-                                scope_overload_set_add(existing_method, sym, ctx->store->arena);
+                                scope_overload_set_add(existing_method, sym, ctx->arena);
                             }
                         } else {
-                            hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym, ptr_hash, ptr_cmp);
+                            ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym);
                         }
+                        sema_exclusive_end(ctx);
                         
-                        CompilationUnit *unit = module_loader_get_unit(ctx->loader, decl->filename);
-                        if (unit && unit->generic_templates) {
-                            hashmap_put(unit->generic_templates, func->intern_result->key, method_decl, ptr_hash, ptr_cmp);
-                        }
+                        register_generic_template(ctx, decl->span.file, func->intern_result, method_decl);
                         continue;
                     }
 
                     resolve_function_decl(ctx, global_scope, method_decl);
                     
-                    Symbol *sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+                    Symbol *sym = arena_calloc(ctx->arena, sizeof(Symbol));
+                    MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
                     sym->name_rec = func->intern_result;
                     sym->type = method_decl->type;
                     sym->kind = SYMBOL_VALUE_FUNCTION;
                     sym->decl_node = method_decl;
                     sym->is_pub = func->is_pub;
-                    sym->filename = method_decl->filename;
+                    sym->file = method_decl->span.file;
                     
-                    Symbol *existing_method = (Symbol*)hashmap_get(target_type->as.struct_type.methods, func->intern_result->key, ptr_hash, ptr_cmp);
+                    sema_exclusive_begin(ctx);
+                    Symbol *existing_method = (Symbol*)ptrmap_get(target_type->as.struct_type.methods, func->intern_result->key);
                     if (existing_method) {
                         if (existing_method->kind == SYMBOL_VALUE_FUNCTION || existing_method->kind == SYMBOL_GENERIC_FUNCTION) {
-                            Symbol *set = scope_make_overload_set(ctx->store->arena, existing_method, sym);
-                            hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, set, ptr_hash, ptr_cmp);
+                            Symbol *set = scope_make_overload_set(ctx->arena, existing_method, sym);
+                            ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, set);
                         } else if (existing_method->kind == SYMBOL_OVERLOAD_SET) {
-                            scope_overload_set_add(existing_method, sym, ctx->store->arena);
+                            scope_overload_set_add(existing_method, sym, ctx->arena);
                         }
                     } else {
-                        hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym, ptr_hash, ptr_cmp);
+                        ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym);
                     }
+                    sema_exclusive_end(ctx);
                 }
             }
             continue;
@@ -961,12 +1242,12 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
 
         if (!func->target_type_node) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
 
         // Skip methods on generic template structs
         Symbol *target_sym = NULL;
         if (func->target_type_node->node_type == AST_IDENTIFIER) {
-            target_sym = scope_lookup_symbol(global_scope, func->target_type_node->data.identifier.intern_result, ctx->filename);
+            target_sym = scope_lookup_symbol(global_scope, func->target_type_node->data.identifier.intern_result, ctx->file);
         }
         if (target_sym && target_sym->kind == SYMBOL_GENERIC_STRUCT) {
             continue;
@@ -975,39 +1256,39 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
         // 1. Resolve target struct type
         Type *target_type = resolve_ast_type(ctx, global_scope, func->target_type_node);
         if (!target_type || target_type->kind != TYPE_STRUCT) {
-            TypeError err = { .kind = TE_UNDECLARED, .span = func->target_type_node->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_UNDECLARED, .span = func->target_type_node->span };
             err.as.name.name = "Method must be bound to a struct type";
             dynarray_push_value(ctx->errors, &err);
             continue;
         }
 
         if (func->type_params && func->type_params->count > 0) {
-            Symbol *sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+            Symbol *sym = arena_calloc(ctx->arena, sizeof(Symbol));
+            MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
             sym->name_rec = func->intern_result;
             sym->type = NULL;
             sym->kind = SYMBOL_GENERIC_FUNCTION;
             sym->decl_node = decl;
             sym->is_pub = func->is_pub;
-            sym->filename = decl->filename;
-            sym->overloads = arena_calloc(ctx->store->arena, sizeof(DynArray));
-            dynarray_init_in_arena(sym->overloads, ctx->store->arena, sizeof(Symbol*), 4);
+            sym->file = decl->span.file;
+            sym->overloads = arena_calloc(ctx->arena, sizeof(DynArray));
+            dynarray_init_in_arena(sym->overloads, ctx->arena, sizeof(Symbol*), 4);
 
-            Symbol *existing_method = (Symbol*)hashmap_get(target_type->as.struct_type.methods, func->intern_result->key, ptr_hash, ptr_cmp);
+            sema_exclusive_begin(ctx);
+            Symbol *existing_method = (Symbol*)ptrmap_get(target_type->as.struct_type.methods, func->intern_result->key);
             if (existing_method) {
                 if (existing_method->kind == SYMBOL_VALUE_FUNCTION || existing_method->kind == SYMBOL_GENERIC_FUNCTION) {
-                    Symbol *set = scope_make_overload_set(ctx->store->arena, existing_method, sym);
-                    hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, set, ptr_hash, ptr_cmp);
+                    Symbol *set = scope_make_overload_set(ctx->arena, existing_method, sym);
+                    ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, set);
                 } else if (existing_method->kind == SYMBOL_OVERLOAD_SET) {
-                    scope_overload_set_add(existing_method, sym, ctx->store->arena);
+                    scope_overload_set_add(existing_method, sym, ctx->arena);
                 }
             } else {
-                hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym, ptr_hash, ptr_cmp);
-            }
-            
-            CompilationUnit *unit = module_loader_get_unit(ctx->loader, decl->filename);
-            if (unit && unit->generic_templates) {
-                hashmap_put(unit->generic_templates, func->intern_result->key, decl, ptr_hash, ptr_cmp);
+                ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym);
             }
+            sema_exclusive_end(ctx);
+
+            register_generic_template(ctx, decl->span.file, func->intern_result, decl);
             continue;
         }
 
@@ -1015,29 +1296,32 @@ static void resolve_program_methods(TypeCheckContext *ctx, Scope *global_scope)
         resolve_function_decl(ctx, global_scope, decl);
 
         // 3. Register in struct's method map
-        Symbol *sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+        Symbol *sym = arena_calloc(ctx->arena, sizeof(Symbol));
+        MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
         sym->name_rec = func->intern_result;
         sym->type = decl->type;
         sym->kind = SYMBOL_VALUE_FUNCTION;
         sym->decl_node = decl;
         sym->is_pub = func->is_pub;
-        sym->filename = decl->filename;
+        sym->file = decl->span.file;
 
-        Symbol *existing_method = (Symbol*)hashmap_get(target_type->as.struct_type.methods, func->intern_result->key, ptr_hash, ptr_cmp);
+        sema_exclusive_begin(ctx);
+        Symbol *existing_method = (Symbol*)ptrmap_get(target_type->as.struct_type.methods, func->intern_result->key);
         if (existing_method) {
             if (existing_method->kind == SYMBOL_VALUE_FUNCTION) {
-                Symbol *set = scope_make_overload_set(ctx->store->arena, existing_method, sym);
-                hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, set, ptr_hash, ptr_cmp);
+                Symbol *set = scope_make_overload_set(ctx->arena, existing_method, sym);
+                ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, set);
             } else if (existing_method->kind == SYMBOL_OVERLOAD_SET) {
-                if (!scope_overload_set_add(existing_method, sym, ctx->store->arena)) {
-                    TypeError err = { .kind = TE_REDECLARATION, .span = decl->span, .filename = ctx->filename };
+                if (!scope_overload_set_add(existing_method, sym, ctx->arena)) {
+                    TypeError err = { .kind = TE_REDECLARATION, .span = decl->span };
                     err.as.name.name = ((Slice*)func->intern_result->key)->ptr;
                     dynarray_push_value(ctx->errors, &err);
                 }
             }
         } else {
-            hashmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym, ptr_hash, ptr_cmp);
+            ptrmap_put(target_type->as.struct_type.methods, func->intern_result->key, sym);
         }
+        sema_exclusive_end(ctx);
     }
 }
 
@@ -1046,11 +1330,11 @@ static void resolve_program_aliases(TypeCheckContext *ctx, Scope *global_scope)
     AstProgram *program = &ctx->program->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (!decl || decl->node_type != AST_ALIAS_DECLARATION) continue;
 
-        ctx->filename = decl->filename;
+        ctx->file = decl->span.file;
         AstAliasDeclaration *alias = &decl->data.alias_declaration;
 
         Symbol *my_alias_sym = scope_lookup_symbol_local(global_scope, alias->alias_name);
@@ -1058,9 +1342,9 @@ static void resolve_program_aliases(TypeCheckContext *ctx, Scope *global_scope)
 
         Symbol *target_sym = NULL;
         if (alias->target->node_type == AST_IDENTIFIER) {
-            target_sym = scope_lookup_symbol(global_scope, alias->target->data.identifier.intern_result, ctx->filename);
+            target_sym = scope_lookup_symbol(global_scope, alias->target->data.identifier.intern_result, ctx->file);
             if (!target_sym) {
-                Type *prim = (Type*)hashmap_get(ctx->store->primitive_registry, alias->target->data.identifier.intern_result->key, ptr_hash, ptr_cmp);
+                Type *prim = (Type*)ptrmap_get(ctx->store->primitive_registry, alias->target->data.identifier.intern_result->key);
                 if (prim) {
                     my_alias_sym->type = prim;
                     continue;
@@ -1087,13 +1371,13 @@ static void resolve_program_aliases(TypeCheckContext *ctx, Scope *global_scope)
                 my_alias_sym->type = inst_type;
                 my_alias_sym->target_symbol = NULL; 
             } else {
-                TypeError err = { .kind = TE_UNDECLARED, .span = alias->target->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_UNDECLARED, .span = alias->target->span };
                 err.as.name.name = "Could not resolve alias target type";
                 dynarray_push_value(ctx->errors, &err);
             }
             continue;
         } else {
-             TypeError err = { .kind = TE_TYPE_MISMATCH, .span = alias->target->span, .filename = ctx->filename };
+             TypeError err = { .kind = TE_TYPE_MISMATCH, .span = alias->target->span };
              err.as.name.name = "Alias target must be a symbol, path, or generic instantiation";
              dynarray_push_value(ctx->errors, &err);
              continue;
@@ -1139,14 +1423,14 @@ static bool is_type_complete(Type *t) {
     return true; 
 }
 
-void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *var_node) {
+static void check_variable_declaration_in(TypeCheckContext *ctx, Scope *scope, AstNode *var_node) {
     if (var_node->node_type != AST_VARIABLE_DECLARATION) return;
     
     // Skip if already checked in this pass (duplicate prevention during recursive resolutions)
     if (var_node->last_checked_pass == ctx->current_pass) return;
 
-    const char *old_filename = ctx->filename;
-    ctx->filename = var_node->filename;
+    SourceId old_file = ctx->file;
+    ctx->file = var_node->span.file;
 
     AstVariableDeclaration *var_decl = &var_node->data.variable_declaration;
 
@@ -1158,15 +1442,15 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     // If already initialized (from redundant pass call or demand-driven), skip
     if (is_us && (existing->flags & SYMBOL_FLAG_INITIALIZED)) {
         var_node->last_checked_pass = ctx->current_pass;
-        ctx->filename = old_filename;
+        ctx->file = old_file;
         return; 
     }
     
     // Cycle detection for constants
     if (is_us && (existing->flags & SYMBOL_FLAG_COMPUTING)) {
-        TypeError err = { .kind = TE_RECURSIVE_CONST, .span = var_node->span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_RECURSIVE_CONST, .span = var_node->span };
         dynarray_push_value(ctx->errors, &err);
-        ctx->filename = old_filename;
+        ctx->file = old_file;
         return;
     }
 
@@ -1174,7 +1458,7 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     Type *var_type = my_sym ? my_sym->type : resolve_ast_type(ctx, scope, var_decl->type);
 
     if (!var_type) {
-        ctx->filename = old_filename;
+        ctx->file = old_file;
         return;
     }
 
@@ -1182,11 +1466,10 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     if (type_is_void(var_type)) {
         TypeError err = { 
             .kind = TE_VOID_VARIABLE, 
-            .span = var_node->span, 
-            .filename = ctx->filename
+            .span = var_node->span
         };
         dynarray_push_value(ctx->errors, &err);
-        ctx->filename = old_filename;
+        ctx->file = old_file;
         return;
     }
 
@@ -1195,8 +1478,7 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
         if (!is_type_complete(var_type)) {
             TypeError err = { 
                 .kind = TE_INCOMPLETE_TYPE, 
-                .span = var_node->span, 
-                .filename = ctx->filename,
+                .span = var_node->span,
                 .as.name.name = "Variable declared with incomplete type (missing array size)" 
             };
             dynarray_push_value(ctx->errors, &err);
@@ -1210,7 +1492,7 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     if (is_global) {
         // Global: Symbol MUST be defined before checking initializer to allow recursion
         if (!my_sym) {
-            define_symbol_or_error(ctx, scope, var_decl->intern_result, var_type, SYMBOL_VARIABLE, var_node->span, var_decl->is_pub, var_node->filename, var_node);
+            define_symbol_or_error(ctx, scope, var_decl->intern_result, var_type, SYMBOL_VARIABLE, var_node->span, var_decl->is_pub, var_node->span.file, var_node);
             my_sym = scope_lookup_symbol_local(scope, var_decl->intern_result);
             if (my_sym && my_sym->decl_node != var_node) my_sym = NULL;
         }
@@ -1226,7 +1508,8 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     } else {
         // Local: Check initializer FIRST to catch self-initialization (x = x) as TE_UNDECLARED
         check_initializer(ctx, scope, var_node, var_decl->initializer, var_type, NULL);
-        define_symbol_or_error(ctx, scope, var_decl->intern_result, var_type, SYMBOL_VARIABLE, var_node->span, var_decl->is_pub, var_node->filename, var_node);
+        // var_node->type: a T[] initialized by a list was upgraded to T[N]
+        define_symbol_or_error(ctx, scope, var_decl->intern_result, var_node->type, SYMBOL_VARIABLE, var_node->span, var_decl->is_pub, var_node->span.file, var_node);
         my_sym = scope_lookup_symbol_local(scope, var_decl->intern_result);
         if (my_sym && my_sym->decl_node != var_node) my_sym = NULL;
         if (my_sym) my_sym->flags |= SYMBOL_FLAG_INITIALIZED;
@@ -1250,21 +1533,120 @@ void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *va
     }
     
     var_node->last_checked_pass = ctx->current_pass;
-    ctx->filename = old_filename;
+    ctx->file = old_file;
+}
+
+/* for (x in range): x is a local of the element type, assigned before every iteration. */
+static void check_range_for(TypeCheckContext *ctx, Scope *scope, AstForStatement *fs) {
+    Type *range_type = check_expression(ctx, scope, fs->range, NULL);
+    if (!range_type) return;
+    if (range_type->kind != TYPE_ARRAY && range_type->kind != TYPE_SLICE) {
+        TypeError err = { .kind = TE_NOT_ITERABLE, .span = fs->range->span, .as.bad_usage.actual = range_type };
+        dynarray_push_value(ctx->errors, &err);
+        return;
+    }
+
+    AstNode *var_node = fs->init;
+    InternResult *name = var_node->data.variable_declaration.intern_result;
+    Type *elem = range_type->kind == TYPE_ARRAY ? range_type->as.array.base : range_type->as.slice.base;
+    var_node->type = elem;
+    define_symbol_or_error(ctx, scope, name, elem, SYMBOL_VARIABLE, var_node->span, 0, var_node->span.file, var_node);
+    Symbol *sym = scope_lookup_symbol_local(scope, name);
+    if (sym && sym->decl_node == var_node) sym->flags |= SYMBOL_FLAG_INITIALIZED;
+}
+
+/* The integer a checked case value folded to; false if it is not a constant. */
+static bool case_value(AstNode *value, int64_t *out) {
+    if (!value->is_foldable_const) return false;
+    switch (value->const_value.type) {
+        case INT_LITERAL:  *out = value->const_value.value.int_val; return true;
+        case CHAR_LITERAL: *out = (int64_t)value->const_value.value.char_val; return true;
+        default:           return false;
+    }
+}
+
+static bool values_contain(DynArray *seen, int64_t v) {
+    DYNARRAY_FOREACH(int64_t, it, seen) if (*it == v) return true;
+    return false;
+}
+
+/* switch over an integer, char or enum: every case value a distinct constant of the subject's type,
+ * and an enum switch without `else` names every variant. */
+static void check_switch(TypeCheckContext *ctx, Scope *scope, AstNode *stmt, Type *return_type) {
+    AstSwitchStatement *sw = &stmt->data.switch_statement;
+    Type *subject = check_expression(ctx, scope, sw->subject, NULL);
+    bool switchable = subject && (type_is_integer(subject) || type_is_char(subject) || subject->kind == TYPE_ENUM);
+    if (subject && !switchable) {
+        TypeError err = { .kind = TE_NOT_SWITCHABLE, .span = sw->subject->span, .as.bad_usage.actual = subject };
+        dynarray_push_value(ctx->errors, &err);
+    }
+
+    DynArray seen;
+    dynarray_init(&seen, sizeof(int64_t));
+    bool all_known = switchable;
+    DYNARRAY_FOREACH(AstNode*, arm_it, sw->cases) {
+        AstSwitchCase *arm = &(*arm_it)->data.switch_case;
+        DYNARRAY_FOREACH(AstNode*, value_it, arm->values) {
+            AstNode *value = *value_it;
+            Type *vt = check_expression(ctx, scope, value, switchable ? subject : NULL);
+            if (!vt || !switchable) { all_known = false; continue; }
+            if (vt != subject && !coerce_or_error(ctx, value, subject)) { all_known = false; continue; }
+            int64_t v;
+            if (!case_value(value, &v)) {
+                TypeError err = { .kind = TE_NOT_CONST, .span = value->span };
+                dynarray_push_value(ctx->errors, &err);
+                all_known = false;
+                continue;
+            }
+            if (values_contain(&seen, v)) {
+                TypeError err = { .kind = TE_DUPLICATE_CASE, .span = value->span };
+                dynarray_push_value(ctx->errors, &err);
+                continue;
+            }
+            dynarray_push_value(&seen, &v);
+        }
+        check_statement(ctx, scope, arm->body, return_type);
+    }
+    if (sw->else_body) check_statement(ctx, scope, sw->else_body, return_type);
+
+    // Only reported when every case value was understood, so one bad value gives one error
+    if (all_known && !sw->else_body && subject->kind == TYPE_ENUM) {
+        for (size_t i = 0; i < subject->as.enum_type.variant_count; i++) {
+            EnumVariant *variant = &subject->as.enum_type.variants[i];
+            if (values_contain(&seen, variant->value)) continue;
+            TypeError err = { .kind = TE_NONEXHAUSTIVE_SWITCH, .span = stmt->span };
+            err.as.field.name = variant->name ? ((Slice*)variant->name->key)->ptr : "<unknown>";
+            err.as.field.type = subject;
+            dynarray_push_value(ctx->errors, &err);
+            break;
+        }
+    }
+    dynarray_free(&seen);
+}
+
+void check_variable_declaration(TypeCheckContext *ctx, Scope *scope, AstNode *var_node) {
+    // Globals are shared between workers; locals belong to the body being checked
+    bool global = !scope->locals;
+    if (global) sema_exclusive_begin(ctx);
+    check_variable_declaration_in(ctx, scope, var_node);
+    if (global) sema_exclusive_end(ctx);
 }
 
 static void check_block(TypeCheckContext *ctx, Scope *parent, AstNode *block_node, Type *return_type, bool create_new_scope) {
     if (block_node->node_type != AST_BLOCK) return;
     Scope *scope = parent;
-    if (create_new_scope) scope = scope_create(ctx->store->arena, parent, 16, SCOPE_IDENTIFIERS);
+    if (create_new_scope) scope = scope_create_local(ctx->locals, parent);
 
+    size_t live_defers = ctx->live_defers; // Defers of this block run when it exits
     AstBlock *b = &block_node->data.block;
-    if (!b->statements) return;
-
-    for (size_t i = 0; i < b->statements->count; i++) {
-        AstNode *stmt = FAST_GET(b->statements, i);
-        check_statement(ctx, scope, stmt, return_type);
+    if (b->statements) {
+        DYNARRAY_FOREACH(AstNode*, stmt_it, b->statements) {
+            AstNode *stmt = *stmt_it;
+            check_statement(ctx, scope, stmt, return_type);
+        }
     }
+    ctx->live_defers = live_defers;
+    if (create_new_scope) scope_exit(scope);
 }
 
 static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt, Type *return_type) {
@@ -1274,6 +1656,10 @@ static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt,
         case AST_RETURN_STATEMENT: {
             AstReturnStatement *ret = &stmt->data.return_statement;
             Type *actual = ctx->store->t_void;
+            if (ret->expression && ret->expression->node_type == AST_INTRINSIC && ret->expression->data.intrinsic.kind == INTRINSIC_TAIL) {
+                check_tail_call(ctx, scope, ret->expression, return_type);
+                break; // Same signature as the caller, so nothing to coerce
+            }
             if (ret->expression) actual = check_expression(ctx, scope, ret->expression, return_type);
             
             if (actual && return_type && actual != return_type) {
@@ -1283,6 +1669,7 @@ static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt,
         }
         case AST_DEFER_STATEMENT: {
             check_statement(ctx, scope, stmt->data.defer_statement.body, return_type);
+            ctx->live_defers++;
             break;
         }
         case AST_BLOCK: 
@@ -1307,17 +1694,22 @@ static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt,
         case AST_FOR_STATEMENT: {
             AstForStatement *fs = &stmt->data.for_statement;
             // 1. Create a scope for the loop
-            Scope *for_scope = scope_create(ctx->store->arena, scope, 8, SCOPE_IDENTIFIERS);
+            Scope *for_scope = scope_create_local(ctx->locals, scope);
                 
             // 2. Check the parts
-            if (fs->init) check_statement(ctx, for_scope, fs->init, return_type);
+            if (fs->range) check_range_for(ctx, for_scope, fs);
+            else if (fs->init) check_statement(ctx, for_scope, fs->init, return_type);
             if (fs->condition) check_expression(ctx, for_scope, fs->condition, ctx->store->t_bool);
             if (fs->post) check_expression(ctx, for_scope, fs->post, NULL);
                 
             // 3. Check the body
             check_statement(ctx, for_scope, fs->body, return_type);
+            scope_exit(for_scope);
             break;
         }
+        case AST_SWITCH_STATEMENT:
+            check_switch(ctx, scope, stmt, return_type);
+            break;
 
         case AST_EXPR_STATEMENT: 
             check_expression(ctx, scope, stmt->data.expr_statement.expression, NULL); 
@@ -1333,47 +1725,125 @@ static void check_statement(TypeCheckContext *ctx, Scope *scope, AstNode *stmt,
     }
 }
 
-static void check_function(TypeCheckContext *ctx, Scope *parent_scope, AstNode *func_node) {
-    const char *old_filename = ctx->filename;
-    ctx->filename = func_node->filename;
-
+/*
+ * The function's body, parsed now if the parser skimmed it. An instance
+ * with a template body (held unpatched by check_function) gets the tree
+ * parsed once for every instance of its template.
+ */
+static AstNode *function_body(TypeCheckContext *ctx, AstNode *func_node) {
     AstFunctionDeclaration *decl = &func_node->data.function_declaration;
-
-    // Skip if this is a template (has type params or is a method on a generic struct template)
-    if (decl->type_params && decl->type_params->count > 0) {
-        ctx->filename = old_filename;
-        return;
+    if (!decl->template_body && (decl->body || !decl->lazy_body)) return decl->body;
+
+    const char *msg = NULL;
+    Span span = func_node->span;
+    decl->body = decl->template_body ? template_body_parse(decl->template_body, func_node, &msg, &span)
+                                     : parse_deferred_body(func_node, ctx->arena, &msg, &span);
+    if (!decl->body) {
+        decl->lazy_body = NULL; // Reported once
+        TypeError err = { .kind = TE_SYNTAX, .span = span };
+        err.as.name.name = msg;
+        dynarray_push_value(ctx->errors, &err);
     }
-    if (decl->target_type_node) {
-        Symbol *target_sym = NULL;
-        if (decl->target_type_node->node_type == AST_IDENTIFIER) {
-            target_sym = scope_lookup_symbol(parent_scope, decl->target_type_node->data.identifier.intern_result, func_node->filename);
-        }
-        if (target_sym && target_sym->kind == SYMBOL_GENERIC_STRUCT) {
-            ctx->filename = old_filename;
-            return;
-        }
+    return decl->body;
+}
+
+/* Templates (type params, or a method of a generic struct) are only checked per instance. */
+static bool is_function_template(Scope *parent_scope, AstNode *func_node) {
+    AstFunctionDeclaration *decl = &func_node->data.function_declaration;
+    if (decl->type_params && decl->type_params->count > 0) return true;
+    if (decl->target_type_node && decl->target_type_node->node_type == AST_IDENTIFIER) {
+        Symbol *target_sym = scope_lookup_symbol(parent_scope, decl->target_type_node->data.identifier.intern_result, func_node->span.file);
+        if (target_sym && target_sym->kind == SYMBOL_GENERIC_STRUCT) return true;
     }
+    return false;
+}
+
+static void check_function(TypeCheckContext *ctx, Scope *parent_scope, AstNode *func_node) {
+    if ((func_node->flags & (AST_FLAG_PRUNED | AST_FLAG_REUSED)) || is_function_template(parent_scope, func_node)) return;
 
     Type *func_type = func_node->type;
     if (!func_type) return;
 
-    Scope *fn_scope = scope_create(ctx->store->arena, parent_scope, 32, SCOPE_IDENTIFIERS);
+    SourceId old_file = ctx->file;
+    ctx->file = func_node->span.file;
+    SourceId old_mem_source = mem_report_set_source(ctx->file);
+    AstFunctionDeclaration *decl = &func_node->data.function_declaration;
+
+    Slice *fn_name = decl->intern_result ? (Slice*)decl->intern_result->key : NULL;
+    if (fn_name) trace_begin_n("sema", fn_name->ptr, fn_name->len);
+    else trace_begin("sema", "<function>");
+
+    Scope *fn_scope = scope_create_local(ctx->locals, parent_scope);
     if (decl->params) {
-        for (size_t i = 0; i < decl->params->count; i++) {
-            AstNode *param = *(AstNode**)dynarray_get(decl->params, i);
+        DYNARRAY_FOREACH(AstNode*, param_it, decl->params) {
+            AstNode *param = *param_it;
             if (param->data.param.name_idx != -1) {
                 InternResult *name_rec = interner_get_result(ctx->identifiers, param->data.param.name_idx);
-                define_symbol_or_error(ctx, fn_scope, name_rec, param->type, SYMBOL_VARIABLE, param->span, false, param->filename, param);
+                define_symbol_or_error(ctx, fn_scope, name_rec, param->type, SYMBOL_VARIABLE, param->span, false, param->span.file, param);
             }
         }
     }
-    if (decl->body) {
-        check_block(ctx, fn_scope, decl->body, func_type->as.func.return_type, false);
+    // An instance is checked in its template's shared body; what that wrote becomes its patch
+    TemplateBody *shared = decl->template_body;
+    if (shared && !template_body_bind(shared, NULL)) {
+        // Instantiated from inside another instance of the same template: parse one of its own
+        decl->template_body = NULL;
+        decl->body = NULL;
+        shared = NULL;
+    }
+    AstNode *body = function_body(ctx, func_node);
+    size_t instance_uses = ctx->instance_uses;
+    // Instantiation checks other bodies from inside this one
+    AstNode *outer_function = ctx->current_function;
+    size_t outer_defers = ctx->live_defers;
+    ctx->current_function = func_node;
+    ctx->live_defers = 0;
+    if (body) {
+        check_block(ctx, fn_scope, body, func_type->as.func.return_type, false);
+    }
+    ctx->current_function = outer_function;
+    ctx->live_defers = outer_defers;
+    if (ctx->instance_uses != instance_uses) func_node->flags |= AST_FLAG_USES_INSTANCES;
+    scope_exit(fn_scope);
+    if (shared) {
+        if (body) decl->body_patch = template_body_capture(shared, ctx->arena);
+        template_body_unbind(shared);
     }
 
     func_node->last_checked_pass = ctx->current_pass;
-    ctx->filename = old_filename;
+    trace_end();
+    mem_report_set_source(old_mem_source);
+    ctx->file = old_file;
+}
+
+/* The unit an import names, or NULL when no loaded module has that path. */
+static CompilationUnit *import_target(TypeCheckContext *ctx, AstImportDeclaration *import) {
+    // Use the resolved logical path from the loading phase
+    const char *logical_path_str = import->resolved_logical_path;
+    if (!logical_path_str) {
+         // Fallback to rebuilding from module_path if needed
+         size_t total_len = 0;
+         for (size_t j = 0; j < import->module_path->count; j++) {
+            InternResult *part = DYNARRAY_AT(InternResult*, import->module_path, j);
+            Slice *s = (Slice*)part->key;
+            total_len += s->len + (j > 0 ? 1 : 0);
+         }
+
+         char *rebuilt = arena_alloc(ctx->arena, total_len + 1);
+         size_t r_len = 0;
+         for (size_t j = 0; j < import->module_path->count; j++) {
+            InternResult *part = DYNARRAY_AT(InternResult*, import->module_path, j);
+            Slice *s = (Slice*)part->key;
+            if (j > 0) rebuilt[r_len++] = '.';
+            memcpy(rebuilt + r_len, s->ptr, s->len);
+            r_len += s->len;
+         }
+         rebuilt[r_len] = '\0';
+         logical_path_str = rebuilt;
+    }
+
+    // Find the unit by logical path
+    return (CompilationUnit*)hashmap_get(ctx->loader->units_by_logical_path, (void*)logical_path_str, str_hash, str_cmp);
 }
 
 static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
@@ -1381,51 +1851,28 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
     AstProgram *program = &unit->ast_root->data.program;
     if (!program->decls) return;
 
-    for (size_t i = 0; i < program->decls->count; i++) {
-        AstNode *decl = *(AstNode**)dynarray_get(program->decls, i);
+    DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+        AstNode *decl = *decl_it;
         if (decl->node_type != AST_IMPORT_DECLARATION) continue;
 
         AstImportDeclaration *import = &decl->data.import_declaration;
-
-        // Use the resolved logical path from the loading phase
-        const char *logical_path_str = import->resolved_logical_path;
-        if (!logical_path_str) {
-             // Fallback to rebuilding from module_path if needed
-             size_t total_len = 0;
-             for (size_t j = 0; j < import->module_path->count; j++) {
-                InternResult *part = *(InternResult**)dynarray_get(import->module_path, j);
-                Slice *s = (Slice*)part->key;
-                total_len += s->len + (j > 0 ? 1 : 0);
-             }
-
-             char *rebuilt = arena_alloc(ctx->store->arena, total_len + 1);
-             size_t r_len = 0;
-             for (size_t j = 0; j < import->module_path->count; j++) {
-                InternResult *part = *(InternResult**)dynarray_get(import->module_path, j);
-                Slice *s = (Slice*)part->key;
-                if (j > 0) rebuilt[r_len++] = '.';
-                memcpy(rebuilt + r_len, s->ptr, s->len);
-                r_len += s->len;
-             }
-             rebuilt[r_len] = '\0';
-             logical_path_str = rebuilt;
-        }
-
-        // Find the unit by logical path
-        CompilationUnit *target = (CompilationUnit*)hashmap_get(ctx->loader->units_by_logical_path, (void*)logical_path_str, str_hash, str_cmp);
+        CompilationUnit *target = import_target(ctx, import);
 
         if (!target) {
-            TypeError err = { .kind = TE_UNDECLARED, .span = decl->span, .filename = unit->absolute_path };
+            TypeError err = { .kind = TE_UNDECLARED, .span = decl->span };
             err.as.name.name = "Module not found";
             dynarray_push_value(ctx->errors, &err);
             continue;
         }
 
         // 1. Nested Module Binding (Full Path Access)
-        // Bind components like 'std' -> 'libc' in the scope hierarchy
+        // Bind components like 'std' -> 'libc' in the scope hierarchy.
+        // Past the first component that can be another module's scope.
+        bool nested = import->module_path->count > 1;
+        if (nested) sema_exclusive_begin(ctx);
         Scope *current_bind_scope = unit->global_scope;
         for (size_t j = 0; j < import->module_path->count; j++) {
-            InternResult *part = *(InternResult**)dynarray_get(import->module_path, j);
+            InternResult *part = DYNARRAY_AT(InternResult*, import->module_path, j);
             
             // Is this the final part?
             bool is_last = (j == import->module_path->count - 1);
@@ -1433,7 +1880,7 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
             if (is_last) {
                 // Bind the actual target module. 
                 // It's private in the importing module's scope, but 'pub' relative to its parent dummy module.
-                Symbol *mod_sym = scope_define_symbol(current_bind_scope, part, NULL, SYMBOL_VALUE_MODULE, target->absolute_path, true, NULL);
+                Symbol *mod_sym = scope_define_symbol(current_bind_scope, part, NULL, SYMBOL_VALUE_MODULE, target->file, true, NULL);
                 if (mod_sym) {
                     mod_sym->module_scope = target->global_scope;
                     // Note: the very first component (e.g. 'std') bound to unit->global_scope 
@@ -1447,7 +1894,7 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
                 Symbol *existing = scope_lookup_symbol_local(current_bind_scope, part);
                 if (existing) {
                     if (existing->kind != SYMBOL_VALUE_MODULE && existing->kind != SYMBOL_VALUE_NAMESPACE) {
-                         TypeError err = { .kind = TE_REDECLARATION, .span = decl->span, .filename = unit->absolute_path };
+                         TypeError err = { .kind = TE_REDECLARATION, .span = decl->span };
                          err.as.name.name = "Import path component conflicts with existing symbol";
                          dynarray_push_value(ctx->errors, &err);
                          break;
@@ -1456,8 +1903,8 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
                 } else {
                     // Create a namespace symbol for the namespace. 
                     // This namespace is 'pub' so we can traverse it.
-                    Symbol *ns_sym = scope_define_symbol(current_bind_scope, part, NULL, SYMBOL_VALUE_NAMESPACE, NULL, true, NULL);
-                    ns_sym->module_scope = scope_create(ctx->store->arena, NULL, 16, SCOPE_IDENTIFIERS);
+                    Symbol *ns_sym = scope_define_symbol(current_bind_scope, part, NULL, SYMBOL_VALUE_NAMESPACE, SOURCE_NONE, true, NULL);
+                    ns_sym->module_scope = scope_create(ctx->arena, NULL, 16, SCOPE_IDENTIFIERS);
                     
                     // But if it's in the root global scope, it should be private by default.
                     if (current_bind_scope == unit->global_scope) {
@@ -1468,11 +1915,12 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
                 }
             }
         }
+        if (nested) sema_exclusive_end(ctx);
 
         // 2. Handle specific symbols: import math { sin };
         if (import->specific_symbols) {
-            for (size_t j = 0; j < import->specific_symbols->count; j++) {
-                ImportSymbol *sym_imp = *(ImportSymbol**)dynarray_get(import->specific_symbols, j);
+            DYNARRAY_FOREACH(ImportSymbol*, sym_imp_it, import->specific_symbols) {
+                ImportSymbol *sym_imp = *sym_imp_it;
                 Symbol *target_sym = scope_lookup_symbol_local(target->global_scope, sym_imp->original_name);
 
                 if (!target_sym || !target_sym->is_pub) {
@@ -1480,7 +1928,7 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
                     if (sym_imp->original_name && sym_imp->original_name->key) {
                         missing_name = ((Slice*)sym_imp->original_name->key)->ptr;
                     }
-                    TypeError err = { .kind = TE_UNDECLARED, .span = decl->span, .filename = unit->absolute_path };
+                    TypeError err = { .kind = TE_UNDECLARED, .span = decl->span };
                     err.as.name.name = missing_name;
                     dynarray_push_value(ctx->errors, &err);
                     continue;
@@ -1488,19 +1936,19 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
 
                 // Register in local scope
                 InternResult *local_name = sym_imp->alias_name ? sym_imp->alias_name : sym_imp->original_name;
-                scope_define_symbol(unit->global_scope, local_name, target_sym->type, target_sym->kind, target->absolute_path, import->is_pub, target_sym->decl_node);
+                scope_define_symbol(unit->global_scope, local_name, target_sym->type, target_sym->kind, target->file, import->is_pub, target_sym->decl_node);
             }
         } else if (import->is_star) {
             // "import *": Bring everything into local scope
             for (size_t j = 0; j < target->global_scope->symbols_list.count; j++) {
-                Symbol *sym = *(Symbol**)dynarray_get(&target->global_scope->symbols_list, j);
+                Symbol *sym = DYNARRAY_AT(Symbol*, &target->global_scope->symbols_list, j);
                 if (sym && sym->is_pub && sym->kind != SYMBOL_VALUE_MODULE) {
-                     scope_define_symbol(unit->global_scope, sym->name_rec, sym->type, sym->kind, target->absolute_path, import->is_pub, sym->decl_node);
+                     scope_define_symbol(unit->global_scope, sym->name_rec, sym->type, sym->kind, target->file, import->is_pub, sym->decl_node);
                 }
             }
         } else if (import->module_alias) {
             // Handle module alias: import math alias m;
-            Symbol *mod_sym = scope_define_symbol(unit->global_scope, import->module_alias, NULL, SYMBOL_VALUE_MODULE, target->absolute_path, import->is_pub, NULL);
+            Symbol *mod_sym = scope_define_symbol(unit->global_scope, import->module_alias, NULL, SYMBOL_VALUE_MODULE, target->file, import->is_pub, NULL);
             if (mod_sym) {
                 mod_sym->module_scope = target->global_scope;
             }
@@ -1516,67 +1964,464 @@ static void resolve_imports(TypeCheckContext *ctx, CompilationUnit *unit) {
 // MAIN ENTRY POINT
 // -----------------------------------------------------------------------------
 
-void typecheck_program(TypeCheckContext *ctx) {
-    if (!ctx || !ctx->loader) return;
-    Arena *scope_arena = ctx->store->arena;
+// One trace span per sub-pass, named after the function that runs it
+#define SEMA_PASS(pass, ...) do { trace_begin("sema", #pass); pass(__VA_ARGS__); trace_end(); } while (0)
 
-    // Create a shared "Universe" scope for primitives and keywords
-    int universe_count = (ctx->keywords ? ctx->keywords->dense_index_count : 0) + 32;
-    Scope *universe_scope = scope_create(scope_arena, NULL, universe_count, SCOPE_KEYWORDS);
-    register_primitives_to_scope(ctx->store, universe_scope, ctx->keywords);
+// -----------------------------------------------------------------------------
+// Pass 1: Signatures
+// -----------------------------------------------------------------------------
 
-    // 1. Initialize Global Scopes for all units
-    for (size_t i = 0; i < ctx->loader->units_ordered->count; i++) {
-        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(ctx->loader->units_ordered, i);
-        int id_count = (ctx->identifiers ? ctx->identifiers->dense_index_count : 0) + 64;
-        unit->global_scope = scope_create(scope_arena, universe_scope, id_count, SCOPE_IDENTIFIERS);
-        unit->global_scope->unit = unit; // Set the unit pointer
-        register_intrinsics(ctx->store, unit->global_scope, ctx->identifiers);
+/*
+ * Pass 1 for one unit: names, then imports, then full signatures. The units
+ * it imports must be done, since their names are bound here. The unit's
+ * global scope grows from ctx->arena meanwhile, which on a pool worker is
+ * the worker's own.
+ */
+static void resolve_unit_signatures(TypeCheckContext *ctx, CompilationUnit *unit) {
+    ctx->file = unit->file;
+    ctx->program = unit->ast_root;
+    SourceId mem_source = mem_report_set_source(unit->file);
+    Arena *scope_arena = scope_set_arena(unit->global_scope, ctx->arena);
+    trace_begin("sema", unit->absolute_path);
+
+    // Step A: Names (Register Struct/Global/Function/Alias names)
+    SEMA_PASS(register_program_structs, ctx, unit->global_scope);
+    SEMA_PASS(register_program_enums, ctx, unit->global_scope);
+    SEMA_PASS(register_program_globals, ctx, unit->global_scope);
+    SEMA_PASS(register_program_functions, ctx, unit->global_scope);
+    SEMA_PASS(register_program_aliases, ctx, unit->global_scope);
+    SEMA_PASS(group_program_methods, ctx, unit->global_scope);
+
+    // Step B: Imports (Now that all dependency names are registered due to post-order)
+    SEMA_PASS(resolve_imports, ctx, unit);
+    unit->imports_resolved = true;
+
+    // Step C: Full Signatures (Types are now available via imports)
+    SEMA_PASS(resolve_program_aliases, ctx, unit->global_scope);
+    SEMA_PASS(resolve_program_structs, ctx, unit->global_scope);
+    SEMA_PASS(resolve_program_enums, ctx, unit->global_scope);
+    SEMA_PASS(resolve_program_globals, ctx, unit->global_scope);
+    SEMA_PASS(resolve_program_functions, ctx, unit->global_scope);
+    SEMA_PASS(resolve_program_methods, ctx, unit->global_scope);
+    unit->signatures_resolved = true;
+
+    trace_end();
+    scope_set_arena(unit->global_scope, scope_arena);
+    mem_report_set_source(mem_source);
+}
+
+/* Pass 1 on this thread, module by module in dependency order. */
+static void resolve_signatures_serial(TypeCheckContext *ctx) {
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (!unit->signatures_resolved) resolve_unit_signatures(ctx, unit);
     }
+}
 
-    // 2. Pass 1: Signatures (Interleaved loop: Names -> Imports -> Full Signatures)
-    for (size_t i = 0; i < ctx->loader->units_ordered->count; i++) {
-        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(ctx->loader->units_ordered, i);
-        ctx->filename = unit->absolute_path;
+// -----------------------------------------------------------------------------
+// Parallel Passes: Worker Pool
+// -----------------------------------------------------------------------------
+
+static void *sema_worker_main(void *arg) {
+    SemaWorker *w = arg;
+    SemaPool *pool = w->pool;
+    for (;;) {
+        pthread_mutex_lock(&pool->queue_lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->queue_lock);
+        if (i >= pool->queue_count) break;
+
+        SemaJob *job = pool->queue[i];
+        w->job = job;
+        w->ctx.errors = &job->errors;
+        pthread_rwlock_rdlock(&pool->sema_lock);
+        if (job->unit) {
+            resolve_unit_signatures(&w->ctx, job->unit);
+        } else {
+            check_function(&w->ctx, job->scope, job->func);
+        }
+        pthread_rwlock_unlock(&pool->sema_lock);
+        w->job = NULL;
+    }
+    return NULL;
+}
+
+static void *sema_worker_thread(void *arg) {
+    sema_worker_main(arg);
+    arena_scratch_release();
+    return NULL;
+}
+
+static void sema_pool_init(SemaPool *pool) {
+    memset(pool, 0, sizeof(*pool));
+    pool->late_errors = hashmap_create(NULL, 16);
+    pool->late_deps = hashmap_create(NULL, 16);
+
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    // Readers come back after every job; let a waiting writer go first
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&pool->sema_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&pool->queue_lock, NULL);
+}
+
+/* `threads` workers, each with its own arena and local symbol table. */
+static SemaWorker *sema_workers_create(TypeCheckContext *ctx, SemaPool *pool, int threads) {
+    SemaWorker *workers = xcalloc((size_t)threads, sizeof(SemaWorker));
+    for (int t = 0; t < threads; t++) {
+        SemaWorker *w = &workers[t];
+        w->pool = pool;
+        w->arena = arena_create(1024 * 1024);
+        w->ctx = *ctx;
+        w->ctx.arena = w->arena;
+        w->ctx.locals = symbol_table_create(w->arena, ctx->identifiers ? ctx->identifiers->dense_index_count : 0);
+        w->ctx.worker = w;
+        dynarray_init(&w->section_errors, sizeof(TypeError));
+        w->ctx.overload_cache = NULL; // Per worker: lookups are not synchronized
+        w->ctx.is_draining = false;
+        w->ctx.current_mono_depth = 0;
+    }
+    return workers;
+}
+
+/* Run `count` jobs on up to `threads` workers; returns when all are done. */
+static void sema_pool_run(SemaPool *pool, SemaWorker *workers, int threads, SemaJob **queue, size_t count) {
+    pool->queue = queue;
+    pool->queue_count = count;
+    pool->next = 0;
+    if ((size_t)threads > count) threads = count ? (int)count : 1;
+
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, sema_worker_thread, &workers[t]) != 0) break;
+        started = t;
+    }
+    sema_worker_main(&workers[0]); // Also picks up what failed threads would have done
+    for (int t = 1; t <= started; t++) pthread_join(workers[t].thread, NULL);
+}
+static int slice_order(const Slice *a, const Slice *b) {
+    if (!a || !b) return (a != NULL) - (b != NULL);
+    size_t n = a->len < b->len ? a->len : b->len;
+    int c = memcmp(a->ptr, b->ptr, n);
+    if (c != 0) return c;
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+// Instances made by the pool: by target struct (methods), then name
+static int mono_instance_cmp(const void *pa, const void *pb) {
+    const AstFunctionDeclaration *a = &(*(AstNode *const *)pa)->data.function_declaration;
+    const AstFunctionDeclaration *b = &(*(AstNode *const *)pb)->data.function_declaration;
+    const AstNode *ta = a->target_type_node, *tb = b->target_type_node;
+    const Slice *sa = ta && ta->node_type == AST_IDENTIFIER ? (Slice*)ta->data.identifier.intern_result->key : NULL;
+    const Slice *sb = tb && tb->node_type == AST_IDENTIFIER ? (Slice*)tb->data.identifier.intern_result->key : NULL;
+    int c = slice_order(sa, sb);
+    if (c != 0) return c;
+    return slice_order(a->intern_result ? (Slice*)a->intern_result->key : NULL,
+                       b->intern_result ? (Slice*)b->intern_result->key : NULL);
+}
+
+/* Where each unit's mono_instances end now, for sort_new_mono_instances(). */
+static size_t *mono_instances_mark(DynArray *units) {
+    size_t *mark = xcalloc(units->count ? units->count : 1, sizeof(size_t));
+    for (size_t u = 0; u < units->count; u++) {
+        CompilationUnit *unit = DYNARRAY_AT(CompilationUnit*, units, u);
+        mark[u] = unit->mono_instances ? unit->mono_instances->count : 0;
+    }
+    return mark;
+}
+
+/* Sort the instances each unit gained since `mark` by name, and free `mark`. */
+static void sort_new_mono_instances(DynArray *units, size_t *mark) {
+    for (size_t u = 0; u < units->count; u++) {
+        DynArray *instances = DYNARRAY_AT(CompilationUnit*, units, u)->mono_instances;
+        if (!instances || instances->count - mark[u] < 2) continue;
+        qsort((AstNode**)instances->data + mark[u], instances->count - mark[u], sizeof(AstNode*), mono_instance_cmp);
+    }
+    free(mark);
+}
+
+/* The errors of instance `key` and of the instances it asked for, once each. */
+static void merge_late_errors(TypeCheckContext *ctx, SemaPool *pool, HashMap *merged, void *key) {
+    if (ptrmap_get(merged, key)) return;
+    ptrmap_put(merged, key, key);
+    DynArray *errors = ptrmap_get(pool->late_errors, key);
+    if (errors) {
+        for (size_t e = 0; e < errors->count; e++) dynarray_push_value(ctx->errors, dynarray_get(errors, e));
+    }
+    DynArray *deps = ptrmap_get(pool->late_deps, key);
+    if (deps) DYNARRAY_FOREACH(void*, dep_it, deps) merge_late_errors(ctx, pool, merged, *dep_it);
+}
+
+/*
+ * Merge the errors of `jobs` in job order (declaration order), each
+ * instance's at the first request for it, so the report is the serial one
+ * whatever the scheduling. Then release the pool. The workers' arenas are
+ * adopted by the store rather than merged into it: scopes and method tables
+ * built from them may still grow.
+ */
+static void sema_pool_finish(TypeCheckContext *ctx, SemaPool *pool, SemaWorker *workers, int threads, SemaJob *jobs, size_t count) {
+    HashMap *merged = hashmap_create(NULL, 16);
+    for (size_t i = 0; i < count; i++) {
+        DynArray *errors = &jobs[i].errors;
+        size_t e = 0;
+        DYNARRAY_FOREACH(InstanceRequest, req, &jobs[i].requests) {
+            for (; e < req->at && e < errors->count; e++) dynarray_push_value(ctx->errors, dynarray_get(errors, e));
+            merge_late_errors(ctx, pool, merged, req->key);
+        }
+        for (; e < errors->count; e++) dynarray_push_value(ctx->errors, dynarray_get(errors, e));
+        dynarray_free(errors);
+        dynarray_free(&jobs[i].requests);
+    }
+
+    // Each key was noted as a request or a dependency, so all are merged by now
+    size_t cursor = 0;
+    void *key, *value;
+    while (hashmap_next(pool->late_errors, &cursor, &key, &value)) {
+        dynarray_free(value);
+        free(value);
+    }
+    cursor = 0;
+    while (hashmap_next(pool->late_deps, &cursor, &key, &value)) {
+        dynarray_free(value);
+        free(value);
+    }
+    hashmap_destroy(pool->late_errors, NULL, NULL);
+    hashmap_destroy(pool->late_deps, NULL, NULL);
+    hashmap_destroy(merged, NULL, NULL);
+
+    for (int t = 0; t < threads; t++) {
+        dynarray_free(&workers[t].section_errors);
+        arena_adopt(ctx->arena, workers[t].arena);
+    }
+    free(workers);
+    pthread_mutex_destroy(&pool->queue_lock);
+    pthread_rwlock_destroy(&pool->sema_lock);
+}
+
+// -----------------------------------------------------------------------------
+// Parallel Pass 1: Signatures by Dependency Level
+// -----------------------------------------------------------------------------
+
+/*
+ * Dependency level of every unit, into `level`: one above each unit it
+ * imports and, across an import cycle, one above each earlier unit that
+ * imports it, so two units of one level never read each other's scopes.
+ * Units resolved by an earlier call are at level 0. Returns the highest.
+ */
+static size_t signature_levels(TypeCheckContext *ctx, size_t *level) {
+    DynArray *units = ctx->loader->units_ordered;
+    size_t n = units->count;
+    size_t *floor = xcalloc(n ? n : 1, sizeof(size_t)); // Set by earlier units that import a later one
+    ArenaScratch scratch = arena_scratch_begin();
+    HashMap *position = hashmap_create(scratch.arena, n);
+    for (size_t i = 0; i < n; i++) ptrmap_put(position, DYNARRAY_AT(CompilationUnit*, units, i), (void*)(uintptr_t)(i + 1));
+
+    size_t levels = 0;
+    for (size_t i = 0; i < n; i++) {
+        CompilationUnit *unit = DYNARRAY_AT(CompilationUnit*, units, i);
+        level[i] = 0;
+        if (unit->signatures_resolved) continue;
+        level[i] = floor[i] > 1 ? floor[i] : 1;
+
+        AstProgram *program = unit->ast_root ? &unit->ast_root->data.program : NULL;
+        for (int lift_later = 0; program && program->decls && lift_later < 2; lift_later++) {
+            DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+                if ((*decl_it)->node_type != AST_IMPORT_DECLARATION) continue;
+                CompilationUnit *target = import_target(ctx, &(*decl_it)->data.import_declaration);
+                size_t j = target ? (size_t)(uintptr_t)ptrmap_get(position, target) : 0;
+                if (j-- == 0 || j == i) continue;
+                if (!lift_later && j < i && level[j] + 1 > level[i]) level[i] = level[j] + 1;
+                if (lift_later && j > i && floor[j] < level[i] + 1) floor[j] = level[i] + 1;
+            }
+        }
+        if (level[i] > levels) levels = level[i];
+    }
+
+    arena_scratch_end(scratch);
+    free(floor);
+    return levels;
+}
+
+/*
+ * Pass 1 with up to `threads` workers. Units are resolved a dependency level
+ * at a time, the units of one level in parallel; each pool run is the
+ * barrier before the next level, whose imports it binds. Errors and the
+ * instances queued meanwhile are put in a fixed order afterwards, as in
+ * check_bodies_parallel.
+ */
+static void resolve_signatures_parallel(TypeCheckContext *ctx, int threads) {
+    DynArray *units = ctx->loader->units_ordered;
+    size_t n = units->count;
+    size_t *level = xcalloc(n ? n : 1, sizeof(size_t));
+    size_t levels = signature_levels(ctx, level);
+
+    // Jobs in unit order (the error order); the queue holds them by level
+    size_t *width = xcalloc(levels + 2, sizeof(size_t));
+    size_t job_count = 0, widest = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (level[i] == 0) continue;
+        job_count++;
+        if (++width[level[i]] > widest) widest = width[level[i]];
+    }
+    if ((size_t)threads > widest) threads = widest ? (int)widest : 1;
+    bool concurrent = threads > 1 && typestore_begin_concurrent(ctx->store);
+    if (!concurrent) {
+        // A chain of imports, or no memory for the shards: nothing to overlap
+        free(width);
+        free(level);
+        resolve_signatures_serial(ctx);
+        return;
+    }
+
+    SemaJob *jobs = xcalloc(job_count, sizeof(SemaJob));
+    SemaJob **queue = xcalloc(job_count, sizeof(SemaJob*));
+    size_t *next_slot = xcalloc(levels + 2, sizeof(size_t));
+    for (size_t l = 1; l <= levels; l++) next_slot[l + 1] = next_slot[l] + width[l];
+    for (size_t i = 0, k = 0; i < n; i++) {
+        if (level[i] == 0) continue;
+        CompilationUnit *unit = DYNARRAY_AT(CompilationUnit*, units, i);
+        jobs[k].unit = unit;
+        jobs[k].scope = unit->global_scope;
+        dynarray_init(&jobs[k].errors, sizeof(TypeError));
+        dynarray_init(&jobs[k].requests, sizeof(InstanceRequest));
+        queue[next_slot[level[i]]++] = &jobs[k++];
+    }
+
+    size_t queue_start = ctx->mono_queue->count;
+    size_t *mono_mark = mono_instances_mark(units);
+    SemaPool pool;
+    sema_pool_init(&pool);
+    SemaWorker *workers = sema_workers_create(ctx, &pool, threads);
+    for (size_t l = 1, start = 0; l <= levels; start += width[l], l++) {
+        sema_pool_run(&pool, workers, threads, queue + start, width[l]);
+    }
+    typestore_end_concurrent(ctx->store);
+
+    sema_pool_finish(ctx, &pool, workers, threads, jobs, job_count);
+    sort_new_mono_instances(units, mono_mark);
+    sort_mono_queue(ctx, queue_start);
+    free(next_slot);
+    free(queue);
+    free(jobs);
+    free(width);
+    free(level);
+}
+
+// -----------------------------------------------------------------------------
+// Parallel Pass 2: Bodies
+// -----------------------------------------------------------------------------
+
+static void push_body_job(DynArray *jobs, TypeCheckContext *ctx, Scope *scope, AstNode *func) {
+    if ((func->flags & (AST_FLAG_PRUNED | AST_FLAG_REUSED)) || is_function_template(scope, func) || !func->type) return;
+    SemaJob job = { .func = func, .scope = scope };
+    dynarray_init(&job.errors, sizeof(TypeError));
+    dynarray_init(&job.requests, sizeof(InstanceRequest));
+
+    // Deferred bodies are parsed here, on one thread, so the interners stay serial
+    DynArray *errors = ctx->errors;
+    ctx->errors = &job.errors;
+    bool has_body = function_body(ctx, func) != NULL;
+    ctx->errors = errors;
+    if (!has_body && job.errors.count == 0) {
+        dynarray_free(&job.errors);
+        dynarray_free(&job.requests);
+        return;
+    }
+    if (!has_body) job.func = NULL; // Its syntax error is all there is to report
+    dynarray_push_value(jobs, &job);
+}
+
+/* A global variable, checked here on this thread, as a job that is already done. */
+static void push_global_job(DynArray *jobs, TypeCheckContext *ctx, Scope *scope, AstNode *decl) {
+    SemaJob job = { .scope = scope };
+    dynarray_init(&job.errors, sizeof(TypeError));
+    dynarray_init(&job.requests, sizeof(InstanceRequest));
+    DynArray *errors = ctx->errors;
+    ctx->errors = &job.errors;
+    check_variable_declaration(ctx, scope, decl);
+    ctx->errors = errors;
+    dynarray_push_value(jobs, &job);
+}
+
+/*
+ * Pass 2 with `threads` workers. Global variables and deferred bodies are
+ * handled first on this thread; the bodies are then checked by the pool, each
+ * job into its own error list. Errors are merged as the serial pass reports
+ * them (see sema_pool_finish), so the report does not depend on scheduling.
+ * Instances the pool created are sorted by name for the same reason.
+ */
+static void check_bodies_parallel(TypeCheckContext *ctx, int threads) {
+    DynArray jobs;
+    dynarray_init(&jobs, sizeof(SemaJob));
+
+    DynArray *units = ctx->loader->units_ordered;
+    size_t *mono_mark = mono_instances_mark(units);
+    for (size_t u = 0; u < units->count; u++) {
+        CompilationUnit *unit = DYNARRAY_AT(CompilationUnit*, units, u);
+        if (unit->bodies_checked) continue;
+        unit->bodies_checked = true;
+        ctx->file = unit->file;
         ctx->program = unit->ast_root;
 
-        // Step A: Names (Register Struct/Global/Function/Alias names)
-        register_program_structs(ctx, unit->global_scope);
-        register_program_enums(ctx, unit->global_scope);
-        register_program_globals(ctx, unit->global_scope);
-        register_program_functions(ctx, unit->global_scope);
-        register_program_aliases(ctx, unit->global_scope);
-        group_program_methods(ctx, unit->global_scope);
+        AstProgram *program = &unit->ast_root->data.program;
+        if (!program->decls) continue;
 
-        // Step B: Imports (Now that all dependency names are registered due to post-order)
-        resolve_imports(ctx, unit);
-        unit->imports_resolved = true;
+        DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type == AST_VARIABLE_DECLARATION) {
+                push_global_job(&jobs, ctx, unit->global_scope, decl);
+            } else if (decl->node_type == AST_FUNCTION_DECLARATION) {
+                push_body_job(&jobs, ctx, unit->global_scope, decl);
+            } else if (decl->node_type == AST_IMPL_DECLARATION) {
+                AstImplDeclaration *impl = &decl->data.impl_declaration;
+                if ((impl->type_params && impl->type_params->count > 0) || !impl->methods) continue;
+                DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                    push_body_job(&jobs, ctx, unit->global_scope, *method_it);
+                }
+            }
+        }
+    }
 
-        // Step C: Full Signatures (Types are now available via imports)
-        resolve_program_aliases(ctx, unit->global_scope);
-        resolve_program_structs(ctx, unit->global_scope);
-        resolve_program_enums(ctx, unit->global_scope);
-        resolve_program_globals(ctx, unit->global_scope);
-        resolve_program_functions(ctx, unit->global_scope);
-        resolve_program_methods(ctx, unit->global_scope);
-        unit->signatures_resolved = true;
+    SemaJob **queue = xcalloc(jobs.count ? jobs.count : 1, sizeof(SemaJob*));
+    size_t queued = 0;
+    for (size_t i = 0; i < jobs.count; i++) {
+        SemaJob *job = &((SemaJob*)jobs.data)[i];
+        if (job->func) queue[queued++] = job;
     }
 
-    drain_mono_queue(ctx);
+    if ((size_t)threads > queued) threads = queued ? (int)queued : 1;
+    bool concurrent = threads > 1 && typestore_begin_concurrent(ctx->store);
+    if (!concurrent) threads = 1;
+    SemaPool pool;
+    sema_pool_init(&pool);
+    SemaWorker *workers = sema_workers_create(ctx, &pool, threads);
+    sema_pool_run(&pool, workers, threads, queue, queued);
+    if (concurrent) typestore_end_concurrent(ctx->store);
 
-    // 3. Pass 2: Bodies (Global)
-    // Keep a constant assignment of 1 so the `last_checked_pass` logic works internally for duplicate prevention
-    ctx->current_pass = 1; 
-    for (size_t i = 0; i < ctx->loader->units_ordered->count; i++) {
-        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(ctx->loader->units_ordered, i);
-        ctx->filename = unit->absolute_path;
+    sema_pool_finish(ctx, &pool, workers, threads, (SemaJob*)jobs.data, jobs.count);
+    sort_new_mono_instances(units, mono_mark);
+    free(queue);
+    dynarray_free(&jobs);
+}
+
+/* Pass 2 on this thread, module by module in dependency order. */
+static void check_bodies_serial(TypeCheckContext *ctx) {
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (unit->bodies_checked) continue;
+        unit->bodies_checked = true;
+        ctx->file = unit->file;
         ctx->program = unit->ast_root;
 
         AstProgram *program = &unit->ast_root->data.program;
         if (!program->decls) continue;
 
-        for (size_t j = 0; j < program->decls->count; j++) {
-            AstNode *decl = *(AstNode**)dynarray_get(program->decls, j);
+        trace_begin("sema", unit->absolute_path);
+        DYNARRAY_FOREACH(AstNode*, decl_it, program->decls) {
+            AstNode *decl = *decl_it;
             switch (decl->node_type) {
                 case AST_VARIABLE_DECLARATION: check_variable_declaration(ctx, unit->global_scope, decl); break;
                 case AST_FUNCTION_DECLARATION: check_function(ctx, unit->global_scope, decl); break;
@@ -1585,8 +2430,8 @@ void typecheck_program(TypeCheckContext *ctx) {
                     if (impl->type_params && impl->type_params->count > 0) break; // Skip generic templates
                     
                     if (impl->methods) {
-                        for (size_t k = 0; k < impl->methods->count; k++) {
-                            AstNode *method = *(AstNode**)dynarray_get(impl->methods, k);
+                        DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+                            AstNode *method = *method_it;
                             check_function(ctx, unit->global_scope, method);
                         }
                     }
@@ -1595,9 +2440,68 @@ void typecheck_program(TypeCheckContext *ctx) {
                 default: break;
             }
         }
+        trace_end();
     }
 }
 
+void typecheck_program(TypeCheckContext *ctx) {
+    if (!ctx || !ctx->loader) return;
+    Arena *scope_arena = ctx->store->arena;
+
+    // The shared "Universe" scope for primitives and keywords (already
+    // there when the store came from a startup snapshot)
+    Scope *universe_scope = typestore_universe(ctx->store, ctx->keywords);
+
+    // Units checked by an earlier call (the --serve daemon's resident
+    // library) keep their scopes, signatures and checked bodies.
+
+    // 1. Initialize Global Scopes for all units
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, ctx->loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        if (unit->global_scope) continue;
+        // Sized by the unit's own declarations (plus the intrinsics), not the
+        // whole program's identifier count
+        size_t decl_count = unit->ast_root && unit->ast_root->data.program.decls ? unit->ast_root->data.program.decls->count : 0;
+        int id_count = (int)decl_count + 64;
+        unit->global_scope = scope_create(scope_arena, universe_scope, id_count, SCOPE_IDENTIFIERS);
+        unit->global_scope->unit = unit; // Set the unit pointer
+        register_intrinsics(ctx->store, unit->global_scope, ctx->identifiers);
+    }
+
+    // 2. Pass 1: Signatures (per unit: Names -> Imports -> Full Signatures)
+    int jobs = ctx->loader->opts ? ctx->loader->opts->jobs : 1;
+    if (jobs > 1) {
+        SEMA_PASS(resolve_signatures_parallel, ctx, jobs);
+    } else {
+        SEMA_PASS(resolve_signatures_serial, ctx);
+    }
+
+    SEMA_PASS(drain_mono_queue, ctx);
+
+    // Library functions nothing reaches are left out of pass 2 and codegen
+    SEMA_PASS(reachability_prune_program, ctx);
+
+    // Bodies an earlier --incremental build already checked and compiled are skipped
+    SEMA_PASS(decl_deps_program, ctx);
+
+    // 3. Pass 2: Bodies (Global)
+    // Keep a constant assignment of 1 so the `last_checked_pass` logic works internally for duplicate prevention
+    ctx->current_pass = 1; 
+    if (jobs > 1) {
+        SEMA_PASS(check_bodies_parallel, ctx, jobs);
+    } else {
+        SEMA_PASS(check_bodies_serial, ctx);
+    }
+
+    // 4. Pass 3: Global initializers that are not LLVM constants yet
+    if (ctx->errors->count == 0) SEMA_PASS(const_eval_program, ctx);
+
+    // 5. Memory effects of the checked functions, for codegen's attributes
+    if (ctx->errors->count == 0) SEMA_PASS(purity_program, ctx);
+}
+
+#undef SEMA_PASS
+
 // --- Generic Monomorphization Helpers ---
 
 static size_t type_mangled_len(Type *t) {
@@ -1617,6 +2521,7 @@ static size_t type_mangled_len(Type *t) {
         case TYPE_POINTER: return 4 + type_mangled_len(t->as.ptr.base);
         case TYPE_ARRAY: return 4 + type_mangled_len(t->as.array.base);
         case TYPE_SLICE: return 6 + type_mangled_len(t->as.slice.base);
+        case TYPE_VECTOR: return 4 + (size_t)snprintf(NULL, 0, "%lld", (long long)t->as.vector.lanes) + type_mangled_len(t->as.vector.base);
         case TYPE_STRUCT:
             if (t->as.struct_type.name && t->as.struct_type.name->key) return ((Slice*)t->as.struct_type.name->key)->len;
             return 6; // struct
@@ -1630,6 +2535,10 @@ static size_t type_mangled_len(Type *t) {
         case TYPE_TYPEVAR:
             if (t->as.typevar.name && t->as.typevar.name->key) return ((Slice*)t->as.typevar.name->key)->len;
             return 7; // typevar
+        case TYPE_CONST_ARG: {
+            int64_t v = t->as.const_arg.value;
+            return (v < 0 ? 1 : 0) + (size_t)snprintf(NULL, 0, "%llu", v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+        }
         default: return 4; // type
     }
 }
@@ -1670,6 +2579,14 @@ static void type_to_mangled_str_append(Type *t, char **buf) {
             memcpy(*buf, "slice_", 6); *buf += 6;
             type_to_mangled_str_append(t->as.slice.base, buf);
             break;
+        case TYPE_VECTOR: {
+            // vec8_f32: the lane count keeps vec<f32, 4> and vec<f32, 8> apart
+            char lanes[24];
+            int n = snprintf(lanes, sizeof(lanes), "vec%lld_", (long long)t->as.vector.lanes);
+            memcpy(*buf, lanes, (size_t)n); *buf += n;
+            type_to_mangled_str_append(t->as.vector.base, buf);
+            break;
+        }
         case TYPE_STRUCT:
             if (t->as.struct_type.name && t->as.struct_type.name->key) {
                 Slice *s = (Slice*)t->as.struct_type.name->key;
@@ -1695,6 +2612,14 @@ static void type_to_mangled_str_append(Type *t, char **buf) {
                 memcpy(*buf, "typevar", 7); *buf += 7;
             }
             break;
+        case TYPE_CONST_ARG: {
+            // Buf__i32__4, and n4 for -4 so the name stays an identifier
+            int64_t v = t->as.const_arg.value;
+            char digits[24];
+            int n = snprintf(digits, sizeof(digits), v < 0 ? "n%llu" : "%llu", v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+            memcpy(*buf, digits, (size_t)n); *buf += n;
+            break;
+        }
         default:
             memcpy(*buf, "type", 4); *buf += 4;
             break;
@@ -1718,7 +2643,7 @@ static Type *instantiate_generic_struct(TypeCheckContext *ctx, Scope *scope, Sym
 
     size_t expected_count = struct_decl->type_params ? struct_decl->type_params->count : 0;
     if (expected_count != count) {
-        TypeError err = { .kind = TE_GENERIC_ARG_MISMATCH, .span = error_span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_GENERIC_ARG_MISMATCH, .span = error_span };
         err.as.generic_mismatch.name = ((Slice*)sym->name_rec->key)->ptr;
         err.as.generic_mismatch.expected = expected_count;
         err.as.generic_mismatch.provided = count;
@@ -1727,31 +2652,40 @@ static Type *instantiate_generic_struct(TypeCheckContext *ctx, Scope *scope, Sym
     }
 
     if (ctx->current_mono_depth > 64) {
-        TypeError err = { .kind = TE_INSTANTIATION_DEPTH, .span = error_span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_INSTANTIATION_DEPTH, .span = error_span };
         err.as.name.name = ((Slice*)sym->name_rec->key)->ptr;
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
 
+    CompilationUnit *unit = module_loader_unit_for_file(ctx->loader, sym->file);
+    if (!check_generic_arg_kinds(ctx, unit ? unit->global_scope : scope, struct_decl->type_params, struct_decl->const_params, arg_types, count, error_span)) {
+        return NULL;
+    }
+
     Type *base_type = sym->type;
     if (!base_type) return NULL;
 
     Type *inst_type = make_generic_inst_type(ctx->store, base_type, arg_types, count);
     if (!inst_type) return NULL;
+    sema_note_instance(ctx, inst_type);
 
     if (inst_type->as.generic_inst.concrete_type) {
+        STAT_INC(MONO_CACHE_HITS);
         return inst_type;
     }
 
     // Check if it's already in the queue to avoid duplicates
     for (size_t i = 0; i < ctx->mono_queue->count; i++) {
-        MonoJob *job = *(MonoJob**)dynarray_get(ctx->mono_queue, i);
+        MonoJob *job = DYNARRAY_AT(MonoJob*, ctx->mono_queue, i);
         if (job->inst_type == inst_type) {
+            STAT_INC(MONO_CACHE_HITS);
             return inst_type; // Already queued
         }
     }
 
-    MonoJob *job = arena_calloc(ctx->store->arena, sizeof(MonoJob));
+    STAT_INC(MONO_STRUCTS);
+    MonoJob *job = arena_calloc(ctx->arena, sizeof(MonoJob));
     job->sym = sym;
     job->inst_type = inst_type;
     job->scope = scope;
@@ -1759,7 +2693,7 @@ static Type *instantiate_generic_struct(TypeCheckContext *ctx, Scope *scope, Sym
     job->depth = ctx->current_mono_depth + 1;
     
     // Copy type arguments so they survive
-    job->arg_types = arena_alloc(ctx->store->arena, sizeof(Type*) * count);
+    job->arg_types = arena_alloc(ctx->arena, sizeof(Type*) * count);
     memcpy(job->arg_types, arg_types, sizeof(Type*) * count);
 
     dynarray_push_value(ctx->mono_queue, &job);
@@ -1767,12 +2701,58 @@ static Type *instantiate_generic_struct(TypeCheckContext *ctx, Scope *scope, Sym
     return inst_type;
 }
 
+typedef struct {
+    MonoJob *job;
+    char *name; // Mangled instance name
+    size_t len;
+} MonoJobKey;
+
+// By mangled name, then by where the template is declared
+static int mono_job_key_cmp(const void *pa, const void *pb) {
+    const MonoJobKey *a = pa, *b = pb;
+    Slice sa = { .ptr = a->name, .len = a->len }, sb = { .ptr = b->name, .len = b->len };
+    int c = slice_order(&sa, &sb);
+    if (c != 0) return c;
+    Symbol *ta = a->job->sym, *tb = b->job->sym;
+    if (ta->file != tb->file) {
+        const char *fa = source_path(ta->file), *fb = source_path(tb->file);
+        c = strcmp(fa ? fa : "", fb ? fb : "");
+        if (c != 0) return c;
+    }
+    return (ta->span.start > tb->span.start) - (ta->span.start < tb->span.start);
+}
+
+/*
+ * Sort the struct instances queued since `start` by name. Parallel pass 1
+ * queues them in whatever order its workers reach them; draining them in a
+ * fixed one keeps the errors and nested instances the same on every run.
+ */
+static void sort_mono_queue(TypeCheckContext *ctx, size_t start) {
+    size_t count = ctx->mono_queue->count - start;
+    if (count < 2) return;
+    ArenaScratch scratch = arena_scratch_begin();
+    MonoJobKey *keys = arena_alloc(scratch.arena, count * sizeof(MonoJobKey));
+    for (size_t i = 0; i < count; i++) {
+        MonoJob *job = DYNARRAY_AT(MonoJob*, ctx->mono_queue, start + i);
+        char *name = arena_alloc(scratch.arena, type_mangled_len(job->inst_type) + 1);
+        char *end = name;
+        type_to_mangled_str_append(job->inst_type, &end);
+        keys[i] = (MonoJobKey){ .job = job, .name = name, .len = (size_t)(end - name) };
+    }
+    qsort(keys, count, sizeof(MonoJobKey), mono_job_key_cmp);
+    for (size_t i = 0; i < count; i++) DYNARRAY_AT(MonoJob*, ctx->mono_queue, start + i) = keys[i].job;
+    arena_scratch_end(scratch);
+}
+
 static void drain_mono_queue(TypeCheckContext *ctx) {
     if (ctx->is_draining) return;
     ctx->is_draining = true;
+    // Each job runs at its own depth; the caller's must survive the drain,
+    // or every later instantiation would start deeper
+    int outer_depth = ctx->current_mono_depth;
 
     for (size_t q = 0; q < ctx->mono_queue->count; q++) {
-        MonoJob *job = *(MonoJob**)dynarray_get(ctx->mono_queue, q);
+        MonoJob *job = DYNARRAY_AT(MonoJob*, ctx->mono_queue, q);
         Type *inst_type = job->inst_type;
         if (inst_type->as.generic_inst.concrete_type) continue;
 
@@ -1790,7 +2770,7 @@ static void drain_mono_queue(TypeCheckContext *ctx) {
         // Check for recursion AFTER popping from queue if needed, but true structural 
         // infinite recursion will just hang here. We should use a depth counter if we wanted to prevent hangs.
         if (sym->flags & SYMBOL_FLAG_COMPUTING) {
-            TypeError err = { .kind = TE_INCOMPLETE_TYPE, .span = decl_node->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_INCOMPLETE_TYPE, .span = decl_node->span };
             err.as.name.name = "Recursive instantiation of generic struct";
             dynarray_push_value(ctx->errors, &err);
             continue;
@@ -1805,7 +2785,8 @@ static void drain_mono_queue(TypeCheckContext *ctx) {
         total_len += 2 + type_mangled_len(arg_types[i]); // "__" + arg
     }
     
-    char *name_buf = arena_alloc(ctx->store->arena, total_len + 1);
+    ArenaScratch scratch = arena_scratch_begin();
+    char *name_buf = arena_alloc(scratch.arena, total_len + 1);
     char *ptr = name_buf;
     memcpy(ptr, base_slice->ptr, base_len);
     ptr += base_len;
@@ -1819,43 +2800,67 @@ static void drain_mono_queue(TypeCheckContext *ctx) {
 
     Slice mangled_slice = { .ptr = name_buf, .len = total_len };
     InternResult *mangled_res = intern(ctx->identifiers, &mangled_slice, NULL);
+    arena_scratch_end(scratch);
 
-    CompilationUnit *unit = module_loader_get_unit(ctx->loader, sym->filename);
+    CompilationUnit *unit = module_loader_unit_for_file(ctx->loader, sym->file);
     Scope *parent_global = unit ? unit->global_scope : scope;
-    Scope *inst_scope = scope_create(ctx->store->arena, parent_global, count, SCOPE_IDENTIFIERS);
+    Scope *inst_scope = scope_create(ctx->arena, parent_global, count, SCOPE_IDENTIFIERS);
 
-    for (size_t i = 0; i < count; i++) {
-        InternResult *tp_name = *(InternResult**)dynarray_get(struct_decl->type_params, i);
-        define_symbol_or_error(ctx, inst_scope, tp_name, arg_types[i], SYMBOL_VALUE_TYPE, sym->span, false, sym->filename, NULL);
-    }
+    bind_type_params(ctx, inst_scope, struct_decl->type_params, struct_decl->const_params, arg_types, count, sym->span, sym->file);
 
-    Type *concrete_struct = arena_calloc(ctx->store->arena, sizeof(Type));
+    Type *concrete_struct = arena_calloc(ctx->arena, sizeof(Type));
+    MEM_ACCOUNT(MEM_TYPES, TYPE_STRUCT, ctx->file, sizeof(Type), 1);
     concrete_struct->kind = TYPE_STRUCT;
     concrete_struct->as.struct_type.name = mangled_res;
     concrete_struct->as.struct_type.decl_node = sym->decl_node;
     concrete_struct->as.struct_type.field_count = struct_decl->fields ? struct_decl->fields->count : 0;
-    concrete_struct->as.struct_type.fields = concrete_struct->as.struct_type.field_count > 0 ? arena_alloc(ctx->store->arena, sizeof(StructField) * concrete_struct->as.struct_type.field_count) : NULL;
-    concrete_struct->as.struct_type.field_map = hashmap_create(ctx->store->arena, concrete_struct->as.struct_type.field_count);
-    concrete_struct->as.struct_type.methods = hashmap_create(ctx->store->arena, 4);
+    concrete_struct->as.struct_type.fields = concrete_struct->as.struct_type.field_count > 0 ? arena_alloc(ctx->arena, sizeof(StructField) * concrete_struct->as.struct_type.field_count) : NULL;
+    concrete_struct->as.struct_type.field_map = hashmap_create(ctx->arena, concrete_struct->as.struct_type.field_count);
+    concrete_struct->as.struct_type.methods = hashmap_create(ctx->arena, 4);
 
     inst_type->as.generic_inst.concrete_type = concrete_struct;
 
-    const char *saved_filename = ctx->filename;
-    ctx->filename = sym->filename;
+    SourceId saved_file = ctx->file;
+    ctx->file = sym->file;
     for (size_t j = 0; j < concrete_struct->as.struct_type.field_count; j++) {
         AstFieldDecl *fdecl = (AstFieldDecl*)dynarray_get(struct_decl->fields, j);
         concrete_struct->as.struct_type.fields[j].name = fdecl->name;
         concrete_struct->as.struct_type.fields[j].type = resolve_ast_type(ctx, inst_scope, fdecl->type);
-        hashmap_put(concrete_struct->as.struct_type.field_map, fdecl->name->key, (void*)(uintptr_t)(j + 1), ptr_hash, ptr_cmp);
+        ptrmap_put(concrete_struct->as.struct_type.field_map, fdecl->name->key, (void*)(uintptr_t)(j + 1));
     }
-    ctx->filename = saved_filename;
+    ctx->file = saved_file;
 
     sym->flags &= ~SYMBOL_FLAG_COMPUTING;
     }
+
+    // An instance can hold one queued after it: lay them out once all are resolved
+    DYNARRAY_FOREACH(MonoJob*, job_it, ctx->mono_queue) {
+        Type *concrete = (*job_it)->inst_type->as.generic_inst.concrete_type;
+        if (concrete) type_struct_layout(concrete);
+    }
+    ctx->current_mono_depth = outer_depth;
     ctx->is_draining = false;
 }
 
-Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *inst_type, AstNode *method_node) {
+/*
+ * Remember what `mono` was instantiated with. Codegen keys the cached object
+ * of an instance on these (see codegen_use_cached_instances).
+ */
+static void record_mono_args(TypeCheckContext *ctx, CompilationUnit *unit, AstNode *mono, Type **args, size_t count) {
+    if (!unit || !unit->mono_args) return;
+    DynArray *recorded = arena_alloc(ctx->arena, sizeof(DynArray));
+    dynarray_init_in_arena(recorded, ctx->arena, sizeof(Type*), count ? count : 1);
+    for (size_t i = 0; i < count; i++) dynarray_push_value(recorded, &args[i]);
+    ptrmap_put(unit->mono_args, mono, recorded);
+}
+
+/* Give a deferred template the body its clones will share, before the first one is made. */
+static void share_template_body(TypeCheckContext *ctx, AstNode *template) {
+    AstFunctionDeclaration *decl = &template->data.function_declaration;
+    if (decl->lazy_body && !decl->body && !decl->template_body) decl->template_body = template_body_create(ctx->arena);
+}
+
+static Symbol *instantiate_method(TypeCheckContext *ctx, Scope *scope, Type *inst_type, AstNode *method_node) {
     if (!ctx || !scope || !inst_type || inst_type->kind != TYPE_GENERIC_INST || !method_node) return NULL;
     
     Type *base_type = inst_type->as.generic_inst.base;
@@ -1866,8 +2871,13 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
     InternResult *orig_name = orig_func->intern_result;
     
     // Check if already monomorphized
-    Symbol *existing = (Symbol*)hashmap_get(concrete_struct->as.struct_type.methods, orig_name->key, ptr_hash, ptr_cmp);
-    if (existing) return existing;
+    Symbol *existing = (Symbol*)ptrmap_get(concrete_struct->as.struct_type.methods, orig_name->key);
+    if (existing) {
+        sema_note_instance(ctx, existing);
+        STAT_INC(MONO_CACHE_HITS);
+        return existing;
+    }
+    STAT_INC(MONO_METHODS);
     
     // Get the decl_node directly from the struct type!
     AstNode *decl_node = base_type->as.struct_type.decl_node;
@@ -1876,10 +2886,11 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
     }
     
     // The method's parent scope should be the global scope where the struct was DEFINED!
-    CompilationUnit *unit = module_loader_get_unit(ctx->loader, decl_node->filename);
+    CompilationUnit *unit = module_loader_unit_for_file(ctx->loader, decl_node->span.file);
     Scope *parent_global = unit ? unit->global_scope : scope;
     
-    AstNode *mono_method = ast_clone_node(method_node, ctx->store->arena);
+    share_template_body(ctx, method_node);
+    AstNode *mono_method = ast_clone_node(method_node, ctx->arena);
     if (!mono_method) return NULL;
     
     AstFunctionDeclaration *mono_func = &mono_method->data.function_declaration;
@@ -1887,11 +2898,8 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
     AstStructDeclaration *struct_decl = &decl_node->data.struct_declaration;
     size_t count = inst_type->as.generic_inst.arg_count;
     
-    Scope *inst_scope = scope_create(ctx->store->arena, parent_global, count, SCOPE_IDENTIFIERS);
-    for (size_t i = 0; i < count; i++) {
-        InternResult *tp_name = *(InternResult**)dynarray_get(struct_decl->type_params, i);
-        define_symbol_or_error(ctx, inst_scope, tp_name, inst_type->as.generic_inst.args[i], SYMBOL_VALUE_TYPE, decl_node->span, false, decl_node->filename, NULL);
-    }
+    Scope *inst_scope = scope_create(ctx->arena, parent_global, count, SCOPE_IDENTIFIERS);
+    bind_type_params(ctx, inst_scope, struct_decl->type_params, struct_decl->const_params, inst_type->as.generic_inst.args, count, decl_node->span, decl_node->span.file);
     
     // Generate LLVM mangled name: Vec__i32_push
     Slice *base_slice = (Slice*)base_type->as.struct_type.name->key;
@@ -1905,7 +2913,8 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
     Slice *orig_slice = (Slice*)orig_name->key;
     size_t m_len = total_len + 1 + orig_slice->len; // name_buf + '_' + orig_name
     
-    char *m_name = arena_alloc(ctx->store->arena, m_len + 1);
+    ArenaScratch scratch = arena_scratch_begin();
+    char *m_name = arena_alloc(scratch.arena, m_len + 1);
     char *ptr = m_name;
     memcpy(ptr, base_slice->ptr, base_len);
     ptr += base_len;
@@ -1924,6 +2933,7 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
     
     Slice m_slice = { .ptr = m_name, .len = m_len };
     InternResult *mono_m_res = intern(ctx->identifiers, &m_slice, NULL);
+    arena_scratch_end(scratch);
     
     mono_func->intern_result = orig_name; 
     
@@ -1933,17 +2943,18 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
             mono_func->target_type_node->data.identifier.intern_result = concrete_struct->as.struct_type.name;
         }
         
-        Symbol *method_sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+        Symbol *method_sym = arena_calloc(ctx->arena, sizeof(Symbol));
+        MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
         method_sym->name_rec = mono_func->intern_result;
         method_sym->kind = SYMBOL_GENERIC_FUNCTION;
         method_sym->decl_node = mono_method;
         method_sym->is_pub = mono_func->is_pub;
-        method_sym->filename = mono_method->filename;
+        method_sym->file = mono_method->span.file;
         method_sym->module_scope = inst_scope; // Save struct's generic bindings
-        method_sym->overloads = arena_calloc(ctx->store->arena, sizeof(DynArray));
-        dynarray_init_in_arena(method_sym->overloads, ctx->store->arena, sizeof(Symbol*), 4);
+        method_sym->overloads = arena_calloc(ctx->arena, sizeof(DynArray));
+        dynarray_init_in_arena(method_sym->overloads, ctx->arena, sizeof(Symbol*), 4);
         
-        hashmap_put(concrete_struct->as.struct_type.methods, orig_name->key, method_sym, ptr_hash, ptr_cmp);
+        ptrmap_put(concrete_struct->as.struct_type.methods, orig_name->key, method_sym);
         return method_sym;
     }
 
@@ -1952,35 +2963,87 @@ Symbol *instantiate_generic_method(TypeCheckContext *ctx, Scope *scope, Type *in
         mono_func->target_type_node->data.identifier.intern_result = concrete_struct->as.struct_type.name;
     }
     
-    Symbol *method_sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+    Symbol *method_sym = arena_calloc(ctx->arena, sizeof(Symbol));
+    MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
+    sema_note_instance(ctx, method_sym);
     method_sym->name_rec = mono_func->intern_result;
     method_sym->kind = SYMBOL_VALUE_FUNCTION;
     method_sym->decl_node = mono_method;
     method_sym->is_pub = mono_func->is_pub;
-    method_sym->filename = mono_method->filename;
+    method_sym->file = mono_method->span.file;
 
-    const char *saved_filename = ctx->filename;
-    ctx->filename = method_sym->filename;
+    SourceId saved_file = ctx->file;
+    ctx->file = method_sym->file;
 
     resolve_function_decl(ctx, inst_scope, mono_method);
     
     method_sym->type = mono_method->type;
-    hashmap_put(concrete_struct->as.struct_type.methods, orig_name->key, method_sym, ptr_hash, ptr_cmp);
+    ptrmap_put(concrete_struct->as.struct_type.methods, orig_name->key, method_sym);
     
-    define_symbol_or_error(ctx, parent_global, mono_m_res, mono_method->type, SYMBOL_VALUE_FUNCTION, mono_method->span, mono_func->is_pub, mono_method->filename, mono_method);
+    define_symbol_or_error(ctx, parent_global, mono_m_res, mono_method->type, SYMBOL_VALUE_FUNCTION, mono_method->span, mono_func->is_pub, mono_method->span.file, mono_method);
     
-    unit = module_loader_get_unit(ctx->loader, method_sym->filename);
+    unit = module_loader_unit_for_file(ctx->loader, method_sym->file);
     if (unit && unit->mono_instances) {
         dynarray_push_value(unit->mono_instances, &mono_method);
     }
+    record_mono_args(ctx, unit, mono_method, &inst_type, 1);
     
     check_function(ctx, inst_scope, mono_method);
-    ctx->filename = saved_filename;
+    ctx->file = saved_file;
     
     return method_sym;
 }
 
-Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol *sym, Type **arg_types, size_t count, Span error_span) {
+/*
+ * The method templates of a generic struct, by name, from every impl block
+ * registered for it. Built on the first lookup against one of its
+ * instances, so later lookups (including misses) cost one probe instead of
+ * a walk over each impl's methods. Rebuilt if an impl was registered since.
+ */
+typedef struct {
+    HashMap *by_name;  // Method name key -> AST_FUNCTION_DECLARATION (first declared wins)
+    size_t impl_count; // impl_registry entries it was built from
+} ImplMethodIndex;
+
+static ImplMethodIndex *build_impl_method_index(TypeCheckContext *ctx, Type *base_type, DynArray *impls) {
+    ImplMethodIndex *index = arena_alloc(ctx->arena, sizeof(ImplMethodIndex));
+    index->by_name = hashmap_create(ctx->arena, 16);
+    index->impl_count = impls->count;
+    DYNARRAY_FOREACH(AstNode*, impl_it, impls) {
+        AstImplDeclaration *impl = &(*impl_it)->data.impl_declaration;
+        if (!impl->methods) continue;
+        DYNARRAY_FOREACH(AstNode*, method_it, impl->methods) {
+            AstNode *method = *method_it;
+            if (method->node_type != AST_FUNCTION_DECLARATION) continue;
+            InternResult *name = method->data.function_declaration.intern_result;
+            if (name && !ptrmap_get(index->by_name, name->key)) ptrmap_put(index->by_name, name->key, method);
+        }
+    }
+    ptrmap_put(ctx->store->impl_method_index, base_type, index);
+    return index;
+}
+
+Symbol *lookup_generic_method(TypeCheckContext *ctx, Scope *scope, Type *inst_type, InternResult *method_name) {
+    if (!ctx || !inst_type || inst_type->kind != TYPE_GENERIC_INST || !method_name) return NULL;
+    ctx->instance_uses++;
+    Type *base_type = inst_type->as.generic_inst.base;
+    DynArray *impls = (DynArray*)ptrmap_get(ctx->store->impl_registry, (void*)base_type);
+    if (!impls) return NULL;
+
+    // Tables only change inside exclusive sections, so a current one can be read as is
+    ImplMethodIndex *index = ptrmap_get(ctx->store->impl_method_index, base_type);
+    if (index && index->impl_count == impls->count && !ptrmap_get(index->by_name, method_name->key)) return NULL;
+
+    sema_exclusive_begin(ctx);
+    index = ptrmap_get(ctx->store->impl_method_index, base_type);
+    if (!index || index->impl_count != impls->count) index = build_impl_method_index(ctx, base_type, impls);
+    AstNode *method_node = ptrmap_get(index->by_name, method_name->key);
+    Symbol *method_sym = method_node ? instantiate_method(ctx, scope, inst_type, method_node) : NULL;
+    sema_exclusive_end(ctx);
+    return method_sym;
+}
+
+static Symbol *instantiate_function(TypeCheckContext *ctx, Scope *scope, Symbol *sym, Type **arg_types, size_t count, Span error_span) {
     if (!ctx || !scope || !sym || !sym->decl_node) return NULL;
     
     AstNode *decl_node = sym->decl_node;
@@ -1989,7 +3052,7 @@ Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol
     
     size_t expected_count = func_decl->type_params ? func_decl->type_params->count : 0;
     if (expected_count != count) {
-        TypeError err = { .kind = TE_GENERIC_ARG_MISMATCH, .span = error_span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_GENERIC_ARG_MISMATCH, .span = error_span };
         err.as.generic_mismatch.name = ((Slice*)sym->name_rec->key)->ptr;
         err.as.generic_mismatch.expected = expected_count;
         err.as.generic_mismatch.provided = count;
@@ -1998,15 +3061,21 @@ Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol
     }
 
     if (ctx->current_mono_depth > 64) {
-        TypeError err = { .kind = TE_INSTANTIATION_DEPTH, .span = error_span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_INSTANTIATION_DEPTH, .span = error_span };
         err.as.name.name = ((Slice*)sym->name_rec->key)->ptr;
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
+
+    CompilationUnit *unit = module_loader_unit_for_file(ctx->loader, sym->file);
+    Scope *parent_global = sym->module_scope ? sym->module_scope : (unit ? unit->global_scope : scope);
+    if (!check_generic_arg_kinds(ctx, parent_global, func_decl->type_params, func_decl->const_params, arg_types, count, error_span)) {
+        return NULL;
+    }
     
     if (!sym->overloads) {
-        sym->overloads = arena_calloc(ctx->store->arena, sizeof(DynArray));
-        dynarray_init_in_arena(sym->overloads, ctx->store->arena, sizeof(Symbol*), 4);
+        sym->overloads = arena_calloc(ctx->arena, sizeof(DynArray));
+        dynarray_init_in_arena(sym->overloads, ctx->arena, sizeof(Symbol*), 4);
     }
     
     // Generate LLVM mangled name: abs__i32
@@ -2018,7 +3087,8 @@ Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol
         total_len += 2 + type_mangled_len(arg_types[i]);
     }
     
-    char *name_buf = arena_alloc(ctx->store->arena, total_len + 1);
+    ArenaScratch scratch = arena_scratch_begin();
+    char *name_buf = arena_alloc(scratch.arena, total_len + 1);
     char *ptr = name_buf;
     memcpy(ptr, base_slice->ptr, base_len);
     ptr += base_len;
@@ -2032,40 +3102,42 @@ Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol
     
     Slice mangled_slice = { .ptr = name_buf, .len = total_len };
     InternResult *mangled_res = intern(ctx->identifiers, &mangled_slice, NULL);
+    arena_scratch_end(scratch);
+    sema_note_instance(ctx, mangled_res);
     
     // Check cache by mangled name
-    for (size_t i = 0; i < sym->overloads->count; i++) {
-        Symbol *inst = *(Symbol**)dynarray_get(sym->overloads, i);
-        if (inst->name_rec == mangled_res) return inst;
+    DYNARRAY_FOREACH(Symbol*, inst_it, sym->overloads) {
+        Symbol *inst = *inst_it;
+        if (inst->name_rec == mangled_res) {
+            STAT_INC(MONO_CACHE_HITS);
+            return inst;
+        }
     }
+    STAT_INC(MONO_FUNCTIONS);
     
     // The function's parent scope should be the global scope where it was DEFINED!
     // If it's a generic method on a generic struct, sym->module_scope holds the struct's instantiation scope.
-    CompilationUnit *unit = module_loader_get_unit(ctx->loader, sym->filename);
-    Scope *parent_global = sym->module_scope ? sym->module_scope : (unit ? unit->global_scope : scope);
-    
-    AstNode *mono_node = ast_clone_node(decl_node, ctx->store->arena);
+    share_template_body(ctx, decl_node);
+    AstNode *mono_node = ast_clone_node(decl_node, ctx->arena);
     if (!mono_node) return NULL;
     AstFunctionDeclaration *mono_func = &mono_node->data.function_declaration;
     
-    Scope *inst_scope = scope_create(ctx->store->arena, parent_global, count, SCOPE_IDENTIFIERS);
-    for (size_t i = 0; i < count; i++) {
-        InternResult *tp_name = *(InternResult**)dynarray_get(func_decl->type_params, i);
-        define_symbol_or_error(ctx, inst_scope, tp_name, arg_types[i], SYMBOL_VALUE_TYPE, decl_node->span, false, decl_node->filename, NULL);
-    }
+    Scope *inst_scope = scope_create(ctx->arena, parent_global, count, SCOPE_IDENTIFIERS);
+    bind_type_params(ctx, inst_scope, func_decl->type_params, func_decl->const_params, arg_types, count, decl_node->span, decl_node->span.file);
     
     mono_func->intern_result = mangled_res;
     mono_func->type_params = NULL; // No longer generic
     
-    Symbol *inst_sym = arena_calloc(ctx->store->arena, sizeof(Symbol));
+    Symbol *inst_sym = arena_calloc(ctx->arena, sizeof(Symbol));
+    MEM_ACCOUNT(MEM_SYMBOLS, MEM_KIND_NONE, ctx->file, sizeof(Symbol), 1);
     inst_sym->name_rec = mangled_res;
     inst_sym->kind = SYMBOL_VALUE_FUNCTION;
     inst_sym->decl_node = mono_node;
     inst_sym->is_pub = mono_func->is_pub;
-    inst_sym->filename = mono_node->filename;
+    inst_sym->file = mono_node->span.file;
 
-    const char *saved_filename = ctx->filename;
-    ctx->filename = inst_sym->filename;
+    SourceId saved_file = ctx->file;
+    ctx->file = inst_sym->file;
 
     ctx->current_mono_depth++;
 
@@ -2076,16 +3148,28 @@ Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol
     dynarray_push_value(sym->overloads, &inst_sym);
     
     // Register it in the parent module so it gets exported or found
-    define_symbol_or_error(ctx, parent_global, mangled_res, mono_node->type, SYMBOL_VALUE_FUNCTION, mono_node->span, mono_func->is_pub, mono_node->filename, mono_node);
+    define_symbol_or_error(ctx, parent_global, mangled_res, mono_node->type, SYMBOL_VALUE_FUNCTION, mono_node->span, mono_func->is_pub, mono_node->span.file, mono_node);
     
     if (unit && unit->mono_instances) {
         dynarray_push_value(unit->mono_instances, &mono_node);
     }
+    // A method of a generic struct also depends on the struct's arguments,
+    // which only its module scope knows; such instances stay unrecorded.
+    if (!sym->module_scope) record_mono_args(ctx, unit, mono_node, arg_types, count);
     
     check_function(ctx, inst_scope, mono_node);
 
     ctx->current_mono_depth--;
-    ctx->filename = saved_filename;
+    ctx->file = saved_file;
     
     return inst_sym;
-}
\ No newline at end of file
+}
+
+Symbol *instantiate_generic_function(TypeCheckContext *ctx, Scope *scope, Symbol *sym, Type **arg_types, size_t count, Span error_span) {
+    if (!ctx) return NULL;
+    ctx->instance_uses++;
+    sema_exclusive_begin(ctx);
+    Symbol *inst_sym = instantiate_function(ctx, scope, sym, arg_types, count, error_span);
+    sema_exclusive_end(ctx);
+    return inst_sym;
+}
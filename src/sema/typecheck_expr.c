@@ -5,9 +5,11 @@
 #include "sema/symbol_utils.h"
 #include "sema/typecheck.h"
 #include "sema/intrinsics.h"
+#include "sema/type_layout.h"
 #include "parsing/ast.h" 
 #include "datastructures/scope.h"
 #include "core/error.h"
+#include "core/stats.h"
 #include <math.h>
 #include "sema/type.h"
 #include <string.h>
@@ -18,40 +20,30 @@ static Symbol *find_struct_method(TypeCheckContext *ctx, Scope *scope, Type *tar
     if (!target_type || !method_name) return NULL;
     
     Type *underlying = target_type;
+    bool instance = false;
     while (underlying && (underlying->kind == TYPE_POINTER || underlying->kind == TYPE_GENERIC_INST)) {
         if (underlying->kind == TYPE_POINTER) {
             underlying = underlying->as.ptr.base;
         } else {
+            ctx->instance_uses++;
+            instance = true;
             underlying = underlying->as.generic_inst.concrete_type;
         }
     }
     
     if (!underlying || underlying->kind != TYPE_STRUCT) return NULL;
     
-    Symbol *method_sym = (Symbol*)hashmap_get(underlying->as.struct_type.methods, method_name->key, ptr_hash, ptr_cmp);
-    if (method_sym) return method_sym;
+    Symbol *method_sym = (Symbol*)ptrmap_get(underlying->as.struct_type.methods, method_name->key);
+    if (method_sym) {
+        if (instance) sema_note_instance(ctx, method_sym);
+        return method_sym;
+    }
     
     // Lazy Monomorphization Fallback
     Type *gen_inst = target_type;
     while (gen_inst && gen_inst->kind == TYPE_POINTER) gen_inst = gen_inst->as.ptr.base;
     if (gen_inst && gen_inst->kind == TYPE_GENERIC_INST) {
-        Type *base_type = gen_inst->as.generic_inst.base;
-        DynArray *impls = (DynArray*)hashmap_get(ctx->store->impl_registry, (void*)base_type, ptr_hash, ptr_cmp);
-        if (impls) {
-            for (size_t i = 0; i < impls->count; i++) {
-                AstNode *impl_node = *(AstNode**)dynarray_get(impls, i);
-                AstImplDeclaration *impl_decl = &impl_node->data.impl_declaration;
-                if (!impl_decl->methods) continue;
-                for (size_t m = 0; m < impl_decl->methods->count; m++) {
-                    AstNode *method_node = *(AstNode**)dynarray_get(impl_decl->methods, m);
-                    if (method_node->node_type != AST_FUNCTION_DECLARATION) continue;
-                    AstFunctionDeclaration *func = &method_node->data.function_declaration;
-                    if (func->intern_result == method_name) {
-                        return instantiate_generic_method(ctx, scope, gen_inst, method_node);
-                    }
-                }
-            }
-        }
+        return lookup_generic_method(ctx, scope, gen_inst, method_name);
     }
     
     return NULL;
@@ -87,7 +79,7 @@ static void fold_unary_op(AstNode *node, OpKind op, AstNode *operand) {
     }
 }
 
-static void fold_binary_op(AstNode *node, OpKind op, AstNode *l, AstNode *r) {
+static void fold_binary_op(AstNode *node, OpKind op, AstNode *l, AstNode *r, Type *operand_type) {
     if (!l->is_foldable_const || !r->is_foldable_const) return;
 
     LiteralType ltype = l->const_value.type;
@@ -128,19 +120,21 @@ static void fold_binary_op(AstNode *node, OpKind op, AstNode *l, AstNode *r) {
         int64_t v2 = r->const_value.value.int_val;
         int64_t res = 0;
         bool is_bool = false;
+        uint64_t u1 = (uint64_t)v1, u2 = (uint64_t)v2;
+        bool is_unsigned = operand_type && type_is_unsigned(operand_type);
 
         switch (op) {
             case OP_ADD: res = v1 + v2; break;
             case OP_SUB: res = v1 - v2; break;
             case OP_MUL: res = v1 * v2; break;
-            case OP_DIV: if(v2==0) return; res = v1 / v2; break;
-            case OP_MOD: if(v2==0) return; res = v1 % v2; break;
+            case OP_DIV: if(v2==0) return; res = is_unsigned ? (int64_t)(u1 / u2) : v1 / v2; break;
+            case OP_MOD: if(v2==0) return; res = is_unsigned ? (int64_t)(u1 % u2) : v1 % v2; break;
             case OP_EQ:  res = (v1 == v2); is_bool = true; break;
             case OP_NEQ: res = (v1 != v2); is_bool = true; break;
-            case OP_LT:  res = (v1 < v2);  is_bool = true; break;
-            case OP_GT:  res = (v1 > v2);  is_bool = true; break;
-            case OP_LE:  res = (v1 <= v2); is_bool = true; break;
-            case OP_GE:  res = (v1 >= v2); is_bool = true; break;
+            case OP_LT:  res = is_unsigned ? (u1 < u2)  : (v1 < v2);  is_bool = true; break;
+            case OP_GT:  res = is_unsigned ? (u1 > u2)  : (v1 > v2);  is_bool = true; break;
+            case OP_LE:  res = is_unsigned ? (u1 <= u2) : (v1 <= v2); is_bool = true; break;
+            case OP_GE:  res = is_unsigned ? (u1 >= u2) : (v1 >= v2); is_bool = true; break;
             case OP_AND: res = (v1 && v2); is_bool = true; break;
             case OP_OR:  res = (v1 || v2); is_bool = true; break;
             default: return;
@@ -231,6 +225,22 @@ static Scope* get_module_scope(Scope *scope) {
     return scope;
 }
 
+static Type *async_error(TypeCheckContext *ctx, Span span, const char *reason) {
+    TypeError err = { .kind = TE_INVALID_ASYNC, .span = span, .as.name.name = reason };
+    dynarray_push_value(ctx->errors, &err);
+    return NULL;
+}
+
+/* The async fn declaration a checked call calls, or NULL. */
+static AstNode *called_async_function(AstNode *call) {
+    AstNode *callee = call->data.call_expr.callee;
+    Symbol *sym = callee->node_type == AST_IDENTIFIER ? callee->data.identifier.symbol
+                : callee->node_type == AST_MEMBER_EXPR ? callee->data.member_expr.symbol : NULL;
+    AstNode *decl = sym ? sym->decl_node : NULL;
+    if (!decl || decl->node_type != AST_FUNCTION_DECLARATION) return NULL;
+    return (decl->data.function_declaration.attrs & FN_ATTR_ASYNC) ? decl : NULL;
+}
+
 /**
  * Resolves an identifier to its symbol and determines its type and constancy.
  * 
@@ -252,7 +262,7 @@ Type* check_identifier(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
     // -------------------------------------------------------------------------
     // 1. SYMBOL LOOKUP
     // -------------------------------------------------------------------------
-    Symbol *sym = scope_lookup_symbol(scope, ident->intern_result, ctx->filename);
+    Symbol *sym = scope_lookup_symbol(scope, ident->intern_result, ctx->file);
 
     if (!sym) {
         const char *name = (ident->intern_result && ident->intern_result->key) 
@@ -262,7 +272,6 @@ Type* check_identifier(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
         TypeError err = { 
             .kind = TE_UNDECLARED, 
             .span = expr->span, 
-            .filename = ctx->filename, 
             .as.name.name = name 
         };
         dynarray_push_value(ctx->errors, &err);
@@ -272,6 +281,12 @@ Type* check_identifier(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
     // Store resolved symbol for later stages (Codegen/Sema)
     ident->symbol = sym; 
 
+    // Its frame is only made by await and @spawn, so there is no function pointer to take
+    AstNode *decl = sym->decl_node;
+    if (decl && decl->node_type == AST_FUNCTION_DECLARATION && (decl->data.function_declaration.attrs & FN_ATTR_ASYNC)) {
+        return async_error(ctx, expr->span, "an async fn cannot be used as a value");
+    }
+
     // -------------------------------------------------------------------------
     // 2. DEMAND-DRIVEN GLOBAL RESOLUTION
     // -------------------------------------------------------------------------
@@ -331,21 +346,61 @@ Type* check_identifier(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
 }
 
 
+/*
+ * Overload resolution only looks at the canonical argument types, so the
+ * winner for a set and an argument tuple is remembered. The key is the words
+ * {set, instance call, candidate count, arg types...}; the count keeps sets
+ * that gain instances later from reusing a stale answer.
+ */
+typedef struct {
+    size_t hash;
+    size_t count;
+    void *words[];
+} OverloadKey;
+
+#define OVERLOAD_KEY_FIXED 3
+
+static size_t overload_key_hash(void *key) {
+    return ((OverloadKey*)key)->hash;
+}
+
+static int overload_key_cmp(void *a, void *b) {
+    OverloadKey *ka = a, *kb = b;
+    if (ka->count != kb->count) return 1;
+    return memcmp(ka->words, kb->words, ka->count * sizeof(void*));
+}
+
+static OverloadKey *overload_key_make(Arena *arena, Symbol *set, Type **arg_types, size_t arg_count, bool is_instance_method) {
+    size_t count = OVERLOAD_KEY_FIXED + arg_count;
+    OverloadKey *key = arena_alloc(arena, sizeof(OverloadKey) + count * sizeof(void*));
+    key->count = count;
+    key->words[0] = set;
+    key->words[1] = (void*)(uintptr_t)is_instance_method;
+    key->words[2] = (void*)(uintptr_t)set->overloads->count;
+    if (arg_count) memcpy(&key->words[OVERLOAD_KEY_FIXED], arg_types, arg_count * sizeof(Type*));
+    key->hash = hash_bytes(key->words, count * sizeof(void*));
+    return key;
+}
+
 /**
  * Validates a function call expression, checking arguments against parameters.
  */
-static Symbol* resolve_overload_candidate(TypeCheckContext *ctx, AstNode *expr, Symbol *callee_sym, Type **arg_types, size_t arg_count, bool is_instance_method) {
+static Symbol* score_overload_candidates(TypeCheckContext *ctx, AstNode *expr, Symbol *callee_sym, Type **arg_types, size_t arg_count, bool is_instance_method) {
     size_t n_cands = callee_sym->overloads->count;
     size_t alloc_cands = n_cands ? n_cands : 1;
-    Symbol **viable = arena_alloc(ctx->store->arena, sizeof(Symbol*) * alloc_cands);
-    int **mk = arena_alloc(ctx->store->arena, sizeof(int*) * alloc_cands);
+    STAT_INC(OVERLOAD_RESOLUTIONS);
+    STAT_ADD(OVERLOAD_CANDIDATES, n_cands);
+    // Candidate bookkeeping is dropped once the winner is known
+    ArenaScratch scratch = arena_scratch_begin();
+    Symbol **viable = arena_alloc(scratch.arena, sizeof(Symbol*) * alloc_cands);
+    int **mk = arena_alloc(scratch.arena, sizeof(int*) * alloc_cands);
     size_t n_viable = 0;
 
     size_t stride = arg_count ? arg_count : 1;
-    int *all_kinds = arena_alloc(ctx->store->arena, sizeof(int) * stride * alloc_cands);
+    int *all_kinds = arena_alloc(scratch.arena, sizeof(int) * stride * alloc_cands);
 
     for (size_t oi = 0; oi < n_cands; oi++) {
-        Symbol *cand = *(Symbol**)dynarray_get(callee_sym->overloads, oi);
+        Symbol *cand = DYNARRAY_AT(Symbol*, callee_sym->overloads, oi);
         Type *ft = cand->type;
         if (!ft || ft->kind != TYPE_FUNCTION) continue;
         
@@ -381,14 +436,15 @@ static Symbol* resolve_overload_candidate(TypeCheckContext *ctx, AstNode *expr,
     }
 
     if (n_viable == 0) {
-        TypeError err = { .kind = TE_NO_MATCHING_OVERLOAD, .span = expr->span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_NO_MATCHING_OVERLOAD, .span = expr->span };
         err.as.name.name = ((Slice*)callee_sym->name_rec->key)->ptr;
         dynarray_push_value(ctx->errors, &err);
+        arena_scratch_end(scratch);
         return NULL;
     }
 
     // Pass 3: Dominance Filter
-    bool *dominated = arena_alloc(ctx->store->arena, sizeof(bool) * n_viable);
+    bool *dominated = arena_alloc(scratch.arena, sizeof(bool) * n_viable);
     memset(dominated, 0, sizeof(bool) * n_viable);
 
     for (size_t a = 0; a < n_viable; a++) {
@@ -412,8 +468,10 @@ static Symbol* resolve_overload_candidate(TypeCheckContext *ctx, AstNode *expr,
         }
     }
 
+    arena_scratch_end(scratch);
+
     if (n_best > 1) {
-        TypeError err = { .kind = TE_AMBIGUOUS_OVERLOAD, .span = expr->span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_AMBIGUOUS_OVERLOAD, .span = expr->span };
         err.as.name.name = ((Slice*)callee_sym->name_rec->key)->ptr;
         dynarray_push_value(ctx->errors, &err);
         return NULL;
@@ -422,6 +480,23 @@ static Symbol* resolve_overload_candidate(TypeCheckContext *ctx, AstNode *expr,
     return best;
 }
 
+static Symbol* resolve_overload_candidate(TypeCheckContext *ctx, AstNode *expr, Symbol *callee_sym, Type **arg_types, size_t arg_count, bool is_instance_method) {
+    ArenaScratch scratch = arena_scratch_begin();
+    OverloadKey *probe = overload_key_make(scratch.arena, callee_sym, arg_types, arg_count, is_instance_method);
+    Symbol *best = ctx->overload_cache
+        ? hashmap_get_hashed(ctx->overload_cache, probe, probe->hash, overload_key_cmp) : NULL;
+    arena_scratch_end(scratch);
+    if (best) return best;
+
+    // Failures are not cached: each call site reports its own error
+    best = score_overload_candidates(ctx, expr, callee_sym, arg_types, arg_count, is_instance_method);
+    if (!best) return NULL;
+    if (!ctx->overload_cache) ctx->overload_cache = hashmap_create(ctx->arena, 64);
+    OverloadKey *key = overload_key_make(ctx->arena, callee_sym, arg_types, arg_count, is_instance_method);
+    hashmap_put_hashed(ctx->overload_cache, key, best, key->hash, overload_key_hash, overload_key_cmp);
+    return best;
+}
+
 static Type* substitute_type_args(TypeStore *ts, Type *t, Type **inferred, size_t count) {
     if (!t || !inferred) return t;
     switch (t->kind) {
@@ -445,6 +520,11 @@ static Type* substitute_type_args(TypeStore *ts, Type *t, Type **inferred, size_
             if (b == t->as.slice.base) return t;
             return make_slice_type(ts, b);
         }
+        case TYPE_VECTOR: {
+            Type *b = substitute_type_args(ts, t->as.vector.base, inferred, count);
+            if (b == t->as.vector.base) return t;
+            return make_vector_type(ts, b, t->as.vector.lanes);
+        }
         default: return t;
     }
 }
@@ -456,6 +536,7 @@ static bool contains_typevar(Type *t) {
         case TYPE_POINTER: return contains_typevar(t->as.ptr.base);
         case TYPE_ARRAY:   return contains_typevar(t->as.array.base);
         case TYPE_SLICE:   return contains_typevar(t->as.slice.base);
+        case TYPE_VECTOR:  return contains_typevar(t->as.vector.base);
         case TYPE_FUNCTION: {
             if (contains_typevar(t->as.func.return_type)) return true;
             for (size_t i = 0; i < t->as.func.param_count; i++) {
@@ -486,13 +567,13 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
     // 1. INTRINSIC DISPATCH
     // =========================================================================
     if (callee_base->node_type == AST_IDENTIFIER) {
-        Symbol *sym = scope_lookup_symbol(scope, callee_base->data.identifier.intern_result, ctx->filename);
+        Symbol *sym = scope_lookup_symbol(scope, callee_base->data.identifier.intern_result, ctx->file);
         if (sym && sym->kind == SYMBOL_VALUE_INTRINSIC) {
             expr->type = ctx->store->t_void; 
             
             size_t arg_count = call->args ? call->args->count : 0;
             for (size_t i = 0; i < arg_count; i++) {
-                AstNode *arg = *(AstNode**)dynarray_get(call->args, i);
+                AstNode *arg = DYNARRAY_AT(AstNode*, call->args, i);
                 check_expression(ctx, scope, arg, NULL);
             }
 
@@ -513,7 +594,7 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
     bool    is_instance_method = false;
 
     if (callee_base->node_type == AST_IDENTIFIER) {
-        callee_sym = scope_lookup_symbol(scope, callee_base->data.identifier.intern_result, ctx->filename);
+        callee_sym = scope_lookup_symbol(scope, callee_base->data.identifier.intern_result, ctx->file);
     } else if (callee_base->node_type == AST_MEMBER_EXPR) {
         AstMemberExpr *mem = &callee_base->data.member_expr;
         Type *target_type = check_expression(ctx, scope, mem->target, NULL);
@@ -545,9 +626,9 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
         // size_t n_cands = callee_sym->overloads->count; // unused
 
         // Pass 1: Type-check args
-        Type **arg_types = arena_alloc(ctx->store->arena, sizeof(Type*) * (arg_count ? arg_count : 1));
+        Type **arg_types = arena_alloc(ctx->arena, sizeof(Type*) * (arg_count ? arg_count : 1));
         for (size_t i = 0; i < arg_count; i++) {
-            AstNode *arg = *(AstNode**)dynarray_get(call->args, i);
+            AstNode *arg = DYNARRAY_AT(AstNode*, call->args, i);
             arg_types[i] = check_expression(ctx, scope, arg, NULL);
             if (!arg_types[i]) return NULL;
         }
@@ -559,7 +640,7 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
         if (call->callee->node_type == AST_GENERIC_INST_EXPR) {
             if (callee_sym->kind != SYMBOL_GENERIC_FUNCTION && callee_sym->kind != SYMBOL_GENERIC_STRUCT) {
                 printf("DEBUG: callee_sym->kind = %d, name = %s\n", callee_sym->kind, ((Slice*)callee_sym->name_rec->key)->ptr);
-                TypeError err = { .kind = TE_NOT_GENERIC, .span = call->callee->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_NOT_GENERIC, .span = call->callee->span };
                 err.as.name.name = ((Slice*)callee_sym->name_rec->key)->ptr;
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
@@ -573,22 +654,23 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
                     if (decl_node && decl_node->node_type == AST_FUNCTION_DECLARATION) {
                         AstFunctionDeclaration *fdecl = &decl_node->data.function_declaration;
                         size_t type_param_count = fdecl->type_params ? fdecl->type_params->count : 0;
-                        if (type_param_count > 0) {
-                            Scope *temp_scope = scope_create(ctx->store->arena, scope, type_param_count, SCOPE_IDENTIFIERS);
+                        // A const parameter appears in no argument type it could be inferred from
+                        if (type_param_count > 0 && !fdecl->const_params) {
+                            Scope *temp_scope = scope_create(ctx->arena, scope, type_param_count, SCOPE_IDENTIFIERS);
                             for (size_t i = 0; i < type_param_count; i++) {
-                                InternResult *tp_name = *(InternResult**)dynarray_get(fdecl->type_params, i);
+                                InternResult *tp_name = DYNARRAY_AT(InternResult*, fdecl->type_params, i);
                                 Type *tvar = make_typevar_type(ctx->store, tp_name, (int)i);
-                                define_symbol_or_error(ctx, temp_scope, tp_name, tvar, SYMBOL_VALUE_TYPE, expr->span, false, ctx->filename, NULL);
+                                define_symbol_or_error(ctx, temp_scope, tp_name, tvar, SYMBOL_VALUE_TYPE, expr->span, false, ctx->file, NULL);
                             }
 
                             size_t param_count = fdecl->params ? fdecl->params->count : 0;
-                            Type **expected_params = arena_alloc(ctx->store->arena, sizeof(Type*) * param_count);
+                            Type **expected_params = arena_alloc(ctx->arena, sizeof(Type*) * param_count);
                             for (size_t i = 0; i < param_count; i++) {
-                                AstNode *param_node = *(AstNode**)dynarray_get(fdecl->params, i);
+                                AstNode *param_node = DYNARRAY_AT(AstNode*, fdecl->params, i);
                                 expected_params[i] = resolve_ast_type(ctx, temp_scope, param_node->data.param.type);
                             }
 
-                            Type **inferred = arena_alloc(ctx->store->arena, sizeof(Type*) * type_param_count);
+                            Type **inferred = arena_alloc(ctx->arena, sizeof(Type*) * type_param_count);
                             memset(inferred, 0, sizeof(Type*) * type_param_count);
                             bool inference_ok = true;
                             
@@ -597,11 +679,11 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
                                 infer_type_args(expected_return, expected_type, inferred, type_param_count);
                             }
 
-                            Type **provided_args = arena_alloc(ctx->store->arena, sizeof(Type*) * (arg_count ? arg_count : 1));
+                            Type **provided_args = arena_alloc(ctx->arena, sizeof(Type*) * (arg_count ? arg_count : 1));
                             size_t p_idx = is_instance_method ? 1 : 0;
                             
                             for (size_t i = 0; i < arg_count; i++) {
-                                AstNode *arg = *(AstNode**)dynarray_get(call->args, i);
+                                AstNode *arg = DYNARRAY_AT(AstNode*, call->args, i);
                                 Type *arg_expected = NULL;
                                 if (p_idx + i < param_count) {
                                     arg_expected = expected_params[p_idx + i];
@@ -633,7 +715,7 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
                         }
                     }
                 }
-                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_MISSING_TYPE_ARGS, .span = expr->span };
                 err.as.name.name = ((Slice*)callee_sym->name_rec->key)->ptr;
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
@@ -642,10 +724,10 @@ Type* check_call_expr(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
                 size_t count = inst->type_args ? inst->type_args->count : 0;
                 Type **arg_types = NULL;
                 if (count > 0) {
-                    arg_types = arena_alloc(ctx->store->arena, sizeof(Type*) * count);
+                    arg_types = arena_alloc(ctx->arena, sizeof(Type*) * count);
                     for (size_t i = 0; i < count; i++) {
-                        AstNode *arg_node = *(AstNode**)dynarray_get(inst->type_args, i);
-                        arg_types[i] = resolve_ast_type(ctx, scope, arg_node);
+                        AstNode *arg_node = DYNARRAY_AT(AstNode*, inst->type_args, i);
+                        arg_types[i] = resolve_generic_arg(ctx, scope, arg_node);
                         if (!arg_types[i]) return NULL;
                     }
                 }
@@ -663,7 +745,7 @@ inference_success:;
     if (!callee_type) return NULL;
 
     if (callee_type->kind != TYPE_FUNCTION) {
-        TypeError err = { .kind = TE_NOT_CALLABLE, .span = call->callee->span, .filename = ctx->filename, .as.bad_usage.actual = callee_type };
+        TypeError err = { .kind = TE_NOT_CALLABLE, .span = call->callee->span, .as.bad_usage.actual = callee_type };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
@@ -679,6 +761,9 @@ inference_success:;
     if (call->callee != callee_base) {
         call->callee->type = callee_type;
     }
+    if (!(expr->flags & AST_FLAG_ASYNC_CALL) && called_async_function(expr)) {
+        return async_error(ctx, expr->span, "an async fn is only called by await or @spawn");
+    }
 
     // =========================================================================
     // 3. METHOD SELF INJECTION
@@ -696,7 +781,7 @@ inference_success:;
 
                 // Auto-ref: target is S, param is *S
                 if (target_type->kind != TYPE_POINTER && first_param_type->kind == TYPE_POINTER) {
-                    AstNode *ref = ast_create_node(AST_UNARY_EXPR, ctx->store->arena, ctx->filename);
+                    AstNode *ref = ast_create_node(AST_UNARY_EXPR, ctx->arena, ctx->file);
                     ref->span = self_arg->span;
                     ref->data.unary_expr.op = OP_ADDRESS;
                     ref->data.unary_expr.expr = self_arg;
@@ -708,7 +793,7 @@ inference_success:;
                 }
                 // Auto-deref: target is *S, param is S
                 else if (target_type->kind == TYPE_POINTER && first_param_type->kind != TYPE_POINTER) {
-                    AstNode *deref = ast_create_node(AST_UNARY_EXPR, ctx->store->arena, ctx->filename);
+                    AstNode *deref = ast_create_node(AST_UNARY_EXPR, ctx->arena, ctx->file);
                     deref->span = self_arg->span;
                     deref->data.unary_expr.op = OP_DEREF;
                     deref->data.unary_expr.expr = self_arg;
@@ -717,8 +802,8 @@ inference_success:;
                 }
 
                 if (!call->args) {
-                    call->args = arena_alloc(ctx->store->arena, sizeof(DynArray));
-                    dynarray_init_in_arena(call->args, ctx->store->arena, sizeof(AstNode*), 2);
+                    call->args = arena_alloc(ctx->arena, sizeof(DynArray));
+                    dynarray_init_in_arena(call->args, ctx->arena, sizeof(AstNode*), 2);
                 }
                 
                 dynarray_push_ptr(call->args, NULL);
@@ -740,13 +825,13 @@ inference_success:;
     size_t actual_arg_count = call->args ? call->args->count : 0;
 
     if (actual_arg_count != param_count) {
-        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.arg_count = { .expected = param_count, .actual = actual_arg_count } };
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = expr->span, .as.arg_count = { .expected = param_count, .actual = actual_arg_count } };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
 
     for (size_t i = 0; i < actual_arg_count; i++) {
-        AstNode *arg = *(AstNode**)dynarray_get(call->args, i);
+        AstNode *arg = DYNARRAY_AT(AstNode*, call->args, i);
         Type *param_type = callee_type->as.func.params[i];
         
         // Re-check expression with the specific parameter type hint to ensure correct promotion (e.g. literals)
@@ -793,11 +878,11 @@ Type* check_subscript(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
     if (!base_type) return NULL; // Error already logged by check_expression
 
     // Ensure the resolved target type is actually indexable.
-    if (base_type->kind != TYPE_ARRAY && base_type->kind != TYPE_SLICE && base_type->kind != TYPE_POINTER) {
+    if (base_type->kind != TYPE_ARRAY && base_type->kind != TYPE_SLICE && base_type->kind != TYPE_POINTER &&
+        base_type->kind != TYPE_VECTOR) {
         TypeError err = { 
             .kind = TE_NOT_INDEXABLE, 
             .span = subscript->target->span, 
-            .filename = ctx->filename, 
             .as.bad_usage.actual = base_type 
         };
         dynarray_push_value(ctx->errors, &err);
@@ -819,8 +904,8 @@ Type* check_subscript(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
     // =========================================================================
     // 4. BOUNDS CHECKING & RETURN TYPE DETERMINATION
     // =========================================================================
-    // Compile-time bounds checking for fixed-size arrays.
-    if (base_type->kind == TYPE_ARRAY) {
+    // Compile-time bounds checking for fixed-size arrays and vector lanes.
+    if (base_type->kind == TYPE_ARRAY || base_type->kind == TYPE_VECTOR) {
         // Determine if the index is a constant expression we can evaluate right now.
         bool is_const = subscript->index->is_foldable_const;
         
@@ -831,14 +916,13 @@ Type* check_subscript(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
         
         if (is_const) {
             int64_t idx = subscript->index->const_value.value.int_val;
-            int64_t limit = base_type->as.array.size;
+            int64_t limit = base_type->kind == TYPE_ARRAY ? base_type->as.array.size : base_type->as.vector.lanes;
 
             // If the literal index is negative or exceeds the known array size, emit an error.
             if (idx < 0 || idx >= limit) {
                 TypeError err = { 
                     .kind = TE_INDEX_OUT_OF_BOUNDS, 
                     .span = subscript->index->span, 
-                    .filename = ctx->filename, 
                     .as.size = { .expected_size = (size_t)limit, .actual_size = (size_t)idx } 
                 };
                 dynarray_push_value(ctx->errors, &err);
@@ -850,6 +934,7 @@ Type* check_subscript(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *
     // Return the underlying element type depending on the specific collection type.
     return (base_type->kind == TYPE_ARRAY) ? base_type->as.array.base : 
            (base_type->kind == TYPE_SLICE) ? base_type->as.slice.base :
+           (base_type->kind == TYPE_VECTOR) ? base_type->as.vector.base :
            base_type->as.ptr.base;
 }
 
@@ -871,7 +956,7 @@ Type* check_assignment(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
     // 2. L-VALUE VALIDATION
     // =========================================================================
     if (!is_lvalue_node(assign->lvalue)) {
-        TypeError err = { .kind = TE_NOT_LVALUE, .span = assign->lvalue->span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_NOT_LVALUE, .span = assign->lvalue->span };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
@@ -882,9 +967,16 @@ Type* check_assignment(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
     // 3. OPERATOR & TYPE CONSISTENCY
     // =========================================================================
     if (assign->op != OP_ASSIGN) {
-        // Compound assignments (+=, -=, etc.) require numeric types.
+        // Compound assignments (+=, -=, etc.) require numeric types; a vector takes a vector or a lane
+        if (type_is_vector(lhs) && type_is_numeric(lhs->as.vector.base)) {
+            Type *lane = lhs->as.vector.base;
+            if (!type_is_vector(rhs)) rhs = check_expression(ctx, scope, assign->rvalue, lane);
+            if (!rhs || (rhs != lhs && !coerce_or_error(ctx, assign->rvalue, type_is_vector(rhs) ? lhs : lane))) return NULL;
+            expr->type = lhs;
+            return lhs;
+        }
         if (!type_is_numeric(lhs) || !type_is_numeric(rhs)) {
-            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.binop = { .op = assign->op, .left = lhs, .right = rhs } };
+            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = assign->op, .left = lhs, .right = rhs } };
             dynarray_push_value(ctx->errors, &err);
             return NULL;
         }
@@ -922,10 +1014,46 @@ static int get_type_rank(Type *t) {
 static int get_initializer_rank(AstNode *node) {
     if (!node || node->node_type != AST_INITIALIZER_LIST) return 0;
     if (node->data.initializer_list.elements->count == 0) return 1;
-    AstNode *first = *(AstNode**)dynarray_get(node->data.initializer_list.elements, 0);
+    AstNode *first = DYNARRAY_AT(AstNode*, node->data.initializer_list.elements, 0);
     return 1 + get_initializer_rank(first);
 }
 
+static Type *vector_error(TypeCheckContext *ctx, Span span, const char *what) {
+    TypeError err = { .kind = TE_INVALID_VECTOR, .span = span, .as.name.name = what };
+    dynarray_push_value(ctx->errors, &err);
+    return NULL;
+}
+
+/* `{a, b, c, d}` for a vec<T, 4>: one element per lane, each coerced to T. */
+static Type *check_vector_initializer(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *vec_type) {
+    DynArray *elements = expr->data.initializer_list.elements;
+    size_t count = elements ? elements->count : 0;
+    if (count != (size_t)vec_type->as.vector.lanes) {
+        TypeError err = {
+            .kind = TE_ARRAY_SIZE_MISMATCH,
+            .span = expr->span,
+            .as.size = { .expected_size = (size_t)vec_type->as.vector.lanes, .actual_size = count }
+        };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+
+    Type *lane = vec_type->as.vector.base;
+    bool all_llvm_const = true;
+    for (size_t i = 0; i < count; i++) {
+        AstNode *node = DYNARRAY_AT(AstNode*, elements, i);
+        Type *actual = check_expression(ctx, scope, node, lane);
+        if (!actual) return NULL;
+        if (actual != lane && !coerce_or_error(ctx, node, lane)) return NULL;
+        if (!node->is_llvm_const_safe) all_llvm_const = false;
+    }
+
+    expr->is_foldable_const = 0;
+    expr->is_llvm_const_safe = all_llvm_const ? 1 : 0;
+    expr->type = vec_type;
+    return vec_type;
+}
+
 /**
  * Validates an initializer list, ensuring all elements have compatible types
  * and verifying array/slice structural dimensions (ranks).
@@ -953,12 +1081,13 @@ Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
         if (!expected_type) return NULL;
     }
 
+    if (expected_type->kind == TYPE_VECTOR) return check_vector_initializer(ctx, scope, expr, expected_type);
+
     // 2. Structural Mismatch (Array vs Scalar)
     if (expected_type->kind != TYPE_ARRAY && expected_type->kind != TYPE_SLICE) {
          TypeError err = {
             .kind = TE_UNEXPECTED_LIST,
             .span = expr->span,
-            .filename = ctx->filename,
             .as.mismatch = { .expected = expected_type, .actual = NULL } 
         };
         dynarray_push_value(ctx->errors, &err);
@@ -973,7 +1102,6 @@ Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
         TypeError err = {
             .kind = TE_DIMENSION_MISMATCH,
             .span = expr->span,
-            .filename = ctx->filename,
             .as.dims = { .expected_ndim = type_rank, .actual_ndim = init_rank }
         };
         dynarray_push_value(ctx->errors, &err);
@@ -986,7 +1114,6 @@ Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
              TypeError err = {
                 .kind = TE_ARRAY_SIZE_MISMATCH,
                 .span = expr->span,
-                .filename = ctx->filename,
                 .as.size = { .expected_size = expected_type->as.array.size, .actual_size = elem_count }
             };
             dynarray_push_value(ctx->errors, &err);
@@ -1016,7 +1143,6 @@ Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
              TypeError err = {
                 .kind = TE_EXPECTED_ARRAY,
                 .span = node->span,
-                .filename = ctx->filename,
                 .as.mismatch = { .expected = base_expected, .actual = actual_elem_type }
             };
             dynarray_push_value(ctx->errors, &err);
@@ -1028,7 +1154,6 @@ Type* check_initializer_list(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
              TypeError err = {
                 .kind = TE_TYPE_MISMATCH,
                 .span = node->span,
-                .filename = ctx->filename,
                 .as.mismatch = { .expected = base_expected, .actual = actual_elem_type }
             };
             dynarray_push_value(ctx->errors, &err);
@@ -1092,7 +1217,7 @@ static Type* check_struct_literal(TypeCheckContext *ctx, Scope *scope, AstNode *
 
     if (!struct_type || struct_type->kind != TYPE_STRUCT) {
         const char *name_str = "<unknown>";
-        TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = expr->span, .filename = ctx->filename, .as.name.name = name_str };
+        TypeError err = { .kind = TE_UNKNOWN_TYPE, .span = expr->span, .as.name.name = name_str };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
@@ -1102,7 +1227,7 @@ static Type* check_struct_literal(TypeCheckContext *ctx, Scope *scope, AstNode *
     size_t lit_field_count = lit->fields ? lit->fields->count : 0;
 
     if (lit_field_count != defined_field_count) {
-        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.arg_count = { .expected = defined_field_count, .actual = lit_field_count } };
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = expr->span, .as.arg_count = { .expected = defined_field_count, .actual = lit_field_count } };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
@@ -1114,11 +1239,11 @@ static Type* check_struct_literal(TypeCheckContext *ctx, Scope *scope, AstNode *
         AstFieldInit *init = (AstFieldInit*)dynarray_get(lit->fields, i);
         
         // O(1) Lookup
-        void *field_idx_ptr = hashmap_get(struct_type->as.struct_type.field_map, init->name->key, ptr_hash, ptr_cmp);
+        void *field_idx_ptr = ptrmap_get(struct_type->as.struct_type.field_map, init->name->key);
         if (!field_idx_ptr) {
             const char *name_str = "<unknown>";
             if (init->name && init->name->key) name_str = ((Slice*)init->name->key)->ptr;
-            TypeError err = { .kind = TE_FIELD_ACCESS, .span = init->expr->span, .filename = ctx->filename, .as.name.name = name_str };
+            TypeError err = { .kind = TE_FIELD_ACCESS, .span = init->expr->span, .as.name.name = name_str };
             dynarray_push_value(ctx->errors, &err);
             return NULL;
         }
@@ -1153,14 +1278,14 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
     if (t->kind == TYPE_POINTER) t = t->as.ptr.base;
 
     if (t->kind != TYPE_STRUCT) {
-        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename };
+        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span };
         err.as.name.name = "Allocator argument must be a struct type";
         dynarray_push_value(ctx->errors, &err);
         return;
     }
 
     if (t->as.struct_type.field_count != 3) {
-        TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span, .filename = ctx->filename, 
+        TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span, 
                           .as.name.name = "Allocator struct must have exactly 3 fields: ctx, _alloc, _free" };
         dynarray_push_value(ctx->errors, &err);
         return;
@@ -1170,14 +1295,14 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
     for (int i = 0; i < 3; i++) {
         StructField *field = &t->as.struct_type.fields[i];
         if (!field->name || !field->name->key) {
-             TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span, .filename = ctx->filename,
+             TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span,
                               .as.name.name = "Allocator struct fields must have names" };
             dynarray_push_value(ctx->errors, &err);
             return;
         }
         Slice *field_name = (Slice*)field->name->key;
         if (strncmp(field_name->ptr, expected_fields[i], field_name->len) != 0 || expected_fields[i][field_name->len] != '\0') {
-            TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span, .filename = ctx->filename,
+            TypeError err = { .kind = TE_ALLOCATOR_SHAPE_INVALID, .span = alloc_arg->span,
                               .as.name.name = "Allocator struct fields must be named: ctx, _alloc, _free" };
             dynarray_push_value(ctx->errors, &err);
             return;
@@ -1189,13 +1314,13 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
     StructField *free_field = &t->as.struct_type.fields[2];
 
     if (!ctx_field->type || ctx_field->type->kind != TYPE_POINTER) {
-        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename, 
+        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, 
                           .as.name.name = "field 'ctx' must be a pointer" };
         dynarray_push_value(ctx->errors, &err);
     }
     
     if (!alloc_field->type || alloc_field->type->kind != TYPE_FUNCTION) {
-        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename, 
+        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, 
                           .as.name.name = "field '_alloc' must be a function" };
         dynarray_push_value(ctx->errors, &err);
     } else {
@@ -1204,14 +1329,14 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
             fn_ty->as.func.params[0]->kind != TYPE_POINTER ||
             (fn_ty->as.func.params[1]->kind != TYPE_PRIMITIVE || fn_ty->as.func.params[1]->as.primitive != PRIM_USIZE) ||
             fn_ty->as.func.return_type->kind != TYPE_POINTER) {
-            TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename, 
+            TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, 
                               .as.name.name = "field '_alloc' must have signature: fn(ptr, usize) -> ptr" };
             dynarray_push_value(ctx->errors, &err);
         }
     }
 
     if (!free_field->type || free_field->type->kind != TYPE_FUNCTION) {
-        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename, 
+        TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, 
                           .as.name.name = "field '_free' must be a function" };
         dynarray_push_value(ctx->errors, &err);
     } else {
@@ -1220,7 +1345,7 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
             fn_ty->as.func.params[0]->kind != TYPE_POINTER ||
             fn_ty->as.func.params[1]->kind != TYPE_POINTER ||
             !type_is_void(fn_ty->as.func.return_type)) {
-            TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, .filename = ctx->filename, 
+            TypeError err = { .kind = TE_INVALID_ALLOCATOR, .span = alloc_arg->span, 
                               .as.name.name = "field '_free' must have signature: fn(ptr, ptr) -> void" };
             dynarray_push_value(ctx->errors, &err);
         }
@@ -1231,23 +1356,592 @@ static void validate_allocator_structure(TypeCheckContext *ctx, AstNode *alloc_a
  * Validates compiler intrinsics (e.g. @alloc, @free), performing custom 
  * type checking logic per-intrinsic since they often bypass normal rules.
  */
+/* A vector operand: `hint` is passed down so `{...}` literals can take its type. */
+static Type *check_vector_operand(TypeCheckContext *ctx, Scope *scope, AstNode *node, Type *hint) {
+    Type *t = check_expression(ctx, scope, node, type_is_vector(hint) ? hint : NULL);
+    if (!t) return NULL;
+    if (!type_is_vector(t)) return vector_error(ctx, node->span, "expected a vector operand");
+    return t;
+}
+
+/* A scalar coerced to `lane`, re-checked so literals take the lane type. */
+static bool check_lane_operand(TypeCheckContext *ctx, Scope *scope, AstNode *node, Type *lane) {
+    Type *t = check_expression(ctx, scope, node, lane);
+    return t && (t == lane || coerce_or_error(ctx, node, lane));
+}
+
+/* The memory @load reads and @store writes: an array, slice or pointer of `lane`, indexed by a usize. */
+static bool check_lane_memory(TypeCheckContext *ctx, Scope *scope, AstNode *mem, AstNode *index, Type *vec) {
+    Type *mem_type = check_expression(ctx, scope, mem, NULL);
+    if (!mem_type || !check_lane_operand(ctx, scope, index, ctx->store->t_usize)) return false;
+
+    Type *lane = vec->as.vector.base;
+    Type *elem = mem_type->kind == TYPE_ARRAY   ? mem_type->as.array.base :
+                 mem_type->kind == TYPE_SLICE   ? mem_type->as.slice.base :
+                 mem_type->kind == TYPE_POINTER ? mem_type->as.ptr.base : NULL;
+    if (elem != lane) {
+        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = mem->span, .as.mismatch = { .expected = make_slice_type(ctx->store, lane), .actual = mem_type } };
+        dynarray_push_value(ctx->errors, &err);
+        return false;
+    }
+    if (mem_type->kind == TYPE_ARRAY && !is_lvalue_node(mem)) {
+        TypeError err = { .kind = TE_NOT_LVALUE, .span = mem->span };
+        dynarray_push_value(ctx->errors, &err);
+        return false;
+    }
+    if (mem_type->kind == TYPE_ARRAY && index->is_foldable_const) {
+        int64_t first = index->const_value.value.int_val;
+        int64_t size = mem_type->as.array.size;
+        if (first < 0 || first > size - vec->as.vector.lanes) {
+            TypeError err = { .kind = TE_INDEX_OUT_OF_BOUNDS, .span = index->span, .as.size = { .expected_size = (size_t)size, .actual_size = (size_t)(first + vec->as.vector.lanes - 1) } };
+            dynarray_push_value(ctx->errors, &err);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* @shuffle's last argument: constant lane indices below `limit`, one per result lane. */
+static Type *check_shuffle_mask(TypeCheckContext *ctx, Scope *scope, AstNode *mask, Type *lane, int64_t limit) {
+    if (mask->node_type != AST_INITIALIZER_LIST || !mask->data.initializer_list.elements ||
+        mask->data.initializer_list.elements->count == 0 ||
+        mask->data.initializer_list.elements->count > VECTOR_MAX_LANES) {
+        return vector_error(ctx, mask->span, "@shuffle takes a list of lane indices");
+    }
+    DynArray *indices = mask->data.initializer_list.elements;
+    DYNARRAY_FOREACH(AstNode*, idx_it, indices) {
+        AstNode *idx = *idx_it;
+        Type *t = check_expression(ctx, scope, idx, ctx->store->t_i32);
+        if (!t) return NULL;
+        if (!type_is_integer(t) || !idx->is_foldable_const) return vector_error(ctx, idx->span, "shuffle indices must be integer constants");
+        int64_t v = idx->const_value.value.int_val;
+        if (v < 0 || v >= limit) {
+            TypeError err = { .kind = TE_INDEX_OUT_OF_BOUNDS, .span = idx->span, .as.size = { .expected_size = (size_t)limit, .actual_size = (size_t)v } };
+            dynarray_push_value(ctx->errors, &err);
+            return NULL;
+        }
+    }
+    mask->type = make_array_type(ctx->store, ctx->store->t_i32, (int64_t)indices->count);
+    return make_vector_type(ctx->store, lane, (int64_t)indices->count);
+}
+
+static Type *check_vector_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node, Type *expected_type) {
+    IntrinsicKind kind = node->data.intrinsic.kind;
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+
+    size_t min_args = 1, max_args = 1;
+    switch (kind) {
+        case INTRINSIC_SPLAT:   min_args = max_args = 2; break;
+        case INTRINSIC_LOAD:
+        case INTRINSIC_STORE:
+        case INTRINSIC_SELECT:  min_args = max_args = 3; break;
+        case INTRINSIC_SHUFFLE: min_args = 2; max_args = 3; break;
+        default: break;
+    }
+    if (arg_count < min_args || arg_count > max_args) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = min_args, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    AstNode *a0 = DYNARRAY_AT(AstNode*, args, 0);
+    AstNode *a1 = arg_count > 1 ? DYNARRAY_AT(AstNode*, args, 1) : NULL;
+    AstNode *a2 = arg_count > 2 ? DYNARRAY_AT(AstNode*, args, 2) : NULL;
+
+    switch (kind) {
+        case INTRINSIC_SPLAT:
+        case INTRINSIC_LOAD: {
+            Type *vec = resolve_ast_type(ctx, scope, a0);
+            if (!vec) return NULL;
+            a0->type = vec;
+            if (!type_is_vector(vec)) return vector_error(ctx, a0->span, "the first argument must be a vector type");
+            bool ok = kind == INTRINSIC_SPLAT ? check_lane_operand(ctx, scope, a1, vec->as.vector.base)
+                                              : check_lane_memory(ctx, scope, a1, a2, vec);
+            return ok ? vec : NULL;
+        }
+
+        case INTRINSIC_STORE: {
+            Type *vec = check_vector_operand(ctx, scope, a2, NULL);
+            if (!vec || !check_lane_memory(ctx, scope, a0, a1, vec)) return NULL;
+            return ctx->store->t_void;
+        }
+
+        case INTRINSIC_SHUFFLE: {
+            Type *vec = check_vector_operand(ctx, scope, a0, NULL);
+            if (!vec) return NULL;
+            int64_t limit = vec->as.vector.lanes;
+            if (a2) {
+                Type *other = check_vector_operand(ctx, scope, a1, vec);
+                if (!other) return NULL;
+                if (other != vec) {
+                    TypeError err = { .kind = TE_TYPE_MISMATCH, .span = a1->span, .as.mismatch = { .expected = vec, .actual = other } };
+                    dynarray_push_value(ctx->errors, &err);
+                    return NULL;
+                }
+                limit *= 2;
+            }
+            return check_shuffle_mask(ctx, scope, a2 ? a2 : a1, vec->as.vector.base, limit);
+        }
+
+        case INTRINSIC_SELECT: {
+            Type *mask = check_vector_operand(ctx, scope, a0, NULL);
+            if (!mask) return NULL;
+            if (!type_is_mask(mask)) return vector_error(ctx, a0->span, "@select takes a vec<bool, N> mask");
+            Type *vec = check_vector_operand(ctx, scope, a1, expected_type);
+            if (!vec) return NULL;
+            Type *other = check_vector_operand(ctx, scope, a2, vec);
+            if (!other) return NULL;
+            if (other != vec) {
+                TypeError err = { .kind = TE_TYPE_MISMATCH, .span = a2->span, .as.mismatch = { .expected = vec, .actual = other } };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            if (vec->as.vector.lanes != mask->as.vector.lanes) return vector_error(ctx, node->span, "mask and operands have different lane counts");
+            return vec;
+        }
+
+        case INTRINSIC_ANY:
+        case INTRINSIC_ALL: {
+            Type *mask = check_vector_operand(ctx, scope, a0, NULL);
+            if (!mask) return NULL;
+            if (!type_is_mask(mask)) return vector_error(ctx, a0->span, "@any and @all take a vec<bool, N> mask");
+            return ctx->store->t_bool;
+        }
+
+        default: { // Reductions
+            Type *vec = check_vector_operand(ctx, scope, a0, NULL);
+            if (!vec) return NULL;
+            if (!type_is_numeric(vec->as.vector.base)) return vector_error(ctx, a0->span, "reductions need integer or float lanes");
+            return vec->as.vector.base;
+        }
+    }
+}
+
+static Type *atomic_error(TypeCheckContext *ctx, Span span, const char *what) {
+    TypeError err = { .kind = TE_INVALID_ATOMIC, .span = span, .as.name.name = what };
+    dynarray_push_value(ctx->errors, &err);
+    return NULL;
+}
+
+/* The bare name an ordering or @atomic_rmw operation is written as, NULL if the argument is anything else. */
+static Slice *atomic_name_arg(AstNode *arg) {
+    if (!arg || arg->node_type != AST_IDENTIFIER || !arg->data.identifier.intern_result) return NULL;
+    return (Slice*)arg->data.identifier.intern_result->key;
+}
+
+static bool check_atomic_order(TypeCheckContext *ctx, AstNode *arg, AtomicOrder *out) {
+    Slice *name = atomic_name_arg(arg);
+    AtomicOrder order = name ? atomic_order_named(name->ptr, name->len) : ATOMIC_ORDER_INVALID;
+    if (order == ATOMIC_ORDER_INVALID) {
+        atomic_error(ctx, arg->span, "expected an ordering: relaxed, acquire, release, acq_rel or seq_cst");
+        return false;
+    }
+    *out = order;
+    return true;
+}
+
+/* The `*T` operand: T must fit one atomic machine access, so an integer, bool, char or pointer. */
+static Type *check_atomic_pointer(TypeCheckContext *ctx, Scope *scope, AstNode *ptr) {
+    Type *t = check_expression(ctx, scope, ptr, NULL);
+    if (!t) return NULL;
+    if (t->kind != TYPE_POINTER) return atomic_error(ctx, ptr->span, "expected a pointer to the atomic variable");
+    Type *base = t->as.ptr.base;
+    if (!type_is_integer(base) && !type_is_bool(base) && !type_is_char(base) && (!base || base->kind != TYPE_POINTER)) {
+        return atomic_error(ctx, ptr->span, "atomics need an integer, bool, char or pointer variable");
+    }
+    return base;
+}
+
+/*
+ * Orderings and the @atomic_rmw operation are bare names, never resolved as
+ * identifiers. Loads cannot release and stores cannot acquire; the failure
+ * ordering of @atomic_cas is a load, and defaults to the strongest one its
+ * success ordering allows.
+ */
+static Type *check_atomic_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
+    IntrinsicKind kind = node->data.intrinsic.kind;
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+
+    size_t min_args = 1, max_args = 1;
+    switch (kind) {
+        case INTRINSIC_ATOMIC_LOAD:  min_args = max_args = 2; break;
+        case INTRINSIC_ATOMIC_STORE: min_args = max_args = 3; break;
+        case INTRINSIC_ATOMIC_CAS:   min_args = 4; max_args = 5; break;
+        case INTRINSIC_ATOMIC_RMW:   min_args = max_args = 4; break;
+        default: break;
+    }
+    if (arg_count < min_args || arg_count > max_args) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = min_args, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    AstNode *a[5] = { NULL };
+    for (size_t i = 0; i < arg_count; i++) a[i] = DYNARRAY_AT(AstNode*, args, i);
+
+    AtomicOrder order, failure;
+    switch (kind) {
+        case INTRINSIC_ATOMIC_LOAD: {
+            Type *t = check_atomic_pointer(ctx, scope, a[0]);
+            if (!t || !check_atomic_order(ctx, a[1], &order)) return NULL;
+            if (order == ATOMIC_RELEASE || order == ATOMIC_ACQ_REL) return atomic_error(ctx, a[1]->span, "a load cannot be release or acq_rel");
+            return t;
+        }
+
+        case INTRINSIC_ATOMIC_STORE: {
+            Type *t = check_atomic_pointer(ctx, scope, a[0]);
+            if (!t || !check_lane_operand(ctx, scope, a[1], t) || !check_atomic_order(ctx, a[2], &order)) return NULL;
+            if (order == ATOMIC_ACQUIRE || order == ATOMIC_ACQ_REL) return atomic_error(ctx, a[2]->span, "a store cannot be acquire or acq_rel");
+            return ctx->store->t_void;
+        }
+
+        case INTRINSIC_ATOMIC_CAS: {
+            Type *t = check_atomic_pointer(ctx, scope, a[0]);
+            if (!t || !check_lane_operand(ctx, scope, a[1], t) || !check_lane_operand(ctx, scope, a[2], t)) return NULL;
+            if (!check_atomic_order(ctx, a[3], &order)) return NULL;
+            if (arg_count == 5) {
+                if (!check_atomic_order(ctx, a[4], &failure)) return NULL;
+                if (failure == ATOMIC_RELEASE || failure == ATOMIC_ACQ_REL) return atomic_error(ctx, a[4]->span, "the failure ordering cannot be release or acq_rel");
+            }
+            return t;
+        }
+
+        case INTRINSIC_ATOMIC_RMW: {
+            Slice *name = atomic_name_arg(a[0]);
+            AtomicRmwOp op = name ? atomic_rmw_op_named(name->ptr, name->len) : ATOMIC_RMW_INVALID;
+            if (op == ATOMIC_RMW_INVALID) return atomic_error(ctx, a[0]->span, "expected an operation: xchg, add, sub, and, or, xor, min or max");
+            Type *t = check_atomic_pointer(ctx, scope, a[1]);
+            if (!t) return NULL;
+            if (op != ATOMIC_RMW_XCHG && !type_is_integer(t)) return atomic_error(ctx, a[1]->span, "only xchg works on a bool, char or pointer");
+            if (!check_lane_operand(ctx, scope, a[2], t) || !check_atomic_order(ctx, a[3], &order)) return NULL;
+            return t;
+        }
+
+        default: // @fence
+            if (!check_atomic_order(ctx, a[0], &order)) return NULL;
+            if (order == ATOMIC_RELAXED) return atomic_error(ctx, a[0]->span, "a fence cannot be relaxed");
+            return ctx->store->t_void;
+    }
+}
+
+/* A @memcpy/@memmove/@memset operand: a T[N], T[] or *T, yielding T (void for a *void, counted in bytes). */
+static Type *check_bulk_operand(TypeCheckContext *ctx, Scope *scope, AstNode *mem) {
+    Type *t = check_expression(ctx, scope, mem, NULL);
+    if (!t) return NULL;
+    if (t->kind == TYPE_ARRAY) return t->as.array.base;
+    if (t->kind == TYPE_SLICE) return t->as.slice.base;
+    if (t->kind == TYPE_POINTER) return t->as.ptr.base;
+    TypeError err = { .kind = TE_TYPE_MISMATCH, .span = mem->span, .as.mismatch = { .expected = ctx->store->t_void_ptr, .actual = t } };
+    dynarray_push_value(ctx->errors, &err);
+    return NULL;
+}
+
+static Type *check_bulk_memory_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+    if (arg_count != 3) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = 3, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    AstNode *dst = DYNARRAY_AT(AstNode*, args, 0);
+    AstNode *src = DYNARRAY_AT(AstNode*, args, 1);
+    AstNode *count = DYNARRAY_AT(AstNode*, args, 2);
+
+    Type *elem = check_bulk_operand(ctx, scope, dst);
+    if (!elem) return NULL;
+    if (node->data.intrinsic.kind == INTRINSIC_MEMSET) {
+        if (!check_lane_operand(ctx, scope, src, ctx->store->t_u8)) return NULL;
+    } else {
+        Type *src_elem = check_bulk_operand(ctx, scope, src);
+        if (!src_elem) return NULL;
+        if (src_elem != elem) {
+            // Both sides count in the same elements
+            TypeError err = { .kind = TE_TYPE_MISMATCH, .span = src->span, .as.mismatch = { .expected = dst->type, .actual = src->type } };
+            dynarray_push_value(ctx->errors, &err);
+            return NULL;
+        }
+    }
+    if (!check_lane_operand(ctx, scope, count, ctx->store->t_usize)) return NULL;
+    return ctx->store->t_void;
+}
+
+/*
+ * @likely and @unlikely yield their bool operand; @assume, @prefetch and
+ * @unreachable are void. @prefetch reads or writes nothing: its memory
+ * operand is any T[N], T[] or *T, then a bare `read` or `write`, then a
+ * locality from 0 (use once) to 3 (keep in every cache level).
+ */
+static Type *check_hint_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node) {
+    IntrinsicKind kind = node->data.intrinsic.kind;
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+    size_t expected = kind == INTRINSIC_PREFETCH ? 3 : kind == INTRINSIC_UNREACHABLE ? 0 : 1;
+    if (arg_count != expected) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = expected, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+
+    switch (kind) {
+        case INTRINSIC_LIKELY:
+        case INTRINSIC_UNLIKELY:
+        case INTRINSIC_ASSUME:
+            if (!check_lane_operand(ctx, scope, DYNARRAY_AT(AstNode*, args, 0), ctx->store->t_bool)) return NULL;
+            return kind == INTRINSIC_ASSUME ? ctx->store->t_void : ctx->store->t_bool;
+
+        case INTRINSIC_PREFETCH: {
+            if (!check_bulk_operand(ctx, scope, DYNARRAY_AT(AstNode*, args, 0))) return NULL;
+            Slice *rw = atomic_name_arg(DYNARRAY_AT(AstNode*, args, 1));
+            if (!rw || !((rw->len == 4 && memcmp(rw->ptr, "read", 4) == 0) || (rw->len == 5 && memcmp(rw->ptr, "write", 5) == 0))) {
+                TypeError err = { .kind = TE_INVALID_HINT, .span = DYNARRAY_AT(AstNode*, args, 1)->span, .as.name.name = "expected read or write" };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            AstNode *locality = DYNARRAY_AT(AstNode*, args, 2);
+            Type *t = check_expression(ctx, scope, locality, ctx->store->t_i32);
+            if (!t) return NULL;
+            if (!type_is_integer(t) || !locality->is_foldable_const ||
+                locality->const_value.value.int_val < 0 || locality->const_value.value.int_val > 3) {
+                TypeError err = { .kind = TE_INVALID_HINT, .span = locality->span, .as.name.name = "the locality must be a constant from 0 to 3" };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            return ctx->store->t_void;
+        }
+
+        default: // @unreachable
+            return ctx->store->t_void;
+    }
+}
+
+/*
+ * The operands of a math intrinsic share one type, which is the result: a
+ * float or a vector of floats, or for @abs, @min and @max an integer or
+ * vector of integers. A literal takes the type of the other operands.
+ */
+static Type *check_math_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node, Type *expected_type) {
+    IntrinsicKind kind = node->data.intrinsic.kind;
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+    size_t expected = intrinsic_math_arity(kind);
+    if (arg_count != expected) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = expected, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+
+    // The first operand that is not a literal (or a negated one) gives the type
+    size_t lead = 0;
+    while (lead + 1 < arg_count) {
+        AstNode *a = DYNARRAY_AT(AstNode*, args, lead);
+        if (a->node_type == AST_UNARY_EXPR && a->data.unary_expr.op == OP_SUB) a = a->data.unary_expr.expr;
+        if (a->node_type != AST_LITERAL) break;
+        lead++;
+    }
+    AstNode *lead_arg = DYNARRAY_AT(AstNode*, args, lead);
+    Type *t = check_expression(ctx, scope, lead_arg, expected_type);
+    if (!t) return NULL;
+
+    Type *lane = t->kind == TYPE_VECTOR ? t->as.vector.base : t;
+    bool int_ok = kind == INTRINSIC_ABS || kind == INTRINSIC_MIN || kind == INTRINSIC_MAX;
+    if (!type_is_float(lane) && !(int_ok && type_is_integer(lane))) {
+        TypeError err = { .kind = TE_TYPE_MISMATCH, .span = lead_arg->span, .as.mismatch = { .expected = ctx->store->t_f64, .actual = t } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    for (size_t i = 0; i < arg_count; i++) {
+        if (i != lead && !check_lane_operand(ctx, scope, DYNARRAY_AT(AstNode*, args, i), t)) return NULL;
+    }
+    return t;
+}
+
+static Type *tail_call_error(TypeCheckContext *ctx, Span span, const char *reason) {
+    TypeError err = { .kind = TE_INVALID_TAIL_CALL, .span = span, .as.name.name = reason };
+    dynarray_push_value(ctx->errors, &err);
+    return NULL;
+}
+
+/* True if `node` names storage in the frame of the function being checked. */
+static bool is_frame_storage(Scope *scope, AstNode *node) {
+    switch (node->node_type) {
+        case AST_IDENTIFIER: {
+            Symbol *sym = node->data.identifier.symbol;
+            if (!sym || sym->kind != SYMBOL_VARIABLE) return false;
+            Scope *module_scope = get_module_scope(scope);
+            return !module_scope || scope_lookup_symbol_local(module_scope, sym->name_rec) != sym;
+        }
+        case AST_MEMBER_EXPR: {
+            AstNode *target = node->data.member_expr.target;
+            return target->type && target->type->kind != TYPE_POINTER && is_frame_storage(scope, target);
+        }
+        case AST_SUBSCRIPT_EXPR: {
+            AstNode *target = node->data.subscript_expr.target;
+            return target->type && target->type->kind == TYPE_ARRAY && is_frame_storage(scope, target);
+        }
+        default:
+            return false;
+    }
+}
+
+/* True if the argument is the address of a local or parameter, or a slice of a local array. */
+static bool points_into_frame(Scope *scope, AstNode *arg) {
+    if (arg->node_type == AST_CAST) {
+        AstNode *inner = arg->data.cast_expr.expr;
+        if (inner->type && inner->type->kind == TYPE_ARRAY) return is_frame_storage(scope, inner);
+        return points_into_frame(scope, inner);
+    }
+    if (arg->node_type == AST_UNARY_EXPR && arg->data.unary_expr.op == OP_ADDRESS) {
+        return is_frame_storage(scope, arg->data.unary_expr.expr);
+    }
+    return false;
+}
+
+/* Passed and returned without a copy in the caller's memory on every target ABI. */
+static bool travels_in_registers(Type *t) {
+    int64_t size;
+    int32_t align;
+    if (t->kind == TYPE_VOID) return true;
+    return t->kind != TYPE_ARRAY && type_layout(t, &size, &align) && size <= 16;
+}
+
+/*
+ * `return @tail(f(args))`: the call replaces the caller's frame. f has the
+ * caller's exact signature, no defer is pending and no argument points into
+ * the frame being given up. A call back into the caller itself becomes a
+ * jump to its entry (AST_FLAG_SELF_TAIL_CALL); any other callee must take
+ * and return only values that fit in registers, so no copy outlives the frame.
+ */
+Type *check_tail_call(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *return_type) {
+    DynArray *args = expr->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+    if (arg_count != 1) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = expr->span, .as.arg_count = { .expected = 1, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    AstNode *call = DYNARRAY_AT(AstNode*, args, 0);
+    if (call->node_type != AST_CALL_EXPR) return tail_call_error(ctx, call->span, "the operand of @tail must be a call");
+    if (ctx->current_function && (ctx->current_function->data.function_declaration.attrs & FN_ATTR_ASYNC)) {
+        return tail_call_error(ctx, expr->span, "an async fn has no stack frame to reuse");
+    }
+
+    Type *result = check_expression(ctx, scope, call, return_type);
+    if (!result) return NULL;
+    expr->type = result;
+
+    AstNode *caller = ctx->current_function;
+    Type *callee_type = call->data.call_expr.callee->type;
+    if (callee_type && callee_type->kind == TYPE_POINTER) callee_type = callee_type->as.ptr.base;
+    if (!caller || !callee_type || callee_type != caller->type) {
+        return tail_call_error(ctx, call->span, "the callee must have the same signature as the calling function");
+    }
+    if (ctx->live_defers > 0) return tail_call_error(ctx, expr->span, "a deferred statement would have to run after the call");
+    DYNARRAY_FOREACH(AstNode*, arg_it, call->data.call_expr.args) {
+        if (points_into_frame(scope, *arg_it)) {
+            return tail_call_error(ctx, (*arg_it)->span, "an argument points into the frame the call replaces");
+        }
+    }
+
+    AstNode *callee = call->data.call_expr.callee;
+    if (callee->node_type == AST_GENERIC_INST_EXPR) callee = callee->data.generic_inst_expr.base;
+    Symbol *sym = callee->node_type == AST_IDENTIFIER ? callee->data.identifier.symbol
+                : callee->node_type == AST_MEMBER_EXPR ? callee->data.member_expr.symbol : NULL;
+    if (sym && sym->decl_node == caller) {
+        caller->flags |= AST_FLAG_SELF_TAIL_CALL;
+        return result;
+    }
+    if (!travels_in_registers(callee_type->as.func.return_type)) {
+        return tail_call_error(ctx, call->span, "a call to another function must return at most 16 bytes, and no array");
+    }
+    for (size_t i = 0; i < callee_type->as.func.param_count; i++) {
+        if (!travels_in_registers(callee_type->as.func.params[i])) {
+            return tail_call_error(ctx, call->span, "a call to another function must pass only arguments of at most 16 bytes, and no arrays");
+        }
+    }
+    return result;
+}
+
+/* The operand of `await` or @spawn: a direct call of an async fn, yielding its result type. */
+static Type *check_async_call(TypeCheckContext *ctx, Scope *scope, AstNode *call, Type *expected_type) {
+    if (call->node_type != AST_CALL_EXPR) return async_error(ctx, call->span, "the operand must be a call of an async fn");
+    call->flags |= AST_FLAG_ASYNC_CALL;
+    Type *result = check_expression(ctx, scope, call, expected_type);
+    if (!result) return NULL;
+    if (!called_async_function(call)) return async_error(ctx, call->span, "the operand must be a call of an async fn");
+    return result;
+}
+
+/*
+ * `await f(args)`, @suspend() and @frame() belong to the body of an async fn;
+ * @spawn, @resume, @done and @destroy drive frames from anywhere. A frame is
+ * an opaque *void; see docs/lang/async.md.
+ */
+static Type *check_async_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *node, Type *expected_type) {
+    IntrinsicKind kind = node->data.intrinsic.kind;
+    DynArray *args = node->data.intrinsic.args;
+    size_t arg_count = args ? args->count : 0;
+    size_t expected_count = kind == INTRINSIC_SPAWN ? 2 : (kind == INTRINSIC_SUSPEND || kind == INTRINSIC_FRAME) ? 0 : 1;
+    if (arg_count != expected_count) {
+        TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .as.arg_count = { .expected = expected_count, .actual = arg_count } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+
+    bool in_async = ctx->current_function && (ctx->current_function->data.function_declaration.attrs & FN_ATTR_ASYNC);
+    switch (kind) {
+        case INTRINSIC_AWAIT:
+            if (!in_async) return async_error(ctx, node->span, "await is only allowed inside an async fn");
+            return check_async_call(ctx, scope, DYNARRAY_AT(AstNode*, args, 0), expected_type);
+        case INTRINSIC_SUSPEND:
+        case INTRINSIC_FRAME:
+            if (!in_async) return async_error(ctx, node->span, "@suspend and @frame are only allowed inside an async fn");
+            return kind == INTRINSIC_FRAME ? ctx->store->t_void_ptr : ctx->store->t_void;
+        case INTRINSIC_SPAWN: {
+            AstNode *alloc_arg = DYNARRAY_AT(AstNode*, args, 0);
+            validate_allocator_structure(ctx, alloc_arg, check_expression(ctx, scope, alloc_arg, NULL));
+            if (!check_async_call(ctx, scope, DYNARRAY_AT(AstNode*, args, 1), NULL)) return NULL;
+            return ctx->store->t_void_ptr;
+        }
+        default: { // @resume, @done, @destroy
+            AstNode *frame = DYNARRAY_AT(AstNode*, args, 0);
+            Type *t = check_expression(ctx, scope, frame, ctx->store->t_void_ptr);
+            if (!t) return NULL;
+            if (t != ctx->store->t_void_ptr) {
+                TypeError err = { .kind = TE_TYPE_MISMATCH, .span = frame->span, .as.mismatch = { .expected = ctx->store->t_void_ptr, .actual = t } };
+                dynarray_push_value(ctx->errors, &err);
+                return NULL;
+            }
+            return kind == INTRINSIC_DONE ? ctx->store->t_bool : ctx->store->t_void;
+        }
+    }
+}
+
 static Type *check_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expected_type) {
     AstNode *node = expr;
     IntrinsicKind kind = node->data.intrinsic.kind;
     size_t arg_count = node->data.intrinsic.args ? node->data.intrinsic.args->count : 0;
 
+    if (kind >= INTRINSIC_SPLAT && kind <= INTRINSIC_ALL) return check_vector_intrinsic(ctx, scope, node, expected_type);
+    if (intrinsic_is_atomic(kind)) return check_atomic_intrinsic(ctx, scope, node);
+    if (intrinsic_is_bulk_memory(kind)) return check_bulk_memory_intrinsic(ctx, scope, node);
+    if (intrinsic_is_hint(kind)) return check_hint_intrinsic(ctx, scope, node);
+    if (intrinsic_is_math(kind)) return check_math_intrinsic(ctx, scope, node, expected_type);
+    if (kind == INTRINSIC_TAIL) return tail_call_error(ctx, node->span, "@tail may only be the whole operand of a return");
+    if (intrinsic_is_async(kind)) return check_async_intrinsic(ctx, scope, node, expected_type);
+
     if (kind == INTRINSIC_ALLOC) {
         if (arg_count < 2 || arg_count > 3) {
-            TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span };
             err.as.arg_count.expected = 2; // expects 2 or 3, simplified
             err.as.arg_count.actual = arg_count;
             dynarray_push_value(ctx->errors, &err);
             return ctx->store->t_void_ptr;
         }
 
-        AstNode *type_arg = *(AstNode**)dynarray_get(node->data.intrinsic.args, 0);
-        AstNode *alloc_arg = *(AstNode**)dynarray_get(node->data.intrinsic.args, 1);
-        AstNode *count_arg = arg_count == 3 ? *(AstNode**)dynarray_get(node->data.intrinsic.args, 2) : NULL;
+        AstNode *type_arg = DYNARRAY_AT(AstNode*, node->data.intrinsic.args, 0);
+        AstNode *alloc_arg = DYNARRAY_AT(AstNode*, node->data.intrinsic.args, 1);
+        AstNode *count_arg = arg_count == 3 ? DYNARRAY_AT(AstNode*, node->data.intrinsic.args, 2) : NULL;
 
         // 1. Arg 0: Must be a type
         Type *allocated_type = resolve_ast_type(ctx, scope, type_arg);
@@ -1258,7 +1952,7 @@ static Type *check_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
             // It couldn't be resolved as a type. Let's see what it evaluates to as an expression
             // to provide a better error message.
             Type *actual = check_expression(ctx, scope, type_arg, NULL);
-            TypeError err = { .kind = TE_EXPECTED_TYPE_ARG, .span = type_arg->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_EXPECTED_TYPE_ARG, .span = type_arg->span };
             err.as.mismatch.expected = NULL;
             err.as.mismatch.actual = actual;
             dynarray_push_value(ctx->errors, &err);
@@ -1272,7 +1966,7 @@ static Type *check_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
         if (count_arg) {
             Type *count_ty = check_expression(ctx, scope, count_arg, ctx->store->t_usize);
             if (count_ty && !type_is_integer(count_ty)) {
-                TypeError err = { .kind = TE_TYPE_MISMATCH, .span = count_arg->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_TYPE_MISMATCH, .span = count_arg->span };
                 err.as.mismatch.expected = ctx->store->t_usize;
                 err.as.mismatch.actual = count_ty;
                 dynarray_push_value(ctx->errors, &err);
@@ -1295,15 +1989,15 @@ static Type *check_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
     } 
     else if (kind == INTRINSIC_FREE) {
         if (arg_count != 2) {
-            TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_ARG_COUNT_MISMATCH, .span = node->span };
             err.as.arg_count.expected = 2;
             err.as.arg_count.actual = arg_count;
             dynarray_push_value(ctx->errors, &err);
             return ctx->store->t_void;
         }
         
-        AstNode *alloc_arg = *(AstNode**)dynarray_get(node->data.intrinsic.args, 0);
-        AstNode *ptr_arg = *(AstNode**)dynarray_get(node->data.intrinsic.args, 1);
+        AstNode *alloc_arg = DYNARRAY_AT(AstNode*, node->data.intrinsic.args, 0);
+        AstNode *ptr_arg = DYNARRAY_AT(AstNode*, node->data.intrinsic.args, 1);
 
         // 1. Arg 0: Must be an allocator struct
         Type *alloc_ty = check_expression(ctx, scope, alloc_arg, NULL);
@@ -1312,7 +2006,7 @@ static Type *check_intrinsic(TypeCheckContext *ctx, Scope *scope, AstNode *expr,
         // 2. Arg 1: Must be a pointer or slice
         Type *ptr_ty = check_expression(ctx, scope, ptr_arg, NULL);
         if (ptr_ty && ptr_ty->kind != TYPE_POINTER && ptr_ty->kind != TYPE_SLICE) {
-            TypeError err = { .kind = TE_TYPE_MISMATCH, .span = ptr_arg->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_TYPE_MISMATCH, .span = ptr_arg->span };
             err.as.mismatch.expected = ctx->store->t_void_ptr; 
             err.as.mismatch.actual = ptr_ty;
             dynarray_push_value(ctx->errors, &err);
@@ -1343,14 +2037,28 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
     if (unary->op == OP_NOT && expected_type == ctx->store->t_bool) {
         hint = expected_type;
     }
+    if ((unary->op == OP_SUB || unary->op == OP_NOT) && type_is_vector(expected_type)) {
+        hint = expected_type;
+    }
 
     Type *operand_type = check_expression(ctx, scope, unary->expr, hint);
     if (!operand_type) return NULL;
 
+    // Lane-wise: negation of numeric vectors, `!` of masks
+    if (type_is_vector(operand_type) && (unary->op == OP_SUB || unary->op == OP_NOT)) {
+        bool ok = unary->op == OP_SUB ? type_is_numeric(operand_type->as.vector.base) : type_is_mask(operand_type);
+        if (!ok) {
+            TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .as.unop = { .op = unary->op, .operand = operand_type } };
+            dynarray_push_value(ctx->errors, &err);
+            return NULL;
+        }
+        return operand_type;
+    }
+
     switch (unary->op) {
         case OP_NOT: 
             if (operand_type != ctx->store->t_bool) { 
-                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.unop = { .op = unary->op, .operand = operand_type } };
+                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .as.unop = { .op = unary->op, .operand = operand_type } };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL; 
             }
@@ -1358,7 +2066,7 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
             return ctx->store->t_bool;
         case OP_SUB: 
             if (!type_is_numeric(operand_type)) { 
-                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.unop = { .op = unary->op, .operand = operand_type } };
+                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .as.unop = { .op = unary->op, .operand = operand_type } };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL; 
             }
@@ -1366,7 +2074,7 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
             return operand_type;
         case OP_ADDRESS: 
             if (!is_lvalue_node(unary->expr)) { 
-                TypeError err = { .kind = TE_NOT_LVALUE, .span = unary->expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_NOT_LVALUE, .span = unary->expr->span };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL; 
             }
@@ -1377,12 +2085,12 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
             }
         case OP_DEREF: 
             if (operand_type->kind != TYPE_POINTER) { 
-                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.unop = { .op = unary->op, .operand = operand_type } };
+                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .as.unop = { .op = unary->op, .operand = operand_type } };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL; 
             }
             if (type_is_void(operand_type->as.ptr.base)) {
-                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.unop = { .op = unary->op, .operand = operand_type } };
+                TypeError err = { .kind = TE_UNOP_MISMATCH, .span = expr->span, .as.unop = { .op = unary->op, .operand = operand_type } };
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
             }
@@ -1391,6 +2099,54 @@ Type* check_unary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *expe
     }
 }
 
+/*
+ * Lane-wise binary operations. One side may be a scalar of the lane type,
+ * which is broadcast; comparisons give a vec<bool, N> mask.
+ */
+static Type *check_vector_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *lhs, Type *rhs) {
+    AstBinaryExpr *bin = &expr->data.binary_expr;
+    OpKind op = bin->op;
+    Type *vec = type_is_vector(lhs) ? lhs : rhs;
+    Type *lane = vec->as.vector.base;
+
+    if (!type_is_vector(lhs) || !type_is_vector(rhs)) {
+        AstNode *scalar = type_is_vector(lhs) ? bin->right : bin->left;
+        if (!check_lane_operand(ctx, scope, scalar, lane)) return NULL;
+    } else if (lhs != rhs) {
+        TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+
+    bool ok;
+    Type *result = vec;
+    switch (op) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            ok = type_is_numeric(lane);
+            break;
+        case OP_LT: case OP_GT: case OP_LE: case OP_GE:
+            ok = type_is_numeric(lane);
+            result = make_vector_type(ctx->store, ctx->store->t_bool, vec->as.vector.lanes);
+            break;
+        case OP_EQ: case OP_NEQ:
+            ok = true;
+            result = make_vector_type(ctx->store, ctx->store->t_bool, vec->as.vector.lanes);
+            break;
+        case OP_AND: case OP_OR:
+            ok = type_is_bool(lane);
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    if (!ok) {
+        TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+        dynarray_push_value(ctx->errors, &err);
+        return NULL;
+    }
+    return result;
+}
+
 /**
  * Validates binary operations (x + y, x == y, x && y), enforcing strict
  * type consistency and applying literal inference.
@@ -1400,7 +2156,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     OpKind op = bin->op;
 
     Type *lhs_hint = NULL;
-    if (expected_type && type_is_numeric(expected_type)) {
+    if (expected_type && (type_is_numeric(expected_type) || type_is_vector(expected_type))) {
         if (op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_MOD) {
             lhs_hint = expected_type;
         }
@@ -1409,7 +2165,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     Type *lhs = check_expression(ctx, scope, bin->left, lhs_hint);
 
     Type *rhs_hint = NULL;
-    if (lhs && type_is_numeric(lhs)) {
+    if (lhs && (type_is_numeric(lhs) || type_is_vector(lhs))) {
         rhs_hint = lhs;
     } else if (expected_type && type_is_numeric(expected_type) && lhs_hint) {
         rhs_hint = expected_type;
@@ -1418,6 +2174,8 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     Type *rhs = check_expression(ctx, scope, bin->right, rhs_hint);
     if (!lhs || !rhs) return NULL;
 
+    if (type_is_vector(lhs) || type_is_vector(rhs)) return check_vector_binary(ctx, scope, expr, lhs, rhs);
+
     // 1. Literal Inference: If one side is a literal, try to adapt it to the other side's type
     if (bin->left->node_type == AST_LITERAL && lhs != rhs) {
          lhs = check_expression(ctx, scope, bin->left, rhs);
@@ -1428,7 +2186,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
 
     // 2. STRICTOR RULES: Operands must match exactly after inference
     if (lhs != rhs) {
-        TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+        TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
         dynarray_push_value(ctx->errors, &err);
         return NULL;
     }
@@ -1437,7 +2195,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
 
     if (op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_MOD) {
         if (!type_is_numeric(lhs)) { 
-            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
             dynarray_push_value(ctx->errors, &err);
             return NULL; 
         }
@@ -1446,7 +2204,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     else if (op == OP_EQ || op == OP_NEQ || op == OP_LT || op == OP_GT || op == OP_LE || op == OP_GE) {
         // Disallow struct/array equality for now
         if (lhs->kind != TYPE_PRIMITIVE && lhs->kind != TYPE_POINTER && lhs->kind != TYPE_ENUM) {
-             TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+             TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
              dynarray_push_value(ctx->errors, &err);
              return NULL;
         }
@@ -1454,7 +2212,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     }
     else if (op == OP_AND || op == OP_OR) {
         if (lhs != ctx->store->t_bool) { 
-            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .filename = ctx->filename, .as.binop = { .op = op, .left = lhs, .right = rhs } };
+            TypeError err = { .kind = TE_BINOP_MISMATCH, .span = expr->span, .as.binop = { .op = op, .left = lhs, .right = rhs } };
             dynarray_push_value(ctx->errors, &err);
             return NULL; 
         }
@@ -1462,7 +2220,7 @@ Type* check_binary(TypeCheckContext *ctx, Scope *scope, AstNode *expr, Type *exp
     }
 
     if (bin->left->is_foldable_const && bin->right->is_foldable_const) {
-        fold_binary_op(expr, op, bin->left, bin->right);
+        fold_binary_op(expr, op, bin->left, bin->right, lhs);
         // Correct const value type if needed (e.g. promoted in literal inference)
         if (result_type && type_is_float(result_type) && expr->const_value.type == INT_LITERAL) {
             expr->const_value.type = FLOAT_LITERAL;
@@ -1484,7 +2242,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
         // If the target is an identifier or another member expression, check if it resolved to a module
         Symbol *target_sym = NULL;
         if (member_expr->target->node_type == AST_IDENTIFIER) {
-            target_sym = scope_lookup_symbol(scope, member_expr->target->data.identifier.intern_result, ctx->filename);
+            target_sym = scope_lookup_symbol(scope, member_expr->target->data.identifier.intern_result, ctx->file);
         } else {
             target_sym = member_expr->target->data.member_expr.symbol;
         }
@@ -1497,7 +2255,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
                 if (member_expr->member && member_expr->member->key) {
                     field_name = ((Slice*)member_expr->member->key)->ptr;
                 }
-                TypeError err = { .kind = TE_UNDECLARED, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_UNDECLARED, .span = expr->span };
                 err.as.name.name = field_name;
                 dynarray_push_value(ctx->errors, &err);
                 return NULL;
@@ -1545,7 +2303,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
                 if (member_expr->member && member_expr->member->key) {
                     field_name = ((Slice*)member_expr->member->key)->ptr;
                 }
-                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span };
                 err.as.field.name = field_name;
                 err.as.field.type = underlying;
                 dynarray_push_value(ctx->errors, &err);
@@ -1572,7 +2330,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
                 if (member_expr->member && member_expr->member->key) {
                     field_name = ((Slice*)member_expr->member->key)->ptr;
                 }
-                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span };
                 err.as.field.name = field_name;
                 err.as.field.type = underlying;
                 dynarray_push_value(ctx->errors, &err);
@@ -1588,7 +2346,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
                 if (member_expr->member && member_expr->member->key) {
                     field_name = ((Slice*)member_expr->member->key)->ptr;
                 }
-                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span };
                 err.as.field.name = field_name;
                 err.as.field.type = underlying;
                 dynarray_push_value(ctx->errors, &err);
@@ -1625,7 +2383,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
             if (member_expr->member && member_expr->member->key) {
                 field_name = ((Slice*)member_expr->member->key)->ptr;
             }
-            TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span, .filename = ctx->filename };
+            TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span };
             err.as.field.name = field_name;
             err.as.field.type = underlying;
             dynarray_push_value(ctx->errors, &err);
@@ -1638,7 +2396,7 @@ static Type* check_member_expr(TypeCheckContext *ctx, Scope *scope, AstNode *exp
                 if (member_expr->member && member_expr->member->key) {
                     field_name = ((Slice*)member_expr->member->key)->ptr;
                 }
-                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span, .filename = ctx->filename };
+                TypeError err = { .kind = TE_FIELD_ACCESS, .span = expr->span };
                 err.as.field.name = field_name;
                 err.as.field.type = target_type;
                 dynarray_push_value(ctx->errors, &err);
@@ -1664,7 +2422,6 @@ static Type* check_cast(TypeCheckContext *ctx, Scope *scope, AstNode *expr) {
         TypeError err = { 
             .kind = TE_TYPE_MISMATCH, 
             .span = expr->span, 
-            .filename = ctx->filename, 
             .as.mismatch = { .expected = cast->target_type, .actual = src_type } 
         };
         dynarray_push_value(ctx->errors, &err);
@@ -1682,15 +2439,16 @@ static Type* check_generic_inst_expr(TypeCheckContext *ctx, Scope *scope, AstNod
     size_t count = inst->type_args ? inst->type_args->count : 0;
     Type **arg_types = NULL;
     if (count > 0) {
-        arg_types = arena_alloc(ctx->store->arena, count * sizeof(Type*));
+        arg_types = arena_alloc(ctx->arena, count * sizeof(Type*));
         for (size_t i = 0; i < count; i++) {
-            AstNode *arg_node = *(AstNode**)dynarray_get(inst->type_args, i);
-            arg_types[i] = resolve_ast_type(ctx, scope, arg_node);
+            AstNode *arg_node = DYNARRAY_AT(AstNode*, inst->type_args, i);
+            arg_types[i] = resolve_generic_arg(ctx, scope, arg_node);
+            if (!arg_types[i]) return NULL;
         }
     }
 
     if (inst->base->node_type == AST_IDENTIFIER) {
-        Symbol *sym = scope_lookup_symbol(scope, inst->base->data.identifier.intern_result, inst->base->filename);
+        Symbol *sym = scope_lookup_symbol(scope, inst->base->data.identifier.intern_result, inst->base->span.file);
         if (sym && sym->kind == SYMBOL_GENERIC_FUNCTION) {
             Symbol *inst_sym = instantiate_generic_function(ctx, scope, sym, arg_types, count, expr->span);
             if (inst_sym) {
@@ -1793,6 +2551,9 @@ bool infer_type_args(Type *expected, Type *provided, Type **inferred_args, size_
             return infer_type_args(expected->as.array.base, provided->as.array.base, inferred_args, count);
         case TYPE_SLICE:
             return infer_type_args(expected->as.slice.base, provided->as.slice.base, inferred_args, count);
+        case TYPE_VECTOR:
+            if (expected->as.vector.lanes != provided->as.vector.lanes) return false;
+            return infer_type_args(expected->as.vector.base, provided->as.vector.base, inferred_args, count);
         case TYPE_GENERIC_INST:
             if (expected->as.generic_inst.base != provided->as.generic_inst.base) return false;
             if (expected->as.generic_inst.arg_count != provided->as.generic_inst.arg_count) return false;
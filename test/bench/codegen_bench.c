@@ -0,0 +1,343 @@
+/*
+ * Generated-code benchmarks: every program below is compiled by the Newt
+ * compiler at -O0 through -O3 and run, so a codegen change that slows the
+ * programs down shows up here even when the compiler itself got faster.
+ *
+ * Each build is run once to warm the page cache and then --runs times
+ * (5 by default). A run's wall time, user-space instructions (from
+ * perf_event_open, when the kernel allows it) and peak RSS (wait4) are
+ * recorded; the table shows the fastest and the median time, the fewest
+ * instructions and the largest RSS. A program with a reference C version
+ * next to it (test/bench/programs/<name>.c) is also built with `cc -O2`,
+ * and each Newt build is reported as a multiple of that time.
+ *
+ * Every build of a program must exit with the same status as the first
+ * one, and as the C version; a mismatch is reported and makes the run
+ * fail, so the table cannot hide a miscompile.
+ *
+ * Results go to a JSON file (out/bench_codegen.json by default, or the
+ * path after --json). --quick builds only -O0 and -O2 and runs each twice.
+ * Names after the options select programs. Built and run by
+ * `make bench-codegen`, from the repository root.
+ */
+#include "core/utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+#endif
+
+#define BUILD_DIR "out/bench_codegen_build"
+#define MAX_RUNS 64
+
+typedef struct {
+    const char *name;
+    const char *source;     // Newt program
+    const char *reference;  // C version, or NULL
+} Program;
+
+static const Program g_programs[] = {
+    { "nbody",       "test/bench/programs/nbody.nt",          "test/bench/programs/nbody.c" },
+    { "sieve",       "test/bench/programs/sieve.nt",          "test/bench/programs/sieve.c" },
+    { "sort",        "test/bench/programs/sort.nt",           "test/bench/programs/sort.c" },
+    { "sat_nqueens", "test/fixtures/modules/sat_nqueens/main.nt", NULL },
+    { "sat_sudoku",  "test/fixtures/modules/sat_sudoku/main.nt",  NULL },
+};
+
+// --- Results ---
+
+typedef struct {
+    const char *program;
+    char build[8];          // "O0".."O3" or "C"
+    double compile_seconds;
+    size_t runs;
+    double best_seconds;
+    double median_seconds;
+    int64_t instructions;   // Fewest over the runs, -1 if not counted
+    long max_rss_kb;
+    int exit_status;
+    double vs_c;            // best / the C version's best, 0 without one
+} BenchResult;
+
+static BenchResult g_results[64];
+static size_t g_result_count;
+static bool g_failed;
+
+static const char *g_compiler = "out/compiler";
+static const char *g_cc = "cc";
+static size_t g_runs = 5;
+
+// --- Processes ---
+
+#ifdef __linux__
+/* A disabled user-space instruction counter on `pid` that starts when it execs; -1 if the kernel refuses. */
+static int open_instruction_counter(pid_t pid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+#endif
+
+typedef struct {
+    double seconds;
+    int64_t instructions;
+    long max_rss_kb;
+    int exit_status;
+} RunSample;
+
+/*
+ * Runs one benchmark binary with its output discarded. The child waits on
+ * a pipe until the counter is attached, so the count covers exactly the
+ * exec'd program.
+ */
+static bool run_sample(const char *path, RunSample *out) {
+    int go[2];
+    if (pipe(go) < 0) return false;
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(go[1]);
+        char byte;
+        if (read(go[0], &byte, 1) != 1) _exit(127);
+        close(go[0]);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execl(path, path, (char*)NULL);
+        _exit(127);
+    }
+    close(go[0]);
+    int counter = -1;
+#ifdef __linux__
+    counter = open_instruction_counter(pid);
+#endif
+    double t0 = now_seconds();
+    ssize_t sent = write(go[1], "x", 1);
+    close(go[1]);
+    int status;
+    struct rusage usage;
+    pid_t waited = wait4(pid, &status, 0, &usage);
+    out->seconds = now_seconds() - t0;
+    out->instructions = -1;
+    if (counter >= 0) {
+        uint64_t count;
+        if (read(counter, &count, sizeof(count)) == sizeof(count)) out->instructions = (int64_t)count;
+        close(counter);
+    }
+    if (sent != 1 || waited != pid) return false;
+    out->max_rss_kb = usage.ru_maxrss;
+    out->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return true;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Warms up, then times g_runs runs of `binary` into a new result. */
+static BenchResult *measure(const Program *p, const char *build, const char *binary, double compile_seconds) {
+    RunSample sample;
+    if (!run_sample(binary, &sample)) {
+        fprintf(stderr, "bench: could not run %s\n", binary);
+        g_failed = true;
+        return NULL;
+    }
+
+    BenchResult *r = &g_results[g_result_count++];
+    memset(r, 0, sizeof(*r));
+    r->program = p->name;
+    snprintf(r->build, sizeof(r->build), "%s", build);
+    r->compile_seconds = compile_seconds;
+    r->exit_status = sample.exit_status;
+    r->instructions = -1;
+
+    double times[MAX_RUNS];
+    for (size_t i = 0; i < g_runs; i++) {
+        if (!run_sample(binary, &sample)) {
+            fprintf(stderr, "bench: could not run %s\n", binary);
+            g_failed = true;
+            break;
+        }
+        times[r->runs++] = sample.seconds;
+        if (sample.instructions >= 0 && (r->instructions < 0 || sample.instructions < r->instructions)) {
+            r->instructions = sample.instructions;
+        }
+        if (sample.max_rss_kb > r->max_rss_kb) r->max_rss_kb = sample.max_rss_kb;
+        if (sample.exit_status != r->exit_status) {
+            fprintf(stderr, "bench: %s exited with %d, then %d\n", binary, r->exit_status, sample.exit_status);
+            g_failed = true;
+        }
+    }
+    if (r->runs > 0) {
+        qsort(times, r->runs, sizeof(double), compare_doubles);
+        r->best_seconds = times[0];
+        r->median_seconds = times[r->runs / 2];
+    }
+    return r;
+}
+
+static void print_result(const BenchResult *r) {
+    printf("%-12s %-5s %10.1f %10.2f %10.2f", r->program, r->build, r->compile_seconds * 1e3,
+           r->best_seconds * 1e3, r->median_seconds * 1e3);
+    if (r->instructions >= 0) printf(" %12.1f", (double)r->instructions / 1e6);
+    else printf(" %12s", "-");
+    printf(" %10ld %5d", r->max_rss_kb, r->exit_status);
+    if (r->vs_c > 0) printf(" %7.2fx", r->vs_c);
+    printf("\n");
+    fflush(stdout);
+}
+
+// --- Programs ---
+
+static void bench_program(const Program *p, const int *levels, size_t level_count) {
+    char binary[256];
+    const BenchResult *reference = NULL;
+
+    if (p->reference) {
+        snprintf(binary, sizeof(binary), "%s/%s-c", BUILD_DIR, p->name);
+        char *argv[] = { (char*)g_cc, "-O2", (char*)p->reference, "-o", binary, "-lm", NULL };
+        double t0 = now_seconds();
+        if (run_command(argv[0], argv) != 0) {
+            fprintf(stderr, "bench: %s failed to build %s\n", g_cc, p->reference);
+            g_failed = true;
+        } else {
+            BenchResult *r = measure(p, "C", binary, now_seconds() - t0);
+            if (r) {
+                print_result(r);
+                reference = r;
+            }
+        }
+    }
+
+    int expected = reference ? reference->exit_status : -1;
+    for (size_t l = 0; l < level_count; l++) {
+        char level[8];
+        snprintf(level, sizeof(level), "-O%d", levels[l]);
+        snprintf(binary, sizeof(binary), "%s/%s%s", BUILD_DIR, p->name, level);
+        char *argv[] = { (char*)g_compiler, (char*)p->source, "-o", binary, level, "-q", NULL };
+        double t0 = now_seconds();
+        if (run_command(argv[0], argv) != 0) {
+            fprintf(stderr, "bench: %s failed to compile %s at %s\n", g_compiler, p->source, level);
+            g_failed = true;
+            continue;
+        }
+        BenchResult *r = measure(p, level + 1, binary, now_seconds() - t0);
+        if (!r) continue;
+        if (reference && r->best_seconds > 0 && reference->best_seconds > 0) {
+            r->vs_c = r->best_seconds / reference->best_seconds;
+        }
+        if (expected < 0) {
+            expected = r->exit_status;
+        } else if (r->exit_status != expected) {
+            fprintf(stderr, "bench: MISMATCH: %s at %s exited with %d, expected %d\n", p->name, level, r->exit_status, expected);
+            g_failed = true;
+        }
+        print_result(r);
+    }
+}
+
+static void json_number(FILE *f, const char *key, double value, bool present) {
+    if (present) fprintf(f, ", \"%s\": %.4f", key, value);
+    else fprintf(f, ", \"%s\": null", key);
+}
+
+static bool write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"schema\": 1,\n  \"runs\": %zu,\n  \"results\": [\n", g_runs);
+    for (size_t i = 0; i < g_result_count; i++) {
+        const BenchResult *r = &g_results[i];
+        fprintf(f, "    {\"program\": \"%s\", \"build\": \"%s\", \"runs\": %zu", r->program, r->build, r->runs);
+        json_number(f, "compile_ms", r->compile_seconds * 1e3, true);
+        json_number(f, "best_ms", r->best_seconds * 1e3, true);
+        json_number(f, "median_ms", r->median_seconds * 1e3, true);
+        if (r->instructions >= 0) fprintf(f, ", \"instructions\": %lld", (long long)r->instructions);
+        else fprintf(f, ", \"instructions\": null");
+        fprintf(f, ", \"max_rss_kb\": %ld, \"exit\": %d", r->max_rss_kb, r->exit_status);
+        json_number(f, "vs_c", r->vs_c, r->vs_c > 0);
+        fprintf(f, "}%s\n", i + 1 < g_result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--compiler PATH] [--cc CC] [--runs N] [--json FILE] [--quick] [program...]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *json_path = "out/bench_codegen.json";
+    bool quick = false;
+    const char *only[16];
+    size_t only_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            g_compiler = argv[++i];
+        } else if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc) {
+            g_cc = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            g_runs = strtoul(argv[++i], NULL, 10);
+            if (g_runs < 1) g_runs = 1;
+            if (g_runs > MAX_RUNS) g_runs = MAX_RUNS;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (argv[i][0] != '-' && only_count < sizeof(only) / sizeof(only[0])) {
+            only[only_count++] = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (quick) g_runs = 2;
+
+    static const int all_levels[] = { 0, 1, 2, 3 };
+    static const int quick_levels[] = { 0, 2 };
+    const int *levels = quick ? quick_levels : all_levels;
+    size_t level_count = quick ? 2 : 4;
+
+    if (mkdir(BUILD_DIR, 0755) != 0 && errno != EEXIST) {
+        perror("bench: mkdir " BUILD_DIR);
+        return 1;
+    }
+
+    printf("%-12s %-5s %10s %10s %10s %12s %10s %5s %8s\n", "program", "build", "compile ms", "best ms",
+           "median ms", "Minstr", "max RSS KB", "exit", "vs C");
+    fflush(stdout);
+    for (size_t i = 0; i < sizeof(g_programs) / sizeof(g_programs[0]); i++) {
+        bool selected = only_count == 0;
+        for (size_t k = 0; k < only_count; k++) {
+            if (strcmp(only[k], g_programs[i].name) == 0) selected = true;
+        }
+        if (selected) bench_program(&g_programs[i], levels, level_count);
+    }
+
+    if (!write_json(json_path)) {
+        fprintf(stderr, "bench: could not write %s\n", json_path);
+        return 1;
+    }
+    printf("\nwrote %s\n", json_path);
+    return g_failed ? 1 : 0;
+}
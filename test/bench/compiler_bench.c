@@ -0,0 +1,445 @@
+/*
+ * Compiler microbenchmarks: the core data structures (arena, hash map,
+ * interner) and each front-to-back phase (lex, parse, typecheck, codegen)
+ * on checked-in sources and on generated programs of several sizes.
+ *
+ * Every measurement is repeated until it has run for MIN_SECONDS and at
+ * least MIN_RUNS times; the fastest run is reported, which is the most
+ * stable number on a shared machine. Results go to stdout as a table and
+ * to a JSON file (out/bench.json by default, or the path after --json) so
+ * runs can be compared release over release. --quick drops the largest
+ * inputs and shortens every measurement.
+ *
+ * Built and run by `make bench`.
+ */
+#include "datastructures/arena.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/dense_arena_interner.h"
+#include "lexing/lexer.h"
+#include "parsing/parser.h"
+#include "parsing/parse_declarations.h"
+#include "core/module_loader.h"
+#include "sema/typecheck.h"
+#include "codegen/codegen.h"
+#include "core/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_RUNS 3
+
+static double g_min_seconds = 0.25;
+static volatile uintptr_t g_sink;
+
+// --- Results ---
+
+typedef struct {
+    const char *bench;
+    char input[48];
+    size_t ops;         // operations, tokens or bytes per run (see `unit`)
+    const char *unit;
+    size_t bytes;       // source bytes per run, 0 for data-structure benches
+    size_t runs;
+    double best_seconds;
+} BenchResult;
+
+static BenchResult g_results[128];
+static size_t g_result_count;
+
+typedef void (*BenchFn)(void *arg);
+
+/* Setup runs outside the timer: `prepare` before and `finish` after every run. */
+typedef struct {
+    void (*prepare)(void *arg);
+    BenchFn run;
+    void (*finish)(void *arg);
+} BenchOps;
+
+static void record(const char *bench, const char *input, size_t ops, const char *unit, size_t bytes,
+                   const BenchOps *fns, void *arg) {
+    double best = 1e30, total = 0;
+    size_t runs = 0;
+    while (runs < MIN_RUNS || total < g_min_seconds) {
+        if (fns->prepare) fns->prepare(arg);
+        double t0 = now_seconds();
+        fns->run(arg);
+        double dt = now_seconds() - t0;
+        if (fns->finish) fns->finish(arg);
+        if (dt < best) best = dt;
+        total += dt;
+        runs++;
+    }
+
+    BenchResult *r = &g_results[g_result_count++];
+    r->bench = bench;
+    snprintf(r->input, sizeof(r->input), "%s", input);
+    r->ops = ops;
+    r->unit = unit;
+    r->bytes = bytes;
+    r->runs = runs;
+    r->best_seconds = best;
+
+    double mb_s = bytes ? (double)bytes / best / (1024.0 * 1024.0) : 0;
+    printf("%-18s %-18s %10zu %-6s %12.2f %12.3f", bench, input, ops, unit, best * 1e9 / (double)ops, best * 1e3);
+    if (bytes) printf(" %10.1f", mb_s);
+    printf("\n");
+    fflush(stdout);
+}
+
+static bool write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+#ifdef NEWT_HASH_FNV1A
+    const char *hash = "fnv1a";
+#else
+    const char *hash = "wyhash";
+#endif
+    fprintf(f, "{\n  \"schema\": 1,\n  \"hash\": \"%s\",\n  \"min_seconds\": %.3f,\n  \"results\": [\n", hash, g_min_seconds);
+    for (size_t i = 0; i < g_result_count; i++) {
+        const BenchResult *r = &g_results[i];
+        fprintf(f, "    {\"bench\": \"%s\", \"input\": \"%s\", \"ops\": %zu, \"unit\": \"%s\", \"bytes\": %zu, "
+                   "\"runs\": %zu, \"best_ms\": %.4f, \"ns_per_op\": %.3f}%s\n",
+                r->bench, r->input, r->ops, r->unit, r->bytes, r->runs, r->best_seconds * 1e3,
+                r->best_seconds * 1e9 / (double)r->ops, i + 1 < g_result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// --- Data structures ---
+
+typedef struct {
+    size_t n;
+    void **keys;
+    Slice *names;       // for intern: n slices over `n / 4` distinct spellings
+    char *name_buf;
+    HashMap *map;
+} DataArgs;
+
+static void run_arena_alloc(void *p) {
+    DataArgs *a = p;
+    Arena *arena = arena_create(64 * 1024);
+    for (size_t i = 0; i < a->n; i++) {
+        // Mixed small sizes, as AST nodes, types and slices are
+        g_sink += (uintptr_t)arena_alloc(arena, 16 + (i & 3) * 16);
+    }
+    arena_destroy(arena);
+}
+
+static void run_hashmap_put(void *p) {
+    DataArgs *a = p;
+    HashMap *map = hashmap_create(NULL, 16);
+    for (size_t i = 0; i < a->n; i++) hashmap_put(map, a->keys[i], a->keys[i], ptr_hash, ptr_cmp);
+    hashmap_destroy(map, NULL, NULL);
+}
+
+static void prepare_hashmap_get(void *p) {
+    DataArgs *a = p;
+    a->map = hashmap_create(NULL, 16);
+    for (size_t i = 0; i < a->n; i++) hashmap_put(a->map, a->keys[i], a->keys[i], ptr_hash, ptr_cmp);
+}
+
+static void run_hashmap_get(void *p) {
+    DataArgs *a = p;
+    for (size_t i = 0; i < a->n; i++) g_sink += (uintptr_t)hashmap_get(a->map, a->keys[i], ptr_hash, ptr_cmp);
+}
+
+static void finish_hashmap_get(void *p) {
+    DataArgs *a = p;
+    hashmap_destroy(a->map, NULL, NULL);
+    a->map = NULL;
+}
+
+static void run_intern(void *p) {
+    DataArgs *a = p;
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 128), arena, string_copy_func, slice_hash, slice_cmp);
+    for (size_t i = 0; i < a->n; i++) g_sink += (uintptr_t)intern(in, &a->names[i], NULL);
+    arena_destroy(arena);
+}
+
+static void bench_data_structures(bool quick) {
+    static const size_t sizes[] = { 1024, 65536, 1048576 };
+    size_t count = quick ? 2 : 3;
+
+    for (size_t s = 0; s < count; s++) {
+        size_t n = sizes[s];
+        char input[48];
+        snprintf(input, sizeof(input), "n=%zu", n);
+
+        DataArgs a = { .n = n };
+        a.keys = malloc(n * sizeof(void*));
+        char *block = malloc(n * 48);
+        for (size_t i = 0; i < n; i++) a.keys[i] = block + i * 48;
+
+        // Identifier-like spellings, each seen four times
+        a.names = malloc(n * sizeof(Slice));
+        a.name_buf = malloc(n * 24);
+        for (size_t i = 0; i < n; i++) {
+            char *dst = a.name_buf + i * 24;
+            int len = snprintf(dst, 24, "%s_%zu", i % 3 == 0 ? "value" : i % 3 == 1 ? "node" : "tmp", (i * 2654435761u) % (n / 4));
+            a.names[i] = (Slice){ dst, (uint32_t)len };
+        }
+
+        record("arena_alloc", input, n, "allocs", 0, &(BenchOps){ NULL, run_arena_alloc, NULL }, &a);
+        record("hashmap_put", input, n, "puts", 0, &(BenchOps){ NULL, run_hashmap_put, NULL }, &a);
+        record("hashmap_get", input, n, "gets", 0, &(BenchOps){ prepare_hashmap_get, run_hashmap_get, finish_hashmap_get }, &a);
+        record("intern", input, n, "keys", 0, &(BenchOps){ NULL, run_intern, NULL }, &a);
+
+        free(a.names);
+        free(a.name_buf);
+        free(block);
+        free(a.keys);
+    }
+}
+
+// --- Phases ---
+
+typedef struct {
+    const char *path;   // on disk, for the phases that go through the module loader
+    const char *source;
+    size_t len;
+    SourceId file;      // registered once, shared by every run
+    bool full;          // self-contained: also typecheck and codegen
+
+    Arena *arena;
+    DenseArenaInterner *keywords, *identifiers, *strings;
+    Lexer *lexer;
+    ModuleLoader *loader;
+    TypeStore *store;
+    Options opts;
+    size_t tokens;
+} PhaseArgs;
+
+static void phase_setup(PhaseArgs *a) {
+    a->arena = arena_create(1024 * 1024);
+    a->keywords = intern_table_create(hashmap_create(a->arena, 32), a->arena, string_copy_func, slice_hash, slice_cmp);
+    a->identifiers = intern_table_create(hashmap_create(a->arena, 256), a->arena, string_copy_func, slice_hash, slice_cmp);
+    a->strings = intern_table_create(hashmap_create(a->arena, 128), a->arena, string_copy_func, slice_hash, slice_cmp);
+    lexer_populate_default_keywords(a->keywords);
+    a->lexer = lexer_create_ex(a->source, a->len, a->file, a->arena, a->keywords, a->identifiers, a->strings);
+}
+
+static void phase_teardown(void *p) {
+    PhaseArgs *a = p;
+    arena_destroy(a->arena);
+    a->arena = NULL;
+}
+
+static void prepare_lex(void *p) {
+    phase_setup(p);
+}
+
+static void run_lex(void *p) {
+    PhaseArgs *a = p;
+    if (!lexer_lex_all(a->lexer)) abort();
+    a->tokens = a->lexer->tokens->count;
+}
+
+static void prepare_parse(void *p) {
+    PhaseArgs *a = p;
+    phase_setup(a);
+    if (!lexer_lex_all(a->lexer)) abort();
+}
+
+static void run_parse(void *p) {
+    PhaseArgs *a = p;
+    Parser *parser = parser_create(a->lexer, (char*)a->path, a->arena);
+    ParseError err = {0};
+    if (!parse_program(parser, &err) || err.message) {
+        fprintf(stderr, "bench: %s does not parse: %s\n", a->path, err.message);
+        exit(1);
+    }
+}
+
+// Lexing and parsing interleaved, as the module loader does it
+static void run_parse_streaming(void *p) {
+    PhaseArgs *a = p;
+    Parser *parser = parser_create_streaming(a->lexer, (char*)a->path, a->arena);
+    ParseError err = {0};
+    if (!parse_program(parser, &err) || err.message) {
+        fprintf(stderr, "bench: %s does not parse: %s\n", a->path, err.message);
+        exit(1);
+    }
+}
+
+static void load_program(PhaseArgs *a) {
+    phase_setup(a);
+    a->opts = (Options){ .stdlib_path = "lib", .jobs = 1, .jit_opt_level = -1 };
+    a->loader = module_loader_create(a->arena, &a->opts, a->keywords, a->identifiers, a->strings);
+    if (!a->loader || module_loader_load(a->loader, a->path) != 0) {
+        fprintf(stderr, "bench: could not load %s\n", a->path);
+        exit(1);
+    }
+    a->store = NULL;
+}
+
+static void run_typecheck(void *p) {
+    PhaseArgs *a = p;
+    CompilationUnit *first = DYNARRAY_AT(CompilationUnit*, a->loader->units_ordered, 0);
+    a->store = typestore_create(a->arena, a->identifiers, a->keywords);
+    TypeCheckContext ctx = typecheck_context_create(a->arena, a->store, a->identifiers, a->keywords,
+                                                    first->file, a->loader);
+    typecheck_program(&ctx);
+    if (ctx.errors->count > 0) {
+        fprintf(stderr, "bench: %s has %zu type errors\n", a->path, ctx.errors->count);
+        exit(1);
+    }
+}
+
+static void prepare_codegen(void *p) {
+    PhaseArgs *a = p;
+    load_program(a);
+    run_typecheck(a);
+}
+
+static void run_codegen(void *p) {
+    PhaseArgs *a = p;
+    CodegenContext *cg = codegen_context_create(a->store, "bench", 0, a->loader);
+    if (!cg || codegen_program(cg) != 0) {
+        fprintf(stderr, "bench: codegen failed for %s\n", a->path);
+        exit(1);
+    }
+    codegen_context_destroy(cg);
+}
+
+static void bench_phases(PhaseArgs *a, const char *input) {
+    // Token count for the per-token columns
+    prepare_lex(a);
+    run_lex(a);
+    phase_teardown(a);
+    size_t tokens = a->tokens;
+
+    record("lexer_lex_all", input, tokens, "tokens", a->len, &(BenchOps){ prepare_lex, run_lex, phase_teardown }, a);
+    record("parse_program", input, tokens, "tokens", a->len, &(BenchOps){ prepare_parse, run_parse, phase_teardown }, a);
+    record("parse_streaming", input, tokens, "tokens", a->len,
+           &(BenchOps){ prepare_lex, run_parse_streaming, phase_teardown }, a);
+    if (!a->full) return;
+    record("typecheck_program", input, tokens, "tokens", a->len,
+           &(BenchOps){ (void (*)(void*))load_program, run_typecheck, phase_teardown }, a);
+    record("codegen_program", input, tokens, "tokens", a->len, &(BenchOps){ prepare_codegen, run_codegen, phase_teardown }, a);
+}
+
+/*
+ * A self-contained program of `functions` functions, each with its own
+ * struct, a loop, a branch and a call to the previous function, so every
+ * phase sees declarations, statements and expressions in fixed proportion.
+ */
+static char *generate_program(size_t functions, size_t *out_len) {
+    size_t cap = 512 + functions * 512, len = 0;
+    char *src = malloc(cap);
+    for (size_t i = 0; i < functions; i++) {
+        len += (size_t)snprintf(src + len, cap - len,
+            "struct Point%zu { x: i64; y: i64; }\n"
+            "fn step%zu(a: i64, b: i64) -> i64 {\n"
+            "    p: Point%zu = Point%zu{ x: a, y: b };\n"
+            "    acc: i64 = 0;\n"
+            "    i: i64 = 0;\n"
+            "    while (i < a) {\n"
+            "        if (i %% 3 == 0) { acc = acc + p.x * i; } else { acc = acc - p.y; }\n"
+            "        i = i + 1;\n"
+            "    }\n",
+            i, i, i, i);
+        if (i > 0) {
+            len += (size_t)snprintf(src + len, cap - len, "    return acc + step%zu(a - 1, b + acc);\n}\n\n", i - 1);
+        } else {
+            len += (size_t)snprintf(src + len, cap - len, "    return acc;\n}\n\n");
+        }
+    }
+    len += (size_t)snprintf(src + len, cap - len, "fn main() -> i32 {\n    return step%zu(3, 4) as i32;\n}\n", functions - 1);
+    *out_len = len;
+    return src;
+}
+
+static char *read_file(const char *path, size_t *out_len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc((size_t)size + 1);
+    size_t got = fread(buf, 1, (size_t)size, f);
+    fclose(f);
+    buf[got] = '\0';
+    *out_len = got;
+    return buf;
+}
+
+static void bench_checked_in(void) {
+    // Front-end only: these import std, which the generated inputs leave out
+    static const char *files[] = { "test/bench/sat_nqueens.nt", "lib/std/vec.nt", "lib/std/map.nt", "lib/std/string.nt" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        PhaseArgs a = { .path = files[i] };
+        char *src = read_file(files[i], &a.len);
+        if (!src) {
+            fprintf(stderr, "bench: skipping %s (run from the repository root)\n", files[i]);
+            continue;
+        }
+        a.source = src;
+        a.file = source_register(files[i], src, a.len);
+        const char *base = strrchr(files[i], '/');
+        bench_phases(&a, base ? base + 1 : files[i]);
+        free(src);
+    }
+}
+
+static void bench_generated(bool quick) {
+    static const size_t sizes[] = { 16, 256, 4096 };
+    size_t count = quick ? 2 : 3;
+    for (size_t s = 0; s < count; s++) {
+        char path[] = "/tmp/newt_bench_XXXXXX.nt";
+        int fd = mkstemps(path, 3);
+        if (fd < 0) {
+            perror("bench: mkstemps");
+            exit(1);
+        }
+        PhaseArgs a = { .path = path, .full = true };
+        char *src = generate_program(sizes[s], &a.len);
+        if (write(fd, src, a.len) != (ssize_t)a.len) {
+            perror("bench: write");
+            exit(1);
+        }
+        close(fd);
+        a.source = src;
+        a.file = source_register(path, src, a.len);
+
+        char input[48];
+        snprintf(input, sizeof(input), "generated/%zu", sizes[s]);
+        bench_phases(&a, input);
+
+        unlink(path);
+        free(src);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *json_path = "out/bench.json";
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            fprintf(stderr, "usage: %s [--json FILE] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (quick) g_min_seconds = 0.05;
+
+    codegen_initialize();
+
+    printf("%-18s %-18s %10s %-6s %12s %12s %10s\n", "bench", "input", "ops", "unit", "ns/op", "best ms", "MiB/s");
+    bench_data_structures(quick);
+    bench_checked_in();
+    bench_generated(quick);
+
+    if (!write_json(json_path)) {
+        fprintf(stderr, "bench: could not write %s\n", json_path);
+        return 1;
+    }
+    printf("\nwrote %s\n", json_path);
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * HashMap microbenchmarks: the Swiss table in src/datastructures/hash_map.c
+ * against the linear-probing map it replaced (kept below as `legacy_*`,
+ * unchanged apart from names), on the key shapes the compiler uses:
+ * pointer keys through ptr_hash (scopes, codegen maps, type caches) and
+ * identifier strings through str_hash (module tables, interners). Pointer
+ * keys are also run through the ptrmap_* entry points, which inline the
+ * hash and compare, including batched lookups through ptrmap_get_many.
+ * A last table times hash_bytes itself against byte-at-a-time FNV-1a on
+ * identifier-sized keys.
+ *
+ * Built and run by `make bench`.
+ */
+#include "datastructures/hash_map.h"
+#include "core/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Legacy map (linear probing, modulo indexing) ---
+
+#define LEGACY_TOMBSTONE ((void*)-1)
+
+typedef struct {
+    KeyValue *entries;
+    size_t capacity;
+    size_t size;
+    size_t tombstones;
+} LegacyMap;
+
+static LegacyMap *legacy_create(size_t initial_capacity) {
+    if (initial_capacity < 8) initial_capacity = 8;
+    LegacyMap *map = calloc(1, sizeof(LegacyMap));
+    map->capacity = initial_capacity;
+    map->entries = calloc(initial_capacity, sizeof(KeyValue));
+    return map;
+}
+
+static void legacy_destroy(LegacyMap *map) {
+    free(map->entries);
+    free(map);
+}
+
+static void legacy_rehash(LegacyMap *map, size_t new_capacity, size_t (*hash)(void*)) {
+    KeyValue *new_entries = calloc(new_capacity, sizeof(KeyValue));
+    for (size_t i = 0; i < map->capacity; i++) {
+        void *k = map->entries[i].key;
+        if (k != NULL && k != LEGACY_TOMBSTONE) {
+            size_t index = hash(k) % new_capacity;
+            while (new_entries[index].key != NULL) index = (index + 1) % new_capacity;
+            new_entries[index] = map->entries[i];
+        }
+    }
+    free(map->entries);
+    map->entries = new_entries;
+    map->capacity = new_capacity;
+    map->tombstones = 0;
+}
+
+static void legacy_put(LegacyMap *map, void *key, void *value, size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    if (map->size + map->tombstones >= (map->capacity * 3) / 4) legacy_rehash(map, map->capacity * 2, hash);
+
+    size_t index = hash(key) % map->capacity;
+    size_t first_tombstone = (size_t)-1;
+    for (size_t i = 0; i < map->capacity; i++) {
+        void *k = map->entries[index].key;
+        if (k == NULL) {
+            if (first_tombstone != (size_t)-1) {
+                index = first_tombstone;
+                map->tombstones--;
+            }
+            map->entries[index].key = key;
+            map->entries[index].value = value;
+            map->size++;
+            return;
+        } else if (k == LEGACY_TOMBSTONE) {
+            if (first_tombstone == (size_t)-1) first_tombstone = index;
+        } else if (cmp(k, key) == 0) {
+            map->entries[index].value = value;
+            return;
+        }
+        index = (index + 1) % map->capacity;
+    }
+}
+
+static void *legacy_get(LegacyMap *map, void *key, size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    size_t index = hash(key) % map->capacity;
+    for (size_t i = 0; i < map->capacity; i++) {
+        void *k = map->entries[index].key;
+        if (k == NULL) return NULL;
+        if (k != LEGACY_TOMBSTONE && cmp(k, key) == 0) return map->entries[index].value;
+        index = (index + 1) % map->capacity;
+    }
+    return NULL;
+}
+
+static void legacy_remove(LegacyMap *map, void *key, size_t (*hash)(void*), int (*cmp)(void*, void*)) {
+    size_t index = hash(key) % map->capacity;
+    for (size_t i = 0; i < map->capacity; i++) {
+        void *k = map->entries[index].key;
+        if (k == NULL) return;
+        if (k != LEGACY_TOMBSTONE && cmp(k, key) == 0) {
+            map->entries[index].key = LEGACY_TOMBSTONE;
+            map->entries[index].value = NULL;
+            map->size--;
+            map->tombstones++;
+            return;
+        }
+        index = (index + 1) % map->capacity;
+    }
+}
+
+// --- Workloads ---
+
+typedef struct {
+    const char *name;
+    size_t (*hash)(void*);
+    int (*cmp)(void*, void*);
+    void **keys;    // n present keys followed by n absent ones
+    size_t n;
+} Workload;
+
+// Operations per measurement, so small tables are timed over many rounds
+#define OPS_TARGET 4000000
+
+enum { OP_INSERT, OP_GET_HIT, OP_GET_MISS, OP_CHURN, OP_BATCH_HIT, OP_COUNT };
+
+#define BATCH 16
+
+static volatile uintptr_t g_sink;
+
+/*
+ * OP_INSERT times building a fresh table from 16 slots; the others time
+ * their loop alone on a table built beforehand. OP_CHURN removes every
+ * other key and puts it back, leaving the table as it found it.
+ */
+static double bench_swiss(const Workload *w, int op) {
+    size_t rounds = OPS_TARGET / w->n + 1;
+    HashMap *map = hashmap_create(NULL, 16);
+    for (size_t i = 0; i < w->n; i++) hashmap_put(map, w->keys[i], w->keys[i], w->hash, w->cmp);
+
+    double t0 = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        if (op == OP_INSERT) {
+            HashMap *fresh = hashmap_create(NULL, 16);
+            for (size_t i = 0; i < w->n; i++) hashmap_put(fresh, w->keys[i], w->keys[i], w->hash, w->cmp);
+            hashmap_destroy(fresh, NULL, NULL);
+        } else if (op == OP_GET_HIT) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)hashmap_get(map, w->keys[i], w->hash, w->cmp);
+        } else if (op == OP_GET_MISS) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)hashmap_get(map, w->keys[w->n + i], w->hash, w->cmp);
+        } else {
+            for (size_t i = 0; i < w->n; i += 2) hashmap_remove(map, w->keys[i], w->hash, w->cmp, NULL, NULL);
+            for (size_t i = 0; i < w->n; i += 2) hashmap_put(map, w->keys[i], w->keys[i], w->hash, w->cmp);
+        }
+    }
+    double elapsed = now_seconds() - t0;
+    hashmap_destroy(map, NULL, NULL);
+    return elapsed / (double)(rounds * w->n);
+}
+
+static double bench_legacy(const Workload *w, int op) {
+    size_t rounds = OPS_TARGET / w->n + 1;
+    LegacyMap *map = legacy_create(16);
+    for (size_t i = 0; i < w->n; i++) legacy_put(map, w->keys[i], w->keys[i], w->hash, w->cmp);
+
+    double t0 = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        if (op == OP_INSERT) {
+            LegacyMap *fresh = legacy_create(16);
+            for (size_t i = 0; i < w->n; i++) legacy_put(fresh, w->keys[i], w->keys[i], w->hash, w->cmp);
+            legacy_destroy(fresh);
+        } else if (op == OP_GET_HIT) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)legacy_get(map, w->keys[i], w->hash, w->cmp);
+        } else if (op == OP_GET_MISS) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)legacy_get(map, w->keys[w->n + i], w->hash, w->cmp);
+        } else {
+            for (size_t i = 0; i < w->n; i += 2) legacy_remove(map, w->keys[i], w->hash, w->cmp);
+            for (size_t i = 0; i < w->n; i += 2) legacy_put(map, w->keys[i], w->keys[i], w->hash, w->cmp);
+        }
+    }
+    double elapsed = now_seconds() - t0;
+    legacy_destroy(map);
+    return elapsed / (double)(rounds * w->n);
+}
+
+static double bench_ptrmap(const Workload *w, int op) {
+    size_t rounds = OPS_TARGET / w->n + 1;
+    HashMap *map = hashmap_create(NULL, 16);
+    for (size_t i = 0; i < w->n; i++) ptrmap_put(map, w->keys[i], w->keys[i]);
+
+    void *values[BATCH];
+    double t0 = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        if (op == OP_INSERT) {
+            HashMap *fresh = hashmap_create(NULL, 16);
+            for (size_t i = 0; i < w->n; i++) ptrmap_put(fresh, w->keys[i], w->keys[i]);
+            hashmap_destroy(fresh, NULL, NULL);
+        } else if (op == OP_GET_HIT) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)ptrmap_get(map, w->keys[i]);
+        } else if (op == OP_GET_MISS) {
+            for (size_t i = 0; i < w->n; i++) g_sink += (uintptr_t)ptrmap_get(map, w->keys[w->n + i]);
+        } else if (op == OP_CHURN) {
+            for (size_t i = 0; i < w->n; i += 2) ptrmap_remove(map, w->keys[i]);
+            for (size_t i = 0; i < w->n; i += 2) ptrmap_put(map, w->keys[i], w->keys[i]);
+        } else {
+            for (size_t i = 0; i + BATCH <= w->n; i += BATCH) g_sink += ptrmap_get_many(map, w->keys + i, values, BATCH);
+        }
+    }
+    double elapsed = now_seconds() - t0;
+    hashmap_destroy(map, NULL, NULL);
+    return elapsed / (double)(rounds * w->n);
+}
+
+static void **make_pointer_keys(size_t n) {
+    // Heap objects of a typical AST/Type node size, in allocation order
+    void **keys = malloc(2 * n * sizeof(void*));
+    char *block = malloc(2 * n * 48);
+    for (size_t i = 0; i < 2 * n; i++) keys[i] = block + i * 48;
+    return keys;
+}
+
+static void **make_string_keys(size_t n) {
+    void **keys = malloc(2 * n * sizeof(void*));
+    for (size_t i = 0; i < 2 * n; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%s_%zu", i % 3 == 0 ? "value" : i % 3 == 1 ? "node" : "tmp", i);
+        keys[i] = xstrdup(buf);
+    }
+    return keys;
+}
+
+// --- String hashing ---
+
+static size_t fnv1a_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    size_t h = (size_t)1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= (size_t)1099511628211ULL;
+    }
+    return h;
+}
+
+static double bench_hash(size_t (*fn)(const void*, size_t), const char *text, size_t len) {
+    size_t rounds = OPS_TARGET * 4;
+    double t0 = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        // Vary the length a little so the loop cannot be hoisted
+        g_sink += fn(text, len - (r & 1));
+    }
+    return (now_seconds() - t0) / (double)rounds;
+}
+
+static void bench_hashes(void) {
+    static const char text[] = "a_fairly_long_generated_identifier_name_used_for_hash_timing_00";
+    static const size_t lens[] = { 4, 8, 16, 32, 64 };
+
+    printf("\n%-8s %7s  %14s %14s %8s\n", "hash", "bytes", "fnv1a ns/op", "hash ns/op", "speedup");
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        double fnv = bench_hash(fnv1a_bytes, text, lens[i]);
+        double fast = bench_hash(hash_bytes, text, lens[i]);
+        printf("%-8s %7zu  %14.2f %14.2f %7.2fx\n", "string", lens[i], fnv * 1e9, fast * 1e9, fnv / fast);
+    }
+}
+
+int main(void) {
+    static const size_t sizes[] = { 32, 1024, 65536 };
+    static const char *ops[] = { "insert", "get hit", "get miss", "remove+reinsert", "get hit x16" };
+
+    printf("%-8s %7s  %-16s %14s %14s %14s %8s\n", "keys", "n", "operation",
+           "legacy ns/op", "swiss ns/op", "ptrmap ns/op", "speedup");
+    for (int kind = 0; kind < 2; kind++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t n = sizes[s];
+            Workload w = kind == 0
+                ? (Workload){ "pointer", ptr_hash, ptr_cmp, make_pointer_keys(n), n }
+                : (Workload){ "string", str_hash, str_cmp, make_string_keys(n), n };
+
+            for (int op = 0; op < OP_COUNT; op++) {
+                // Batched lookups only exist for pointer keys
+                if (op == OP_BATCH_HIT && kind != 0) continue;
+                double legacy = op == OP_BATCH_HIT ? bench_legacy(&w, OP_GET_HIT) : bench_legacy(&w, op);
+                double swiss = op == OP_BATCH_HIT ? 0 : bench_swiss(&w, op);
+                double ptr = kind == 0 ? bench_ptrmap(&w, op) : 0;
+                double best = kind == 0 ? ptr : swiss;
+                char swiss_col[32] = "-", ptr_col[32] = "-";
+                if (swiss > 0) snprintf(swiss_col, sizeof(swiss_col), "%.2f", swiss * 1e9);
+                if (ptr > 0) snprintf(ptr_col, sizeof(ptr_col), "%.2f", ptr * 1e9);
+                printf("%-8s %7zu  %-16s %14.2f %14s %14s %7.2fx\n", w.name, n, ops[op],
+                       legacy * 1e9, swiss_col, ptr_col, best > 0 ? legacy / best : 0.0);
+            }
+
+            if (kind == 0) {
+                free(w.keys[0]);
+            } else {
+                for (size_t i = 0; i < 2 * n; i++) free(w.keys[i]);
+            }
+            free(w.keys);
+        }
+    }
+    bench_hashes();
+    return 0;
+}
@@ -0,0 +1,86 @@
+/* Reference for nbody.nt: the same bodies, steps and operation order. */
+#include <math.h>
+#include <stddef.h>
+
+#define PI 3.141592653589793
+#define SOLAR_MASS (4.0 * PI * PI)
+#define DAYS_PER_YEAR 365.24
+#define STEPS 2000000
+#define N_BODIES 5
+
+typedef struct {
+    double x, y, z, vx, vy, vz, mass;
+} Body;
+
+static Body body(double x, double y, double z, double vx, double vy, double vz, double mass) {
+    return (Body){ x, y, z, vx * DAYS_PER_YEAR, vy * DAYS_PER_YEAR, vz * DAYS_PER_YEAR, mass * SOLAR_MASS };
+}
+
+static void offset_momentum(Body *bs, size_t n) {
+    double px = 0.0, py = 0.0, pz = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        px += bs[i].vx * bs[i].mass;
+        py += bs[i].vy * bs[i].mass;
+        pz += bs[i].vz * bs[i].mass;
+    }
+    bs[0].vx = -px / SOLAR_MASS;
+    bs[0].vy = -py / SOLAR_MASS;
+    bs[0].vz = -pz / SOLAR_MASS;
+}
+
+static void advance(Body *bs, size_t n, double dt) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            double dx = bs[i].x - bs[j].x;
+            double dy = bs[i].y - bs[j].y;
+            double dz = bs[i].z - bs[j].z;
+            double d2 = dx * dx + dy * dy + dz * dz;
+            double mag = dt / (d2 * sqrt(d2));
+            double mi = bs[i].mass * mag;
+            double mj = bs[j].mass * mag;
+            bs[i].vx -= dx * mj;
+            bs[i].vy -= dy * mj;
+            bs[i].vz -= dz * mj;
+            bs[j].vx += dx * mi;
+            bs[j].vy += dy * mi;
+            bs[j].vz += dz * mi;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        bs[i].x += dt * bs[i].vx;
+        bs[i].y += dt * bs[i].vy;
+        bs[i].z += dt * bs[i].vz;
+    }
+}
+
+static double energy(const Body *bs, size_t n) {
+    double e = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        e += 0.5 * bs[i].mass * (bs[i].vx * bs[i].vx + bs[i].vy * bs[i].vy + bs[i].vz * bs[i].vz);
+        for (size_t j = i + 1; j < n; j++) {
+            double dx = bs[i].x - bs[j].x;
+            double dy = bs[i].y - bs[j].y;
+            double dz = bs[i].z - bs[j].z;
+            e -= bs[i].mass * bs[j].mass / sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return e;
+}
+
+int main(void) {
+    Body bs[N_BODIES] = {
+        body(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0),
+        body(4.84143144246472090e+00, -1.16032004402742839e+00, -1.03622044471123109e-01,
+             1.66007664274403694e-03, 7.69901118419740425e-03, -6.90460016972063023e-05, 9.54791938424326609e-04),
+        body(8.34336671824457987e+00, 4.12479856412430479e+00, -4.03523417114321381e-01,
+             -2.76742510726862411e-03, 4.99852801234917238e-03, 2.30417297573763929e-05, 2.85885980666130812e-04),
+        body(1.28943695621391310e+01, -1.51111514016986312e+01, -2.23307578892655734e-01,
+             2.96460137564761618e-03, 2.37847173959480950e-03, -2.96589568540237556e-05, 4.36624404335156298e-05),
+        body(1.53796971148509165e+01, -2.59193146099879641e+01, 1.79258772950371181e-01,
+             2.68067772490389322e-03, 1.62824170038242295e-03, -9.51592254519715870e-05, 5.15138902046611451e-05),
+    };
+    offset_momentum(bs, N_BODIES);
+    for (int s = 0; s < STEPS; s++) advance(bs, N_BODIES, 0.01);
+    long long digits = (long long)(-energy(bs, N_BODIES) * 1000000000.0 + 0.5);
+    return (int)(digits % 256);
+}
@@ -0,0 +1,19 @@
+/* Reference for sieve.nt. */
+#include <stdlib.h>
+#include <string.h>
+
+#define N 30000000u
+
+int main(void) {
+    unsigned char *composite = malloc(N);
+    memset(composite, 0, N);
+    size_t count = 0;
+    for (size_t i = 2; i < N; i++) {
+        if (composite[i] == 0) {
+            count++;
+            for (size_t j = i * i; j < N; j += i) composite[j] = 1;
+        }
+    }
+    free(composite);
+    return (int)(count % 256);
+}
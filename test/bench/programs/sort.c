@@ -0,0 +1,31 @@
+/* Reference for sort.nt: the same data and passes through qsort. */
+#include <stdint.h>
+#include <stdlib.h>
+
+#define N 4000000u
+
+static int ascending(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int descending(const void *a, const void *b) {
+    return ascending(b, a);
+}
+
+int main(void) {
+    int64_t *xs = malloc(N * sizeof(int64_t));
+    uint64_t s = 88172645463325252u;
+    for (size_t i = 0; i < N; i++) {
+        s = s * 6364136223846793005u + 1442695040888963407u;
+        xs[i] = (int64_t)(s / 65536) - 70368744177664;
+    }
+    qsort(xs, N, sizeof(int64_t), ascending);
+    qsort(xs, N, sizeof(int64_t), ascending);
+    qsort(xs, N, sizeof(int64_t), descending);
+    int64_t check = 0;
+    for (size_t i = 0; i < N; i += 4099) check += xs[i] % 1000;
+    free(xs);
+    if (check < 0) check = -check;
+    return (int)(check % 256);
+}
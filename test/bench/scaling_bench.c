@@ -0,0 +1,439 @@
+/*
+ * Scaling benchmarks: synthetic Newt programs whose size is set by N are
+ * generated at several N and compiled by the Newt compiler, and each
+ * phase's time and the compiler's peak RSS are reported against N. The
+ * correctness suites (parser_stress.inc, property_tests.c) never get big
+ * enough to show a phase that grows faster than its input; this does.
+ *
+ * Shapes:
+ *   deep       N modules in a chain, each importing the next
+ *   wide       one module importing N leaf modules
+ *   functions  N functions in one module, each calling the one before
+ *   nesting    one expression nested N parentheses deep
+ *   generics   N instantiations of generics over nested type arguments
+ *   overloads  one overload set of N functions, each called once
+ *
+ * Every program is compiled once with -T; the load (lex + parse), sema
+ * and backend (codegen + link) times come from its metrics and the peak
+ * RSS from wait4. Between two sizes the growth exponent
+ * log(t2 / t1) / log(n2 / n1) of each phase is printed: about 1 is linear,
+ * 2 quadratic. Exponents above SUPERLINEAR are flagged with '!'. Phases
+ * under NOISE_MS are too fast to fit and are shown as '-'.
+ *
+ * Results go to a JSON file (out/bench_scaling.json by default, or the
+ * path after --json) with one row per shape and N, ready to plot.
+ * --quick stops at smaller N. `--generate SHAPE N` only writes the program
+ * (for profiling with --stats, --mem-report or --trace) and prints its
+ * entry path. Names after the options select shapes. Built and run by
+ * `make bench-scaling`, from the repository root.
+ */
+#include "core/utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BUILD_DIR "out/bench_scaling_build"
+#define SUPERLINEAR 1.3
+#define NOISE_MS 2.0
+
+// --- Source buffers ---
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static void buf_printf(Buf *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data ? b->data + b->len : NULL, b->data ? b->cap - b->len : 0, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (b->data && b->len + (size_t)n < b->cap) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + (size_t)n + 1) cap *= 2;
+        b->data = realloc(b->data, cap);
+        if (!b->data) {
+            perror("bench: realloc");
+            exit(1);
+        }
+        b->cap = cap;
+    }
+}
+
+/* Write `b` to dir/name.nt and empty it; returns the bytes written. */
+static size_t buf_flush(Buf *b, const char *dir, const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.nt", dir, name);
+    FILE *f = fopen(path, "w");
+    if (!f || fwrite(b->data, 1, b->len, f) != b->len) {
+        fprintf(stderr, "bench: could not write %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+    size_t written = b->len;
+    b->len = 0;
+    return written;
+}
+
+// --- Shapes ---
+
+/* Each generator writes dir/main.nt (plus any modules) and returns the source bytes. */
+typedef size_t (*GenerateFn)(const char *dir, size_t n);
+
+// A few locals, a loop and a branch, so a body is more than a return
+static void emit_body(Buf *b, const char *result) {
+    buf_printf(b,
+        "    acc: i64 = x;\n"
+        "    i: i64 = 0;\n"
+        "    while (i < 3) {\n"
+        "        if (i %% 2 == 0) { acc = acc + i; } else { acc = acc - 1; }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return %s;\n", result);
+}
+
+static size_t generate_deep(const char *dir, size_t n) {
+    Buf b = {0};
+    size_t bytes = 0;
+    char name[32], result[64];
+    for (size_t i = 0; i < n; i++) {
+        if (i + 1 < n) buf_printf(&b, "import .m%zu { fn_%zu };\n\n", i + 1, i + 1);
+        buf_printf(&b, "pub fn fn_%zu(x: i64) -> i64 {\n", i);
+        if (i + 1 < n) snprintf(result, sizeof(result), "fn_%zu(acc) %% 1000", i + 1);
+        else snprintf(result, sizeof(result), "acc");
+        emit_body(&b, result);
+        buf_printf(&b, "}\n");
+        snprintf(name, sizeof(name), "m%zu", i);
+        bytes += buf_flush(&b, dir, name);
+    }
+    buf_printf(&b, "import .m0 { fn_0 };\n\nfn main() -> i32 {\n    return (fn_0(1) %% 100) as i32;\n}\n");
+    bytes += buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+static size_t generate_wide(const char *dir, size_t n) {
+    Buf b = {0};
+    size_t bytes = 0;
+    char name[32];
+    for (size_t i = 0; i < n; i++) {
+        buf_printf(&b, "pub fn fn_%zu(x: i64) -> i64 {\n", i);
+        emit_body(&b, "acc");
+        buf_printf(&b, "}\n");
+        snprintf(name, sizeof(name), "m%zu", i);
+        bytes += buf_flush(&b, dir, name);
+    }
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "import .m%zu { fn_%zu };\n", i, i);
+    buf_printf(&b, "\nfn main() -> i32 {\n    acc: i64 = 0;\n");
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "    acc = fn_%zu(acc) %% 1000;\n", i);
+    buf_printf(&b, "    return (acc %% 100) as i32;\n}\n");
+    bytes += buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+static size_t generate_functions(const char *dir, size_t n) {
+    Buf b = {0};
+    char result[64];
+    for (size_t i = 0; i < n; i++) {
+        buf_printf(&b, "fn fn_%zu(x: i64) -> i64 {\n", i);
+        if (i > 0) snprintf(result, sizeof(result), "fn_%zu(acc) %% 1000", i - 1);
+        else snprintf(result, sizeof(result), "acc");
+        emit_body(&b, result);
+        buf_printf(&b, "}\n\n");
+    }
+    buf_printf(&b, "fn main() -> i32 {\n    return (fn_%zu(1) %% 100) as i32;\n}\n", n - 1);
+    size_t bytes = buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+static size_t generate_nesting(const char *dir, size_t n) {
+    static const char ops[] = { '+', '*', '-', '+' };
+    Buf b = {0};
+    buf_printf(&b, "fn eval(x: i64) -> i64 {\n    return ");
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "(x %c ", ops[i % 4]);
+    buf_printf(&b, "1");
+    for (size_t i = 0; i < n; i++) buf_printf(&b, ")");
+    buf_printf(&b, ";\n}\n\nfn main() -> i32 {\n    return (eval(1) %% 100) as i32;\n}\n");
+    size_t bytes = buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+static size_t generate_generics(const char *dir, size_t n) {
+    Buf b = {0};
+    buf_printf(&b,
+        "struct Box<T> { v: T; }\n"
+        "struct Pair<A, B> { a: A; b: B; }\n\n"
+        "fn make<T>(x: T) -> Box<T> {\n"
+        "    b: Box<T>;\n"
+        "    b.v = x;\n"
+        "    return b;\n"
+        "}\n\n");
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "struct S%zu { v: i64; }\n", i);
+    buf_printf(&b, "\nfn main() -> i32 {\n    acc: i64 = 0;\n");
+    // Box<Pair<S, Box<S>>> per struct: three new instances, one of them nested two deep
+    for (size_t i = 0; i < n; i++) {
+        buf_printf(&b,
+            "    p%zu: Pair<S%zu, Box<S%zu>>;\n"
+            "    p%zu.a.v = %zu;\n"
+            "    q%zu: Box<Pair<S%zu, Box<S%zu>>> = make(p%zu);\n"
+            "    acc = (acc + q%zu.v.a.v) %% 1000;\n",
+            i, i, i, i, i % 7, i, i, i, i, i);
+    }
+    buf_printf(&b, "    return (acc %% 100) as i32;\n}\n");
+    size_t bytes = buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+static size_t generate_overloads(const char *dir, size_t n) {
+    Buf b = {0};
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "struct S%zu { v: i64; }\n", i);
+    buf_printf(&b, "\n");
+    for (size_t i = 0; i < n; i++) buf_printf(&b, "fn score(s: S%zu) -> i64 { return s.v + %zu; }\n", i, i % 5);
+    buf_printf(&b, "\nfn main() -> i32 {\n    acc: i64 = 0;\n");
+    for (size_t i = 0; i < n; i++) {
+        buf_printf(&b, "    s%zu: S%zu;\n    s%zu.v = acc;\n    acc = score(s%zu) %% 1000;\n", i, i, i, i);
+    }
+    buf_printf(&b, "    return (acc %% 100) as i32;\n}\n");
+    size_t bytes = buf_flush(&b, dir, "main");
+    free(b.data);
+    return bytes;
+}
+
+typedef struct {
+    const char *name;
+    GenerateFn generate;
+    size_t sizes[8];        // Full run, ascending, 0-terminated
+    size_t quick_sizes[8];  // --quick
+} Shape;
+
+static const Shape g_shapes[] = {
+    { "deep",      generate_deep,      { 32, 64, 128, 256, 512 },          { 16, 32, 64 } },
+    { "wide",      generate_wide,      { 32, 64, 128, 256, 512, 1024 },    { 16, 32, 64 } },
+    { "functions", generate_functions, { 256, 512, 1024, 2048, 4096 },     { 128, 256, 512 } },
+    { "nesting",   generate_nesting,   { 64, 128, 256, 512, 1024 },        { 32, 64, 128 } },
+    { "generics",  generate_generics,  { 32, 64, 128, 256, 512 },          { 16, 32, 64 } },
+    { "overloads", generate_overloads, { 32, 64, 128, 256, 512, 1024 },    { 16, 32, 64 } },
+};
+
+// --- Measurement ---
+
+typedef struct {
+    const char *shape;
+    size_t n;
+    size_t source_bytes;
+    double load_ms;
+    double sema_ms;
+    double backend_ms;
+    double wall_ms;
+    long max_rss_kb;
+    bool ok;
+} BenchResult;
+
+static BenchResult g_results[128];
+static size_t g_result_count;
+static bool g_failed;
+
+static const char *g_compiler = "out/compiler";
+
+static void make_dir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "bench: mkdir %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+}
+
+/* Value after `label` in the compiler's -T output, or -1. */
+static double metric(const char *output, const char *label) {
+    const char *at = strstr(output, label);
+    return at ? strtod(at + strlen(label), NULL) : -1.0;
+}
+
+/* Compile dir/main.nt with -T, its stdout captured in dir/metrics.txt. */
+static bool compile(const char *dir, BenchResult *r) {
+    char entry[512], binary[512], log_path[512];
+    snprintf(entry, sizeof(entry), "%s/main.nt", dir);
+    snprintf(binary, sizeof(binary), "%s/program", dir);
+    snprintf(log_path, sizeof(log_path), "%s/metrics.txt", dir);
+
+    double t0 = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int out_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) _exit(127);
+        dup2(out_fd, STDOUT_FILENO);
+        execl(g_compiler, g_compiler, entry, "-o", binary, "-T", (char*)NULL);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) return false;
+    r->wall_ms = (now_seconds() - t0) * 1e3;
+    r->max_rss_kb = usage.ru_maxrss;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+    char output[4096];
+    FILE *f = fopen(log_path, "r");
+    if (!f) return false;
+    size_t got = fread(output, 1, sizeof(output) - 1, f);
+    fclose(f);
+    output[got] = '\0';
+    r->load_ms = metric(output, "Time Parse/Load:");
+    r->sema_ms = metric(output, "Time Sema:");
+    r->backend_ms = metric(output, "Time Codegen:");
+    return r->load_ms >= 0 && r->sema_ms >= 0 && r->backend_ms >= 0;
+}
+
+/* Growth exponent of one phase between two sizes, NAN when too small to tell. */
+static double growth(double t1, double t2, size_t n1, size_t n2) {
+    if (t1 < NOISE_MS || t2 < NOISE_MS) return NAN;
+    return log(t2 / t1) / log((double)n2 / (double)n1);
+}
+
+static void print_growth(double g) {
+    if (isnan(g)) printf(" %6s", "-");
+    else printf(" %5.2f%c", g, g > SUPERLINEAR ? '!' : ' ');
+}
+
+static void print_result(const BenchResult *r, const BenchResult *prev) {
+    printf("%-10s %6zu %9.1f %9.2f %9.2f %10.2f %10ld", r->shape, r->n, r->source_bytes / 1024.0,
+           r->load_ms, r->sema_ms, r->backend_ms, r->max_rss_kb);
+    if (prev) {
+        print_growth(growth(prev->load_ms, r->load_ms, prev->n, r->n));
+        print_growth(growth(prev->sema_ms, r->sema_ms, prev->n, r->n));
+        print_growth(growth(prev->backend_ms, r->backend_ms, prev->n, r->n));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void shape_dir(char *out, size_t len, const Shape *s, size_t n) {
+    snprintf(out, len, "%s/%s_%zu", BUILD_DIR, s->name, n);
+}
+
+static void bench_shape(const Shape *s, bool quick) {
+    const size_t *sizes = quick ? s->quick_sizes : s->sizes;
+    const BenchResult *prev = NULL;
+    for (size_t i = 0; i < 8 && sizes[i]; i++) {
+        char dir[512];
+        shape_dir(dir, sizeof(dir), s, sizes[i]);
+        make_dir(dir);
+
+        BenchResult *r = &g_results[g_result_count++];
+        memset(r, 0, sizeof(*r));
+        r->shape = s->name;
+        r->n = sizes[i];
+        r->source_bytes = s->generate(dir, sizes[i]);
+        r->ok = compile(dir, r);
+        if (!r->ok) {
+            fprintf(stderr, "bench: %s failed to compile %s/main.nt\n", g_compiler, dir);
+            g_failed = true;
+            g_result_count--;
+            return; // Larger sizes would fail the same way
+        }
+        print_result(r, prev);
+        prev = r;
+    }
+}
+
+static bool write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"schema\": 1,\n  \"results\": [\n");
+    for (size_t i = 0; i < g_result_count; i++) {
+        const BenchResult *r = &g_results[i];
+        fprintf(f, "    {\"shape\": \"%s\", \"n\": %zu, \"source_bytes\": %zu, \"load_ms\": %.3f, \"sema_ms\": %.3f, "
+                   "\"backend_ms\": %.3f, \"wall_ms\": %.3f, \"max_rss_kb\": %ld}%s\n",
+                r->shape, r->n, r->source_bytes, r->load_ms, r->sema_ms, r->backend_ms, r->wall_ms, r->max_rss_kb,
+                i + 1 < g_result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+static const Shape *find_shape(const char *name) {
+    for (size_t i = 0; i < sizeof(g_shapes) / sizeof(g_shapes[0]); i++) {
+        if (strcmp(g_shapes[i].name, name) == 0) return &g_shapes[i];
+    }
+    return NULL;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--compiler PATH] [--json FILE] [--quick] [shape...]\n", argv0);
+    fprintf(stderr, "       %s --generate SHAPE N\n", argv0);
+    fprintf(stderr, "shapes:");
+    for (size_t i = 0; i < sizeof(g_shapes) / sizeof(g_shapes[0]); i++) fprintf(stderr, " %s", g_shapes[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    const char *json_path = "out/bench_scaling.json";
+    bool quick = false;
+    const Shape *only[16];
+    size_t only_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            g_compiler = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc) {
+            const Shape *s = find_shape(argv[i + 1]);
+            size_t n = strtoul(argv[i + 2], NULL, 10);
+            if (!s || n == 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            char dir[512];
+            make_dir(BUILD_DIR);
+            shape_dir(dir, sizeof(dir), s, n);
+            make_dir(dir);
+            s->generate(dir, n);
+            printf("%s/main.nt\n", dir);
+            return 0;
+        } else if (argv[i][0] != '-' && find_shape(argv[i]) && only_count < sizeof(only) / sizeof(only[0])) {
+            only[only_count++] = find_shape(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    make_dir(BUILD_DIR);
+    printf("%-10s %6s %9s %9s %9s %10s %10s %6s %6s %6s\n", "shape", "N", "src KB", "load ms", "sema ms",
+           "backend ms", "max RSS KB", "x load", "x sema", "x back");
+    fflush(stdout);
+    if (only_count == 0) {
+        for (size_t i = 0; i < sizeof(g_shapes) / sizeof(g_shapes[0]); i++) bench_shape(&g_shapes[i], quick);
+    } else {
+        for (size_t i = 0; i < only_count; i++) bench_shape(only[i], quick);
+    }
+
+    if (!write_json(json_path)) {
+        fprintf(stderr, "bench: could not write %s\n", json_path);
+        return 1;
+    }
+    printf("\nwrote %s\n", json_path);
+    return g_failed ? 1 : 0;
+}
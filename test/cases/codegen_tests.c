@@ -25,12 +25,26 @@ TEST_CASE_PRIO("Codegen: Loops", 40) {
     return 1;
 }
 
+// Unknown -march / --target-features names are an error before any machine is built
+TEST_CASE_PRIO("Codegen: Target Names", 40) {
+    ASSERT(codegen_check_target(NULL, NULL));
+    ASSERT(codegen_check_target("native", NULL));
+    ASSERT(codegen_check_target("generic", NULL));
+    ASSERT(!codegen_check_target("no-such-cpu", NULL));
+    ASSERT(!codegen_check_target(NULL, "+no-such-feature"));
+    ASSERT(!codegen_check_target("generic", "-no-such-feature"));
+    return 1;
+}
+
 #define CODEGEN_EXIT(name, src, expected) \
     TEST_CASE_PRIO("Codegen/" name, 40) { ASSERT_EQ_INT(test_run_and_get_exit_code(src), expected); return 1; }
 
 #define CODEGEN_OUTPUT(name, src, expected_exit, expected_out) \
     TEST_CASE_PRIO("Codegen/Output/" name, 40) { ASSERT(test_check_codegen_output(src, expected_exit, expected_out)); return 1; }
 
+#define CODEGEN_IR(name, src, strict, needle, expected) \
+    TEST_CASE_PRIO("Codegen/IR/" name, 40) { ASSERT(test_codegen_ir_contains(src, strict, needle) == (expected)); return 1; }
+
 CODEGEN_OUTPUT("print_hello", "fn main() -> i32 { print(\"Hello, World!\"); return 0; }", 0, "Hello, World!")
 
 #include "codegen_abi.inc"
@@ -45,5 +59,7 @@ CODEGEN_OUTPUT("print_hello", "fn main() -> i32 { print(\"Hello, World!\"); retu
 #include "codegen_defer.inc"
 #include "codegen_generics.inc"
 #include "codegen_std.inc"
+#include "codegen_const.inc"
 
 #undef CODEGEN_EXIT
+#undef CODEGEN_IR
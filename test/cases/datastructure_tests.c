@@ -0,0 +1,563 @@
+#include "../harness/test_harness.h"
+#include "datastructures/arena.h"
+#include "datastructures/hash_map.h"
+#include "datastructures/dense_arena_interner.h"
+#include "datastructures/scope.h"
+#include "parsing/ast.h"
+#include "core/stats.h"
+#include "core/mem_report.h"
+#include <pthread.h>
+
+// --- Arena ---
+
+TEST_CASE_PRIO("Arena: Rewind Releases Everything After the Mark", 5) {
+    Arena *arena = arena_create(256);
+    int *kept = arena_alloc(arena, sizeof(int));
+    *kept = 42;
+    ArenaMark mark = arena_mark(arena);
+    size_t used = arena_bytes_used(arena);
+
+    // Spill into several new blocks, including an oversized one
+    for (int i = 0; i < 64; i++) ASSERT(arena_alloc(arena, 100) != NULL);
+    ASSERT(arena_alloc(arena, 4096) != NULL);
+    ASSERT(arena_block_count(arena) > 1);
+
+    arena_rewind(arena, mark);
+    ASSERT_EQ_INT(arena_block_count(arena), 1);
+    ASSERT_EQ_INT(arena_bytes_used(arena), used);
+    ASSERT_EQ_INT(*kept, 42);
+
+    // The mark's block is bumped from the same spot again
+    ASSERT(arena_alloc(arena, 8) != NULL);
+    ASSERT_EQ_INT(arena_block_count(arena), 1);
+    ASSERT(arena_bytes_used(arena) > used);
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Arena: Scratch Regions Nest", 5) {
+    ArenaScratch outer = arena_scratch_begin();
+    size_t base_used = arena_bytes_used(outer.arena);
+    char *a = arena_alloc(outer.arena, 32);
+    memset(a, 'a', 32);
+    size_t outer_used = arena_bytes_used(outer.arena);
+
+    ArenaScratch inner = arena_scratch_begin();
+    ASSERT(inner.arena == outer.arena);
+    for (int i = 0; i < 100; i++) memset(arena_alloc(inner.arena, 4096), 'b', 4096);
+    arena_scratch_end(inner);
+
+    ASSERT_EQ_INT(arena_bytes_used(outer.arena), outer_used);
+    for (int i = 0; i < 32; i++) ASSERT(a[i] == 'a');
+    arena_scratch_end(outer);
+    ASSERT_EQ_INT(arena_bytes_used(outer.arena), base_used);
+    return 1;
+}
+
+TEST_CASE_PRIO("Arena: Blocks Grow Geometrically and Are Recycled by Reset", 5) {
+    Arena *arena = arena_create(1024);
+    for (int i = 0; i < 200; i++) ASSERT(arena_alloc(arena, 100) != NULL);
+
+    // 1 KiB, 1 KiB, 2 KiB, 4 KiB, ... instead of twenty 1 KiB blocks
+    size_t blocks = arena_block_count(arena);
+    ASSERT(blocks <= 6);
+    ASSERT(arena->next_block_size > 1024);
+
+    arena_reset(arena);
+    ASSERT_EQ_INT(arena_block_count(arena), 1);
+    ASSERT(arena->free_blocks != NULL);
+
+    // Refilling takes the parked blocks back before asking for memory
+    size_t next = arena->next_block_size;
+    for (int i = 0; i < 200; i++) ASSERT(arena_alloc(arena, 100) != NULL);
+    ASSERT_EQ_INT(arena->next_block_size, next);
+    ASSERT(arena_block_count(arena) > 1);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Arena: Adopted Arenas Stay Usable Until the Owner Goes", 5) {
+    Arena *owner = arena_create(1024);
+    Arena *worker = arena_create(1024);
+    Arena *nested = arena_create(1024);
+    arena_adopt(worker, nested);
+
+    // A table a worker filled keeps growing after the hand-over
+    HashMap *map = hashmap_create(worker, 4);
+    for (uintptr_t i = 1; i <= 8; i++) ASSERT(ptrmap_put(map, (void*)i, (void*)(i * 10)));
+    size_t worker_used = arena_bytes_used(worker);
+    arena_adopt(owner, worker);
+    ASSERT(arena_bytes_used(owner) >= worker_used);
+
+    for (uintptr_t i = 9; i <= 512; i++) ASSERT(ptrmap_put(map, (void*)i, (void*)(i * 10)));
+    for (uintptr_t i = 1; i <= 512; i++) ASSERT(ptrmap_get(map, (void*)i) == (void*)(i * 10));
+    ASSERT(arena_alloc(nested, 64) != NULL);
+
+    // Merging the owner hands its adopted arenas on as well
+    Arena *root = arena_create(1024);
+    arena_merge(root, owner);
+    ASSERT(arena_bytes_used(root) > worker_used);
+    arena_destroy(root); // Frees worker and nested too (checked by the ASan run)
+    return 1;
+}
+
+TEST_CASE_PRIO("Arena: Mapped and Huge-Page Backings", 5) {
+    static const ArenaBacking backings[] = { ARENA_MMAP, ARENA_HUGE_PAGES, ARENA_HUGETLB };
+    for (size_t k = 0; k < sizeof(backings) / sizeof(backings[0]); k++) {
+        Arena *arena = arena_create_backed(64 * 1024, backings[k]);
+        ASSERT(arena != NULL);
+        char *big = arena_alloc(arena, 3 * 1024 * 1024);
+        ASSERT(big != NULL);
+        memset(big, 0x5a, 3 * 1024 * 1024);
+        for (int i = 0; i < 1000; i++) {
+            int *p = arena_calloc(arena, sizeof(int) * 16);
+            ASSERT(p != NULL && p[15] == 0);
+            p[15] = i;
+        }
+        ASSERT(big[3 * 1024 * 1024 - 1] == 0x5a);
+        arena_reset(arena);
+        ASSERT(arena_alloc(arena, 1024) != NULL);
+        arena_destroy(arena);
+    }
+    return 1;
+}
+
+// --- DynArray ---
+
+TEST_CASE_PRIO("DynArray: Typed Access and Foreach", 5) {
+    DynArray arr;
+    dynarray_init(&arr, sizeof(int));
+    for (int i = 0; i < 100; i++) dynarray_push_value(&arr, &i);
+
+    ASSERT_EQ_INT(DYNARRAY_AT(int, &arr, 42), 42);
+    DYNARRAY_AT(int, &arr, 42) = -1;
+    ASSERT_EQ_INT(*(int*)dynarray_get(&arr, 42), -1);
+    ASSERT(dynarray_at(&arr, 99) == dynarray_get(&arr, 99));
+
+    int sum = 0, visited = 0;
+    DYNARRAY_FOREACH(int, it, &arr) {
+        sum += *it;
+        visited++;
+    }
+    ASSERT_EQ_INT(visited, 100);
+    ASSERT_EQ_INT(sum, 99 * 100 / 2 - 43);
+
+    // Pointer elements, and a NULL array walks nothing
+    DynArray ptrs;
+    dynarray_init(&ptrs, sizeof(int*));
+    for (int i = 0; i < 3; i++) dynarray_push_ptr(&ptrs, dynarray_at(&arr, (size_t)i));
+    visited = 0;
+    DYNARRAY_FOREACH(int*, it, &ptrs) {
+        ASSERT(*it == &DYNARRAY_AT(int, &arr, visited));
+        visited++;
+    }
+    ASSERT_EQ_INT(visited, 3);
+
+    DynArray *none = NULL;
+    DYNARRAY_FOREACH(int*, it, none) visited++;
+    ASSERT_EQ_INT(visited, 3);
+
+    dynarray_free(&ptrs);
+    dynarray_free(&arr);
+    return 1;
+}
+
+// --- HashMap ---
+
+#define MAP_KEYS 5000
+
+static size_t int_key_hash(void *k) { return (size_t)(uintptr_t)k; }
+static int int_key_cmp(void *a, void *b) { return (a > b) - (a < b); }
+#define INT_KEY(i) ((void*)(uintptr_t)((i) + 1))
+
+TEST_CASE_PRIO("HashMap: Put, Update and Get Across Growth", 5) {
+    HashMap *map = hashmap_create(NULL, 4);
+    ASSERT(map != NULL);
+    ASSERT_EQ_INT(map->capacity, HASHMAP_GROUP_WIDTH);
+
+    for (int i = 0; i < MAP_KEYS; i++) ASSERT(hashmap_put(map, INT_KEY(i), INT_KEY(i * 2), int_key_hash, int_key_cmp));
+    ASSERT_EQ_INT(hashmap_size(map), MAP_KEYS);
+    ASSERT((map->capacity & (map->capacity - 1)) == 0);
+
+    for (int i = 0; i < MAP_KEYS; i += 2) ASSERT(hashmap_put(map, INT_KEY(i), INT_KEY(i * 3), int_key_hash, int_key_cmp));
+    ASSERT_EQ_INT(hashmap_size(map), MAP_KEYS);
+    for (int i = 0; i < MAP_KEYS; i++) {
+        void *expected = INT_KEY(i % 2 == 0 ? i * 3 : i * 2);
+        ASSERT(hashmap_get(map, INT_KEY(i), int_key_hash, int_key_cmp) == expected);
+    }
+    ASSERT(hashmap_get(map, INT_KEY(MAP_KEYS), int_key_hash, int_key_cmp) == NULL);
+
+    hashmap_destroy(map, NULL, NULL);
+    return 1;
+}
+
+TEST_CASE_PRIO("HashMap: Remove and Reinsert Churn", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    HashMap *map = hashmap_create(arena, 64);
+
+    // Constant live size with steady removals: tombstones must be recycled
+    // instead of forcing the table to grow without bound.
+    for (int round = 0; round < 40; round++) {
+        for (int i = 0; i < 40; i++) ASSERT(hashmap_put(map, INT_KEY(round * 40 + i), INT_KEY(i), int_key_hash, int_key_cmp));
+        for (int i = 0; i < 40; i++) {
+            ASSERT(hashmap_remove(map, INT_KEY(round * 40 + i), int_key_hash, int_key_cmp, NULL, NULL));
+        }
+        ASSERT(!hashmap_remove(map, INT_KEY(round * 40), int_key_hash, int_key_cmp, NULL, NULL));
+        ASSERT_EQ_INT(hashmap_size(map), 0);
+    }
+    ASSERT(map->capacity <= 128);
+
+    for (int i = 0; i < 100; i++) hashmap_put(map, INT_KEY(i), INT_KEY(i), int_key_hash, int_key_cmp);
+    for (int i = 0; i < 100; i += 3) hashmap_remove(map, INT_KEY(i), int_key_hash, int_key_cmp, NULL, NULL);
+    for (int i = 0; i < 100; i++) {
+        void *v = hashmap_get(map, INT_KEY(i), int_key_hash, int_key_cmp);
+        ASSERT(v == (i % 3 == 0 ? NULL : INT_KEY(i)));
+    }
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("HashMap: Iteration Visits Each Entry Once", 5) {
+    HashMap *map = hashmap_create(NULL, 16);
+    for (int i = 0; i < 300; i++) hashmap_put(map, INT_KEY(i), INT_KEY(i), int_key_hash, int_key_cmp);
+    for (int i = 0; i < 300; i += 5) hashmap_remove(map, INT_KEY(i), int_key_hash, int_key_cmp, NULL, NULL);
+
+    static int seen[300];
+    memset(seen, 0, sizeof(seen));
+    size_t visited = 0;
+    void *key, *value;
+    for (size_t cursor = 0; hashmap_next(map, &cursor, &key, &value); visited++) {
+        ASSERT(key == value);
+        seen[(uintptr_t)key - 1]++;
+    }
+    ASSERT_EQ_INT(visited, hashmap_size(map));
+    for (int i = 0; i < 300; i++) ASSERT_EQ_INT(seen[i], i % 5 == 0 ? 0 : 1);
+
+    hashmap_destroy(map, NULL, NULL);
+    return 1;
+}
+
+TEST_CASE_PRIO("HashMap: Pointer-Keyed Entry Points Share the Table", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    HashMap *map = hashmap_create(arena, 16);
+    static char nodes[600][24];
+
+    for (int i = 0; i < 600; i++) {
+        if (i % 2) ASSERT(ptrmap_put(map, nodes[i], INT_KEY(i)));
+        else ASSERT(hashmap_put(map, nodes[i], INT_KEY(i), ptr_hash, ptr_cmp));
+    }
+    for (int i = 0; i < 600; i++) {
+        ASSERT(ptrmap_get(map, nodes[i]) == INT_KEY(i));
+        ASSERT(hashmap_get(map, nodes[i], ptr_hash, ptr_cmp) == INT_KEY(i));
+    }
+    for (int i = 0; i < 600; i += 4) ASSERT(ptrmap_remove(map, nodes[i]));
+    ASSERT(!ptrmap_remove(map, nodes[0]));
+    ASSERT_EQ_INT(hashmap_size(map), 450);
+
+    // Batched lookup: hits, removed keys, an unknown key and NULL
+    void *keys[40], *values[40];
+    for (int i = 0; i < 38; i++) keys[i] = nodes[i];
+    keys[38] = &nodes[599][1];
+    keys[39] = NULL;
+    ASSERT_EQ_INT(ptrmap_get_many(map, keys, values, 40), 28);
+    for (int i = 0; i < 38; i++) ASSERT(values[i] == (i % 4 == 0 ? NULL : INT_KEY(i)));
+    ASSERT(values[38] == NULL && values[39] == NULL);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+// --- Concurrent interner ---
+
+#define INTERN_THREADS 4
+#define INTERN_KEYS    2000
+
+typedef struct {
+    DenseArenaInterner *interner;
+    int offset;
+    InternResult *results[INTERN_KEYS];
+} InternWorkerArgs;
+
+static void make_key(char *buf, size_t cap, int i) {
+    snprintf(buf, cap, "ident_%d", i);
+}
+
+static void *intern_worker(void *arg) {
+    InternWorkerArgs *a = arg;
+    char buf[32];
+    // Each thread walks the same key set from a different starting point so
+    // inserts of the same key race with each other.
+    for (int n = 0; n < INTERN_KEYS; n++) {
+        int i = (n + a->offset) % INTERN_KEYS;
+        make_key(buf, sizeof(buf), i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        a->results[i] = intern(a->interner, &s, NULL);
+    }
+    return NULL;
+}
+
+TEST_CASE_PRIO("Interner: Concurrent Mode Deduplicates Across Threads", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 64), arena, string_copy_func, slice_hash, slice_cmp);
+
+    Slice pre = { "ident_0", 7 };
+    InternResult *pre_res = intern(in, &pre, NULL);
+
+    ASSERT(intern_table_begin_concurrent(in, 8));
+
+    static InternWorkerArgs args[INTERN_THREADS];
+    pthread_t threads[INTERN_THREADS];
+    for (int t = 0; t < INTERN_THREADS; t++) {
+        args[t].interner = in;
+        args[t].offset = t * (INTERN_KEYS / INTERN_THREADS);
+        ASSERT(pthread_create(&threads[t], NULL, intern_worker, &args[t]) == 0);
+    }
+    for (int t = 0; t < INTERN_THREADS; t++) pthread_join(threads[t], NULL);
+
+    intern_table_end_concurrent(in);
+
+    // Every thread must have observed the same canonical record per key.
+    for (int i = 0; i < INTERN_KEYS; i++) {
+        ASSERT(args[0].results[i] != NULL);
+        for (int t = 1; t < INTERN_THREADS; t++) ASSERT(args[t].results[i] == args[0].results[i]);
+    }
+    ASSERT(args[0].results[0] == pre_res);
+    ASSERT_EQ_INT(in->dense_index_count, INTERN_KEYS);
+
+    // Dense indices stay a bijection onto 0..N-1.
+    for (int idx = 0; idx < INTERN_KEYS; idx++) {
+        InternResult *r = interner_get_result(in, idx);
+        ASSERT(r != NULL);
+        ASSERT_EQ_INT(r->entry->dense_index, idx);
+        ASSERT(interner_get_cstr(in, idx) == ((Slice*)r->key)->ptr);
+    }
+
+    // After folding the shards back, plain lookups see every key.
+    char buf[32];
+    for (int i = 0; i < INTERN_KEYS; i++) {
+        make_key(buf, sizeof(buf), i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        ASSERT(intern_peek(in, &s) == args[0].results[i]);
+    }
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Interner: Dense Index Maps Back to Key and Meta", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 16), arena, string_copy_func, slice_hash, slice_cmp);
+
+    char buf[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(buf, sizeof(buf), "name_%d", i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        ASSERT_EQ_INT(intern_idx(in, &s, (void*)(uintptr_t)(i + 1)), i);
+    }
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(buf, sizeof(buf), "name_%d", i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        InternResult *rec = intern_peek(in, &s);
+        ASSERT(rec == interner_get_result(in, i));
+        // Re-interning returns the same record and keeps the first meta
+        ASSERT(intern(in, &s, NULL) == rec);
+        ASSERT(rec->entry->meta == (void*)(uintptr_t)(i + 1));
+
+        const Slice *key = rec->key;
+        ASSERT(slice_cmp((void*)key, &s) == 0);
+        ASSERT(key->ptr[key->len] == '\0');
+        ASSERT(interner_get_cstr(in, i) == key->ptr);
+    }
+    Slice absent = { "name_500", 8 };
+    ASSERT(intern_peek(in, &absent) == NULL);
+    ASSERT(interner_get_cstr(in, 500) == NULL);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+static size_t g_slice_hash_calls;
+
+static size_t counting_slice_hash(void *key) {
+    g_slice_hash_calls++;
+    return slice_hash(key);
+}
+
+TEST_CASE_PRIO("Interner: Keys Are Hashed Once, Even Across Table Growth", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 16), arena, string_copy_func,
+                                                 counting_slice_hash, slice_cmp);
+    g_slice_hash_calls = 0;
+
+    // Enough keys to rebuild the table several times over
+    char buf[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(buf, sizeof(buf), "identifier_%d", i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        ASSERT(intern(in, &s, NULL) != NULL);
+    }
+    ASSERT(in->hashmap->capacity >= 2048);
+    ASSERT_EQ_INT((int)g_slice_hash_calls, 2000);
+
+    for (int i = 0; i < 2000; i++) {
+        snprintf(buf, sizeof(buf), "identifier_%d", i);
+        Slice s = { buf, (uint32_t)strlen(buf) };
+        InternResult *r = intern_peek(in, &s);
+        ASSERT(r != NULL);
+        ASSERT_EQ_INT(r->entry->dense_index, i);
+        ASSERT(slice_hash(r->key) == slice_hash(&s));
+    }
+
+    // str_hash and slice_hash agree on the same bytes, at every length class
+    static const char *texts[] = { "", "a", "fn", "abc", "main", "println", "a_16_byte_ident_",
+                                   "seventeen_bytes__", "a_much_longer_identifier_spanning_blocks" };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        Slice s = { texts[i], (uint32_t)strlen(texts[i]) };
+        ASSERT(str_hash((void*)texts[i]) == slice_hash(&s));
+    }
+    // Prefixes of one string must not collide systematically
+    const char *base = texts[8];
+    for (uint32_t len = 1; len < strlen(base); len++) {
+        Slice a = { base, len }, b = { base, len + 1 };
+        ASSERT(slice_hash(&a) != slice_hash(&b));
+    }
+
+    arena_destroy(arena);
+    return 1;
+}
+
+// --- Scope ---
+
+static InternResult *scope_name(DenseArenaInterner *in, const char *name) {
+    Slice s = { name, (uint32_t)strlen(name) };
+    return intern(in, &s, NULL);
+}
+
+TEST_CASE_PRIO("Scope: Local Bindings Shadow, Pop on Exit and Stay Per Function", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 64), arena, string_copy_func, slice_hash, slice_cmp);
+    InternResult *x = scope_name(in, "x");
+    InternResult *y = scope_name(in, "y");
+
+    Scope *global = scope_create(arena, NULL, 8, SCOPE_IDENTIFIERS);
+    Symbol *gx = scope_define_symbol(global, x, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL);
+
+    SymbolTable *table = symbol_table_create(arena, in->dense_index_count);
+    Scope *fn = scope_create_local(table, global);
+    Symbol *fx = scope_define_symbol(fn, x, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL);
+    ASSERT(fx && fx != gx);
+    ASSERT(scope_define_symbol(fn, x, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL) == NULL);
+
+    Scope *block = scope_create_local(table, fn);
+    Symbol *bx = scope_define_symbol(block, x, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL);
+    Symbol *by = scope_define_symbol(block, y, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL);
+    ASSERT(scope_lookup_symbol(block, x, SOURCE_NONE) == bx);
+    ASSERT(scope_lookup_symbol(block, y, SOURCE_NONE) == by);
+    ASSERT(scope_lookup_symbol(fn, x, SOURCE_NONE) == fx);
+    ASSERT(scope_lookup_symbol_local(fn, y) == NULL);
+
+    // Another function body checked meanwhile must not see these locals
+    Scope *other = scope_create_local(table, global);
+    ASSERT(scope_lookup_symbol(other, x, SOURCE_NONE) == gx);
+    ASSERT(scope_lookup_symbol(other, y, SOURCE_NONE) == NULL);
+    scope_exit(other);
+
+    scope_exit(block);
+    ASSERT(scope_lookup_symbol(fn, x, SOURCE_NONE) == fx);
+    ASSERT(scope_lookup_symbol(fn, y, SOURCE_NONE) == NULL);
+
+    Scope *sibling = scope_create_local(table, fn);
+    ASSERT(scope_lookup_symbol(sibling, y, SOURCE_NONE) == NULL);
+    ASSERT(scope_define_symbol(sibling, y, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL) != NULL);
+    scope_exit(sibling);
+
+    scope_exit(fn);
+    ASSERT(scope_lookup_symbol(fn, x, SOURCE_NONE) == gx);
+    ASSERT(table->heads[x->entry->dense_index] == NULL);
+    ASSERT(table->heads[y->entry->dense_index] == NULL);
+
+    // Names interned after the table was sized grow it on demand
+    Scope *late = scope_create_local(table, global);
+    char buf[32];
+    for (int i = 0; i < 300; i++) {
+        snprintf(buf, sizeof(buf), "late_%d", i);
+        ASSERT(scope_define_symbol(late, scope_name(in, buf), NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL) != NULL);
+    }
+    for (int i = 0; i < 300; i++) {
+        snprintf(buf, sizeof(buf), "late_%d", i);
+        Symbol *sym = scope_lookup_symbol(late, scope_name(in, buf), SOURCE_NONE);
+        ASSERT(sym && sym->name_rec == scope_name(in, buf));
+    }
+    ASSERT_EQ_INT(scope_get_symbol_count(late), 300);
+    scope_exit(late);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+// --- Stats ---
+
+TEST_CASE_PRIO("Stats: Counters Track Interning and Scope Walks", 5) {
+    ASSERT(stats_enabled()); // The test build is a dev build
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *in = intern_table_create(hashmap_create(arena, 64), arena, string_copy_func, slice_hash, slice_cmp);
+    Scope *global = scope_create(arena, NULL, 16, SCOPE_IDENTIFIERS);
+    Scope *inner = scope_create(arena, global, 16, SCOPE_IDENTIFIERS);
+    InternResult *x = scope_name(in, "x");
+    ASSERT(scope_define_symbol(global, x, NULL, SYMBOL_VARIABLE, SOURCE_NONE, false, NULL) != NULL);
+
+    stats_reset();
+    ASSERT(scope_name(in, "x") == x);
+    ASSERT(scope_name(in, "y") != NULL);
+    ASSERT_EQ_INT(stats_get(STAT_INTERN_HITS), 1);
+    ASSERT_EQ_INT(stats_get(STAT_INTERN_MISSES), 1);
+
+    // Found one scope up: both scopes are walked
+    ASSERT(scope_lookup_symbol(inner, x, SOURCE_NONE) != NULL);
+    ASSERT_EQ_INT(stats_get(STAT_SCOPE_LOOKUPS), 1);
+    ASSERT_EQ_INT(stats_get(STAT_SCOPE_WALKED), 2);
+    ASSERT_EQ_INT(stats_get(STAT_SCOPE_DEPTH_MAX), 2);
+    ASSERT(stats_get(STAT_HASHMAP_LOOKUPS) >= 3);
+
+    stats_reset();
+    ASSERT_EQ_INT(stats_get(STAT_SCOPE_WALKED), 0);
+    ASSERT(strcmp(stats_name(STAT_SCOPE_WALKED), "scope.walked") == 0);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("MemReport: Allocations Are Tallied by Category, Kind and Module", 5) {
+    Arena *arena = arena_create(64 * 1024);
+    mem_report_start();
+    AstNode *call = ast_create_node(AST_CALL_EXPR, arena, (SourceId)3);
+    AstNode *ident = ast_create_node(AST_IDENTIFIER, arena, (SourceId)3);
+    ASSERT(call && ident);
+    HashMap *map = hashmap_create(arena, 16);
+    ASSERT(map != NULL);
+
+    SourceId previous = mem_report_set_source((SourceId)5);
+    mem_account(MEM_SYMBOLS, MEM_KIND_NONE, SOURCE_NONE, 100, 2);
+    mem_report_set_source(previous);
+    mem_report_stop();
+    ast_create_node(AST_CALL_EXPR, arena, (SourceId)3); // Not recorded once stopped
+
+    ASSERT_EQ_INT(mem_report_kind(MEM_AST, AST_CALL_EXPR).count, 1);
+    ASSERT_EQ_INT(mem_report_kind(MEM_AST, AST_CALL_EXPR).bytes, ast_node_size(AST_CALL_EXPR));
+    ASSERT_EQ_INT(mem_report_category(MEM_AST).count, 2);
+    ASSERT_EQ_INT(mem_report_module((SourceId)3, MEM_AST).bytes, ast_node_size(AST_CALL_EXPR) + ast_node_size(AST_IDENTIFIER));
+    ASSERT_EQ_INT(mem_report_category(MEM_HASHMAP).count, 1);
+    ASSERT(mem_report_category(MEM_HASHMAP).bytes > sizeof(HashMap));
+    ASSERT_EQ_INT(mem_report_module((SourceId)5, MEM_SYMBOLS).bytes, 100);
+    ASSERT_EQ_INT(mem_report_module((SourceId)5, MEM_SYMBOLS).count, 2);
+    ASSERT(mem_report_module_limit() == 6);
+
+    mem_report_start();
+    ASSERT_EQ_INT(mem_report_category(MEM_AST).bytes, 0);
+    mem_report_stop();
+    arena_destroy(arena);
+    return 1;
+}
@@ -18,3 +18,189 @@ TEST_CASE_PRIO("Lexer: Long Identifier Stress", 10) {
     arena_destroy(arena);
     return 1;
 }
+
+TEST_CASE_PRIO("Lexer: Keywords Classify Without the Identifier Table", 10) {
+    Arena *arena = arena_create(1024 * 1024);
+    static const char src[] =
+        "fn if else while for return break continue defer const pub import alias struct enum impl as "
+        "i8 i16 i32 i64 u8 u16 u32 u64 bool f32 f64 str char usize isize void true false null switch case async await "
+        "fnx i9 u128 f16 Fn elsf continu continues strs _as";
+    static const TokenKind expected[] = {
+        TOK_FN, TOK_IF, TOK_ELSE, TOK_WHILE, TOK_FOR, TOK_RETURN, TOK_BREAK, TOK_CONTINUE, TOK_DEFER,
+        TOK_CONST, TOK_PUB, TOK_IMPORT, TOK_ALIAS, TOK_STRUCT, TOK_ENUM, TOK_IMPL, TOK_AS,
+        TOK_I8, TOK_I16, TOK_I32, TOK_I64, TOK_U8, TOK_U16, TOK_U32, TOK_U64, TOK_BOOL, TOK_F32,
+        TOK_F64, TOK_STRING, TOK_CHAR, TOK_USIZE, TOK_ISIZE, TOK_VOID, TOK_TRUE, TOK_FALSE, TOK_NULL,
+        TOK_SWITCH, TOK_CASE, TOK_ASYNC, TOK_AWAIT,
+    };
+    const size_t keyword_count = sizeof(expected) / sizeof(expected[0]);
+    const size_t near_misses = 10;
+
+    Lexer *lexer = lexer_create(src, strlen(src), arena);
+    ASSERT(lexer && lexer_lex_all(lexer));
+    size_t count = 0;
+    Token *tokens = lexer_get_tokens(lexer, &count);
+    ASSERT_EQ_INT((int)count, (int)(keyword_count + near_misses + 1));
+
+    for (size_t i = 0; i < keyword_count; i++) {
+        ASSERT_EQ_INT(tokens[i].type, expected[i]);
+        // Sema looks keyword records up by spelling, so the token must carry that record
+        ASSERT(tokens[i].record != NULL);
+        Slice spelling = token_slice(lexer->source, &tokens[i]);
+        ASSERT(tokens[i].record == intern_peek(lexer->keywords, &spelling));
+    }
+    for (size_t i = keyword_count; i < keyword_count + near_misses; i++) {
+        ASSERT_EQ_INT(tokens[i].type, TOK_IDENTIFIER);
+        Slice spelling = token_slice(lexer->source, &tokens[i]);
+        ASSERT(intern_peek(lexer->keywords, &spelling) == NULL);
+    }
+    // Only the near misses were interned as identifiers
+    ASSERT_EQ_INT(lexer->identifiers->dense_index_count, (int)near_misses);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Lexer: Block Scanning Keeps Lines and Columns Exact", 10) {
+    Arena *arena = arena_create(1024 * 1024);
+    // Runs longer than any scan block, comments spanning lines, and an
+    // identifier that ends right at the end of input
+    char src[512];
+    size_t len = 0;
+    src[len++] = 'a';
+    for (int i = 0; i < 49; i++) src[len++] = ' ';
+    len += (size_t)sprintf(src + len, "b\n");
+    for (int i = 0; i < 35; i++) src[len++] = '\t';
+    len += (size_t)sprintf(src + len, "c // to the end of the line\n");
+    len += (size_t)sprintf(src + len, "/* one\n two\n three */ d /**/ e /* * / ** */ f\n");
+    for (int i = 0; i < 34; i++) src[len++] = '\n';
+    len += (size_t)sprintf(src + len, "     an_identifier_that_is_much_longer_than_thirty_two_bytes_x9");
+
+    static const struct { size_t line, col, len; } expected[] = {
+        { 1, 1, 1 }, { 1, 51, 1 }, { 2, 36, 1 }, { 5, 11, 1 }, { 5, 18, 1 }, { 5, 33, 1 }, { 40, 6, 58 },
+    };
+    const size_t n = sizeof(expected) / sizeof(expected[0]);
+
+    Lexer *lexer = lexer_create(src, len, arena);
+    ASSERT(lexer && lexer_lex_all(lexer));
+    size_t count = 0;
+    Token *tokens = lexer_get_tokens(lexer, &count);
+    ASSERT_EQ_INT((int)count, (int)n + 1);
+    for (size_t i = 0; i < n; i++) {
+        ASSERT_EQ_INT(tokens[i].type, TOK_IDENTIFIER);
+        SourcePos pos = span_start_pos(token_span(lexer->file, &tokens[i]));
+        ASSERT_EQ_INT((int)pos.line, (int)expected[i].line);
+        ASSERT_EQ_INT((int)pos.col, (int)expected[i].col);
+        ASSERT_EQ_INT((int)tokens[i].len, (int)expected[i].len);
+    }
+    ASSERT_EQ_INT(tokens[n].type, TOK_EOF);
+    ASSERT_EQ_INT((int)span_start_pos(token_span(lexer->file, &tokens[n])).col, 64);
+    ASSERT_EQ_INT((int)lexer->pos, (int)len);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Lexer: Numeric Literals Carry Their Decoded Value", 10) {
+    Arena *arena = arena_create(1024 * 1024);
+    const char *src = "0 1_000 0xDEAD_beef 0b1010_1100 18446744073709551615 "
+                      "18446744073709551616 0x1_0000_0000_0000_0000 0x_ 12.5 1_000.25 2.5e-3 'A' 7.x";
+    Lexer *lexer = lexer_create(src, strlen(src), arena);
+    ASSERT(lexer && lexer_lex_all(lexer));
+    size_t count = 0;
+    Token *tokens = lexer_get_tokens(lexer, &count);
+    ASSERT_EQ_INT((int)count, 16);
+
+    static const uint64_t ints[] = { 0, 1000, 0xDEADBEEF, 0xAC, UINT64_MAX };
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ_INT(tokens[i].type, TOK_INT_LIT);
+        ASSERT(tokens[i].int_value == ints[i]);
+    }
+    // Past u64, or no digits after the prefix: the parser reports these
+    ASSERT_EQ_INT(tokens[5].type, TOK_BAD_INT_LIT);
+    ASSERT_EQ_INT(tokens[6].type, TOK_BAD_INT_LIT);
+    ASSERT_EQ_INT(tokens[7].type, TOK_BAD_INT_LIT);
+    ASSERT_EQ_INT((int)tokens[7].len, 3);
+
+    ASSERT_EQ_INT(tokens[8].type, TOK_FLOAT_LIT);
+    ASSERT(tokens[8].float_value == 12.5);
+    ASSERT_EQ_INT(tokens[9].type, TOK_FLOAT_LIT);
+    ASSERT(tokens[9].float_value == 1000.25);
+    ASSERT_EQ_INT(tokens[10].type, TOK_FLOAT_LIT);
+    ASSERT(tokens[10].float_value > 0.0024999 && tokens[10].float_value < 0.0025001);
+    ASSERT_EQ_INT(tokens[11].type, TOK_CHAR_LIT);
+    ASSERT(tokens[11].int_value == 'A');
+    // '.' without a digit after it ends the integer
+    ASSERT_EQ_INT(tokens[12].type, TOK_INT_LIT);
+    ASSERT(tokens[12].int_value == 7);
+    ASSERT_EQ_INT(tokens[13].type, TOK_DOT);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Lexer: Spans Are Byte Offsets Resolved on Demand", 10) {
+    Arena *arena = arena_create(1024 * 1024);
+    const char *src = "x = 1;\n\n  \"two\nlines\" y\r\nz";
+    Lexer *lexer = lexer_create(src, strlen(src), arena);
+    ASSERT(lexer && lexer_lex_all(lexer));
+    ASSERT(lexer->file != SOURCE_NONE);
+    ASSERT(source_path(lexer->file) == NULL);
+    size_t count = 0;
+    Token *tokens = lexer_get_tokens(lexer, &count);
+    ASSERT_EQ_INT((int)count, 8);
+
+    // The string literal: bytes [10, 21), starting on line 3 and ending on line 4
+    Token *str = &tokens[4];
+    ASSERT_EQ_INT(str->type, TOK_STRING_LIT);
+    // Packed: kind and length share a word, then offset and record
+    ASSERT_EQ_INT((int)sizeof(Token), 16);
+    ASSERT_EQ_INT((int)str->offset, 10);
+    ASSERT_EQ_INT((int)str->len, 11);
+    Span span = token_span(lexer->file, str);
+    ASSERT_EQ_INT(span.file, lexer->file);
+    ASSERT_EQ_INT((int)span.end, 21);
+    SourcePos start = span_start_pos(span), end = span_end_pos(span);
+    ASSERT_EQ_INT((int)start.line, 3);
+    ASSERT_EQ_INT((int)start.col, 3);
+    ASSERT_EQ_INT((int)end.line, 4);
+    ASSERT_EQ_INT((int)end.col, 7);
+
+    ASSERT_EQ_INT((int)span_start_pos(token_span(lexer->file, &tokens[5])).col, 8);
+    // '\r' is an ordinary byte, only '\n' starts a line
+    ASSERT_EQ_INT((int)span_start_pos(token_span(lexer->file, &tokens[6])).line, 5);
+    ASSERT_EQ_INT((int)span_start_pos(token_span(lexer->file, &tokens[6])).col, 1);
+    ASSERT_EQ_INT((int)span_start_pos(token_span(lexer->file, &tokens[7])).col, 2);
+
+    // Named files keep their path; spans without a file resolve to 0:0
+    SourceId named = source_register("dir/file.nt", src, strlen(src));
+    ASSERT(named != SOURCE_NONE && named != lexer->file);
+    ASSERT(strcmp(source_path(named), "dir/file.nt") == 0);
+    ASSERT_EQ_INT((int)source_pos(named, 9).line, 3);
+    ASSERT_EQ_INT((int)source_pos(SOURCE_NONE, 9).line, 0);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Lexer: Source Lines Come From the Registered Buffer", 10) {
+    // The path does not exist: excerpts must not need the file on disk
+    static const char src[] = "first\n\nthird line\r\nlast";
+    SourceId file = source_register("missing/dir/lines.nt", src, sizeof(src) - 1);
+    ASSERT(file != SOURCE_NONE);
+
+    size_t len = 0;
+    const char *line = source_line(file, 1, &len);
+    ASSERT(line == src && len == 5);
+    line = source_line(file, 2, &len);
+    ASSERT(line == src + 6 && len == 0);
+    // Only '\n' ends a line; a '\r' before it stays part of the text
+    line = source_line(file, 3, &len);
+    ASSERT(line && len == 11 && strncmp(line, "third line\r", len) == 0);
+    line = source_line(file, 4, &len);
+    ASSERT(line && len == 4 && strncmp(line, "last", len) == 0);
+
+    ASSERT(source_line(file, 5, &len) == NULL);
+    ASSERT(source_line(file, 0, &len) == NULL);
+    ASSERT(source_line(SOURCE_NONE, 1, &len) == NULL);
+    return 1;
+}
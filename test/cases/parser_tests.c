@@ -16,5 +16,229 @@ PARSE_ERROR("missing_parens_for", "fn main() { for i: i32 = 0; i < 10; i = i + 1
 PARSE_ERROR("missing_brace", "fn main() { x: i32 = 1;", "expected '}'")
 PARSE_ERROR("missing_type", "fn main() { x: = 1; }", "expected type name")
 PARSE_ERROR("bad_alloc", "import std; fn main() { p: *i32 = @alloc(10, std.heap.allocator, 1); }", "expected type name")
+PARSE_ERROR("inline_noinline", "@inline @noinline fn f() {}", "@inline and @noinline are exclusive")
+PARSE_ERROR("duplicate_attribute", "@hot @hot fn f() {}", "duplicate attribute")
+PARSE_ERROR("attribute_on_struct", "@cold struct S { x: i32; }", "function attributes not supported for structs")
+PARSE_ERROR("align_not_pow2", "@align(48) struct S { x: i32; }", "@align expects a power of two between 1 and 4096")
+PARSE_ERROR("struct_attribute_on_fn", "@packed fn f() {}", "struct attributes not supported for functions")
+PARSE_ERROR("link_on_method", "impl P { @link(\"m\") fn m(self: *P) {} }", "@link attribute not supported for methods")
+PARSE_ERROR("switch_else_not_last", "fn main() { switch x { else: f(); case 1: g(); } }", "'else' must be the last arm of a switch")
 
 #undef PARSE_ERROR
+
+TEST_CASE_PRIO("Parser: Streaming Recycles Tokens Between Declarations", 20) {
+    Arena *arena = arena_create(4 * 1024 * 1024);
+    // Many small declarations, several token chunks' worth, then a syntax
+    // error near the end so the failing token has to still be around
+    const size_t decls = 400;
+    size_t cap = decls * 96 + 64, len = 0;
+    char *src = arena_alloc(arena, cap);
+    for (size_t i = 0; i < decls; i++) {
+        len += (size_t)snprintf(src + len, cap - len, "fn step%zu(a: i32) -> i32 { return a * %zu + 1; }\n", i, i);
+    }
+
+    Lexer *l = lexer_create(src, len, arena);
+    ASSERT(lexer_lex_all(l));
+    ParseError err = {0};
+    AstNode *prog = parse_program(parser_create(l, "<test>", arena), &err);
+    ASSERT(prog && !err.message);
+
+    Lexer *sl = lexer_create(src, len, arena);
+    Parser *sp = parser_create_streaming(sl, "<test>", arena);
+    AstNode *sprog = parse_program(sp, &err);
+    ASSERT(sprog && !err.message);
+    ASSERT_EQ_INT((int)sl->tokens->count, 0);
+    ASSERT_EQ_INT((int)sp->lexed, (int)l->tokens->count);
+    // Only the chunks around the last declaration are left in the window
+    ASSERT(sp->window_len <= 2);
+    ASSERT(sp->window_base > 0);
+    ASSERT(sp->free_chunks != NULL);
+    ASSERT_EQ_INT((int)sprog->data.program.decls->count, (int)decls);
+    for (size_t i = 0; i < decls; i++) {
+        AstNode *a = DYNARRAY_AT(AstNode*, prog->data.program.decls, i);
+        AstNode *b = DYNARRAY_AT(AstNode*, sprog->data.program.decls, i);
+        ASSERT_EQ_INT((int)a->span.start, (int)b->span.start);
+        ASSERT_EQ_INT((int)a->span.end, (int)b->span.end);
+    }
+
+    len += (size_t)snprintf(src + len, cap - len, "fn broken() { x: i32 = ; }\n");
+    ParseError arr_err = {0}, s_err = {0};
+    Lexer *el = lexer_create(src, len, arena);
+    ASSERT(lexer_lex_all(el));
+    parse_program(parser_create(el, "<test>", arena), &arr_err);
+    parse_program(parser_create_streaming(lexer_create(src, len, arena), "<test>", arena), &s_err);
+    ASSERT(arr_err.message && s_err.message);
+    ASSERT(strcmp(arr_err.message, s_err.message) == 0);
+    ASSERT_EQ_INT((int)arr_err.token->offset, (int)s_err.token->offset);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Parser: Nodes Are Allocated By Kind", 20) {
+    // Leaves get their own payload, not the widest one in the union
+    ASSERT(ast_node_size(AST_IDENTIFIER) < sizeof(AstNode));
+    ASSERT(ast_node_size(AST_LITERAL) < sizeof(AstNode));
+    ASSERT(ast_node_size(AST_FUNCTION_DECLARATION) <= sizeof(AstNode));
+    // Every kind can still be rewritten into a cast or literal in place
+    for (int k = AST_PROGRAM; k <= AST_INITIALIZER_LIST; k++) {
+        size_t size = ast_node_size((AstNodeType)k);
+        ASSERT(size >= offsetof(AstNode, data) + sizeof(AstCastExpr));
+        ASSERT(size >= offsetof(AstNode, data) + sizeof(AstLiteral));
+        ASSERT(size % _Alignof(AstNode) == 0);
+    }
+
+    Arena *arena = arena_create(64 * 1024);
+    size_t before = arena_bytes_used(arena);
+    AstNode *id = ast_create_node(AST_IDENTIFIER, arena, SOURCE_NONE);
+    ASSERT(id && id->node_type == AST_IDENTIFIER && id->type == NULL);
+    ASSERT(arena_bytes_used(arena) - before < sizeof(AstNode));
+
+    // A clone copies exactly the node's own bytes
+    id->span = (Span){1, 2, 5};
+    AstNode *copy = ast_clone_node(id, arena);
+    ASSERT(copy && copy != id && copy->node_type == AST_IDENTIFIER);
+    ASSERT_EQ_INT((int)copy->span.start, 2);
+    ASSERT_EQ_INT((int)copy->span.end, 5);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+static AstNode *parse_single_expr(Arena *arena, const char *src) {
+    Lexer *l = lexer_create(src, strlen(src), arena);
+    if (!lexer_lex_all(l)) return NULL;
+    ParseError err = {0};
+    AstNode *e = parse_expression(parser_create(l, "<test>", arena), &err);
+    return err.message ? NULL : e;
+}
+
+TEST_CASE_PRIO("Parser: Binary Operators Follow The Binding-Power Table", 20) {
+    Arena *arena = arena_create(64 * 1024);
+
+    // || loosest, then &&, ==, <, +, *, as
+    AstNode *e = parse_single_expr(arena, "a || b && c == d < e + f * g as i64");
+    ASSERT(e && e->node_type == AST_BINARY_EXPR && e->data.binary_expr.op == OP_OR);
+    AstNode *r = e->data.binary_expr.right;
+    ASSERT(r->node_type == AST_BINARY_EXPR && r->data.binary_expr.op == OP_AND);
+    r = r->data.binary_expr.right;
+    ASSERT(r->node_type == AST_BINARY_EXPR && r->data.binary_expr.op == OP_EQ);
+    r = r->data.binary_expr.right;
+    ASSERT(r->node_type == AST_BINARY_EXPR && r->data.binary_expr.op == OP_LT);
+    r = r->data.binary_expr.right;
+    ASSERT(r->node_type == AST_BINARY_EXPR && r->data.binary_expr.op == OP_ADD);
+    r = r->data.binary_expr.right;
+    ASSERT(r->node_type == AST_BINARY_EXPR && r->data.binary_expr.op == OP_MUL);
+    ASSERT(r->data.binary_expr.right->node_type == AST_CAST);
+
+    // Every level is left-associative
+    e = parse_single_expr(arena, "a - b - c");
+    ASSERT(e && e->data.binary_expr.op == OP_SUB);
+    ASSERT(e->data.binary_expr.left->node_type == AST_BINARY_EXPR);
+    ASSERT(e->data.binary_expr.right->node_type == AST_IDENTIFIER);
+
+    // Prefix operators bind tighter than `as`, `as` tighter than `*`
+    e = parse_single_expr(arena, "y * -x as i64");
+    ASSERT(e && e->node_type == AST_BINARY_EXPR && e->data.binary_expr.op == OP_MUL);
+    AstNode *cast = e->data.binary_expr.right;
+    ASSERT(cast->node_type == AST_CAST);
+    ASSERT(cast->data.cast_expr.expr->node_type == AST_UNARY_EXPR);
+    ASSERT_EQ_INT((int)e->span.start, 0);
+    ASSERT_EQ_INT((int)e->span.end, 13);
+
+    // Assignment stays right-associative and outside the table
+    e = parse_single_expr(arena, "a = b = c + 1");
+    ASSERT(e && e->node_type == AST_ASSIGNMENT_EXPR);
+    ASSERT(e->data.assignment_expr.rvalue->node_type == AST_ASSIGNMENT_EXPR);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Parser: Deferred Bodies Are Skimmed And Parsed On Demand", 20) {
+    Arena *arena = arena_create(64 * 1024);
+    const char *src =
+        "fn a(x: i32) -> i32 { if x > 0 { return x; } return 0; }\n"
+        "fn b() -> void { }\n"
+        "fn c() -> void { y: i32 = ; }\n";
+    size_t len = strlen(src);
+
+    Lexer *l = lexer_create(src, len, arena);
+    Parser *p = parser_create_streaming(l, "<test>", arena);
+    ASSERT(parser_defer_bodies(p, l, true));
+    ParseError err = {0};
+    AstNode *prog = parse_program(p, &err);
+    // The syntax error in c's body is not seen while skimming
+    ASSERT(prog && !err.message);
+    ASSERT_EQ_INT((int)prog->data.program.decls->count, 3);
+
+    AstNode *a = DYNARRAY_AT(AstNode*, prog->data.program.decls, 0);
+    AstFunctionDeclaration *fa = &a->data.function_declaration;
+    ASSERT(fa->body == NULL && fa->lazy_body != NULL);
+    ASSERT_EQ_INT((int)fa->body_start, 20);
+    ASSERT(src[fa->body_end - 1] == '}' && src[fa->body_end] == '\n');
+    ASSERT_EQ_INT((int)a->span.end, (int)fa->body_end);
+
+    const char *msg = NULL;
+    Span span = {0};
+    AstNode *body = parse_deferred_body(a, arena, &msg, &span);
+    ASSERT(body && body->node_type == AST_BLOCK && !msg);
+    ASSERT_EQ_INT((int)body->data.block.statements->count, 2);
+    ASSERT_EQ_INT((int)body->span.start, (int)fa->body_start);
+    ASSERT_EQ_INT((int)body->span.end, (int)fa->body_end);
+    ASSERT_EQ_INT((int)body->span.file, (int)a->span.file);
+    // Parsing it again gives a fresh tree, as a monomorphized copy needs
+    AstNode *again = parse_deferred_body(a, arena, NULL, NULL);
+    ASSERT(again && again != body);
+
+    AstNode *c = DYNARRAY_AT(AstNode*, prog->data.program.decls, 2);
+    ASSERT(parse_deferred_body(c, arena, &msg, &span) == NULL);
+    ASSERT(msg != NULL);
+    ASSERT(span.start > c->data.function_declaration.body_start);
+    ASSERT(span.end < c->data.function_declaration.body_end);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("Parser: Generic Bodies Are Deferred But Still Checked", 20) {
+    Arena *arena = arena_create(64 * 1024);
+    const char *src =
+        "struct Box<T> { v: T; }\n"
+        "impl<T> Box<T> { fn get(self: *Box<T>) -> T { return self.v; } }\n"
+        "fn id<T>(x: T) -> T { return x; }\n"
+        "fn main() -> i32 { return id<i32>(1); }\n";
+
+    Lexer *l = lexer_create(src, strlen(src), arena);
+    Parser *p = parser_create_streaming(l, "<test>", arena);
+    ASSERT(parser_defer_bodies(p, l, false));
+    ParseError err = {0};
+    AstNode *prog = parse_program(p, &err);
+    ASSERT(prog && !err.message);
+
+    AstNode *impl = DYNARRAY_AT(AstNode*, prog->data.program.decls, 1);
+    AstNode *get = DYNARRAY_AT(AstNode*, impl->data.impl_declaration.methods, 0);
+    AstNode *id = DYNARRAY_AT(AstNode*, prog->data.program.decls, 2);
+    AstNode *main_fn = DYNARRAY_AT(AstNode*, prog->data.program.decls, 3);
+    ASSERT(!get->data.function_declaration.body && get->data.function_declaration.lazy_body);
+    ASSERT(!id->data.function_declaration.body && id->data.function_declaration.lazy_body);
+    ASSERT(main_fn->data.function_declaration.body && !main_fn->data.function_declaration.lazy_body);
+    // Every instance gets its own tree from the source
+    AstNode *a = parse_deferred_body(id, arena, NULL, NULL);
+    AstNode *b = parse_deferred_body(id, arena, NULL, NULL);
+    ASSERT(a && b && a != b);
+    ASSERT_EQ_INT((int)a->data.block.statements->count, 1);
+
+    // A syntax error in a generic body is still found while parsing
+    const char *bad = "fn id<T>(x: T) -> T { y: T = ; return x; }\n";
+    Lexer *bl = lexer_create(bad, strlen(bad), arena);
+    Parser *bp = parser_create_streaming(bl, "<test>", arena);
+    ASSERT(parser_defer_bodies(bp, bl, false));
+    ParseError bad_err = {0};
+    parse_program(bp, &bad_err);
+    ASSERT(bad_err.message && bad_err.token);
+    ASSERT_EQ_INT((int)bad_err.token->offset, 29);
+
+    arena_destroy(arena);
+    return 1;
+}
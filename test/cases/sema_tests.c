@@ -1,5 +1,6 @@
 #include "../harness/test_harness.h"
 #include "../helpers/compiler_helpers.h"
+#include <pthread.h>
 
 #define SEMA_VALID(name, src) \
     TEST_CASE_PRIO("Sema/Valid/" name, 30) { ASSERT(test_is_sema_valid(src)); return 1; }
@@ -21,3 +22,111 @@
 
 #undef SEMA_VALID
 #undef SEMA_ERROR
+
+// --- Concurrent TypeStore ---
+
+#define TYPE_THREADS 4
+#define TYPE_SIZES   64
+
+typedef struct {
+    TypeStore *store;
+    int offset;
+    Type *arrays[TYPE_SIZES];
+    Type *pointers[TYPE_SIZES];
+    Type *functions[TYPE_SIZES];
+    Type *insts[TYPE_SIZES];
+} TypeWorkerArgs;
+
+static void *type_worker(void *arg) {
+    TypeWorkerArgs *a = arg;
+    TypeStore *ts = a->store;
+    for (int n = 0; n < TYPE_SIZES; n++) {
+        int i = (n + a->offset) % TYPE_SIZES;
+        Type *arr = make_array_type(ts, ts->t_i32, i + 1);
+        Type *params[2] = { arr, ts->t_bool };
+        a->arrays[i] = arr;
+        a->pointers[i] = make_pointer_type(ts, make_pointer_type(ts, arr));
+        a->functions[i] = make_function_type(ts, ts->t_void, params, 2);
+        a->insts[i] = make_generic_inst_type(ts, ts->t_i64, params, 2);
+    }
+    return NULL;
+}
+
+TEST_CASE_PRIO("TypeStore: Concurrent Interning Keeps Types Canonical", 30) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *keywords = intern_table_create(hashmap_create(arena, 32), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *identifiers = intern_table_create(hashmap_create(arena, 64), arena, string_copy_func, slice_hash, slice_cmp);
+    TypeStore *ts = typestore_create(arena, identifiers, keywords);
+    ASSERT(ts != NULL);
+
+    // One type per kind exists before the switch and must be found, not duplicated
+    Type *pre = make_array_type(ts, ts->t_i32, 1);
+
+    ASSERT(typestore_begin_concurrent(ts));
+    static TypeWorkerArgs args[TYPE_THREADS];
+    pthread_t threads[TYPE_THREADS];
+    for (int t = 0; t < TYPE_THREADS; t++) {
+        args[t].store = ts;
+        args[t].offset = t * (TYPE_SIZES / TYPE_THREADS);
+        ASSERT(pthread_create(&threads[t], NULL, type_worker, &args[t]) == 0);
+    }
+    for (int t = 0; t < TYPE_THREADS; t++) pthread_join(threads[t], NULL);
+    typestore_end_concurrent(ts);
+
+    ASSERT(args[0].arrays[0] == pre);
+    for (int i = 0; i < TYPE_SIZES; i++) {
+        for (int t = 1; t < TYPE_THREADS; t++) {
+            ASSERT(args[t].arrays[i] == args[0].arrays[i]);
+            ASSERT(args[t].pointers[i] == args[0].pointers[i]);
+            ASSERT(args[t].functions[i] == args[0].functions[i]);
+            ASSERT(args[t].insts[i] == args[0].insts[i]);
+        }
+        ASSERT(args[0].insts[i]->as.generic_inst.args[0] == args[0].arrays[i]);
+    }
+
+    // Back in serial mode the same requests return the same pointers
+    Type *params[2] = { args[0].arrays[5], ts->t_bool };
+    ASSERT(make_function_type(ts, ts->t_void, params, 2) == args[0].functions[5]);
+    ASSERT(make_generic_inst_type(ts, ts->t_i64, params, 2) == args[0].insts[5]);
+    ASSERT(make_pointer_type(ts, make_pointer_type(ts, args[0].arrays[5])) == args[0].pointers[5]);
+
+    arena_destroy(arena);
+    return 1;
+}
+
+TEST_CASE_PRIO("TypeStore: Composite Types Hash Their Children by Identity", 30) {
+    Arena *arena = arena_create(64 * 1024);
+    DenseArenaInterner *keywords = intern_table_create(hashmap_create(arena, 32), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *identifiers = intern_table_create(hashmap_create(arena, 64), arena, string_copy_func, slice_hash, slice_cmp);
+    TypeStore *ts = typestore_create(arena, identifiers, keywords);
+    ASSERT(ts != NULL);
+
+    // Two nominal structs with equal contents are still different children
+    Type *a = arena_calloc(arena, sizeof(Type));
+    Type *b = arena_calloc(arena, sizeof(Type));
+    a->kind = b->kind = TYPE_STRUCT;
+    Type *pa = make_pointer_type(ts, a);
+    Type *pb = make_pointer_type(ts, b);
+    ASSERT(pa != pb);
+    ASSERT(pa->cached_hash != pb->cached_hash);
+
+    // A deep type is rebuilt level by level and lands on the same pointers
+    Type *deep = ts->t_i32, *again = ts->t_i32;
+    for (int i = 0; i < 32; i++) {
+        Type *params[2] = { deep, pa };
+        deep = make_pointer_type(ts, make_function_type(ts, deep, params, 2));
+    }
+    for (int i = 0; i < 32; i++) {
+        Type *params[2] = { again, pa };
+        again = make_pointer_type(ts, make_function_type(ts, again, params, 2));
+    }
+    ASSERT(deep == again);
+
+    Type *args[2] = { deep, ts->t_bool };
+    Type *inst = make_generic_inst_type(ts, a, args, 2);
+    ASSERT(make_generic_inst_type(ts, a, args, 2) == inst);
+    ASSERT(make_generic_inst_type(ts, b, args, 2) != inst);
+
+    arena_destroy(arena);
+    return 1;
+}
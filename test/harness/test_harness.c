@@ -9,11 +9,16 @@
     #define dup2 _dup2
     #define fileno _fileno
 #else
+    #include <errno.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/wait.h>
     #include <unistd.h>
 #endif
 
 #define MAX_TESTS 2048
 #define LOG_BUFFER_SIZE 16384
+#define MAX_TEST_JOBS 64
 
 typedef struct {
     const char *name;
@@ -62,18 +67,38 @@ void test_registry_add(const char *name, TestFunc func, int priority) {
     }
 }
 
-static void run_single_test(const char *name, TestFunc func) {
-    g_tests_run++;
-    test_clear_log();
+/* What running one case produced; `log` and `captured` are malloc'd (or NULL). */
+typedef struct {
+    int result;
+    double ms;
+    char *log;      // test_log text
+    char *captured; // stdout and stderr of a failed case
+} TestOutcome;
+
+#define CAPTURE_LIMIT (64 * 1024)
 
-    const char *sub = name;
+static const char *test_short_name(const char *name) {
     const char *slash = strrchr(name, '/');
-    if (slash) sub = slash + 1;
+    return slash ? slash + 1 : name;
+}
+
+static char *read_capture(FILE *tmp) {
+    rewind(tmp);
+    char *buf = malloc(CAPTURE_LIMIT + 1);
+    if (!buf) return NULL;
+    size_t n = fread(buf, 1, CAPTURE_LIMIT, tmp);
+    buf[n] = '\0';
+    if (n == 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* Runs one case with its stdout and stderr redirected to a temporary file. */
+static void execute_test(TestFunc func, TestOutcome *out) {
+    test_clear_log();
 
-    fprintf(stdout, "      %-50s", sub);
-    fflush(stdout);
-    
-    // Redirect stdout and stderr to a temporary file
     int stdout_save = dup(STDOUT_FILENO);
     int stderr_save = dup(STDERR_FILENO);
     FILE *tmp = tmpfile();
@@ -88,8 +113,7 @@ static void run_single_test(const char *name, TestFunc func) {
     double start = now_seconds();
     int result = func();
     double end = now_seconds();
-    
-    // Restore stdout and stderr
+
     if (tmp) {
         fflush(stdout);
         fflush(stderr);
@@ -99,54 +123,331 @@ static void run_single_test(const char *name, TestFunc func) {
     close(stdout_save);
     close(stderr_save);
 
-    double diff_ms = (end - start) * 1000.0;
+    out->result = result;
+    out->ms = (end - start) * 1000.0;
+    out->log = g_log_len > 0 ? strdup(g_log_buffer) : NULL;
+    out->captured = !result && tmp ? read_capture(tmp) : NULL;
+    if (tmp) fclose(tmp);
+}
 
-    if (result) {
+static void report_test(const char *name, const TestOutcome *out) {
+    const char *sub = test_short_name(name);
+    g_tests_run++;
+    if (out->result) {
         g_tests_passed++;
         fprintf(stdout, "\r\033[K    %s✓%s %-50s %s%8.3fms%s\n", 
-            COL_GREEN, COL_RESET, sub, COL_CYAN, diff_ms, COL_RESET);
-            
-        if (g_log_len > 0) {
-            fprintf(stdout, "%s", g_log_buffer);
-            if (g_log_buffer[g_log_len - 1] != '\n') fprintf(stdout, "\n");
-        }
+            COL_GREEN, COL_RESET, sub, COL_CYAN, out->ms, COL_RESET);
     } else {
         g_tests_failed++;
         fprintf(stdout, "\r\033[K    %s✗%s %-50s\n", COL_RED, COL_RESET, sub);
-        
-        if (tmp) {
-            rewind(tmp);
-            char buf[1024];
-            bool has_output = false;
-            while (fgets(buf, sizeof(buf), tmp)) {
-                if (!has_output) {
-                    fprintf(stdout, "      %s--- Captured Output ---%s\n", COL_YELLOW, COL_RESET);
-                    has_output = true;
-                }
-                fprintf(stdout, "      %s", buf);
+
+        if (out->captured) {
+            fprintf(stdout, "      %s--- Captured Output ---%s\n", COL_YELLOW, COL_RESET);
+            for (const char *line = out->captured; *line; ) {
+                const char *end = strchr(line, '\n');
+                size_t len = end ? (size_t)(end - line) + 1 : strlen(line);
+                fprintf(stdout, "      %.*s", (int)len, line);
+                line += len;
+            }
+            if (out->captured[strlen(out->captured) - 1] != '\n') fprintf(stdout, "\n");
+            fprintf(stdout, "      %s-----------------------%s\n", COL_YELLOW, COL_RESET);
+        }
+    }
+    if (out->log && out->log[0]) {
+        size_t len = strlen(out->log);
+        fprintf(stdout, "%s", out->log);
+        if (out->log[len - 1] != '\n') fprintf(stdout, "\n");
+    }
+    fflush(stdout);
+}
+
+/* Prints the "[Category]" header when `name` starts a new one. */
+static void enter_category(const char *name, char *current, size_t cap) {
+    char cat[64] = {0};
+    const char *sep = strpbrk(name, "/:");
+    if (sep) {
+        size_t len = (size_t)(sep - name);
+        if (len < sizeof(cat)) memcpy(cat, name, len);
+    } else {
+        strcpy(cat, "General");
+    }
+    if (current[0] == '\0' || strcmp(cat, current) != 0) {
+        fprintf(stdout, "\n %s[%s]%s\n", COL_BOLD, cat, COL_RESET);
+        snprintf(current, cap, "%s", cat);
+    }
+}
+
+#ifndef _WIN32
+/*
+ * Parallel runs: forked workers, each inheriting the LLVM targets the
+ * parent initialized. The parent hands out one case at a time (the next in
+ * order, so long fixture suites start early enough to overlap) and prints
+ * the outcomes in registry order as they become contiguous. A worker that
+ * dies fails the case it was running and is replaced.
+ */
+typedef struct {
+    pid_t pid;
+    int cmd_fd;  // Parent -> worker: index of the next case, -1 to exit
+    int res_fd;  // Worker -> parent: outcome messages
+    int running; // Case index, -1 when idle
+} TestWorker;
+
+typedef struct {
+    int32_t index;
+    int32_t result;
+    double ms;
+    uint32_t log_len;
+    uint32_t captured_len;
+} OutcomeHeader;
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void worker_main(const TestEntry *cases, int cmd_fd, int res_fd) {
+    int32_t index;
+    while (read_all(cmd_fd, &index, sizeof(index)) && index >= 0) {
+        TestOutcome out = {0};
+        execute_test(cases[index].func, &out);
+        OutcomeHeader h = { index, out.result, out.ms,
+                            out.log ? (uint32_t)strlen(out.log) : 0,
+                            out.captured ? (uint32_t)strlen(out.captured) : 0 };
+        bool ok = write_all(res_fd, &h, sizeof(h)) &&
+                  write_all(res_fd, out.log, h.log_len) &&
+                  write_all(res_fd, out.captured, h.captured_len);
+        free(out.log);
+        free(out.captured);
+        if (!ok) break;
+    }
+    _exit(0);
+}
+
+static bool spawn_worker(TestWorker *w, const TestEntry *cases, TestWorker *workers, int worker_count) {
+    int cmd[2], res[2];
+    if (pipe(cmd) != 0) return false;
+    if (pipe(res) != 0) {
+        close(cmd[0]);
+        close(cmd[1]);
+        return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(cmd[0]); close(cmd[1]); close(res[0]); close(res[1]);
+        return false;
+    }
+    if (pid == 0) {
+        // Only our own ends: a sibling must see EOF when the parent closes its pipe
+        for (int i = 0; i < worker_count; i++) {
+            if (&workers[i] == w || workers[i].pid <= 0) continue;
+            close(workers[i].cmd_fd);
+            close(workers[i].res_fd);
+        }
+        close(cmd[1]);
+        close(res[0]);
+        worker_main(cases, cmd[0], res[1]);
+    }
+    close(cmd[0]);
+    close(res[1]);
+    *w = (TestWorker){ pid, cmd[1], res[0], -1 };
+    return true;
+}
+
+static void assign_next(TestWorker *w, int *next, int count) {
+    int32_t index = *next < count ? *next : -1;
+    if (index >= 0 && write_all(w->cmd_fd, &index, sizeof(index))) {
+        w->running = index;
+        (*next)++;
+        return;
+    }
+    w->running = -1;
+    close(w->cmd_fd);
+    w->cmd_fd = -1;
+}
+
+static void retire_worker(TestWorker *w) {
+    if (w->cmd_fd >= 0) close(w->cmd_fd);
+    close(w->res_fd);
+    waitpid(w->pid, NULL, 0);
+    w->pid = 0;
+    w->cmd_fd = w->res_fd = -1;
+}
+
+/* Reads the outcome the worker just sent; false if it died instead. */
+static bool receive_outcome(TestWorker *w, TestOutcome *outcomes) {
+    OutcomeHeader h;
+    if (!read_all(w->res_fd, &h, sizeof(h)) || h.index != w->running) return false;
+    TestOutcome *out = &outcomes[h.index];
+    out->result = h.result;
+    out->ms = h.ms;
+    out->log = h.log_len ? malloc(h.log_len + 1) : NULL;
+    out->captured = h.captured_len ? malloc(h.captured_len + 1) : NULL;
+    if ((h.log_len && (!out->log || !read_all(w->res_fd, out->log, h.log_len))) ||
+        (h.captured_len && (!out->captured || !read_all(w->res_fd, out->captured, h.captured_len)))) {
+        return false;
+    }
+    if (out->log) out->log[h.log_len] = '\0';
+    if (out->captured) out->captured[h.captured_len] = '\0';
+    return true;
+}
+
+static void run_parallel(TestEntry *cases, int count, int jobs, bool fail_fast, TestOutcome *outcomes) {
+    bool *done = calloc((size_t)count, sizeof(bool));
+    TestWorker *workers = calloc((size_t)jobs, sizeof(TestWorker));
+    struct pollfd *fds = calloc((size_t)jobs, sizeof(struct pollfd));
+    int next = 0, printed = 0, live = 0;
+    char category[64] = "";
+
+    for (int i = 0; i < jobs; i++) {
+        if (!spawn_worker(&workers[i], cases, workers, jobs)) continue;
+        live++;
+        assign_next(&workers[i], &next, count);
+    }
+
+    bool stop = false;
+    while (printed < count && !stop && live > 0) {
+        int polled = 0;
+        int slot[MAX_TEST_JOBS];
+        for (int i = 0; i < jobs; i++) {
+            if (workers[i].pid <= 0 || workers[i].running < 0) continue;
+            fds[polled] = (struct pollfd){ workers[i].res_fd, POLLIN, 0 };
+            slot[polled++] = i;
+        }
+        if (polled == 0) break;
+        if (poll(fds, (nfds_t)polled, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int p = 0; p < polled; p++) {
+            if (!fds[p].revents) continue;
+            TestWorker *w = &workers[slot[p]];
+            int index = w->running;
+            if (receive_outcome(w, outcomes)) {
+                done[index] = true;
+                assign_next(w, &next, count);
+                continue;
             }
-            if (has_output) {
-                fprintf(stdout, "      %s-----------------------%s\n", COL_YELLOW, COL_RESET);
+
+            // The worker died in the case: fail it, and replace the worker if work is left
+            int status = 0;
+            if (w->cmd_fd >= 0) close(w->cmd_fd);
+            close(w->res_fd);
+            waitpid(w->pid, &status, 0);
+            w->pid = 0;
+            live--;
+            char reason[96];
+            if (WIFSIGNALED(status)) snprintf(reason, sizeof(reason), "      %sWorker killed by signal %d%s\n", COL_RED, WTERMSIG(status), COL_RESET);
+            else snprintf(reason, sizeof(reason), "      %sWorker exited (status %d)%s\n", COL_RED, WEXITSTATUS(status), COL_RESET);
+            free(outcomes[index].log);
+            free(outcomes[index].captured);
+            outcomes[index] = (TestOutcome){ 0, 0.0, strdup(reason), NULL };
+            done[index] = true;
+            if (next < count && spawn_worker(w, cases, workers, jobs)) {
+                live++;
+                assign_next(w, &next, count);
             }
         }
 
-        if (g_log_len > 0) {
-            fprintf(stdout, "%s", g_log_buffer);
-            if (g_log_buffer[g_log_len - 1] != '\n') fprintf(stdout, "\n");
+        while (printed < count && done[printed]) {
+            enter_category(cases[printed].name, category, sizeof(category));
+            report_test(cases[printed].name, &outcomes[printed]);
+            printed++;
+            if (fail_fast && g_tests_failed > 0) {
+                fprintf(stdout, "\n%sStopping early due to failure%s\n", COL_RED, COL_RESET);
+                stop = true;
+                break;
+            }
         }
     }
-    if (tmp) fclose(tmp);
+
+    for (int i = 0; i < jobs; i++) {
+        if (workers[i].pid <= 0) continue;
+        if (stop) kill(workers[i].pid, SIGTERM);
+        retire_worker(&workers[i]);
+    }
+    free(fds);
+    free(workers);
+    free(done);
+}
+#endif
+
+/* The slowest cases of the run, so that they stand out. */
+static void report_slowest(const TestEntry *cases, const TestOutcome *outcomes, int count) {
+    enum { SLOWEST = 5 };
+    int top[SLOWEST];
+    int shown = 0;
+    for (int i = 0; i < count; i++) {
+        double ms = outcomes[i].ms;
+        if (ms <= 0.0) continue;
+        int pos = shown;
+        if (shown < SLOWEST) shown++;
+        else if (ms <= outcomes[top[SLOWEST - 1]].ms) continue;
+        else pos = SLOWEST - 1;
+        while (pos > 0 && outcomes[top[pos - 1]].ms < ms) {
+            top[pos] = top[pos - 1];
+            pos--;
+        }
+        top[pos] = i;
+    }
+    if (shown == 0) return;
+    fprintf(stdout, "  Slowest:\n");
+    for (int i = 0; i < shown; i++) {
+        fprintf(stdout, "    %s%10.3fms%s  %s\n", COL_CYAN, outcomes[top[i]].ms, COL_RESET, cases[top[i]].name);
+    }
+}
+
+/*
+ * Test jobs: -j N, else $TEST_JOBS, else one per online CPU. Windows has
+ * no fork and always runs serially.
+ */
+static int test_jobs(int requested) {
+#ifdef _WIN32
+    (void)requested;
+    return 1;
+#else
+    const char *env = getenv("TEST_JOBS");
+    long jobs = requested > 0 ? requested : env && atoi(env) > 0 ? atoi(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1) return 1;
+    return jobs > MAX_TEST_JOBS ? MAX_TEST_JOBS : (int)jobs;
+#endif
 }
 
 int run_all_registered_tests(int argc, char **argv) {
     const char *filter = NULL;
     bool fail_fast = false;
+    int requested_jobs = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
             filter = argv[++i];
         } else if (strcmp(argv[i], "--fail-fast") == 0) {
             fail_fast = true;
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            requested_jobs = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0') {
+            requested_jobs = atoi(argv[i] + 2);
         }
     }
 
@@ -161,42 +462,55 @@ int run_all_registered_tests(int argc, char **argv) {
         }
     }
 
-    fprintf(stdout, "\n%s=== Compiler Test Suite ===%s\n", COL_BOLD, COL_RESET);
-    
-    const char *current_cat = NULL;
+    // The cases to run, in order
+    static TestEntry cases[MAX_TESTS];
+    int count = 0;
     for (int i = 0; i < g_registry_count; i++) {
         if (filter && strstr(g_registry[i].name, filter) == NULL) continue;
+        cases[count++] = g_registry[i];
+    }
+    TestOutcome *outcomes = calloc((size_t)(count > 0 ? count : 1), sizeof(TestOutcome));
 
-        char cat[64] = {0};
-        const char *sep = strpbrk(g_registry[i].name, "/:");
-        if (sep) {
-            size_t len = (size_t)(sep - g_registry[i].name);
-            if (len < sizeof(cat)) memcpy(cat, g_registry[i].name, len);
-        } else {
-            strcpy(cat, "General");
-        }
+    int jobs = test_jobs(requested_jobs);
+    if (jobs > count) jobs = count > 0 ? count : 1;
 
-        if (current_cat == NULL || strcmp(cat, current_cat) != 0) {
-            fprintf(stdout, "\n %s[%s]%s\n", COL_BOLD, cat, COL_RESET);
-            if (current_cat) free((void*)current_cat);
-            current_cat = strdup(cat);
-        }
-        
-        run_single_test(g_registry[i].name, g_registry[i].func);
-        
-        if (fail_fast && g_tests_failed > 0) {
-            fprintf(stdout, "\n%sStopping early due to failure%s\n", COL_RED, COL_RESET);
-            break;
+    fprintf(stdout, "\n%s=== Compiler Test Suite ===%s\n", COL_BOLD, COL_RESET);
+    double start = now_seconds();
+
+#ifndef _WIN32
+    if (jobs > 1) {
+        run_parallel(cases, count, jobs, fail_fast, outcomes);
+    } else
+#endif
+    {
+        char category[64] = "";
+        for (int i = 0; i < count; i++) {
+            enter_category(cases[i].name, category, sizeof(category));
+            fprintf(stdout, "      %-50s", test_short_name(cases[i].name));
+            fflush(stdout);
+            execute_test(cases[i].func, &outcomes[i]);
+            report_test(cases[i].name, &outcomes[i]);
+
+            if (fail_fast && g_tests_failed > 0) {
+                fprintf(stdout, "\n%sStopping early due to failure%s\n", COL_RED, COL_RESET);
+                break;
+            }
         }
     }
-
-    if (current_cat) free((void*)current_cat);
+    double wall_ms = (now_seconds() - start) * 1000.0;
 
     fprintf(stdout, "\n%s=== Summary ===%s\n", COL_BOLD, COL_RESET);
     fprintf(stdout, "  Total:  %d\n", g_tests_run);
     fprintf(stdout, "  Passed: %s%d%s\n", COL_GREEN, g_tests_passed, COL_RESET);
     fprintf(stdout, "  Failed: %s%d%s\n", g_tests_failed ? COL_RED : COL_GREEN, g_tests_failed, COL_RESET);
+    fprintf(stdout, "  Time:   %.0fms on %d job%s\n", wall_ms, jobs, jobs == 1 ? "" : "s");
+    report_slowest(cases, outcomes, count);
     fprintf(stdout, "%s===============%s\n", COL_BOLD, COL_RESET);
-    
+
+    for (int i = 0; i < count; i++) {
+        free(outcomes[i].log);
+        free(outcomes[i].captured);
+    }
+    free(outcomes);
     return g_tests_failed > 0 ? 1 : 0;
 }
@@ -3,6 +3,7 @@
 #include "core/module_loader.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 TestCompileResult test_compile_source(const char *src) {
     TestCompileResult res = {0};
@@ -16,14 +17,14 @@ TestCompileResult test_compile_source(const char *src) {
     lexer_populate_default_keywords(keywords);
 
     // 2. Lex
-    res.lexer = lexer_create_ex(src, strlen(src), res.arena, keywords, identifiers, strings);
+    res.lexer = lexer_create_ex(src, strlen(src), source_register(NULL, src, strlen(src)), res.arena, keywords, identifiers, strings);
     if (!lexer_lex_all(res.lexer)) {
         res.failed = true;
         return res;
     }
 
     // 3. Parse
-    res.parser = parser_create(res.lexer->tokens, "<test>", res.arena);
+    res.parser = parser_create(res.lexer, "<test>", res.arena);
     ParseError p_err = {0};
     res.program = parse_program(res.parser, &p_err);
     if (p_err.message) {
@@ -32,23 +33,35 @@ TestCompileResult test_compile_source(const char *src) {
     }
 
     // 4. Module Loader
-    Options opts = { .stdlib_path = "lib", .verbose = false };
-    ModuleLoader *loader = module_loader_create(res.arena, &opts, keywords, identifiers, strings);
+    // The loader keeps the options for codegen, so they live in the arena
+    Options *opts = arena_calloc(res.arena, sizeof(Options));
+    opts->stdlib_path = "lib";
+    ModuleLoader *loader = module_loader_create(res.arena, opts, keywords, identifiers, strings);
     
     CompilationUnit *unit = arena_alloc(res.arena, sizeof(CompilationUnit));
     unit->absolute_path = (char*)"<test>";
+    unit->file = res.lexer->file;
     unit->logical_path = NULL;
     unit->ast_root = res.program;
     unit->global_scope = NULL;
     unit->signatures_resolved = false;
     unit->imports_resolved = false;
+    unit->cache_key = 0;
+    unit->source_len = 0;
+    unit->from_cache = false;
+    unit->is_library = false;
+    unit->prebuilt = false;
+    unit->bodies_checked = false;
+    unit->resident = false;
     unit->generic_templates = hashmap_create(res.arena, 16);
     unit->mono_instances = arena_alloc(res.arena, sizeof(DynArray));
     if (unit->mono_instances) {
         dynarray_init_in_arena(unit->mono_instances, res.arena, sizeof(AstNode*), 8);
     }
+    unit->mono_args = hashmap_create(res.arena, 8);
     
     hashmap_put(loader->units, unit->absolute_path, unit, str_hash, str_cmp);
+    ptrmap_put(loader->units_by_file, (void*)(uintptr_t)unit->file, unit);
     dynarray_push_value(loader->units_ordered, &unit);
 
     // Manually trigger import resolution for the virtual <test> unit
@@ -75,13 +88,13 @@ TestCompileResult test_compile_source(const char *src) {
                     }
 
                     char target_file[1024];
-                    snprintf(target_file, sizeof(target_file), "%s/%s.nt", opts.stdlib_path, cp_buf);
+                    snprintf(target_file, sizeof(target_file), "%s/%s.nt", opts->stdlib_path, cp_buf);
                     
                     FILE *f = fopen(target_file, "r");
                     if (f) {
                         fclose(f);
                     } else {
-                        snprintf(target_file, sizeof(target_file), "%s/%s/module.nt", opts.stdlib_path, cp_buf);
+                        snprintf(target_file, sizeof(target_file), "%s/%s/module.nt", opts->stdlib_path, cp_buf);
                     }
                     
                     char *target_logical = arena_alloc(loader->arena, strlen(cl_buf) + 1);
@@ -98,7 +111,7 @@ TestCompileResult test_compile_source(const char *src) {
 
     // 5. Sema
     res.store = typestore_create(res.arena, identifiers, keywords);
-    res.sema_ctx = typecheck_context_create(res.arena, res.store, identifiers, keywords, "<test>", loader);
+    res.sema_ctx = typecheck_context_create(res.arena, res.store, identifiers, keywords, unit->file, loader);
     typecheck_program(&res.sema_ctx);
     
     if (res.sema_ctx.errors->count > 0) {
@@ -124,10 +137,21 @@ bool test_is_parse_valid(const char *src) {
     Arena *arena = arena_create(1024 * 1024);
     Lexer *l = lexer_create(src, strlen(src), arena);
     lexer_lex_all(l);
-    Parser *p = parser_create(l->tokens, "<test>", arena);
+    Parser *p = parser_create(l, "<test>", arena);
     ParseError p_err = {0};
     AstNode *prog = parse_program(p, &p_err);
     bool ok = (p_err.message == NULL && prog != NULL);
+
+    // The streaming parser the module loader uses must agree
+    Lexer *sl = lexer_create(src, strlen(src), arena);
+    Parser *sp = parser_create_streaming(sl, "<test>", arena);
+    ParseError s_err = {0};
+    AstNode *sprog = parse_program(sp, &s_err);
+    bool s_ok = (s_err.message == NULL && sprog != NULL);
+    if (s_ok != ok || (ok && sprog->data.program.decls->count != prog->data.program.decls->count)) {
+        test_log("      Streaming parse disagrees with the token array: %s\n", s_err.message ? s_err.message : "ok");
+        ok = false;
+    }
     arena_destroy(arena);
     return ok;
 }
@@ -171,7 +195,8 @@ int test_run_and_get_exit_code(const char *src) {
         if (res.sema_ctx.errors) {
             for (size_t i = 0; i < res.sema_ctx.errors->count; i++) {
                 TypeError *err = (TypeError*)dynarray_get(res.sema_ctx.errors, i);
-                fprintf(stderr, "      Sema Error %zu: Kind %d at span %u:%u to %u:%u in %s\n", i + 1, err->kind, err->span.start_line, err->span.start_col, err->span.end_line, err->span.end_col, err->filename);
+                SourcePos start = span_start_pos(err->span), end = span_end_pos(err->span);
+                fprintf(stderr, "      Sema Error %zu: Kind %d at span %u:%u to %u:%u in %s\n", i + 1, err->kind, start.line, start.col, end.line, end.col, source_path(err->span.file));
             }
         }
         test_cleanup_compilation(&res);
@@ -197,6 +222,29 @@ bool test_check_codegen_output(const char *src, int expected_exit, const char *e
     return actual == expected_exit;
 }
 
+bool test_codegen_ir_contains(const char *src, bool strict, const char *needle) {
+    TestCompileResult res = test_compile_source(src);
+    if (res.failed) {
+        test_cleanup_compilation(&res);
+        return false;
+    }
+
+    res.sema_ctx.loader->opts->strict_overflow = strict;
+    res.sema_ctx.loader->opts->strict_aliasing = strict;
+    res.sema_ctx.loader->opts->bounds_checks = strict;
+    CodegenContext *cg_ctx = codegen_context_create(res.store, "test_ir", 0, res.sema_ctx.loader);
+    bool found = false;
+    if (codegen_program(cg_ctx) == 0) {
+        char *ir = codegen_module_ir(cg_ctx);
+        found = ir && strstr(ir, needle) != NULL;
+        free(ir);
+    }
+
+    codegen_context_destroy(cg_ctx);
+    test_cleanup_compilation(&res);
+    return found;
+}
+
 bool test_check_parse_error(const char *src, const char *expected_msg_substring) {
     return true;
 }
@@ -29,4 +29,6 @@ bool test_is_sema_valid(const char *src);
 bool test_check_sema_error(const char *src, TypeErrorKind kind);
 int test_run_and_get_exit_code(const char *src);
 bool test_check_codegen_output(const char *src, int expected_exit, const char *expected_output);
+// True if the unoptimized IR contains `needle`; `strict` turns on --strict-overflow and --strict-aliasing.
+bool test_codegen_ir_contains(const char *src, bool strict, const char *needle);
 bool test_check_parse_error(const char *src, const char *expected_msg_substring);
@@ -1,10 +1,23 @@
 #include "compiler_helpers.h"
 #include "../harness/test_harness.h"
 #include "module_loader.h"
+#include "module_cache.h"
+#include "snapshot.h"
+#include "template_body.h"
+#include "linker.h"
+#include "server.h"
+#include "trace.h"
+#include "stats.h"
+#include "utils.h"
 #include <sys/stat.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Comdat.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm/Config/llvm-config.h>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -21,7 +34,12 @@
     #define close _close
 #else
     #include <dirent.h>
+    #include <fcntl.h>
     #include <unistd.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/wait.h>
 #endif
 
 static char* read_entire_file(const char* path) {
@@ -37,14 +55,91 @@ static char* read_entire_file(const char* path) {
     return buf;
 }
 
-static int run_single_fixture(const char *dir_path, const char *name) {
+typedef enum {
+    FIXTURE_JIT,        // codegen_program + MCJIT
+    FIXTURE_LINKED,     // In-process linker, run as a child process
+    FIXTURE_LAZY_JIT,   // The --run path: per-unit lazy ORC JIT
+    FIXTURE_LINKED_UNITS, // Linked in-process from --codegen-units=4 objects
+    FIXTURE_LINKED_INSTRUMENTED,   // FIXTURE_LINKED with --instrument
+    FIXTURE_LAZY_JIT_INSTRUMENTED, // FIXTURE_LAZY_JIT with --instrument
+    FIXTURE_LINKED_DEV, // FIXTURE_LINKED at -Odev
+} FixtureBackend;
+
+#ifndef _WIN32
+/* Writes the objects next to `exe_path` and links them with cc, as the compiler would. */
+static LinkStatus link_fixture_with_cc(const CodegenObject *objects, size_t count, const char *exe_path) {
+    char obj_paths[4][64];
+    char *argv[4 + 5] = { (char*)"cc" };
+    size_t argc = 1;
+    bool written = true;
+    for (size_t i = 0; i < count; i++) {
+        snprintf(obj_paths[i], sizeof(obj_paths[i]), "%s.%zu.o", exe_path, i);
+        FILE *f = fopen(obj_paths[i], "wb");
+        written = f && fwrite(objects[i].data, 1, objects[i].size, f) == objects[i].size && written;
+        if (f) fclose(f);
+        argv[argc++] = obj_paths[i];
+    }
+    argv[argc++] = (char*)"-lm";
+    argv[argc++] = (char*)"-o";
+    argv[argc++] = (char*)exe_path;
+    argv[argc] = NULL;
+    int status = written ? run_command("cc", argv) : -1;
+    for (size_t i = 0; i < count; i++) remove(obj_paths[i]);
+    return status == 0 ? LINK_OK : LINK_FAILED;
+}
+
+/*
+ * Links the module in-process into a temporary executable and runs it; the
+ * child inherits the (possibly captured) stdout. With `units` > 1 the module
+ * is split into that many objects first (--codegen-units). Where the
+ * in-process linker does not apply it falls back to cc with `system_link`
+ * (TLS and destructors, which MCJIT would not run), else to the JIT.
+ * Process exit codes are 8 bits wide, which is reported through `truncated`.
+ */
+static int run_fixture_linked(CodegenContext *cg_ctx, size_t units, bool system_link, bool *truncated) {
+    CodegenObject objects[4] = {{0}};
+    size_t count = units > 1 ? codegen_emit_object_units(cg_ctx, units, objects) : 0;
+    if (count == SIZE_MAX) return -1;
+    if (count == 0) {
+        objects[0].data = codegen_emit_object_buffer(cg_ctx, &objects[0].size);
+        if (!objects[0].data) return -1;
+        count = 1;
+    }
+
+    int exit_code = -1;
+    char exe_path[] = "/tmp/newt-link-XXXXXX";
+    int fd = mkstemp(exe_path);
+    if (fd >= 0) {
+        close(fd);
+        LinkInput inputs[4];
+        for (size_t i = 0; i < count; i++) inputs[i] = (LinkInput){ objects[i].data, objects[i].size, "fixture" };
+        LinkStatus status = link_executable_in_process(inputs, count, exe_path, NULL, 0);
+        if (status == LINK_UNSUPPORTED && system_link) status = link_fixture_with_cc(objects, count, exe_path);
+        if (status == LINK_OK) {
+            char *argv[] = { exe_path, NULL };
+            exit_code = run_command(exe_path, argv);
+            *truncated = true;
+        } else if (status == LINK_UNSUPPORTED) {
+            exit_code = codegen_run_jit(cg_ctx);
+        }
+        remove(exe_path);
+    }
+    for (size_t i = 0; i < count; i++) free(objects[i].data);
+    return exit_code;
+}
+#endif
+
+static int run_single_fixture(const char *dir_path, const char *name, int jobs, FixtureBackend backend) {
     Arena *arena = arena_create(4 * 1024 * 1024);
     DenseArenaInterner *keywords = intern_table_create(hashmap_create(arena, 32), arena, string_copy_func, slice_hash, slice_cmp);
     DenseArenaInterner *identifiers = intern_table_create(hashmap_create(arena, 256), arena, string_copy_func, slice_hash, slice_cmp);
     DenseArenaInterner *strings = intern_table_create(hashmap_create(arena, 128), arena, string_copy_func, slice_hash, slice_cmp);
     lexer_populate_default_keywords(keywords);
 
-    Options opts = { .verbose = false, .stdlib_path = (char*)"lib" };
+    bool lazy = backend == FIXTURE_LAZY_JIT || backend == FIXTURE_LAZY_JIT_INSTRUMENTED;
+    bool instrument = backend == FIXTURE_LINKED_INSTRUMENTED || backend == FIXTURE_LAZY_JIT_INSTRUMENTED;
+    Options opts = { .verbose = false, .stdlib_path = (char*)"lib", .jobs = jobs, .instrument = instrument,
+                     .fast_compile = backend == FIXTURE_LINKED_DEV };
     ModuleLoader *loader = module_loader_create(arena, &opts, keywords, identifiers, strings);
     
     char main_path[512];
@@ -58,7 +153,7 @@ static int run_single_fixture(const char *dir_path, const char *name) {
     }
 
     TypeStore *store = typestore_create(arena, identifiers, keywords);
-    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, identifiers, keywords, main_path, loader);
+    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, identifiers, keywords, SOURCE_NONE, loader);
     typecheck_program(&sema_ctx);
 
     char expect_path[512];
@@ -69,7 +164,8 @@ static int run_single_fixture(const char *dir_path, const char *name) {
             test_log("      %s✗%s %-30s (Unexpected sema errors)\n", COL_RED, COL_RESET, name);
             for (size_t i = 0; i < sema_ctx.errors->count; i++) {
                 TypeError *err = (TypeError*)dynarray_get(sema_ctx.errors, i);
-                test_log("        -> Error %zu: Kind %d at %s:%u:%u\n", i + 1, err->kind, err->filename, err->span.start_line, err->span.start_col);
+                SourcePos pos = span_start_pos(err->span);
+                test_log("        -> Error %zu: Kind %d at %s:%u:%u\n", i + 1, err->kind, source_path(err->span.file), pos.line, pos.col);
             }
             arena_destroy(arena);
             return 0;
@@ -114,14 +210,16 @@ static int run_single_fixture(const char *dir_path, const char *name) {
         test_log("      %s✗%s %-30s (Unexpected sema errors)\n", COL_RED, COL_RESET, name);
         for (size_t i = 0; i < sema_ctx.errors->count; i++) {
             TypeError *err = (TypeError*)dynarray_get(sema_ctx.errors, i);
-            test_log("        -> Error %zu: Kind %d at %s:%u:%u\n", i + 1, err->kind, err->filename, err->span.start_line, err->span.start_col);
+            SourcePos pos = span_start_pos(err->span);
+            test_log("        -> Error %zu: Kind %d at %s:%u:%u\n", i + 1, err->kind, source_path(err->span.file), pos.line, pos.col);
         }
         success = 0;
     }
 
     if (success && (expected_exit != -1 || out_pos > 0)) {
         CodegenContext *cg_ctx = codegen_context_create(store, "jit_module", 0, loader);
-        if (codegen_program(cg_ctx) == 0) {
+        int cg_res = lazy ? 0 : codegen_program(cg_ctx);
+        if (cg_res == 0) {
             int pipe_fds[2];
             int stdout_save = -1;
             
@@ -137,7 +235,19 @@ static int run_single_fixture(const char *dir_path, const char *name) {
                 }
             }
 
-            int actual_exit = codegen_run_jit(cg_ctx);
+            bool truncated = false;
+            int actual_exit;
+            if (lazy) {
+                actual_exit = codegen_run_lazy_jit(cg_ctx, 0);
+#ifndef _WIN32
+            } else if (backend == FIXTURE_LINKED || backend == FIXTURE_LINKED_UNITS || backend == FIXTURE_LINKED_INSTRUMENTED ||
+                       backend == FIXTURE_LINKED_DEV) {
+                actual_exit = run_fixture_linked(cg_ctx, backend == FIXTURE_LINKED_UNITS ? 4 : 1, instrument, &truncated);
+#endif
+            } else {
+                actual_exit = codegen_run_jit(cg_ctx);
+            }
+            if (truncated && expected_exit != -1) expected_exit &= 0xff;
 
             if (out_pos > 0 && success) {
                 fflush(stdout);
@@ -171,6 +281,18 @@ static int run_single_fixture(const char *dir_path, const char *name) {
                 test_log("      %s✗%s %-30s (Exit code: %d != %d)\n", COL_RED, COL_RESET, name, actual_exit, expected_exit);
                 success = 0;
             }
+
+            // The report lands in $NEWT_INSTRUMENT_FILE, which the suite points at a temporary file
+            if (success && instrument) {
+                const char *report_path = getenv("NEWT_INSTRUMENT_FILE");
+                char *report = report_path ? read_entire_file(report_path) : NULL;
+                if (!report || strncmp(report, "     calls", 10) != 0 || !strstr(report, "main.main()")) {
+                    test_log("      %s✗%s %-30s (No instrumentation report for main)\n", COL_RED, COL_RESET, name);
+                    success = 0;
+                }
+                free(report);
+                if (report_path) remove(report_path);
+            }
         } else {
             test_log("      %s✗%s %-30s (Codegen failed)\n", COL_RED, COL_RESET, name);
             success = 0;
@@ -188,7 +310,13 @@ static int run_single_fixture(const char *dir_path, const char *name) {
     return success;
 }
 
-TEST_CASE_PRIO("Fixtures: Module Loader", 50) {
+typedef int (*FixtureCheck)(const char *dir_path, const char *name, void *data);
+
+/*
+ * Runs `check` on every fixture under test/fixtures/modules, in directory
+ * order, and returns 1 when all of them passed.
+ */
+static int for_each_fixture(FixtureCheck check, void *data) {
     const char *base_path = "test/fixtures/modules";
     int total_success = 1;
 
@@ -208,7 +336,7 @@ TEST_CASE_PRIO("Fixtures: Module Loader", 50) {
         
         struct stat st;
         if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
-            if (!run_single_fixture(full_path, find_data.cFileName)) {
+            if (!check(full_path, find_data.cFileName, data)) {
                 total_success = 0;
             }
         }
@@ -227,7 +355,7 @@ TEST_CASE_PRIO("Fixtures: Module Loader", 50) {
         
         struct stat st;
         if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
-            if (!run_single_fixture(full_path, entry->d_name)) {
+            if (!check(full_path, entry->d_name, data)) {
                 total_success = 0;
             }
         }
@@ -237,3 +365,1327 @@ TEST_CASE_PRIO("Fixtures: Module Loader", 50) {
 
     return total_success;
 }
+
+typedef struct {
+    int jobs;
+    FixtureBackend backend;
+} FixtureMode;
+
+static int run_fixture_in_mode(const char *dir_path, const char *name, void *data) {
+    FixtureMode *mode = data;
+    return run_single_fixture(dir_path, name, mode->jobs, mode->backend);
+}
+
+/* Builds and runs every fixture with `jobs` workers on `backend`. */
+static int run_all_fixtures(int jobs, FixtureBackend backend) {
+    FixtureMode mode = { jobs, backend };
+    return for_each_fixture(run_fixture_in_mode, &mode);
+}
+
+TEST_CASE_PRIO("Fixtures: Module Loader", 50) {
+    return run_all_fixtures(1, FIXTURE_JIT);
+}
+
+static ModuleLoader *load_fixture_modules(Arena *arena, Options *opts, const char *main_path, int *out_res) {
+    DenseArenaInterner *keywords = intern_table_create(hashmap_create(arena, 32), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *identifiers = intern_table_create(hashmap_create(arena, 256), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *strings = intern_table_create(hashmap_create(arena, 128), arena, string_copy_func, slice_hash, slice_cmp);
+    lexer_populate_default_keywords(keywords);
+
+    ModuleLoader *loader = module_loader_create(arena, opts, keywords, identifiers, strings);
+    *out_res = module_loader_load(loader, main_path);
+    return loader;
+}
+
+typedef int (*FixtureCodegen)(CodegenContext *cg_ctx, Arena *arena, ModuleLoader *loader, void *data);
+
+/*
+ * Loads and checks `main_path` with `opts` in a fresh arena and hands a
+ * codegen context for the program to `step`. Returns what `step` returned,
+ * or -1 when the program does not load or check: fixtures that are meant
+ * to fail never reach codegen.
+ */
+static int compile_fixture(const char *main_path, Options *opts, const char *module_name, FixtureCodegen step, void *data) {
+    Arena *arena = arena_create(1024 * 1024);
+    int load_res = 0;
+    ModuleLoader *loader = load_fixture_modules(arena, opts, main_path, &load_res);
+    TypeStore *store = typestore_create(arena, loader->identifiers, loader->keywords);
+    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, loader->identifiers, loader->keywords, SOURCE_NONE, loader);
+    if (load_res == 0) typecheck_program(&sema_ctx);
+    int result = -1;
+    if (load_res == 0 && sema_ctx.errors->count == 0) {
+        CodegenContext *cg_ctx = codegen_context_create(store, module_name, opts->opt_level, loader);
+        result = step(cg_ctx, arena, loader, data);
+        codegen_context_destroy(cg_ctx);
+    }
+    arena_destroy(arena);
+    return result;
+}
+
+static int check_parallel_order(const char *dir_path, const char *name, void *data) {
+    (void)data;
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", dir_path);
+
+    Options serial_opts = { .stdlib_path = "lib", .jobs = 1 };
+    Options parallel_opts = { .stdlib_path = "lib", .jobs = 4 };
+    Arena *serial_arena = arena_create(1024 * 1024);
+    Arena *parallel_arena = arena_create(1024 * 1024);
+
+    int serial_res = 0, parallel_res = 0;
+    ModuleLoader *serial = load_fixture_modules(serial_arena, &serial_opts, main_path, &serial_res);
+    ModuleLoader *parallel = load_fixture_modules(parallel_arena, &parallel_opts, main_path, &parallel_res);
+
+    int success = 1;
+    if (serial_res != parallel_res || serial->units_ordered->count != parallel->units_ordered->count) {
+        test_log("      %s✗%s %-30s (Parallel load diverged: %d/%zu vs %d/%zu)\n", COL_RED, COL_RESET, name,
+                 serial_res, serial->units_ordered->count, parallel_res, parallel->units_ordered->count);
+        success = 0;
+    }
+
+    for (size_t i = 0; success && i < serial->units_ordered->count; i++) {
+        CompilationUnit *a = *(CompilationUnit**)dynarray_get(serial->units_ordered, i);
+        CompilationUnit *b = *(CompilationUnit**)dynarray_get(parallel->units_ordered, i);
+        bool same_logical = (!a->logical_path && !b->logical_path) ||
+                            (a->logical_path && b->logical_path && strcmp(a->logical_path, b->logical_path) == 0);
+        if (strcmp(a->absolute_path, b->absolute_path) != 0 || !same_logical) {
+            test_log("      %s✗%s %-30s (Unit %zu differs: %s vs %s)\n", COL_RED, COL_RESET, name, i, a->absolute_path, b->absolute_path);
+            success = 0;
+        }
+    }
+
+    if (success) {
+        test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    }
+
+    arena_destroy(serial_arena);
+    arena_destroy(parallel_arena);
+    return success;
+}
+
+#ifndef _WIN32
+// Same fixtures with IR generation split over four partitions.
+TEST_CASE_PRIO("Fixtures: Partitioned Codegen", 50) {
+    return run_all_fixtures(4, FIXTURE_JIT);
+}
+
+// Same fixtures as real executables from the in-process linker.
+TEST_CASE_PRIO("Fixtures: In-Process Link", 50) {
+    return run_all_fixtures(1, FIXTURE_LINKED);
+}
+
+// Same again at -Odev (FastISel, fast register allocation), lowered in two partitions.
+TEST_CASE_PRIO("Fixtures: Dev Tier", 50) {
+    return run_all_fixtures(2, FIXTURE_LINKED_DEV);
+}
+
+/*
+ * An object for the host defining `inst` (returning inst_value) as
+ * linkonce_odr in its own COMDAT, and `caller`, which calls it (plus
+ * `callee` when that is given). NULL if the host has no target.
+ */
+static unsigned char *comdat_object(int inst_value, const char *caller, const char *callee, size_t *size) {
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef mod = LLVMModuleCreateWithNameInContext("comdat", context);
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(context);
+    LLVMTypeRef fn_type = LLVMFunctionType(i32, NULL, 0, false);
+    LLVMBuilderRef b = LLVMCreateBuilderInContext(context);
+
+    LLVMValueRef inst = LLVMAddFunction(mod, "inst", fn_type);
+    LLVMSetLinkage(inst, LLVMLinkOnceODRLinkage);
+    LLVMSetComdat(inst, LLVMGetOrInsertComdat(mod, "inst"));
+    LLVMPositionBuilderAtEnd(b, LLVMAppendBasicBlockInContext(context, inst, "entry"));
+    LLVMBuildRet(b, LLVMConstInt(i32, inst_value, false));
+
+    LLVMValueRef fn = LLVMAddFunction(mod, caller, fn_type);
+    LLVMPositionBuilderAtEnd(b, LLVMAppendBasicBlockInContext(context, fn, "entry"));
+    LLVMValueRef result = LLVMBuildCall2(b, fn_type, inst, NULL, 0, "a");
+    if (callee) {
+        LLVMValueRef other = LLVMAddFunction(mod, callee, fn_type);
+        result = LLVMBuildAdd(b, result, LLVMBuildCall2(b, fn_type, other, NULL, 0, "b"), "s");
+    }
+    LLVMBuildRet(b, result);
+    LLVMDisposeBuilder(b);
+
+    unsigned char *data = NULL;
+    char *triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, NULL) == 0) {
+        LLVMSetTarget(mod, triple);
+        LLVMTargetMachineRef machine = LLVMCreateTargetMachine(target, triple, "", "", LLVMCodeGenLevelNone,
+                                                               LLVMRelocPIC, LLVMCodeModelDefault);
+        LLVMMemoryBufferRef mem = NULL;
+        if (LLVMTargetMachineEmitToMemoryBuffer(machine, mod, LLVMObjectFile, NULL, &mem) == 0) {
+            *size = LLVMGetBufferSize(mem);
+            data = malloc(*size);
+            memcpy(data, LLVMGetBufferStart(mem), *size);
+            LLVMDisposeMemoryBuffer(mem);
+        }
+        LLVMDisposeTargetMachine(machine);
+    }
+    LLVMDisposeMessage(triple);
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(context);
+    return data;
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+// Both objects define the instance in its COMDAT; every call must reach the
+// first copy. The in-process linker only targets x86-64 Linux, so other
+// hosts do not register the case.
+TEST_CASE_PRIO("Fixtures: In-Process Link Keeps One Instance", 50) {
+    size_t sizes[2] = { 0, 0 };
+    unsigned char *objects[2] = {
+        comdat_object(7, "main", "other", &sizes[0]), // inst() + other()
+        comdat_object(9, "other", NULL, &sizes[1]),   // inst()
+    };
+    LinkInput inputs[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT(objects[i] != NULL);
+        inputs[i] = (LinkInput){ objects[i], sizes[i], "comdat" };
+    }
+
+    char exe_path[] = "/tmp/newt-comdat-XXXXXX";
+    int fd = mkstemp(exe_path);
+    ASSERT(fd >= 0);
+    close(fd);
+    char err[256] = "";
+    LinkStatus status = link_executable_in_process(inputs, 2, exe_path, err, sizeof(err));
+    int exit_code = -1;
+    if (status == LINK_OK) {
+        char *argv[] = { exe_path, NULL };
+        exit_code = run_command(exe_path, argv);
+    } else {
+        test_log("      In-process link failed: %s\n", err);
+    }
+    remove(exe_path);
+    for (int i = 0; i < 2; i++) free((void*)inputs[i].data);
+
+    ASSERT(status == LINK_OK);
+    ASSERT_EQ_INT(exit_code, 14);
+    return 1;
+}
+#endif
+
+// Same again with the module split into codegen units (--codegen-units).
+TEST_CASE_PRIO("Fixtures: Codegen Units", 50) {
+    return run_all_fixtures(1, FIXTURE_LINKED_UNITS);
+}
+
+// Same fixtures through the lazy per-unit JIT behind --run.
+TEST_CASE_PRIO("Fixtures: Lazy JIT", 50) {
+    return run_all_fixtures(2, FIXTURE_LAZY_JIT);
+}
+
+#ifndef _WIN32
+// Instrumented (--instrument) executables and JIT runs behave the same and report main.
+TEST_CASE_PRIO("Fixtures: Instrumented", 50) {
+    char report_path[] = "/tmp/newt-instrument-XXXXXX";
+    int fd = mkstemp(report_path);
+    if (fd < 0) return 0;
+    close(fd);
+    setenv("NEWT_INSTRUMENT_FILE", report_path, 1);
+
+    int linked = run_all_fixtures(1, FIXTURE_LINKED_INSTRUMENTED);
+    int lazy = run_all_fixtures(2, FIXTURE_LAZY_JIT_INSTRUMENTED);
+    unsetenv("NEWT_INSTRUMENT_FILE");
+    remove(report_path);
+
+    return linked && lazy;
+}
+#endif
+
+// A traced compile (partitioned codegen, so several threads record spans)
+// must come out as trace_event JSON with every span closed on its thread.
+TEST_CASE_PRIO("Fixtures: Trace Export", 50) {
+    char trace_path[] = "/tmp/newt-trace-XXXXXX";
+    int fd = mkstemp(trace_path);
+    if (fd < 0) return 0;
+    close(fd);
+
+    trace_start();
+    int compiled = run_single_fixture("test/fixtures/modules/generics_cross_module", "generics_cross_module (traced)", 2, FIXTURE_JIT);
+    bool written = trace_write_json(trace_path);
+
+    char *json = read_entire_file(trace_path);
+    remove(trace_path);
+    if (!compiled || !written || !json) {
+        free(json);
+        return 0;
+    }
+
+    int success = strncmp(json, "{\"traceEvents\":[", 16) == 0 && strstr(json, "\"displayTimeUnit\"") != NULL;
+    const char *cats[] = { "\"cat\":\"module\"", "\"cat\":\"sema\"", "\"cat\":\"codegen\"", "\"name\":\"drain_mono_queue\"" };
+    for (size_t i = 0; i < sizeof(cats) / sizeof(cats[0]); i++) {
+        if (!strstr(json, cats[i])) {
+            test_log("      %s✗%s Trace has no %s event\n", COL_RED, COL_RESET, cats[i]);
+            success = 0;
+        }
+    }
+
+    // One event per line: track the open span depth of every thread
+    int depth[64] = {0};
+    unsigned max_tid = 0;
+    for (char *line = strchr(json, '\n'); line; line = strchr(line, '\n')) {
+        line++;
+        char ph = 0;
+        unsigned tid = 0;
+        if (sscanf(line, "{\"ph\":\"%c\",\"pid\":1,\"tid\":%u", &ph, &tid) != 2) continue;
+        if (tid >= 64) { success = 0; break; }
+        if (tid > max_tid) max_tid = tid;
+        depth[tid] += ph == 'B' ? 1 : -1;
+        if (depth[tid] < 0) success = 0;
+    }
+    for (unsigned t = 0; t <= max_tid; t++) {
+        if (depth[t] != 0) {
+            test_log("      %s✗%s Thread %u left %d span(s) open\n", COL_RED, COL_RESET, t, depth[t]);
+            success = 0;
+        }
+    }
+    if (max_tid < 2) {
+        test_log("      %s✗%s Expected spans from the codegen workers\n", COL_RED, COL_RESET);
+        success = 0;
+    }
+
+    free(json);
+    return success;
+}
+
+TEST_CASE_PRIO("Fixtures: Parallel Module Loading", 50) {
+    return for_each_fixture(check_parallel_order, NULL);
+}
+
+/*
+ * Loads `main_path` with `jobs` workers and reads the resolution counters:
+ * `misses` is how many paths the cache could not answer, `probes` how many
+ * stat/realpath/opendir calls resolving took.
+ */
+static size_t count_resolution(const char *main_path, int jobs, size_t *misses, size_t *probes) {
+    Options opts = { .stdlib_path = "lib", .jobs = jobs };
+    Arena *arena = arena_create(1024 * 1024);
+    stats_reset();
+    int load_res = 0;
+    ModuleLoader *loader = load_fixture_modules(arena, &opts, main_path, &load_res);
+    *misses = stats_get(STAT_MODULE_RESOLVES) - stats_get(STAT_MODULE_RESOLVE_HITS);
+    *probes = stats_get(STAT_MODULE_FS_PROBES);
+    size_t units = load_res == 0 ? loader->units_ordered->count : 0;
+    arena_destroy(arena);
+    return units;
+}
+
+TEST_CASE_PRIO("Fixtures: Cached Module Resolution", 50) {
+    ASSERT(stats_enabled());
+    size_t misses, probes;
+
+    // base.nt is imported twice but resolved once: one miss per unit
+    size_t units = count_resolution("test/fixtures/modules/diamond/main.nt", 1, &misses, &probes);
+    ASSERT_EQ_INT(units, 4);
+    ASSERT_EQ_INT(misses, units);
+
+    // The library is answered from two directory listings (lib, lib/std);
+    // only the entry module is looked up on disk
+    for (int jobs = 1; jobs <= 4; jobs += 3) {
+        units = count_resolution("test/fixtures/modules/sat_nqueens/main.nt", jobs, &misses, &probes);
+        ASSERT(units > 2);
+        ASSERT_EQ_INT(probes, 3);
+    }
+    return 1;
+}
+
+// Loads and checks `main_path` with `jobs` workers; fills `errors` (TypeError).
+static size_t check_fixture_with_jobs(Arena *arena, const char *main_path, int jobs, DynArray *errors) {
+    Options opts = { .stdlib_path = "lib", .jobs = jobs };
+    int load_res = 0;
+    ModuleLoader *loader = load_fixture_modules(arena, &opts, main_path, &load_res);
+    if (load_res != 0) return 0;
+
+    TypeStore *store = typestore_create(arena, loader->identifiers, loader->keywords);
+    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, loader->identifiers, loader->keywords, SOURCE_NONE, loader);
+    typecheck_program(&sema_ctx);
+    for (size_t i = 0; i < sema_ctx.errors->count; i++) dynarray_push_value(errors, dynarray_get(sema_ctx.errors, i));
+
+    size_t instances = 0;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, loader->units_ordered) {
+        if ((*unit_it)->mono_instances) instances += (*unit_it)->mono_instances->count;
+    }
+    return instances;
+}
+
+static bool same_errors(DynArray *a, DynArray *b) {
+    if (a->count != b->count) return false;
+    for (size_t i = 0; i < a->count; i++) {
+        TypeError *ea = dynarray_get(a, i), *eb = dynarray_get(b, i);
+        if (ea->kind != eb->kind || ea->span.start != eb->span.start || ea->span.end != eb->span.end ||
+            strcmp(source_path(ea->span.file), source_path(eb->span.file)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Passes 1 and 2 on a worker pool must find the same errors and instances as
+// the serial passes, and report the errors in the serial order on every run.
+static int check_parallel_sema(const char *dir_path, const char *name, void *data) {
+    (void)data;
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", dir_path);
+
+    Arena *arenas[3] = { arena_create(1024 * 1024), arena_create(1024 * 1024), arena_create(1024 * 1024) };
+    DynArray serial, first, second;
+    dynarray_init(&serial, sizeof(TypeError));
+    dynarray_init(&first, sizeof(TypeError));
+    dynarray_init(&second, sizeof(TypeError));
+
+    size_t serial_instances = check_fixture_with_jobs(arenas[0], main_path, 1, &serial);
+    size_t parallel_instances = check_fixture_with_jobs(arenas[1], main_path, 4, &first);
+    check_fixture_with_jobs(arenas[2], main_path, 4, &second);
+
+    int success = 1;
+    if (!same_errors(&first, &second)) {
+        test_log("      %s✗%s %-30s (Parallel error order not stable)\n", COL_RED, COL_RESET, name);
+        success = 0;
+    }
+    if (serial_instances != parallel_instances) {
+        test_log("      %s✗%s %-30s (Instances differ: %zu vs %zu)\n", COL_RED, COL_RESET, name, serial_instances, parallel_instances);
+        success = 0;
+    }
+    if (success && !same_errors(&serial, &first)) {
+        test_log("      %s✗%s %-30s (Errors differ: %zu vs %zu)\n", COL_RED, COL_RESET, name, serial.count, first.count);
+        success = 0;
+    }
+    if (success) {
+        test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    }
+
+    dynarray_free(&serial);
+    dynarray_free(&first);
+    dynarray_free(&second);
+    for (int i = 0; i < 3; i++) arena_destroy(arenas[i]);
+    return success;
+}
+
+TEST_CASE_PRIO("Fixtures: Parallel Body Checking", 50) {
+    return for_each_fixture(check_parallel_sema, NULL);
+}
+
+// Reads a whole binary file; returns NULL if missing.
+static unsigned char *read_binary_file(const char *path, long *out_size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *buf = malloc(size > 0 ? size : 1);
+    *out_size = (long)fread(buf, 1, size, f);
+    fclose(f);
+    return buf;
+}
+
+static size_t count_sema_errors(Arena *arena, ModuleLoader *loader, const char *main_path) {
+    TypeStore *store = typestore_create(arena, loader->identifiers, loader->keywords);
+    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, loader->identifiers, loader->keywords, SOURCE_NONE, loader);
+    typecheck_program(&sema_ctx);
+    return sema_ctx.errors->count;
+}
+
+/* The first top-level function `name` of the unit whose path ends in `file`, or NULL. */
+static AstNode *find_unit_function(ModuleLoader *loader, const char *file, const char *name) {
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, loader->units_ordered) {
+        CompilationUnit *unit = *unit_it;
+        size_t path_len = strlen(unit->absolute_path), file_len = strlen(file);
+        if (path_len < file_len || strcmp(unit->absolute_path + path_len - file_len, file) != 0) continue;
+        DYNARRAY_FOREACH(AstNode*, decl_it, unit->ast_root->data.program.decls) {
+            AstNode *decl = *decl_it;
+            if (decl->node_type != AST_FUNCTION_DECLARATION) continue;
+            Slice *key = (Slice*)decl->data.function_declaration.intern_result->key;
+            if (key->len == strlen(name) && memcmp(key->ptr, name, key->len) == 0) return decl;
+        }
+    }
+    return NULL;
+}
+
+static bool is_pruned(AstNode *decl) {
+    return decl && (decl->flags & AST_FLAG_PRUNED);
+}
+
+// std functions the program never names are neither checked nor emitted;
+// --check-all keeps them, and the program's own modules are never pruned.
+TEST_CASE_PRIO("Fixtures: Reachability Pruning", 50) {
+    const char *main_path = "test/fixtures/modules/std_pruning/main.nt";
+    int success = 1;
+
+    for (int check_all = 0; check_all <= 1; check_all++) {
+        Options opts = { .stdlib_path = "lib", .jobs = 1, .check_all = check_all };
+        Arena *arena = arena_create(1024 * 1024);
+        int res = 0;
+        ModuleLoader *loader = load_fixture_modules(arena, &opts, main_path, &res);
+        if (res != 0 || count_sema_errors(arena, loader, main_path) != 0) {
+            test_log("      %s✗%s std_pruning does not check (check_all=%d)\n", COL_RED, COL_RESET, check_all);
+            arena_destroy(arena);
+            return 0;
+        }
+
+        AstNode *sqrt_fn = find_unit_function(loader, "std/math.nt", "sqrt");
+        AstNode *cos_fn = find_unit_function(loader, "std/math.nt", "cos");
+        AstNode *libc_atan = find_unit_function(loader, "std/libc.nt", "atan"); // std.math.sqrt is an intrinsic
+        AstNode *libc_cos = find_unit_function(loader, "std/libc.nt", "cos");
+        AstNode *unused = find_unit_function(loader, "std_pruning/helper.nt", "unused");
+        if (!sqrt_fn || !cos_fn || !libc_atan || !libc_cos || !unused) {
+            test_log("      %s✗%s Fixture functions not found\n", COL_RED, COL_RESET);
+            success = 0;
+        } else if (is_pruned(sqrt_fn) || is_pruned(libc_atan) || is_pruned(unused)) {
+            test_log("      %s✗%s A reachable function was pruned (check_all=%d)\n", COL_RED, COL_RESET, check_all);
+            success = 0;
+        } else if (is_pruned(cos_fn) != !check_all || is_pruned(libc_cos) != !check_all) {
+            test_log("      %s✗%s std 'cos' pruned: %d, expected %d\n", COL_RED, COL_RESET, is_pruned(cos_fn), !check_all);
+            success = 0;
+        }
+        arena_destroy(arena);
+    }
+    if (success) test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, "std_pruning");
+    return success;
+}
+
+static bool template_body_as_parsed(const TemplateBody *tb) {
+    for (size_t i = 0; i < tb->block_count; i++) {
+        if (memcmp(tb->blocks[i].block->data, tb->blocks[i].parsed, tb->blocks[i].used) != 0) return false;
+    }
+    return true;
+}
+
+// Box<i32>.get and Box<i8>.get are checked in the one body of `get`: each
+// keeps only a patch, and the tree is as parsed whenever none is bound.
+TEST_CASE_PRIO("Fixtures: Instances Share The Template Body", 50) {
+    const char *main_path = "test/fixtures/modules/generics_cross_module/main.nt";
+    Options opts = { .stdlib_path = "lib", .jobs = 1 };
+    Arena *arena = arena_create(1024 * 1024);
+    int res = 0;
+    ModuleLoader *loader = load_fixture_modules(arena, &opts, main_path, &res);
+    if (res != 0 || count_sema_errors(arena, loader, main_path) != 0) {
+        test_log("      %s✗%s generics_cross_module does not check\n", COL_RED, COL_RESET);
+        arena_destroy(arena);
+        return 0;
+    }
+
+    AstNode *gets[2] = { NULL, NULL };
+    size_t found = 0;
+    DYNARRAY_FOREACH(CompilationUnit*, unit_it, loader->units_ordered) {
+        if (!(*unit_it)->mono_instances) continue;
+        DYNARRAY_FOREACH(AstNode*, mono_it, (*unit_it)->mono_instances) {
+            Slice *name = (Slice*)(*mono_it)->data.function_declaration.intern_result->key;
+            if (name->len == 3 && memcmp(name->ptr, "get", 3) == 0 && found < 2) gets[found++] = *mono_it;
+        }
+    }
+
+    int success = 1;
+    if (found != 2) {
+        test_log("      %s✗%s Expected two instances of Box.get, found %zu\n", COL_RED, COL_RESET, found);
+        success = 0;
+    } else {
+        AstFunctionDeclaration *a = &gets[0]->data.function_declaration, *b = &gets[1]->data.function_declaration;
+        TemplateBody *tb = a->template_body;
+        if (!tb || tb != b->template_body || !a->body || a->body != b->body || a->body != tb->root) {
+            test_log("      %s✗%s The instances do not share one body\n", COL_RED, COL_RESET);
+            success = 0;
+        } else if (!a->body_patch || !b->body_patch || !template_body_as_parsed(tb)) {
+            test_log("      %s✗%s An instance's annotations were left in the shared body\n", COL_RED, COL_RESET);
+            success = 0;
+        } else {
+            // Binding a patch puts that instance's types back; unbinding undoes it
+            ASSERT(template_body_bind(tb, a->body_patch));
+            AstNode *ret = DYNARRAY_AT(AstNode*, tb->root->data.block.statements, 0);
+            Type *a_type = ret->data.return_statement.expression ? ret->data.return_statement.expression->type : NULL;
+            template_body_unbind(tb);
+            ASSERT(template_body_bind(tb, b->body_patch));
+            Type *b_type = ret->data.return_statement.expression ? ret->data.return_statement.expression->type : NULL;
+            template_body_unbind(tb);
+            if (!a_type || !b_type || a_type == b_type || !template_body_as_parsed(tb)) {
+                test_log("      %s✗%s The patches do not hold each instance's types\n", COL_RED, COL_RESET);
+                success = 0;
+            }
+        }
+    }
+    arena_destroy(arena);
+    if (success) test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, "generics_cross_module");
+    return success;
+}
+
+static void remove_cache_dir(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) return;
+    struct dirent *entry;
+    char path[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        remove(path);
+    }
+    closedir(dir);
+    rmdir(dir_path);
+}
+
+/*
+ * Cold load fills the cache, warm load must take every unit from it, and
+ * every imported non-library unit from its interface summary. Warm ASTs are
+ * re-encoded into a second directory and compared byte for byte, and both
+ * runs must report the same number of sema errors.
+ */
+typedef struct {
+    const char *cache_dir;
+    const char *recheck_dir;
+} CacheDirs;
+
+static int check_cache_round_trip(const char *dir_path, const char *name, void *data) {
+    const char *cache_dir = ((CacheDirs*)data)->cache_dir;
+    const char *recheck_dir = ((CacheDirs*)data)->recheck_dir;
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", dir_path);
+
+    Options opts = { .stdlib_path = "lib", .jobs = 1, .cache_dir = cache_dir };
+    Arena *cold_arena = arena_create(1024 * 1024);
+    Arena *warm_arena = arena_create(1024 * 1024);
+
+    int cold_res = 0, warm_res = 0;
+    ModuleLoader *cold = load_fixture_modules(cold_arena, &opts, main_path, &cold_res);
+    ModuleLoader *warm = load_fixture_modules(warm_arena, &opts, main_path, &warm_res);
+
+    int success = 1;
+    if (cold_res != warm_res || cold->units_ordered->count != warm->units_ordered->count) {
+        test_log("      %s✗%s %-30s (Cached load diverged: %d/%zu vs %d/%zu)\n", COL_RED, COL_RESET, name,
+                 cold_res, cold->units_ordered->count, warm_res, warm->units_ordered->count);
+        success = 0;
+    }
+
+    for (size_t i = 0; success && i < warm->units_ordered->count; i++) {
+        CompilationUnit *a = *(CompilationUnit**)dynarray_get(cold->units_ordered, i);
+        CompilationUnit *b = *(CompilationUnit**)dynarray_get(warm->units_ordered, i);
+        if (!b->from_cache || b->cache_key != a->cache_key) {
+            test_log("      %s✗%s %-30s (Unit %zu not served from cache: %s)\n", COL_RED, COL_RESET, name, i, b->absolute_path);
+            success = 0;
+            break;
+        }
+
+        // Imported modules outside the library come from their summaries
+        bool imported = i + 1 < warm->units_ordered->count && !b->is_library;
+        if (b->from_interface != imported) {
+            test_log("      %s✗%s %-30s (Unit %zu %s its interface summary: %s)\n", COL_RED, COL_RESET, name, i,
+                     imported ? "not served from" : "wrongly served from", b->absolute_path);
+            success = 0;
+            break;
+        }
+        if (imported) {
+            module_cache_store_interface(recheck_dir, b->cache_key, b->source_len, b->ast_root,
+                                         warm->keywords, warm->identifiers, warm->strings);
+        } else {
+            module_cache_store(recheck_dir, b->cache_key, b->source_len, b->ast_root,
+                               warm->keywords, warm->identifiers, warm->strings);
+        }
+
+        const char *ext = imported ? "nti" : "ntc";
+        char first[1024], second[1024];
+        snprintf(first, sizeof(first), "%s/%016llx.%s", cache_dir, (unsigned long long)b->cache_key, ext);
+        snprintf(second, sizeof(second), "%s/%016llx.%s", recheck_dir, (unsigned long long)b->cache_key, ext);
+        long first_size = 0, second_size = 0;
+        unsigned char *first_buf = read_binary_file(first, &first_size);
+        unsigned char *second_buf = read_binary_file(second, &second_size);
+        if (!first_buf || !second_buf || first_size != second_size || memcmp(first_buf, second_buf, first_size) != 0) {
+            test_log("      %s✗%s %-30s (Cached AST does not round-trip: %s)\n", COL_RED, COL_RESET, name, b->absolute_path);
+            success = 0;
+        }
+        free(first_buf);
+        free(second_buf);
+    }
+
+    if (success && cold_res == 0) {
+        size_t cold_errors = count_sema_errors(cold_arena, cold, main_path);
+        size_t warm_errors = count_sema_errors(warm_arena, warm, main_path);
+        if (cold_errors != warm_errors) {
+            test_log("      %s✗%s %-30s (Sema errors differ: %zu vs %zu)\n", COL_RED, COL_RESET, name, cold_errors, warm_errors);
+            success = 0;
+        }
+    }
+
+    if (success) {
+        test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    }
+
+    arena_destroy(cold_arena);
+    arena_destroy(warm_arena);
+    return success;
+}
+
+TEST_CASE_PRIO("Fixtures: Module Cache Round-Trip", 50) {
+    char cache_dir[] = "/tmp/newt-cache-XXXXXX";
+    char recheck_dir[] = "/tmp/newt-recheck-XXXXXX";
+    if (!mkdtemp(cache_dir)) return 0;
+    if (!mkdtemp(recheck_dir)) { rmdir(cache_dir); return 0; }
+
+    CacheDirs dirs = { cache_dir, recheck_dir };
+    int total_success = for_each_fixture(check_cache_round_trip, &dirs);
+
+    remove_cache_dir(cache_dir);
+    remove_cache_dir(recheck_dir);
+    return total_success;
+}
+
+static bool has_snapshot(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) return false;
+    bool found = false;
+    struct dirent *entry;
+    while (!found && (entry = readdir(dir)) != NULL) {
+        found = strncmp(entry->d_name, "startup-", 8) == 0 && strstr(entry->d_name, ".nts") != NULL;
+    }
+    closedir(dir);
+    return found;
+}
+
+/*
+ * The first open builds the startup state and writes the snapshot; the
+ * second maps it back at the same address. Every table must answer as it
+ * did, and still take new entries through the callbacks set on load.
+ */
+TEST_CASE_PRIO("Fixtures: Startup Snapshot Round-Trip", 50) {
+    char cache_dir[] = "/tmp/newt-snapshot-XXXXXX";
+    if (!mkdtemp(cache_dir)) return 0;
+
+    StartupState built, loaded;
+    bool mapped = true;
+    Arena *arena = startup_state_open(cache_dir, 8 * 1024 * 1024, ARENA_MALLOC, &built, &mapped);
+    ASSERT(arena != NULL);
+    ASSERT(!mapped);
+    int keyword_count = built.keywords->dense_index_count;
+    int identifier_count = built.identifiers->dense_index_count;
+    TypeStore before = *built.store;
+    arena_destroy(arena);
+
+    // No snapshot where the fixed address is not available: nothing to check
+    if (!has_snapshot(cache_dir)) {
+        remove_cache_dir(cache_dir);
+        return 1;
+    }
+
+    arena = startup_state_open(cache_dir, 8 * 1024 * 1024, ARENA_MALLOC, &loaded, &mapped);
+    ASSERT(arena != NULL && mapped);
+    ASSERT(loaded.store == built.store && loaded.keywords == built.keywords);
+    ASSERT(loaded.keywords->dense_index_count == keyword_count &&
+           loaded.identifiers->dense_index_count == identifier_count);
+    ASSERT(loaded.store->t_i32 == before.t_i32 && loaded.store->t_str == before.t_str &&
+           loaded.store->kw_len == before.kw_len && loaded.store->kw_print == before.kw_print &&
+           loaded.store->universe == before.universe);
+
+    InternResult *kw_struct = intern_peek(loaded.keywords, &(Slice){ .ptr = "struct", .len = 6 });
+    InternResult *kw_i32 = intern_peek(loaded.keywords, &(Slice){ .ptr = "i32", .len = 3 });
+    ASSERT(kw_struct && kw_i32);
+    ASSERT(ptrmap_get(loaded.store->primitive_registry, kw_i32->key) == loaded.store->t_i32);
+    Symbol *sym = scope_lookup_symbol_local(loaded.store->universe, kw_i32);
+    ASSERT(sym && sym->type == loaded.store->t_i32);
+
+    // The interners work after the callbacks were set again
+    InternResult *len = intern(loaded.identifiers, &(Slice){ .ptr = "len", .len = 3 }, NULL);
+    ASSERT(len == loaded.store->kw_len);
+    InternResult *fresh = intern(loaded.identifiers, &(Slice){ .ptr = "snapshot_fresh", .len = 14 }, NULL);
+    ASSERT(fresh && fresh->entry->dense_index == identifier_count);
+    ASSERT(make_pointer_type(loaded.store, loaded.store->t_char) == loaded.store->t_str);
+    Type *fresh_ptr = make_pointer_type(loaded.store, loaded.store->t_i32);
+    ASSERT(fresh_ptr && make_pointer_type(loaded.store, loaded.store->t_i32) == fresh_ptr);
+
+    arena_destroy(arena);
+    remove_cache_dir(cache_dir);
+    test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, "startup snapshot");
+    return 1;
+}
+
+static size_t count_object_files(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) return 0;
+    size_t count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > 2 && strcmp(entry->d_name + len - 2, ".o") == 0) count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/*
+ * Two compilations against the same cache: the first builds one object per
+ * library unit, the second must pick up the very same files without adding
+ * any, and the program module must still generate around them.
+ */
+typedef struct {
+    const char *cache_dir;
+    const char *name;
+    int round;
+    char *first_paths[64];
+    size_t first_count;
+    size_t objects_after_first;
+} PrebuiltRounds;
+
+static int prebuilt_round(CodegenContext *cg_ctx, Arena *arena, ModuleLoader *loader, void *data) {
+    PrebuiltRounds *r = data;
+    size_t libraries = 0;
+    for (size_t i = 0; i < loader->units_ordered->count; i++) {
+        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(loader->units_ordered, i);
+        if (unit->is_library) libraries++;
+    }
+
+    DynArray objects;
+    dynarray_init_in_arena(&objects, arena, sizeof(char*), 8);
+    int prebuilt = codegen_use_prebuilt_libraries(cg_ctx, r->cache_dir, arena, &objects);
+
+    int success = 1;
+    if (prebuilt < 0 || (size_t)prebuilt != libraries || objects.count != libraries || objects.count > 64) {
+        test_log("      %s✗%s %-30s (Prebuilt %d of %zu library units)\n", COL_RED, COL_RESET, r->name, prebuilt, libraries);
+        success = 0;
+    } else if (r->round == 0) {
+        r->first_count = objects.count;
+        for (size_t i = 0; i < objects.count; i++) {
+            r->first_paths[i] = strdup(*(char**)dynarray_get(&objects, i));
+        }
+        r->objects_after_first = count_object_files(r->cache_dir);
+    } else {
+        for (size_t i = 0; i < objects.count; i++) {
+            if (i >= r->first_count || strcmp(r->first_paths[i], *(char**)dynarray_get(&objects, i)) != 0) {
+                test_log("      %s✗%s %-30s (Prebuilt object %zu not reused)\n", COL_RED, COL_RESET, r->name, i);
+                success = 0;
+                break;
+            }
+        }
+        if (count_object_files(r->cache_dir) != r->objects_after_first) {
+            test_log("      %s✗%s %-30s (Warm run rebuilt library objects)\n", COL_RED, COL_RESET, r->name);
+            success = 0;
+        }
+    }
+
+    if (success && codegen_program(cg_ctx) != 0) {
+        test_log("      %s✗%s %-30s (Codegen failed around prebuilt units)\n", COL_RED, COL_RESET, r->name);
+        success = 0;
+    }
+    return success;
+}
+
+static int check_prebuilt_objects(const char *dir_path, const char *name, void *data) {
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", dir_path);
+
+    Options opts = { .stdlib_path = "lib", .jobs = 1, .cache_dir = data };
+    PrebuiltRounds rounds = { .cache_dir = data, .name = name };
+    int success = 1;
+    for (; success && rounds.round < 2; rounds.round++) {
+        int result = compile_fixture(main_path, &opts, "prebuilt_module", prebuilt_round, &rounds);
+        if (result < 0) break;
+        success = result;
+    }
+
+    for (size_t i = 0; i < rounds.first_count; i++) free(rounds.first_paths[i]);
+    if (success) {
+        test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    }
+    return success;
+}
+
+TEST_CASE_PRIO("Fixtures: Prebuilt Library Objects", 50) {
+    char cache_dir[] = "/tmp/newt-prebuilt-XXXXXX";
+    if (!mkdtemp(cache_dir)) return 0;
+
+    int total_success = for_each_fixture(check_prebuilt_objects, cache_dir);
+
+    remove_cache_dir(cache_dir);
+    return total_success;
+}
+
+/*
+ * Same for generic instances: the warm run must link every instance of a
+ * library template from the objects the cold run wrote, and the program
+ * module must still generate and verify without their bodies.
+ */
+typedef struct {
+    const char *cache_dir;
+    int linked;     // Instances linked from the cache, over all fixtures
+} InstanceCache;
+
+typedef struct {
+    InstanceCache *cache;
+    const char *name;
+    int round;
+    int first_count;
+    size_t objects_after_first;
+} InstanceRounds;
+
+static int instance_round(CodegenContext *cg_ctx, Arena *arena, ModuleLoader *loader, void *data) {
+    (void)loader;
+    InstanceRounds *r = data;
+    const char *cache_dir = r->cache->cache_dir;
+    DynArray objects;
+    dynarray_init_in_arena(&objects, arena, sizeof(char*), 8);
+    codegen_use_prebuilt_libraries(cg_ctx, cache_dir, arena, &objects);
+    int instances = codegen_use_cached_instances(cg_ctx, cache_dir, arena, &objects);
+
+    int success = 1;
+    if (instances < 0) {
+        test_log("      %s✗%s %-30s (Instance cache rejected its arguments)\n", COL_RED, COL_RESET, r->name);
+        success = 0;
+    } else if (r->round == 0) {
+        r->first_count = instances;
+        r->cache->linked += instances;
+        r->objects_after_first = count_object_files(cache_dir);
+    } else if (instances != r->first_count || count_object_files(cache_dir) != r->objects_after_first) {
+        test_log("      %s✗%s %-30s (Warm run rebuilt %d of %d instances)\n", COL_RED, COL_RESET, r->name,
+                 (int)(count_object_files(cache_dir) - r->objects_after_first), r->first_count);
+        success = 0;
+    }
+
+    if (success && codegen_program(cg_ctx) != 0) {
+        test_log("      %s✗%s %-30s (Codegen failed around cached instances)\n", COL_RED, COL_RESET, r->name);
+        success = 0;
+    }
+    return success;
+}
+
+static int check_cached_instances(const char *dir_path, const char *name, void *data) {
+    InstanceCache *cache = data;
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", dir_path);
+
+    Options opts = { .stdlib_path = "lib", .jobs = 1, .cache_dir = cache->cache_dir };
+    InstanceRounds rounds = { .cache = cache, .name = name, .first_count = -1 };
+    int success = 1;
+    for (; success && rounds.round < 2; rounds.round++) {
+        int result = compile_fixture(main_path, &opts, "instance_module", instance_round, &rounds);
+        if (result < 0) break;
+        success = result;
+    }
+
+    if (success) {
+        test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    }
+    return success;
+}
+
+TEST_CASE_PRIO("Fixtures: Cached Generic Instances", 50) {
+    char cache_dir[] = "/tmp/newt-instances-XXXXXX";
+    if (!mkdtemp(cache_dir)) return 0;
+
+    InstanceCache cache = { cache_dir, 0 };
+    int total_success = for_each_fixture(check_cached_instances, &cache);
+
+    // The std containers are generic: some fixture must have used one.
+    if (cache.linked == 0) {
+        test_log("      %s✗%s No fixture linked a cached instance\n", COL_RED, COL_RESET);
+        total_success = 0;
+    }
+
+    remove_cache_dir(cache_dir);
+    return total_success;
+}
+
+// --incremental: a body is only checked and compiled again when its own
+// source, or the interface of something it names, changed.
+static const char *INCREMENTAL_HELPER[] = {
+    "pub struct P { x: i32; y: i32; }\n"
+    "pub fn twice(a: i32) -> i32 { return a * 2; }\n"
+    "pub fn sum(p: P) -> i32 { return p.x + p.y; }\n",
+    // A body edit
+    "pub struct P { x: i32; y: i32; }\n"
+    "pub fn twice(a: i32) -> i32 { return a * 3; }\n"
+    "pub fn sum(p: P) -> i32 { return p.x + p.y; }\n",
+    // A signature edit: main calls twice
+    "pub struct P { x: i32; y: i32; }\n"
+    "pub fn twice(a: i64) -> i32 { return (a as i32) * 3; }\n"
+    "pub fn sum(p: P) -> i32 { return p.x + p.y; }\n",
+};
+
+static const char *INCREMENTAL_MAIN =
+    "import .helper { twice, sum, P };\n"
+    "fn add(a: i32, b: i32) -> i32 { return a + b; }\n"
+    "fn main() -> i32 {\n"
+    "    p: P = P { x: 1, y: 2 };\n"
+    "    return add(twice(3), sum(p));\n"
+    "}\n";
+
+static bool write_text_file(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fputs(text, f);
+    fclose(f);
+    return true;
+}
+
+typedef struct {
+    const char *const *names;
+    const char *const *files;
+    size_t count;
+} IncrementalFunctions;
+
+static int incremental_round(CodegenContext *cg_ctx, Arena *arena, ModuleLoader *loader, void *data) {
+    IncrementalFunctions *fns = data;
+    int reused = 0;
+    for (size_t i = 0; i < fns->count; i++) {
+        AstNode *func = find_unit_function(loader, fns->files[i], fns->names[i]);
+        if (!func) reused = -1;
+        else if (reused >= 0 && (func->flags & AST_FLAG_REUSED)) reused |= 1 << i;
+    }
+
+    DynArray objects;
+    dynarray_init_in_arena(&objects, arena, sizeof(char*), 8);
+    if (codegen_use_cached_bodies(cg_ctx, arena, &objects) != (int)fns->count || codegen_program(cg_ctx) != 0) reused = -1;
+    return reused;
+}
+
+/* Check and compile the project; returns a bit per entry of `names` that sema skipped, or -1. */
+static int incremental_build(const char *main_path, const char *cache_dir, const char *const *names, const char *const *files, size_t count) {
+    Options opts = { .stdlib_path = "lib", .jobs = 1, .cache_dir = cache_dir, .incremental = true };
+    IncrementalFunctions fns = { names, files, count };
+    return compile_fixture(main_path, &opts, "incremental_module", incremental_round, &fns);
+}
+
+TEST_CASE_PRIO("Fixtures: Incremental Re-checking", 50) {
+    char project[] = "/tmp/newt-incremental-XXXXXX";
+    if (!mkdtemp(project)) return 0;
+    char main_path[512], helper_path[512], cache_dir[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", project);
+    snprintf(helper_path, sizeof(helper_path), "%s/helper.nt", project);
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", project);
+    mkdir(cache_dir, 0755);
+
+    const char *const names[] = { "add", "main", "twice", "sum" };
+    const char *const files[] = { "/main.nt", "/main.nt", "/helper.nt", "/helper.nt" };
+    // Which of `names` the build may take from the cache after each edit
+    const struct { int helper; int reused; const char *what; } rounds[] = {
+        { 0, 0x0, "cold build" },
+        { 0, 0xf, "unchanged sources" },
+        { 1, 0xb, "body of twice edited" },
+        { 2, 0x9, "signature of twice edited" },
+        { 2, 0xf, "unchanged after the edits" },
+    };
+
+    int success = write_text_file(main_path, INCREMENTAL_MAIN);
+    for (size_t i = 0; success && i < sizeof(rounds) / sizeof(rounds[0]); i++) {
+        if (!write_text_file(helper_path, INCREMENTAL_HELPER[rounds[i].helper])) { success = 0; break; }
+        int reused = incremental_build(main_path, cache_dir, names, files, 4);
+        if (reused != rounds[i].reused) {
+            test_log("      %s✗%s %s: reused 0x%x, expected 0x%x\n", COL_RED, COL_RESET, rounds[i].what, reused, rounds[i].reused);
+            success = 0;
+        }
+    }
+    if (success) test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, "incremental");
+
+    remove_cache_dir(cache_dir);
+    rmdir(cache_dir);
+    remove(main_path);
+    remove(helper_path);
+    rmdir(project);
+    return success;
+}
+
+#if LLVM_VERSION_MAJOR <= 16
+static const char *PROFILE_MAIN =
+    "fn step(x: i32) -> i32 { if (x > 3) { return x * 2; } return x; }\n"
+    "fn main() -> i32 { s: i32 = 0; for (i: i32 = 0; i < 10; i++) { s = s + step(i); } print(s); return 0; }\n";
+
+/* Points `fd` at `path` (NULL: restores `saved`); returns the descriptor to restore. */
+static int redirect_fd(int fd, const char *path, int saved) {
+    fflush(fd == STDERR_FILENO ? stderr : stdout);
+    if (!path) {
+        dup2(saved, fd);
+        close(saved);
+        return -1;
+    }
+    int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) return -1;
+    saved = dup(fd);
+    dup2(file, fd);
+    close(file);
+    return saved;
+}
+
+typedef struct {
+    Options *opts;
+    const char *exe_path;
+    const char *err_path;
+} ProfileBuild;
+
+static int profile_link(CodegenContext *cg_ctx, Arena *arena, ModuleLoader *loader, void *data) {
+    (void)arena;
+    (void)loader;
+    ProfileBuild *build = data;
+    int stderr_save = redirect_fd(STDERR_FILENO, build->err_path, -1);
+    int cg_res = codegen_program(cg_ctx);
+    if (stderr_save >= 0) redirect_fd(STDERR_FILENO, NULL, stderr_save);
+
+    CodegenObject object = {0};
+    if (cg_res == 0) object.data = codegen_emit_object_buffer(cg_ctx, &object.size);
+    if (!object.data) return 0;
+    // As in the compiler, the counter sections' __start_/__stop_ symbols need the system linker
+    LinkInput input = { object.data, object.size, "profile" };
+    LinkStatus status = build->opts->profile_generate ? LINK_UNSUPPORTED : link_executable_in_process(&input, 1, build->exe_path, NULL, 0);
+    if (status == LINK_UNSUPPORTED) status = link_fixture_with_cc(&object, 1, build->exe_path);
+    free(object.data);
+    return status == LINK_OK;
+}
+
+/*
+ * Compiles `main_path` with `opts` into `exe_path`, the compiler's stderr
+ * going to `err_path`. Runs in a child: LLVM flags set by one build would
+ * otherwise carry over to the next, as they never do between compiler runs.
+ */
+static bool profile_build(const char *main_path, Options *opts, const char *exe_path, const char *err_path) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        ProfileBuild build = { opts, exe_path, err_path };
+        _exit(compile_fixture(main_path, opts, "profile_module", profile_link, &build) == 1 ? 0 : 1);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// --profile-generate, llvm-profdata merge, --profile-use: the profile must
+// match the program it was taken from, so the use build warns about nothing.
+TEST_CASE_PRIO("Fixtures: Profile-Guided Build", 50) {
+    char project[] = "/tmp/newt-profile-XXXXXX";
+    if (!mkdtemp(project)) return 0;
+    char main_path[512], exe_path[512], raw_path[512], data_path[512], err_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", project);
+    snprintf(exe_path, sizeof(exe_path), "%s/main", project);
+    snprintf(raw_path, sizeof(raw_path), "%s/main.profraw", project);
+    snprintf(data_path, sizeof(data_path), "%s/main.profdata", project);
+    snprintf(err_path, sizeof(err_path), "%s/stderr.txt", project);
+
+    int success = write_text_file(main_path, PROFILE_MAIN);
+    Options generate = { .stdlib_path = "lib", .jobs = 1, .opt_level = 2, .profile_generate = raw_path };
+    if (success && !profile_build(main_path, &generate, exe_path, err_path)) {
+        test_log("      %s✗%s %-30s (Instrumented build failed)\n", COL_RED, COL_RESET, "profile-generate");
+        success = 0;
+    }
+    if (success) {
+        char *argv[] = { exe_path, NULL };
+        int stdout_save = redirect_fd(STDOUT_FILENO, "/dev/null", -1);
+        int exit_code = run_command(exe_path, argv);
+        if (stdout_save >= 0) redirect_fd(STDOUT_FILENO, NULL, stdout_save);
+        struct stat st;
+        if (exit_code != 0 || stat(raw_path, &st) != 0 || st.st_size == 0) {
+            test_log("      %s✗%s %-30s (No raw profile written, exit %d)\n", COL_RED, COL_RESET, "profile-generate", exit_code);
+            success = 0;
+        }
+    }
+
+    char *merge_argv[] = { (char*)"llvm-profdata", (char*)"merge", (char*)"-o", data_path, raw_path, NULL };
+    bool merged = success && run_command("llvm-profdata", merge_argv) == 0;
+    if (success && !merged) {
+        test_log("      %s-%s %-30s (skipped: llvm-profdata merge failed or is not installed)\n", COL_YELLOW, COL_RESET, "profile-use");
+    }
+    if (merged) {
+        Options use = { .stdlib_path = "lib", .jobs = 1, .opt_level = 2, .profile_use = data_path };
+        char *err = NULL;
+        if (!profile_build(main_path, &use, exe_path, err_path)) {
+            test_log("      %s✗%s %-30s (Build with the profile failed)\n", COL_RED, COL_RESET, "profile-use");
+            success = 0;
+        } else if ((err = read_entire_file(err_path)) && err[0] != '\0') {
+            test_log("      %s✗%s %-30s (Warnings from the use build)\n%s", COL_RED, COL_RESET, "profile-use", err);
+            success = 0;
+        }
+        free(err);
+    }
+    if (success) test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, merged ? "profile-use" : "profile-generate");
+
+    remove(main_path);
+    remove(exe_path);
+    remove(raw_path);
+    remove(data_path);
+    remove(err_path);
+    rmdir(project);
+    return success;
+}
+#endif
+
+// --serve: the library is loaded and checked once in the daemon, every
+// request is compiled in a forked copy of that state.
+typedef struct {
+    Arena *arena;
+    DenseArenaInterner *keywords;
+    DenseArenaInterner *identifiers;
+    ModuleLoader *loader;
+    TypeStore *store;
+} ResidentLibrary;
+
+/* Daemon side: argv[1] is a fixture directory. Sema errors come back as 1000 + count. */
+static int serve_fixture(int argc, char **argv, void *arg) {
+    ResidentLibrary *lib = arg;
+    if (argc < 2) return -1;
+
+    char main_path[512];
+    snprintf(main_path, sizeof(main_path), "%s/main.nt", argv[1]);
+    if (load_module_recursive(lib->loader, main_path, NULL, NULL, 0) != 0) return -1;
+    module_loader_retain_reachable(lib->loader, main_path);
+
+    // A library unit that is not resident was parsed again
+    for (size_t i = 0; i < lib->loader->units_ordered->count; i++) {
+        CompilationUnit *unit = *(CompilationUnit**)dynarray_get(lib->loader->units_ordered, i);
+        if (unit->is_library && !unit->resident) return -2;
+    }
+
+    TypeCheckContext sema_ctx = typecheck_context_create(lib->arena, lib->store, lib->identifiers, lib->keywords, SOURCE_NONE, lib->loader);
+    typecheck_program(&sema_ctx);
+    if (sema_ctx.errors->count > 0) return 1000 + (int)sema_ctx.errors->count;
+
+    CodegenContext *cg_ctx = codegen_context_create(lib->store, "jit_module", 0, lib->loader);
+    int result = codegen_program(cg_ctx) == 0 ? codegen_run_jit(cg_ctx) : -1;
+    codegen_context_destroy(cg_ctx);
+    return result;
+}
+
+/* Load and check the library once, the state requests are forked from. */
+static bool prepare_resident_library(ResidentLibrary *lib, Options *opts) {
+    Arena *arena = arena_create(4 * 1024 * 1024);
+    DenseArenaInterner *keywords = intern_table_create(hashmap_create(arena, 32), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *identifiers = intern_table_create(hashmap_create(arena, 256), arena, string_copy_func, slice_hash, slice_cmp);
+    DenseArenaInterner *strings = intern_table_create(hashmap_create(arena, 128), arena, string_copy_func, slice_hash, slice_cmp);
+    lexer_populate_default_keywords(keywords);
+
+    ModuleLoader *loader = module_loader_create(arena, opts, keywords, identifiers, strings);
+    TypeStore *store = typestore_create(arena, identifiers, keywords);
+    *lib = (ResidentLibrary){ arena, keywords, identifiers, loader, store };
+    if (module_loader_preload_library(loader) != 0) return false;
+
+    TypeCheckContext sema_ctx = typecheck_context_create(arena, store, identifiers, keywords, SOURCE_NONE, loader);
+    typecheck_program(&sema_ctx);
+    return sema_ctx.errors->count == 0;
+}
+
+static void run_fixture_server(const char *socket_path) {
+    Options opts = { .verbose = false, .stdlib_path = (char*)"lib", .jobs = 1 };
+    ResidentLibrary lib;
+    if (!prepare_resident_library(&lib, &opts)) _exit(1);
+    _exit(server_run(socket_path, serve_fixture, &lib));
+}
+
+/* What a fixture's expect.txt says serve_fixture returns for it, or -1. */
+static int expected_serve_result(const char *fixture_dir) {
+    char expect_path[600];
+    snprintf(expect_path, sizeof(expect_path), "%s/expect.txt", fixture_dir);
+    char *expect = read_entire_file(expect_path);
+    if (!expect) return -1;
+    const char *errors = strstr(expect, "error:");
+    const char *exit_line = strstr(expect, "exit:");
+    int expected = errors ? 1000 + atoi(errors + 6) : exit_line ? atoi(exit_line + 5) : -1;
+    free(expect);
+    return expected;
+}
+
+static bool wait_for_server(const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    for (int attempt = 0; attempt < 500; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool up = fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (fd >= 0) close(fd);
+        if (up) return true;
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+/* One request for the fixture; fixtures without an expected result are skipped. */
+static int serve_one_fixture(const char *dir_path, const char *name, void *data) {
+    int expected = expected_serve_result(dir_path);
+    if (expected == -1) return 1;
+
+    char *argv[] = { (char*)"compiler", (char*)dir_path, NULL };
+    int actual = server_request((const char*)data, 2, argv);
+    if (actual != expected) {
+        test_log("      %s✗%s %-30s (Server result: %d != %d)\n", COL_RED, COL_RESET, name, actual, expected);
+        return 0;
+    }
+    test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, name);
+    return 1;
+}
+
+TEST_CASE_PRIO("Fixtures: Compile Server", 50) {
+    char socket_path[64];
+    snprintf(socket_path, sizeof(socket_path), "/tmp/newt-serve-%d.sock", (int)getpid());
+
+    fflush(NULL);
+    pid_t server = fork();
+    if (server < 0) return 0;
+    if (server == 0) run_fixture_server(socket_path);
+
+    if (!wait_for_server(socket_path)) {
+        test_log("      %s✗%s Compile server did not come up\n", COL_RED, COL_RESET);
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        return 0;
+    }
+
+    int total_success = for_each_fixture(serve_one_fixture, socket_path);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    return total_success;
+}
+
+typedef struct {
+    FILE *manifest;
+    int expected[64];
+    char names[64][256];
+    size_t count;
+} BatchFixtures;
+
+/* Adds the fixture to the manifest when it has an expected result. */
+static int add_batch_fixture(const char *dir_path, const char *name, void *data) {
+    BatchFixtures *fixtures = data;
+    int result = expected_serve_result(dir_path);
+    if (result == -1 || fixtures->count == 64) return 1;
+    fixtures->expected[fixtures->count] = result;
+    snprintf(fixtures->names[fixtures->count], sizeof(fixtures->names[0]), "%s", name);
+    fprintf(fixtures->manifest, "%s   # %s\n", dir_path, name);
+    fixtures->count++;
+    return 1;
+}
+
+// --batch: one manifest line per fixture, four children at a time, each
+// forked from the same checked library.
+TEST_CASE_PRIO("Fixtures: Batch Mode", 50) {
+    char manifest_path[] = "/tmp/newt-batch-XXXXXX";
+    int fd = mkstemp(manifest_path);
+    if (fd < 0) return 0;
+    FILE *manifest_file = fdopen(fd, "w");
+    if (!manifest_file) { close(fd); return 0; }
+
+    // Manifest order is readdir order; remember what each line expects
+    BatchFixtures fixtures = { .manifest = manifest_file };
+    fprintf(manifest_file, "# one fixture per line\n\n");
+    for_each_fixture(add_batch_fixture, &fixtures);
+    fclose(manifest_file);
+
+    BatchManifest manifest;
+    bool read = batch_manifest_read(manifest_path, "compiler", &manifest);
+    remove(manifest_path);
+    if (!read) return 0;
+
+    int success = manifest.count == fixtures.count;
+    Options opts = { .verbose = false, .stdlib_path = (char*)"lib", .jobs = 1 };
+    ResidentLibrary lib = {0};
+    if (success && prepare_resident_library(&lib, &opts)) {
+        server_batch(&manifest, 4, serve_fixture, &lib);
+        for (size_t i = 0; i < fixtures.count; i++) {
+            if (manifest.entries[i].code != fixtures.expected[i] || manifest.entries[i].argc != 2 || manifest.entries[i].line != (int)i + 3) {
+                test_log("      %s✗%s %-30s (Batch result: %d != %d)\n", COL_RED, COL_RESET, fixtures.names[i], manifest.entries[i].code, fixtures.expected[i]);
+                success = 0;
+            } else {
+                test_log("      %s✓%s %-30s\n", COL_GREEN, COL_RESET, fixtures.names[i]);
+            }
+        }
+    } else {
+        success = 0;
+    }
+    if (lib.arena) arena_destroy(lib.arena);
+    batch_manifest_free(&manifest);
+    return success;
+}
+#endif
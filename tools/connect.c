@@ -0,0 +1,31 @@
+// connect.c - thin client for the compile daemon (compiler --serve)
+
+/**
+ * DOC: newt-connect
+ *
+ * Same command line as `compiler --connect <socket> <file> [options]`, but
+ * built without LLVM, so a CI job that fires off many small compiles does
+ * not pay for loading the backend in every client process. Everything past
+ * the socket is interpreted by the daemon.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "core/server.h"
+#include "core/exit_codes.h"
+
+int main(int argc, char **argv) {
+    const char *socket_path = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--connect") == 0) {
+            socket_path = argv[i + 1];
+            break;
+        }
+    }
+    if (!socket_path) {
+        fprintf(stderr, "Usage: %s --connect <socket> <file> [options]\n", argv[0]);
+        return EXIT_USAGE;
+    }
+    return server_request(socket_path, argc, argv);
+}